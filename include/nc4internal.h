@@ -47,6 +47,16 @@ typedef enum {VAR, DIM, ATT} NC_OBJ_T;
 
 #define MEGABYTE 1048576
 
+/* Reads and writes that need type conversion and are larger than this
+ * (in the file's type) are converted in blocks of at most this size,
+ * so the per-file conversion buffer never grows beyond it. */
+#define NC4_CONVERT_BLOCK_SIZE (4 * MEGABYTE)
+
+/* The default size of the per-file cache of decoded chunks for point
+ * reads, and the most values a read may have to be served from it. */
+#define NC4_POINT_CACHE_SIZE (4 * MEGABYTE)
+#define NC4_POINT_READ_MAX 64
+
 /*
  * limits of the external representation
  */
@@ -89,6 +99,11 @@ typedef enum {VAR, DIM, ATT} NC_OBJ_T;
  * same name as a dimension. */
 #define NON_COORD_PREPEND "_nc4_non_coord_"
 
+/* The metadata index of a file is kept in this dataset of the root
+ * group, stamped with this attribute. */
+#define NC_METADATA_INDEX_NAME "_NCMetadataIndex"
+#define NC_METADATA_STAMP_ATT_NAME "_NCMetadataStamp"
+
 /* An attribute in the HDF5 root group of this name means that the
  * file must follow strict netCDF classic format rules. */
 #define NC3_STRICT_ATT_NAME "_nc3_strict"
@@ -125,6 +140,7 @@ typedef struct NC_DIM_INFO
    nc_bool_t too_long;          /* True if len is too big to fit in local size_t. */
    hid_t hdf_dimscaleid;
    HDF5_OBJID_T hdf5_objid;
+   nc_bool_t dimid_in_file;     /* True if the dimid was read from the _Netcdf4Dimid att */
    struct NC_VAR_INFO *coord_var; /* The coord var, if it exists. */
 } NC_DIM_INFO_T;
 
@@ -173,15 +189,27 @@ typedef struct NC_VAR_INFO
    nc_bool_t dimscale;          /* True if var is a dimscale */
    nc_bool_t *dimscale_attached;        /* Array of flags that are true if dimscale is attached for that dim index */
    HDF5_OBJID_T *dimscale_hdf5_objids;
+   nc_bool_t coords_read;       /* True if dimids were read from the coordinates att, and are not yet checked */
    nc_bool_t deflate;           /* True if var has deflate filter applied */
    int deflate_level;
    nc_bool_t shuffle;           /* True if var has shuffle filter applied */
    nc_bool_t fletcher32;        /* True if var has fletcher32 filter applied */
    nc_bool_t szip;              /* True if var has szip filter applied */
+   int quantize_mode;           /* NC_NOQUANTIZE, NC_QUANTIZE_BITGROOM or NC_QUANTIZE_BITROUND */
+   int nsd;                     /* Significant digits or bits kept by quantize_mode */
    int options_mask;
    int pixels_per_block;
-   size_t chunk_cache_size, chunk_cache_nelems;
+   unsigned int filterid;       /* Id of the HDF5 filter set with nc_def_var_filter, or 0 */
+   size_t nparams;              /* Number of params of filterid */
+   unsigned int *params;        /* Params of filterid */
+   size_t chunk_cache_size, chunk_cache_nelems; /* As set by the user, or the default */
    float chunk_cache_preemption;
+   size_t chunk_cache_charged;  /* Bytes of chunk cache granted by the memory budget, and given to HDF5 */
+   hsize_t *logical_dims;       /* Extent of the data written, once known; the HDF5 extent may be larger */
+   nc_bool_t overallocated;     /* True if the HDF5 extent is larger than logical_dims */
+   hid_t hdf_spaceid;           /* Cached file dataspace, reset when the extent changes */
+   hid_t hdf_mem_spaceid;       /* Memory dataspace of the last read or write */
+   hsize_t *mem_space_dims;     /* Dims of hdf_mem_spaceid */
 #ifdef USE_HDF4
    /* Stuff below is for hdf4 files. */
    int sdsid;
@@ -323,8 +351,41 @@ typedef struct  NC_HDF5_FILE_INFO
 #ifdef ENABLE_FILEINFO
    struct NCFILEINFO* fileinfo;
 #endif
+   void *convert_buf;           /* Scratch buffer for type conversion */
+   size_t convert_buf_size;
+   int append_mode;             /* NC_APPEND_EXACT or NC_APPEND_GEOMETRIC */
+   size_t point_cache_size;     /* Bytes of decoded chunks for point reads */
+   struct NC4_POINT_CACHE *point_cache; /* Allocated on first point read */
+   NC_GRP_INFO_T **grp_index;   /* Groups, by nc_grpid */
+   int grp_index_len;
+   NC_TYPE_INFO_T **type_index; /* User-defined types, by nc_typeid */
+   int type_index_len;
+   struct NC4_GRP_PATHS *grp_paths; /* Groups by full name, built on first use */
+   nc_bool_t md_index;          /* True to write the metadata index on sync */
+   nc_bool_t md_index_read;     /* True if the metadata was read from the index */
+   nc_bool_t meta_dirty;        /* True if metadata changed since the last sync */
+   nc_bool_t dimids_preserved;  /* True once the dimids of all dimscales are written */
 } NC_HDF5_FILE_INFO_T;
 
+typedef struct NC4_POINT_CACHE NC4_POINT_CACHE_T;
+
+/* One block of an arena. */
+typedef struct NC4_ARENA_BLOCK
+{
+   char *data;
+   size_t size;
+   size_t used;
+} NC4_ARENA_BLOCK_T;
+
+/* The memory HDF5 allocates for the strings and vlens of one read,
+ * carved out of a few large blocks instead of allocated one value at
+ * a time. It is all freed together, with nc4_arena_release(). */
+typedef struct NC4_ARENA
+{
+   NC4_ARENA_BLOCK_T *block;    /* The blocks, the last one in use */
+   int nblocks;
+} NC4_ARENA_T;
+
 
 /* Defined in lookup3.c */
 extern uint32_t hash_fast(const void *key, size_t length);
@@ -337,22 +398,56 @@ int nc4_convert_type(const void *src, void *dest,
 		     const size_t len, int *range_error,
 		     const void *fill_value, int strict_nc3, int src_long,
 		     int dest_long);
+void nc4_quantize_data(void *data, nc_type type, size_t len,
+		       int quantize_mode, int nsd, const void *fill_value);
 
 /* These functions do HDF5 things. */
 int rec_detach_scales(NC_GRP_INFO_T *grp, int dimid, hid_t dimscaleid);
 int rec_reattach_scales(NC_GRP_INFO_T *grp, int dimid, hid_t dimscaleid);
 int nc4_open_var_grp2(NC_GRP_INFO_T *grp, int varid, hid_t *dataset);
+int nc4_read_dimscale_objids(NC_VAR_INFO_T *var);
 int nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
 		 const size_t *countp, nc_type xtype, int is_long, void *op);
 int nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
-		 const size_t *countp, nc_type xtype, int is_long, void *op);
+		 const size_t *countp, nc_type xtype, int is_long, void *op,
+		 NC4_ARENA_T *arena);
+int nc4_get_vara_field(NC *nc, int ncid, int varid, int fieldid,
+		       const size_t *startp, const size_t *countp, void *op);
+int nc4_get_var_points(NC *nc, int ncid, int varid, size_t npoints,
+		       const size_t *indexp, nc_type xtype, int is_long,
+		       void *op);
 int nc4_rec_match_dimscales(NC_GRP_INFO_T *grp);
+int nc4_read_type(NC_GRP_INFO_T *grp, hid_t hdf_typeid, char *type_name);
 int nc4_rec_detect_need_to_preserve_dimids(NC_GRP_INFO_T *grp, nc_bool_t *bad_coord_orderp);
 int nc4_rec_write_metadata(NC_GRP_INFO_T *grp, nc_bool_t bad_coord_order);
+int nc4_rec_trim_extents(NC_GRP_INFO_T *grp);
+void nc4_release_file_space(NC_VAR_INFO_T *var);
+void nc4_release_var_spaces(NC_VAR_INFO_T *var);
+int nc4_get_file_space(NC_VAR_INFO_T *var, hid_t *spaceidp);
 int nc4_rec_write_groups_types(NC_GRP_INFO_T *grp);
 int nc4_enddef_netcdf4_file(NC_HDF5_FILE_INFO_T *h5);
 int nc4_reopen_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var);
+int nc4_open_var_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var, const char *name);
 int nc4_adjust_var_cache(NC_GRP_INFO_T *grp, NC_VAR_INFO_T * var);
+void nc4_charge_chunk_cache(NC_VAR_INFO_T *var);
+void nc4_release_chunk_cache(NC_VAR_INFO_T *var);
+int nc4_get_convert_buf(NC_HDF5_FILE_INFO_T *h5, size_t size, void **bufp);
+void nc4_free_convert_buf(NC_HDF5_FILE_INFO_T *h5);
+
+/* These functions manage the cache of decoded chunks for point
+ * reads, in nc4pointcache.c. */
+int nc4_point_read(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var,
+		   const hsize_t *start, const hsize_t *count,
+		   nc_type mem_nc_type, int is_long, void *data,
+		   nc_bool_t *donep);
+void nc4_point_cache_drop_var(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var);
+size_t nc4_point_cache_used(NC_HDF5_FILE_INFO_T *h5);
+void nc4_point_cache_free(NC_HDF5_FILE_INFO_T *h5);
+
+/* These functions write and read the metadata index of a file, in
+ * nc4mdindex.c. */
+int nc4_write_metadata_index(NC_HDF5_FILE_INFO_T *h5);
+int nc4_read_metadata_index(NC_HDF5_FILE_INFO_T *h5, nc_bool_t *readp);
 
 /* The following functions manipulate the in-memory linked list of
    metadata, without using HDF calls. */
@@ -361,15 +456,20 @@ int nc4_find_nc_grp_h5(int ncid, NC **nc, NC_GRP_INFO_T **grp,
 int nc4_find_grp_h5(int ncid, NC_GRP_INFO_T **grp, NC_HDF5_FILE_INFO_T **h5);
 int nc4_find_nc4_grp(int ncid, NC_GRP_INFO_T **grp);
 NC_GRP_INFO_T *nc4_find_nc_grp(int ncid);
-NC_GRP_INFO_T *nc4_rec_find_grp(NC_GRP_INFO_T *start_grp, int target_nc_grpid);
+NC_GRP_INFO_T *nc4_find_grp_id(const NC_HDF5_FILE_INFO_T *h5, int nc_grpid);
+int nc4_find_grp_full_name(NC_HDF5_FILE_INFO_T *h5, const char *full_name,
+			   NC_GRP_INFO_T **grp);
+int nc4_grp_full_name(const NC_GRP_INFO_T *grp, char **full_name);
+void nc4_grp_paths_free(NC_HDF5_FILE_INFO_T *h5);
+void nc4_free_indexes(NC_HDF5_FILE_INFO_T *h5);
 NC *nc4_find_nc_file(int ncid, NC_HDF5_FILE_INFO_T**);
 int nc4_find_dim(NC_GRP_INFO_T *grp, int dimid, NC_DIM_INFO_T **dim, NC_GRP_INFO_T **dim_grp);
 int nc4_find_var(NC_GRP_INFO_T *grp, const char *name, NC_VAR_INFO_T **var);
 int nc4_find_dim_len(NC_GRP_INFO_T *grp, int dimid, size_t **len);
 int nc4_find_type(const NC_HDF5_FILE_INFO_T *h5, int typeid1, NC_TYPE_INFO_T **type);
-NC_TYPE_INFO_T *nc4_rec_find_nc_type(const NC_GRP_INFO_T *start_grp, nc_type target_nc_typeid);
-NC_TYPE_INFO_T *nc4_rec_find_hdf_type(NC_GRP_INFO_T *start_grp, hid_t target_hdf_typeid);
-NC_TYPE_INFO_T *nc4_rec_find_named_type(NC_GRP_INFO_T *start_grp, char *name);
+NC_TYPE_INFO_T *nc4_find_nc_type(const NC_HDF5_FILE_INFO_T *h5, nc_type typeid1);
+NC_TYPE_INFO_T *nc4_find_hdf_type(const NC_HDF5_FILE_INFO_T *h5, hid_t target_hdf_typeid);
+NC_TYPE_INFO_T *nc4_find_named_type(const NC_HDF5_FILE_INFO_T *h5, const char *name);
 NC_TYPE_INFO_T *nc4_rec_find_equal_type(NC_GRP_INFO_T *start_grp, int ncid1, NC_TYPE_INFO_T *type);
 int nc4_find_nc_att(int ncid, int varid, const char *name, int attnum,
 		    NC_ATT_INFO_T **att);
@@ -418,6 +518,12 @@ int nc4_check_dup_name(NC_GRP_INFO_T *grp, char *norm_name);
 /* HDF5 initialization */
 extern int nc4_hdf5_initialized;
 extern void nc4_hdf5_initialize(void);
+int nc4_filter_initialize(void);
+
+/* Arenas for the strings and vlens of a read, in nc4packed.c. */
+void *nc4_arena_alloc(size_t size, void *arena);
+void nc4_arena_free(void *mem, void *arena);
+void nc4_arena_release(NC4_ARENA_T *arena);
 
 /* This is only included if --enable-logging is used for configure; it
    prints info about the metadata to stderr. */
@@ -181,6 +181,8 @@ extern int NCDEFAULT_get_varm(int, int, const size_t*,
 extern int NCDEFAULT_put_varm(int, int, const size_t*,
                const size_t*, const ptrdiff_t*, const ptrdiff_t*,
                const void*, nc_type);
+extern int NCDEFAULT_get_var_points(int, int, size_t, const size_t*,
+               void*, nc_type);
 
 /**************************************************/
 /* Forward */
@@ -294,6 +296,49 @@ int (*set_var_chunk_cache)(int, int, size_t, size_t, float);
 int (*get_var_chunk_cache)(int ncid, int varid, size_t *sizep, size_t *nelemsp, float *preemptionp);
 #endif /*USE_NETCDF4*/
 
+/* Added to support I/O statistics; only meaningful for classic files */
+int (*inq_io_stats)(int, nc_io_stats_t*);
+int (*reset_io_stats)(int);
+
+/* Added to support memory accounting */
+int (*inq_memory_usage)(int, nc_memory_usage_t*);
+
+/* Added to support amortized extension of unlimited dimensions */
+int (*set_append_mode)(int, int, int*);
+
+/* Added to support batched reads of scattered points */
+int (*get_var_points)(int, int, size_t, const size_t*, void*, nc_type);
+
+/* Added to support quantization of float vars */
+int (*def_var_quantize)(int, int, int, int);
+int (*inq_var_quantize)(int, int, int*, int*);
+
+/* Added to support the metadata index of netCDF-4 files */
+int (*set_metadata_index)(int, int, int*);
+int (*inq_metadata_index)(int, int*, int*);
+
+/* Added to support raw chunk I/O of netCDF-4 vars */
+int (*get_chunk_raw)(int, int, const size_t*, unsigned int*, size_t*, void*);
+int (*put_chunk_raw)(int, int, const size_t*, unsigned int, size_t, const void*);
+int (*iter_chunks_raw)(int, int, nc_chunk_iter_fn, void*);
+
+/* Added to support the export of the byte ranges of var data */
+int (*iter_byte_ranges)(int, int, nc_byte_range_fn, void*);
+
+/* Added to support generic filters of netCDF-4 vars */
+int (*def_var_filter)(int, int, unsigned int, size_t, const unsigned int*);
+int (*inq_var_filter)(int, int, unsigned int*, size_t*, unsigned int*);
+
+/* Added to support reads of one field of compound vars */
+int (*get_vara_field)(int, int, int, const size_t*, const size_t*, void*);
+
+/* Added to support packed strings and vlens */
+int (*get_vara_packed)(int, int, const size_t*, const size_t*, size_t*, void**);
+int (*put_vara_packed)(int, int, const size_t*, const size_t*, const size_t*, const void*);
+
+/* Added to support the comparison of the filter pipelines of vars */
+int (*inq_var_filter_ids)(int, int, size_t*, unsigned int*);
+
 };
 
 /* Following functions must be handled as non-dispatch */
@@ -364,6 +409,8 @@ extern int NCDAP_ping(const char*);
 /* Misc */
 
 extern int NC_getshape(int ncid, int varid, int ndims, size_t* shape);
+extern int NC_fill_slab(int ncid, int varid, const size_t** startp,
+			const size_t** countp, size_t* start, size_t* count);
 extern int NC_is_recvar(int ncid, int varid, size_t* nrecs);
 extern int NC_inq_recvar(int ncid, int varid, int* nrecdims, int* is_recdim);
 
@@ -385,6 +432,66 @@ extern int NC_argc;
 extern char* NC_argv[];
 extern int NC_initialized;
 
+/* Dispatch tracing (dtrace.c), controlled by NETCDF_TRACE and
+   NETCDF_TRACE_JSON */
+extern int NC_tracing;
+extern int NC_trace_initialize(void);
+extern int NC_trace_finalize(void);
+extern NC_Dispatch* NC_trace_wrap(NC_Dispatch* inner);
+
+/* Memory accounting (dmemory.c). The chunk caches, DAP2 caches and
+   I/O buffers charge what they hold to one of these categories;
+   NC_memory_grant() shrinks a request to fit the budget set by
+   nc_set_memory_budget(). */
+#define NC_MEM_CHUNK_CACHE 0
+#define NC_MEM_DAP_CACHE 1
+#define NC_MEM_IO_BUFFERS 2
+#define NC_MEM_NCATEGORIES 3
+extern size_t NC_memory_available(void);
+extern size_t NC_memory_grant(int category, size_t want, size_t floor);
+extern void NC_memory_charge(int category, size_t n);
+extern void NC_memory_release(int category, size_t n);
+
+/* Streaming reads and writes (dtiles.c). NC_read_tiles() reads a
+   hyperslab a tile at a time through a buffer of at most bufsize
+   bytes, tiles of chunked vars aligned with the chunks, and hands each
+   row of a tile along the innermost dimension to row(), with the
+   position of its first value relative to the start of the
+   hyperslab. */
+typedef void (*NC_tile_row_fn)(void* ctx, const void* values, size_t n,
+                               const size_t* rel);
+extern int NC_read_tiles(int ncid, int varid, nc_type memtype, size_t bufsize,
+                         const size_t* start, const size_t* count,
+                         NC_tile_row_fn row, void* ctx);
+/* NC_write_tiles() is the other way round: row() fills each row of a
+   tile, which is then written. */
+typedef void (*NC_tile_fill_fn)(void* ctx, void* values, size_t n,
+                                const size_t* rel);
+extern int NC_write_tiles(int ncid, int varid, nc_type memtype, size_t bufsize,
+                          const size_t* start, const size_t* count,
+                          NC_tile_fill_fn row, void* ctx);
+
+/* The CF packing and masking attributes of a var (dunpack.c), all
+   as doubles. A value is valid unless it equals fill or one of the
+   nmissing values of missing_value (the rest of missing are NaN) or
+   lies outside [lo, hi]; valid values unpack to value * scale +
+   offset. */
+#define NC_UNPACK_MAX_MISSING 4
+typedef struct NC_unpack {
+    double scale;
+    double offset;
+    double fill;
+    double missing[NC_UNPACK_MAX_MISSING];
+    int nmissing;
+    double lo;
+    double hi;
+} NC_unpack;
+#define NC_UNPACK_VALID(u, v) (((v) != (u)->fill) & \
+                               ((v) != (u)->missing[0]) & ((v) != (u)->missing[1]) & \
+                               ((v) != (u)->missing[2]) & ((v) != (u)->missing[3]) & \
+                               ((v) >= (u)->lo) & ((v) <= (u)->hi))
+extern int NC_get_unpack(int ncid, int varid, nc_type xtype, NC_unpack* up);
+
 NCD_EXTERNL int nc_initialize();
 
 
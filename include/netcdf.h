@@ -119,6 +119,35 @@ extern "C" {
 #define NC_FILL		0	/**< Argument to nc_set_fill() to clear NC_NOFILL */
 #define NC_NOFILL	0x100	/**< Argument to nc_set_fill() to turn off filling of data. */
 
+#define NC_APPEND_EXACT		0 /**< Argument to nc_set_append_mode() to extend unlimited dimensions exactly. */
+#define NC_APPEND_GEOMETRIC	1 /**< Argument to nc_set_append_mode() to over-allocate unlimited dimensions. */
+
+#define NC_REDUCE_MIN	1 /**< Argument to nc_get_vara_reduce() for the minimum. */
+#define NC_REDUCE_MAX	2 /**< Argument to nc_get_vara_reduce() for the maximum. */
+#define NC_REDUCE_SUM	3 /**< Argument to nc_get_vara_reduce() for the sum. */
+#define NC_REDUCE_MEAN	4 /**< Argument to nc_get_vara_reduce() for the mean. */
+#define NC_REDUCE_COUNT	5 /**< Argument to nc_get_vara_reduce() for the number of valid values. */
+
+#define NC_NOQUANTIZE		0 /**< Argument to nc_def_var_quantize() to turn quantization off. */
+#define NC_QUANTIZE_BITGROOM	1 /**< Argument to nc_def_var_quantize() to keep a number of significant digits by bit grooming. */
+#define NC_QUANTIZE_BITROUND	2 /**< Argument to nc_def_var_quantize() to keep a number of significant bits by bit rounding. */
+
+/** Name of the attribute that records the number of significant
+ * digits kept by ::NC_QUANTIZE_BITGROOM. */
+#define NC_QUANTIZE_BITGROOM_ATT_NAME "_QuantizeBitGroomNumberOfSignificantDigits"
+/** Name of the attribute that records the number of significant bits
+ * kept by ::NC_QUANTIZE_BITROUND. */
+#define NC_QUANTIZE_BITROUND_ATT_NAME "_QuantizeBitRoundNumberOfSignificantBits"
+
+/** Id of the LZ4 filter built into the library, for
+ * nc_def_var_filter(). Its first param is the size in bytes of the
+ * blocks a chunk is compressed in (0 for the whole chunk), its second
+ * the compression level: 0 (or no param) for the fastest, up to
+ * ::NC_FILTER_LZ4_MAX_LEVEL for smaller output that still decompresses
+ * as fast. The data is stored as by the HDF5 LZ4 filter plugin. */
+#define NC_FILTER_LZ4		32004
+#define NC_FILTER_LZ4_MAX_LEVEL	12 /**< Highest level of ::NC_FILTER_LZ4. */
+
 /* Define the ioflags bits for nc_create and nc_open.
    currently unused:
         0x0002
@@ -456,8 +485,9 @@ by the desired type. */
 #define NC_EDISKLESS     (-129)    /**< Error in using diskless  access. */
 #define NC_ECANTEXTEND   (-130)    /**< Attempt to extend dataset during ind. I/O operation. */
 #define NC_EMPI          (-131)    /**< MPI operation failed. */
+#define NC_EFILTER       (-132)    /**< Filter not available, or failed. */
 
-#define NC4_LAST_ERROR   (-131)
+#define NC4_LAST_ERROR   (-132)
 
 /* This is used in netCDF-4 files for dimensions without coordinate
  * vars. */
@@ -520,6 +550,63 @@ nc_open(const char *path, int mode, int *ncidp);
 EXTERNL int
 nc_inq_path(int ncid, size_t *pathlen, char *path);
 
+/** I/O counters kept for each open classic format file. The call
+ * counts and times are those of the ncio layer (get, rel, move,
+ * sync); the remaining counters are kept by the I/O package in use
+ * (posix, ffio, diskless memory, mmap or byte-range). */
+typedef struct {
+    unsigned long long nget;          /**< Regions requested */
+    unsigned long long nrel;          /**< Regions released */
+    unsigned long long nmove;         /**< Region moves (header growth) */
+    unsigned long long nsync;         /**< Buffer flushes */
+    unsigned long long nread;         /**< Read system calls (or copies in) */
+    unsigned long long nwrite;        /**< Write system calls (or copies out) */
+    unsigned long long nseek;         /**< Seek system calls */
+    unsigned long long bytes_read;    /**< Bytes read from the file */
+    unsigned long long bytes_written; /**< Bytes written to the file */
+    unsigned long long nrmw;          /**< Writes that first had to read existing data */
+    unsigned long long cache_hits;    /**< Requests satisfied from the buffer */
+    unsigned long long cache_misses;  /**< Requests that had to fault data in */
+    double get_time;                  /**< Seconds spent in get */
+    double rel_time;                  /**< Seconds spent in rel */
+    double move_time;                 /**< Seconds spent in move */
+    double sync_time;                 /**< Seconds spent in sync */
+} nc_io_stats_t;
+
+/* Get the I/O counters of a classic format file. */
+EXTERNL int
+nc_inq_io_stats(int ncid, nc_io_stats_t *statsp);
+
+/* Zero the I/O counters of a classic format file. */
+EXTERNL int
+nc_reset_io_stats(int ncid);
+
+/** Memory held by the library, in bytes, as reported by
+ * nc_inq_memory_usage(). The chunk cache figure is the capacity
+ * reserved for the caches, which HDF5 fills on demand; the others are
+ * memory actually held. Metadata is an estimate. */
+typedef struct {
+    size_t chunk_cache;   /**< HDF5 chunk caches of netCDF-4 variables */
+    size_t dap_cache;     /**< DAP2 data caches */
+    size_t io_buffers;    /**< Classic format I/O buffers and in-memory file images */
+    size_t metadata;      /**< In-memory metadata (dimensions, variables, attributes) */
+    size_t total;         /**< Sum of the above */
+} nc_memory_usage_t;
+
+/* Get the memory held for one file, or for all open files if ncid is
+ * NC_GLOBAL. */
+EXTERNL int
+nc_inq_memory_usage(int ncid, nc_memory_usage_t *usagep);
+
+/* Limit the combined size of the chunk caches, DAP2 caches and I/O
+ * buffers; 0 removes the limit. */
+EXTERNL int
+nc_set_memory_budget(size_t budget);
+
+/* Get the memory budget (0 if there is none). */
+EXTERNL int
+nc_inq_memory_budget(size_t *budgetp);
+
 /* Given an ncid and group name (NULL gets root group), return
  * locid. */
 EXTERNL int
@@ -867,10 +954,91 @@ nc_def_var_endian(int ncid, int varid, int endian);
 EXTERNL int
 nc_inq_var_endian(int ncid, int varid, int *endianp);
 
+/* Set quantization for a float or double var, which zeroes the bits
+ * of each value written that are not needed to keep nsd significant
+ * digits (or bits), so that it compresses better. This must be done
+ * after nc_def_var and before nc_enddef. */
+EXTERNL int
+nc_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd);
+
+/* Find out quantization settings of a var. */
+EXTERNL int
+nc_inq_var_quantize(int ncid, int varid, int *quantize_modep, int *nsdp);
+
+/* Read a chunk of a chunked var as it is stored, compressed. With a
+ * NULL data pointer, just find its size, which is 0 if the chunk has
+ * not been written. */
+EXTERNL int
+nc_get_chunk_raw(int ncid, int varid, const size_t *startp,
+                 unsigned int *filter_maskp, size_t *sizep, void *data);
+
+/* Write a chunk of a chunked var as it is to be stored. */
+EXTERNL int
+nc_put_chunk_raw(int ncid, int varid, const size_t *startp,
+                 unsigned int filter_mask, size_t size, const void *data);
+
+/* The function called by nc_iter_chunks_raw() for each stored chunk
+ * of a var. A non-zero return stops the iteration. */
+typedef int (*nc_chunk_iter_fn)(const size_t *startp,
+                                unsigned int filter_mask, size_t size,
+                                void *udata);
+
+/* Call a function for each stored chunk of a chunked var. */
+EXTERNL int
+nc_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void *udata);
+
+/* The function called by nc_iter_byte_ranges() for each block of the
+ * data of a var in the file: the index of its first element and its
+ * shape in the var, its offset and size in bytes in the file, and the
+ * mask of the filters skipped for it. A non-zero return stops the
+ * iteration. */
+typedef int (*nc_byte_range_fn)(const size_t *startp, const size_t *countp,
+                                unsigned long long offset,
+                                unsigned long long size,
+                                unsigned int filter_mask, void *udata);
+
+/* Call a function for each block of the data of a var in the file,
+ * so that it can be read without the library. */
+EXTERNL int
+nc_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void *udata);
+
+/* Set an HDF5 filter, by its id, to compress the data of a var, with
+ * the params it takes. This must be done after nc_def_var and before
+ * nc_enddef. */
+EXTERNL int
+nc_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+                  const unsigned int *params);
+
+/* Find out the filter of a var, set with nc_def_var_filter, and its
+ * params. */
+EXTERNL int
+nc_inq_var_filter(int ncid, int varid, unsigned int *idp, size_t *nparamsp,
+                  unsigned int *params);
+
+/* Find out the ids of all the HDF5 filters of a var, in the order
+ * they are applied to its chunks. */
+EXTERNL int
+nc_inq_var_filter_ids(int ncid, int varid, size_t *nfiltersp,
+                      unsigned int *ids);
+
 /* Set the fill mode (classic or 64-bit offset files only). */
 EXTERNL int
 nc_set_fill(int ncid, int fillmode, int *old_modep);
 
+/* Set how writes extend unlimited dimensions (netCDF-4 files only). */
+EXTERNL int
+nc_set_append_mode(int ncid, int mode, int *old_modep);
+
+/* Set whether the metadata index is written, for fast read-only opens
+ * (netCDF-4 files only). */
+EXTERNL int
+nc_set_metadata_index(int ncid, int flag, int *old_flagp);
+
+/* Find out whether the metadata index is written, and whether the
+ * metadata was read from it on open. */
+EXTERNL int
+nc_inq_metadata_index(int ncid, int *flagp, int *openedp);
+
 /* Set the default nc_create format to NC_FORMAT_CLASSIC,
  * NC_FORMAT_64BIT, NC_FORMAT_NETCDF4, etc */
 EXTERNL int
@@ -884,6 +1052,46 @@ nc_set_chunk_cache(size_t size, size_t nelems, float preemption);
 EXTERNL int
 nc_get_chunk_cache(size_t *sizep, size_t *nelemsp, float *preemptionp);
 
+/* Set the size of the cache of decoded chunks for point reads. */
+EXTERNL int
+nc_set_point_cache(size_t size);
+
+/* Get the size of the cache of decoded chunks for point reads. */
+EXTERNL int
+nc_get_point_cache(size_t *sizep);
+
+/* Set the size of the blocks HDF5 gathers small metadata into. */
+EXTERNL int
+nc_set_meta_block_size(size_t size);
+
+/* Get the size of the blocks HDF5 gathers small metadata into. */
+EXTERNL int
+nc_get_meta_block_size(size_t *sizep);
+
+/* Set the page size of new files, and the size of the page buffer. */
+EXTERNL int
+nc_set_page_strategy(size_t page_size, size_t buffer_size);
+
+/* Get the page size of new files, and the size of the page buffer. */
+EXTERNL int
+nc_get_page_strategy(size_t *page_sizep, size_t *buffer_sizep);
+
+/* Set the alignment of objects of at least threshold bytes. */
+EXTERNL int
+nc_set_alignment(size_t threshold, size_t alignment);
+
+/* Get the alignment of objects of at least threshold bytes. */
+EXTERNL int
+nc_get_alignment(size_t *thresholdp, size_t *alignmentp);
+
+/* Set the size of the HDF5 metadata cache. */
+EXTERNL int
+nc_set_metadata_cache(size_t size);
+
+/* Get the size of the HDF5 metadata cache. */
+EXTERNL int
+nc_get_metadata_cache(size_t *sizep);
+
 /* Set the per-variable cache size, nelems, and preemption policy. */
 EXTERNL int
 nc_set_var_chunk_cache(int ncid, int varid, size_t size, size_t nelems,
@@ -1222,6 +1430,138 @@ nc_get_var1_string(int ncid, int varid, const size_t *indexp,
 		   char **ip);
 
 /* End {put,get}_var1 */
+/* Begin get_var_points */
+
+/* Read the values at many scattered indices of a var. */
+EXTERNL int
+nc_get_var_points(int ncid, int varid, size_t npoints,
+		  const size_t *indexp, void *ip);
+
+EXTERNL int
+nc_get_var_points_text(int ncid, int varid, size_t npoints,
+                       const size_t *indexp, char *ip);
+
+EXTERNL int
+nc_get_var_points_uchar(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, unsigned char *ip);
+
+EXTERNL int
+nc_get_var_points_schar(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, signed char *ip);
+
+EXTERNL int
+nc_get_var_points_short(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, short *ip);
+
+EXTERNL int
+nc_get_var_points_int(int ncid, int varid, size_t npoints,
+                      const size_t *indexp, int *ip);
+
+EXTERNL int
+nc_get_var_points_long(int ncid, int varid, size_t npoints,
+                       const size_t *indexp, long *ip);
+
+EXTERNL int
+nc_get_var_points_float(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, float *ip);
+
+EXTERNL int
+nc_get_var_points_double(int ncid, int varid, size_t npoints,
+                         const size_t *indexp, double *ip);
+
+EXTERNL int
+nc_get_var_points_ubyte(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, unsigned char *ip);
+
+EXTERNL int
+nc_get_var_points_ushort(int ncid, int varid, size_t npoints,
+                         const size_t *indexp, unsigned short *ip);
+
+EXTERNL int
+nc_get_var_points_uint(int ncid, int varid, size_t npoints,
+                       const size_t *indexp, unsigned int *ip);
+
+EXTERNL int
+nc_get_var_points_longlong(int ncid, int varid, size_t npoints,
+                           const size_t *indexp, long long *ip);
+
+EXTERNL int
+nc_get_var_points_ulonglong(int ncid, int varid, size_t npoints,
+                            const size_t *indexp, unsigned long long *ip);
+
+EXTERNL int
+nc_get_var_points_string(int ncid, int varid, size_t npoints,
+                         const size_t *indexp, char **ip);
+
+/* End get_var_points */
+
+/* Read one field of the compound values of a hyperslab of a var,
+ * packed one after another. */
+EXTERNL int
+nc_get_vara_field(int ncid, int varid, int fieldid, const size_t *startp,
+                  const size_t *countp, void *ip);
+
+/* Read the strings or vlens of a hyperslab of a var into one block
+ * of memory, with the offset of each value in it. */
+EXTERNL int
+nc_get_vara_packed(int ncid, int varid, const size_t *startp,
+                   const size_t *countp, size_t *offsetsp, void **datap);
+
+/* Write the strings or vlens of a hyperslab of a var from one block
+ * of memory, with the offset of each value in it. */
+EXTERNL int
+nc_put_vara_packed(int ncid, int varid, const size_t *startp,
+                   const size_t *countp, const size_t *offsetsp,
+                   const void *data);
+
+/* Free the block of memory of a packed read. */
+EXTERNL int
+nc_free_packed(void *data);
+
+/* Begin get_vara_reduce */
+
+/* Reduce a hyperslab of a var over some of its dimensions, leaving
+ * out fill values and values outside the valid range. */
+EXTERNL int
+nc_get_vara_reduce(int ncid, int varid, const size_t *startp,
+                   const size_t *countp, const int *reducep, int op,
+                   double *resultp);
+
+/* End get_vara_reduce */
+/* Begin get_vara_unpack */
+
+/* Read a hyperslab of a CF packed var, applying scale_factor and
+ * add_offset, with fill, missing and out of range values as NaN. */
+EXTERNL int
+nc_get_vara_unpack_double(int ncid, int varid, const size_t *startp,
+                          const size_t *countp, double *ip);
+
+EXTERNL int
+nc_get_vara_unpack_float(int ncid, int varid, const size_t *startp,
+                         const size_t *countp, float *ip);
+
+/* End get_vara_unpack */
+/* Begin put_vara_pack */
+
+/* Give an integral var the scale_factor and add_offset that pack
+ * values from minval to maxval, where the first write can't choose
+ * them. */
+EXTERNL int
+nc_def_var_pack(int ncid, int varid, nc_type xtype, double minval,
+                double maxval);
+
+/* Write a hyperslab of a CF packed var, packing with its scale_factor
+ * and add_offset (computed from the data when it has neither), with
+ * NaNs as fill values. */
+EXTERNL int
+nc_put_vara_pack_double(int ncid, int varid, const size_t *startp,
+                        const size_t *countp, const double *op);
+
+EXTERNL int
+nc_put_vara_pack_float(int ncid, int varid, const size_t *startp,
+                       const size_t *countp, const float *op);
+
+/* End put_vara_pack */
 /* Begin {put,get}_vara */
 
 EXTERNL int
@@ -271,8 +271,10 @@ fprintf(stderr,"buildcachenode: new cache node: %s\n",
     if(!isprefetch) {
 	NCcache* cache = nccomm->cdf.cache;
 	if(cache->nodes == NULL) cache->nodes = nclistnew();
-	/* remove cache nodes to get below the max cache size */
-	while(cache->cachesize + cachenode->xdrsize > cache->cachelimit
+	/* remove cache nodes to get below the max cache size,
+	   and to make room within the memory budget */
+	while((cache->cachesize + cachenode->xdrsize > cache->cachelimit
+	       || cachenode->xdrsize > NC_memory_available())
 	      && nclistlength(cache->nodes) > 0) {
 	    NCcachenode* node = (NCcachenode*)nclistremove(cache->nodes,0);
 #ifdef DEBUG
@@ -280,6 +282,7 @@ fprintf(stderr,"buildcachenode: purge cache node: %s\n",
 	dumpcachenode(cachenode));
 #endif
 	    cache->cachesize -= node->xdrsize;
+	    NC_memory_release(NC_MEM_DAP_CACHE,node->xdrsize);
 	    freenccachenode(nccomm,node);
 	}
 	/* Remove cache nodes to get below the max cache count */
@@ -291,10 +294,12 @@ fprintf(stderr,"buildcachenode: count purge cache node: %s\n",
 	dumpcachenode(node));
 #endif
 	    cache->cachesize -= node->xdrsize;
+	    NC_memory_release(NC_MEM_DAP_CACHE,node->xdrsize);
 	    freenccachenode(nccomm,node);
         }
         nclistpush(nccomm->cdf.cache->nodes,(void*)cachenode);
         cache->cachesize += cachenode->xdrsize;
+        NC_memory_charge(NC_MEM_DAP_CACHE,cachenode->xdrsize);
     }
 
 #ifdef DEBUG
@@ -346,6 +351,7 @@ freenccache(NCDAPCOMMON* nccomm, NCcache* cache)
 	freenccachenode(nccomm,(NCcachenode*)nclistget(cache->nodes,i));
     }
     nclistfree(cache->nodes);
+    NC_memory_release(NC_MEM_DAP_CACHE,cache->cachesize);
     nullfree(cache);
 }
 
@@ -90,6 +90,27 @@ static int NCD2_get_vars(int ncid, int varid,
 	    const size_t *start, const size_t *edges, const ptrdiff_t* stride,
             void *value, nc_type memtype);
 
+static int NCD2_inq_io_stats(int ncid, nc_io_stats_t* statsp);
+static int NCD2_reset_io_stats(int ncid);
+static int NCD2_inq_memory_usage(int ncid, nc_memory_usage_t* usagep);
+static int NCD2_set_append_mode(int ncid, int mode, int* old_modep);
+static int NCD2_get_var_points(int ncid, int varid, size_t npoints,
+            const size_t* indexp, void* value, nc_type memtype);
+static int NCD2_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd);
+static int NCD2_inq_var_quantize(int ncid, int varid, int* quantize_modep, int* nsdp);
+static int NCD2_set_metadata_index(int ncid, int flag, int* old_flagp);
+static int NCD2_inq_metadata_index(int ncid, int* flagp, int* openedp);
+static int NCD2_get_chunk_raw(int ncid, int varid, const size_t* startp, unsigned int* filter_maskp, size_t* sizep, void* data);
+static int NCD2_put_chunk_raw(int ncid, int varid, const size_t* startp, unsigned int filter_mask, size_t size, const void* data);
+static int NCD2_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void* udata);
+static int NCD2_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void* udata);
+static int NCD2_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams, const unsigned int* params);
+static int NCD2_inq_var_filter(int ncid, int varid, unsigned int* idp, size_t* nparamsp, unsigned int* params);
+static int NCD2_get_vara_field(int ncid, int varid, int fieldid, const size_t* startp, const size_t* countp, void* data);
+static int NCD2_get_vara_packed(int ncid, int varid, const size_t* startp, const size_t* countp, size_t* offsetsp, void** datap);
+static int NCD2_put_vara_packed(int ncid, int varid, const size_t* startp, const size_t* countp, const size_t* offsetsp, const void* data);
+static int NCD2_inq_var_filter_ids(int ncid, int varid, size_t* nfiltersp, unsigned int* ids);
+
 static NC_Dispatch NCD2_dispatch_base = {
 
 NC_FORMATX_DAP2,
@@ -180,6 +201,31 @@ NCD2_get_var_chunk_cache,
 
 #endif /*USE_NETCDF4*/
 
+NCD2_inq_io_stats,
+NCD2_reset_io_stats,
+
+NCD2_inq_memory_usage,
+
+NCD2_set_append_mode,
+
+NCD2_get_var_points,
+
+NCD2_def_var_quantize,
+NCD2_inq_var_quantize,
+
+NCD2_set_metadata_index,
+NCD2_inq_metadata_index,
+NCD2_get_chunk_raw,
+NCD2_put_chunk_raw,
+NCD2_iter_chunks_raw,
+NCD2_iter_byte_ranges,
+NCD2_def_var_filter,
+NCD2_inq_var_filter,
+NCD2_get_vara_field,
+NCD2_get_vara_packed,
+NCD2_put_vara_packed,
+NCD2_inq_var_filter_ids,
+
 };
 
 NC_Dispatch* NCD2_dispatch_table = NULL; /* moved here from ddispatch.c */
@@ -244,6 +290,137 @@ NCD2_abort(int ncid)
     return NCD2_close(ncid);
 }
 
+/* The substrate file is an in-memory artifact; its I/O is not the user's */
+static int
+NCD2_inq_io_stats(int ncid, nc_io_stats_t* statsp)
+{
+    return NC_ENOTNC3;
+}
+
+static int
+NCD2_reset_io_stats(int ncid)
+{
+    return NC_ENOTNC3;
+}
+
+/* Only the data cache is reported; the substrate file is an open
+   file in its own right and so is counted in the global totals */
+static int
+NCD2_inq_memory_usage(int ncid, nc_memory_usage_t* usagep)
+{
+    NC* drno;
+    NCDAPCOMMON* dapcomm;
+    int ncstatus = NC_check_id(ncid, (NC**)&drno);
+    if(ncstatus != NC_NOERR) return THROW(ncstatus);
+    dapcomm = (NCDAPCOMMON*)drno->dispatchdata;
+    if(usagep) {
+        memset(usagep,0,sizeof(nc_memory_usage_t));
+        if(dapcomm->cdf.cache != NULL)
+            usagep->dap_cache = dapcomm->cdf.cache->cachesize;
+    }
+    return NC_NOERR;
+}
+
+static int
+NCD2_set_append_mode(int ncid, int mode, int* old_modep)
+{
+    return THROW(NC_EPERM);
+}
+
+static int
+NCD2_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd)
+{
+    return THROW(NC_EPERM);
+}
+
+static int
+NCD2_inq_var_quantize(int ncid, int varid, int* quantize_modep, int* nsdp)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+static int
+NCD2_set_metadata_index(int ncid, int flag, int* old_flagp)
+{
+    return THROW(NC_EPERM);
+}
+
+static int
+NCD2_inq_metadata_index(int ncid, int* flagp, int* openedp)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+static int
+NCD2_get_chunk_raw(int ncid, int varid, const size_t* startp,
+                   unsigned int* filter_maskp, size_t* sizep, void* data)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+static int
+NCD2_put_chunk_raw(int ncid, int varid, const size_t* startp,
+                   unsigned int filter_mask, size_t size, const void* data)
+{
+    return THROW(NC_EPERM);
+}
+
+static int
+NCD2_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void* udata)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+/* The data of a DAP dataset is not in a local file */
+static int
+NCD2_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void* udata)
+{
+    return THROW(NC_EINVAL);
+}
+
+static int
+NCD2_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+                    const unsigned int* params)
+{
+    return THROW(NC_EPERM);
+}
+
+static int
+NCD2_inq_var_filter(int ncid, int varid, unsigned int* idp, size_t* nparamsp,
+                    unsigned int* params)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+static int
+NCD2_get_vara_field(int ncid, int varid, int fieldid, const size_t* startp,
+                    const size_t* countp, void* data)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+static int
+NCD2_get_vara_packed(int ncid, int varid, const size_t* startp,
+                     const size_t* countp, size_t* offsetsp, void** datap)
+{
+    return THROW(NC_ENOTNC4);
+}
+
+static int
+NCD2_put_vara_packed(int ncid, int varid, const size_t* startp,
+                     const size_t* countp, const size_t* offsetsp,
+                     const void* data)
+{
+    return THROW(NC_EPERM);
+}
+
+static int
+NCD2_inq_var_filter_ids(int ncid, int varid, size_t* nfiltersp,
+                        unsigned int* ids)
+{
+    return THROW(NC_ENOTNC4);
+}
+
 static int
 NCD2_create(const char *path, int cmode,
            size_t initialsz, int basepe, size_t *chunksizehintp,
@@ -289,6 +466,145 @@ NCD2_get_vars(int ncid, int varid,
     return stat;
 }
 
+/* The most values fetched for one box of points */
+#define MAXPOINTBOX (1<<20)
+
+typedef struct Dappoint {
+    const size_t* index;
+    size_t point; /* which of the caller's points this is */
+    int rank;
+} Dappoint;
+
+static int
+dappointcmp(const void* a, const void* b)
+{
+    const Dappoint* pa = (const Dappoint*)a;
+    const Dappoint* pb = (const Dappoint*)b;
+    int i;
+    for(i=0;i<pa->rank;i++) {
+	if(pa->index[i] != pb->index[i])
+	    return (pa->index[i] < pb->index[i] ? -1 : 1);
+    }
+    return (pa->point < pb->point ? -1 : (pa->point > pb->point ? 1 : 0));
+}
+
+/* Fetch one box of points with a single constraint,
+   and scatter the values to where the points were given. */
+static int
+getpointbox(int ncid, int varid, int rank, Dappoint* points, size_t npoints,
+	    const size_t* start, const size_t* count,
+	    char* value, nc_type memtype, size_t memsize)
+{
+    int stat;
+    size_t i, boxsize = 1;
+    char* box;
+    int d;
+
+    for(d=0;d<rank;d++) boxsize *= count[d];
+    box = (char*)malloc(boxsize*memsize);
+    if(box == NULL) return THROW(NC_ENOMEM);
+    stat = nc3d_getvarx(ncid,varid,start,count,nc_ptrdiffvector1,box,memtype);
+    if(stat == NC_NOERR || stat == NC_ERANGE) {
+	for(i=0;i<npoints;i++) {
+	    size_t offset = 0;
+	    for(d=0;d<rank;d++)
+		offset = offset*count[d] + (points[i].index[d] - start[d]);
+	    memcpy(value+points[i].point*memsize,box+offset*memsize,memsize);
+	}
+    }
+    free(box);
+    return stat;
+}
+
+/*
+Read scattered points by fetching the bounding boxes of runs of the
+points, in index order, each with one constraint, rather than making
+a request per point. A box grows to cover the next point unless that
+would take it past MAXPOINTBOX values.
+*/
+static int
+NCD2_get_var_points(int ncid, int varid, size_t npoints,
+	    const size_t* indexp, void* value, nc_type memtype)
+{
+    NC* drno;
+    int stat, rank, d;
+    nc_type vartype;
+    int dimids[NC_MAX_VAR_DIMS];
+    size_t dimlens[NC_MAX_VAR_DIMS];
+    size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+    size_t newcount[NC_MAX_VAR_DIMS], newstart[NC_MAX_VAR_DIMS];
+    size_t i, first, memsize, boxsize;
+    Dappoint* points = NULL;
+    int status = NC_NOERR;
+
+    stat = NC_check_id(ncid, (NC**)&drno);
+    if(stat != NC_NOERR) return THROW(stat);
+    stat = nc_inq_var(getnc3id(drno),varid,NULL,&vartype,&rank,dimids,NULL);
+    if(stat != NC_NOERR) return THROW(stat);
+    if(memtype == NC_NAT) memtype = vartype;
+    if(npoints == 0 || rank == 0 || memtype > NC_MAX_ATOMIC_TYPE
+       || memtype == NC_STRING)
+	return NCDEFAULT_get_var_points(ncid,varid,npoints,indexp,value,memtype);
+    if((memtype == NC_CHAR) != (vartype == NC_CHAR))
+	return THROW(NC_ECHAR);
+    memsize = nctypesizeof(memtype);
+
+    for(d=0;d<rank;d++) {
+	stat = nc_inq_dimlen(getnc3id(drno),dimids[d],&dimlens[d]);
+	if(stat != NC_NOERR) return THROW(stat);
+    }
+
+    points = (Dappoint*)malloc(npoints*sizeof(Dappoint));
+    if(points == NULL) return THROW(NC_ENOMEM);
+    for(i=0;i<npoints;i++) {
+	points[i].index = indexp + i*(size_t)rank;
+	points[i].point = i;
+	points[i].rank = rank;
+	for(d=0;d<rank;d++) {
+	    if(points[i].index[d] >= dimlens[d])
+		{status = NC_EINVALCOORDS; goto done;}
+	}
+    }
+    qsort(points,npoints,sizeof(Dappoint),dappointcmp);
+
+    first = 0;
+    for(d=0;d<rank;d++) {start[d] = points[0].index[d]; count[d] = 1;}
+    for(i=1;i<=npoints;i++) {
+	if(i < npoints) {
+	    /* Try growing the box to cover this point */
+	    boxsize = 1;
+	    for(d=0;d<rank;d++) {
+		size_t lo = start[d], hi = start[d]+count[d];
+		size_t x = points[i].index[d];
+		if(x < lo) lo = x;
+		if(x+1 > hi) hi = x+1;
+		newstart[d] = lo;
+		newcount[d] = hi - lo;
+		boxsize *= newcount[d];
+	    }
+	    if(boxsize <= MAXPOINTBOX) {
+		memcpy(start,newstart,rank*sizeof(size_t));
+		memcpy(count,newcount,rank*sizeof(size_t));
+		continue;
+	    }
+	}
+	stat = getpointbox(ncid,varid,rank,points+first,i-first,start,count,
+			   (char*)value,memtype,memsize);
+	if(stat == NC_ERANGE)
+	    status = stat;
+	else if(stat != NC_NOERR)
+	    {status = stat; goto done;}
+	if(i < npoints) {
+	    first = i;
+	    for(d=0;d<rank;d++) {start[d] = points[i].index[d]; count[d] = 1;}
+	}
+    }
+
+done:
+    if(points != NULL) free(points);
+    return THROW(status);
+}
+
 /* See ncd2dispatch.c for other version */
 int
 NCD2_open(const char * path, int mode,
@@ -227,6 +227,220 @@ NC_find_equal_type(int ncid1, nc_type xtype1, int ncid2, nc_type *xtype2)
    return ret;
 }
 
+/* Find the byte order of a var, with native order resolved. */
+static int
+NC_var_endian(int ncid, int varid, int *endianp)
+{
+   int one = 1;
+   int ret;
+
+   if ((ret = nc_inq_var_endian(ncid, varid, endianp)))
+      return ret;
+   if (*endianp == NC_ENDIAN_NATIVE)
+      *endianp = *(char *)&one ? NC_ENDIAN_LITTLE : NC_ENDIAN_BIG;
+   return NC_NOERR;
+}
+
+/* Set *samep if two vars have the same filter pipeline: the same
+ * filters in the same order, as the filter masks of stored chunks
+ * have a bit for each place in it, and the same settings for each. */
+static int
+NC_same_var_filters(int ncid_in, int varid_in, int ncid_out, int varid_out,
+		    int *samep)
+{
+   int shuffle_in, deflate_in, level_in, shuffle_out, deflate_out, level_out;
+   size_t nfilters_in, nfilters_out, nparams_in, nparams_out;
+   unsigned int *ids = NULL, id_in, id_out, *params = NULL;
+   int same = 1, ret;
+
+   *samep = 0;
+   if ((ret = nc_inq_var_filter_ids(ncid_in, varid_in, &nfilters_in, NULL)))
+      return ret;
+   if ((ret = nc_inq_var_filter_ids(ncid_out, varid_out, &nfilters_out, NULL)))
+      return ret;
+   if (nfilters_in != nfilters_out)
+      return NC_NOERR;
+   if (nfilters_in)
+   {
+      if (!(ids = malloc(2 * nfilters_in * sizeof(unsigned int))))
+	 return NC_ENOMEM;
+      if (!(ret = nc_inq_var_filter_ids(ncid_in, varid_in, NULL, ids)) &&
+	  !(ret = nc_inq_var_filter_ids(ncid_out, varid_out, NULL,
+					ids + nfilters_in)))
+	 same = !memcmp(ids, ids + nfilters_in,
+			nfilters_in * sizeof(unsigned int));
+      free(ids);
+      if (ret || !same)
+	 return ret;
+   }
+
+   if ((ret = nc_inq_var_deflate(ncid_in, varid_in, &shuffle_in, &deflate_in,
+				 &level_in)))
+      return ret;
+   if ((ret = nc_inq_var_deflate(ncid_out, varid_out, &shuffle_out,
+				 &deflate_out, &level_out)))
+      return ret;
+   if (deflate_in && level_in != level_out)
+      return NC_NOERR;
+
+   if ((ret = nc_inq_var_filter(ncid_in, varid_in, &id_in, &nparams_in, NULL)))
+      return ret;
+   if ((ret = nc_inq_var_filter(ncid_out, varid_out, &id_out, &nparams_out,
+				NULL)))
+      return ret;
+   if (id_in != id_out || nparams_in != nparams_out)
+      return NC_NOERR;
+   if (nparams_in)
+   {
+      if (!(params = malloc(2 * nparams_in * sizeof(unsigned int))))
+	 return NC_ENOMEM;
+      if (!(ret = nc_inq_var_filter(ncid_in, varid_in, NULL, NULL, params)) &&
+	  !(ret = nc_inq_var_filter(ncid_out, varid_out, NULL, NULL,
+				    params + nparams_in)))
+	 same = !memcmp(params, params + nparams_in,
+			nparams_in * sizeof(unsigned int));
+      free(params);
+      if (ret || !same)
+	 return ret;
+   }
+   *samep = 1;
+   return NC_NOERR;
+}
+
+/* Set *samep if the copy of a var stores its chunks as the var does:
+ * with the same chunking, filters and byte order, so that the chunks
+ * can be copied as they are stored. */
+static int
+NC_same_var_storage(int ncid_in, int varid_in, int ncid_out, int varid_out,
+		    nc_type xtype, int ndims, int *samep)
+{
+   int storage_in, storage_out, options_mask, endian_in, endian_out, d;
+   size_t chunks_in[NC_MAX_VAR_DIMS], chunks_out[NC_MAX_VAR_DIMS];
+   int ret;
+
+   *samep = 0;
+
+   /* The chunks of strings and user types hold references to memory
+    * or other types, so only atomic types are copied as stored. */
+   if (xtype <= NC_NAT || xtype >= NC_STRING)
+      return NC_NOERR;
+
+   if ((ret = nc_inq_var_chunking(ncid_in, varid_in, &storage_in,
+				  chunks_in)))
+      return ret;
+   if ((ret = nc_inq_var_chunking(ncid_out, varid_out, &storage_out,
+				  chunks_out)))
+      return ret;
+   if (storage_in != NC_CHUNKED || storage_out != NC_CHUNKED)
+      return NC_NOERR;
+   for (d = 0; d < ndims; d++)
+      if (chunks_in[d] != chunks_out[d])
+	 return NC_NOERR;
+
+   /* Szip can be read, but not written. */
+   if ((ret = nc_inq_var_szip(ncid_in, varid_in, &options_mask, NULL)))
+      return ret;
+   if (options_mask)
+      return NC_NOERR;
+
+   if ((ret = NC_var_endian(ncid_in, varid_in, &endian_in)))
+      return ret;
+   if ((ret = NC_var_endian(ncid_out, varid_out, &endian_out)))
+      return ret;
+   if (endian_in != endian_out)
+      return NC_NOERR;
+
+   return NC_same_var_filters(ncid_in, varid_in, ncid_out, varid_out, samep);
+}
+
+/* Where the stored chunks of a var are copied to. */
+typedef struct NC_chunk_copy
+{
+   int ncid_in, varid_in, ncid_out, varid_out;
+   void *buf;
+   size_t buf_size;
+   size_t nstored;
+} NC_chunk_copy;
+
+static int
+NC_count_chunk(const size_t *startp, unsigned int filter_mask, size_t size,
+	       void *udata)
+{
+   ((NC_chunk_copy *)udata)->nstored++;
+   return NC_NOERR;
+}
+
+static int
+NC_copy_chunk(const size_t *startp, unsigned int filter_mask, size_t size,
+	      void *udata)
+{
+   NC_chunk_copy *c = udata;
+   int ret;
+
+   if (size > c->buf_size)
+   {
+      void *buf;
+      if (!(buf = realloc(c->buf, size)))
+	 return NC_ENOMEM;
+      c->buf = buf;
+      c->buf_size = size;
+   }
+   if ((ret = nc_get_chunk_raw(c->ncid_in, c->varid_in, startp, &filter_mask,
+			       &size, c->buf)))
+      return ret;
+   return nc_put_chunk_raw(c->ncid_out, c->varid_out, startp, filter_mask,
+			   size, c->buf);
+}
+
+/* Copy the stored chunks of a var to a var with the same chunking and
+ * filters, without decompressing them. Set *copiedp if this was done;
+ * it can't be if the library was built without direct chunk I/O, or
+ * if some chunks are not stored and the output var is not filled, so
+ * that they would not read as fill values. */
+static int
+NC_copy_var_chunks(int ncid_in, int varid_in, int ncid_out, int varid_out,
+		   int ndims, const size_t *dimlen, int *copiedp)
+{
+   NC_chunk_copy c;
+   size_t chunks[NC_MAX_VAR_DIMS], index[NC_MAX_VAR_DIMS], nchunks = 1;
+   unsigned long long value;
+   int storage, no_fill, d, ret;
+
+   *copiedp = 0;
+   memset(&c, 0, sizeof(c));
+   c.ncid_in = ncid_in;
+   c.varid_in = varid_in;
+   c.ncid_out = ncid_out;
+   c.varid_out = varid_out;
+   if ((ret = nc_iter_chunks_raw(ncid_in, varid_in, NC_count_chunk, &c)))
+      return ret == NC_ENOTBUILT ? NC_NOERR : ret;
+
+   if ((ret = nc_inq_var_chunking(ncid_in, varid_in, &storage, chunks)))
+      return ret;
+   for (d = 0; d < ndims; d++)
+      nchunks *= (dimlen[d] + chunks[d] - 1) / chunks[d];
+   if ((ret = nc_inq_var_fill(ncid_out, varid_out, &no_fill, NULL)))
+      return ret;
+   if (no_fill && c.nstored < nchunks)
+      return NC_NOERR;
+
+   /* Extend any unlimited dims of the output var over the data, by
+    * writing its last value. */
+   for (d = 0; d < ndims; d++)
+      index[d] = dimlen[d] - 1;
+   if ((ret = nc_get_var1(ncid_in, varid_in, index, &value)))
+      return ret;
+   if ((ret = nc_put_var1(ncid_out, varid_out, index, &value)))
+      return ret;
+
+   ret = nc_iter_chunks_raw(ncid_in, varid_in, NC_copy_chunk, &c);
+   free(c.buf);
+   if (ret)
+      return ret;
+   *copiedp = 1;
+   return NC_NOERR;
+}
+
 #endif /* USE_NETCDF4 */
 
 /* This will copy a variable that is an array of primitive type and
@@ -248,6 +462,11 @@ NC_find_equal_type(int ncid1, nc_type xtype1, int ncid2, nc_type *xtype2)
    result in moving data for other variables in the target file. This
    is not a problem for netCDF-4 files, which support efficient
    addition of variables without moving data for other variables.
+
+   Between netCDF-4 files, the new variable gets the default chunking
+   and filters, as any new variable does. If they happen to be those
+   of the variable copied, its chunks are copied as they are stored,
+   without decompressing and compressing them again.
 */
 int
 nc_copy_var(int ncid_in, int varid_in, int ncid_out)
@@ -268,6 +487,9 @@ nc_copy_var(int ncid_in, int varid_in, int ncid_out)
    char type_name[NC_MAX_NAME+1];
    char dimname_in[NC_MAX_NAME + 1];
    int i;
+#ifdef USE_NETCDF4
+   int raw = 0, copied;
+#endif
 
    /* Learn about this var. */
    if ((retval = nc_inq_var(ncid_in, varid_in, name, &xtype,
@@ -328,6 +550,18 @@ nc_copy_var(int ncid_in, int varid_in, int ncid_out)
    nc_enddef(ncid_out);
    nc_sync(ncid_out);
 
+#ifdef USE_NETCDF4
+   /* Between netCDF-4 files, the chunks are copied as they are stored
+    * if the new var happens to store them the same way. */
+   if ((src_format == NC_FORMAT_NETCDF4 ||
+        src_format == NC_FORMAT_NETCDF4_CLASSIC) &&
+       (dest_format == NC_FORMAT_NETCDF4 ||
+        dest_format == NC_FORMAT_NETCDF4_CLASSIC) && ndims)
+      if ((retval = NC_same_var_storage(ncid_in, varid_in, ncid_out,
+                                        varid_out, xtype, ndims, &raw)))
+         BAIL(retval);
+#endif
+
    /* Allocate memory for our start and count arrays. If ndims = 0
       this is a scalar, which I will treat as a 1-D array with one
       element. */
@@ -374,6 +608,20 @@ nc_copy_var(int ncid_in, int varid_in, int ncid_out)
    if (!dimlen[0])
       goto exit;
 
+#ifdef USE_NETCDF4
+   if (raw)
+   {
+      for (d = 0; d < ndims; d++)
+         if (!dimlen[d])
+            goto exit;
+      if ((retval = NC_copy_var_chunks(ncid_in, varid_in, ncid_out,
+                                       varid_out, ndims, dimlen, &copied)))
+         BAIL(retval);
+      if (copied)
+         goto exit;
+   }
+#endif
+
    /* Allocate memory for one record. */
    if (!(data = malloc(reclen * type_size))) {
      if(count) free(count);
@@ -53,6 +53,7 @@ NCDISPATCH_initialize(void)
 	NC_coord_one[i] = 1;
 	NC_coord_zero[i] = 0;
     }
+    status = NC_trace_initialize();
     return status;
 }
 
@@ -61,6 +62,7 @@ NCDISPATCH_finalize(void)
 {
     int status = NC_NOERR;
     int i;
+    status = NC_trace_finalize();
     return status;
 }
 
@@ -150,6 +152,17 @@ NC_urlmodel(const char* path)
     struct NCPROTOCOLLIST* protolist;
 
     model = NC_FORMATX_DAP2;
+#ifdef ENABLE_BYTERANGE
+    /* A url with the client parameter mode=bytes refers to a
+       classic file read directly using byte-range requests */
+    if(ncuriparse(path,&tmpurl)) {
+	const char* mode = NULL;
+	if(ncurilookup(tmpurl,"mode",&mode) && mode != NULL
+	   && strcmp(mode,"bytes") == 0)
+	    model = NC_FORMATX_NC3;
+	ncurifree(tmpurl);
+    }
+#endif
     return model;
 }
 
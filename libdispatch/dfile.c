@@ -826,6 +826,60 @@ nc_inq_path(int ncid, size_t *pathlen, char *path)
    return stat;
 }
 
+/** \ingroup datasets
+Get the I/O counters of an open classic format file.
+
+The counters record the region requests made of the I/O layer, the
+read, write and seek system calls these caused, the bytes moved, the
+number of read-modify-write cycles, buffer hits and misses, and the
+cumulative time spent in each I/O operation since the file was opened
+or since the last call to nc_reset_io_stats(). They are cheap to keep
+and may be queried at any time, so an application can look for
+pathological access patterns in production.
+
+\param ncid NetCDF ID, from a previous call to nc_open() or
+nc_create().
+
+\param statsp Pointer to an nc_io_stats_t where the counters will be
+copied. Ignored if NULL.
+
+\returns ::NC_NOERR No error.
+
+\returns ::NC_EBADID Invalid ncid passed.
+
+\returns ::NC_ENOTNC3 Not a classic format file; netCDF-4, DAP and
+parallel-netcdf files do not keep I/O counters.
+*/
+int
+nc_inq_io_stats(int ncid, nc_io_stats_t *statsp)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->inq_io_stats(ncid, statsp);
+}
+
+/** \ingroup datasets
+Zero the I/O counters of an open classic format file.
+
+\param ncid NetCDF ID, from a previous call to nc_open() or
+nc_create().
+
+\returns ::NC_NOERR No error.
+
+\returns ::NC_EBADID Invalid ncid passed.
+
+\returns ::NC_ENOTNC3 Not a classic format file.
+*/
+int
+nc_reset_io_stats(int ncid)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->reset_io_stats(ncid);
+}
+
 /** \ingroup datasets
 Put open netcdf dataset into define mode
 
@@ -1345,6 +1399,191 @@ nc_set_fill(int ncid, int fillmode, int *old_modep)
    return ncp->dispatch->set_fill(ncid,fillmode,old_modep);
 }
 
+/**
+Set the append mode for a netCDF-4 dataset open for writing.
+
+By default, a write past the end of an unlimited dimension extends
+the HDF5 datasets involved to exactly the new length. A program that
+appends one record at a time therefore pays for a dataset extension
+on every write.
+
+In ::NC_APPEND_GEOMETRIC mode the datasets are instead over-allocated,
+at least doubling their extent each time they must grow. The true
+length of each unlimited dimension is kept by the library, so the
+extra space is never visible through the netCDF interfaces of the
+program writing the file. The datasets are trimmed back to their true
+extent by nc_sync(), nc_close() and nc_abort(), so that other programs
+see only the records written; the first append after an nc_sync()
+over-allocates again. A program that ends without any of these
+leaves the extra records in the file, where they read as fill values;
+call nc_sync() as often as other programs must see a consistent file.
+
+The mode applies to the dataset as a whole, and lasts until it is
+changed again or the dataset is closed. It is not supported for
+files opened for parallel I/O.
+
+\param ncid NetCDF ID, from a previous call to nc_open() or
+nc_create().
+
+\param mode Desired append mode for the dataset, either
+::NC_APPEND_EXACT or ::NC_APPEND_GEOMETRIC.
+
+\param old_modep Pointer to location for returned current append mode
+of the dataset before this call. Ignored if NULL.
+
+\returns ::NC_NOERR No error.
+
+\returns ::NC_EBADID The specified netCDF ID does not refer to an open
+netCDF dataset.
+
+\returns ::NC_ENOTNC4 The dataset is not a netCDF-4 file.
+
+\returns ::NC_EPERM The specified netCDF ID refers to a dataset open for
+read-only access.
+
+\returns ::NC_EINVAL The mode argument is neither ::NC_APPEND_EXACT nor
+::NC_APPEND_GEOMETRIC, or the dataset is open for parallel I/O.
+
+<h1>Example</h1>
+
+Here is an example using nc_set_append_mode() to speed up writing a
+time series one record at a time:
+
+\code
+     #include <netcdf.h>
+        ...
+     int ncid, status;
+        ...
+     status = nc_open("foo.nc", NC_WRITE, &ncid);
+     if (status != NC_NOERR) handle_error(status);
+
+     status = nc_set_append_mode(ncid, NC_APPEND_GEOMETRIC, NULL);
+     if (status != NC_NOERR) handle_error(status);
+
+        ...    append records
+
+     status = nc_close(ncid);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+ */
+int
+nc_set_append_mode(int ncid, int mode, int *old_modep)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->set_append_mode(ncid,mode,old_modep);
+}
+
+/**
+Turn the metadata index of a netCDF-4 dataset open for writing on or
+off.
+
+To open a netCDF-4 file, the library normally reads every group,
+dataset, named type and attribute in it. For files with many
+variables, or on filesystems where each small read is costly, this
+can take much longer than reading the data of interest.
+
+With the index turned on, nc_sync() and nc_close() also write all the
+metadata of the dataset into one hidden dataset of the root
+group. When the file is later opened read-only, the metadata is built
+from the index, in one read, and the datasets of variables are only
+opened when their data is first read. Files opened for writing keep an
+index they have up to date.
+
+The index is ignored, and the file read the usual way, if the size of
+the file, or the number of links or of attributes of its root group,
+has changed since the index was written. Other changes made with HDF5
+by a program that does not maintain the index are not detected: such a
+program should delete the _NCMetadataIndex dataset of the root group,
+or the index must not be trusted.
+
+Files with variable-length types, attributes of types with values of
+variable size, or variables of such types with a fill value, are not
+indexed; nor are files opened for parallel I/O.
+
+\param ncid NetCDF ID, from a previous call to nc_open() or
+nc_create().
+
+\param flag Non-zero to write the index, zero to remove it from the
+file.
+
+\param old_flagp Pointer to location for returned setting before
+this call. Ignored if NULL.
+
+\returns ::NC_NOERR No error.
+
+\returns ::NC_EBADID The specified netCDF ID does not refer to an open
+netCDF dataset.
+
+\returns ::NC_ENOTNC4 The dataset is not a netCDF-4 file.
+
+\returns ::NC_EPERM The specified netCDF ID refers to a dataset open for
+read-only access.
+
+\returns ::NC_EINVAL The dataset is open for parallel I/O.
+
+<h1>Example</h1>
+
+Here is an example using nc_set_metadata_index() to index a file as
+it is created:
+
+\code
+     #include <netcdf.h>
+        ...
+     int ncid, status;
+        ...
+     status = nc_create("foo.nc", NC_NETCDF4, &ncid);
+     if (status != NC_NOERR) handle_error(status);
+
+     status = nc_set_metadata_index(ncid, 1, NULL);
+     if (status != NC_NOERR) handle_error(status);
+
+        ...    define and write variables
+
+     status = nc_close(ncid);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+ */
+int
+nc_set_metadata_index(int ncid, int flag, int *old_flagp)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->set_metadata_index(ncid,flag,old_flagp);
+}
+
+/**
+Learn about the metadata index of a netCDF-4 dataset.
+
+\param ncid NetCDF ID, from a previous call to nc_open() or
+nc_create().
+
+\param flagp Pointer to location for returned setting of
+nc_set_metadata_index(): 1 if the index is written when the dataset
+is synced or closed, 0 if not. Ignored if NULL.
+
+\param openedp Pointer to location for returned 1 if the metadata of
+the dataset was read from the index when it was opened, 0 if it was
+read from the objects in the file. Ignored if NULL.
+
+\returns ::NC_NOERR No error.
+
+\returns ::NC_EBADID The specified netCDF ID does not refer to an open
+netCDF dataset.
+
+\returns ::NC_ENOTNC4 The dataset is not a netCDF-4 file.
+ */
+int
+nc_inq_metadata_index(int ncid, int *flagp, int *openedp)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->inq_metadata_index(ncid,flagp,openedp);
+}
+
 /**
 \internal
 
@@ -1757,6 +1996,9 @@ NC_create(const char *path, int cmode, size_t initialsz,
 	 return NC_ENOTNC;
    }
 
+   if(NC_tracing)
+      dispatcher = NC_trace_wrap(dispatcher);
+
    /* Create the NC* instance and insert its dispatcher */
    stat = new_NC(dispatcher,path,cmode,&ncp);
    if(stat) return stat;
@@ -1915,6 +2157,9 @@ NC_open(const char *path, int cmode,
 
 havetable:
 
+   if(NC_tracing)
+      dispatcher = NC_trace_wrap(dispatcher);
+
    /* Create the NC* instance and insert its dispatcher */
    stat = new_NC(dispatcher,path,cmode,&ncp);
    if(stat) return stat;
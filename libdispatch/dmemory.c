@@ -0,0 +1,168 @@
+/** \file dmemory.c
+
+Memory accounting and the process-wide memory budget.
+
+The chunk caches of netCDF-4 variables, the DAP2 data caches and the
+I/O buffers of classic files (including the images of in-memory
+files) charge the memory they hold to the counters kept here. When a
+budget has been set with nc_set_memory_budget(), new caches and
+buffers are shrunk so that together they stay within it.
+
+Copyright 2016 University Corporation for Atmospheric
+Research/Unidata. See COPYRIGHT file for more info.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "ncdispatch.h"
+
+/* 0 => no budget */
+static size_t nc_memory_budget = 0;
+
+/* Bytes currently charged, by category */
+static size_t nc_memory_used[NC_MEM_NCATEGORIES];
+
+static size_t
+memory_used(void)
+{
+    size_t total = 0;
+    int i;
+    for(i=0;i<NC_MEM_NCATEGORIES;i++)
+	total += nc_memory_used[i];
+    return total;
+}
+
+/* Bytes that may still be charged before the budget is exhausted;
+   (size_t)-1 if there is no budget. */
+size_t
+NC_memory_available(void)
+{
+    size_t used;
+    if(nc_memory_budget == 0)
+	return (size_t)-1;
+    used = memory_used();
+    return (used < nc_memory_budget ? nc_memory_budget - used : 0);
+}
+
+/* Charge up to want bytes to a category and return the amount
+   charged: want itself if the budget allows it, otherwise whatever is
+   left of the budget, but never less than floor. */
+size_t
+NC_memory_grant(int category, size_t want, size_t floor)
+{
+    size_t avail = NC_memory_available();
+    if(want > avail)
+	want = (avail > floor ? avail : floor);
+    NC_memory_charge(category,want);
+    return want;
+}
+
+/* Charge memory that cannot be shrunk, whatever the budget. */
+void
+NC_memory_charge(int category, size_t n)
+{
+    if(category >= 0 && category < NC_MEM_NCATEGORIES)
+	nc_memory_used[category] += n;
+}
+
+void
+NC_memory_release(int category, size_t n)
+{
+    if(category < 0 || category >= NC_MEM_NCATEGORIES)
+	return;
+    if(n > nc_memory_used[category])
+	n = nc_memory_used[category];
+    nc_memory_used[category] -= n;
+}
+
+/** \ingroup datasets
+Get the memory held by the library for a file, or for the whole
+process.
+
+For a single file, the chunk caches of its variables, its I/O buffers
+and an estimate of its in-memory metadata are reported; for a DAP2
+url, the data cache. If ncid is ::NC_GLOBAL, the figures are the
+totals over all open files, which is what nc_set_memory_budget()
+limits (metadata excepted).
+
+\param ncid NetCDF ID, from a previous call to nc_open() or
+nc_create(), or ::NC_GLOBAL.
+
+\param usagep Pointer to an nc_memory_usage_t where the figures will
+be copied. Ignored if NULL.
+
+\returns ::NC_NOERR No error.
+
+\returns ::NC_EBADID Invalid ncid passed.
+*/
+int
+nc_inq_memory_usage(int ncid, nc_memory_usage_t *usagep)
+{
+    nc_memory_usage_t usage, fileusage;
+    NC* ncp;
+    int stat = NC_NOERR;
+
+    memset(&usage,0,sizeof(usage));
+    if(ncid == NC_GLOBAL) {
+	int i, nfiles = count_NCList(), found = 0;
+	usage.chunk_cache = nc_memory_used[NC_MEM_CHUNK_CACHE];
+	usage.dap_cache = nc_memory_used[NC_MEM_DAP_CACHE];
+	usage.io_buffers = nc_memory_used[NC_MEM_IO_BUFFERS];
+	/* Metadata is not charged as it is built, so ask every file. */
+	for(i=1;found < nfiles && iterate_NCList(i,&ncp) == NC_NOERR;i++) {
+	    if(ncp == NULL) continue;
+	    found++;
+	    memset(&fileusage,0,sizeof(fileusage));
+	    if(ncp->dispatch->inq_memory_usage(ncp->ext_ncid,&fileusage) == NC_NOERR)
+		usage.metadata += fileusage.metadata;
+	}
+    } else {
+	stat = NC_check_id(ncid, &ncp);
+	if(stat != NC_NOERR) return stat;
+	stat = ncp->dispatch->inq_memory_usage(ncid,&usage);
+	if(stat != NC_NOERR) return stat;
+    }
+    usage.total = usage.chunk_cache + usage.dap_cache
+		  + usage.io_buffers + usage.metadata;
+    if(usagep) *usagep = usage;
+    return NC_NOERR;
+}
+
+/** \ingroup datasets
+Set a memory budget for the whole process.
+
+The chunk caches of netCDF-4 variables, the DAP2 data caches and the
+I/O buffers of classic files are then sized so that together they do
+not exceed the budget: a chunk cache gets whatever is left of the
+budget when its variable is created or opened, a DAP2 cache evicts
+entries to make room, and classic files use smaller buffers, down to
+a minimum block. An in-memory (diskless) file is refused with
+::NC_ENOMEM if its image does not fit when it is opened. Memory
+already held when the budget is set or lowered is not taken back.
+
+\param budget Budget in bytes, or 0 for no budget (the default).
+
+\returns ::NC_NOERR No error.
+*/
+int
+nc_set_memory_budget(size_t budget)
+{
+    nc_memory_budget = budget;
+    return NC_NOERR;
+}
+
+/** \ingroup datasets
+Get the memory budget.
+
+\param budgetp Pointer that gets the budget in bytes, 0 if there is
+none. Ignored if NULL.
+
+\returns ::NC_NOERR No error.
+*/
+int
+nc_inq_memory_budget(size_t *budgetp)
+{
+    if(budgetp) *budgetp = nc_memory_budget;
+    return NC_NOERR;
+}
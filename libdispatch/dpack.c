@@ -0,0 +1,594 @@
+/** \file dpack.c
+
+Writes that pack CF packed variables.
+
+nc_put_vara_pack_double() and nc_put_vara_pack_float() are the
+inverse of nc_get_vara_unpack_double(): the values are packed with the
+scale_factor and add_offset attributes of the variable (computed from
+the range of the data of the first write when it has neither, or
+given a range by nc_def_var_pack()), rounded, clamped to the valid
+range and converted to the type of the variable a tile at a time with
+NC_write_tiles(), with NaNs written as the fill value. There is no
+second pass over the data and no temporary the size of the request.
+
+Copyright 2016 University Corporation for Atmospheric
+Research/Unidata. See COPYRIGHT file for more info.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ncdispatch.h"
+
+/* Size of the working buffer, in bytes. */
+#define NC_PACK_BUFFER (1024 * 1024)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2_PACK
+#include <emmintrin.h>
+#endif
+
+/* How values are packed: (value - offset) * inv, rounded when the
+ * var is of an integral type, clamped to [lo, hi], with NaN as
+ * fill. Values beyond [lo - slack, hi + slack] are range errors. */
+typedef struct NC_pack {
+    double inv;
+    double offset;
+    double fill;
+    double lo;
+    double hi;
+    double slack;
+    int integral;
+    int fast;
+} NC_pack;
+
+/* A packing kernel converts n values to the type of the var, setting
+ * *erange if any was out of range. */
+typedef void (*NC_PACK_FN)(const void *src, void *dest, size_t n,
+			   const NC_pack *p, int *erange);
+
+/* Values are packed into doubles a step at a time, into a buffer
+ * that stays in L1, and then narrowed to the type of the var. */
+#define PACK_STEP 256
+
+/* Adding and taking away 1.5 * 2^52 rounds to the nearest integer,
+ * ties to even, for values of magnitude below 2^51. */
+#define ROUND_MAGIC 6755399441055744.0
+
+static double
+pack_value(double v, const NC_pack *p, int *erange)
+{
+    double x;
+
+    if (v != v)
+	return p->fill;
+    x = (v - p->offset) * p->inv;
+    if (x < p->lo - p->slack || x > p->hi + p->slack)
+	*erange = 1;
+    if (x < p->lo)
+	x = p->lo;
+    else if (x > p->hi)
+	x = p->hi;
+    return p->integral ? rint(x) : x;
+}
+
+#ifdef USE_SSE2_PACK
+#define APPLY_SETUP							\
+    const __m128d inv = _mm_set1_pd(p->inv);				\
+    const __m128d offset = _mm_set1_pd(p->offset);			\
+    const __m128d fill = _mm_set1_pd(p->fill);				\
+    const __m128d lo = _mm_set1_pd(p->lo);				\
+    const __m128d hi = _mm_set1_pd(p->hi);				\
+    const __m128d lo_slack = _mm_set1_pd(p->lo - p->slack);		\
+    const __m128d hi_slack = _mm_set1_pd(p->hi + p->slack);		\
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);			\
+    __m128d bad = _mm_setzero_pd()
+
+/* Two values at a time, clamped before rounding so that the magic
+ * number rounding holds (p->fast is only set when [lo, hi] is small
+ * enough); NaNs become fill by masking. */
+#define APPLY_SSE2(v, r)						\
+    do {								\
+	__m128d ok = _mm_cmpord_pd(v, v);				\
+	__m128d t = _mm_mul_pd(_mm_sub_pd(v, offset), inv);		\
+	bad = _mm_or_pd(bad, _mm_or_pd(_mm_cmplt_pd(t, lo_slack),	\
+				       _mm_cmpgt_pd(t, hi_slack)));	\
+	t = _mm_min_pd(_mm_max_pd(t, lo), hi);				\
+	r = _mm_sub_pd(_mm_add_pd(t, magic), magic);			\
+	r = _mm_or_pd(_mm_and_pd(ok, r), _mm_andnot_pd(ok, fill));	\
+    } while (0)
+
+static void
+apply_double(const double *v, double *q, size_t n, const NC_pack *p,
+	     int *erange)
+{
+    APPLY_SETUP;
+    size_t i = 0;
+
+    if (p->fast) {
+	for (; i + 2 <= n; i += 2) {
+	    __m128d x = _mm_loadu_pd(v + i), r;
+	    APPLY_SSE2(x, r);
+	    _mm_storeu_pd(q + i, r);
+	}
+	if (_mm_movemask_pd(bad))
+	    *erange = 1;
+    }
+    for (; i < n; i++)
+	q[i] = pack_value(v[i], p, erange);
+}
+
+static void
+apply_float(const float *v, double *q, size_t n, const NC_pack *p,
+	    int *erange)
+{
+    APPLY_SETUP;
+    size_t i = 0;
+
+    if (p->fast) {
+	for (; i + 4 <= n; i += 4) {
+	    __m128 f = _mm_loadu_ps(v + i);
+	    __m128d a = _mm_cvtps_pd(f), b = _mm_cvtps_pd(_mm_movehl_ps(f, f));
+	    __m128d ra, rb;
+	    APPLY_SSE2(a, ra);
+	    APPLY_SSE2(b, rb);
+	    _mm_storeu_pd(q + i, ra);
+	    _mm_storeu_pd(q + i + 2, rb);
+	}
+	if (_mm_movemask_pd(bad))
+	    *erange = 1;
+    }
+    for (; i < n; i++)
+	q[i] = pack_value(v[i], p, erange);
+}
+#else
+static void
+apply_double(const double *v, double *q, size_t n, const NC_pack *p,
+	     int *erange)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	q[i] = pack_value(v[i], p, erange);
+}
+
+static void
+apply_float(const float *v, double *q, size_t n, const NC_pack *p,
+	    int *erange)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	q[i] = pack_value(v[i], p, erange);
+}
+#endif /* USE_SSE2_PACK */
+
+#define PACK(name, stype, dtype)					\
+static void								\
+pack_##name(const void *src, void *dest, size_t n, const NC_pack *p,	\
+	    int *erange)						\
+{									\
+    const stype *sp = (const stype *)src;				\
+    dtype *dp = (dtype *)dest;						\
+    double q[PACK_STEP];						\
+    size_t i, j, m;							\
+									\
+    for (i = 0; i < n; i += m) {					\
+	m = n - i < PACK_STEP ? n - i : PACK_STEP;			\
+	apply_##stype(sp + i, q, m, p, erange);				\
+	for (j = 0; j < m; j++)						\
+	    dp[i + j] = (dtype)q[j];					\
+    }									\
+}
+
+PACK(double_schar, double, signed char)
+PACK(double_uchar, double, unsigned char)
+PACK(double_short, double, short)
+PACK(double_ushort, double, unsigned short)
+PACK(double_int, double, int)
+PACK(double_uint, double, unsigned int)
+PACK(double_longlong, double, long long)
+PACK(double_ulonglong, double, unsigned long long)
+PACK(double_float, double, float)
+PACK(double_double, double, double)
+PACK(float_schar, float, signed char)
+PACK(float_uchar, float, unsigned char)
+PACK(float_short, float, short)
+PACK(float_ushort, float, unsigned short)
+PACK(float_int, float, int)
+PACK(float_uint, float, unsigned int)
+PACK(float_longlong, float, long long)
+PACK(float_ulonglong, float, unsigned long long)
+PACK(float_float, float, float)
+PACK(float_double, float, double)
+
+/* The kernels, indexed by the type of the variable. */
+static const NC_PACK_FN pack_double[NC_MAX_ATOMIC_TYPE] = {
+    NULL,
+    pack_double_schar,		/* NC_BYTE */
+    NULL,			/* NC_CHAR */
+    pack_double_short,		/* NC_SHORT */
+    pack_double_int,		/* NC_INT */
+    pack_double_float,		/* NC_FLOAT */
+    pack_double_double,		/* NC_DOUBLE */
+    pack_double_uchar,		/* NC_UBYTE */
+    pack_double_ushort,		/* NC_USHORT */
+    pack_double_uint,		/* NC_UINT */
+    pack_double_longlong,	/* NC_INT64 */
+    pack_double_ulonglong	/* NC_UINT64 */
+};
+
+static const NC_PACK_FN pack_float[NC_MAX_ATOMIC_TYPE] = {
+    NULL,
+    pack_float_schar,		/* NC_BYTE */
+    NULL,			/* NC_CHAR */
+    pack_float_short,		/* NC_SHORT */
+    pack_float_int,		/* NC_INT */
+    pack_float_float,		/* NC_FLOAT */
+    pack_float_double,		/* NC_DOUBLE */
+    pack_float_uchar,		/* NC_UBYTE */
+    pack_float_ushort,		/* NC_USHORT */
+    pack_float_uint,		/* NC_UINT */
+    pack_float_longlong,	/* NC_INT64 */
+    pack_float_ulonglong	/* NC_UINT64 */
+};
+
+/* The range of each integral type, the ends of the 64-bit types
+ * pulled in to the nearest doubles that convert back. */
+static void
+type_range(nc_type xtype, double *lo, double *hi)
+{
+    switch (xtype) {
+    case NC_BYTE: *lo = -128; *hi = 127; break;
+    case NC_UBYTE: *lo = 0; *hi = 255; break;
+    case NC_SHORT: *lo = -32768; *hi = 32767; break;
+    case NC_USHORT: *lo = 0; *hi = 65535; break;
+    case NC_INT: *lo = -2147483648.0; *hi = 2147483647.0; break;
+    case NC_UINT: *lo = 0; *hi = 4294967295.0; break;
+    case NC_INT64: *lo = -9223372036854775808.0; *hi = 9223372036854774784.0; break;
+    case NC_UINT64: *lo = 0; *hi = 18446744073709549568.0; break;
+    default: *lo = -HUGE_VAL; *hi = HUGE_VAL; break;
+    }
+}
+
+/* The packed values the data may take: the valid range within the
+ * range of the type, leaving out the fill value when it is at one
+ * end (as the default fill values are). */
+static void
+packed_range(nc_type xtype, const NC_unpack *u, double *lo, double *hi)
+{
+    type_range(xtype, lo, hi);
+    if (u->lo > *lo)
+	*lo = ceil(u->lo);
+    if (u->hi < *hi)
+	*hi = floor(u->hi);
+    if (xtype != NC_FLOAT && xtype != NC_DOUBLE) {
+	if (u->fill == *lo || u->fill == *lo + 1)
+	    *lo = u->fill + 1;
+	else if (u->fill == *hi || u->fill == *hi - 1)
+	    *hi = u->fill - 1;
+    }
+}
+
+/* Put a packing attribute in the memory type. */
+static int
+put_pack_att(int ncid, int varid, const char *name, nc_type memtype,
+	     double value)
+{
+    float fvalue = (float)value;
+    const void *vp = memtype == NC_FLOAT ? (const void *)&fvalue : (const void *)&value;
+
+    return nc_put_att(ncid, varid, name, memtype, 1, vp);
+}
+
+/* Put packing attributes, in the type atttype, that map [vmin, vmax]
+ * onto the packed range of an integral var. */
+static int
+put_packing(int ncid, int varid, nc_type xtype, nc_type atttype,
+	    const NC_unpack *u, double vmin, double vmax)
+{
+    double lo, hi, scale;
+    int stat;
+
+    packed_range(xtype, u, &lo, &hi);
+    scale = (vmax > vmin && hi > lo) ? (vmax - vmin) / (hi - lo) : 1;
+    if ((stat = put_pack_att(ncid, varid, "scale_factor", atttype, scale)))
+	return stat;
+    return put_pack_att(ncid, varid, "add_offset", atttype, vmin - lo * scale);
+}
+
+/* Give an integral var without scale_factor or add_offset packing
+ * attributes that map the range of the data onto its packed range,
+ * in the memory type. Data with no finite values leaves it alone.
+ * Define mode is not entered: where the format needs it to add
+ * attributes, this fails with NC_ENOTINDEFINE. */
+static int
+def_packing(int ncid, int varid, nc_type xtype, nc_type memtype,
+	    const NC_unpack *u, const void *op, size_t n)
+{
+    double vmin = HUGE_VAL, vmax = -HUGE_VAL;
+    size_t i;
+
+    if (memtype == NC_FLOAT) {
+	const float *fp = (const float *)op;
+	for (i = 0; i < n; i++)
+	    if (fp[i] - fp[i] == 0) {
+		if (fp[i] < vmin)
+		    vmin = fp[i];
+		if (fp[i] > vmax)
+		    vmax = fp[i];
+	    }
+    } else {
+	const double *dp = (const double *)op;
+	for (i = 0; i < n; i++)
+	    if (dp[i] - dp[i] == 0) {
+		if (dp[i] < vmin)
+		    vmin = dp[i];
+		if (dp[i] > vmax)
+		    vmax = dp[i];
+	    }
+    }
+    if (vmin > vmax)
+	return NC_NOERR;
+    return put_packing(ncid, varid, xtype, memtype, u, vmin, vmax);
+}
+
+/* The state of a packing write. */
+typedef struct NC_PACK {
+    NC_PACK_FN fn;
+    const NC_pack *p;
+    int ndims;
+    const size_t *istride;
+    const char *src;
+    size_t size;
+    int erange;
+} NC_PACK;
+
+/* Pack a row of a tile from where it is in the data. */
+static void
+pack_row(void *ctx, void *values, size_t n, const size_t *rel)
+{
+    NC_PACK *pk = (NC_PACK *)ctx;
+    size_t offset = 0;
+    int d;
+
+    for (d = 0; d < pk->ndims; d++)
+	offset += rel[d] * pk->istride[d];
+    pk->fn(pk->src + offset * pk->size, values, n, pk->p, &pk->erange);
+}
+
+static int
+NC_put_vara_pack(int ncid, int varid, const size_t *startp,
+		 const size_t *countp, const void *op, nc_type memtype)
+{
+    NC_unpack u;
+    NC_pack p;
+    NC_PACK pk;
+    size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+    size_t shape[NC_MAX_VAR_DIMS], istride[NC_MAX_VAR_DIMS], n = 1;
+    nc_type xtype;
+    int ndims, d, stat, natts = 0;
+
+    if ((stat = nc_inq_var(ncid, varid, NULL, &xtype, &ndims, NULL, NULL)))
+	return stat;
+    if ((stat = NC_get_unpack(ncid, varid, xtype, &u)))
+	return stat;
+    if ((stat = NC_getshape(ncid, varid, ndims, shape)))
+	return stat;
+    for (d = 0; d < ndims; d++) {
+	start[d] = startp ? startp[d] : 0;
+	if (countp)
+	    count[d] = countp[d];
+	else
+	    count[d] = start[d] < shape[d] ? shape[d] - start[d] : 0;
+    }
+    for (d = ndims - 1; d >= 0; d--) {
+	istride[d] = n;
+	n *= count[d];
+    }
+
+    /* An integral var with neither attribute gets them from the data
+     * of its first write. */
+    if (xtype != NC_FLOAT && xtype != NC_DOUBLE) {
+	if (nc_inq_attid(ncid, varid, "scale_factor", NULL) == NC_NOERR)
+	    natts++;
+	if (nc_inq_attid(ncid, varid, "add_offset", NULL) == NC_NOERR)
+	    natts++;
+	if (!natts) {
+	    if ((stat = def_packing(ncid, varid, xtype, memtype, &u, op, n)))
+		return stat;
+	    if ((stat = NC_get_unpack(ncid, varid, xtype, &u)))
+		return stat;
+	}
+    }
+
+    p.inv = 1 / u.scale;
+    p.offset = u.offset;
+    p.fill = u.fill;
+    packed_range(xtype, &u, &p.lo, &p.hi);
+    p.integral = xtype != NC_FLOAT && xtype != NC_DOUBLE;
+    p.slack = p.integral ? 0.5 : 0;
+    p.fast = p.integral && p.lo >= -2251799813685248.0 &&
+	p.hi <= 2251799813685248.0;
+
+    pk.fn = memtype == NC_FLOAT ? pack_float[xtype] : pack_double[xtype];
+    pk.p = &p;
+    pk.ndims = ndims;
+    pk.istride = istride;
+    pk.src = (const char *)op;
+    pk.size = memtype == NC_FLOAT ? sizeof(float) : sizeof(double);
+    pk.erange = 0;
+    if ((stat = NC_write_tiles(ncid, varid, xtype, NC_PACK_BUFFER, start, count,
+			       pack_row, &pk)))
+	return stat;
+    return pk.erange ? NC_ERANGE : NC_NOERR;
+}
+
+/** \name Packing and Writing Packed Variables
+
+Functions to pack data as the CF conventions describe, and write a
+hyperslab of a variable with it. */
+/** \{ */
+/** \ingroup variables
+Give a variable of an integral type the scale_factor and add_offset
+attributes that pack values from \p minval to \p maxval.
+
+The attributes map [\p minval, \p maxval] onto the whole range of
+packed values of the variable: the range of its type, within its
+valid_range attribute (or its valid_min and valid_max attributes),
+leaving out its fill value when that is at one end. Any _FillValue
+and valid range attributes must therefore be defined first. Like any
+new attribute, they must be defined in define mode for the classic
+formats and the classic model; call this with nc_def_var(), before
+nc_enddef(). Without them, nc_put_vara_pack_double() computes them
+from the data of its first write instead, where the format allows.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be of an integral type.
+
+\param xtype Type of the attributes, ::NC_FLOAT or ::NC_DOUBLE; it
+should be the type of the unpacked data.
+
+\param minval The smallest value to be packed.
+
+\param maxval The largest value to be packed.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EBADTYPE The variable is not of an integral type, or \p
+xtype is neither ::NC_FLOAT nor ::NC_DOUBLE.
+\returns ::NC_EINVAL \p minval and \p maxval are not finite, or \p
+minval is greater than \p maxval, or a masking attribute of the
+variable is not numeric or has the wrong number of values.
+\returns ::NC_ENOTINDEFINE Not in define mode, for a classic format
+file.
+\returns ::NC_EPERM The file is read-only.
+\returns ::NC_EBADID Bad ncid.
+*/
+int
+nc_def_var_pack(int ncid, int varid, nc_type xtype, double minval,
+		double maxval)
+{
+    NC_unpack u;
+    nc_type vtype;
+    int stat;
+
+    if (xtype != NC_FLOAT && xtype != NC_DOUBLE)
+	return NC_EBADTYPE;
+    if (!(minval - minval == 0 && maxval - maxval == 0 && minval <= maxval))
+	return NC_EINVAL;
+    if ((stat = nc_inq_vartype(ncid, varid, &vtype)))
+	return stat;
+    if (vtype == NC_FLOAT || vtype == NC_DOUBLE)
+	return NC_EBADTYPE;
+    if ((stat = NC_get_unpack(ncid, varid, vtype, &u)))
+	return stat;
+
+    return put_packing(ncid, varid, vtype, xtype, &u, minval, maxval);
+}
+
+/** \ingroup variables
+Pack a hyperslab of data and write it to a variable.
+
+Each value is packed by subtracting the add_offset attribute of the
+variable and dividing by its scale_factor attribute (either may be
+absent), rounded to the nearest integer if the variable is of an
+integral type, and converted to the type of the variable. NaNs are
+written as the _FillValue attribute (or, without one, the default
+fill value of the type of the variable). Packed values outside the
+valid_range attribute (or the valid_min and valid_max attributes), or
+outside the range of the type of the variable, are clamped to it, and
+::NC_ERANGE is returned once the whole hyperslab is written.
+
+If the variable is of an integral type and has neither a scale_factor
+nor an add_offset attribute, both are computed from the range of the
+finite values written, so that they cover the whole range of packed
+values except the fill value, and added to the variable in the type
+of \p op. The first write should therefore cover the range of all the
+data. Define mode is not entered to add them: in the classic formats
+and the classic model, which need it for new attributes, the variable
+must be given them when it is defined, by hand or with
+nc_def_var_pack(), or the write fails with ::NC_ENOTINDEFINE.
+
+The packing is done as each tile of the hyperslab is converted to the
+type of the variable, so the data is read once and needs no temporary
+the size of the request.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be of a numeric type.
+
+\param startp Start index vector, or NULL for the start of the
+variable.
+
+\param countp Count vector, or NULL for the rest of the variable from
+\p startp.
+
+\param op Pointer to the values to pack and write.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_ERANGE A value was out of range and was clamped.
+\returns ::NC_EINDEFINE Operation not allowed in define mode.
+\returns ::NC_ENOTINDEFINE The variable is of an integral type and has
+neither a scale_factor nor an add_offset attribute, and the format
+needs define mode to add them. Nothing is written.
+\returns ::NC_EPERM The file is read-only.
+\returns ::NC_ECHAR The variable is of type char.
+\returns ::NC_EBADTYPE The variable is not of a numeric type.
+\returns ::NC_EINVAL A packing or masking attribute of the variable is
+not numeric or has the wrong number of values.
+\returns ::NC_ENOMEM Out of memory.
+\returns ::NC_EBADID Bad ncid.
+
+\section nc_put_vara_pack_double_example Example
+
+Here is an example that packs temperatures into a [time][lat][lon]
+variable of shorts in a netCDF-4 file, letting the first write choose
+its scale_factor and add_offset:
+
+\code
+     #include <netcdf.h>
+        ...
+     int  status, ncid, varid, dimids[3];
+     size_t start[3] = {0, 0, 0}, count[3] = {1, NLAT, NLON};
+     double t[NLAT][NLON];
+        ...
+     status = nc_def_var(ncid, "t", NC_SHORT, 3, dimids, &varid);
+     if (status != NC_NOERR) handle_error(status);
+     status = nc_enddef(ncid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_put_vara_pack_double(ncid, varid, start, count, &t[0][0]);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+*/
+int
+nc_put_vara_pack_double(int ncid, int varid, const size_t *startp,
+			const size_t *countp, const double *op)
+{
+    return NC_put_vara_pack(ncid, varid, startp, countp, (const void *)op,
+			    NC_DOUBLE);
+}
+
+/** \ingroup variables
+Pack a hyperslab of floats and write it to a variable. See
+nc_put_vara_pack_double(); the packing is done in double precision,
+and computed packing attributes are floats.
+*/
+int
+nc_put_vara_pack_float(int ncid, int varid, const size_t *startp,
+		       const size_t *countp, const float *op)
+{
+    return NC_put_vara_pack(ncid, varid, startp, countp, (const void *)op,
+			    NC_FLOAT);
+}
+/** \} */
@@ -0,0 +1,392 @@
+/** \file dreduce.c
+
+Reductions of variables computed while the data is read.
+
+nc_get_vara_reduce() streams a hyperslab through a working buffer of
+fixed size with NC_read_tiles() and folds each row of each tile into
+the result, so that summaries of variables far larger than memory
+never need the whole hyperslab in memory.
+
+Copyright 2016 University Corporation for Atmospheric
+Research/Unidata. See COPYRIGHT file for more info.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ncdispatch.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2_REDUCE
+#include <emmintrin.h>
+#endif
+
+/* Size of the working buffer, in bytes. */
+#define NC_REDUCE_BUFFER (1024 * 1024)
+
+/* Which values count: those that are not the fill or a missing value
+ * and are within [lo, hi]. Unused missing values are NaNs, which
+ * nothing equals; NaNs in the data fail the range test. */
+#define VALID(m, v) NC_UNPACK_VALID(m, v)
+
+/* The state of a reduction. */
+typedef struct NC_REDUCE {
+    const NC_unpack *mask;
+    int op;
+    int ndims;
+    const size_t *rstride;
+    double *res;
+    unsigned long long *cnt;
+} NC_REDUCE;
+
+/* Fold a run of n values into one result cell. Each kernel returns
+ * the number of valid values in the run. */
+
+#ifdef USE_SSE2_REDUCE
+static size_t
+run_sum(const NC_unpack *m, const double *v, size_t n, double *res)
+{
+    const __m128d fill = _mm_set1_pd(m->fill);
+    const __m128d missing[NC_UNPACK_MAX_MISSING] = {
+	_mm_set1_pd(m->missing[0]), _mm_set1_pd(m->missing[1]),
+	_mm_set1_pd(m->missing[2]), _mm_set1_pd(m->missing[3])};
+    const __m128d lo = _mm_set1_pd(m->lo);
+    const __m128d hi = _mm_set1_pd(m->hi);
+    __m128d sum = _mm_setzero_pd();
+    double tail = 0;
+    size_t i, nvalid = 0;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+	__m128d x = _mm_loadu_pd(v + i);
+	__m128d ok = _mm_and_pd(_mm_cmpneq_pd(x, fill),
+				_mm_and_pd(_mm_cmpge_pd(x, lo), _mm_cmple_pd(x, hi)));
+	int k, mm;
+	for (k = 0; k < m->nmissing; k++)
+	    ok = _mm_and_pd(ok, _mm_cmpneq_pd(x, missing[k]));
+	mm = _mm_movemask_pd(ok);
+	sum = _mm_add_pd(sum, _mm_and_pd(ok, x));
+	nvalid += (size_t)((mm & 1) + (mm >> 1));
+    }
+    for (; i < n; i++) {
+	int ok = VALID(m, v[i]);
+	tail += ok ? v[i] : 0;
+	nvalid += (size_t)ok;
+    }
+    {
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	*res += lanes[0] + lanes[1] + tail;
+    }
+    return nvalid;
+}
+
+/* The invalid values are replaced by +inf for the minimum and -inf
+ * for the maximum, which leave the result as it is. */
+static size_t
+run_minmax(const NC_unpack *m, const double *v, size_t n, double *res,
+	   int max)
+{
+    const __m128d fill = _mm_set1_pd(m->fill);
+    const __m128d missing[NC_UNPACK_MAX_MISSING] = {
+	_mm_set1_pd(m->missing[0]), _mm_set1_pd(m->missing[1]),
+	_mm_set1_pd(m->missing[2]), _mm_set1_pd(m->missing[3])};
+    const __m128d lo = _mm_set1_pd(m->lo);
+    const __m128d hi = _mm_set1_pd(m->hi);
+    const __m128d none = _mm_set1_pd(max ? -HUGE_VAL : HUGE_VAL);
+    __m128d acc = _mm_set1_pd(*res);
+    double r = *res, lanes[2];
+    size_t i, nvalid = 0;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+	__m128d x = _mm_loadu_pd(v + i);
+	__m128d ok = _mm_and_pd(_mm_cmpneq_pd(x, fill),
+				_mm_and_pd(_mm_cmpge_pd(x, lo), _mm_cmple_pd(x, hi)));
+	int k, mm;
+	for (k = 0; k < m->nmissing; k++)
+	    ok = _mm_and_pd(ok, _mm_cmpneq_pd(x, missing[k]));
+	mm = _mm_movemask_pd(ok);
+	x = _mm_or_pd(_mm_and_pd(ok, x), _mm_andnot_pd(ok, none));
+	acc = max ? _mm_max_pd(acc, x) : _mm_min_pd(acc, x);
+	nvalid += (size_t)((mm & 1) + (mm >> 1));
+    }
+    _mm_storeu_pd(lanes, acc);
+    if (max) {
+	r = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+	for (; i < n; i++)
+	    if (VALID(m, v[i])) {
+		nvalid++;
+		if (v[i] > r)
+		    r = v[i];
+	    }
+    } else {
+	r = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+	for (; i < n; i++)
+	    if (VALID(m, v[i])) {
+		nvalid++;
+		if (v[i] < r)
+		    r = v[i];
+	    }
+    }
+    *res = r;
+    return nvalid;
+}
+#else
+static size_t
+run_sum(const NC_unpack *m, const double *v, size_t n, double *res)
+{
+    double s0 = 0, s1 = 0;
+    size_t i, n0 = 0, n1 = 0;
+
+    /* Two independent sums, so that the adds can overlap. */
+    for (i = 0; i + 2 <= n; i += 2) {
+	int ok0 = VALID(m, v[i]), ok1 = VALID(m, v[i + 1]);
+	s0 += ok0 ? v[i] : 0;
+	s1 += ok1 ? v[i + 1] : 0;
+	n0 += (size_t)ok0;
+	n1 += (size_t)ok1;
+    }
+    for (; i < n; i++) {
+	int ok = VALID(m, v[i]);
+	s0 += ok ? v[i] : 0;
+	n0 += (size_t)ok;
+    }
+    *res += s0 + s1;
+    return n0 + n1;
+}
+
+static size_t
+run_minmax(const NC_unpack *m, const double *v, size_t n, double *res,
+	   int max)
+{
+    double r = *res;
+    size_t i, nvalid = 0;
+
+    for (i = 0; i < n; i++) {
+	int ok = VALID(m, v[i]);
+	nvalid += (size_t)ok;
+	if (ok && (max ? v[i] > r : v[i] < r))
+	    r = v[i];
+    }
+    *res = r;
+    return nvalid;
+}
+#endif /* USE_SSE2_REDUCE */
+
+/* Fold n values, each into its own result cell, stride cells
+ * apart. */
+static void
+fold_each(const NC_unpack *m, int op, const double *v, size_t n,
+	  double *res, unsigned long long *cnt, size_t stride)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++, res += stride, cnt += stride) {
+	double x = v[i];
+	if (!VALID(m, x))
+	    continue;
+	(*cnt)++;
+	switch (op) {
+	case NC_REDUCE_MIN:
+	    if (x < *res)
+		*res = x;
+	    break;
+	case NC_REDUCE_MAX:
+	    if (x > *res)
+		*res = x;
+	    break;
+	default:
+	    *res += x;
+	    break;
+	}
+    }
+}
+
+/* Fold a run of n values into one result cell. */
+static void
+fold_run(const NC_unpack *m, int op, const double *v, size_t n,
+	 double *res, unsigned long long *cnt)
+{
+    switch (op) {
+    case NC_REDUCE_MIN:
+	*cnt += run_minmax(m, v, n, res, 0);
+	break;
+    case NC_REDUCE_MAX:
+	*cnt += run_minmax(m, v, n, res, 1);
+	break;
+    default:
+	*cnt += run_sum(m, v, n, res);
+	break;
+    }
+}
+
+/* Fold a row of a tile into the result. */
+static void
+fold_row(void *ctx, const void *values, size_t n, const size_t *rel)
+{
+    NC_REDUCE *rd = (NC_REDUCE *)ctx;
+    size_t cell = 0;
+    int d;
+
+    for (d = 0; d < rd->ndims; d++)
+	cell += rel[d] * rd->rstride[d];
+    if (rd->ndims && rd->rstride[rd->ndims - 1])
+	fold_each(rd->mask, rd->op, (const double *)values, n, rd->res + cell,
+		  rd->cnt + cell, rd->rstride[rd->ndims - 1]);
+    else
+	fold_run(rd->mask, rd->op, (const double *)values, n, rd->res + cell,
+		 rd->cnt + cell);
+}
+
+/** \ingroup variables
+Reduce a hyperslab of a variable over some of its dimensions.
+
+The minimum, maximum, sum, mean or number of the valid values of the
+hyperslab is computed along the dimensions selected by \p reducep,
+while the data is read: the hyperslab is read a tile at a time into a
+working buffer of fixed size (1 MB), so it never has to fit in
+memory. Tiles of chunked variables are aligned with the chunks, so
+each chunk is read only once.
+
+A value is left out if it equals the _FillValue attribute of the
+variable (or, without one, the default fill value of its type) or one
+of the values of its missing_value attribute, if it lies outside the valid_range attribute (or the valid_min and
+valid_max attributes), or if it is a NaN. Packed values are reduced
+as they are stored; scale_factor and add_offset are not applied.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be of a numeric type.
+
+\param startp Start index vector, or NULL for the start of the
+variable.
+
+\param countp Count vector, or NULL for the rest of the variable from
+\p startp.
+
+\param reducep A flag for each dimension: nonzero if the result is
+reduced along that dimension. If NULL, the variable is reduced along
+all of them, to a single value.
+
+\param op One of ::NC_REDUCE_MIN, ::NC_REDUCE_MAX, ::NC_REDUCE_SUM,
+::NC_REDUCE_MEAN or ::NC_REDUCE_COUNT.
+
+\param resultp Where the result is stored: one value for each element
+of the hyperslab of the dimensions not reduced, in the usual order.
+Cells without any valid values have a minimum, maximum and mean of
+::NC_FILL_DOUBLE, a sum of 0 and a count of 0.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_ECHAR The variable is of type char.
+\returns ::NC_EBADTYPE The variable is not of a numeric type.
+\returns ::NC_EINVAL Unknown reduction, or one of the masking
+attributes is not numeric or has the wrong number of values.
+\returns ::NC_ENOMEM Out of memory.
+\returns ::NC_EBADID Bad ncid.
+
+\section nc_get_vara_reduce_example Example
+
+Here is an example of the daily mean of a [time][lat][lon] variable
+over the whole grid:
+
+\code
+     #include <netcdf.h>
+        ...
+     int  status, ncid, varid;
+     int reduce[3] = {0, 1, 1};
+     double means[NDAYS];
+        ...
+     status = nc_open("foo.nc", NC_NOWRITE, &ncid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_inq_varid (ncid, "tas", &varid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_get_vara_reduce(ncid, varid, NULL, NULL, reduce,
+                                 NC_REDUCE_MEAN, means);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+*/
+int
+nc_get_vara_reduce(int ncid, int varid, const size_t *startp,
+		   const size_t *countp, const int *reducep, int op,
+		   double *resultp)
+{
+    NC_unpack mask;
+    NC_REDUCE rd;
+    size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+    size_t shape[NC_MAX_VAR_DIMS], rstride[NC_MAX_VAR_DIMS];
+    size_t nres = 1, r;
+    unsigned long long *cnt;
+    nc_type xtype;
+    int ndims, d, stat;
+
+    if (op < NC_REDUCE_MIN || op > NC_REDUCE_COUNT)
+	return NC_EINVAL;
+    if ((stat = nc_inq_var(ncid, varid, NULL, &xtype, &ndims, NULL, NULL)))
+	return stat;
+    if ((stat = NC_get_unpack(ncid, varid, xtype, &mask)))
+	return stat;
+
+    /* The hyperslab, and the strides of its dimensions in the
+     * result. */
+    if ((stat = NC_getshape(ncid, varid, ndims, shape)))
+	return stat;
+    for (d = 0; d < ndims; d++) {
+	start[d] = startp ? startp[d] : 0;
+	if (countp)
+	    count[d] = countp[d];
+	else
+	    count[d] = start[d] < shape[d] ? shape[d] - start[d] : 0;
+    }
+    for (d = ndims - 1; d >= 0; d--) {
+	if (reducep && !reducep[d]) {
+	    rstride[d] = nres;
+	    nres *= count[d];
+	} else
+	    rstride[d] = 0;
+    }
+
+    if (!(cnt = calloc(nres ? nres : 1, sizeof(unsigned long long))))
+	return NC_ENOMEM;
+    for (r = 0; r < nres; r++)
+	resultp[r] = op == NC_REDUCE_MIN ? HUGE_VAL :
+	    op == NC_REDUCE_MAX ? -HUGE_VAL : 0;
+
+    rd.mask = &mask;
+    rd.op = op;
+    rd.ndims = ndims;
+    rd.rstride = rstride;
+    rd.res = resultp;
+    rd.cnt = cnt;
+    if ((stat = NC_read_tiles(ncid, varid, NC_DOUBLE, NC_REDUCE_BUFFER, start,
+			      count, fold_row, &rd)))
+	goto done;
+
+    for (r = 0; r < nres; r++) {
+	switch (op) {
+	case NC_REDUCE_MIN:
+	case NC_REDUCE_MAX:
+	    if (!cnt[r])
+		resultp[r] = NC_FILL_DOUBLE;
+	    break;
+	case NC_REDUCE_MEAN:
+	    resultp[r] = cnt[r] ? resultp[r] / (double)cnt[r] : NC_FILL_DOUBLE;
+	    break;
+	case NC_REDUCE_COUNT:
+	    resultp[r] = (double)cnt[r];
+	    break;
+	default:
+	    break;
+	}
+    }
+
+done:
+    free(cnt);
+    return stat;
+}
@@ -0,0 +1,174 @@
+/** \file dtiles.c
+
+Streaming a hyperslab through a small buffer.
+
+NC_read_tiles() reads a hyperslab one tile at a time into a working
+buffer of fixed size and hands the rows of each tile to a callback,
+so that functions that fold or transform the data as it is read
+(nc_get_vara_reduce(), nc_get_vara_unpack_double()) never hold the
+whole hyperslab in memory. NC_write_tiles() is the other way round:
+the callback fills the rows of each tile, which is then written
+(nc_put_vara_pack_double()). Tiles of chunked netCDF-4 variables are
+made of whole chunks, aligned with the chunks, so that each chunk is
+read and decoded, or encoded and written, once.
+
+Copyright 2016 University Corporation for Atmospheric
+Research/Unidata. See COPYRIGHT file for more info.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "ncdispatch.h"
+
+/* Choose the shape of the tiles read: the largest with at most cap
+ * values, growing from the innermost dimension out. For a chunked var
+ * every side is a multiple of the chunk side, unless it covers the
+ * whole request, so that no chunk is split between tiles. */
+static void
+tile_shape(int ndims, const size_t *count, const size_t *chunks,
+	   size_t cap, size_t *tile)
+{
+    size_t prod = 1, others, n;
+    int d;
+
+    for (d = 0; d < ndims; d++) {
+	tile[d] = chunks ? chunks[d] : 1;
+	if (tile[d] > count[d])
+	    tile[d] = count[d];
+	prod *= tile[d];
+    }
+    for (d = ndims - 1; d >= 0; d--) {
+	size_t base = chunks ? chunks[d] : 1;
+	others = prod / tile[d];
+	n = cap / others;
+	n -= n % base;
+	if (n > count[d])
+	    n = count[d];
+	if (n > tile[d]) {
+	    prod = others * n;
+	    tile[d] = n;
+	}
+    }
+}
+
+/* Walk the tiles of a hyperslab. For a read, each tile is read and
+ * then its rows handed to get_row(); for a write, put_row() fills its
+ * rows and then it is written. */
+static int
+walk_tiles(int ncid, int varid, nc_type memtype, size_t bufsize,
+	   const size_t *start, const size_t *count,
+	   NC_tile_row_fn get_row, NC_tile_fill_fn put_row, void *ctx)
+{
+    NC *ncp;
+    size_t tile[NC_MAX_VAR_DIMS], pos[NC_MAX_VAR_DIMS], edge[NC_MAX_VAR_DIMS];
+    size_t rel[NC_MAX_VAR_DIMS], k[NC_MAX_VAR_DIMS];
+    size_t *chunks = NULL, memsize, cap, nvals = 1, run, r, nrows;
+    char *buf;
+    int ndims, d, stat;
+#ifdef USE_NETCDF4
+    size_t chunksizes[NC_MAX_VAR_DIMS];
+    int storage;
+#endif
+
+    if ((stat = NC_check_id(ncid, &ncp)))
+	return stat;
+    if ((stat = nc_inq_varndims(ncid, varid, &ndims)))
+	return stat;
+    if ((stat = nc_inq_type(ncid, memtype, NULL, &memsize)))
+	return stat;
+    for (d = 0; d < ndims; d++)
+	nvals *= count[d];
+    if (!nvals)
+	return NC_NOERR;
+    if ((cap = bufsize / memsize) == 0)
+	cap = 1;
+
+#ifdef USE_NETCDF4
+    if (ndims && nc_inq_var_chunking(ncid, varid, &storage, chunksizes) == NC_NOERR &&
+	storage == NC_CHUNKED) {
+	size_t chunk_vals = 1;
+	for (d = 0; d < ndims; d++)
+	    chunk_vals *= chunksizes[d];
+	if (chunk_vals <= cap)
+	    chunks = chunksizes;
+    }
+#endif
+    tile_shape(ndims, count, chunks, cap, tile);
+    if (!(buf = malloc(cap * memsize)))
+	return NC_ENOMEM;
+
+    /* Walk the tiles, outermost dimension slowest. A chunked var's
+     * tiles start on multiples of the tile shape, so the first and
+     * last along a dimension may be short. */
+    for (d = 0; d < ndims; d++)
+	pos[d] = start[d];
+    for (;;) {
+	for (d = 0; d < ndims; d++) {
+	    size_t end = start[d] + count[d];
+	    size_t next = (chunks && tile[d] < count[d]) ?
+		(pos[d] / tile[d] + 1) * tile[d] : pos[d] + tile[d];
+	    edge[d] = (next < end ? next : end) - pos[d];
+	}
+	if (get_row &&
+	    (stat = ncp->dispatch->get_vara(ncid, varid, pos, edge, buf, memtype)))
+	    break;
+
+	/* Hand over each row of the tile along its innermost
+	 * dimension. */
+	run = ndims ? edge[ndims - 1] : 1;
+	for (nrows = 1, d = 0; d < ndims - 1; d++) {
+	    nrows *= edge[d];
+	    k[d] = 0;
+	}
+	if (ndims)
+	    rel[ndims - 1] = pos[ndims - 1] - start[ndims - 1];
+	for (r = 0; r < nrows; r++) {
+	    for (d = 0; d < ndims - 1; d++)
+		rel[d] = pos[d] - start[d] + k[d];
+	    if (get_row)
+		get_row(ctx, buf + r * run * memsize, run, rel);
+	    else
+		put_row(ctx, buf + r * run * memsize, run, rel);
+	    for (d = ndims - 2; d >= 0; d--) {
+		if (++k[d] < edge[d])
+		    break;
+		k[d] = 0;
+	    }
+	}
+	if (put_row &&
+	    (stat = ncp->dispatch->put_vara(ncid, varid, pos, edge, buf, memtype)))
+	    break;
+
+	/* On to the next tile. */
+	for (d = ndims - 1; d >= 0; d--) {
+	    pos[d] += edge[d];
+	    if (pos[d] < start[d] + count[d])
+		break;
+	    pos[d] = start[d];
+	}
+	if (d < 0)
+	    break;
+    }
+
+    free(buf);
+    return stat;
+}
+
+int
+NC_read_tiles(int ncid, int varid, nc_type memtype, size_t bufsize,
+	      const size_t *start, const size_t *count,
+	      NC_tile_row_fn row, void *ctx)
+{
+    return walk_tiles(ncid, varid, memtype, bufsize, start, count,
+		      row, NULL, ctx);
+}
+
+int
+NC_write_tiles(int ncid, int varid, nc_type memtype, size_t bufsize,
+	       const size_t *start, const size_t *count,
+	       NC_tile_fill_fn row, void *ctx)
+{
+    return walk_tiles(ncid, varid, memtype, bufsize, start, count,
+		      NULL, row, ctx);
+}
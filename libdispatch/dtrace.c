@@ -0,0 +1,898 @@
+/** \file dtrace.c
+
+Dispatch-layer tracing.
+
+When the environment variable NETCDF_TRACE (or NETCDF_TRACE_JSON) is
+set at library initialization, every file that is subsequently opened
+or created gets a tracing dispatch table that wraps the real one. Each
+wrapper times the underlying call and records, per dispatch entry, the
+number of calls, the number of errors, the total and maximum latency
+and a histogram of latencies in power-of-two buckets of nanoseconds.
+
+NETCDF_TRACE=1 writes the summary to stderr at exit (or at
+nc_finalize()); any other value except 0 is taken as the name of a
+file to write the summary to. NETCDF_TRACE_JSON=path additionally
+streams every call as a Chrome trace event ("ph":"X") in the JSON
+array format, which chrome://tracing and Perfetto load directly.
+
+When neither variable is set the real tables are used unchanged, so
+tracing costs nothing.
+
+Copyright 2016 University Corporation for Atmospheric
+Research/Unidata. See COPYRIGHT file for more info.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include "nc.h"
+#include "ncdispatch.h"
+
+#define NCTRACEENV "NETCDF_TRACE"
+#define NCTRACEJSONENV "NETCDF_TRACE_JSON"
+
+/* Bucket b holds latencies in [2^b,2^(b+1)) nanoseconds;
+   bucket 0 also holds anything under 1ns */
+#define NCTRACE_NBUCKETS 40
+
+/* One tracing table per underlying dispatch table */
+#define NCTRACE_MAXTABLES 8
+
+/* The traced operations, in NC_Dispatch order */
+#define NCTRACE_OPS(X) \
+X(create) X(open) X(redef) X(_enddef) X(sync) X(abort) X(close) \
+X(set_fill) X(inq_base_pe) X(set_base_pe) X(inq_format) \
+X(inq_format_extended) X(inq) X(inq_type) \
+X(def_dim) X(inq_dimid) X(inq_dim) X(inq_unlimdim) X(rename_dim) \
+X(inq_att) X(inq_attid) X(inq_attname) X(rename_att) X(del_att) \
+X(get_att) X(put_att) \
+X(def_var) X(inq_varid) X(rename_var) X(get_vara) X(put_vara) \
+X(get_vars) X(put_vars) X(get_varm) X(put_varm) X(inq_var_all) \
+X(var_par_access) \
+X(show_metadata) X(inq_unlimdims) X(inq_ncid) X(inq_grps) \
+X(inq_grpname) X(inq_grpname_full) X(inq_grp_parent) \
+X(inq_grp_full_ncid) X(inq_varids) X(inq_dimids) X(inq_typeids) \
+X(inq_type_equal) X(def_grp) X(rename_grp) X(inq_user_type) \
+X(inq_typeid) X(def_compound) X(insert_compound) \
+X(insert_array_compound) X(inq_compound_field) \
+X(inq_compound_fieldindex) X(def_vlen) X(put_vlen_element) \
+X(get_vlen_element) X(def_enum) X(insert_enum) X(inq_enum_member) \
+X(inq_enum_ident) X(def_opaque) X(def_var_deflate) \
+X(def_var_fletcher32) X(def_var_chunking) X(def_var_fill) \
+X(def_var_endian) X(set_var_chunk_cache) X(get_var_chunk_cache) \
+X(inq_io_stats) X(reset_io_stats) X(inq_memory_usage) \
+X(set_append_mode) X(get_var_points) X(def_var_quantize) \
+X(inq_var_quantize) X(set_metadata_index) X(inq_metadata_index) \
+X(get_chunk_raw) X(put_chunk_raw) X(iter_chunks_raw) X(iter_byte_ranges) \
+X(def_var_filter) X(inq_var_filter) X(get_vara_field) \
+X(get_vara_packed) X(put_vara_packed) X(inq_var_filter_ids)
+
+#define NCTRACE_ENUM(op) NCT_##op,
+#define NCTRACE_NAME(op) #op,
+
+typedef enum NCTRACEOP {
+NCTRACE_OPS(NCTRACE_ENUM)
+NCT_COUNT
+} NCTRACEOP;
+
+static const char* nctrace_names[NCT_COUNT] = {
+NCTRACE_OPS(NCTRACE_NAME)
+};
+
+typedef struct NCTRACESTAT {
+    unsigned long long calls;
+    unsigned long long errors;
+    double total; /* seconds */
+    double max;   /* seconds */
+    unsigned long long hist[NCTRACE_NBUCKETS];
+} NCTRACESTAT;
+
+/* A tracing table; table must be first so that an NC's dispatch
+   pointer can be converted back to its NCTRACETABLE */
+typedef struct NCTRACETABLE {
+    NC_Dispatch table;
+    NC_Dispatch* inner;
+} NCTRACETABLE;
+
+int NC_tracing = 0;
+
+static NCTRACESTAT nctrace_stats[NCT_COUNT];
+static NCTRACETABLE nctrace_tables[NCTRACE_MAXTABLES];
+static int nctrace_ntables = 0;
+static int nctrace_tostderr = 0;
+static char* nctrace_summaryfile = NULL;
+static FILE* nctrace_json = NULL;
+static int nctrace_nevents = 0;
+static double nctrace_epoch = 0;
+static int nctrace_pid = 0;
+static int nctrace_exithandler = 0;
+
+static NC_Dispatch nctrace_dispatcher; /* forward */
+
+/* Monotonic clock in seconds */
+static double
+nctrace_clock(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+    (void)gettimeofday(&tv,NULL);
+    return (double)tv.tv_sec + 1.0e-6 * (double)tv.tv_usec;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static int
+nctrace_bucket(double seconds)
+{
+    int e;
+    double ns = seconds * 1.0e9;
+    if(ns < 1.0) return 0;
+    (void)frexp(ns,&e); /* ns = m * 2^e, 0.5 <= m < 1 */
+    e--;
+    return (e >= NCTRACE_NBUCKETS ? NCTRACE_NBUCKETS - 1 : e);
+}
+
+static void
+nctrace_record(NCTRACEOP op, int ncid, double t0, int stat)
+{
+    double t1 = nctrace_clock();
+    double dt = t1 - t0;
+    NCTRACESTAT* st = &nctrace_stats[op];
+
+    st->calls++;
+    if(stat != NC_NOERR) st->errors++;
+    st->total += dt;
+    if(dt > st->max) st->max = dt;
+    st->hist[nctrace_bucket(dt)]++;
+
+    if(nctrace_json != NULL) {
+	fprintf(nctrace_json,
+		"%s{\"name\":\"%s\",\"cat\":\"netcdf\",\"ph\":\"X\","
+		"\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":1,"
+		"\"args\":{\"ncid\":%d,\"status\":%d}}",
+		(nctrace_nevents++ == 0 ? "\n" : ",\n"),
+		nctrace_names[op],
+		(t0 - nctrace_epoch) * 1.0e6, dt * 1.0e6,
+		nctrace_pid, ncid, stat);
+    }
+}
+
+/* Find the real dispatch table behind an ncid */
+static int
+nctrace_inner(int ncid, NC_Dispatch** innerp)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    *innerp = ((NCTRACETABLE*)ncp->dispatch)->inner;
+    return NC_NOERR;
+}
+
+/* Body of every wrapper: time call on the real table */
+#define NCTRACE(op,ncid,call) { \
+    NC_Dispatch* inner; \
+    int stat; \
+    double t0; \
+    if((stat = nctrace_inner((ncid),&inner))) return stat; \
+    t0 = nctrace_clock(); \
+    stat = inner->call; \
+    nctrace_record(NCT_##op,(ncid),t0,stat); \
+    return stat; \
+}
+
+/**************************************************/
+/* Wrappers */
+
+static int
+NCTRACE_create(const char *path, int cmode, size_t initialsz, int basepe,
+	       size_t *chunksizehintp, int use_parallel, void* parameters,
+	       NC_Dispatch* table, NC* ncp)
+{
+    NC_Dispatch* inner = ((NCTRACETABLE*)table)->inner;
+    double t0 = nctrace_clock();
+    int stat = inner->create(path,cmode,initialsz,basepe,chunksizehintp,
+			     use_parallel,parameters,table,ncp);
+    nctrace_record(NCT_create,ncp->ext_ncid,t0,stat);
+    return stat;
+}
+
+static int
+NCTRACE_open(const char *path, int mode, int basepe, size_t *chunksizehintp,
+	     int use_parallel, void* parameters, NC_Dispatch* table, NC* ncp)
+{
+    NC_Dispatch* inner = ((NCTRACETABLE*)table)->inner;
+    double t0 = nctrace_clock();
+    int stat = inner->open(path,mode,basepe,chunksizehintp,
+			   use_parallel,parameters,table,ncp);
+    nctrace_record(NCT_open,ncp->ext_ncid,t0,stat);
+    return stat;
+}
+
+static int
+NCTRACE_redef(int ncid)
+NCTRACE(redef,ncid,redef(ncid))
+
+static int
+NCTRACE__enddef(int ncid, size_t h_minfree, size_t v_align,
+		size_t v_minfree, size_t r_align)
+NCTRACE(_enddef,ncid,_enddef(ncid,h_minfree,v_align,v_minfree,r_align))
+
+static int
+NCTRACE_sync(int ncid)
+NCTRACE(sync,ncid,sync(ncid))
+
+static int
+NCTRACE_abort(int ncid)
+NCTRACE(abort,ncid,abort(ncid))
+
+static int
+NCTRACE_close(int ncid)
+NCTRACE(close,ncid,close(ncid))
+
+static int
+NCTRACE_set_fill(int ncid, int fillmode, int* old_modep)
+NCTRACE(set_fill,ncid,set_fill(ncid,fillmode,old_modep))
+
+static int
+NCTRACE_inq_base_pe(int ncid, int* pe)
+NCTRACE(inq_base_pe,ncid,inq_base_pe(ncid,pe))
+
+static int
+NCTRACE_set_base_pe(int ncid, int pe)
+NCTRACE(set_base_pe,ncid,set_base_pe(ncid,pe))
+
+static int
+NCTRACE_inq_format(int ncid, int* formatp)
+NCTRACE(inq_format,ncid,inq_format(ncid,formatp))
+
+static int
+NCTRACE_inq_format_extended(int ncid, int* formatp, int* modep)
+NCTRACE(inq_format_extended,ncid,inq_format_extended(ncid,formatp,modep))
+
+static int
+NCTRACE_inq(int ncid, int* ndimsp, int* nvarsp, int* nattsp, int* unlimdimidp)
+NCTRACE(inq,ncid,inq(ncid,ndimsp,nvarsp,nattsp,unlimdimidp))
+
+static int
+NCTRACE_inq_type(int ncid, nc_type xtype, char* name, size_t* size)
+NCTRACE(inq_type,ncid,inq_type(ncid,xtype,name,size))
+
+static int
+NCTRACE_def_dim(int ncid, const char* name, size_t len, int* idp)
+NCTRACE(def_dim,ncid,def_dim(ncid,name,len,idp))
+
+static int
+NCTRACE_inq_dimid(int ncid, const char* name, int* idp)
+NCTRACE(inq_dimid,ncid,inq_dimid(ncid,name,idp))
+
+static int
+NCTRACE_inq_dim(int ncid, int dimid, char* name, size_t* lenp)
+NCTRACE(inq_dim,ncid,inq_dim(ncid,dimid,name,lenp))
+
+static int
+NCTRACE_inq_unlimdim(int ncid, int* unlimdimidp)
+NCTRACE(inq_unlimdim,ncid,inq_unlimdim(ncid,unlimdimidp))
+
+static int
+NCTRACE_rename_dim(int ncid, int dimid, const char* name)
+NCTRACE(rename_dim,ncid,rename_dim(ncid,dimid,name))
+
+static int
+NCTRACE_inq_att(int ncid, int varid, const char* name, nc_type* xtypep, size_t* lenp)
+NCTRACE(inq_att,ncid,inq_att(ncid,varid,name,xtypep,lenp))
+
+static int
+NCTRACE_inq_attid(int ncid, int varid, const char* name, int* idp)
+NCTRACE(inq_attid,ncid,inq_attid(ncid,varid,name,idp))
+
+static int
+NCTRACE_inq_attname(int ncid, int varid, int attnum, char* name)
+NCTRACE(inq_attname,ncid,inq_attname(ncid,varid,attnum,name))
+
+static int
+NCTRACE_rename_att(int ncid, int varid, const char* name, const char* newname)
+NCTRACE(rename_att,ncid,rename_att(ncid,varid,name,newname))
+
+static int
+NCTRACE_del_att(int ncid, int varid, const char* name)
+NCTRACE(del_att,ncid,del_att(ncid,varid,name))
+
+static int
+NCTRACE_get_att(int ncid, int varid, const char* name, void* value, nc_type memtype)
+NCTRACE(get_att,ncid,get_att(ncid,varid,name,value,memtype))
+
+static int
+NCTRACE_put_att(int ncid, int varid, const char* name, nc_type xtype,
+		size_t len, const void* value, nc_type memtype)
+NCTRACE(put_att,ncid,put_att(ncid,varid,name,xtype,len,value,memtype))
+
+static int
+NCTRACE_def_var(int ncid, const char* name, nc_type xtype, int ndims,
+		const int* dimidsp, int* varidp)
+NCTRACE(def_var,ncid,def_var(ncid,name,xtype,ndims,dimidsp,varidp))
+
+static int
+NCTRACE_inq_varid(int ncid, const char* name, int* varidp)
+NCTRACE(inq_varid,ncid,inq_varid(ncid,name,varidp))
+
+static int
+NCTRACE_rename_var(int ncid, int varid, const char* name)
+NCTRACE(rename_var,ncid,rename_var(ncid,varid,name))
+
+static int
+NCTRACE_get_vara(int ncid, int varid, const size_t* start,
+		 const size_t* count, void* value, nc_type memtype)
+NCTRACE(get_vara,ncid,get_vara(ncid,varid,start,count,value,memtype))
+
+static int
+NCTRACE_put_vara(int ncid, int varid, const size_t* start,
+		 const size_t* count, const void* value, nc_type memtype)
+NCTRACE(put_vara,ncid,put_vara(ncid,varid,start,count,value,memtype))
+
+static int
+NCTRACE_get_vars(int ncid, int varid, const size_t* start,
+		 const size_t* count, const ptrdiff_t* stride,
+		 void* value, nc_type memtype)
+NCTRACE(get_vars,ncid,get_vars(ncid,varid,start,count,stride,value,memtype))
+
+static int
+NCTRACE_put_vars(int ncid, int varid, const size_t* start,
+		 const size_t* count, const ptrdiff_t* stride,
+		 const void* value, nc_type memtype)
+NCTRACE(put_vars,ncid,put_vars(ncid,varid,start,count,stride,value,memtype))
+
+static int
+NCTRACE_get_varm(int ncid, int varid, const size_t* start,
+		 const size_t* count, const ptrdiff_t* stride,
+		 const ptrdiff_t* imap, void* value, nc_type memtype)
+NCTRACE(get_varm,ncid,get_varm(ncid,varid,start,count,stride,imap,value,memtype))
+
+static int
+NCTRACE_put_varm(int ncid, int varid, const size_t* start,
+		 const size_t* count, const ptrdiff_t* stride,
+		 const ptrdiff_t* imap, const void* value, nc_type memtype)
+NCTRACE(put_varm,ncid,put_varm(ncid,varid,start,count,stride,imap,value,memtype))
+
+static int
+NCTRACE_inq_var_all(int ncid, int varid, char* name, nc_type* xtypep,
+		    int* ndimsp, int* dimidsp, int* nattsp,
+		    int* shufflep, int* deflatep, int* deflate_levelp,
+		    int* fletcher32p, int* contiguousp, size_t* chunksizesp,
+		    int* no_fill, void* fill_valuep, int* endiannessp,
+		    int* options_maskp, int* pixels_per_blockp)
+NCTRACE(inq_var_all,ncid,inq_var_all(ncid,varid,name,xtypep,ndimsp,dimidsp,
+	nattsp,shufflep,deflatep,deflate_levelp,fletcher32p,contiguousp,
+	chunksizesp,no_fill,fill_valuep,endiannessp,options_maskp,
+	pixels_per_blockp))
+
+static int
+NCTRACE_var_par_access(int ncid, int varid, int par_access)
+NCTRACE(var_par_access,ncid,var_par_access(ncid,varid,par_access))
+
+#ifdef USE_NETCDF4
+static int
+NCTRACE_show_metadata(int ncid)
+NCTRACE(show_metadata,ncid,show_metadata(ncid))
+
+static int
+NCTRACE_inq_unlimdims(int ncid, int* nunlimdimsp, int* unlimdimidsp)
+NCTRACE(inq_unlimdims,ncid,inq_unlimdims(ncid,nunlimdimsp,unlimdimidsp))
+
+static int
+NCTRACE_inq_ncid(int ncid, const char* name, int* grp_ncid)
+NCTRACE(inq_ncid,ncid,inq_ncid(ncid,name,grp_ncid))
+
+static int
+NCTRACE_inq_grps(int ncid, int* numgrps, int* ncids)
+NCTRACE(inq_grps,ncid,inq_grps(ncid,numgrps,ncids))
+
+static int
+NCTRACE_inq_grpname(int ncid, char* name)
+NCTRACE(inq_grpname,ncid,inq_grpname(ncid,name))
+
+static int
+NCTRACE_inq_grpname_full(int ncid, size_t* lenp, char* full_name)
+NCTRACE(inq_grpname_full,ncid,inq_grpname_full(ncid,lenp,full_name))
+
+static int
+NCTRACE_inq_grp_parent(int ncid, int* parent_ncid)
+NCTRACE(inq_grp_parent,ncid,inq_grp_parent(ncid,parent_ncid))
+
+static int
+NCTRACE_inq_grp_full_ncid(int ncid, const char* full_name, int* grp_ncid)
+NCTRACE(inq_grp_full_ncid,ncid,inq_grp_full_ncid(ncid,full_name,grp_ncid))
+
+static int
+NCTRACE_inq_varids(int ncid, int* nvars, int* varids)
+NCTRACE(inq_varids,ncid,inq_varids(ncid,nvars,varids))
+
+static int
+NCTRACE_inq_dimids(int ncid, int* ndims, int* dimids, int include_parents)
+NCTRACE(inq_dimids,ncid,inq_dimids(ncid,ndims,dimids,include_parents))
+
+static int
+NCTRACE_inq_typeids(int ncid, int* ntypes, int* typeids)
+NCTRACE(inq_typeids,ncid,inq_typeids(ncid,ntypes,typeids))
+
+static int
+NCTRACE_inq_type_equal(int ncid1, nc_type typeid1, int ncid2,
+		       nc_type typeid2, int* equal)
+NCTRACE(inq_type_equal,ncid1,inq_type_equal(ncid1,typeid1,ncid2,typeid2,equal))
+
+static int
+NCTRACE_def_grp(int parent_ncid, const char* name, int* new_ncid)
+NCTRACE(def_grp,parent_ncid,def_grp(parent_ncid,name,new_ncid))
+
+static int
+NCTRACE_rename_grp(int grpid, const char* name)
+NCTRACE(rename_grp,grpid,rename_grp(grpid,name))
+
+static int
+NCTRACE_inq_user_type(int ncid, nc_type xtype, char* name, size_t* size,
+		      nc_type* base_nc_typep, size_t* nfieldsp, int* classp)
+NCTRACE(inq_user_type,ncid,inq_user_type(ncid,xtype,name,size,base_nc_typep,nfieldsp,classp))
+
+static int
+NCTRACE_inq_typeid(int ncid, const char* name, nc_type* typeidp)
+NCTRACE(inq_typeid,ncid,inq_typeid(ncid,name,typeidp))
+
+static int
+NCTRACE_def_compound(int ncid, size_t size, const char* name, nc_type* typeidp)
+NCTRACE(def_compound,ncid,def_compound(ncid,size,name,typeidp))
+
+static int
+NCTRACE_insert_compound(int ncid, nc_type xtype, const char* name,
+			size_t offset, nc_type field_typeid)
+NCTRACE(insert_compound,ncid,insert_compound(ncid,xtype,name,offset,field_typeid))
+
+static int
+NCTRACE_insert_array_compound(int ncid, nc_type xtype, const char* name,
+			      size_t offset, nc_type field_typeid,
+			      int ndims, const int* dim_sizes)
+NCTRACE(insert_array_compound,ncid,insert_array_compound(ncid,xtype,name,offset,field_typeid,ndims,dim_sizes))
+
+static int
+NCTRACE_inq_compound_field(int ncid, nc_type xtype, int fieldid, char* name,
+			   size_t* offsetp, nc_type* field_typeidp,
+			   int* ndimsp, int* dim_sizesp)
+NCTRACE(inq_compound_field,ncid,inq_compound_field(ncid,xtype,fieldid,name,offsetp,field_typeidp,ndimsp,dim_sizesp))
+
+static int
+NCTRACE_inq_compound_fieldindex(int ncid, nc_type xtype, const char* name,
+				int* fieldidp)
+NCTRACE(inq_compound_fieldindex,ncid,inq_compound_fieldindex(ncid,xtype,name,fieldidp))
+
+static int
+NCTRACE_def_vlen(int ncid, const char* name, nc_type base_typeid, nc_type* xtypep)
+NCTRACE(def_vlen,ncid,def_vlen(ncid,name,base_typeid,xtypep))
+
+static int
+NCTRACE_put_vlen_element(int ncid, int typeid1, void* vlen_element,
+			 size_t len, const void* data)
+NCTRACE(put_vlen_element,ncid,put_vlen_element(ncid,typeid1,vlen_element,len,data))
+
+static int
+NCTRACE_get_vlen_element(int ncid, int typeid1, const void* vlen_element,
+			 size_t* len, void* data)
+NCTRACE(get_vlen_element,ncid,get_vlen_element(ncid,typeid1,vlen_element,len,data))
+
+static int
+NCTRACE_def_enum(int ncid, nc_type base_typeid, const char* name, nc_type* typeidp)
+NCTRACE(def_enum,ncid,def_enum(ncid,base_typeid,name,typeidp))
+
+static int
+NCTRACE_insert_enum(int ncid, nc_type xtype, const char* name, const void* value)
+NCTRACE(insert_enum,ncid,insert_enum(ncid,xtype,name,value))
+
+static int
+NCTRACE_inq_enum_member(int ncid, nc_type xtype, int idx, char* name, void* value)
+NCTRACE(inq_enum_member,ncid,inq_enum_member(ncid,xtype,idx,name,value))
+
+static int
+NCTRACE_inq_enum_ident(int ncid, nc_type xtype, long long value, char* identifier)
+NCTRACE(inq_enum_ident,ncid,inq_enum_ident(ncid,xtype,value,identifier))
+
+static int
+NCTRACE_def_opaque(int ncid, size_t size, const char* name, nc_type* xtypep)
+NCTRACE(def_opaque,ncid,def_opaque(ncid,size,name,xtypep))
+
+static int
+NCTRACE_def_var_deflate(int ncid, int varid, int shuffle, int deflate,
+			int deflate_level)
+NCTRACE(def_var_deflate,ncid,def_var_deflate(ncid,varid,shuffle,deflate,deflate_level))
+
+static int
+NCTRACE_def_var_fletcher32(int ncid, int varid, int fletcher32)
+NCTRACE(def_var_fletcher32,ncid,def_var_fletcher32(ncid,varid,fletcher32))
+
+static int
+NCTRACE_def_var_chunking(int ncid, int varid, int storage, const size_t* chunksizesp)
+NCTRACE(def_var_chunking,ncid,def_var_chunking(ncid,varid,storage,chunksizesp))
+
+static int
+NCTRACE_def_var_fill(int ncid, int varid, int no_fill, const void* fill_value)
+NCTRACE(def_var_fill,ncid,def_var_fill(ncid,varid,no_fill,fill_value))
+
+static int
+NCTRACE_def_var_endian(int ncid, int varid, int endian)
+NCTRACE(def_var_endian,ncid,def_var_endian(ncid,varid,endian))
+
+static int
+NCTRACE_set_var_chunk_cache(int ncid, int varid, size_t size, size_t nelems,
+			    float preemption)
+NCTRACE(set_var_chunk_cache,ncid,set_var_chunk_cache(ncid,varid,size,nelems,preemption))
+
+static int
+NCTRACE_get_var_chunk_cache(int ncid, int varid, size_t* sizep,
+			    size_t* nelemsp, float* preemptionp)
+NCTRACE(get_var_chunk_cache,ncid,get_var_chunk_cache(ncid,varid,sizep,nelemsp,preemptionp))
+#endif /*USE_NETCDF4*/
+
+static int
+NCTRACE_inq_io_stats(int ncid, nc_io_stats_t* statsp)
+NCTRACE(inq_io_stats,ncid,inq_io_stats(ncid,statsp))
+
+static int
+NCTRACE_reset_io_stats(int ncid)
+NCTRACE(reset_io_stats,ncid,reset_io_stats(ncid))
+
+static int
+NCTRACE_inq_memory_usage(int ncid, nc_memory_usage_t* usagep)
+NCTRACE(inq_memory_usage,ncid,inq_memory_usage(ncid,usagep))
+
+static int
+NCTRACE_set_append_mode(int ncid, int mode, int* old_modep)
+NCTRACE(set_append_mode,ncid,set_append_mode(ncid,mode,old_modep))
+
+static int
+NCTRACE_get_var_points(int ncid, int varid, size_t npoints,
+		       const size_t* indexp, void* value, nc_type memtype)
+NCTRACE(get_var_points,ncid,get_var_points(ncid,varid,npoints,indexp,value,memtype))
+
+static int
+NCTRACE_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd)
+NCTRACE(def_var_quantize,ncid,def_var_quantize(ncid,varid,quantize_mode,nsd))
+
+static int
+NCTRACE_inq_var_quantize(int ncid, int varid, int* quantize_modep, int* nsdp)
+NCTRACE(inq_var_quantize,ncid,inq_var_quantize(ncid,varid,quantize_modep,nsdp))
+
+static int
+NCTRACE_set_metadata_index(int ncid, int flag, int* old_flagp)
+NCTRACE(set_metadata_index,ncid,set_metadata_index(ncid,flag,old_flagp))
+
+static int
+NCTRACE_inq_metadata_index(int ncid, int* flagp, int* openedp)
+NCTRACE(inq_metadata_index,ncid,inq_metadata_index(ncid,flagp,openedp))
+
+static int
+NCTRACE_get_chunk_raw(int ncid, int varid, const size_t* startp,
+		      unsigned int* filter_maskp, size_t* sizep, void* data)
+NCTRACE(get_chunk_raw,ncid,get_chunk_raw(ncid,varid,startp,filter_maskp,sizep,data))
+
+static int
+NCTRACE_put_chunk_raw(int ncid, int varid, const size_t* startp,
+		      unsigned int filter_mask, size_t size, const void* data)
+NCTRACE(put_chunk_raw,ncid,put_chunk_raw(ncid,varid,startp,filter_mask,size,data))
+
+static int
+NCTRACE_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void* udata)
+NCTRACE(iter_chunks_raw,ncid,iter_chunks_raw(ncid,varid,fn,udata))
+
+static int
+NCTRACE_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void* udata)
+NCTRACE(iter_byte_ranges,ncid,iter_byte_ranges(ncid,varid,fn,udata))
+
+static int
+NCTRACE_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+		       const unsigned int* params)
+NCTRACE(def_var_filter,ncid,def_var_filter(ncid,varid,id,nparams,params))
+
+static int
+NCTRACE_inq_var_filter(int ncid, int varid, unsigned int* idp, size_t* nparamsp,
+		       unsigned int* params)
+NCTRACE(inq_var_filter,ncid,inq_var_filter(ncid,varid,idp,nparamsp,params))
+
+static int
+NCTRACE_get_vara_field(int ncid, int varid, int fieldid, const size_t* startp,
+		       const size_t* countp, void* data)
+NCTRACE(get_vara_field,ncid,get_vara_field(ncid,varid,fieldid,startp,countp,data))
+
+static int
+NCTRACE_get_vara_packed(int ncid, int varid, const size_t* startp,
+			const size_t* countp, size_t* offsetsp, void** datap)
+NCTRACE(get_vara_packed,ncid,get_vara_packed(ncid,varid,startp,countp,offsetsp,datap))
+
+static int
+NCTRACE_put_vara_packed(int ncid, int varid, const size_t* startp,
+			const size_t* countp, const size_t* offsetsp,
+			const void* data)
+NCTRACE(put_vara_packed,ncid,put_vara_packed(ncid,varid,startp,countp,offsetsp,data))
+
+static int
+NCTRACE_inq_var_filter_ids(int ncid, int varid, size_t* nfiltersp,
+			   unsigned int* ids)
+NCTRACE(inq_var_filter_ids,ncid,inq_var_filter_ids(ncid,varid,nfiltersp,ids))
+
+/* The model field is filled in per table by NC_trace_wrap */
+static NC_Dispatch nctrace_dispatcher = {
+
+NC_FORMATX_UNDEFINED,
+
+NCTRACE_create,
+NCTRACE_open,
+
+NCTRACE_redef,
+NCTRACE__enddef,
+NCTRACE_sync,
+NCTRACE_abort,
+NCTRACE_close,
+NCTRACE_set_fill,
+NCTRACE_inq_base_pe,
+NCTRACE_set_base_pe,
+NCTRACE_inq_format,
+NCTRACE_inq_format_extended,
+
+NCTRACE_inq,
+NCTRACE_inq_type,
+
+NCTRACE_def_dim,
+NCTRACE_inq_dimid,
+NCTRACE_inq_dim,
+NCTRACE_inq_unlimdim,
+NCTRACE_rename_dim,
+
+NCTRACE_inq_att,
+NCTRACE_inq_attid,
+NCTRACE_inq_attname,
+NCTRACE_rename_att,
+NCTRACE_del_att,
+NCTRACE_get_att,
+NCTRACE_put_att,
+
+NCTRACE_def_var,
+NCTRACE_inq_varid,
+NCTRACE_rename_var,
+NCTRACE_get_vara,
+NCTRACE_put_vara,
+NCTRACE_get_vars,
+NCTRACE_put_vars,
+NCTRACE_get_varm,
+NCTRACE_put_varm,
+
+NCTRACE_inq_var_all,
+
+NCTRACE_var_par_access,
+
+#ifdef USE_NETCDF4
+NCTRACE_show_metadata,
+NCTRACE_inq_unlimdims,
+NCTRACE_inq_ncid,
+NCTRACE_inq_grps,
+NCTRACE_inq_grpname,
+NCTRACE_inq_grpname_full,
+NCTRACE_inq_grp_parent,
+NCTRACE_inq_grp_full_ncid,
+NCTRACE_inq_varids,
+NCTRACE_inq_dimids,
+NCTRACE_inq_typeids,
+NCTRACE_inq_type_equal,
+NCTRACE_def_grp,
+NCTRACE_rename_grp,
+NCTRACE_inq_user_type,
+NCTRACE_inq_typeid,
+
+NCTRACE_def_compound,
+NCTRACE_insert_compound,
+NCTRACE_insert_array_compound,
+NCTRACE_inq_compound_field,
+NCTRACE_inq_compound_fieldindex,
+NCTRACE_def_vlen,
+NCTRACE_put_vlen_element,
+NCTRACE_get_vlen_element,
+NCTRACE_def_enum,
+NCTRACE_insert_enum,
+NCTRACE_inq_enum_member,
+NCTRACE_inq_enum_ident,
+NCTRACE_def_opaque,
+NCTRACE_def_var_deflate,
+NCTRACE_def_var_fletcher32,
+NCTRACE_def_var_chunking,
+NCTRACE_def_var_fill,
+NCTRACE_def_var_endian,
+NCTRACE_set_var_chunk_cache,
+NCTRACE_get_var_chunk_cache,
+#endif /*USE_NETCDF4*/
+
+NCTRACE_inq_io_stats,
+NCTRACE_reset_io_stats,
+
+NCTRACE_inq_memory_usage,
+
+NCTRACE_set_append_mode,
+
+NCTRACE_get_var_points,
+
+NCTRACE_def_var_quantize,
+NCTRACE_inq_var_quantize,
+
+NCTRACE_set_metadata_index,
+NCTRACE_inq_metadata_index,
+NCTRACE_get_chunk_raw,
+NCTRACE_put_chunk_raw,
+NCTRACE_iter_chunks_raw,
+NCTRACE_iter_byte_ranges,
+NCTRACE_def_var_filter,
+NCTRACE_inq_var_filter,
+NCTRACE_get_vara_field,
+NCTRACE_get_vara_packed,
+NCTRACE_put_vara_packed,
+NCTRACE_inq_var_filter_ids,
+
+};
+
+/**************************************************/
+/* Reporting */
+
+static void
+nctrace_printlatency(FILE* f, double seconds)
+{
+    if(seconds < 1.0e-6)
+	fprintf(f,"%7.0fns",seconds*1.0e9);
+    else if(seconds < 1.0e-3)
+	fprintf(f,"%7.1fus",seconds*1.0e6);
+    else if(seconds < 1.0)
+	fprintf(f,"%7.1fms",seconds*1.0e3);
+    else
+	fprintf(f,"%7.2fs ",seconds);
+}
+
+static void
+nctrace_report(FILE* f)
+{
+    int op, b;
+
+    fprintf(f,"netCDF dispatch trace (pid %d)\n",nctrace_pid);
+    fprintf(f,"%-24s %10s %8s %12s %9s %9s\n",
+	    "operation","calls","errors","total(s)","mean","max");
+    for(op=0;op<NCT_COUNT;op++) {
+	NCTRACESTAT* st = &nctrace_stats[op];
+	if(st->calls == 0) continue;
+	fprintf(f,"%-24s %10llu %8llu %12.6f ",nctrace_names[op],
+		st->calls,st->errors,st->total);
+	nctrace_printlatency(f,st->total/(double)st->calls);
+	fprintf(f," ");
+	nctrace_printlatency(f,st->max);
+	fprintf(f,"\n");
+	for(b=0;b<NCTRACE_NBUCKETS;b++) {
+	    if(st->hist[b] == 0) continue;
+	    fprintf(f,"    >=");
+	    nctrace_printlatency(f,ldexp(1.0e-9,b));
+	    fprintf(f," %10llu\n",st->hist[b]);
+	}
+    }
+}
+
+static void
+nctrace_atexit(void)
+{
+    (void)NC_trace_finalize();
+}
+
+/**************************************************/
+/* Internal API */
+
+/**
+\internal
+Turn tracing on if the environment asks for it.
+Called from NCDISPATCH_initialize().
+*/
+int
+NC_trace_initialize(void)
+{
+    const char* summary = getenv(NCTRACEENV);
+    const char* json = getenv(NCTRACEJSONENV);
+
+    if(summary != NULL && (*summary == '\0' || strcmp(summary,"0") == 0))
+	summary = NULL;
+    if(json != NULL && *json == '\0')
+	json = NULL;
+    if(summary == NULL && json == NULL)
+	return NC_NOERR;
+
+    memset(nctrace_stats,0,sizeof(nctrace_stats));
+    nctrace_nevents = 0;
+    nctrace_epoch = nctrace_clock();
+#ifdef HAVE_UNISTD_H
+    nctrace_pid = (int)getpid();
+#endif
+    if(summary != NULL && strcmp(summary,"1") == 0)
+	nctrace_tostderr = 1;
+    else if(summary != NULL)
+	nctrace_summaryfile = strdup(summary);
+    if(json != NULL) {
+	nctrace_json = fopen(json,"w");
+	if(nctrace_json == NULL)
+	    return NC_EINVAL;
+	fputs("[",nctrace_json);
+    }
+    if(!nctrace_exithandler) {
+	atexit(nctrace_atexit);
+	nctrace_exithandler = 1;
+    }
+    NC_tracing = 1;
+    return NC_NOERR;
+}
+
+/**
+\internal
+Write the summary, close the event stream and turn tracing off.
+Called from NCDISPATCH_finalize() and at exit.
+*/
+int
+NC_trace_finalize(void)
+{
+    int stat = NC_NOERR;
+
+    if(!NC_tracing) return NC_NOERR;
+    NC_tracing = 0;
+
+    if(nctrace_summaryfile != NULL) {
+	FILE* f = fopen(nctrace_summaryfile,"w");
+	if(f == NULL)
+	    stat = NC_EINVAL;
+	else {
+	    nctrace_report(f);
+	    fclose(f);
+	}
+	free(nctrace_summaryfile);
+	nctrace_summaryfile = NULL;
+    } else if(nctrace_tostderr)
+	nctrace_report(stderr);
+    nctrace_tostderr = 0;
+
+    if(nctrace_json != NULL) {
+	fputs("\n]\n",nctrace_json);
+	fclose(nctrace_json);
+	nctrace_json = NULL;
+    }
+    return stat;
+}
+
+/**
+\internal
+Return the tracing table that wraps inner. Files already open keep
+their table, so tables are never released.
+*/
+NC_Dispatch*
+NC_trace_wrap(NC_Dispatch* inner)
+{
+    int i;
+    NCTRACETABLE* t;
+
+    for(i=0;i<nctrace_ntables;i++) {
+	if(nctrace_tables[i].inner == inner)
+	    return &nctrace_tables[i].table;
+    }
+    if(nctrace_ntables == NCTRACE_MAXTABLES)
+	return inner; /* cannot happen with the known dispatchers */
+    t = &nctrace_tables[nctrace_ntables++];
+    t->table = nctrace_dispatcher;
+    t->table.model = inner->model;
+    t->inner = inner;
+    return &t->table;
+}
@@ -0,0 +1,433 @@
+/** \file dunpack.c
+
+Reads that unpack CF packed variables.
+
+nc_get_vara_unpack_double() and nc_get_vara_unpack_float() read a
+hyperslab in the type of the variable, a tile at a time with
+NC_read_tiles(), and convert each tile to the memory type, applying
+scale_factor and add_offset and turning fill, missing and out of range
+values into NaNs, in the same pass. There is no second pass over the
+result and no temporary the size of the request.
+
+Copyright 2016 University Corporation for Atmospheric
+Research/Unidata. See COPYRIGHT file for more info.
+*/
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ncdispatch.h"
+
+/* Size of the working buffer, in bytes. */
+#define NC_UNPACK_BUFFER (1024 * 1024)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2_UNPACK
+#include <emmintrin.h>
+#endif
+
+/* An unpacking kernel converts n packed values to the memory type. */
+typedef void (*NC_UNPACK_FN)(const void *src, void *dest, size_t n,
+			     const NC_unpack *u);
+
+/* Packed values are widened to double a step at a time, into a
+ * buffer that stays in L1, and then masked, scaled and offset. */
+#define UNPACK_STEP 256
+
+#ifdef USE_SSE2_UNPACK
+/* Two values at a time; invalid values become NaN by masking the
+ * result against an all-NaN vector. */
+#define APPLY_SSE2(x, r)						\
+    do {								\
+	int k_;								\
+	__m128d ok = _mm_and_pd(_mm_cmpneq_pd(x, fill),			\
+				_mm_and_pd(_mm_cmpge_pd(x, lo),		\
+					   _mm_cmple_pd(x, hi)));	\
+	for (k_ = 0; k_ < nmissing; k_++)				\
+	    ok = _mm_and_pd(ok, _mm_cmpneq_pd(x, missing[k_]));	\
+	r = _mm_add_pd(_mm_mul_pd(x, scale), offset);			\
+	r = _mm_or_pd(_mm_and_pd(ok, r), _mm_andnot_pd(ok, nan));	\
+    } while (0)
+
+#define APPLY_SETUP							\
+    const __m128d fill = _mm_set1_pd(u->fill);				\
+    const int nmissing = u->nmissing;					\
+    const __m128d missing[NC_UNPACK_MAX_MISSING] = {			\
+	_mm_set1_pd(u->missing[0]), _mm_set1_pd(u->missing[1]),		\
+	_mm_set1_pd(u->missing[2]), _mm_set1_pd(u->missing[3])};	\
+    const __m128d lo = _mm_set1_pd(u->lo);				\
+    const __m128d hi = _mm_set1_pd(u->hi);				\
+    const __m128d scale = _mm_set1_pd(u->scale);			\
+    const __m128d offset = _mm_set1_pd(u->offset);			\
+    const __m128d nan = _mm_set1_pd(NAN)
+
+static void
+apply_double(const double *v, double *dp, size_t n, const NC_unpack *u)
+{
+    APPLY_SETUP;
+    size_t i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+	__m128d x = _mm_loadu_pd(v + i), r;
+	APPLY_SSE2(x, r);
+	_mm_storeu_pd(dp + i, r);
+    }
+    for (; i < n; i++)
+	dp[i] = NC_UNPACK_VALID(u, v[i]) ? v[i] * u->scale + u->offset : NAN;
+}
+
+static void
+apply_float(const double *v, float *dp, size_t n, const NC_unpack *u)
+{
+    APPLY_SETUP;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+	__m128d a = _mm_loadu_pd(v + i), b = _mm_loadu_pd(v + i + 2), ra, rb;
+	APPLY_SSE2(a, ra);
+	APPLY_SSE2(b, rb);
+	_mm_storeu_ps(dp + i, _mm_movelh_ps(_mm_cvtpd_ps(ra), _mm_cvtpd_ps(rb)));
+    }
+    for (; i < n; i++)
+	dp[i] = NC_UNPACK_VALID(u, v[i]) ? (float)(v[i] * u->scale + u->offset) : (float)NAN;
+}
+#else
+static void
+apply_double(const double *v, double *dp, size_t n, const NC_unpack *u)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	dp[i] = NC_UNPACK_VALID(u, v[i]) ? v[i] * u->scale + u->offset : NAN;
+}
+
+static void
+apply_float(const double *v, float *dp, size_t n, const NC_unpack *u)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+	dp[i] = NC_UNPACK_VALID(u, v[i]) ? (float)(v[i] * u->scale + u->offset) : (float)NAN;
+}
+#endif /* USE_SSE2_UNPACK */
+
+#define UNPACK(name, stype, dtype)					\
+static void								\
+unpack_##name(const void *src, void *dest, size_t n, const NC_unpack *u) \
+{									\
+    const stype *sp = (const stype *)src;				\
+    dtype *dp = (dtype *)dest;						\
+    double v[UNPACK_STEP];						\
+    size_t i, j, m;							\
+									\
+    for (i = 0; i < n; i += m) {					\
+	m = n - i < UNPACK_STEP ? n - i : UNPACK_STEP;			\
+	for (j = 0; j < m; j++)						\
+	    v[j] = (double)sp[i + j];					\
+	apply_##dtype(v, dp + i, m, u);					\
+    }									\
+}
+
+UNPACK(schar_double, signed char, double)
+UNPACK(uchar_double, unsigned char, double)
+UNPACK(short_double, short, double)
+UNPACK(ushort_double, unsigned short, double)
+UNPACK(int_double, int, double)
+UNPACK(uint_double, unsigned int, double)
+UNPACK(longlong_double, long long, double)
+UNPACK(ulonglong_double, unsigned long long, double)
+UNPACK(float_double, float, double)
+UNPACK(double_double, double, double)
+UNPACK(schar_float, signed char, float)
+UNPACK(uchar_float, unsigned char, float)
+UNPACK(short_float, short, float)
+UNPACK(ushort_float, unsigned short, float)
+UNPACK(int_float, int, float)
+UNPACK(uint_float, unsigned int, float)
+UNPACK(longlong_float, long long, float)
+UNPACK(ulonglong_float, unsigned long long, float)
+UNPACK(float_float, float, float)
+UNPACK(double_float, double, float)
+
+/* The kernels, indexed by the type of the variable. */
+static const NC_UNPACK_FN unpack_double[NC_MAX_ATOMIC_TYPE] = {
+    NULL,
+    unpack_schar_double,	/* NC_BYTE */
+    NULL,			/* NC_CHAR */
+    unpack_short_double,	/* NC_SHORT */
+    unpack_int_double,		/* NC_INT */
+    unpack_float_double,	/* NC_FLOAT */
+    unpack_double_double,	/* NC_DOUBLE */
+    unpack_uchar_double,	/* NC_UBYTE */
+    unpack_ushort_double,	/* NC_USHORT */
+    unpack_uint_double,		/* NC_UINT */
+    unpack_longlong_double,	/* NC_INT64 */
+    unpack_ulonglong_double	/* NC_UINT64 */
+};
+
+static const NC_UNPACK_FN unpack_float[NC_MAX_ATOMIC_TYPE] = {
+    NULL,
+    unpack_schar_float,		/* NC_BYTE */
+    NULL,			/* NC_CHAR */
+    unpack_short_float,		/* NC_SHORT */
+    unpack_int_float,		/* NC_INT */
+    unpack_float_float,		/* NC_FLOAT */
+    unpack_double_float,	/* NC_DOUBLE */
+    unpack_uchar_float,		/* NC_UBYTE */
+    unpack_ushort_float,	/* NC_USHORT */
+    unpack_uint_float,		/* NC_UINT */
+    unpack_longlong_float,	/* NC_INT64 */
+    unpack_ulonglong_float	/* NC_UINT64 */
+};
+
+/* Get the values of a numeric attribute of from minlen to maxlen
+ * values as doubles, setting *lenp to how many there are, or to 0
+ * without the attribute. An attribute that is not numeric, or not of
+ * such a length, is NC_EINVAL. */
+static int
+get_att_values(int ncid, int varid, const char *name, size_t minlen,
+	       size_t maxlen, double *valuep, size_t *lenp)
+{
+    double values[NC_UNPACK_MAX_MISSING];
+    nc_type atype;
+    size_t alen;
+    int stat;
+
+    *lenp = 0;
+    stat = nc_inq_att(ncid, varid, name, &atype, &alen);
+    if (stat == NC_ENOTATT)
+	return NC_NOERR;
+    if (stat)
+	return stat;
+    if (alen < minlen || alen > maxlen || atype == NC_CHAR ||
+	atype == NC_STRING || atype > NC_MAX_ATOMIC_TYPE)
+	return NC_EINVAL;
+    if ((stat = nc_get_att_double(ncid, varid, name, values)))
+	return stat;
+    memcpy(valuep, values, alen * sizeof(double));
+    *lenp = alen;
+    return NC_NOERR;
+}
+
+int
+NC_get_unpack(int ncid, int varid, nc_type xtype, NC_unpack *up)
+{
+    double range[2];
+    size_t len;
+    int i, stat;
+
+    if (xtype == NC_CHAR)
+	return NC_ECHAR;
+    if (xtype < NC_BYTE || xtype > NC_MAX_ATOMIC_TYPE || xtype == NC_STRING)
+	return NC_EBADTYPE;
+
+    if ((stat = get_att_values(ncid, varid, "scale_factor", 1, 1, &up->scale, &len)))
+	return stat;
+    if (!len)
+	up->scale = 1;
+    if ((stat = get_att_values(ncid, varid, "add_offset", 1, 1, &up->offset, &len)))
+	return stat;
+    if (!len)
+	up->offset = 0;
+
+    /* missing_value may be a vector; the unused slots are NaN, which
+     * nothing equals. */
+    if ((stat = get_att_values(ncid, varid, "missing_value", 1,
+			       NC_UNPACK_MAX_MISSING, up->missing, &len)))
+	return stat;
+    up->nmissing = (int)len;
+    for (i = up->nmissing; i < NC_UNPACK_MAX_MISSING; i++)
+	up->missing[i] = NAN;
+
+    /* Without a _FillValue attribute, the default fill value of the
+     * type is the fill value. */
+    if ((stat = get_att_values(ncid, varid, _FillValue, 1, 1, &up->fill, &len)))
+	return stat;
+    if (!len) {
+	switch (xtype) {
+	case NC_BYTE: up->fill = NC_FILL_BYTE; break;
+	case NC_UBYTE: up->fill = NC_FILL_UBYTE; break;
+	case NC_SHORT: up->fill = NC_FILL_SHORT; break;
+	case NC_USHORT: up->fill = NC_FILL_USHORT; break;
+	case NC_INT: up->fill = NC_FILL_INT; break;
+	case NC_UINT: up->fill = NC_FILL_UINT; break;
+	case NC_INT64: up->fill = (double)NC_FILL_INT64; break;
+	case NC_UINT64: up->fill = (double)NC_FILL_UINT64; break;
+	case NC_FLOAT: up->fill = NC_FILL_FLOAT; break;
+	default: up->fill = NC_FILL_DOUBLE; break;
+	}
+    }
+
+    /* valid_range overrides valid_min and valid_max. */
+    if ((stat = get_att_values(ncid, varid, "valid_range", 2, 2, range, &len)))
+	return stat;
+    if (len) {
+	up->lo = range[0];
+	up->hi = range[1];
+    } else {
+	if ((stat = get_att_values(ncid, varid, "valid_min", 1, 1, &up->lo, &len)))
+	    return stat;
+	if (!len)
+	    up->lo = -HUGE_VAL;
+	if ((stat = get_att_values(ncid, varid, "valid_max", 1, 1, &up->hi, &len)))
+	    return stat;
+	if (!len)
+	    up->hi = HUGE_VAL;
+    }
+    return NC_NOERR;
+}
+
+/* The state of an unpacking read. */
+typedef struct NC_UNPACK {
+    NC_UNPACK_FN fn;
+    const NC_unpack *u;
+    int ndims;
+    const size_t *ostride;
+    char *dest;
+    size_t size;
+} NC_UNPACK;
+
+/* Unpack a row of a tile to where it goes in the result. */
+static void
+unpack_row(void *ctx, const void *values, size_t n, const size_t *rel)
+{
+    NC_UNPACK *up = (NC_UNPACK *)ctx;
+    size_t offset = 0;
+    int d;
+
+    for (d = 0; d < up->ndims; d++)
+	offset += rel[d] * up->ostride[d];
+    up->fn(values, up->dest + offset * up->size, n, up->u);
+}
+
+static int
+NC_get_vara_unpack(int ncid, int varid, const size_t *startp,
+		   const size_t *countp, void *ip, nc_type memtype)
+{
+    NC_unpack u;
+    NC_UNPACK up;
+    size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+    size_t shape[NC_MAX_VAR_DIMS], ostride[NC_MAX_VAR_DIMS], n = 1;
+    nc_type xtype;
+    int ndims, d, stat;
+
+    if ((stat = nc_inq_var(ncid, varid, NULL, &xtype, &ndims, NULL, NULL)))
+	return stat;
+    if ((stat = NC_get_unpack(ncid, varid, xtype, &u)))
+	return stat;
+    if ((stat = NC_getshape(ncid, varid, ndims, shape)))
+	return stat;
+    for (d = 0; d < ndims; d++) {
+	start[d] = startp ? startp[d] : 0;
+	if (countp)
+	    count[d] = countp[d];
+	else
+	    count[d] = start[d] < shape[d] ? shape[d] - start[d] : 0;
+    }
+    for (d = ndims - 1; d >= 0; d--) {
+	ostride[d] = n;
+	n *= count[d];
+    }
+
+    up.fn = memtype == NC_FLOAT ? unpack_float[xtype] : unpack_double[xtype];
+    up.u = &u;
+    up.ndims = ndims;
+    up.ostride = ostride;
+    up.dest = (char *)ip;
+    up.size = memtype == NC_FLOAT ? sizeof(float) : sizeof(double);
+    return NC_read_tiles(ncid, varid, xtype, NC_UNPACK_BUFFER, start, count,
+			 unpack_row, &up);
+}
+
+/** \name Reading and Unpacking Packed Variables
+
+Functions to read a hyperslab of a variable packed as the CF
+conventions describe, and unpack it. */
+/** \{ */
+/** \ingroup variables
+Read a hyperslab of a packed variable and unpack it.
+
+Each value is read, converted to double and unpacked by multiplying
+it by the scale_factor attribute of the variable and adding its
+add_offset attribute (either may be absent). Values that equal the
+_FillValue attribute (or, without one, the default fill value of the
+type of the variable) or one of the values of the missing_value
+attribute (of at most 4 values), or that lie outside the valid_range
+attribute (or the valid_min and valid_max attributes), are stored as
+NaN. The fill, missing and valid range values are compared with the
+packed values, as the CF conventions describe.
+
+The unpacking is done as each tile of the hyperslab is converted
+from the type of the variable, so the result is written once and
+needs no temporary the size of the request.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be of a numeric type.
+
+\param startp Start index vector, or NULL for the start of the
+variable.
+
+\param countp Count vector, or NULL for the rest of the variable from
+\p startp.
+
+\param ip Pointer where the unpacked values will be stored. Memory
+must be allocated by the user before this function is called.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_ECHAR The variable is of type char.
+\returns ::NC_EBADTYPE The variable is not of a numeric type.
+\returns ::NC_EINVAL One of these attributes is not numeric, or has
+the wrong number of values.
+\returns ::NC_ENOMEM Out of memory.
+\returns ::NC_EBADID Bad ncid.
+
+\section nc_get_vara_unpack_double_example Example
+
+Here is an example that reads the unpacked temperatures of a
+[time][lat][lon] variable packed as shorts, for the first time step:
+
+\code
+     #include <netcdf.h>
+        ...
+     int  status, ncid, varid;
+     size_t start[3] = {0, 0, 0}, count[3] = {1, NLAT, NLON};
+     double t[NLAT][NLON];
+        ...
+     status = nc_open("foo.nc", NC_NOWRITE, &ncid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_inq_varid (ncid, "t", &varid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_get_vara_unpack_double(ncid, varid, start, count, &t[0][0]);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+*/
+int
+nc_get_vara_unpack_double(int ncid, int varid, const size_t *startp,
+			  const size_t *countp, double *ip)
+{
+    return NC_get_vara_unpack(ncid, varid, startp, countp, (void *)ip,
+			      NC_DOUBLE);
+}
+
+/** \ingroup variables
+Read a hyperslab of a packed variable and unpack it to floats. See
+nc_get_vara_unpack_double(); the unpacking is done in double
+precision and then rounded to float.
+*/
+int
+nc_get_vara_unpack_float(int ncid, int varid, const size_t *startp,
+			 const size_t *countp, float *ip)
+{
+    return NC_get_vara_unpack(ncid, varid, startp, countp, (void *)ip,
+			      NC_FLOAT);
+}
+/** \} */
@@ -517,6 +517,39 @@ NC_getshape(int ncid, int varid, int ndims, size_t* shape)
    return status;
 }
 
+/** \internal
+\ingroup variables
+Fill in a hyperslab given without its start or count. A NULL start is
+the first index of each dimension, and a NULL count runs to the end
+of each dimension. If either is filled in, it is stored in start or
+count, and *startp or *countp points to it.
+ */
+int
+NC_fill_slab(int ncid, int varid, const size_t** startp,
+	     const size_t** countp, size_t* start, size_t* count)
+{
+   size_t shape[NC_MAX_VAR_DIMS];
+   int ndims, d;
+   int status = NC_NOERR;
+
+   if (*startp && *countp)
+      return NC_NOERR;
+   if ((status = nc_inq_varndims(ncid, varid, &ndims)))
+      return status;
+   if ((status = NC_getshape(ncid, varid, ndims, shape)))
+      return status;
+   for (d = 0; d < ndims; d++) {
+      start[d] = *startp ? (*startp)[d] : 0;
+      if (*countp)
+	 count[d] = (*countp)[d];
+      else
+	 count[d] = start[d] < shape[d] ? shape[d] - start[d] : 0;
+   }
+   *startp = start;
+   *countp = count;
+   return NC_NOERR;
+}
+
 #ifdef USE_NETCDF4
 /** \ingroup variables
 
@@ -614,6 +647,23 @@ nc_free_string(size_t len, char **data)
    return NC_NOERR;
 }
 
+/** \ingroup variables
+Free the memory of the strings or vlens read by nc_get_vara_packed().
+
+All the values of a packed read are in one block of memory, which is
+freed with this one call, however many values were read.
+
+\param data The block of memory, as returned by nc_get_vara_packed().
+
+\returns ::NC_NOERR No error.
+*/
+int
+nc_free_packed(void *data)
+{
+   free(data);
+   return NC_NOERR;
+}
+
 int
 nc_def_var_deflate(int ncid, int varid, int shuffle, int deflate, int deflate_level)
 {
@@ -662,3 +712,331 @@ nc_def_var_endian(int ncid, int varid, int endian)
 }
 
 #endif /* USE_NETCDF4 */
+
+/** \ingroup variables
+Turn on quantization for a variable.
+
+Quantization zeroes the bits of the mantissa of each value written
+that are not needed to keep its first \p nsd significant decimal
+digits (::NC_QUANTIZE_BITGROOM) or its first \p nsd significant bits
+(::NC_QUANTIZE_BITROUND). The data is changed, within that precision,
+but noisy fields then compress much better with the shuffle and
+deflate filters set with nc_def_var_deflate().
+
+With ::NC_QUANTIZE_BITGROOM the bits are alternately shaved to zero
+and set to one, so that the mean of the errors is close to zero; with
+::NC_QUANTIZE_BITROUND each value is rounded to the nearest value with
+\p nsd bits. Fill values, NaNs and infinities are written as they are.
+
+The setting is recorded in an attribute of the variable named
+::NC_QUANTIZE_BITGROOM_ATT_NAME or ::NC_QUANTIZE_BITROUND_ATT_NAME,
+so readers can tell the precision of the data, and it stays in force
+when the file is opened again.
+
+This must be called after nc_def_var() and before nc_enddef().
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be of type ::NC_FLOAT or
+::NC_DOUBLE.
+
+\param quantize_mode ::NC_QUANTIZE_BITGROOM, ::NC_QUANTIZE_BITROUND,
+or ::NC_NOQUANTIZE to turn quantization off.
+
+\param nsd The number of significant digits to keep, 1 to 7 for
+floats and 1 to 15 for doubles with ::NC_QUANTIZE_BITGROOM; or the
+number of significant bits, 1 to 23 for floats and 1 to 52 for doubles
+with ::NC_QUANTIZE_BITROUND. Ignored for ::NC_NOQUANTIZE.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_ELATEDEF Too late to change settings for this variable.
+\returns ::NC_EINVAL The variable is not a float or double, or the mode
+or \p nsd is out of range.
+*/
+int
+nc_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->def_var_quantize(ncid,varid,quantize_mode,nsd);
+}
+
+/** \ingroup variables
+Set a filter to compress the data of a variable.
+
+Any HDF5 filter can be used, by its registered id, with the params it
+takes: those built into HDF5, those registered by the program with
+H5Zregister(), those loaded by HDF5 from the plugin directories of
+HDF5_PLUGIN_PATH, and ::NC_FILTER_LZ4, which is built into netCDF.
+The filter is applied after shuffle, if it is turned on with
+nc_def_var_deflate(), and before deflate and the fletcher32
+checksum. A variable has one filter set this way; setting another
+replaces it, and an id of 0 removes it.
+
+Readers of the file need the filter too. Data compressed with
+::NC_FILTER_LZ4 can be read by any netCDF library from this version
+on, and by other HDF5 programs with the LZ4 filter plugin.
+
+The HDF5 deflate filter, id 1, with the level as its param, is the
+same as nc_def_var_deflate() without shuffle.
+
+This must be called after nc_def_var() and before nc_enddef(). The
+variable is made chunked, with the default chunk sizes if none have
+been set. Scalar variables can't be chunked, and the filter is
+ignored for them.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID.
+
+\param id Id of the HDF5 filter, or 0 for none.
+
+\param nparams Number of params of the filter.
+
+\param params The params of the filter.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_ELATEDEF Too late to change settings for this variable.
+\returns ::NC_EFILTER The filter is not available to compress data.
+\returns ::NC_EINVAL Bad params, or a file opened for parallel access.
+*/
+int
+nc_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+                  const unsigned int *params)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->def_var_filter(ncid,varid,id,nparams,params);
+}
+
+/** \ingroup variables
+Read a chunk of a variable as it is stored.
+
+The chunk is returned as it is in the file, after any filters such as
+shuffle and deflate, in the byte order of the variable, so that it can
+be written to a variable with the same type, chunking and filters in
+another file with nc_put_chunk_raw(), without being decompressed and
+compressed again.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be a chunked variable of a netCDF-4
+file.
+
+\param startp Index of the first element of the chunk, which must be
+a multiple of the chunk sizes.
+
+\param filter_maskp Pointer to location for the returned mask of the
+filters that were skipped when the chunk was written, one bit for each
+filter in the order they are applied. Ignored if NULL.
+
+\param sizep Pointer to location for the returned size of the chunk
+in bytes, which is 0 if the chunk has not been written. Ignored if
+NULL.
+
+\param data Pointer to a buffer of at least that size for the chunk.
+If NULL, only the mask and size are returned.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EINVAL The variable is not chunked, or \p startp is not
+the start of a chunk.
+\returns ::NC_EINVALCOORDS The chunk is outside the data of the
+variable.
+\returns ::NC_ENOTBUILT The library was built with a version of HDF5
+without direct chunk I/O.
+*/
+int
+nc_get_chunk_raw(int ncid, int varid, const size_t *startp,
+                 unsigned int *filter_maskp, size_t *sizep, void *data)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->get_chunk_raw(ncid,varid,startp,filter_maskp,
+					sizep,data);
+}
+
+/** \ingroup variables
+Write a chunk of a variable as it is to be stored.
+
+The chunk is written to the file as it is, so it must already have
+been through the filters of the variable, as a chunk read with
+nc_get_chunk_raw() from a variable with the same type, chunking and
+filters, in the same order, has. The library does not check this;
+nc_inq_var_filter_ids() gives the order of the filters of each
+variable.
+
+The chunk must be within the extent of the variable. To write chunks
+along an unlimited dimension, first write the last value of the
+variable with nc_put_var1() or similar, to extend it.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be a chunked variable of a netCDF-4
+file.
+
+\param startp Index of the first element of the chunk, which must be
+a multiple of the chunk sizes.
+
+\param filter_mask The mask of the filters that were skipped for this
+chunk, as returned by nc_get_chunk_raw(); usually 0.
+
+\param size The size of the chunk in bytes.
+
+\param data Pointer to the chunk.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EPERM The file is open read-only.
+\returns ::NC_EINVAL The variable is not chunked, \p startp is not the
+start of a chunk, or \p size is 0.
+\returns ::NC_EINVALCOORDS The chunk is outside the extent of the
+variable.
+\returns ::NC_ENOTBUILT The library was built with a version of HDF5
+without direct chunk I/O.
+*/
+int
+nc_put_chunk_raw(int ncid, int varid, const size_t *startp,
+                 unsigned int filter_mask, size_t size, const void *data)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->put_chunk_raw(ncid,varid,startp,filter_mask,
+					size,data);
+}
+
+/** \ingroup variables
+Call a function for each stored chunk of a variable.
+
+The chunks that have been written are visited in the order of their
+place in the variable, last dimension fastest, and \p fn is called
+with the index of the first element of the chunk, its filter mask and
+its size in bytes, as nc_get_chunk_raw() would return them. Chunks
+that have never been written, which read as fill values, are
+skipped.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. It must be a chunked variable of a netCDF-4
+file.
+
+\param fn The function to call. If it returns non-zero, the iteration
+stops and that value is returned.
+
+\param udata Pointer passed on to \p fn.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EINVAL The variable is not chunked, or \p fn is NULL.
+\returns ::NC_ENOTBUILT The library was built with a version of HDF5
+without direct chunk I/O.
+
+<h1>Example</h1>
+
+Here is an example copying the stored chunks of a variable to a
+variable with the same type, chunking and filters in another file.
+
+\code
+     struct copy {int ncid_in, varid_in, ncid_out, varid_out; char *buf;};
+
+     static int
+     copy_chunk(const size_t *startp, unsigned int mask, size_t size, void *udata)
+     {
+        struct copy *c = udata;
+        int status;
+
+        if ((status = nc_get_chunk_raw(c->ncid_in, c->varid_in, startp,
+                                       &mask, &size, c->buf)))
+           return status;
+        return nc_put_chunk_raw(c->ncid_out, c->varid_out, startp, mask,
+                                size, c->buf);
+     }
+        ...
+     status = nc_iter_chunks_raw(ncid_in, varid_in, copy_chunk, &c);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+*/
+int
+nc_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void *udata)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->iter_chunks_raw(ncid,varid,fn,udata);
+}
+
+/** \ingroup variables
+Call a function for each block of the data of a variable in the file.
+
+This tells where the data of a variable is in the file, so that
+programs can read it with plain reads, in parallel and without the
+library. Each block is given by the index of its first element and its
+shape in the variable, its offset and size in bytes in the file, and
+the mask of the filters that were skipped for it.
+
+For a chunked variable of a netCDF-4 file the blocks are its stored
+chunks, in the order of their place in the variable, last dimension
+fastest, compressed with the filters of the variable. Chunks that have
+never been written, which read as fill values, are skipped, and the
+shape of a chunk at the edge of the data may extend past it. A
+contiguous variable of a netCDF-4 file is one block, unless it has not
+been written yet. The data is in the byte order of the variable.
+
+For a classic file a variable without the unlimited dimension is one
+block, and a record variable has a block in each record. The data is
+big-endian and not filtered.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID.
+
+\param fn The function to call. If it returns non-zero, the iteration
+stops and that value is returned.
+
+\param udata Pointer passed on to \p fn.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_EINDEFINE A classic file is in define mode, so its data
+has not been placed.
+\returns ::NC_EINVAL \p fn is NULL, or the dataset is not a local file.
+\returns ::NC_ENOTBUILT The variable is chunked and the library was
+built with a version of HDF5 without direct chunk I/O.
+*/
+int
+nc_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void *udata)
+{
+    NC* ncp;
+    int stat = NC_check_id(ncid,&ncp);
+    if(stat != NC_NOERR) return stat;
+    return ncp->dispatch->iter_byte_ranges(ncid,varid,fn,udata);
+}
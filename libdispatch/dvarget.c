@@ -265,6 +265,67 @@ NC_get_var1(int ncid, int varid, const size_t *coord, void* value,
    return NC_get_vara(ncid, varid, coord, NC_coord_one, value, memtype);
 }
 
+/** \internal
+\ingroup variables
+Read scattered points one at a time through get_vara. Dispatch
+tables with no better way to batch the points use this.
+ */
+int
+NCDEFAULT_get_var_points(int ncid, int varid, size_t npoints,
+	    const size_t *indexp, void *value0, nc_type memtype)
+{
+   int status = NC_NOERR;
+   nc_type vartype = NC_NAT;
+   int varndims;
+   size_t memtypelen, i;
+   NC* ncp;
+   char* value = (char*)value0;
+
+   status = NC_check_id(ncid, &ncp);
+   if(status != NC_NOERR) return status;
+
+   status = nc_inq_vartype(ncid, varid, &vartype);
+   if(status != NC_NOERR) return status;
+   status = nc_inq_varndims(ncid, varid, &varndims);
+   if(status != NC_NOERR) return status;
+   if(memtype == NC_NAT) {
+      status = nc_inq_type(ncid, vartype, NULL, &memtypelen);
+      if(status != NC_NOERR) return status;
+   } else
+      memtypelen = (size_t)nctypelen(memtype);
+
+   for(i = 0; i < npoints; i++) {
+      int lstatus = ncp->dispatch->get_vara(ncid, varid,
+			indexp + i * (size_t)varndims, NC_coord_one,
+			value + i * memtypelen, memtype);
+      if(lstatus != NC_NOERR) {
+         if(lstatus != NC_ERANGE)
+            return lstatus;
+         /* else NC_ERANGE, not fatal for the loop */
+         status = lstatus;
+      }
+   }
+   return status;
+}
+
+/** \internal
+\ingroup variables
+ */
+static int
+NC_get_var_points(int ncid, int varid, size_t npoints,
+		  const size_t *indexp, void *value, nc_type memtype)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+#ifdef USE_NETCDF4
+   if(memtype >= NC_FIRSTUSERTYPEID) memtype = NC_NAT;
+#endif
+   if(npoints > 0 && indexp == NULL) return NC_EINVAL;
+   return ncp->dispatch->get_var_points(ncid, varid, npoints, indexp,
+					value, memtype);
+}
+
 /** \internal
 \ingroup variables
  */
@@ -1611,4 +1672,361 @@ nc_get_varm_string(int ncid, int varid, const size_t *startp,
 #endif /*USE_NETCDF4*/
 
 
+/** \ingroup variables
+Read the values at many scattered indices of a variable.
+
+This does what a loop of nc_get_var1() calls over the indices would
+do, but in one call: the points are read in the order they are laid
+out in the file, so that each chunk (netCDF-4) or file block
+(classic) they fall in is read only once, and the values are stored
+in the order of the indices given.
+
+The nc_get_var_points() function will read a variable of any type,
+including user defined type. For this function, the type of the data
+in memory must match the type of the variable - no data conversion is
+done. Other nc_get_var_points_ functions will convert data to the
+desired output type as needed.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID
+
+\param npoints Number of points to read.
+
+\param indexp Indices of the points, one index vector (with one
+element for each dimension) after another, npoints of them in all.
+
+\param ip Pointer where the npoints values will be copied. Memory
+must be allocated by the user before this function is called.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_ERANGE One or more of the values are out of range.
+\returns ::NC_EINDEFINE Operation not allowed in define mode.
+\returns ::NC_EINVAL No indices given for a nonzero number of points.
+\returns ::NC_EBADID Bad ncid.
+
+\section nc_get_var_points_example Example
+
+Here is an example of reading a time series at three stations of a
+gridded variable:
+
+\code
+     #include <netcdf.h>
+        ...
+     #define NSTATIONS 3
+     int  status, ncid, varid;
+     size_t index[NSTATIONS][3] = {{0, 12, 7}, {0, 40, 201}, {0, 88, 3}};
+     float vals[NSTATIONS];
+        ...
+     status = nc_open("foo.nc", NC_NOWRITE, &ncid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_inq_varid (ncid, "rh", &varid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_get_var_points_float(ncid, varid, NSTATIONS, &index[0][0], vals);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+*/
+/** \{ */
+int
+nc_get_var_points(int ncid, int varid, size_t npoints,
+		  const size_t *indexp, void *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, ip, NC_NAT);
+}
+
+int
+nc_get_var_points_text(int ncid, int varid, size_t npoints,
+                       const size_t *indexp, char *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_CHAR);
+}
+
+int
+nc_get_var_points_schar(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, signed char *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_BYTE);
+}
+
+int
+nc_get_var_points_uchar(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, unsigned char *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_UBYTE);
+}
+
+int
+nc_get_var_points_short(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, short *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_SHORT);
+}
+
+int
+nc_get_var_points_int(int ncid, int varid, size_t npoints,
+                      const size_t *indexp, int *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_INT);
+}
+
+int
+nc_get_var_points_long(int ncid, int varid, size_t npoints,
+                       const size_t *indexp, long *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    longtype);
+}
+
+int
+nc_get_var_points_float(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, float *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_FLOAT);
+}
+
+int
+nc_get_var_points_double(int ncid, int varid, size_t npoints,
+                         const size_t *indexp, double *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_DOUBLE);
+}
+
+int
+nc_get_var_points_ubyte(int ncid, int varid, size_t npoints,
+                        const size_t *indexp, unsigned char *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_UBYTE);
+}
+
+int
+nc_get_var_points_ushort(int ncid, int varid, size_t npoints,
+                         const size_t *indexp, unsigned short *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_USHORT);
+}
+
+int
+nc_get_var_points_uint(int ncid, int varid, size_t npoints,
+                       const size_t *indexp, unsigned int *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_UINT);
+}
+
+int
+nc_get_var_points_longlong(int ncid, int varid, size_t npoints,
+                           const size_t *indexp, long long *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_INT64);
+}
+
+int
+nc_get_var_points_ulonglong(int ncid, int varid, size_t npoints,
+                            const size_t *indexp, unsigned long long *ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_UINT64);
+}
+
+#ifdef USE_NETCDF4
+int
+nc_get_var_points_string(int ncid, int varid, size_t npoints,
+			 const size_t *indexp, char **ip)
+{
+   return NC_get_var_points(ncid, varid, npoints, indexp, (void *)ip,
+			    NC_STRING);
+}
+#endif /*USE_NETCDF4*/
+/** \} */
+
+/** \ingroup variables
+Read one field of the compound values of a hyperslab of a variable.
+
+Instead of whole compound values, only the field given is read, and
+the values of that field are stored one after another, with nothing
+between them. Reading one small field of a large compound type needs
+only a buffer big enough for that field, and only that field is
+copied and converted from the data in the file.
+
+The values stored for the field are as nc_get_vara() would leave them
+in that field of the compound values: an array field holds all of its
+elements for each value, and fields of variable length (strings and
+vlens) hold memory that the caller must free.
+
+This function is only available for netCDF-4 files.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID. The type of the variable must be a
+compound type.
+
+\param fieldid Zero-based index of the field within the compound
+type, as for nc_inq_compound_field().
+
+\param startp Start index vector, as for nc_get_vara(). If NULL, the
+hyperslab starts at the first value of each dimension.
+
+\param countp Count vector, as for nc_get_vara(). If NULL, the
+hyperslab runs to the end of each dimension.
+
+\param ip Pointer where the field of each value is stored. Memory
+must be allocated by the user for count values of the size of the
+field.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EBADTYPE The variable is not of a compound type.
+\returns ::NC_EBADFIELD Bad field id.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EBADID Bad ncid.
+
+\section nc_get_vara_field_example Example
+
+Here is an example of reading the temperatures of a variable of
+observation records, each of which is a compound value with many
+fields:
+
+\code
+     #include <netcdf.h>
+        ...
+     int  status, ncid, varid, fieldid;
+     size_t nobs;
+     float *temps;
+        ...
+     status = nc_open("obs.nc", NC_NOWRITE, &ncid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     status = nc_inq_varid(ncid, "obs", &varid);
+     if (status != NC_NOERR) handle_error(status);
+     status = nc_inq_compound_fieldindex(ncid, obs_typeid, "temp", &fieldid);
+     if (status != NC_NOERR) handle_error(status);
+        ...
+     temps = malloc(nobs * sizeof(float));
+     status = nc_get_vara_field(ncid, varid, fieldid, NULL, NULL, temps);
+     if (status != NC_NOERR) handle_error(status);
+\endcode
+*/
+int
+nc_get_vara_field(int ncid, int varid, int fieldid, const size_t *startp,
+		  const size_t *countp, void *ip)
+{
+   NC* ncp;
+   size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   stat = NC_fill_slab(ncid, varid, &startp, &countp, start, count);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->get_vara_field(ncid, varid, fieldid, startp, countp,
+					ip);
+}
+
+/** \ingroup variables
+Read the strings or vlens of a hyperslab of a variable into one block
+of memory.
+
+Reading a variable of strings with nc_get_vara_string(), or of vlens
+with nc_get_vara(), gives each value its own allocation, which must
+then be freed, one value at a time, with nc_free_string() or
+nc_free_vlens(). This function instead packs all the values read, one
+after another, into one block of memory, freed with one call to
+nc_free_packed(). The library does not allocate memory for each value
+as it reads them either.
+
+For each value, offsetsp holds the offset in bytes of the value in
+the block, and after the last value, the size of the block. Each
+string is stored with its terminating NUL, so value i is the string
+starting at offset offsetsp[i], of length offsetsp[i+1] - offsetsp[i]
+- 1. A NULL string is read as an empty one. Each vlen is stored as
+its values of the base type, so value i is (offsetsp[i+1] -
+offsetsp[i]) / (size of the base type) values long.
+
+The variable must be of type ::NC_STRING, or of a vlen type of a base
+type that holds no strings or vlens itself. This function is only
+available for netCDF-4 files. nc_put_vara_packed() writes values laid
+out in the same way.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID.
+
+\param startp Start index vector, as for nc_get_vara(). If NULL, the
+hyperslab starts at the first value of each dimension.
+
+\param countp Count vector, as for nc_get_vara(). If NULL, the
+hyperslab runs to the end of each dimension.
+
+\param offsetsp Pointer where the offsets of the values are stored,
+one more than the number of values. Memory must be allocated by the
+user before this function is called.
+
+\param datap Pointer where a pointer to the block of memory holding
+the values is stored. It must be freed with nc_free_packed().
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EBADTYPE Variable is not of strings, or of vlens of a
+fixed size type.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_EINVAL No offsetsp or datap.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_ENOMEM Out of memory.
+\returns ::NC_EBADID Bad ncid.
+
+\section nc_get_vara_packed_example Example
+
+Here is an example of reading the station names of a variable of
+strings:
+
+\code
+     #include <netcdf.h>
+        ...
+     int  status, ncid, varid;
+     size_t offsets[NSTATIONS + 1], i;
+     char *names;
+        ...
+     status = nc_get_vara_packed(ncid, varid, NULL, NULL, offsets, (void **)&names);
+     if (status != NC_NOERR) handle_error(status);
+     for (i = 0; i < NSTATIONS; i++)
+        printf("%s\n", names + offsets[i]);
+     nc_free_packed(names);
+\endcode
+*/
+int
+nc_get_vara_packed(int ncid, int varid, const size_t *startp,
+		   const size_t *countp, size_t *offsetsp, void **datap)
+{
+   NC* ncp;
+   size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   if(offsetsp == NULL || datap == NULL) return NC_EINVAL;
+   stat = NC_fill_slab(ncid, varid, &startp, &countp, start, count);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->get_vara_packed(ncid, varid, startp, countp,
+					 offsetsp, datap);
+}
+
 /*! \} */ /* End of named group... */
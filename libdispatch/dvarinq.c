@@ -571,6 +571,114 @@ nc_inq_unlimdims(int ncid, int *nunlimdimsp, int *unlimdimidsp)
 
 #endif /* USE_NETCDF4 */
 
+/** \ingroup variables
+Learn the quantization settings of a variable.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID
+
+\param quantize_modep ::NC_NOQUANTIZE, ::NC_QUANTIZE_BITGROOM or
+::NC_QUANTIZE_BITROUND will be written here; see
+nc_def_var_quantize(). \ref ignored_if_null.
+
+\param nsdp The number of significant digits or bits kept will be
+written here, or 0 without quantization. \ref ignored_if_null.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+*/
+int
+nc_inq_var_quantize(int ncid, int varid, int *quantize_modep, int *nsdp)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid,&ncp);
+   if(stat != NC_NOERR) return stat;
+   TRACE(nc_inq_var_quantize);
+   return ncp->dispatch->inq_var_quantize(ncid, varid, quantize_modep, nsdp);
+}
+
+/** \ingroup variables
+Learn the filter of a variable, set with nc_def_var_filter(), or
+found in the file when it is opened.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID
+
+\param idp The id of the filter, or 0 if there is none, will be
+written here. \ref ignored_if_null.
+
+\param nparamsp The number of params of the filter will be written
+here. \ref ignored_if_null.
+
+\param params The params of the filter will be written here; call
+first with a NULL pointer to learn how many there are. \ref
+ignored_if_null.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+*/
+int
+nc_inq_var_filter(int ncid, int varid, unsigned int *idp, size_t *nparamsp,
+                  unsigned int *params)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid,&ncp);
+   if(stat != NC_NOERR) return stat;
+   TRACE(nc_inq_var_filter);
+   return ncp->dispatch->inq_var_filter(ncid, varid, idp, nparamsp, params);
+}
+
+/** \ingroup variables
+Learn the ids of all the HDF5 filters of a variable, in the order they
+are applied to its chunks when they are written.
+
+This includes shuffle, deflate, szip and fletcher32 as well as the
+filter set with nc_def_var_filter(). The order matters to the raw
+chunks of nc_get_chunk_raw(), and to their filter masks: chunks can
+only be copied as they are stored between variables with the same
+filters, with the same params, in the same order. Files written by
+other programs may have the filters in another order than the one
+this library uses.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID
+
+\param nfiltersp The number of filters will be written here. \ref
+ignored_if_null.
+
+\param ids The ids of the filters will be written here; call first
+with a NULL pointer to learn how many there are. \ref ignored_if_null.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EBADID Bad ncid.
+\returns ::NC_ENOTVAR Invalid variable ID.
+\returns ::NC_EHDFERR Error reading the filters from the file.
+*/
+int
+nc_inq_var_filter_ids(int ncid, int varid, size_t *nfiltersp,
+                      unsigned int *ids)
+{
+   NC* ncp;
+   int stat = NC_check_id(ncid,&ncp);
+   if(stat != NC_NOERR) return stat;
+   TRACE(nc_inq_var_filter_ids);
+   return ncp->dispatch->inq_var_filter_ids(ncid, varid, nfiltersp, ids);
+}
+
 /**
 \internal
 \ingroup variables
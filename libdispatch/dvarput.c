@@ -1543,5 +1543,62 @@ nc_put_varm_string(int ncid, int varid,
 #endif /*USE_NETCDF4*/
 /**\} */
 
+/** \ingroup variables
+Write the strings or vlens of a hyperslab of a variable from one block
+of memory.
+
+The values are laid out as nc_get_vara_packed() reads them: one after
+another in the block, with the offset in bytes of each value in
+offsetsp, followed by the offset of the end of the last value. Each
+string must be stored with its terminating NUL, as the last byte
+before the next offset, and each vlen as whole values of its base
+type. The values are written from where they are in the block,
+without being copied.
+
+\param ncid NetCDF or group ID, from a previous call to nc_open(),
+nc_create(), nc_def_grp(), or associated inquiry functions such as
+nc_inq_ncid().
+
+\param varid Variable ID.
+
+\param startp Start index vector, as for nc_put_vara(). If NULL, the
+hyperslab starts at the first value of each dimension.
+
+\param countp Count vector, as for nc_put_vara(). If NULL, the
+hyperslab runs to the end of each dimension.
+
+\param offsetsp The offsets of the values, one more than the number
+of values.
+
+\param data The block of memory holding the values.
+
+\returns ::NC_NOERR No error.
+\returns ::NC_ENOTVAR Variable not found.
+\returns ::NC_EBADTYPE Variable is not of strings, or of vlens of a
+fixed size type.
+\returns ::NC_EINVALCOORDS Index exceeds dimension bound.
+\returns ::NC_EEDGE Start+count exceeds dimension bound.
+\returns ::NC_EINVAL Offsets out of order, a string without its NUL,
+or a vlen that is not whole values of its base type.
+\returns ::NC_EPERM Attempt to write to a read-only file.
+\returns ::NC_ENOTNC4 Not a netCDF-4 file.
+\returns ::NC_EBADID Bad ncid.
+*/
+int
+nc_put_vara_packed(int ncid, int varid, const size_t *startp,
+		   const size_t *countp, const size_t *offsetsp,
+		   const void *data)
+{
+   NC* ncp;
+   size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+   int stat = NC_check_id(ncid, &ncp);
+   if(stat != NC_NOERR) return stat;
+   if(offsetsp == NULL || data == NULL) return NC_EINVAL;
+   stat = NC_fill_slab(ncid, varid, &startp, &countp, start, count);
+   if(stat != NC_NOERR) return stat;
+   return ncp->dispatch->put_vara_packed(ncid, varid, startp, countp,
+					 offsetsp, data);
+}
+
 
 /*! \} */ /*End of named group... */
@@ -145,17 +145,20 @@ ffio_pgout(ncio *const nciop,
 
 	if(*posp != offset)
 	{
+		nciop->stats.nseek++;
 		if(ffseek(nciop->fd, offset, SEEK_SET) != offset)
 		{
 			return errno;
 		}
 		*posp = offset;
 	}
+	nciop->stats.nwrite++;
 	if(ffwrite(nciop->fd, vp, extent) != extent)
 	{
 		return errno;
 	}
 	*posp += extent;
+	nciop->stats.bytes_written += extent;
 
 	return NC_NOERR;
 }
@@ -176,6 +179,7 @@ ffio_pgin(ncio *const nciop,
 
 	if(*posp != offset)
 	{
+		nciop->stats.nseek++;
 		if(ffseek(nciop->fd, offset, SEEK_SET) != offset)
 		{
 			status = errno;
@@ -186,6 +190,7 @@ ffio_pgin(ncio *const nciop,
 
 	errno = 0;
 	nread = ffread(nciop->fd, vp, extent);
+	nciop->stats.nread++;
 	if(nread != extent)
 	{
 		status = errno;
@@ -195,6 +200,7 @@ ffio_pgin(ncio *const nciop,
 	}
 	*nreadp = nread;
 	*posp += nread;
+	nciop->stats.bytes_read += (unsigned long long)nread;
 
 	return NC_NOERR;
 }
@@ -293,6 +299,7 @@ ncio_ffio_get(ncio *const nciop,
 		if(ffp->bf_base == NULL)
 			return ENOMEM;
 		ffp->bf_extent = extent;
+		ncio_set_memory(nciop, extent);
 	}
 
 	status = ffio_pgin(nciop, offset,
@@ -302,6 +309,11 @@ ncio_ffio_get(ncio *const nciop,
 	if(status != NC_NOERR)
 		return status;
 
+	/* ffio does its own buffering below us; every get is a fault here */
+	nciop->stats.cache_misses++;
+	if(fIsSet(rflags, RGN_WRITE) && ffp->bf_cnt > 0)
+		nciop->stats.nrmw++;
+
 	ffp->bf_offset = offset;
 
 	if(ffp->bf_cnt < extent)
@@ -447,6 +459,7 @@ ncio_ffio_init2(ncio *const nciop, size_t *sizehintp)
 		ffp->bf_extent = 0;
 		return ENOMEM;
 	}
+	ncio_set_memory(nciop, ffp->bf_extent);
 	/* else */
 	return NC_NOERR;
 }
@@ -510,6 +523,8 @@ ncio_ffio_new(const char *path, int ioflags)
 	
 	nciop->ioflags = ioflags;
 	*((int *)&nciop->fd) = -1; /* cast away const */
+	(void) memset(&nciop->stats, 0, sizeof(nciop->stats));
+	nciop->memory = 0;
 
 	nciop->path = (char *) ((char *)nciop + sz_ncio);
 	(void) strcpy((char *)nciop->path, path); /* cast away const */
@@ -672,6 +687,9 @@ ffio_create(const char *path, int ioflags,
 		*sizehintp = M_RNDUP(*sizehintp);
 	}
 
+	/* Keep the buffer within the memory budget */
+	*sizehintp = ncio_budget_blksz(*sizehintp, 1, NCIO_MINBLOCKSIZE);
+
 	status = ncio_ffio_init2(nciop, sizehintp);
 	if(status != NC_NOERR)
 		goto unwind_open;
@@ -764,6 +782,9 @@ ffio_open(const char *path,
 		*sizehintp = M_RNDUP(*sizehintp);
 	}
 
+	/* Keep the buffer within the memory budget */
+	*sizehintp = ncio_budget_blksz(*sizehintp, 1, NCIO_MINBLOCKSIZE);
+
 	status = ncio_ffio_init2(nciop, sizehintp);
 	if(status != NC_NOERR)
 		goto unwind_open;
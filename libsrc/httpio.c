@@ -0,0 +1,657 @@
+/*
+ *	Copyright 2016, University Corporation for Atmospheric Research
+ *	See netcdf/COPYRIGHT file for copying and redistribution conditions.
+ */
+
+/*
+ * Read-only ncio package that accesses a remote classic (CDF-1, CDF-2
+ * or CDF-5) file using HTTP byte-range requests. It is selected when
+ * nc_open() is given a url with the client parameter mode=bytes,
+ * e.g. "https://host/path/file.nc#mode=bytes".
+ *
+ * The remote file is viewed as a sequence of fixed size blocks. A
+ * small LRU cache of blocks is kept; a get() that misses fetches all
+ * of its missing blocks with a single range request (coalescing the
+ * missing pieces), extended by an adaptive readahead window when the
+ * access pattern looks sequential. Gets that are too large for the
+ * cache bypass it and are read directly.
+ *
+ * The following optional client parameters tune the behavior:
+ *   blocksize=<bytes>  size of a cache block (default 64 KiB)
+ *   cachesize=<bytes>  total size of the block cache (default 4 MiB)
+ *   readahead=<n>      maximum number of readahead blocks (default 16)
+ */
+
+#include "config.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif
+#include <curl/curl.h>
+
+#include "ncdispatch.h"
+#include "ncio.h"
+#include "fbits.h"
+#include "ncuri.h"
+
+#undef DEBUG
+
+#undef MIN  /* system may define MIN somewhere and complain */
+#define MIN(mm,nn) (((mm) < (nn)) ? (mm) : (nn))
+
+#define HTTPIO_BLOCKSIZE   65536
+#define HTTPIO_CACHESIZE   (64*HTTPIO_BLOCKSIZE)
+#define HTTPIO_READAHEAD   16
+#define HTTPIO_MINBLOCKS   4
+
+/* One cached block of the remote file */
+typedef struct NCHTTPBLOCK {
+    off_t index;           /* block number in the file; -1 => unused */
+    char* data;            /* blocksize bytes */
+    unsigned long lastuse; /* LRU clock value */
+} NCHTTPBLOCK;
+
+/* Private data for httpio */
+typedef struct NCHTTPIO {
+    CURL* curl;
+    char* url;        /* url without client parameters */
+    off_t size;       /* size of the remote file */
+    size_t blocksize;
+    size_t nblocks;   /* # of cache slots */
+    NCHTTPBLOCK* blocks;
+    unsigned long clock;
+    size_t readahead; /* max readahead in blocks */
+    size_t window;    /* current readahead window in blocks */
+    off_t nextblock;  /* block following the last fetch */
+    int locked;       /* a region is outstanding */
+    NCHTTPBLOCK* pinned; /* block holding the outstanding region, if any */
+    char* region;     /* buffer for regions spanning blocks */
+    size_t regionalloc;
+    nc_io_stats_t* stats; /* counters of the owning ncio */
+    ncio* owner;      /* the owning ncio, which is charged for the blocks */
+} NCHTTPIO;
+
+/* State for one range request */
+typedef struct NCHTTPFETCH {
+    CURL* curl;
+    char** bufs;      /* destination buffers, each bufsize bytes */
+    size_t bufsize;
+    size_t count;     /* # of bytes wanted */
+    size_t pos;       /* # of bytes stored so far */
+    off_t skip;       /* leading bytes to discard */
+    int checked;      /* response code has been examined */
+    off_t total;      /* total size from Content-Range, or -1 */
+} NCHTTPFETCH;
+
+/* Forward */
+static int httpio_rel(ncio *const nciop, off_t offset, int rflags);
+static int httpio_get(ncio *const nciop, off_t offset, size_t extent, int rflags, void **const vpp);
+static int httpio_move(ncio *const nciop, off_t to, off_t from, size_t nbytes, int rflags);
+static int httpio_sync(ncio *const nciop);
+static int httpio_filesize(ncio* nciop, off_t* filesizep);
+static int httpio_pad_length(ncio* nciop, off_t length);
+static int httpio_close(ncio* nciop, int);
+
+static void
+httpio_free(NCHTTPIO* http)
+{
+    size_t i;
+    if(http == NULL) return;
+    if(http->curl != NULL) curl_easy_cleanup(http->curl);
+    if(http->blocks != NULL) {
+        for(i=0;i<http->nblocks;i++)
+	    if(http->blocks[i].data != NULL) free(http->blocks[i].data);
+	free(http->blocks);
+    }
+    if(http->region != NULL) free(http->region);
+    if(http->url != NULL) free(http->url);
+    free(http);
+}
+
+static size_t
+httpio_paramsize(NCURI* uri, const char* key, size_t dfalt)
+{
+    const char* value = NULL;
+    long long n;
+    if(!ncurilookup(uri,key,&value) || value == NULL)
+	return dfalt;
+    n = atoll(value);
+    return (n > 0 ? (size_t)n : dfalt);
+}
+
+/* Pull the total file size out of a Content-Range header */
+static size_t
+httpio_headercallback(char* buffer, size_t size, size_t nitems, void* userdata)
+{
+    NCHTTPFETCH* fetch = (NCHTTPFETCH*)userdata;
+    size_t len = size*nitems;
+    const char* tag = "content-range:";
+    size_t taglen = strlen(tag);
+    if(len > taglen && strncasecmp(buffer,tag,taglen) == 0) {
+	char* slash = memchr(buffer,'/',len);
+	if(slash != NULL && slash[1] != '*')
+	    fetch->total = (off_t)atoll(slash+1);
+    }
+    return len;
+}
+
+static size_t
+httpio_writecallback(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    NCHTTPFETCH* fetch = (NCHTTPFETCH*)userdata;
+    size_t len = size*nmemb;
+    size_t avail = len;
+
+    if(!fetch->checked) {
+	long code = 0;
+	fetch->checked = 1;
+	/* A server that ignores the Range header answers 200 with the
+	   whole file; discard everything before the wanted range */
+	curl_easy_getinfo(fetch->curl,CURLINFO_RESPONSE_CODE,&code);
+	if(code != 200) fetch->skip = 0;
+    }
+    if(fetch->skip > 0) {
+	size_t n = ((off_t)avail < fetch->skip ? avail : (size_t)fetch->skip);
+	fetch->skip -= (off_t)n;
+	ptr += n;
+	avail -= n;
+    }
+    while(avail > 0 && fetch->pos < fetch->count) {
+	size_t ibuf = fetch->pos / fetch->bufsize;
+	size_t off = fetch->pos % fetch->bufsize;
+	size_t n = MIN(avail,fetch->bufsize - off);
+	n = MIN(n,fetch->count - fetch->pos);
+	memcpy(fetch->bufs[ibuf]+off,ptr,n);
+	fetch->pos += n;
+	ptr += n;
+	avail -= n;
+    }
+    return len;
+}
+
+static int
+httpio_curlerror(CURLcode cstat)
+{
+    switch (cstat) {
+    case CURLE_OK: return NC_NOERR;
+    case CURLE_OUT_OF_MEMORY: return NC_ENOMEM;
+    case CURLE_FILE_COULDNT_READ_FILE:
+    case CURLE_REMOTE_FILE_NOT_FOUND: return ENOENT;
+    default: break;
+    }
+    return NC_EIO;
+}
+
+/* Issue one range request for count bytes starting at start,
+   storing the bytes sequentially across the buffers in bufs */
+static int
+httpio_fetch(NCHTTPIO* http, off_t start, size_t count, char** bufs, size_t bufsize)
+{
+    CURLcode cstat;
+    NCHTTPFETCH fetch;
+    char range[64];
+    long code = 0;
+
+    memset(&fetch,0,sizeof(fetch));
+    fetch.curl = http->curl;
+    fetch.bufs = bufs;
+    fetch.bufsize = bufsize;
+    fetch.count = count;
+    fetch.skip = start;
+    fetch.total = -1;
+
+    snprintf(range,sizeof(range),"%lld-%lld",
+	     (long long)start,(long long)(start+(off_t)count-1));
+#ifdef DEBUG
+fprintf(stderr,"httpio: fetch %s\n",range);
+#endif
+    curl_easy_setopt(http->curl,CURLOPT_NOBODY,0L);
+    curl_easy_setopt(http->curl,CURLOPT_HTTPGET,1L);
+    curl_easy_setopt(http->curl,CURLOPT_RANGE,range);
+    curl_easy_setopt(http->curl,CURLOPT_WRITEFUNCTION,httpio_writecallback);
+    curl_easy_setopt(http->curl,CURLOPT_WRITEDATA,&fetch);
+    curl_easy_setopt(http->curl,CURLOPT_HEADERFUNCTION,httpio_headercallback);
+    curl_easy_setopt(http->curl,CURLOPT_HEADERDATA,&fetch);
+    cstat = curl_easy_perform(http->curl);
+    curl_easy_setopt(http->curl,CURLOPT_RANGE,NULL);
+    if(cstat != CURLE_OK)
+	return httpio_curlerror(cstat);
+    curl_easy_getinfo(http->curl,CURLINFO_RESPONSE_CODE,&code);
+    if(code == 404) return ENOENT;
+    if(code >= 400) return NC_EIO;
+    http->stats->nread++;
+    http->stats->bytes_read += fetch.pos;
+    if(fetch.pos < count) {
+	/* Short read: the file ends before the range; zero the rest
+	   as posixio does for reads past EOF */
+	size_t pos = fetch.pos;
+	while(pos < count) {
+	    size_t off = pos % bufsize;
+	    size_t n = MIN(bufsize - off,count - pos);
+	    memset(bufs[pos/bufsize]+off,0,n);
+	    pos += n;
+	}
+    }
+    return NC_NOERR;
+}
+
+/* Determine the size of the remote file */
+static int
+httpio_probesize(NCHTTPIO* http)
+{
+    CURLcode cstat;
+    long code = 0;
+    NCHTTPFETCH fetch;
+    char byte[1];
+    char* bufs[1];
+#ifdef HAVE_CURLINFO_CONTENT_LENGTH_DOWNLOAD_T
+    curl_off_t length = -1;
+#else
+    double length = -1;
+#endif
+
+    memset(&fetch,0,sizeof(fetch));
+    fetch.total = -1;
+    curl_easy_setopt(http->curl,CURLOPT_NOBODY,1L);
+    curl_easy_setopt(http->curl,CURLOPT_HEADERFUNCTION,httpio_headercallback);
+    curl_easy_setopt(http->curl,CURLOPT_HEADERDATA,&fetch);
+    cstat = curl_easy_perform(http->curl);
+    if(cstat != CURLE_OK)
+	return httpio_curlerror(cstat);
+    curl_easy_getinfo(http->curl,CURLINFO_RESPONSE_CODE,&code);
+    if(code == 404) return ENOENT;
+    if(code >= 400) return NC_EIO;
+#ifdef HAVE_CURLINFO_CONTENT_LENGTH_DOWNLOAD_T
+    curl_easy_getinfo(http->curl,CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,&length);
+#else
+    curl_easy_getinfo(http->curl,CURLINFO_CONTENT_LENGTH_DOWNLOAD,&length);
+#endif
+    if(length >= 0) {
+	http->size = (off_t)length;
+	return NC_NOERR;
+    }
+    /* No Content-Length on HEAD; ask for one byte and use Content-Range */
+    bufs[0] = byte;
+    memset(&fetch,0,sizeof(fetch));
+    fetch.curl = http->curl;
+    fetch.bufs = bufs;
+    fetch.bufsize = 1;
+    fetch.count = 1;
+    fetch.total = -1;
+    curl_easy_setopt(http->curl,CURLOPT_NOBODY,0L);
+    curl_easy_setopt(http->curl,CURLOPT_HTTPGET,1L);
+    curl_easy_setopt(http->curl,CURLOPT_RANGE,"0-0");
+    curl_easy_setopt(http->curl,CURLOPT_WRITEFUNCTION,httpio_writecallback);
+    curl_easy_setopt(http->curl,CURLOPT_WRITEDATA,&fetch);
+    curl_easy_setopt(http->curl,CURLOPT_HEADERDATA,&fetch);
+    cstat = curl_easy_perform(http->curl);
+    curl_easy_setopt(http->curl,CURLOPT_RANGE,NULL);
+    if(cstat != CURLE_OK)
+	return httpio_curlerror(cstat);
+    if(fetch.total < 0)
+	return NC_EIO;
+    http->size = fetch.total;
+    return NC_NOERR;
+}
+
+int
+httpio_open(const char* path,
+    int ioflags,
+    off_t igeto, size_t igetsz, size_t* sizehintp,
+    void* parameters,
+    ncio* *nciopp, void** const mempp)
+{
+    int status = NC_NOERR;
+    ncio* nciop = NULL;
+    NCHTTPIO* http = NULL;
+    NCURI* uri = NULL;
+    size_t cachesize;
+    size_t i;
+
+    if(path == NULL || strlen(path) == 0)
+        return NC_EINVAL;
+    if(fIsSet(ioflags,NC_WRITE))
+	return NC_EPERM; /* remote files are read-only */
+    if(!ncuriparse(path,&uri))
+	return NC_EINVAL;
+
+    nciop = (ncio*)calloc(1,sizeof(ncio));
+    if(nciop == NULL) {status = NC_ENOMEM; goto fail;}
+    nciop->ioflags = ioflags;
+    *((int*)&nciop->fd) = nc__pseudofd();
+
+    *((ncio_relfunc**)&nciop->rel) = httpio_rel;
+    *((ncio_getfunc**)&nciop->get) = httpio_get;
+    *((ncio_movefunc**)&nciop->move) = httpio_move;
+    *((ncio_syncfunc**)&nciop->sync) = httpio_sync;
+    *((ncio_filesizefunc**)&nciop->filesize) = httpio_filesize;
+    *((ncio_pad_lengthfunc**)&nciop->pad_length) = httpio_pad_length;
+    *((ncio_closefunc**)&nciop->close) = httpio_close;
+
+    *((char**)&nciop->path) = strdup(path);
+    if(nciop->path == NULL) {status = NC_ENOMEM; goto fail;}
+
+    http = (NCHTTPIO*)calloc(1,sizeof(NCHTTPIO));
+    if(http == NULL) {status = NC_ENOMEM; goto fail;}
+    *((void**)&nciop->pvt) = http;
+    http->stats = &nciop->stats;
+    http->owner = nciop;
+
+    http->blocksize = httpio_paramsize(uri,"blocksize",HTTPIO_BLOCKSIZE);
+    cachesize = httpio_paramsize(uri,"cachesize",HTTPIO_CACHESIZE);
+    http->readahead = httpio_paramsize(uri,"readahead",HTTPIO_READAHEAD);
+    /* Blocks are allocated as they are first used, but the whole
+       cache must fit in the memory budget */
+    cachesize = ncio_budget_blksz(cachesize,1,HTTPIO_MINBLOCKS*http->blocksize);
+    http->nblocks = cachesize / http->blocksize;
+    if(http->nblocks < HTTPIO_MINBLOCKS)
+	http->nblocks = HTTPIO_MINBLOCKS;
+    /* Leave room in the cache for the blocks of the request itself */
+    if(http->readahead > http->nblocks/2)
+	http->readahead = http->nblocks/2;
+    http->nextblock = -1;
+
+    http->blocks = (NCHTTPBLOCK*)calloc(http->nblocks,sizeof(NCHTTPBLOCK));
+    if(http->blocks == NULL) {status = NC_ENOMEM; goto fail;}
+    for(i=0;i<http->nblocks;i++)
+	http->blocks[i].index = -1;
+
+    /* The client parameters are for us, not for the server */
+    http->url = ncuribuild(uri,NULL,NULL,NCURISTD);
+    if(http->url == NULL) {status = NC_ENOMEM; goto fail;}
+
+    http->curl = curl_easy_init();
+    if(http->curl == NULL) {status = NC_EIO; goto fail;}
+    curl_easy_setopt(http->curl,CURLOPT_URL,http->url);
+    curl_easy_setopt(http->curl,CURLOPT_FOLLOWLOCATION,1L);
+    curl_easy_setopt(http->curl,CURLOPT_NOPROGRESS,1L);
+    curl_easy_setopt(http->curl,CURLOPT_NOSIGNAL,1L);
+
+    if((status = httpio_probesize(http)))
+	goto fail;
+
+    if(igetsz != 0) {
+        status = nciop->get(nciop,igeto,igetsz,0,mempp);
+        if(status != NC_NOERR)
+            goto fail;
+    }
+
+    if(sizehintp) *sizehintp = http->blocksize;
+    *nciopp = nciop;
+    ncurifree(uri);
+    return NC_NOERR;
+
+fail:
+    if(uri != NULL) ncurifree(uri);
+    if(nciop != NULL) httpio_close(nciop,0);
+    return status;
+}
+
+/* Find the cache slot holding the given block, or NULL */
+static NCHTTPBLOCK*
+httpio_lookup(NCHTTPIO* http, off_t index)
+{
+    size_t i;
+    for(i=0;i<http->nblocks;i++) {
+	if(http->blocks[i].index == index)
+	    return &http->blocks[i];
+    }
+    return NULL;
+}
+
+/* Pick a slot for a new block: an unused slot, else the least
+   recently used one that is neither pinned nor in use by the
+   current request (whose blocks carry the current clock value). */
+static NCHTTPBLOCK*
+httpio_victim(NCHTTPIO* http)
+{
+    size_t i;
+    NCHTTPBLOCK* victim = NULL;
+    for(i=0;i<http->nblocks;i++) {
+	NCHTTPBLOCK* b = &http->blocks[i];
+	if(b == http->pinned || b->lastuse == http->clock) continue;
+	if(b->index < 0) return b;
+	if(victim == NULL || b->lastuse < victim->lastuse)
+	    victim = b;
+    }
+    return victim;
+}
+
+/* Make sure blocks first..last are in the cache */
+static int
+httpio_fault(NCHTTPIO* http, off_t first, off_t last)
+{
+    int status = NC_NOERR;
+    off_t lastblock = (http->size - 1) / (off_t)http->blocksize;
+    off_t lo = -1, hi = -1, b;
+    char** bufs = NULL;
+    size_t nbufs, count, i;
+
+    http->clock++;
+    /* Touch the cached blocks and find the span of missing ones */
+    for(b=first;b<=last;b++) {
+	NCHTTPBLOCK* blk = httpio_lookup(http,b);
+	if(blk != NULL)
+	    blk->lastuse = http->clock;
+	else {
+	    if(lo < 0) lo = b;
+	    hi = b;
+	}
+    }
+    if(lo < 0) return NC_NOERR; /* all hits */
+
+    /* Adapt the readahead window: grow it while reads are sequential */
+    if(lo == http->nextblock)
+	http->window = (http->window == 0 ? 1 : MIN(2*http->window,http->readahead));
+    else
+	http->window = 0;
+    if(hi == last) {
+	off_t ahead = hi + (off_t)http->window;
+	if(ahead > lastblock) ahead = lastblock;
+	while(hi < ahead && httpio_lookup(http,hi+1) == NULL)
+	    hi++;
+    }
+
+    /* Coalesce: the whole missing span is fetched with one request;
+       cached blocks inside the span are simply refreshed */
+    nbufs = (size_t)(hi - lo + 1);
+    bufs = (char**)calloc(nbufs,sizeof(char*));
+    if(bufs == NULL) return NC_ENOMEM;
+    for(i=0;i<nbufs;i++) {
+	NCHTTPBLOCK* blk = httpio_lookup(http,lo+(off_t)i);
+	if(blk == NULL) {
+	    blk = httpio_victim(http);
+	    if(blk == NULL) {status = NC_ENOMEM; goto done;}
+	    if(blk->data == NULL) {
+		blk->data = (char*)malloc(http->blocksize);
+		if(blk->data == NULL) {status = NC_ENOMEM; goto done;}
+		ncio_set_memory(http->owner,http->owner->memory+http->blocksize);
+	    }
+	    blk->index = lo+(off_t)i;
+	}
+	blk->lastuse = http->clock;
+	bufs[i] = blk->data;
+    }
+    count = nbufs * http->blocksize;
+    if(lo*(off_t)http->blocksize + (off_t)count > http->size)
+	count = (size_t)(http->size - lo*(off_t)http->blocksize);
+    status = httpio_fetch(http,lo*(off_t)http->blocksize,count,bufs,http->blocksize);
+    if(status != NC_NOERR) {
+	/* Do not leave half-filled blocks in the cache */
+	for(i=0;i<nbufs;i++) {
+	    NCHTTPBLOCK* blk = httpio_lookup(http,lo+(off_t)i);
+	    if(blk != NULL) blk->index = -1;
+	}
+	goto done;
+    }
+    http->nextblock = hi + 1;
+
+done:
+    free(bufs);
+    return status;
+}
+
+static int
+httpio_guarantee(NCHTTPIO* http, size_t extent)
+{
+    if(extent > http->regionalloc) {
+	char* newregion = (char*)realloc(http->region,extent);
+	if(newregion == NULL) return NC_ENOMEM;
+	http->region = newregion;
+	ncio_set_memory(http->owner,http->owner->memory+extent-http->regionalloc);
+	http->regionalloc = extent;
+    }
+    return NC_NOERR;
+}
+
+/*
+ * Request that the region (offset, extent)
+ * be made available through *vpp.
+ */
+static int
+httpio_get(ncio* const nciop, off_t offset, size_t extent, int rflags, void** const vpp)
+{
+    int status = NC_NOERR;
+    NCHTTPIO* http;
+    off_t first, last, lastblock, b;
+    size_t avail, pos;
+    unsigned long long nread0;
+
+    if(nciop == NULL || nciop->pvt == NULL) return NC_EINVAL;
+    http = (NCHTTPIO*)nciop->pvt;
+    nread0 = nciop->stats.nread;
+    if(fIsSet(rflags,RGN_WRITE)) return NC_EPERM;
+    assert(!http->locked);
+    if(extent == 0) return NC_EINVAL;
+
+    /* Bytes past the end of the remote file read as zeros */
+    avail = (offset >= http->size ? 0
+             : (size_t)MIN((off_t)extent,http->size - offset));
+    if(avail == 0) {
+	if((status = httpio_guarantee(http,extent))) return status;
+	memset(http->region,0,extent);
+	goto havedata;
+    }
+
+    first = offset / (off_t)http->blocksize;
+    last = (offset + (off_t)avail - 1) / (off_t)http->blocksize;
+    lastblock = (http->size - 1) / (off_t)http->blocksize;
+    assert(last <= lastblock);
+
+    if((size_t)(last - first + 1) > http->nblocks/2) {
+	/* Too big to cache; read it straight into the region buffer */
+	char* bufs[1];
+	if((status = httpio_guarantee(http,extent))) return status;
+	bufs[0] = http->region;
+	status = httpio_fetch(http,offset,avail,bufs,avail);
+	if(status != NC_NOERR) return status;
+	nciop->stats.cache_misses++;
+	http->nextblock = last + 1;
+	goto zerotail;
+    }
+
+    if((status = httpio_fault(http,first,last)))
+	return status;
+    if(nciop->stats.nread == nread0)
+	nciop->stats.cache_hits++;
+    else
+	nciop->stats.cache_misses++;
+
+    if(first == last && avail == extent) {
+	/* Serve the region directly from the cached block */
+	NCHTTPBLOCK* blk = httpio_lookup(http,first);
+	assert(blk != NULL);
+	http->pinned = blk;
+	http->locked = 1;
+	if(vpp) *vpp = blk->data + (offset - first*(off_t)http->blocksize);
+	return NC_NOERR;
+    }
+
+    /* Assemble a region spanning blocks */
+    if((status = httpio_guarantee(http,extent))) return status;
+    for(pos=0,b=first;b<=last;b++) {
+	NCHTTPBLOCK* blk = httpio_lookup(http,b);
+	off_t bstart = b*(off_t)http->blocksize;
+	off_t from = (b == first ? offset - bstart : 0);
+	size_t n = MIN(http->blocksize - (size_t)from,avail - pos);
+	assert(blk != NULL);
+	memcpy(http->region+pos,blk->data+from,n);
+	pos += n;
+    }
+
+zerotail:
+    if(avail < extent)
+	memset(http->region+avail,0,extent-avail);
+
+havedata:
+    http->locked = 1;
+    if(vpp) *vpp = http->region;
+    return NC_NOERR;
+}
+
+static int
+httpio_rel(ncio* const nciop, off_t offset, int rflags)
+{
+    NCHTTPIO* http;
+    if(nciop == NULL || nciop->pvt == NULL) return NC_EINVAL;
+    http = (NCHTTPIO*)nciop->pvt;
+    if(fIsSet(rflags,RGN_MODIFIED)) return NC_EPERM;
+    http->locked = 0;
+    http->pinned = NULL;
+    return NC_NOERR;
+}
+
+static int
+httpio_move(ncio* const nciop, off_t to, off_t from, size_t nbytes, int rflags)
+{
+    return NC_EPERM; /* read-only */
+}
+
+/*
+ * Discard the cache so that the next read gets fresh data
+ * from the server.
+ */
+static int
+httpio_sync(ncio* const nciop)
+{
+    NCHTTPIO* http;
+    size_t i;
+    if(nciop == NULL || nciop->pvt == NULL) return NC_EINVAL;
+    http = (NCHTTPIO*)nciop->pvt;
+    if(http->locked) return NC_NOERR;
+    for(i=0;i<http->nblocks;i++)
+	http->blocks[i].index = -1;
+    http->nextblock = -1;
+    http->window = 0;
+    return NC_NOERR;
+}
+
+static int
+httpio_filesize(ncio* nciop, off_t* filesizep)
+{
+    NCHTTPIO* http;
+    if(nciop == NULL || nciop->pvt == NULL) return NC_EINVAL;
+    http = (NCHTTPIO*)nciop->pvt;
+    if(filesizep != NULL) *filesizep = http->size;
+    return NC_NOERR;
+}
+
+static int
+httpio_pad_length(ncio* nciop, off_t length)
+{
+    return NC_EPERM; /* read-only */
+}
+
+static int
+httpio_close(ncio* nciop, int doUnlink)
+{
+    if(nciop == NULL) return NC_NOERR;
+    httpio_free((NCHTTPIO*)nciop->pvt);
+    if(nciop->path != NULL) free((char*)nciop->path);
+    free(nciop);
+    return NC_NOERR;
+}
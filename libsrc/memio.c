@@ -174,9 +174,12 @@ static int memio_new(const char* path, int ioflags, off_t initialsize, void* mem
     if(inmemory) {
       memio->memory = memory;
     } else {
+        /* The image cannot be shrunk to fit the memory budget */
+        if((size_t)memio->alloc > NC_memory_available()) {status = NC_ENOMEM; goto fail;}
         /* malloc memory */
         memio->memory = (char*)malloc(memio->alloc);
         if(memio->memory == NULL) {status = NC_ENOMEM; goto fail;}
+        ncio_set_memory(nciop,(size_t)memio->alloc);
     }
 
 done:
@@ -371,6 +374,8 @@ fprintf(stderr,"memio_open: initial memory: %lu/%lu\n",(unsigned long)memio->mem
             ssize_t count = read(fd, pos, red);
             if(count < 0) {status = errno; goto unwind_open;}
             if(count == 0) {status = NC_ENOTNC; goto unwind_open;}
+            nciop->stats.nread++;
+            nciop->stats.bytes_read += (unsigned long long)count;
             red -= count;
             pos += count;
         }
@@ -458,6 +463,8 @@ fprintf(stderr,"realloc: %lu/%lu -> %lu/%lu\n",
 #endif
 	memio->memory = newmem;
 	memio->alloc = newsize;
+	if(!fIsSet(nciop->ioflags,NC_INMEMORY))
+	    ncio_set_memory(nciop,(size_t)newsize);
     }
     memio->size = length;
     return NC_NOERR;
@@ -551,6 +558,8 @@ memio_get(ncio* const nciop, off_t offset, size_t extent, int rflags, void** con
     status = guarantee(nciop, offset+extent);
     memio->locked++;
     if(status != NC_NOERR) return status;
+    /* The whole file is resident */
+    nciop->stats.cache_hits++;
     if(vpp) *vpp = memio->memory+offset;
     return NC_NOERR;
 }
@@ -234,6 +234,8 @@ mmapio_create(const char* path, int ioflags,
 				    MAP_PRIVATE|MAP_ANONYMOUS,
                                     mmapio->mapfd,0);
 	{mmapio->memory[0] = 0;} /* test writing of the mmap'd memory */
+	/* Only anonymous memory is charged; file mappings can be paged out */
+	ncio_set_memory(nciop,(size_t)mmapio->alloc);
     } else { /*persist */
         /* Open the file, but make sure we can write it if needed */
         oflags = (persist ? O_RDWR : O_RDONLY);    
@@ -453,6 +455,8 @@ fprintf(stderr,"realloc: %lu/%lu -> %lu/%lu\n",
 #endif
 	mmapio->memory = newmem;
 	mmapio->alloc = newsize;
+	if(mmapio->mapfd < 0)
+	    ncio_set_memory(nciop,(size_t)newsize);
     }  
     mmapio->size = length;
     return NC_NOERR;
@@ -519,6 +523,8 @@ mmapio_get(ncio* const nciop, off_t offset, size_t extent, int rflags, void** co
     status = guarantee(nciop, offset+extent);
     mmapio->locked++;
     if(status != NC_NOERR) return status;
+    /* Any paging is done by the kernel and is not visible here */
+    nciop->stats.cache_hits++;
     if(vpp) *vpp = mmapio->memory+offset;
     return NC_NOERR;
 }
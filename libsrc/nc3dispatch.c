@@ -38,6 +38,20 @@ static int NC3_inq_var_all(int ncid, int varid, char *name, nc_type *xtypep,
 	       int *options_maskp, int *pixels_per_blockp);
 
 static int NC3_var_par_access(int,int,int);
+static int NC3_set_append_mode(int,int,int*);
+static int NC3_def_var_quantize(int,int,int,int);
+static int NC3_inq_var_quantize(int,int,int*,int*);
+static int NC3_set_metadata_index(int,int,int*);
+static int NC3_inq_metadata_index(int,int*,int*);
+static int NC3_get_chunk_raw(int,int,const size_t*,unsigned int*,size_t*,void*);
+static int NC3_put_chunk_raw(int,int,const size_t*,unsigned int,size_t,const void*);
+static int NC3_iter_chunks_raw(int,int,nc_chunk_iter_fn,void*);
+static int NC3_def_var_filter(int,int,unsigned int,size_t,const unsigned int*);
+static int NC3_inq_var_filter(int,int,unsigned int*,size_t*,unsigned int*);
+static int NC3_get_vara_field(int,int,int,const size_t*,const size_t*,void*);
+static int NC3_get_vara_packed(int,int,const size_t*,const size_t*,size_t*,void**);
+static int NC3_put_vara_packed(int,int,const size_t*,const size_t*,const size_t*,const void*);
+static int NC3_inq_var_filter_ids(int,int,size_t*,unsigned int*);
 
 #ifdef USE_NETCDF4
 static int NC3_show_metadata(int);
@@ -168,6 +182,31 @@ NC3_get_var_chunk_cache,
 
 #endif /*_NC4DISPATCH_H*/
 
+NC3_inq_io_stats,
+NC3_reset_io_stats,
+
+NC3_inq_memory_usage,
+
+NC3_set_append_mode,
+
+NC3_get_var_points,
+
+NC3_def_var_quantize,
+NC3_inq_var_quantize,
+
+NC3_set_metadata_index,
+NC3_inq_metadata_index,
+NC3_get_chunk_raw,
+NC3_put_chunk_raw,
+NC3_iter_chunks_raw,
+NC3_iter_byte_ranges,
+NC3_def_var_filter,
+NC3_inq_var_filter,
+NC3_get_vara_field,
+NC3_get_vara_packed,
+NC3_put_vara_packed,
+NC3_inq_var_filter_ids,
+
 };
 
 NC_Dispatch* NC3_dispatch_table = NULL; /*!< NC3 Dispatch table, moved here from ddispatch.c */
@@ -210,6 +249,99 @@ NC3_var_par_access(int ncid, int varid, int par_access)
 {
     return NC_NOERR; /* no-op for netcdf classic */
 }
+
+static int
+NC3_set_append_mode(int ncid, int mode, int *old_modep)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_inq_var_quantize(int ncid, int varid, int *quantize_modep, int *nsdp)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+                   const unsigned int *params)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_inq_var_filter(int ncid, int varid, unsigned int *idp, size_t *nparamsp,
+                   unsigned int *params)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_get_vara_field(int ncid, int varid, int fieldid, const size_t *startp,
+                   const size_t *countp, void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_get_vara_packed(int ncid, int varid, const size_t *startp,
+                    const size_t *countp, size_t *offsetsp, void **datap)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_put_vara_packed(int ncid, int varid, const size_t *startp,
+                    const size_t *countp, const size_t *offsetsp,
+                    const void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_inq_var_filter_ids(int ncid, int varid, size_t *nfiltersp,
+                       unsigned int *ids)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_set_metadata_index(int ncid, int flag, int *old_flagp)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_inq_metadata_index(int ncid, int *flagp, int *openedp)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_get_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int *filter_maskp, size_t *sizep, void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_put_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int filter_mask, size_t size, const void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NC3_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void *udata)
+{
+    return NC_ENOTNC4;
+}
     
 #ifdef USE_NETCDF4
 
@@ -97,6 +97,15 @@ NC3_inq_format(int ncid, int *formatp);
 EXTERNL int
 NC3_inq_format_extended(int ncid, int *formatp, int *modep);
 
+EXTERNL int
+NC3_inq_io_stats(int ncid, nc_io_stats_t *statsp);
+
+EXTERNL int
+NC3_reset_io_stats(int ncid);
+
+EXTERNL int
+NC3_inq_memory_usage(int ncid, nc_memory_usage_t *usagep);
+
 EXTERNL int
 NC3_inq(int ncid, int *ndimsp, int *nvarsp, int *nattsp, int *unlimdimidp);
 
@@ -177,6 +186,13 @@ NC3_get_vara(int ncid, int varid,
 	     const size_t *start, const size_t *count,
              void *value, nc_type);
 
+EXTERNL int
+NC3_get_var_points(int ncid, int varid, size_t npoints,
+		   const size_t *indexp, void *value, nc_type);
+
+EXTERNL int
+NC3_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void *udata);
+
 /* End _var */
 
 extern int NC3_initialize();
@@ -1600,6 +1600,111 @@ NC3_inq_format_extended(int ncid, int *formatp, int *modep)
 	return NC_NOERR;
 }
 
+int
+NC3_inq_io_stats(int ncid, nc_io_stats_t *statsp)
+{
+	int status;
+	NC *nc;
+	NC3_INFO* nc3;
+
+	status = NC_check_id(ncid, &nc);
+	if(status != NC_NOERR)
+		return status;
+	nc3 = NC3_DATA(nc);
+
+	if(statsp != NULL)
+		*statsp = nc3->nciop->stats;
+	return NC_NOERR;
+}
+
+int
+NC3_reset_io_stats(int ncid)
+{
+	int status;
+	NC *nc;
+	NC3_INFO* nc3;
+
+	status = NC_check_id(ncid, &nc);
+	if(status != NC_NOERR)
+		return status;
+	nc3 = NC3_DATA(nc);
+
+	(void) memset(&nc3->nciop->stats, 0, sizeof(nc_io_stats_t));
+	return NC_NOERR;
+}
+
+/* Estimate the memory held by the header structures */
+
+static size_t
+NC_string_memory(const NC_string *ncstrp)
+{
+	return ncstrp == NULL ? 0 : sizeof(NC_string) + ncstrp->nchars + 1;
+}
+
+static size_t
+NC_hashmap_memory(const NC_hashmap *hashmap)
+{
+	return hashmap == NULL ? 0
+		: sizeof(NC_hashmap) + hashmap->size * sizeof(hEntry);
+}
+
+static size_t
+NC_attrarray_memory(const NC_attrarray *ncap)
+{
+	size_t i, n = ncap->nalloc * sizeof(NC_attr *);
+	for(i = 0; i < ncap->nelems; i++)
+		n += sizeof(NC_attr) + ncap->value[i]->xsz
+			+ NC_string_memory(ncap->value[i]->name);
+	return n;
+}
+
+static size_t
+NC3_metadata_memory(const NC3_INFO *nc3)
+{
+	size_t i, n = sizeof(NC3_INFO);
+
+	n += nc3->dims.nalloc * sizeof(NC_dim *)
+		+ NC_hashmap_memory(nc3->dims.hashmap);
+	for(i = 0; i < nc3->dims.nelems; i++)
+		n += sizeof(NC_dim) + NC_string_memory(nc3->dims.value[i]->name);
+
+	n += NC_attrarray_memory(&nc3->attrs);
+
+	n += nc3->vars.nalloc * sizeof(NC_var *)
+		+ NC_hashmap_memory(nc3->vars.hashmap);
+	for(i = 0; i < nc3->vars.nelems; i++) {
+		const NC_var *varp = nc3->vars.value[i];
+		n += sizeof(NC_var) + NC_string_memory(varp->name)
+			+ varp->ndims * (sizeof(size_t) + sizeof(off_t) + sizeof(int))
+			+ NC_attrarray_memory(&varp->attrs);
+	}
+
+	/* In define mode, the previous definitions are kept as well */
+	if(nc3->old != NULL)
+		n += NC3_metadata_memory(nc3->old);
+	return n;
+}
+
+int
+NC3_inq_memory_usage(int ncid, nc_memory_usage_t *usagep)
+{
+	int status;
+	NC *nc;
+	NC3_INFO* nc3;
+
+	status = NC_check_id(ncid, &nc);
+	if(status != NC_NOERR)
+		return status;
+	nc3 = NC3_DATA(nc);
+
+	if(usagep != NULL) {
+		(void) memset(usagep, 0, sizeof(nc_memory_usage_t));
+		usagep->io_buffers = nc3->nciop->memory;
+		usagep->metadata = NC3_metadata_memory(nc3);
+	}
+	return NC_NOERR;
+}
+
 /* The sizes of types may vary from platform to platform, but within
  * netCDF files, type sizes are fixed. */
 #define NC_BYTE_LEN 1
@@ -5,8 +5,13 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
 
 #include "netcdf.h"
+#include "ncdispatch.h"
 #include "ncio.h"
 #include "fbits.h"
 
@@ -27,6 +32,10 @@ extern int ffio_create(const char*,int,size_t,off_t,size_t,size_t*,void*,ncio**,
 extern int ffio_open(const char*,int,off_t,size_t,size_t*,void*,ncio**,void** const);
 #endif
 
+#ifdef ENABLE_BYTERANGE
+extern int httpio_open(const char*,int,off_t,size_t,size_t*,void*,ncio**,void** const);
+#endif
+
 #ifdef USE_DISKLESS
 #  ifdef USE_MMAP
      extern int mmapio_create(const char*,int,size_t,off_t,size_t,size_t*,void*,ncio**,void** const);
@@ -42,6 +51,11 @@ ncio_create(const char *path, int ioflags, size_t initialsz,
 		       void* parameters,
                        ncio** iopp, void** const mempp)
 {
+#ifdef ENABLE_BYTERANGE
+    /* Remote files are read-only */
+    if(NC_testurl(path))
+        return NC_EPERM;
+#endif
 #ifdef USE_DISKLESS
     if(fIsSet(ioflags,NC_DISKLESS)) {
 #  ifdef USE_MMAP
@@ -71,6 +85,11 @@ ncio_open(const char *path, int ioflags,
     /* Diskless open has the following constraints:
        1. file must be classic version 1 or 2
      */
+#ifdef ENABLE_BYTERANGE
+    /* A url reaching this layer was marked mode=bytes by the dispatcher */
+    if(NC_testurl(path))
+        return httpio_open(path,ioflags,igeto,igetsz,sizehintp,parameters,iopp,mempp);
+#endif
 #ifdef USE_DISKLESS
     if(fIsSet(ioflags,NC_DISKLESS)) {
 #  ifdef USE_MMAP
@@ -93,29 +112,62 @@ ncio_open(const char *path, int ioflags,
 /**************************************************/
 /* wrapper functions for the ncio dispatch table */
 
+/* Wall clock in seconds, used to time the ncio operations */
+static double
+ncio_clock(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+    struct timeval tv;
+    (void)gettimeofday(&tv,NULL);
+    return (double)tv.tv_sec + 1.0e-6 * (double)tv.tv_usec;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
 int
 ncio_rel(ncio *const nciop, off_t offset, int rflags)
 {
-    return nciop->rel(nciop,offset,rflags);
+    int status;
+    double t0 = ncio_clock();
+    status = nciop->rel(nciop,offset,rflags);
+    nciop->stats.nrel++;
+    nciop->stats.rel_time += ncio_clock() - t0;
+    return status;
 }
 
 int
 ncio_get(ncio *const nciop, off_t offset, size_t extent,
 			int rflags, void **const vpp)
 {
-    return nciop->get(nciop,offset,extent,rflags,vpp);
+    int status;
+    double t0 = ncio_clock();
+    status = nciop->get(nciop,offset,extent,rflags,vpp);
+    nciop->stats.nget++;
+    nciop->stats.get_time += ncio_clock() - t0;
+    return status;
 }
 
 int
 ncio_move(ncio *const nciop, off_t to, off_t from, size_t nbytes, int rflags)
 {
-    return nciop->move(nciop,to,from,nbytes,rflags);
+    int status;
+    double t0 = ncio_clock();
+    status = nciop->move(nciop,to,from,nbytes,rflags);
+    nciop->stats.nmove++;
+    nciop->stats.move_time += ncio_clock() - t0;
+    return status;
 }
 
 int
 ncio_sync(ncio *const nciop)
 {
-    return nciop->sync(nciop);
+    int status;
+    double t0 = ncio_clock();
+    status = nciop->sync(nciop);
+    nciop->stats.nsync++;
+    nciop->stats.sync_time += ncio_clock() - t0;
+    return status;
 }
 
 int
@@ -136,6 +188,33 @@ ncio_close(ncio *nciop, int doUnlink)
     /* close and release all resources associated
        with nciop, including nciop
     */
-    int status = nciop->close(nciop,doUnlink);
+    int status;
+    ncio_set_memory(nciop,0);
+    status = nciop->close(nciop,doUnlink);
     return status;
 }
+
+/* Record the buffer memory now held by a package,
+   charging the difference to the memory budget */
+void
+ncio_set_memory(ncio *nciop, size_t memory)
+{
+    if(memory > nciop->memory)
+        NC_memory_charge(NC_MEM_IO_BUFFERS,memory - nciop->memory);
+    else
+        NC_memory_release(NC_MEM_IO_BUFFERS,nciop->memory - memory);
+    nciop->memory = memory;
+}
+
+/* Shrink a block size so that nbufs blocks fit in what is left
+   of the memory budget, but not below minblksz; the result stays
+   a multiple of 8 */
+size_t
+ncio_budget_blksz(size_t blksz, size_t nbufs, size_t minblksz)
+{
+    size_t avail = NC_memory_available();
+    if(nbufs == 0 || blksz <= avail / nbufs)
+        return blksz;
+    blksz = (avail / nbufs) & ~(size_t)7;
+    return (blksz < minblksz ? minblksz : blksz);
+}
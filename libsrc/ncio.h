@@ -139,6 +139,20 @@ struct ncio {
 
 	/* implementation private stuff */
 	void *pvt;
+
+	/*
+	 * I/O counters, see nc_inq_io_stats().
+	 * The wrappers below count calls and time them;
+	 * each package counts its own system calls,
+	 * bytes moved and buffer hits.
+	 */
+	nc_io_stats_t stats;
+
+	/*
+	 * Bytes of buffer memory held by the package,
+	 * charged to the memory budget by ncio_set_memory().
+	 */
+	size_t memory;
 };
 
 #undef NCIO_CONST
@@ -153,6 +167,10 @@ extern int ncio_filesize(ncio* const, off_t*);
 extern int ncio_pad_length(ncio* const, off_t);
 extern int ncio_close(ncio* const, int);
 
+/* Memory budget support for the packages */
+extern void ncio_set_memory(ncio* const, size_t);
+extern size_t ncio_budget_blksz(size_t blksz, size_t nbufs, size_t minblksz);
+
 extern int ncio_create(const char *path, int ioflags, size_t initialsz,
                        off_t igeto, size_t igetsz, size_t *sizehintp,
 		       void* parameters, /* new */
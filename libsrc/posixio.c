@@ -284,6 +284,7 @@ px_pgout(ncio *const nciop,
 
 	if(*posp != offset)
 	{
+		nciop->stats.nseek++;
 		if(lseek(nciop->fd, offset, SEEK_SET) != offset)
 		{
 			return errno;
@@ -298,6 +299,7 @@ px_pgout(ncio *const nciop,
 	nextent = extent;
         nvp = vp;
 	while((partial = write(nciop->fd, nvp, nextent)) != -1) {
+	    nciop->stats.nwrite++;
 	    if(partial == nextent)
 		break;
 	    nvp += partial;
@@ -306,6 +308,7 @@ px_pgout(ncio *const nciop,
 	if(partial == -1)
 	    return errno;
 	*posp += extent;
+	nciop->stats.bytes_written += extent;
 
 	return NC_NOERR;
 }
@@ -348,6 +351,7 @@ px_pgin(ncio *const nciop,
 
 	if(*posp != offset)
 	{
+		nciop->stats.nseek++;
 		if(lseek(nciop->fd, offset, SEEK_SET) != offset)
 		{
 			status = errno;
@@ -373,6 +377,7 @@ px_pgin(ncio *const nciop,
        (according to the comment below, at least). */
     do {
       nread = read(nciop->fd,vp,extent);
+      nciop->stats.nread++;
     } while (nread == -1 && errno == EINTR);
 
 
@@ -386,6 +391,7 @@ px_pgin(ncio *const nciop,
 
     *nreadp = nread;
 	*posp += nread;
+	nciop->stats.bytes_read += (unsigned long long)nread;
 
 	return NC_NOERR;
 }
@@ -521,6 +527,9 @@ px_get(ncio *const nciop, ncio_px *const pxp,
 		void **const vpp)
 {
 	int status = NC_NOERR;
+	/* to tell buffer hits from faults at done */
+	const unsigned long long nread0 = nciop->stats.nread;
+	const unsigned long long bytes0 = nciop->stats.bytes_read;
 
 	const off_t blkoffset = _RNDDOWN(offset, (off_t)pxp->blksz);
 	off_t diff = (size_t)(offset - blkoffset);
@@ -725,6 +734,14 @@ pgin:
 	 pxp->bf_extent = blkextent;
 
 done:
+	if(nciop->stats.nread == nread0)
+		nciop->stats.cache_hits++;
+	else {
+		nciop->stats.cache_misses++;
+		/* existing data had to be read before it could be modified */
+		if(fIsSet(rflags, RGN_WRITE) && nciop->stats.bytes_read > bytes0)
+			nciop->stats.nrmw++;
+	}
 	extent += diff;
 	if(pxp->bf_cnt < extent)
 		pxp->bf_cnt = extent;
@@ -822,6 +839,7 @@ fprintf(stderr, "\tdouble_buffr %ld %ld %ld\n",
 		pxp->slave->bf_base = malloc(2 * pxp->blksz);
 		if(pxp->slave->bf_base == NULL)
 			return ENOMEM;
+		ncio_set_memory(nciop, nciop->memory + 2 * pxp->blksz);
 		(void) memcpy(pxp->slave->bf_base, pxp->bf_base,
 			 pxp->bf_extent);
 		pxp->slave->bf_rflags = 0;
@@ -1064,6 +1082,7 @@ ncio_px_init2(ncio *const nciop, size_t *sizehintp, int isNew)
 	pxp->bf_base = malloc(bufsz);
 	if(pxp->bf_base == NULL)
 		return ENOMEM;
+	ncio_set_memory(nciop, bufsz);
 	/* else */
 	pxp->bf_cnt = 0;
 	if(isNew)
@@ -1237,6 +1256,7 @@ ncio_spx_get(ncio *const nciop,
 		if(pxp->bf_base == NULL)
 			return ENOMEM;
 		pxp->bf_extent = extent;
+		ncio_set_memory(nciop, extent);
 	}
 
 	status = px_pgin(nciop, offset,
@@ -1246,6 +1266,11 @@ ncio_spx_get(ncio *const nciop,
 	if(status != NC_NOERR)
 		return status;
 
+	/* NC_SHARE does no buffering; every get is a fault */
+	nciop->stats.cache_misses++;
+	if(fIsSet(rflags, RGN_WRITE) && pxp->bf_cnt > 0)
+		nciop->stats.nrmw++;
+
 	pxp->bf_offset = offset;
 
 	if(pxp->bf_cnt < extent)
@@ -1311,6 +1336,7 @@ fprintf(stderr, "strategy %ld at %ld to %ld\n",
 		if(pxp->bf_base == NULL)
 			return ENOMEM;
 		pxp->bf_extent = extent;
+		ncio_set_memory(nciop, extent);
 	}
 
 	status = px_pgin(nciop, offset,
@@ -1449,6 +1475,7 @@ ncio_spx_init2(ncio *const nciop, const size_t *const sizehintp)
 		pxp->bf_extent = 0;
 		return ENOMEM;
 	}
+	ncio_set_memory(nciop, pxp->bf_extent);
 	/* else */
 	return NC_NOERR;
 }
@@ -1535,6 +1562,8 @@ ncio_px_new(const char *path, int ioflags)
 
 	nciop->ioflags = ioflags;
 	*((int *)&nciop->fd) = -1; /* cast away const */
+	(void) memset(&nciop->stats, 0, sizeof(nciop->stats));
+	nciop->memory = 0;
 
 	nciop->path = (char *) ((char *)nciop + sz_ncio);
 	(void) strcpy((char *)nciop->path, path); /* cast away const */
@@ -1645,6 +1674,11 @@ posixio_create(const char *path, int ioflags,
 		*sizehintp = M_RNDUP(*sizehintp);
 	}
 
+	/* Two blocks are buffered (one with NC_SHARE); keep them
+	   within the memory budget */
+	*sizehintp = ncio_budget_blksz(*sizehintp,
+		fIsSet(nciop->ioflags, NC_SHARE) ? 1 : 2, NCIO_MINBLOCKSIZE);
+
 	if(fIsSet(nciop->ioflags, NC_SHARE))
 		status = ncio_spx_init2(nciop, sizehintp);
 	else
@@ -1777,6 +1811,11 @@ posixio_open(const char *path,
 		*sizehintp = M_RNDUP(*sizehintp);
 	}
 
+	/* Two blocks are buffered (one with NC_SHARE); keep them
+	   within the memory budget */
+	*sizehintp = ncio_budget_blksz(*sizehintp,
+		fIsSet(nciop->ioflags, NC_SHARE) ? 1 : 2, NCIO_MINBLOCKSIZE);
+
 	if(fIsSet(nciop->ioflags, NC_SHARE))
 		status = ncio_spx_init2(nciop, sizehintp);
 	else
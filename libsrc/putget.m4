@@ -1936,6 +1936,117 @@ NC3_get_vara(int ncid, int varid,
     return status;
 }
 
+/*
+ * A point of a variable, and where it is in the file.
+ */
+typedef struct NC_point {
+	off_t offset;
+	size_t point;	/* which of the caller's points this is */
+} NC_point;
+
+static int
+NC_point_cmp(const void *a, const void *b)
+{
+	const NC_point *pa = (const NC_point *)a;
+	const NC_point *pb = (const NC_point *)b;
+
+	if(pa->offset != pb->offset)
+		return pa->offset < pb->offset ? -1 : 1;
+	if(pa->point != pb->point)
+		return pa->point < pb->point ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Read scattered points of a variable. The points are read in the
+ * order they are laid out in the file, so that each block of the file
+ * they fall in is brought into the I/O layer's buffer just once, and
+ * the values are stored in the order the points were given.
+ */
+int
+NC3_get_var_points(int ncid, int varid, size_t npoints,
+		   const size_t *indexp, void *value0, nc_type memtype)
+{
+    int status = NC_NOERR;
+    NC* nc;
+    NC3_INFO* nc3;
+    NC_var *varp;
+    size_t memtypelen, ii;
+    signed char* value = (signed char*) value0; /* legally allow ptr arithmetic */
+    NC_point *points = NULL;
+
+    status = NC_check_id(ncid, &nc);
+    if(status != NC_NOERR)
+        return status;
+    nc3 = NC3_DATA(nc);
+
+    if(NC_indef(nc3))
+        return NC_EINDEFINE;
+
+    status = NC_lookupvar(nc3, varid, &varp);
+    if(status != NC_NOERR)
+        return status;
+
+    if(memtype == NC_NAT) memtype=varp->type;
+
+    if(memtype == NC_CHAR && varp->type != NC_CHAR)
+        return NC_ECHAR;
+    else if(memtype != NC_CHAR && varp->type == NC_CHAR)
+        return NC_ECHAR;
+
+    if(npoints == 0)
+        return NC_NOERR;
+
+    memtypelen = nctypelen(memtype);
+
+    points = (NC_point *) malloc(npoints * sizeof(NC_point));
+    if(points == NULL)
+        return NC_ENOMEM;
+
+    /* Check all the points before reading any. */
+    for(ii = 0; ii < npoints; ii++)
+    {
+        const size_t *coord = indexp + ii * varp->ndims;
+
+        status = NCcoordck(nc3, varp, coord);
+        if(status != NC_NOERR)
+            goto done;
+        if(IS_RECVAR(varp) && *coord >= NC_get_numrecs(nc3))
+        {
+            status = NC_EEDGE;
+            goto done;
+        }
+        points[ii].offset = NC_varoffset(nc3, varp, coord);
+        points[ii].point = ii;
+    }
+
+    qsort(points, npoints, sizeof(NC_point), NC_point_cmp);
+
+    for(ii = 0; ii < npoints; ii++)
+    {
+        const size_t point = points[ii].point;
+        const int lstatus = readNCv(nc3, varp, indexp + point * varp->ndims,
+                                    1, (void*)(value + point * memtypelen),
+                                    memtype);
+        if(lstatus != NC_NOERR)
+        {
+            if(lstatus != NC_ERANGE)
+            {
+                status = lstatus;
+                /* fatal for the loop */
+                break;
+            }
+            /* else NC_ERANGE, not fatal for the loop */
+            if(status == NC_NOERR)
+                status = lstatus;
+        }
+    }
+
+done:
+    free(points);
+    return status;
+}
+
 int
 NC3_put_vara(int ncid, int varid,
 	    const size_t *start, const size_t *edges0,
@@ -775,3 +775,61 @@ NC3_rename_var(int ncid, int varid, const char *unewname)
 
 	return NC_NOERR;
 }
+
+/*
+ * Call fn with where the data of a var is in the file: the whole of a
+ * non-record var, or its part of each record.
+ */
+int
+NC3_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void *udata)
+{
+	int status;
+	NC *nc;
+	NC3_INFO* ncp;
+	NC_var *varp;
+	size_t start[NC_MAX_VAR_DIMS];
+	size_t count[NC_MAX_VAR_DIMS];
+	size_t ii, nrecs;
+	unsigned long long size;
+
+	if(fn == NULL)
+		return NC_EINVAL;
+
+	status = NC_check_id(ncid, &nc);
+	if(status != NC_NOERR)
+		return status;
+	ncp = NC3_DATA(nc);
+
+	/* The data isn't placed until the header is written. */
+	if(NC_indef(ncp))
+		return NC_EINDEFINE;
+
+	status = NC_lookupvar(ncp, varid, &varp);
+	if(status != NC_NOERR)
+		return status;
+
+	size = varp->xsz;
+	for(ii = 0; ii < varp->ndims; ii++)
+	{
+		start[ii] = 0;
+		count[ii] = (ii == 0 && IS_RECVAR(varp)) ? 1 : varp->shape[ii];
+		size *= count[ii];
+	}
+	if(size == 0)
+		return NC_NOERR;
+
+	if(!IS_RECVAR(varp))
+		return fn(start, count, (unsigned long long)varp->begin, size,
+			  0, udata);
+
+	nrecs = NC_get_numrecs(ncp);
+	for(start[0] = 0; start[0] < nrecs; start[0]++)
+	{
+		status = fn(start, count, (unsigned long long)varp->begin
+			    + (unsigned long long)start[0] * (unsigned long long)ncp->recsize,
+			    size, 0, udata);
+		if(status != NC_NOERR)
+			return status;
+	}
+	return NC_NOERR;
+}
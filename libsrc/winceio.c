@@ -271,6 +271,7 @@ ncio_fileio_get(ncio *const nciop,
 		if(ffp->bf_base == NULL)
 			return ENOMEM;
 		ffp->bf_extent = extent;
+		ncio_set_memory(nciop, extent);
 	}
 
 	status = fileio_pgin(nciop, offset,
@@ -393,6 +394,7 @@ ncio_fileio_init2(ncio *const nciop, size_t *sizehintp)
 		ffp->bf_extent = 0;
 		return ENOMEM;
 	}
+	ncio_set_memory(nciop, ffp->bf_extent);
 	/* else */
 	return NC_NOERR;
 }
@@ -453,6 +455,8 @@ ncio_new(const char *path, int ioflags)
 	
 	nciop->ioflags = ioflags;
 	*((int *)&nciop->fd) = -1; /* cast away const */
+	(void) memset(&nciop->stats, 0, sizeof(nciop->stats));
+	nciop->memory = 0;
 
 	nciop->path = (char *) ((char *)nciop + sz_ncio);
 	(void) strcpy((char *)nciop->path, path); /* cast away const */
@@ -55,7 +55,7 @@ nc4_get_att(int ncid, NC *nc, int varid, const char *name,
 
    /* Find info for this file and group, and set pointer to each. */
    h5 = NC4_DATA(nc);
-   if (!(grp = nc4_rec_find_grp(h5->root_grp, (ncid & GRP_ID_MASK))))
+   if (!(grp = nc4_find_grp_id(h5, (ncid & GRP_ID_MASK))))
       BAIL(NC_EBADGRPID);
 
    /* Normalize name. */
@@ -235,7 +235,7 @@ nc4_put_att(int ncid, NC *nc, int varid, const char *name,
 
    /* Find info for this file and group, and set pointer to each. */
    h5 = NC4_DATA(nc);
-   if (!(grp = nc4_rec_find_grp(h5->root_grp, (ncid & GRP_ID_MASK))))
+   if (!(grp = nc4_find_grp_id(h5, (ncid & GRP_ID_MASK))))
       return NC_EBADGRPID;
 
    /* If the file is read-only, return an error. */
@@ -354,7 +354,7 @@ nc4_put_att(int ncid, NC *nc, int varid, const char *name,
    }
 
    att->len = len;
-   if (att->l.prev)
+   if (att != *attlist)
       att->attnum = ((NC_ATT_INFO_T *)att->l.prev)->attnum + 1;
    else
       att->attnum = 0;
@@ -532,6 +532,7 @@ nc4_put_att(int ncid, NC *nc, int varid, const char *name,
    /* Mark attributes on variable dirty, so they get written */
    if(var)
        var->attr_dirty = NC_TRUE;
+   h5->meta_dirty = NC_TRUE;
 
  exit:
    /* If there was an error return it, otherwise return any potential
@@ -723,6 +724,7 @@ NC4_rename_att(int ncid, int varid, const char *name,
    /* Mark attributes on variable dirty, so they get written */
    if(var)
        var->attr_dirty = NC_TRUE;
+   h5->meta_dirty = NC_TRUE;
 
    return retval;
 }
@@ -817,6 +819,7 @@ NC4_del_att(int ncid, int varid, const char *name)
    /* Delete this attribute from this list. */
    if ((retval = nc4_att_list_del(attlist, att)))
       BAIL(retval);
+   h5->meta_dirty = NC_TRUE;
 
  exit:
    if (datasetid > 0) H5Dclose(datasetid);
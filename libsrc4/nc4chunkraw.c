@@ -0,0 +1,416 @@
+/** \file \internal
+Raw chunk I/O, and the byte ranges of the data, of netcdf-4 variables.
+
+The chunks of a chunked variable are read and written as they are
+stored in the file: still compressed, in the byte order of the file,
+with the mask of the filters that were skipped when the chunk was
+written. Whole chunks can then be moved between files with the same
+chunking and filters without inflating and deflating them again, as
+nccopy and nc_copy_var() do.
+
+The offset and size in the file of each stored chunk, or of the data
+of a contiguous variable, can also be listed, so that other programs
+can read the data without the library.
+
+This is built on the direct chunk I/O of HDF5 and on the lookup of
+stored chunks by their coordinates, which came with HDF5 1.10.5.
+Built with an older HDF5, these functions return NC_ENOTBUILT for
+chunked variables.
+
+Copyright 2016, University Corporation for Atmospheric
+Research. See the COPYRIGHT file for copying and redistribution
+conditions.
+*/
+#include "config.h"
+#include "nc4internal.h"
+#include "nc4dispatch.h"
+
+#if H5_VERSION_GE(1,10,5)
+#define HAVE_DIRECT_CHUNK_IO 1
+#endif
+
+/* Find a var, with its dataset open, and the extent of the data
+ * written to it. Leaves define mode, as reads and writes of data
+ * do. */
+static int
+find_var(int ncid, int varid, int for_write, NC_HDF5_FILE_INFO_T **h5p,
+         NC_VAR_INFO_T **varp, hsize_t *fdims)
+{
+   NC *nc;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_GRP_INFO_T *grp;
+   NC_VAR_INFO_T *var;
+   hid_t file_spaceid;
+   int retval;
+
+   if (!(nc = nc4_find_nc_file(ncid, &h5)))
+      return NC_EBADID;
+   if ((retval = nc4_find_g_var_nc(nc, ncid, varid, &grp, &var)))
+      return retval;
+   assert(h5 && grp && var && var->name);
+
+   if (for_write && h5->no_write)
+      return NC_EPERM;
+
+#ifdef USE_HDF4
+   if (h5->hdf4)
+      return NC_EINVAL;
+#endif /* USE_HDF4 */
+
+   /* Direct chunk I/O is not done collectively. */
+   if (h5->parallel)
+      return NC_EINVAL;
+
+   /* The dataset is created, and its chunking settled, by enddef. */
+   if (h5->flags & NC_INDEF)
+   {
+      if (h5->cmode & NC_CLASSIC_MODEL)
+         return NC_EINDEFINE;
+      if ((retval = nc4_enddef_netcdf4_file(h5)))
+         return retval;
+   }
+
+   if ((retval = nc4_open_var_dataset(grp, var, var->hdf5_name ?
+                                      var->hdf5_name : var->name)))
+      return retval;
+
+   /* The extent of the data written so far. */
+   if (var->logical_dims)
+      memcpy(fdims, var->logical_dims, var->ndims * sizeof(hsize_t));
+   else
+   {
+      if ((retval = nc4_get_file_space(var, &file_spaceid)))
+         return retval;
+      if (H5Sget_simple_extent_dims(file_spaceid, fdims, NULL) < 0)
+         return NC_EHDFERR;
+   }
+
+   *h5p = h5;
+   *varp = var;
+   return NC_NOERR;
+}
+
+#ifdef HAVE_DIRECT_CHUNK_IO
+
+/* Find a chunked var, as find_var() does. */
+static int
+find_chunked_var(int ncid, int varid, int for_write,
+                 NC_HDF5_FILE_INFO_T **h5p, NC_VAR_INFO_T **varp,
+                 hsize_t *fdims)
+{
+   int retval;
+
+   if ((retval = find_var(ncid, varid, for_write, h5p, varp, fdims)))
+      return retval;
+   if (!(*varp)->ndims || (*varp)->contiguous || !(*varp)->chunksizes)
+      return NC_EINVAL;
+   return NC_NOERR;
+}
+
+/* Check that startp is the first element of a chunk within the
+ * extent, and find its offset in the dataset. */
+static int
+chunk_offset(const NC_VAR_INFO_T *var, const hsize_t *fdims,
+             const size_t *startp, hsize_t *offset)
+{
+   int d;
+
+   if (!startp)
+      return NC_EINVAL;
+   for (d = 0; d < var->ndims; d++)
+   {
+      if (startp[d] % var->chunksizes[d])
+         return NC_EINVAL;
+      if (startp[d] >= fdims[d])
+         return NC_EINVALCOORDS;
+      offset[d] = startp[d];
+   }
+   return NC_NOERR;
+}
+
+/* Read a chunk as it is stored. */
+int
+NC4_get_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int *filter_maskp, size_t *sizep, void *data)
+{
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   hsize_t fdims[NC_MAX_VAR_DIMS], offset[NC_MAX_VAR_DIMS], size;
+   unsigned filter_mask;
+   uint32_t filters;
+   haddr_t addr;
+   int retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d", __func__, ncid, varid));
+
+   if ((retval = find_chunked_var(ncid, varid, 0, &h5, &var, fdims)))
+      return retval;
+   if ((retval = chunk_offset(var, fdims, startp, offset)))
+      return retval;
+
+   if (H5Dget_chunk_info_by_coord(var->hdf_datasetid, offset, &filter_mask,
+                                  &addr, &size) < 0)
+      return NC_EHDFERR;
+   if (addr == HADDR_UNDEF)
+   {
+      filter_mask = 0;
+      size = 0;
+   }
+
+   if (data && size)
+   {
+      if (H5Dread_chunk(var->hdf_datasetid, H5P_DEFAULT, offset, &filters,
+                        data) < 0)
+         return NC_EHDFERR;
+      filter_mask = filters;
+   }
+
+   if (filter_maskp)
+      *filter_maskp = filter_mask;
+   if (sizep)
+      *sizep = (size_t)size;
+
+   return NC_NOERR;
+}
+
+/* Write a chunk as it is to be stored. */
+int
+NC4_put_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int filter_mask, size_t size, const void *data)
+{
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   hsize_t fdims[NC_MAX_VAR_DIMS], offset[NC_MAX_VAR_DIMS];
+   int retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d size %d", __func__, ncid, varid, size));
+
+   if (!data || !size)
+      return NC_EINVAL;
+   if ((retval = find_chunked_var(ncid, varid, 1, &h5, &var, fdims)))
+      return retval;
+   if ((retval = chunk_offset(var, fdims, startp, offset)))
+      return retval;
+
+   /* HDF5 evicts any cached copy of the chunk. */
+   if (H5Dwrite_chunk(var->hdf_datasetid, H5P_DEFAULT, filter_mask, offset,
+                      size, data) < 0)
+      return NC_EHDFERR;
+
+   nc4_point_cache_drop_var(h5, var);
+   var->written_to = NC_TRUE;
+
+   return NC_NOERR;
+}
+
+/* What to do with each stored chunk found by walk_chunks(). */
+typedef int (*chunk_visit_fn)(NC_VAR_INFO_T *var, const hsize_t *offset,
+                              unsigned filter_mask, haddr_t addr,
+                              hsize_t size, void *arg);
+
+/* Visit each stored chunk of a chunked var, in the order of the
+ * chunks in the var. The stored chunks are looked up by their
+ * coordinates, each in about log time, rather than by their index in
+ * storage, which HDF5 finds by walking the chunk index from the
+ * start. */
+static int
+walk_chunks(NC_VAR_INFO_T *var, const hsize_t *fdims, chunk_visit_fn visit,
+            void *arg)
+{
+   hsize_t offset[NC_MAX_VAR_DIMS], size, nstored, found = 0;
+   unsigned filter_mask;
+   haddr_t addr;
+   hid_t spaceid;
+   int retval, d;
+
+   /* Stop once all the stored chunks are found. */
+   if ((spaceid = H5Dget_space(var->hdf_datasetid)) < 0)
+      return NC_EHDFERR;
+   if (H5Dget_num_chunks(var->hdf_datasetid, spaceid, &nstored) < 0)
+   {
+      H5Sclose(spaceid);
+      return NC_EHDFERR;
+   }
+   if (H5Sclose(spaceid) < 0)
+      return NC_EHDFERR;
+   for (d = 0; d < var->ndims; d++)
+   {
+      if (!fdims[d])
+         return NC_NOERR;
+      offset[d] = 0;
+   }
+
+   while (found < nstored)
+   {
+      if (H5Dget_chunk_info_by_coord(var->hdf_datasetid, offset, &filter_mask,
+                                     &addr, &size) < 0)
+         return NC_EHDFERR;
+      if (addr != HADDR_UNDEF)
+      {
+         if ((retval = visit(var, offset, filter_mask, addr, size, arg)))
+            return retval;
+         found++;
+      }
+
+      /* On to the next chunk, last dim fastest. */
+      for (d = var->ndims - 1; d >= 0; d--)
+      {
+         offset[d] += var->chunksizes[d];
+         if (offset[d] < fdims[d])
+            break;
+         offset[d] = 0;
+      }
+      if (d < 0)
+         break;
+   }
+
+   return NC_NOERR;
+}
+
+/* The user function and data of NC4_iter_chunks_raw(). */
+typedef struct CHUNK_ITER
+{
+   nc_chunk_iter_fn fn;
+   void *udata;
+} CHUNK_ITER;
+
+static int
+visit_chunk_raw(NC_VAR_INFO_T *var, const hsize_t *offset,
+                unsigned filter_mask, haddr_t addr, hsize_t size, void *arg)
+{
+   CHUNK_ITER *iter = arg;
+   size_t start[NC_MAX_VAR_DIMS];
+   int d;
+
+   for (d = 0; d < var->ndims; d++)
+      start[d] = (size_t)offset[d];
+   return iter->fn(start, filter_mask, (size_t)size, iter->udata);
+}
+
+/* Call fn for each stored chunk of a var. */
+int
+NC4_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void *udata)
+{
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   hsize_t fdims[NC_MAX_VAR_DIMS];
+   CHUNK_ITER iter;
+   int retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d", __func__, ncid, varid));
+
+   if (!fn)
+      return NC_EINVAL;
+   if ((retval = find_chunked_var(ncid, varid, 0, &h5, &var, fdims)))
+      return retval;
+
+   iter.fn = fn;
+   iter.udata = udata;
+   return walk_chunks(var, fdims, visit_chunk_raw, &iter);
+}
+
+/* The user function and data of NC4_iter_byte_ranges(), and where
+ * HDF5 addresses start in the file. */
+typedef struct RANGE_ITER
+{
+   nc_byte_range_fn fn;
+   void *udata;
+   hsize_t base;
+} RANGE_ITER;
+
+static int
+visit_chunk_range(NC_VAR_INFO_T *var, const hsize_t *offset,
+                  unsigned filter_mask, haddr_t addr, hsize_t size, void *arg)
+{
+   RANGE_ITER *iter = arg;
+   size_t start[NC_MAX_VAR_DIMS];
+   int d;
+
+   for (d = 0; d < var->ndims; d++)
+      start[d] = (size_t)offset[d];
+   return iter->fn(start, var->chunksizes, iter->base + addr, size,
+                   filter_mask, iter->udata);
+}
+
+#else /* HAVE_DIRECT_CHUNK_IO */
+
+int
+NC4_get_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int *filter_maskp, size_t *sizep, void *data)
+{
+   return NC_ENOTBUILT;
+}
+
+int
+NC4_put_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int filter_mask, size_t size, const void *data)
+{
+   return NC_ENOTBUILT;
+}
+
+int
+NC4_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void *udata)
+{
+   return NC_ENOTBUILT;
+}
+
+#endif /* HAVE_DIRECT_CHUNK_IO */
+
+/* Call fn with where the data of a var is in the file: each stored
+ * chunk of a chunked var, or the whole of a contiguous one. */
+int
+NC4_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void *udata)
+{
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   hsize_t fdims[NC_MAX_VAR_DIMS], size, base;
+   size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+   haddr_t addr;
+   hid_t plistid;
+   int retval, d;
+
+   LOG((2, "%s: ncid 0x%x varid %d", __func__, ncid, varid));
+
+   if (!fn)
+      return NC_EINVAL;
+   if ((retval = find_var(ncid, varid, 0, &h5, &var, fdims)))
+      return retval;
+
+   /* HDF5 addresses are from the end of any user block. */
+   if ((plistid = H5Fget_create_plist(h5->hdfid)) < 0)
+      return NC_EHDFERR;
+   if (H5Pget_userblock(plistid, &base) < 0)
+   {
+      H5Pclose(plistid);
+      return NC_EHDFERR;
+   }
+   if (H5Pclose(plistid) < 0)
+      return NC_EHDFERR;
+
+   if (var->ndims && !var->contiguous && var->chunksizes)
+   {
+#ifdef HAVE_DIRECT_CHUNK_IO
+      RANGE_ITER iter;
+
+      iter.fn = fn;
+      iter.udata = udata;
+      iter.base = base;
+      return walk_chunks(var, fdims, visit_chunk_range, &iter);
+#else
+      return NC_ENOTBUILT;
+#endif /* HAVE_DIRECT_CHUNK_IO */
+   }
+
+   /* Data that is not yet written, or is kept in the object header,
+    * has no range of its own. */
+   if ((addr = H5Dget_offset(var->hdf_datasetid)) == HADDR_UNDEF)
+      return NC_NOERR;
+   if (!(size = H5Dget_storage_size(var->hdf_datasetid)))
+      return NC_NOERR;
+   for (d = 0; d < var->ndims; d++)
+   {
+      start[d] = 0;
+      count[d] = (size_t)fdims[d];
+   }
+   return fn(start, count, base + addr, size, 0, udata);
+}
@@ -0,0 +1,627 @@
+/** \file \internal
+Data type conversion for netcdf-4.
+
+This file contains nc4_convert_type(), which converts data between the
+netCDF atomic types when the memory type of a get or put differs from
+the type of the variable or attribute in the file, and
+nc4_quantize_data(), which trims the precision of float data as it is
+written. Every (source,
+destination) pair has its own conversion kernel, found by indexing a
+table, so that the inner loops are free of type dispatch and can be
+vectorized by the compiler. Where SSE2 is available the most common
+floating point pairs use it directly.
+
+Copyright 2016, University Corporation for Atmospheric
+Research. See the COPYRIGHT file for copying and redistribution
+conditions.
+*/
+#include "config.h"
+#include <math.h>
+#include <string.h>
+#include "nc4internal.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2_CONVERT
+#include <emmintrin.h>
+#endif
+
+/* The source and destination of a conversion never overlap. */
+#if defined(_MSC_VER)
+#define NC_RESTRICT __restrict
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define NC_RESTRICT restrict
+#else
+#define NC_RESTRICT
+#endif
+
+/* A conversion kernel converts len values and returns the number of
+ * them that were out of range for the destination type. */
+typedef size_t (*NC_CONVERT_FN)(const void *src, void *dest, size_t len);
+
+/* The in-memory type of native long, used for NC_INT when the caller
+ * passes longs, has its own slot in the table after the atomic
+ * types. */
+#define CONVERT_LONG (NC_UINT64 + 1)
+#define NUM_CONVERT_TYPES (CONVERT_LONG + 1)
+
+#define CTYPE_schar signed char
+#define CTYPE_uchar unsigned char
+#define CTYPE_short short
+#define CTYPE_ushort unsigned short
+#define CTYPE_int int
+#define CTYPE_uint unsigned int
+#define CTYPE_long long
+#define CTYPE_int64 long long
+#define CTYPE_uint64 unsigned long long
+#define CTYPE_float float
+#define CTYPE_double double
+
+/* A conversion that can never be out of range. */
+#define CONVERT(s, d)                                                   \
+   static size_t                                                        \
+   convert_##s##_##d(const void *src, void *dest, size_t len)           \
+   {                                                                    \
+      const CTYPE_##s *NC_RESTRICT sp = (const CTYPE_##s *)src;         \
+      CTYPE_##d *NC_RESTRICT dp = (CTYPE_##d *)dest;                    \
+      size_t i;                                                         \
+      for (i = 0; i < len; i++)                                         \
+         dp[i] = (CTYPE_##d)sp[i];                                      \
+      return 0;                                                         \
+   }
+
+/* A conversion that counts the values v for which out_of_range is
+ * true. The test is written with | rather than || so the loop has no
+ * branches. */
+#define CONVERT_CHECKED(s, d, out_of_range)                             \
+   static size_t                                                        \
+   convert_##s##_##d(const void *src, void *dest, size_t len)           \
+   {                                                                    \
+      const CTYPE_##s *NC_RESTRICT sp = (const CTYPE_##s *)src;         \
+      CTYPE_##d *NC_RESTRICT dp = (CTYPE_##d *)dest;                    \
+      size_t i, nerr = 0;                                               \
+      for (i = 0; i < len; i++)                                         \
+      {                                                                 \
+         CTYPE_##s v = sp[i];                                           \
+         nerr += (size_t)(out_of_range);                                \
+         dp[i] = (CTYPE_##d)v;                                          \
+      }                                                                 \
+      return nerr;                                                      \
+   }
+
+/* Conversions between identical representations. */
+#define CONVERT_COPY(size)                                              \
+   static size_t                                                        \
+   convert_copy##size(const void *src, void *dest, size_t len)          \
+   {                                                                    \
+      memcpy(dest, src, len * size);                                    \
+      return 0;                                                         \
+   }
+
+CONVERT_COPY(1)
+CONVERT_COPY(2)
+CONVERT_COPY(4)
+CONVERT_COPY(8)
+
+/* From signed char. */
+CONVERT_CHECKED(schar, uchar, v < 0)
+CONVERT(schar, short)
+CONVERT_CHECKED(schar, ushort, v < 0)
+CONVERT(schar, int)
+CONVERT(schar, long)
+CONVERT_CHECKED(schar, uint, v < 0)
+CONVERT(schar, int64)
+CONVERT_CHECKED(schar, uint64, v < 0)
+CONVERT(schar, float)
+CONVERT(schar, double)
+
+/* From unsigned char. */
+CONVERT_CHECKED(uchar, schar, v > X_SCHAR_MAX)
+CONVERT(uchar, short)
+CONVERT(uchar, ushort)
+CONVERT(uchar, int)
+CONVERT(uchar, long)
+CONVERT(uchar, uint)
+CONVERT(uchar, int64)
+CONVERT(uchar, uint64)
+CONVERT(uchar, float)
+CONVERT(uchar, double)
+
+/* From short. */
+CONVERT_CHECKED(short, schar, (v > X_SCHAR_MAX) | (v < X_SCHAR_MIN))
+CONVERT_CHECKED(short, uchar, (v > X_UCHAR_MAX) | (v < 0))
+CONVERT_CHECKED(short, ushort, v < 0)
+CONVERT(short, int)
+CONVERT(short, long)
+CONVERT_CHECKED(short, uint, v < 0)
+CONVERT(short, int64)
+CONVERT_CHECKED(short, uint64, v < 0)
+CONVERT(short, float)
+CONVERT(short, double)
+
+/* From unsigned short. */
+CONVERT_CHECKED(ushort, schar, v > X_SCHAR_MAX)
+CONVERT_CHECKED(ushort, uchar, v > X_UCHAR_MAX)
+CONVERT_CHECKED(ushort, short, v > X_SHORT_MAX)
+CONVERT(ushort, int)
+CONVERT(ushort, long)
+CONVERT(ushort, uint)
+CONVERT(ushort, int64)
+CONVERT(ushort, uint64)
+CONVERT(ushort, float)
+CONVERT(ushort, double)
+
+/* From int. */
+CONVERT_CHECKED(int, schar, (v > X_SCHAR_MAX) | (v < X_SCHAR_MIN))
+CONVERT_CHECKED(int, uchar, (v > X_UCHAR_MAX) | (v < 0))
+CONVERT_CHECKED(int, short, (v > X_SHORT_MAX) | (v < X_SHORT_MIN))
+CONVERT_CHECKED(int, ushort, (v > X_USHORT_MAX) | (v < 0))
+CONVERT(int, long)
+CONVERT_CHECKED(int, uint, v < 0)
+CONVERT(int, int64)
+CONVERT_CHECKED(int, uint64, v < 0)
+#ifndef USE_SSE2_CONVERT
+CONVERT(int, float)
+CONVERT(int, double)
+#endif
+
+/* From long, stored in the file as NC_INT. */
+CONVERT_CHECKED(long, schar, (v > X_SCHAR_MAX) | (v < X_SCHAR_MIN))
+CONVERT_CHECKED(long, uchar, (v > X_UCHAR_MAX) | (v < 0))
+CONVERT_CHECKED(long, short, (v > X_SHORT_MAX) | (v < X_SHORT_MIN))
+CONVERT_CHECKED(long, ushort, (v > X_USHORT_MAX) | (v < 0))
+CONVERT_CHECKED(long, int, (v > X_INT_MAX) | (v < X_INT_MIN))
+CONVERT_CHECKED(long, long, (v > X_LONG_MAX) | (v < X_LONG_MIN))
+CONVERT_CHECKED(long, uint, (v > X_UINT_MAX) | (v < 0))
+CONVERT(long, int64)
+CONVERT_CHECKED(long, uint64, v < 0)
+CONVERT(long, float)
+CONVERT(long, double)
+
+/* From unsigned int. */
+CONVERT_CHECKED(uint, schar, v > X_SCHAR_MAX)
+CONVERT_CHECKED(uint, uchar, v > X_UCHAR_MAX)
+CONVERT_CHECKED(uint, short, v > X_SHORT_MAX)
+CONVERT_CHECKED(uint, ushort, v > X_USHORT_MAX)
+CONVERT_CHECKED(uint, int, v > X_INT_MAX)
+CONVERT_CHECKED(uint, long, v > X_LONG_MAX)
+CONVERT(uint, int64)
+CONVERT(uint, uint64)
+CONVERT(uint, float)
+CONVERT(uint, double)
+
+/* From long long. */
+CONVERT_CHECKED(int64, schar, (v > X_SCHAR_MAX) | (v < X_SCHAR_MIN))
+CONVERT_CHECKED(int64, uchar, (v > X_UCHAR_MAX) | (v < 0))
+CONVERT_CHECKED(int64, short, (v > X_SHORT_MAX) | (v < X_SHORT_MIN))
+CONVERT_CHECKED(int64, ushort, (v > X_USHORT_MAX) | (v < 0))
+CONVERT_CHECKED(int64, int, (v > X_INT_MAX) | (v < X_INT_MIN))
+CONVERT_CHECKED(int64, long, (v > X_LONG_MAX) | (v < X_LONG_MIN))
+CONVERT_CHECKED(int64, uint, (v > X_UINT_MAX) | (v < 0))
+CONVERT_CHECKED(int64, uint64, v < 0)
+CONVERT(int64, float)
+CONVERT(int64, double)
+
+/* From unsigned long long. */
+CONVERT_CHECKED(uint64, schar, v > X_SCHAR_MAX)
+CONVERT_CHECKED(uint64, uchar, v > X_UCHAR_MAX)
+CONVERT_CHECKED(uint64, short, v > X_SHORT_MAX)
+CONVERT_CHECKED(uint64, ushort, v > X_USHORT_MAX)
+CONVERT_CHECKED(uint64, int, v > X_INT_MAX)
+CONVERT_CHECKED(uint64, long, v > X_LONG_MAX)
+CONVERT_CHECKED(uint64, uint, v > X_UINT_MAX)
+CONVERT_CHECKED(uint64, int64, v > X_INT64_MAX)
+CONVERT(uint64, float)
+CONVERT(uint64, double)
+
+/* From float. */
+CONVERT_CHECKED(float, schar,
+                (v > (double)X_SCHAR_MAX) | (v < (double)X_SCHAR_MIN))
+CONVERT_CHECKED(float, uchar, (v > X_UCHAR_MAX) | (v < 0))
+CONVERT_CHECKED(float, short,
+                (v > (double)X_SHORT_MAX) | (v < (double)X_SHORT_MIN))
+CONVERT_CHECKED(float, ushort, (v > X_USHORT_MAX) | (v < 0))
+CONVERT_CHECKED(float, int,
+                (v > (double)X_INT_MAX) | (v < (double)X_INT_MIN))
+CONVERT_CHECKED(float, long,
+                (v > (double)X_LONG_MAX) | (v < (double)X_LONG_MIN))
+CONVERT_CHECKED(float, uint, (v > X_UINT_MAX) | (v < 0))
+CONVERT_CHECKED(float, int64, (v > X_INT64_MAX) | (v < X_INT64_MIN))
+CONVERT_CHECKED(float, uint64, (v > X_UINT64_MAX) | (v < 0))
+#ifndef USE_SSE2_CONVERT
+CONVERT(float, double)
+#endif
+
+/* From double. */
+CONVERT_CHECKED(double, schar, (v > X_SCHAR_MAX) | (v < X_SCHAR_MIN))
+CONVERT_CHECKED(double, uchar, (v > X_UCHAR_MAX) | (v < 0))
+CONVERT_CHECKED(double, short, (v > X_SHORT_MAX) | (v < X_SHORT_MIN))
+CONVERT_CHECKED(double, ushort, (v > X_USHORT_MAX) | (v < 0))
+CONVERT_CHECKED(double, int, (v > X_INT_MAX) | (v < X_INT_MIN))
+CONVERT_CHECKED(double, long, (v > X_LONG_MAX) | (v < X_LONG_MIN))
+CONVERT_CHECKED(double, uint, (v > X_UINT_MAX) | (v < 0))
+CONVERT_CHECKED(double, int64, (v > X_INT64_MAX) | (v < X_INT64_MIN))
+CONVERT_CHECKED(double, uint64, (v > X_UINT64_MAX) | (v < 0))
+#ifndef USE_SSE2_CONVERT
+CONVERT_CHECKED(double, float, (v > X_FLOAT_MAX) | (v < X_FLOAT_MIN))
+#endif
+
+#ifdef USE_SSE2_CONVERT
+/* SSE2 versions of the conversions that reads and writes of
+ * floating point data most often need. Each handles four values per
+ * step and finishes the tail one value at a time. */
+
+static size_t
+convert_float_double(const void *src, void *dest, size_t len)
+{
+   const float *sp = (const float *)src;
+   double *dp = (double *)dest;
+   size_t i;
+
+   for (i = 0; i + 4 <= len; i += 4)
+   {
+      __m128 f = _mm_loadu_ps(sp + i);
+      _mm_storeu_pd(dp + i, _mm_cvtps_pd(f));
+      _mm_storeu_pd(dp + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+   }
+   for (; i < len; i++)
+      dp[i] = sp[i];
+   return 0;
+}
+
+static size_t
+convert_double_float(const void *src, void *dest, size_t len)
+{
+   const double *sp = (const double *)src;
+   float *dp = (float *)dest;
+   const __m128d max = _mm_set1_pd(X_FLOAT_MAX);
+   const __m128d min = _mm_set1_pd(X_FLOAT_MIN);
+   size_t i, nerr = 0;
+
+   for (i = 0; i + 4 <= len; i += 4)
+   {
+      __m128d a = _mm_loadu_pd(sp + i);
+      __m128d b = _mm_loadu_pd(sp + i + 2);
+      int ma = _mm_movemask_pd(_mm_or_pd(_mm_cmpgt_pd(a, max),
+                                         _mm_cmplt_pd(a, min)));
+      int mb = _mm_movemask_pd(_mm_or_pd(_mm_cmpgt_pd(b, max),
+                                         _mm_cmplt_pd(b, min)));
+      nerr += (size_t)((ma & 1) + (ma >> 1) + (mb & 1) + (mb >> 1));
+      _mm_storeu_ps(dp + i, _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b)));
+   }
+   for (; i < len; i++)
+   {
+      double v = sp[i];
+      nerr += (size_t)((v > X_FLOAT_MAX) | (v < X_FLOAT_MIN));
+      dp[i] = (float)v;
+   }
+   return nerr;
+}
+
+static size_t
+convert_int_float(const void *src, void *dest, size_t len)
+{
+   const int *sp = (const int *)src;
+   float *dp = (float *)dest;
+   size_t i;
+
+   for (i = 0; i + 4 <= len; i += 4)
+      _mm_storeu_ps(dp + i, _mm_cvtepi32_ps(
+                       _mm_loadu_si128((const __m128i *)(sp + i))));
+   for (; i < len; i++)
+      dp[i] = (float)sp[i];
+   return 0;
+}
+
+static size_t
+convert_int_double(const void *src, void *dest, size_t len)
+{
+   const int *sp = (const int *)src;
+   double *dp = (double *)dest;
+   size_t i;
+
+   for (i = 0; i + 4 <= len; i += 4)
+   {
+      __m128i n = _mm_loadu_si128((const __m128i *)(sp + i));
+      _mm_storeu_pd(dp + i, _mm_cvtepi32_pd(n));
+      _mm_storeu_pd(dp + i + 2, _mm_cvtepi32_pd(_mm_srli_si128(n, 8)));
+   }
+   for (; i < len; i++)
+      dp[i] = sp[i];
+   return 0;
+}
+#endif /* USE_SSE2_CONVERT */
+
+/* The conversion kernels, indexed by source and destination type. A
+ * NULL entry is a conversion that is not allowed. NC_CHAR only
+ * converts to itself. */
+static const NC_CONVERT_FN convert_table[NUM_CONVERT_TYPES][NUM_CONVERT_TYPES] = {
+   /* Columns: NC_NAT, NC_BYTE, NC_CHAR, NC_SHORT, NC_INT, NC_FLOAT,
+    * NC_DOUBLE, NC_UBYTE, NC_USHORT, NC_UINT, NC_INT64, NC_UINT64,
+    * long */
+   /* NC_NAT */
+   {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL},
+   /* NC_BYTE */
+   {NULL, convert_copy1, NULL, convert_schar_short, convert_schar_int,
+    convert_schar_float, convert_schar_double, convert_schar_uchar,
+    convert_schar_ushort, convert_schar_uint, convert_schar_int64,
+    convert_schar_uint64, convert_schar_long},
+   /* NC_CHAR */
+   {NULL, NULL, convert_copy1, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL},
+   /* NC_SHORT */
+   {NULL, convert_short_schar, NULL, convert_copy2, convert_short_int,
+    convert_short_float, convert_short_double, convert_short_uchar,
+    convert_short_ushort, convert_short_uint, convert_short_int64,
+    convert_short_uint64, convert_short_long},
+   /* NC_INT */
+   {NULL, convert_int_schar, NULL, convert_int_short, convert_copy4,
+    convert_int_float, convert_int_double, convert_int_uchar,
+    convert_int_ushort, convert_int_uint, convert_int_int64,
+    convert_int_uint64, convert_int_long},
+   /* NC_FLOAT */
+   {NULL, convert_float_schar, NULL, convert_float_short, convert_float_int,
+    convert_copy4, convert_float_double, convert_float_uchar,
+    convert_float_ushort, convert_float_uint, convert_float_int64,
+    convert_float_uint64, convert_float_long},
+   /* NC_DOUBLE */
+   {NULL, convert_double_schar, NULL, convert_double_short,
+    convert_double_int, convert_double_float, convert_copy8,
+    convert_double_uchar, convert_double_ushort, convert_double_uint,
+    convert_double_int64, convert_double_uint64, convert_double_long},
+   /* NC_UBYTE */
+   {NULL, convert_uchar_schar, NULL, convert_uchar_short, convert_uchar_int,
+    convert_uchar_float, convert_uchar_double, convert_copy1,
+    convert_uchar_ushort, convert_uchar_uint, convert_uchar_int64,
+    convert_uchar_uint64, convert_uchar_long},
+   /* NC_USHORT */
+   {NULL, convert_ushort_schar, NULL, convert_ushort_short,
+    convert_ushort_int, convert_ushort_float, convert_ushort_double,
+    convert_ushort_uchar, convert_copy2, convert_ushort_uint,
+    convert_ushort_int64, convert_ushort_uint64, convert_ushort_long},
+   /* NC_UINT */
+   {NULL, convert_uint_schar, NULL, convert_uint_short, convert_uint_int,
+    convert_uint_float, convert_uint_double, convert_uint_uchar,
+    convert_uint_ushort, convert_copy4, convert_uint_int64,
+    convert_uint_uint64, convert_uint_long},
+   /* NC_INT64 */
+   {NULL, convert_int64_schar, NULL, convert_int64_short, convert_int64_int,
+    convert_int64_float, convert_int64_double, convert_int64_uchar,
+    convert_int64_ushort, convert_int64_uint, convert_copy8,
+    convert_int64_uint64, convert_int64_long},
+   /* NC_UINT64 */
+   {NULL, convert_uint64_schar, NULL, convert_uint64_short,
+    convert_uint64_int, convert_uint64_float, convert_uint64_double,
+    convert_uint64_uchar, convert_uint64_ushort, convert_uint64_uint,
+    convert_uint64_int64, convert_copy8, convert_uint64_long},
+   /* long */
+   {NULL, convert_long_schar, NULL, convert_long_short, convert_long_int,
+    convert_long_float, convert_long_double, convert_long_uchar,
+    convert_long_ushort, convert_long_uint, convert_long_int64,
+    convert_long_uint64, convert_long_long}
+};
+
+/*! Copy data from one buffer to another, performing appropriate data conversion.
+
+  This function will copy data from one buffer to another, in
+  accordance with the types. Range errors will be noted, and the fill
+  value used (or the default fill value if none is supplied) for
+  values that overflow the type.
+
+  The buffers must not overlap. If src_long (dest_long) is set and the
+  source (destination) type is NC_INT, the values in that buffer are
+  native longs.
+
+  Ed Hartnett, 11/15/3
+*/
+int
+nc4_convert_type(const void *src, void *dest,
+                 const nc_type src_type, const nc_type dest_type,
+                 const size_t len, int *range_error,
+                 const void *fill_value, int strict_nc3, int src_long,
+                 int dest_long)
+{
+  NC_CONVERT_FN convert;
+  int s, d;
+
+  *range_error = 0;
+  LOG((3, "%s: len %d src_type %d dest_type %d src_long %d dest_long %d",
+       __func__, len, src_type, dest_type, src_long, dest_long));
+
+  if (src_type <= NC_NAT || src_type > NC_UINT64)
+    {
+      LOG((0, "%s: unexpected src type. src_type %d, dest_type %d",
+           __func__, src_type, dest_type));
+      return NC_EBADTYPE;
+    }
+
+  /* Text is only ever copied as text; anything else is ignored. */
+  if (src_type == NC_CHAR && dest_type != NC_CHAR)
+    {
+      LOG((0, "%s: Uknown destination type.", __func__));
+      return NC_NOERR;
+    }
+
+  if (dest_type <= NC_NAT || dest_type > NC_UINT64)
+    {
+      LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
+           __func__, src_type, dest_type));
+      return NC_EBADTYPE;
+    }
+
+  s = (src_type == NC_INT && src_long) ? CONVERT_LONG : src_type;
+  d = (dest_type == NC_INT && dest_long) ? CONVERT_LONG : dest_type;
+
+  /* With strict netCDF-3 rules, bytes are unsigned or signed as the
+   * user likes, so no range errors are possible. */
+  if (strict_nc3 && s == NC_UBYTE && d == NC_BYTE)
+    convert = convert_copy1;
+  else
+    convert = convert_table[s][d];
+  if (!convert)
+    {
+      LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
+           __func__, src_type, dest_type));
+      return NC_EBADTYPE;
+    }
+
+  *range_error = (int)convert(src, dest, len);
+  return NC_NOERR;
+}
+
+/* Quantization. The bits of the mantissa below the nsd significant
+ * digits (bit grooming) or bits (bit rounding) kept are zeroed, so
+ * that the shuffle and deflate filters find long runs of zeros. Bit
+ * grooming shaves the bits of even values to zero and sets those of
+ * odd values to one, which keeps the mean of the errors near zero;
+ * bit rounding adds half of the last bit kept before shaving. Fill
+ * values, NaNs and infinities are left as they are, as are zeros when
+ * bits would be set. */
+
+/* Binary digits per decimal digit, log2(10). */
+#define QUANTIZE_BITS_PER_DIGIT 3.321928094887362
+
+/* The number of low mantissa bits to zero, of the mant_bits
+ * explicit ones. Bit grooming keeps one guard bit more than the
+ * digits need. */
+static int
+quantize_zero_bits(int quantize_mode, int nsd, int mant_bits)
+{
+   int keep;
+
+   if (quantize_mode == NC_QUANTIZE_BITGROOM)
+      keep = (int)ceil(nsd * QUANTIZE_BITS_PER_DIGIT) + 1;
+   else
+      keep = nsd;
+   return keep >= mant_bits ? 0 : mant_bits - keep;
+}
+
+#define QUANTIZE_SCALAR(utype, exp_mask, abs_mask)                      \
+   do {                                                                 \
+      for (; i < len; i++)                                              \
+      {                                                                 \
+         utype v = u[i];                                                \
+         if ((v & exp_mask) == exp_mask || v == fill)                   \
+            continue;                                                   \
+         if (!groom)                                                    \
+            u[i] = (v + half) & zro;                                    \
+         else if (i % 2 == 0)                                           \
+            u[i] = v & zro;                                             \
+         else if (v & abs_mask)                                         \
+            u[i] = v | one;                                             \
+      }                                                                 \
+   } while (0)
+
+static void
+quantize_float(void *data, size_t len, int groom, int nzero,
+               const void *fill_value)
+{
+   uint32_t *u = (uint32_t *)data;
+   const uint32_t zro = ~(((uint32_t)1 << nzero) - 1), one = ~zro;
+   const uint32_t half = (uint32_t)1 << (nzero - 1);
+   uint32_t fill;
+   float f = NC_FILL_FLOAT;
+   size_t i = 0;
+
+   memcpy(&fill, fill_value ? fill_value : &f, sizeof(fill));
+#ifdef USE_SSE2_CONVERT
+   {
+      const __m128i vexp = _mm_set1_epi32(0x7f800000);
+      const __m128i vabs = _mm_set1_epi32(0x7fffffff);
+      const __m128i vfill = _mm_set1_epi32((int)fill);
+      const __m128i vzro = _mm_set1_epi32((int)zro);
+      const __m128i vhalf = _mm_set1_epi32((int)half);
+      const __m128i vzero = _mm_setzero_si128();
+      /* Even lanes are shaved, odd ones set. */
+      const __m128i groom_and = _mm_set_epi32(-1, (int)zro, -1, (int)zro);
+      const __m128i groom_or = _mm_set_epi32((int)one, 0, (int)one, 0);
+
+      for (; i + 4 <= len; i += 4)
+      {
+         __m128i v = _mm_loadu_si128((const __m128i *)(u + i)), r;
+         __m128i keep = _mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(v, vexp), vexp),
+                                     _mm_cmpeq_epi32(v, vfill));
+         if (groom)
+            r = _mm_or_si128(_mm_and_si128(v, groom_and),
+                             _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(v, vabs), vzero),
+                                              groom_or));
+         else
+            r = _mm_and_si128(_mm_add_epi32(v, vhalf), vzro);
+         r = _mm_or_si128(_mm_and_si128(keep, v), _mm_andnot_si128(keep, r));
+         _mm_storeu_si128((__m128i *)(u + i), r);
+      }
+   }
+#endif
+   QUANTIZE_SCALAR(uint32_t, 0x7f800000U, 0x7fffffffU);
+}
+
+static void
+quantize_double(void *data, size_t len, int groom, int nzero,
+                const void *fill_value)
+{
+   uint64_t *u = (uint64_t *)data;
+   const uint64_t zro = ~(((uint64_t)1 << nzero) - 1), one = ~zro;
+   const uint64_t half = (uint64_t)1 << (nzero - 1);
+   uint64_t fill;
+   double d = NC_FILL_DOUBLE;
+   size_t i = 0;
+
+   memcpy(&fill, fill_value ? fill_value : &d, sizeof(fill));
+#ifdef USE_SSE2_CONVERT
+   {
+      /* SSE2 has no 64-bit compare: both 32-bit halves must be
+       * equal. */
+#define CMPEQ64(a, b) \
+      (t = _mm_cmpeq_epi32(a, b), _mm_and_si128(t, _mm_shuffle_epi32(t, _MM_SHUFFLE(2, 3, 0, 1))))
+      const __m128i vexp = _mm_set1_epi64x((long long)0x7ff0000000000000ULL);
+      const __m128i vabs = _mm_set1_epi64x((long long)0x7fffffffffffffffULL);
+      const __m128i vfill = _mm_set1_epi64x((long long)fill);
+      const __m128i vzro = _mm_set1_epi64x((long long)zro);
+      const __m128i vhalf = _mm_set1_epi64x((long long)half);
+      const __m128i vzero = _mm_setzero_si128();
+      const __m128i groom_and = _mm_set_epi64x(-1, (long long)zro);
+      const __m128i groom_or = _mm_set_epi64x((long long)one, 0);
+      __m128i t;
+
+      for (; i + 2 <= len; i += 2)
+      {
+         __m128i v = _mm_loadu_si128((const __m128i *)(u + i)), r, keep;
+         keep = CMPEQ64(_mm_and_si128(v, vexp), vexp);
+         keep = _mm_or_si128(keep, CMPEQ64(v, vfill));
+         if (groom)
+            r = _mm_or_si128(_mm_and_si128(v, groom_and),
+                             _mm_andnot_si128(CMPEQ64(_mm_and_si128(v, vabs), vzero),
+                                              groom_or));
+         else
+            r = _mm_and_si128(_mm_add_epi64(v, vhalf), vzro);
+         r = _mm_or_si128(_mm_and_si128(keep, v), _mm_andnot_si128(keep, r));
+         _mm_storeu_si128((__m128i *)(u + i), r);
+      }
+#undef CMPEQ64
+   }
+#endif
+   QUANTIZE_SCALAR(uint64_t, 0x7ff0000000000000ULL, 0x7fffffffffffffffULL);
+}
+
+/*! Quantize len values of type NC_FLOAT or NC_DOUBLE in place, as set
+  with nc_def_var_quantize(). Values equal to fill_value (or, if it
+  is NULL, the default fill value) are left alone. */
+void
+nc4_quantize_data(void *data, nc_type type, size_t len, int quantize_mode,
+                  int nsd, const void *fill_value)
+{
+   int groom = quantize_mode == NC_QUANTIZE_BITGROOM, nzero;
+
+   if (quantize_mode == NC_NOQUANTIZE)
+      return;
+   if (type == NC_FLOAT)
+   {
+      if ((nzero = quantize_zero_bits(quantize_mode, nsd, 23)))
+         quantize_float(data, len, groom, nzero, fill_value);
+   }
+   else if (type == NC_DOUBLE)
+   {
+      if ((nzero = quantize_zero_bits(quantize_mode, nsd, 52)))
+         quantize_double(data, len, groom, nzero, fill_value);
+   }
+}
@@ -279,6 +279,9 @@ NC4_rename_dim(int ncid, int dimid, const char *name)
       return NC_EBADDIM;
    dim = tmp_dim;
 
+   /* The new name is in the metadata written on the next sync. */
+   h5->meta_dirty = NC_TRUE;
+
    /* Check for renaming dimension w/o variable */
    if (dim->hdf_dimscaleid)
    {
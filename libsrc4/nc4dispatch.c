@@ -10,6 +10,19 @@
 #include "ncdispatch.h"
 #include "nc4dispatch.h"
 
+/* I/O statistics are kept by the classic ncio layer only */
+static int
+NC4_inq_io_stats(int ncid, nc_io_stats_t *statsp)
+{
+    return NC_ENOTNC3;
+}
+
+static int
+NC4_reset_io_stats(int ncid)
+{
+    return NC_ENOTNC3;
+}
+
 static NC_Dispatch NC4_dispatcher = {
 
 NC_FORMATX_NC4,
@@ -98,6 +111,31 @@ NC4_def_var_endian,
 NC4_set_var_chunk_cache,
 NC4_get_var_chunk_cache,
 
+NC4_inq_io_stats,
+NC4_reset_io_stats,
+
+NC4_inq_memory_usage,
+
+NC4_set_append_mode,
+
+NC4_get_var_points,
+
+NC4_def_var_quantize,
+NC4_inq_var_quantize,
+
+NC4_set_metadata_index,
+NC4_inq_metadata_index,
+NC4_get_chunk_raw,
+NC4_put_chunk_raw,
+NC4_iter_chunks_raw,
+NC4_iter_byte_ranges,
+NC4_def_var_filter,
+NC4_inq_var_filter,
+NC4_get_vara_field,
+NC4_get_vara_packed,
+NC4_put_vara_packed,
+NC4_inq_var_filter_ids,
+
 };
 
 NC_Dispatch* NC4_dispatch_table = NULL; /* moved here from ddispatch.c */
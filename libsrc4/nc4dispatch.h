@@ -268,6 +268,58 @@ NC4_inq_unlimdims(int, int *, int *);
 EXTERNL int
 NC4_show_metadata(int);
 
+EXTERNL int
+NC4_inq_memory_usage(int, nc_memory_usage_t *);
+
+EXTERNL int
+NC4_set_append_mode(int, int, int *);
+
+EXTERNL int
+NC4_get_var_points(int, int, size_t, const size_t *, void *, nc_type);
+
+EXTERNL int
+NC4_def_var_quantize(int, int, int, int);
+
+EXTERNL int
+NC4_inq_var_quantize(int, int, int *, int *);
+
+EXTERNL int
+NC4_set_metadata_index(int, int, int *);
+
+EXTERNL int
+NC4_inq_metadata_index(int, int *, int *);
+
+EXTERNL int
+NC4_get_chunk_raw(int, int, const size_t *, unsigned int *, size_t *, void *);
+
+EXTERNL int
+NC4_put_chunk_raw(int, int, const size_t *, unsigned int, size_t, const void *);
+
+EXTERNL int
+NC4_iter_chunks_raw(int, int, nc_chunk_iter_fn, void *);
+
+EXTERNL int
+NC4_iter_byte_ranges(int, int, nc_byte_range_fn, void *);
+
+EXTERNL int
+NC4_def_var_filter(int, int, unsigned int, size_t, const unsigned int *);
+
+EXTERNL int
+NC4_inq_var_filter(int, int, unsigned int *, size_t *, unsigned int *);
+
+EXTERNL int
+NC4_get_vara_field(int, int, int, const size_t *, const size_t *, void *);
+
+EXTERNL int
+NC4_get_vara_packed(int, int, const size_t *, const size_t *, size_t *, void **);
+
+EXTERNL int
+NC4_put_vara_packed(int, int, const size_t *, const size_t *, const size_t *,
+                    const void *);
+
+EXTERNL int
+NC4_inq_var_filter_ids(int, int, size_t *, unsigned int *);
+
 extern int 
 NC4_initialize(void);
 
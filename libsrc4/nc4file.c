@@ -125,6 +125,40 @@ size_t nc4_chunk_cache_size = CHUNK_CACHE_SIZE;
 size_t nc4_chunk_cache_nelems = CHUNK_CACHE_NELEMS;
 float nc4_chunk_cache_preemption = CHUNK_CACHE_PREEMPTION;
 
+/* This is the default size of the cache of decoded chunks for point
+ * reads of files created or opened with netCDF-4. */
+size_t nc4_point_cache_size = NC4_POINT_CACHE_SIZE;
+
+/* How HDF5 lays out, and caches, the metadata of files created or
+ * opened with netCDF-4. Zero leaves HDF5's default. They start from
+ * the environment, read once, and are overridden by the nc_set_*
+ * calls below. */
+#define NC4_META_BLOCK_ENV "NETCDF_META_BLOCK_SIZE"
+#define NC4_PAGE_SIZE_ENV "NETCDF_PAGE_SIZE"
+#define NC4_PAGE_BUFFER_ENV "NETCDF_PAGE_BUFFER_SIZE"
+#define NC4_ALIGNMENT_ENV "NETCDF_ALIGNMENT"
+#define NC4_ALIGN_THRESHOLD_ENV "NETCDF_ALIGN_THRESHOLD"
+#define NC4_METADATA_CACHE_ENV "NETCDF_METADATA_CACHE_SIZE"
+#define NC4_MIN_PAGE_SIZE 512                   /* HDF5's smallest page */
+#define NC4_MIN_METADATA_CACHE 1024             /* HDF5's limits on the */
+#define NC4_MAX_METADATA_CACHE (128 * MEGABYTE) /* metadata cache size */
+/* HDF5 1.10.1 added the paged file space strategy. Its page buffer
+ * reads past the end of its pages on speculative reads of metadata
+ * before 1.14, so is not used. */
+#if H5_VERSION_GE(1,10,1)
+#define NC4_PAGE_STRATEGY 1
+#endif
+#if H5_VERSION_GE(1,14,0)
+#define NC4_PAGE_BUFFER 1
+#endif
+static int nc4_layout_env_read = 0;
+static size_t nc4_meta_block_size = 0;
+static size_t nc4_page_size = 0;
+static size_t nc4_page_buffer_size = 0;
+static size_t nc4_align_threshold = 0;
+static size_t nc4_alignment = 0;
+static size_t nc4_metadata_cache_size = 0;
+
 /* For performance, fill this array only the first time, and keep it
  * in global memory for each further use. */
 #define NUM_TYPES 12
@@ -171,6 +205,238 @@ nc_get_chunk_cache(size_t *sizep, size_t *nelemsp, float *preemptionp)
    return NC_NOERR;
 }
 
+/* Set the size, in bytes, of the cache of decoded chunks that serves
+ * single values and other tiny reads of chunked vars. Zero turns the
+ * cache off. Only affects files opened/created *after* it is
+ * called. */
+int
+nc_set_point_cache(size_t size)
+{
+   nc4_point_cache_size = size;
+   return NC_NOERR;
+}
+
+/* Get the size of the cache of decoded chunks for point reads. */
+int
+nc_get_point_cache(size_t *sizep)
+{
+   if (sizep)
+      *sizep = nc4_point_cache_size;
+   return NC_NOERR;
+}
+
+/* Read a size from the environment. Leave it alone if the variable
+ * is not set, or is not a number. */
+static void
+layout_getenv(const char *name, size_t *sizep)
+{
+   const char *s = getenv(name);
+   char *end;
+   unsigned long long size;
+
+   if (!s || !*s)
+      return;
+   size = strtoull(s, &end, 10);
+   if (*end)
+      return;
+   *sizep = (size_t)size;
+}
+
+/* Read the file layout settings from the environment, the first
+ * time only. Values that could not be used are ignored. */
+static void
+layout_read_env(void)
+{
+   size_t page_size = 0, page_buffer_size = 0;
+   size_t threshold = 0, alignment = 0, size = 0;
+
+   if (nc4_layout_env_read)
+      return;
+   nc4_layout_env_read = 1;
+
+   layout_getenv(NC4_META_BLOCK_ENV, &nc4_meta_block_size);
+   layout_getenv(NC4_PAGE_SIZE_ENV, &page_size);
+   layout_getenv(NC4_PAGE_BUFFER_ENV, &page_buffer_size);
+   if (page_size || page_buffer_size)
+      if (nc_set_page_strategy(page_size, page_buffer_size))
+         nc_set_page_strategy(page_size, 0);
+   layout_getenv(NC4_ALIGNMENT_ENV, &alignment);
+   threshold = alignment;
+   layout_getenv(NC4_ALIGN_THRESHOLD_ENV, &threshold);
+   if (alignment)
+      nc_set_alignment(threshold, alignment);
+   layout_getenv(NC4_METADATA_CACHE_ENV, &size);
+   if (size)
+      nc_set_metadata_cache(size);
+}
+
+/* Set the size of the blocks that HDF5 gathers small pieces of
+ * metadata into before writing them. Only affects files
+ * opened/created *after* it is called. */
+int
+nc_set_meta_block_size(size_t size)
+{
+   layout_read_env();
+   nc4_meta_block_size = size;
+   return NC_NOERR;
+}
+
+/* Get the size of the blocks metadata is gathered into. */
+int
+nc_get_meta_block_size(size_t *sizep)
+{
+   layout_read_env();
+   if (sizep)
+      *sizep = nc4_meta_block_size;
+   return NC_NOERR;
+}
+
+/* Create files with HDF5's paged file space strategy, which keeps
+ * metadata and raw data in separate pages of page_size bytes, and
+ * buffer buffer_size bytes of pages when files of pages are opened
+ * or created. A page_size of zero creates files the usual way. The
+ * page buffer needs HDF5 1.14 or later. Only affects files
+ * opened/created *after* it is called, and is ignored for parallel
+ * I/O. */
+int
+nc_set_page_strategy(size_t page_size, size_t buffer_size)
+{
+   layout_read_env();
+   if (page_size && page_size < NC4_MIN_PAGE_SIZE)
+      return NC_EINVAL;
+   if (buffer_size && buffer_size < (page_size ? page_size : NC4_MIN_PAGE_SIZE))
+      return NC_EINVAL;
+#ifndef NC4_PAGE_STRATEGY
+   if (page_size)
+      return NC_ENOTBUILT;
+#endif
+#ifndef NC4_PAGE_BUFFER
+   if (buffer_size)
+      return NC_ENOTBUILT;
+#endif
+   nc4_page_size = page_size;
+   nc4_page_buffer_size = buffer_size;
+   return NC_NOERR;
+}
+
+/* Get the page size and page buffer size. */
+int
+nc_get_page_strategy(size_t *page_sizep, size_t *buffer_sizep)
+{
+   layout_read_env();
+   if (page_sizep)
+      *page_sizep = nc4_page_size;
+   if (buffer_sizep)
+      *buffer_sizep = nc4_page_buffer_size;
+   return NC_NOERR;
+}
+
+/* Start each object of threshold bytes or more at a multiple of
+ * alignment bytes in the file, such as the stripe size of a parallel
+ * filesystem. An alignment of zero turns this off. HDF5 aligns the
+ * objects of files of pages to their pages instead. Only affects
+ * files opened/created *after* it is called. */
+int
+nc_set_alignment(size_t threshold, size_t alignment)
+{
+   layout_read_env();
+   nc4_align_threshold = alignment ? threshold : 0;
+   nc4_alignment = alignment;
+   return NC_NOERR;
+}
+
+/* Get the alignment threshold and alignment. */
+int
+nc_get_alignment(size_t *thresholdp, size_t *alignmentp)
+{
+   layout_read_env();
+   if (thresholdp)
+      *thresholdp = nc4_align_threshold;
+   if (alignmentp)
+      *alignmentp = nc4_alignment;
+   return NC_NOERR;
+}
+
+/* Set the size, in bytes, that HDF5's metadata cache starts at and
+ * does not shrink below. Zero leaves HDF5's own sizing. Only affects
+ * files opened/created *after* it is called. */
+int
+nc_set_metadata_cache(size_t size)
+{
+   layout_read_env();
+   if (size && (size < NC4_MIN_METADATA_CACHE || size > NC4_MAX_METADATA_CACHE))
+      return NC_EINVAL;
+   nc4_metadata_cache_size = size;
+   return NC_NOERR;
+}
+
+/* Get the size of the metadata cache. */
+int
+nc_get_metadata_cache(size_t *sizep)
+{
+   layout_read_env();
+   if (sizep)
+      *sizep = nc4_metadata_cache_size;
+   return NC_NOERR;
+}
+
+/* Apply the file layout settings to the property lists of a file
+ * being opened or created; fcpl_id is -1 on open. There is no page
+ * buffering with parallel I/O. Set *page_bufferedp if a page buffer
+ * was asked for. */
+static int
+set_file_layout(hid_t fapl_id, hid_t fcpl_id, int parallel, int *page_bufferedp)
+{
+   H5AC_cache_config_t mdc;
+
+   layout_read_env();
+   *page_bufferedp = 0;
+   if (nc4_meta_block_size &&
+       H5Pset_meta_block_size(fapl_id, (hsize_t)nc4_meta_block_size) < 0)
+      return NC_EHDFERR;
+   if (nc4_alignment &&
+       H5Pset_alignment(fapl_id, (hsize_t)nc4_align_threshold,
+                        (hsize_t)nc4_alignment) < 0)
+      return NC_EHDFERR;
+   if (nc4_metadata_cache_size)
+   {
+      mdc.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+      if (H5Pget_mdc_config(fapl_id, &mdc) < 0)
+         return NC_EHDFERR;
+      mdc.set_initial_size = 1;
+      mdc.initial_size = nc4_metadata_cache_size;
+      mdc.min_size = nc4_metadata_cache_size;
+      if (mdc.max_size < nc4_metadata_cache_size)
+         mdc.max_size = nc4_metadata_cache_size;
+      if (H5Pset_mdc_config(fapl_id, &mdc) < 0)
+         return NC_EHDFERR;
+   }
+#ifdef NC4_PAGE_STRATEGY
+   if (parallel)
+      return NC_NOERR;
+   if (fcpl_id >= 0 && nc4_page_size)
+   {
+      if (H5Pset_file_space_strategy(fcpl_id, H5F_FSPACE_STRATEGY_PAGE, 1, 1) < 0)
+         return NC_EHDFERR;
+      if (H5Pset_file_space_page_size(fcpl_id, (hsize_t)nc4_page_size) < 0)
+         return NC_EHDFERR;
+   }
+#endif
+#ifdef NC4_PAGE_BUFFER
+   /* Only a file of pages can have a page buffer. */
+   if (nc4_page_buffer_size && (fcpl_id < 0 || nc4_page_size))
+   {
+      if (H5Pset_page_buffer_size(fapl_id, nc4_page_buffer_size, 0, 0) < 0)
+         return NC_EHDFERR;
+      *page_bufferedp = 1;
+   }
+#endif
+   LOG((4, "%s: meta block %ld page size %ld page buffer %ld alignment %ld",
+        __func__, nc4_meta_block_size, nc4_page_size, nc4_page_buffer_size,
+        nc4_alignment));
+   return NC_NOERR;
+}
+
 /* Required for fortran to avoid size_t issues. */
 int
 nc_set_chunk_cache_ints(int size, int nelems, int preemption)
@@ -310,6 +576,7 @@ nc4_create_file(const char *path, int cmode, MPI_Comm comm, MPI_Info info,
    unsigned flags;
    FILE *fp;
    int retval = NC_NOERR;
+   int page_buffered = 0;
    NC_HDF5_FILE_INFO_T* nc4_info = NULL;
 #ifdef USE_PARALLEL4
    int comm_duped = 0;          /* Whether the MPI Communicator was duplicated */
@@ -446,6 +713,10 @@ nc4_create_file(const char *path, int cmode, MPI_Comm comm, MPI_Info info,
 					    H5P_CRT_ORDER_INDEXED)) < 0)
       BAIL(NC_EHDFERR);
 
+   if ((retval = set_file_layout(fapl_id, fcpl_id, nc4_info->parallel,
+                                 &page_buffered)))
+      BAIL(retval);
+
    /* Create the file. */
    if ((nc4_info->hdfid = H5Fcreate(path, flags, fcpl_id, fapl_id)) < 0)
         /*Change the return error from NC_EFILEMETADATA to
@@ -467,6 +738,7 @@ nc4_create_file(const char *path, int cmode, MPI_Comm comm, MPI_Info info,
 
    /* Define mode gets turned on automatically on create. */
    nc4_info->flags |= NC_INDEF;
+   nc4_info->meta_dirty = NC_TRUE;
 
 #ifdef ENABLE_FILEINFO
    NC4_get_fileinfo(nc4_info,&globalpropinfo);
@@ -609,6 +881,8 @@ read_scale(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
       if (H5Aread(attid, H5T_NATIVE_INT, &new_dim->dimid) < 0)
          BAIL(NC_EHDFERR);
 
+      new_dim->dimid_in_file = NC_TRUE;
+
       /* Check if scale's dimid should impact the group's next dimid */
       if (new_dim->dimid >= grp->nc4_info->next_dimid)
          grp->nc4_info->next_dimid = new_dim->dimid + 1;
@@ -754,6 +1028,40 @@ dimscale_visitor(hid_t did, unsigned dim, hid_t dsid,
    return 0;
 }
 
+/* Read the object ids of the dimscales attached to a var, so that
+ * nc4_rec_match_dimscales() can find the dims of the var. If no
+ * scales are attached, the var is left without object ids. */
+int
+nc4_read_dimscale_objids(NC_VAR_INFO_T *var)
+{
+   int num_scales, d;
+
+   /* H5DSget_num_scales returns an error if there are no scales, so
+    * treat a negative return value as zero. */
+   num_scales = H5DSget_num_scales(var->hdf_datasetid, 0);
+   if (num_scales <= 0 || !var->ndims)
+      return NC_NOERR;
+
+   /* Allocate space to remember whether the dimscale has been attached
+    * for each dimension. */
+   if (!var->dimscale_attached &&
+       !(var->dimscale_attached = calloc(var->ndims, sizeof(nc_bool_t))))
+      return NC_ENOMEM;
+
+   /* Store id information allowing us to match hdf5 dimscales to
+    * netcdf dimensions. */
+   if (!(var->dimscale_hdf5_objids = malloc(var->ndims * sizeof(struct hdf5_objid))))
+      return NC_ENOMEM;
+   for (d = 0; d < var->ndims; d++)
+   {
+      if (H5DSiterate_scales(var->hdf_datasetid, d, NULL, dimscale_visitor,
+			     &(var->dimscale_hdf5_objids[d])) < 0)
+	 return NC_EHDFERR;
+      var->dimscale_attached[d] = NC_TRUE;
+   }
+   return NC_NOERR;
+}
+
 /* Given an HDF5 type, set a pointer to netcdf type. */
 static int
 get_netcdf_type(NC_HDF5_FILE_INFO_T *h5, hid_t native_typeid,
@@ -858,7 +1166,7 @@ get_netcdf_type(NC_HDF5_FILE_INFO_T *h5, hid_t native_typeid,
 
    /* Maybe we already know about this type. */
    if (!equal)
-      if((type = nc4_rec_find_hdf_type(h5->root_grp, native_typeid)))
+      if((type = nc4_find_hdf_type(h5, native_typeid)))
       {
          *xtype = type->nc_typeid;
          return NC_NOERR;
@@ -987,7 +1295,7 @@ get_type_info2(NC_HDF5_FILE_INFO_T *h5, hid_t datasetid,
       NC_TYPE_INFO_T *type;
 
       /* This is a user-defined type. */
-      if((type = nc4_rec_find_hdf_type(h5->root_grp, native_typeid)))
+      if((type = nc4_find_hdf_type(h5, native_typeid)))
 	 *type_info = type;
 
       /* The type entry in the array of user-defined types already has
@@ -1203,8 +1511,8 @@ read_hdf5_att(NC_GRP_INFO_T *grp, hid_t attid, NC_ATT_INFO_T *att)
 
 /* Read information about a user defined type from the HDF5 file, and
  * stash it in the group's list of types. */
-static int
-read_type(NC_GRP_INFO_T *grp, hid_t hdf_typeid, char *type_name)
+int
+nc4_read_type(NC_GRP_INFO_T *grp, hid_t hdf_typeid, char *type_name)
 {
    NC_TYPE_INFO_T *type;
    H5T_class_t class;
@@ -1633,6 +1941,7 @@ read_var(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
       BAIL(NC_EHDFERR);
    for (f = 0; f < num_filters; f++)
    {
+      cd_nelems = CD_NELEMS_SZIP;
       if ((filter = H5Pget_filter2(propid, f, NULL, &cd_nelems,
                                    cd_values, 0, NULL, NULL)) < 0)
          BAIL(NC_EHDFERR);
@@ -1662,7 +1971,22 @@ read_var(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
             break;
 
          default:
-            LOG((1, "Yikes! Unknown filter type found on dataset!"));
+            /* Any other filter is the one of nc_def_var_filter(). */
+            if (var->filterid)
+            {
+               LOG((1, "Yikes! More than one other filter found on dataset!"));
+               break;
+            }
+            var->filterid = (unsigned int)filter;
+            var->nparams = cd_nelems;
+            if (cd_nelems)
+            {
+               if (!(var->params = malloc(cd_nelems * sizeof(unsigned int))))
+                  BAIL(NC_ENOMEM);
+               if (H5Pget_filter2(propid, f, NULL, &cd_nelems, var->params,
+                                  0, NULL, NULL) < 0)
+                  BAIL(NC_EHDFERR);
+            }
             break;
       }
    }
@@ -1731,39 +2055,29 @@ read_var(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
       }
       dim->coord_var = var;
    }
-   /* If this is not a scale, but has scales, iterate
-    * through them. (i.e. this is a variable that is not a
-    * coordinate variable) */
-   else
+   /* If this is not a scale, but has scales, find out which. (i.e.
+    * this is a variable that is not a coordinate variable) */
+   else if (ndims)
    {
-      int num_scales = 0;
-
-      /* Find out how many scales are attached to this
-       * dataset. H5DSget_num_scales returns an error if there are no
-       * scales, so convert a negative return value to zero. */
-      num_scales = H5DSget_num_scales(datasetid, 0);
-      if (num_scales < 0)
-         num_scales = 0;
-
-      if (num_scales && ndims)
+      htri_t coords_exist;
+
+      /* This library records the dimids of each var in the
+       * coordinates attribute. They are checked against the dims
+       * once all of them are read, in nc4_rec_match_dimscales(), so
+       * the dimscales attached to the var need not be iterated
+       * through. */
+      if ((coords_exist = H5Aexists(datasetid, COORDINATES)) < 0)
+	 BAIL(NC_EHDFERR);
+      if (coords_exist && !read_coord_dimids(grp, var))
       {
-         /* Allocate space to remember whether the dimscale has been attached
-          * for each dimension. */
-         if (NULL == (var->dimscale_attached = calloc(ndims, sizeof(nc_bool_t))))
-            BAIL(NC_ENOMEM);
-
-         /* Store id information allowing us to match hdf5
-          * dimscales to netcdf dimensions. */
-         if (NULL == (var->dimscale_hdf5_objids = malloc(ndims * sizeof(struct hdf5_objid))))
-            BAIL(NC_ENOMEM);
-         for (d = 0; d < var->ndims; d++)
-         {
-            if (H5DSiterate_scales(var->hdf_datasetid, d, NULL, dimscale_visitor,
-                                   &(var->dimscale_hdf5_objids[d])) < 0)
-               BAIL(NC_EHDFERR);
-            var->dimscale_attached[d] = NC_TRUE;
-         }
+	 if (!(var->dimscale_attached = calloc(ndims, sizeof(nc_bool_t))))
+	    BAIL(NC_ENOMEM);
+	 for (d = 0; d < var->ndims; d++)
+	    var->dimscale_attached[d] = NC_TRUE;
+	 var->coords_read = NC_TRUE;
       }
+      else if ((retval = nc4_read_dimscale_objids(var)))
+	 BAIL(retval);
    }
 
    /* Now read all the attributes of this variable, ignoring the
@@ -1814,6 +2128,17 @@ read_var(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
          }
 
 	 att->created = NC_TRUE;
+
+	 /* Quantization stays in force for writes after a reopen. */
+	 if (att->nc_typeid == NC_INT && att->len == 1 && att->data)
+	 {
+	    if (!strcmp(att->name, NC_QUANTIZE_BITGROOM_ATT_NAME))
+	       var->quantize_mode = NC_QUANTIZE_BITGROOM;
+	    else if (!strcmp(att->name, NC_QUANTIZE_BITROUND_ATT_NAME))
+	       var->quantize_mode = NC_QUANTIZE_BITROUND;
+	    if (var->quantize_mode)
+	       var->nsd = *(int *)att->data;
+	 }
       } /* endif not HDF5 att */
    } /* next attribute */
 
@@ -1822,6 +2147,16 @@ read_var(NC_GRP_INFO_T *grp, hid_t datasetid, const char *obj_name,
    if ((retval = nc4_adjust_var_cache(grp, var)))
       BAIL(retval);
 
+   /* Charge the chunk cache to the memory budget, and reopen the
+    * dataset with a smaller cache if the budget is short. */
+   if (!var->contiguous)
+   {
+      nc4_charge_chunk_cache(var);
+      if (var->chunk_cache_charged < var->chunk_cache_size)
+	 if ((retval = nc4_reopen_dataset(grp, var)))
+	    BAIL(retval);
+   }
+
 exit:
    if (retval)
    {
@@ -2046,6 +2381,16 @@ nc4_rec_read_metadata_cb(hid_t grpid, const char *name, const H5L_info_t *info,
       case H5G_DATASET:
          LOG((3, "found dataset %s", oinfo.oname));
 
+         /* The metadata index is not a var. A file that has one keeps
+          * it up to date when it is written. */
+         if (!udata->grp->parent && !strcmp(oinfo.oname, NC_METADATA_INDEX_NAME))
+         {
+            udata->grp->nc4_info->md_index = NC_TRUE;
+            if (H5Oclose(oinfo.oid) < 0)
+               BAIL(H5_ITER_ERROR);
+            break;
+         }
+
          /* Learn all about this dataset, which may be a dimscale
           * (i.e. dimension metadata), or real data. */
          if ((retval = read_dataset(udata->grp, oinfo.oid, oinfo.oname, &oinfo.statbuf)))
@@ -2070,7 +2415,7 @@ nc4_rec_read_metadata_cb(hid_t grpid, const char *name, const H5L_info_t *info,
          LOG((3, "found datatype %s", oinfo.oname));
 
          /* Process the named datatype */
-         if (read_type(udata->grp, oinfo.oid, oinfo.oname))
+         if (nc4_read_type(udata->grp, oinfo.oid, oinfo.oname))
             BAIL(H5_ITER_ERROR);
 
          /* Close the object */
@@ -2227,7 +2572,9 @@ nc4_open_file(const char *path, int mode, void* parameters, NC *nc)
       H5F_ACC_RDWR : H5F_ACC_RDONLY;
    int retval;
    NC_HDF5_FILE_INFO_T* nc4_info = NULL;
+   nc_bool_t indexed = NC_FALSE;
    int inmemory = ((mode & NC_INMEMORY) == NC_INMEMORY);
+   int page_buffered = 0;
 #ifdef USE_DISKLESS
    NC_MEM_INFO* meminfo = (NC_MEM_INFO*)parameters;
 #endif
@@ -2315,6 +2662,10 @@ nc4_open_file(const char *path, int mode, void* parameters, NC *nc)
 	__func__, nc4_chunk_cache_size, nc4_chunk_cache_nelems, nc4_chunk_cache_preemption));
 #endif /* USE_PARALLEL4 */
 
+   if ((retval = set_file_layout(fapl_id, -1, nc4_info->parallel,
+                                 &page_buffered)))
+      BAIL(retval);
+
    /* The NetCDF-3.x prototype contains an mode option NC_SHARE for
       multiple processes accessing the dataset concurrently.  As there
       is no HDF5 equivalent, NC_SHARE is treated as NC_NOWRITE. */
@@ -2324,24 +2675,43 @@ nc4_open_file(const char *path, int mode, void* parameters, NC *nc)
 			)) < 0)
            BAIL(NC_EHDFERR);
        nc4_info->no_write = NC_TRUE;
-   } else if ((nc4_info->hdfid = H5Fopen(path, flags, fapl_id)) < 0)
-      BAIL(NC_EHDFERR);
+   } else if ((nc4_info->hdfid = H5Fopen(path, flags, fapl_id)) < 0) {
+      /* HDF5 will not open a file that is not of pages with a page
+       * buffer, so try again without one. */
+      if (!page_buffered || H5Pset_page_buffer_size(fapl_id, 0, 0, 0) < 0 ||
+          (nc4_info->hdfid = H5Fopen(path, flags, fapl_id)) < 0)
+         BAIL(NC_EHDFERR);
+   }
 
    /* Does the mode specify that this file is read-only? */
    if ((mode & NC_WRITE) == 0)
       nc4_info->no_write = NC_TRUE;
 
-   /* Now read in all the metadata. Some types and dimscale
-    * information may be difficult to resolve here, if, for example, a
-    * dataset of user-defined type is encountered before the
-    * definition of that type. */
-   if ((retval = nc4_rec_read_metadata(nc4_info->root_grp)))
-      BAIL(retval);
+   /* A file opened read-only may have its metadata in an index,
+    * which is read instead of the objects in the file. */
+   if (nc4_info->no_write && !nc4_info->parallel)
+      if ((retval = nc4_read_metadata_index(nc4_info, &indexed)))
+	 BAIL(retval);
 
-   /* Now figure out which netCDF dims are indicated by the dimscale
-    * information. */
-   if ((retval = nc4_rec_match_dimscales(nc4_info->root_grp)))
-      BAIL(retval);
+   if (!indexed)
+   {
+      /* Now read in all the metadata. Some types and dimscale
+       * information may be difficult to resolve here, if, for example, a
+       * dataset of user-defined type is encountered before the
+       * definition of that type. */
+      if ((retval = nc4_rec_read_metadata(nc4_info->root_grp)))
+	 BAIL(retval);
+
+      /* Now figure out which netCDF dims are indicated by the dimscale
+       * information. */
+      if ((retval = nc4_rec_match_dimscales(nc4_info->root_grp)))
+	 BAIL(retval);
+   }
+
+   /* An index found in a file opened for writing may be out of date,
+    * so it is rewritten on the first sync. */
+   if (nc4_info->md_index && !nc4_info->no_write)
+      nc4_info->meta_dirty = NC_TRUE;
 
 #ifdef LOGGING
    /* This will print out the names, types, lens, etc of the vars and
@@ -2910,6 +3280,91 @@ NC4_set_fill(int ncid, int fillmode, int *old_modep)
    return NC_NOERR;
 }
 
+/* Choose how writes past the end of an unlimited dimension extend
+   the datasets. In geometric mode they are over-allocated, and
+   trimmed back by nc4_rec_trim_extents() on sync and close. */
+int
+NC4_set_append_mode(int ncid, int mode, int *old_modep)
+{
+   NC_HDF5_FILE_INFO_T* nc4_info;
+
+   LOG((2, "%s: ncid 0x%x mode %d", __func__, ncid, mode));
+
+   if (!nc4_find_nc_file(ncid,&nc4_info))
+      return NC_EBADID;
+   assert(nc4_info);
+
+   if (nc4_info->no_write)
+      return NC_EPERM;
+
+   if (mode != NC_APPEND_EXACT && mode != NC_APPEND_GEOMETRIC)
+      return NC_EINVAL;
+
+   /* Every process would have to agree on the over-allocated extent,
+    * which costs the collective call this mode is meant to save. */
+   if (nc4_info->parallel && mode != NC_APPEND_EXACT)
+      return NC_EINVAL;
+
+   if (old_modep)
+      *old_modep = nc4_info->append_mode;
+
+   nc4_info->append_mode = mode;
+
+   return NC_NOERR;
+}
+
+/* Choose whether the metadata index of the file is written when it
+   is synced or closed, for later read-only opens to build their
+   metadata from. */
+int
+NC4_set_metadata_index(int ncid, int flag, int *old_flagp)
+{
+   NC_HDF5_FILE_INFO_T* nc4_info;
+
+   LOG((2, "%s: ncid 0x%x flag %d", __func__, ncid, flag));
+
+   if (!nc4_find_nc_file(ncid,&nc4_info))
+      return NC_EBADID;
+   assert(nc4_info);
+
+   if (nc4_info->no_write)
+      return NC_EPERM;
+
+   /* The index would have to be written collectively, and is never
+    * read by a parallel open. */
+   if (nc4_info->parallel)
+      return NC_EINVAL;
+
+   if (old_flagp)
+      *old_flagp = nc4_info->md_index;
+
+   nc4_info->md_index = flag ? NC_TRUE : NC_FALSE;
+   nc4_info->meta_dirty = NC_TRUE;
+
+   return NC_NOERR;
+}
+
+/* Learn whether the metadata index of the file is written, and
+   whether the metadata was read from it when the file was opened. */
+int
+NC4_inq_metadata_index(int ncid, int *flagp, int *openedp)
+{
+   NC_HDF5_FILE_INFO_T* nc4_info;
+
+   LOG((2, "%s: ncid 0x%x", __func__, ncid));
+
+   if (!nc4_find_nc_file(ncid,&nc4_info))
+      return NC_EBADID;
+   assert(nc4_info);
+
+   if (flagp)
+      *flagp = nc4_info->md_index;
+   if (openedp)
+      *openedp = nc4_info->md_index_read;
+
+   return NC_NOERR;
+}
+
 /* Put the file back in redef mode. This is done automatically for
  * netcdf-4 files, if the user forgets. */
 int
@@ -2932,8 +3387,9 @@ NC4_redef(int ncid)
    if (nc4_info->no_write)
       return NC_EPERM;
 
-   /* Set define mode. */
+   /* Set define mode. Anything may change, until the next sync. */
    nc4_info->flags |= NC_INDEF;
+   nc4_info->meta_dirty = NC_TRUE;
 
    /* For nc_abort, we need to remember if we're in define mode as a
       redef. */
@@ -2971,7 +3427,9 @@ static int NC4_enddef(int ncid)
 }
 
 /* This function will write all changed metadata, and (someday) reread
- * all metadata from the file. */
+ * all metadata from the file. If no metadata has changed since the
+ * last sync, as after writing only data, none is written, and the
+ * group tree is not walked. */
 static int
 sync_netcdf4_file(NC_HDF5_FILE_INFO_T *h5)
 {
@@ -3000,8 +3458,18 @@ sync_netcdf4_file(NC_HDF5_FILE_INFO_T *h5)
    log_metadata_nc(h5->root_grp->nc4_info->controller);
 #endif
 
-   /* Write any metadata that has changed. */
-   if (!(h5->cmode & NC_NOWRITE))
+   /* Trim datasets over-allocated by appends back to the length
+    * written, so that the file holds no records that were never
+    * written for other programs to see. */
+   if (!(h5->cmode & NC_NOWRITE) && !h5->no_write)
+      if ((retval = nc4_rec_trim_extents(h5->root_grp)))
+	 return retval;
+
+   /* Write any metadata that has changed. In parallel, the data
+    * written, and so what changed, differs from process to process,
+    * but the metadata must be written collectively, so it is always
+    * written. */
+   if (!(h5->cmode & NC_NOWRITE) && (h5->meta_dirty || h5->parallel))
    {
       nc_bool_t bad_coord_order = NC_FALSE;	/* if detected, propagate to all groups to consistently store dimids */
 
@@ -3009,10 +3477,24 @@ sync_netcdf4_file(NC_HDF5_FILE_INFO_T *h5)
 	 return retval;
       if ((retval = nc4_rec_detect_need_to_preserve_dimids(h5->root_grp, &bad_coord_order)))
 	 return retval;
+
+      /* Once the dimids of the dimscales already in the file have been
+       * written, only new dimscales need theirs, and those always get
+       * them. */
+      if (h5->dimids_preserved)
+	 bad_coord_order = NC_FALSE;
       if ((retval = nc4_rec_write_metadata(h5->root_grp, bad_coord_order)))
 	 return retval;
+      if (bad_coord_order)
+	 h5->dimids_preserved = NC_TRUE;
    }
 
+   /* The index goes last, to take in everything written above. */
+   if (!(h5->cmode & NC_NOWRITE) && !h5->no_write && !h5->parallel)
+      if ((retval = nc4_write_metadata_index(h5)))
+	 return retval;
+   h5->meta_dirty = NC_FALSE;
+
    if (H5Fflush(h5->hdfid, H5F_SCOPE_GLOBAL) < 0)
       return NC_EHDFERR;
 
@@ -3067,6 +3549,11 @@ close_netcdf4_file(NC_HDF5_FILE_INFO_T *h5, int abort)
       if ((retval = sync_netcdf4_file(h5)))
 	goto exit;
 
+   /* Even when aborting, don't leave datasets over-allocated. */
+   if (!h5->no_write && abort)
+      if ((retval = nc4_rec_trim_extents(h5->root_grp)))
+	goto exit;
+
    /* Delete all the list contents for vars, dims, and atts, in each
     * group. */
    if ((retval = nc4_rec_grp_del(&h5->root_grp, h5->root_grp)))
@@ -3129,7 +3616,12 @@ exit:
    /* Free the nc4_info struct; above code should have reclaimed
       everything else */
    if(h5 != NULL)
+   {
+       nc4_free_convert_buf(h5);
+       nc4_point_cache_free(h5);
+       nc4_free_indexes(h5);
        free(h5);
+   }
    return retval;
 }
 
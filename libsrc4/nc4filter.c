@@ -0,0 +1,495 @@
+/** \file \internal
+The filters built into the netCDF-4 library, for nc_def_var_filter().
+
+NC_FILTER_LZ4 compresses chunks in the LZ4 block format, which trades
+some of the compression of deflate for much faster compression and,
+above all, decompression. Chunks are stored as by the HDF5 LZ4 filter
+plugin, so that files written here can be read by other HDF5 programs
+with that plugin, and the other way round: the size of the chunk (8
+bytes, big-endian), the size of its blocks (4 bytes), then each block
+as its compressed size (4 bytes) and the compressed bytes, or the bytes
+as they are if they do not compress.
+
+The first param of the filter is the block size; the second is the
+level. Level 0 uses a single hash lookup to find each match, as LZ4
+does by default; the higher levels search chains of earlier positions
+with the same hash for the longest match, as LZ4 HC does, for smaller
+output. All levels decompress at the same speed.
+
+Copyright 2016, University Corporation for Atmospheric
+Research. See the COPYRIGHT file for copying and redistribution
+conditions.
+*/
+#include "config.h"
+#include "nc4internal.h"
+
+#define LZ4_MINMATCH 4          /* Shortest match */
+#define LZ4_LASTLITERALS 5      /* The last bytes of a block are literals */
+#define LZ4_MFLIMIT 12          /* No match starts this close to the end */
+#define LZ4_MAX_DISTANCE 65535  /* Furthest back a match can be */
+#define LZ4_MAX_INPUT 0x7E000000 /* Largest block */
+#define LZ4_NICE_LEN 256        /* Long enough a match to stop searching */
+#define LZ4_MAX_HASH_LOG 16
+#define LZ4_MIN_HASH_LOG 10
+#define LZ4_HEADER 12           /* Chunk size and block size */
+#define LZ4_DEFAULT_BLOCK (1U << 30)
+
+static uint32_t
+lz4_read32(const unsigned char *p)
+{
+   uint32_t v;
+
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static uint32_t
+lz4_hash(const unsigned char *p, int hash_log)
+{
+   return (lz4_read32(p) * 2654435761U) >> (32 - hash_log);
+}
+
+/* Length of the common prefix of p and match, up to limit. */
+static size_t
+lz4_count(const unsigned char *p, const unsigned char *match,
+          const unsigned char *limit)
+{
+   const unsigned char *start = p;
+
+   while (p + 4 <= limit && lz4_read32(p) == lz4_read32(match))
+   {
+      p += 4;
+      match += 4;
+   }
+   while (p < limit && *p == *match)
+   {
+      p++;
+      match++;
+   }
+   return (size_t)(p - start);
+}
+
+/* Write a length that does not fit in its 4 bits of the token. */
+static unsigned char *
+lz4_put_length(unsigned char *op, size_t len)
+{
+   for (; len >= 255; len -= 255)
+      *op++ = 255;
+   *op++ = (unsigned char)len;
+   return op;
+}
+
+/* Compress n bytes of src into at most cap bytes of dst, returning the
+ * size of the output, or 0 if it does not fit. Each position is kept
+ * in a hash table of the 4 bytes at it, and, above level 0, in a chain
+ * of the earlier positions with the same hash, which are searched, up
+ * to 2^(level-1) of them, for the longest match, or one of
+ * LZ4_NICE_LEN bytes. */
+static size_t
+lz4_compress(const unsigned char *src, size_t n, unsigned char *dst,
+             size_t cap, int level)
+{
+   const unsigned char *ip = src, *anchor = src;
+   const unsigned char *const end = src + n;
+   const unsigned char *const mflimit = n > LZ4_MFLIMIT ? end - LZ4_MFLIMIT : src;
+   const unsigned char *const matchlimit = n > LZ4_MFLIMIT ? end - LZ4_LASTLITERALS : src;
+   unsigned char *op = dst, *const oend = dst + cap;
+   uint32_t *head;
+   uint16_t *chain = NULL;
+   size_t chain_mask = 0, lit, misses = 0;
+   int hash_log = LZ4_MIN_HASH_LOG;
+   int depth = level > 0 ? 1 << (level - 1) : 1;
+
+   if (n > LZ4_MAX_INPUT)
+      return 0;
+
+   /* Small blocks get small tables, which are quicker to clear. */
+   while (hash_log < LZ4_MAX_HASH_LOG && ((size_t)1 << hash_log) < n)
+      hash_log++;
+   if (!(head = calloc((size_t)1 << hash_log, sizeof(uint32_t))))
+      return 0;
+   if (level > 0)
+   {
+      chain_mask = (size_t)1 << hash_log;
+      if (chain_mask < LZ4_MAX_DISTANCE + 1 && chain_mask < n)
+         chain_mask = LZ4_MAX_DISTANCE + 1;
+      if (!(chain = malloc(chain_mask * sizeof(uint16_t))))
+      {
+         free(head);
+         return 0;
+      }
+      chain_mask--;
+   }
+
+   /* Positions are kept plus one, so that 0 is none. */
+   while (ip < mflimit)
+   {
+      const unsigned char *match = NULL, *cand, *searched = ip;
+      size_t pos = (size_t)(ip - src), len = 0, cand_len;
+      uint32_t h = lz4_hash(ip, hash_log), next = head[h];
+      int tries;
+
+      /* Find the longest match. */
+      for (tries = depth; next && tries; tries--)
+      {
+         size_t cpos = next - 1, delta;
+
+         if (pos - cpos > LZ4_MAX_DISTANCE)
+            break;
+         cand = src + cpos;
+         if (lz4_read32(cand) == lz4_read32(ip))
+         {
+            cand_len = LZ4_MINMATCH + lz4_count(ip + LZ4_MINMATCH,
+                                                cand + LZ4_MINMATCH,
+                                                matchlimit);
+            if (cand_len > len)
+            {
+               len = cand_len;
+               match = cand;
+
+               /* A longer match would gain little. */
+               if (len >= LZ4_NICE_LEN)
+                  break;
+            }
+         }
+         if (!chain || !(delta = chain[cpos & chain_mask]) || delta > cpos)
+            break;
+         next = (uint32_t)(cpos - delta + 1);
+      }
+      if (chain)
+      {
+         size_t delta = head[h] ? pos - (head[h] - 1) : 0;
+
+         chain[pos & chain_mask] =
+            (uint16_t)(delta > LZ4_MAX_DISTANCE ? 0 : delta);
+      }
+      head[h] = (uint32_t)(pos + 1);
+
+      if (!match)
+      {
+         /* Skip faster through data that does not compress. */
+         ip += 1 + (level > 0 ? 0 : (misses++ >> 6));
+         continue;
+      }
+      misses = 0;
+
+      /* Take in any matching bytes before ip. */
+      while (ip > anchor && match > src && ip[-1] == match[-1])
+      {
+         ip--;
+         match--;
+         len++;
+      }
+
+      /* Write the literals since the last match, then the match. */
+      lit = (size_t)(ip - anchor);
+      if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit + 2 +
+          (len - LZ4_MINMATCH) / 255 + 1 + LZ4_LASTLITERALS + 1)
+      {
+         free(head);
+         free(chain);
+         return 0;
+      }
+      {
+         unsigned char *token = op++;
+         size_t off = (size_t)(ip - match), ml = len - LZ4_MINMATCH;
+
+         if (lit >= 15)
+         {
+            *token = 15 << 4;
+            op = lz4_put_length(op, lit - 15);
+         }
+         else
+            *token = (unsigned char)(lit << 4);
+         memcpy(op, anchor, lit);
+         op += lit;
+         *op++ = (unsigned char)(off & 0xff);
+         *op++ = (unsigned char)(off >> 8);
+         if (ml >= 15)
+         {
+            *token |= 15;
+            op = lz4_put_length(op, ml - 15);
+         }
+         else
+            *token |= (unsigned char)ml;
+      }
+
+      /* The higher levels also keep the positions inside the match
+       * that have not been searched from. */
+      ip += len;
+      anchor = ip;
+      if (chain)
+      {
+         const unsigned char *p;
+
+         for (p = searched + 1; p < ip && p < mflimit; p++)
+         {
+            size_t ppos = (size_t)(p - src), delta;
+            uint32_t ph = lz4_hash(p, hash_log);
+
+            delta = head[ph] ? ppos - (head[ph] - 1) : 0;
+            chain[ppos & chain_mask] =
+               (uint16_t)(delta > LZ4_MAX_DISTANCE ? 0 : delta);
+            head[ph] = (uint32_t)(ppos + 1);
+         }
+      }
+   }
+   free(head);
+   free(chain);
+
+   /* The rest is literals. */
+   lit = (size_t)(end - anchor);
+   if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit)
+      return 0;
+   if (lit >= 15)
+   {
+      *op++ = 15 << 4;
+      op = lz4_put_length(op, lit - 15);
+   }
+   else
+      *op++ = (unsigned char)(lit << 4);
+   memcpy(op, anchor, lit);
+   op += lit;
+   return (size_t)(op - dst);
+}
+
+/* Copy len bytes in steps of size bytes, which may copy up to size - 1
+ * bytes past the end; size bytes must be readable and writable
+ * there. Steps of a fixed size compile to a few moves, where memcpy()
+ * of a short variable length is a call. A step may read bytes an
+ * earlier step wrote, so dst may be size or more bytes past src. */
+static void
+lz4_wild_copy(unsigned char *dst, const unsigned char *src, size_t len,
+              size_t size)
+{
+   unsigned char *const end = dst + len;
+
+   if (size == 16)
+      do
+      {
+         memcpy(dst, src, 16);
+         dst += 16;
+         src += 16;
+      } while (dst < end);
+   else
+      do
+      {
+         memcpy(dst, src, 8);
+         dst += 8;
+         src += 8;
+      } while (dst < end);
+}
+
+/* Decompress n bytes of src, which must fill exactly dlen bytes of
+ * dst. Returns non-zero for bad data. */
+static int
+lz4_decompress(const unsigned char *src, size_t n, unsigned char *dst,
+               size_t dlen)
+{
+   const unsigned char *ip = src, *const iend = src + n;
+   unsigned char *op = dst, *const oend = dst + dlen;
+
+   for (;;)
+   {
+      size_t len, off;
+      unsigned token, s;
+      const unsigned char *match;
+
+      if (ip >= iend)
+         return 1;
+      token = *ip++;
+
+      /* Literals. */
+      len = token >> 4;
+      if (len == 15)
+         do
+         {
+            if (ip >= iend)
+               return 1;
+            s = *ip++;
+            len += s;
+         } while (s == 255);
+      if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+         return 1;
+      if ((size_t)(iend - ip) >= len + 16 && (size_t)(oend - op) >= len + 16)
+         lz4_wild_copy(op, ip, len, 16);
+      else
+         memcpy(op, ip, len);
+      op += len;
+      ip += len;
+      if (ip == iend)
+         break;
+
+      /* Match. */
+      if (iend - ip < 2)
+         return 1;
+      off = (size_t)ip[0] | (size_t)ip[1] << 8;
+      ip += 2;
+      if (!off || off > (size_t)(op - dst))
+         return 1;
+      len = token & 15;
+      if (len == 15)
+         do
+         {
+            if (ip >= iend)
+               return 1;
+            s = *ip++;
+            len += s;
+         } while (s == 255);
+      len += LZ4_MINMATCH;
+      if (len > (size_t)(oend - op))
+         return 1;
+      match = op - off;
+      if (off >= 8 && (size_t)(oend - op) >= len + 16)
+         lz4_wild_copy(op, match, len, off >= 16 ? 16 : 8);
+      else if (off >= len)
+         memcpy(op, match, len);
+      else
+      {
+         /* The match overlaps what it writes, repeating its first off
+          * bytes. What is written so far repeats them too, so it can
+          * be copied as a whole, doubling each time. */
+         unsigned char *p = op, *const mend = op + len;
+         size_t step;
+
+         while (p < mend)
+         {
+            step = (size_t)(p - match);
+            if (step > (size_t)(mend - p))
+               step = (size_t)(mend - p);
+            memcpy(p, match, step);
+            p += step;
+         }
+      }
+      op += len;
+   }
+   return op != oend;
+}
+
+static void
+lz4_put_be(unsigned char *p, unsigned long long v, int nbytes)
+{
+   int i;
+
+   for (i = nbytes - 1; i >= 0; i--, v >>= 8)
+      p[i] = (unsigned char)(v & 0xff);
+}
+
+static unsigned long long
+lz4_get_be(const unsigned char *p, int nbytes)
+{
+   unsigned long long v = 0;
+   int i;
+
+   for (i = 0; i < nbytes; i++)
+      v = v << 8 | p[i];
+   return v;
+}
+
+/* The HDF5 filter function of NC_FILTER_LZ4. Returns the size of the
+ * output, which replaces *buf, or 0 on failure. */
+static size_t
+nc4_filter_lz4(unsigned int flags, size_t cd_nelmts,
+               const unsigned int cd_values[], size_t nbytes,
+               size_t *buf_size, void **buf)
+{
+   const unsigned char *in = *buf, *ip;
+   unsigned char *out, *op;
+   size_t block, done, bsize, csize;
+
+   if (flags & H5Z_FLAG_REVERSE)
+   {
+      unsigned long long total;
+
+      if (nbytes < LZ4_HEADER)
+         return 0;
+      total = lz4_get_be(in, 8);
+      block = (size_t)lz4_get_be(in + 8, 4);
+      if (total > ((size_t)-1) >> 1 || (!block && total))
+         return 0;
+      if (!(out = malloc(total ? (size_t)total : 1)))
+         return 0;
+      ip = in + LZ4_HEADER;
+      for (done = 0; done < total; done += bsize)
+      {
+         bsize = total - done < block ? (size_t)(total - done) : block;
+         if (in + nbytes - ip < 4)
+            break;
+         csize = (size_t)lz4_get_be(ip, 4);
+         ip += 4;
+         if (csize > (size_t)(in + nbytes - ip))
+            break;
+         if (csize == bsize)
+            memcpy(out + done, ip, bsize);
+         else if (lz4_decompress(ip, csize, out + done, bsize))
+            break;
+         ip += csize;
+      }
+      if (done < total)
+      {
+         free(out);
+         return 0;
+      }
+      free(*buf);
+      *buf = out;
+      *buf_size = total ? (size_t)total : 1;
+      return (size_t)total;
+   }
+   else
+   {
+      size_t nblocks, cap;
+      int level = cd_nelmts > 1 ? (int)cd_values[1] : 0;
+
+      block = cd_nelmts > 0 && cd_values[0] ? cd_values[0] : LZ4_DEFAULT_BLOCK;
+      if (block > nbytes)
+         block = nbytes;
+      if (block > LZ4_MAX_INPUT)
+         block = LZ4_MAX_INPUT;
+      if (level > NC_FILTER_LZ4_MAX_LEVEL)
+         level = NC_FILTER_LZ4_MAX_LEVEL;
+      nblocks = block ? (nbytes + block - 1) / block : 0;
+
+      /* Blocks that do not compress are stored as they are. */
+      cap = LZ4_HEADER + 4 * nblocks + nbytes;
+      if (!(out = malloc(cap)))
+         return 0;
+      lz4_put_be(out, nbytes, 8);
+      lz4_put_be(out + 8, block, 4);
+      op = out + LZ4_HEADER;
+      for (done = 0; done < nbytes; done += bsize)
+      {
+         bsize = nbytes - done < block ? nbytes - done : block;
+         csize = bsize > 1 ? lz4_compress(in + done, bsize, op + 4,
+                                          bsize - 1, level) : 0;
+         if (!csize)
+         {
+            memcpy(op + 4, in + done, bsize);
+            csize = bsize;
+         }
+         lz4_put_be(op, csize, 4);
+         op += 4 + csize;
+      }
+      free(*buf);
+      *buf = out;
+      *buf_size = cap;
+      return (size_t)(op - out);
+   }
+}
+
+static const H5Z_class2_t nc4_lz4_class = {
+   H5Z_CLASS_T_VERS,
+   (H5Z_filter_t)NC_FILTER_LZ4,
+   1, 1,
+   "lz4",
+   NULL, NULL,
+   (H5Z_func_t)nc4_filter_lz4
+};
+
+/* Register the filters built into the library with HDF5. */
+int
+nc4_filter_initialize(void)
+{
+   if (H5Zregister(&nc4_lz4_class) < 0)
+      return NC_EHDFERR;
+   return NC_NOERR;
+}
@@ -98,6 +98,9 @@ NC4_rename_grp(int grpid, const char *name)
       if ((retval = NC4_redef(grpid)))
 	 return retval;
 
+   /* The new name is in the metadata written on the next sync. */
+   h5->meta_dirty = NC_TRUE;
+
    /* Rename the group, if it exists in the file */
    if (grp->hdf_grpid)
    {
@@ -120,7 +123,9 @@ NC4_rename_grp(int grpid, const char *name)
    }
 
    /* Give the group its new name in metadata. UTF8 normalization
-    * has been done. */
+    * has been done. The full names of this group and those below it
+    * change, so the table of groups by full name is dropped. */
+   nc4_grp_paths_free(h5);
    free(grp->name);
    if (!(grp->name = malloc((strlen(norm_name) + 1) * sizeof(char))))
       return NC_ENOMEM;
@@ -324,14 +329,18 @@ NC4_inq_grp_parent(int ncid, int *parent_ncid)
    return NC_NOERR;
 }
 
-/* Given a full name and ncid, find group ncid. */
+/* Given a full name and ncid, find group ncid. The name is looked
+ * up below the group of ncid, in the file's table of groups by full
+ * name, so the cost does not grow with the number of groups. */
 int
 NC4_inq_grp_full_ncid(int ncid, const char *full_name, int *grp_ncid)
 {
-   NC_GRP_INFO_T *grp;
+   NC_GRP_INFO_T *grp, *g;
    NC_HDF5_FILE_INFO_T *h5;
-   int id1 = ncid, id2;
-   char *cp, *full_name_cpy;
+   char *cp, *full_name_cpy, *key = NULL, *new_key;
+   char norm_name[NC_MAX_NAME + 1];
+   size_t len;
+   int nparts = 0;
    int ret;
 
    if (!full_name)
@@ -341,46 +350,58 @@ NC4_inq_grp_full_ncid(int ncid, const char *full_name, int *grp_ncid)
    if ((ret = nc4_find_grp_h5(ncid, &grp, &h5)))
       return ret;
 
+   /* Groups only work with netCDF-4/HDF5 files... */
+   if (!h5)
+      return NC_ENOTNC4;
+
    /* Copy full_name because strtok messes with the value it works
     * with, and we don't want to mess up full_name. */
    if (!(full_name_cpy = malloc(strlen(full_name) + 1)))
       return NC_ENOMEM;
    strcpy(full_name_cpy, full_name);
 
-   /* Get the first part of the name. */
-   if (!(cp = strtok(full_name_cpy, "/")))
+   /* Start with the full name of this group, and add each normalized
+    * part of the name to it. */
+   if ((ret = nc4_grp_full_name(grp, &key)))
+      goto exit;
+   for (cp = strtok(full_name_cpy, "/"); cp; cp = strtok(NULL, "/"))
    {
-      /* If "/" is passed, and this is the root group, return the root
-       * group id. */
-      if (!grp->parent)
-	 id2 = ncid;
-      else
+      if ((ret = nc4_normalize_name(cp, norm_name)))
+	 goto exit;
+      len = strlen(key);
+      if (!(new_key = realloc(key, len + strlen(norm_name) + 2)))
       {
-	 free(full_name_cpy);
-	 return NC_ENOGRP;
+	 ret = NC_ENOMEM;
+	 goto exit;
       }
+      key = new_key;
+      if (key[len - 1] != '/')
+	 key[len++] = '/';
+      strcpy(key + len, norm_name);
+      nparts++;
    }
-   else
+
+   /* If "/" is passed, it must be the root group. */
+   if (!nparts)
    {
-      /* Keep parsing the string. */
-      for (; cp; id1 = id2)
-      {
-	 if ((ret = NC4_inq_ncid(id1, cp, &id2)))
-	 {
-	    free(full_name_cpy);
-	    return ret;
-	 }
-	 cp = strtok(NULL, "/");
-      }
+      if (grp->parent)
+	 ret = NC_ENOGRP;
+      else if (grp_ncid)
+	 *grp_ncid = ncid;
+      goto exit;
    }
 
+   if ((ret = nc4_find_grp_full_name(h5, key, &g)))
+      goto exit;
+
    /* Give the user the requested value. */
    if (grp_ncid)
-      *grp_ncid = id2;
+      *grp_ncid = h5->controller->ext_ncid | g->nc_grpid;
 
+exit:
+   free(key);
    free(full_name_cpy);
-
-   return NC_NOERR;
+   return ret;
 }
 
 /* Get a list of ids for all the variables in a group. */
@@ -129,10 +129,8 @@ nc4_open_var_grp2(NC_GRP_INFO_T *grp, int varid, hid_t *dataset)
     return NC_ENOTVAR;
 
   /* Open this dataset if necessary. */
-  if (!var->hdf_datasetid)
-    if ((var->hdf_datasetid = H5Dopen2(grp->hdf_grpid, var->name,
-                                       H5P_DEFAULT)) < 0)
-      return NC_ENOTVAR;
+  if (nc4_open_var_dataset(grp, var, var->hdf5_name ? var->hdf5_name : var->name))
+    return NC_ENOTVAR;
 
   *dataset = var->hdf_datasetid;
 
@@ -486,6 +484,106 @@ log_dim_info(NC_VAR_INFO_T *var, hsize_t *fdims, hsize_t *fmaxdims,
 }
 #endif /* LOGGING */
 
+/* Get the file dataspace of a var, keeping it for later calls. The
+ * caller may change its selection, but must not close it. */
+int
+nc4_get_file_space(NC_VAR_INFO_T *var, hid_t *spaceidp)
+{
+  if (!var->hdf_spaceid)
+    {
+      if ((var->hdf_spaceid = H5Dget_space(var->hdf_datasetid)) < 0)
+        {
+          var->hdf_spaceid = 0;
+          return NC_EHDFERR;
+        }
+#ifdef EXTRA_TESTS
+      num_spaces++;
+#endif
+    }
+  *spaceidp = var->hdf_spaceid;
+  return NC_NOERR;
+}
+
+/* Get a memory dataspace for a hyperslab of a var, or a scalar
+ * dataspace for a scalar var. The dataspace of the last read or
+ * write is reused, resized if the count differs. The caller must not
+ * close it. */
+static int
+get_mem_space(NC_VAR_INFO_T *var, const hsize_t *count, hid_t *spaceidp)
+{
+  if (!var->hdf_mem_spaceid)
+    {
+      if (var->ndims)
+        var->hdf_mem_spaceid = H5Screate_simple(var->ndims, count, NULL);
+      else
+        var->hdf_mem_spaceid = H5Screate(H5S_SCALAR);
+      if (var->hdf_mem_spaceid < 0)
+        {
+          var->hdf_mem_spaceid = 0;
+          return NC_EHDFERR;
+        }
+#ifdef EXTRA_TESTS
+      num_spaces++;
+#endif
+
+      /* Keep the shape it was made with, once it exists, so that a
+       * failure leaves nothing behind. */
+      if (var->ndims)
+        {
+          if (!(var->mem_space_dims = malloc(var->ndims * sizeof(hsize_t))))
+            {
+              nc4_release_var_spaces(var);
+              return NC_ENOMEM;
+            }
+          memcpy(var->mem_space_dims, count, var->ndims * sizeof(hsize_t));
+        }
+    }
+  else if (var->ndims &&
+           memcmp(var->mem_space_dims, count, var->ndims * sizeof(hsize_t)))
+    {
+      if (H5Sset_extent_simple(var->hdf_mem_spaceid, var->ndims, count, NULL) < 0)
+        return NC_EHDFERR;
+      memcpy(var->mem_space_dims, count, var->ndims * sizeof(hsize_t));
+    }
+  *spaceidp = var->hdf_mem_spaceid;
+  return NC_NOERR;
+}
+
+/* Forget the cached file dataspace of a var. This must be done
+ * whenever the extent of its dataset changes. */
+void
+nc4_release_file_space(NC_VAR_INFO_T *var)
+{
+  if (var->hdf_spaceid)
+    {
+      H5Sclose(var->hdf_spaceid);
+#ifdef EXTRA_TESTS
+      num_spaces--;
+#endif
+      var->hdf_spaceid = 0;
+    }
+}
+
+/* Free all the dataspaces cached for a var. */
+void
+nc4_release_var_spaces(NC_VAR_INFO_T *var)
+{
+  nc4_release_file_space(var);
+  if (var->hdf_mem_spaceid)
+    {
+      H5Sclose(var->hdf_mem_spaceid);
+#ifdef EXTRA_TESTS
+      num_spaces--;
+#endif
+      var->hdf_mem_spaceid = 0;
+    }
+  if (var->mem_space_dims)
+    {
+      free(var->mem_space_dims);
+      var->mem_space_dims = NULL;
+    }
+}
+
 #ifdef USE_PARALLEL4
 static int
 set_par_access(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var, hid_t xfer_plistid)
@@ -512,6 +610,119 @@ set_par_access(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var, hid_t xfer_plistid)
 }
 #endif
 
+#ifndef HDF5_CONVERT
+/* Read or write a hyperslab that needs type conversion in blocks of
+ * at most NC4_CONVERT_BLOCK_SIZE bytes (in the file's type), using
+ * the file's conversion buffer. Each block is a run of whole rows of
+ * the innermost dimensions that fit, so it is contiguous in the
+ * caller's buffer. Range errors are counted over all blocks. Not
+ * used for parallel files, whose ranks must agree on the number of
+ * H5Dread/H5Dwrite calls. */
+static int
+convert_in_blocks(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var,
+                  NC_PG_T pg, hid_t file_spaceid, hid_t xfer_plistid,
+                  const hsize_t *start, const hsize_t *count,
+                  nc_type mem_nc_type, int is_long, void *data,
+                  int *range_error)
+{
+  hsize_t bstart[NC_MAX_VAR_DIMS], bcount[NC_MAX_VAR_DIMS];
+  hsize_t idx[NC_MAX_VAR_DIMS];
+  hsize_t inner = 1, step, nelems;
+  size_t file_type_size = var->type_info->size, mem_type_size;
+  size_t block_elems, offset;
+  hid_t mem_spaceid = 0;
+  void *bufr;
+  int k, d, re, retval = NC_NOERR;
+
+  assert(var->ndims > 0);
+  if ((retval = nc4_get_typelen_mem(h5, mem_nc_type, is_long, &mem_type_size)))
+    return retval;
+  if ((block_elems = NC4_CONVERT_BLOCK_SIZE / file_type_size) == 0)
+    block_elems = 1;
+  if ((retval = nc4_get_convert_buf(h5, block_elems * file_type_size, &bufr)))
+    return retval;
+
+  /* Take whole innermost dimensions while they fit, then split
+   * dimension k into steps. */
+  for (k = var->ndims - 1; k > 0 && inner * count[k] <= block_elems; k--)
+    inner *= count[k];
+  step = block_elems / inner;
+  if (step > count[k])
+    step = count[k];
+
+  for (d = 0; d < var->ndims; d++)
+    {
+      idx[d] = 0;
+      bstart[d] = start[d];
+      bcount[d] = d > k ? count[d] : 1;
+    }
+
+  for (;;)
+    {
+      /* This block, and where it lives in the caller's buffer. */
+      for (offset = 0, d = 0; d <= k; d++)
+        {
+          bstart[d] = start[d] + idx[d];
+          offset = offset * count[d] + idx[d];
+        }
+      offset *= inner;
+      bcount[k] = count[k] - idx[k] < step ? count[k] - idx[k] : step;
+      nelems = bcount[k] * inner;
+
+      if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, bstart, NULL,
+                              bcount, NULL) < 0)
+        BAIL(NC_EHDFERR);
+      if ((mem_spaceid = H5Screate_simple(1, &nelems, NULL)) < 0)
+        BAIL(NC_EHDFERR);
+
+      if (pg == GET)
+        {
+          if (H5Dread(var->hdf_datasetid, var->type_info->native_hdf_typeid,
+                      mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+            BAIL(NC_EHDFERR);
+          if ((retval = nc4_convert_type(bufr, (char *)data + offset * mem_type_size,
+                                         var->type_info->nc_typeid, mem_nc_type,
+                                         nelems, &re, var->fill_value,
+                                         (h5->cmode & NC_CLASSIC_MODEL), 0, is_long)))
+            BAIL(retval);
+        }
+      else
+        {
+          if ((retval = nc4_convert_type((char *)data + offset * mem_type_size, bufr,
+                                         mem_nc_type, var->type_info->nc_typeid,
+                                         nelems, &re, var->fill_value,
+                                         (h5->cmode & NC_CLASSIC_MODEL), is_long, 0)))
+            BAIL(retval);
+          nc4_quantize_data(bufr, var->type_info->nc_typeid, nelems,
+                            var->quantize_mode, var->nsd, var->fill_value);
+          if (H5Dwrite(var->hdf_datasetid, var->type_info->hdf_typeid,
+                       mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+            BAIL(NC_EHDFERR);
+        }
+      *range_error += re;
+
+      if (H5Sclose(mem_spaceid) < 0)
+        BAIL(NC_EHDFERR);
+      mem_spaceid = 0;
+
+      /* Move on to the next block. */
+      idx[k] += bcount[k];
+      for (d = k; d > 0 && idx[d] >= count[d]; d--)
+        {
+          idx[d] = 0;
+          idx[d - 1]++;
+        }
+      if (idx[0] >= count[0])
+        break;
+    }
+
+ exit:
+  if (mem_spaceid > 0 && H5Sclose(mem_spaceid) < 0)
+    BAIL2(NC_EHDFERR);
+  return retval;
+}
+#endif /* ifndef HDF5_CONVERT */
+
 /* Write an array of data to a variable. When it comes right down to
  * it, this is what netCDF-4 is all about, this is *the* function, the
  * big enchilda, the grand poo-bah, the alpha dog, the head honcho,
@@ -534,7 +745,7 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
   int retval = NC_NOERR, range_error = 0, i, d2;
   void *bufr = NULL;
 #ifndef HDF5_CONVERT
-  int need_to_convert = 0;
+  int need_to_convert = 0, in_blocks = 0;
   size_t len = 1;
 #endif
 #ifdef HDF5_CONVERT
@@ -556,6 +767,9 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
   if ((retval = check_for_vara(&mem_nc_type, var, h5)))
     return retval;
 
+  /* Decoded chunks of this var cached for point reads are stale now. */
+  nc4_point_cache_drop_var(h5, var);
+
   /* Convert from size_t and ptrdiff_t to hssize_t, and hsize_t. */
   for (i = 0; i < var->ndims; i++)
     {
@@ -572,16 +786,12 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
     name_to_use = var->hdf5_name;
   else
     name_to_use = var->name;
-  if (!var->hdf_datasetid)
-    if ((var->hdf_datasetid = H5Dopen2(grp->hdf_grpid, name_to_use, H5P_DEFAULT)) < 0)
-      return NC_ENOTVAR;
+  if ((retval = nc4_open_var_dataset(grp, var, name_to_use)))
+    return retval;
 
   /* Get file space of data. */
-  if ((file_spaceid = H5Dget_space(var->hdf_datasetid)) < 0)
-    BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_spaces++;
-#endif
+  if ((retval = nc4_get_file_space(var, &file_spaceid)))
+    BAIL(retval);
 
   /* Check to ensure the user selection is
    * valid. H5Sget_simple_extent_dims gets the sizes of all the dims
@@ -593,6 +803,15 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
   log_dim_info(var, fdims, fmaxdims, start, count);
 #endif
 
+  /* Until the dataset is over-allocated, the extent of the data
+   * written is the extent of the dataset. */
+  if (var->ndims && !var->logical_dims)
+    {
+      if (!(var->logical_dims = malloc(var->ndims * sizeof(hsize_t))))
+        BAIL(NC_ENOMEM);
+      memcpy(var->logical_dims, fdims, var->ndims * sizeof(hsize_t));
+    }
+
   /* Check dimension bounds. Remember that unlimited dimnsions can
    * put data beyond their current length. */
   for (d2 = 0; d2 < var->ndims; d2++)
@@ -612,33 +831,22 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
      a scalar dataspace with one of the array function calls, but you
      would be wrong. So let's check to see if the dataset is
      scalar. If it is, we won't try to set up a hyperslab. */
-  if (H5Sget_simple_extent_type(file_spaceid) == H5S_SCALAR)
-    {
-      if ((mem_spaceid = H5Screate(H5S_SCALAR)) < 0)
-        BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_spaces++;
-#endif
-    }
-  else
-    {
-      if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, start, NULL,
-                              count, NULL) < 0)
-        BAIL(NC_EHDFERR);
+  if (H5Sget_simple_extent_type(file_spaceid) != H5S_SCALAR)
+    if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, start, NULL,
+                            count, NULL) < 0)
+      BAIL(NC_EHDFERR);
 
-      /* Create a space for the memory, just big enough to hold the slab
-         we want. */
-      if ((mem_spaceid = H5Screate_simple(var->ndims, count, NULL)) < 0)
-        BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_spaces++;
-#endif
-    }
+  /* Get a space for the memory, just big enough to hold the slab we
+     want. */
+  if ((retval = get_mem_space(var, count, &mem_spaceid)))
+    BAIL(retval);
 
 #ifndef HDF5_CONVERT
   /* Are we going to convert any data? (No converting of compound or
-   * opaque types.) */
-  if ((mem_nc_type != var->type_info->nc_typeid || (var->type_info->nc_typeid == NC_INT && is_long)) &&
+   * opaque types.) Quantized data is changed as it is written, so it
+   * is always copied. */
+  if ((mem_nc_type != var->type_info->nc_typeid || (var->type_info->nc_typeid == NC_INT && is_long) ||
+       var->quantize_mode) &&
       mem_nc_type != NC_COMPOUND && mem_nc_type != NC_OPAQUE)
     {
       size_t file_type_size;
@@ -656,12 +864,16 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
       assert(var->type_info->size);
       file_type_size = var->type_info->size;
 
-      /* If we're reading, we need bufr to have enough memory to store
-       * the data in the file. If we're writing, we need bufr to be
-       * big enough to hold all the data in the file's type. */
-      if(len > 0)
-        if (!(bufr = malloc(len * file_type_size)))
-          BAIL(NC_ENOMEM);
+      /* We need bufr to be big enough to hold all the data in the
+       * file's type. Large writes are converted a block at a time
+       * instead, except in parallel, where each rank would make a
+       * different number of (maybe collective) H5Dwrite calls. */
+      if (len * file_type_size > NC4_CONVERT_BLOCK_SIZE && var->ndims &&
+          !h5->parallel)
+        in_blocks++;
+      else if (len > 0)
+        if ((retval = nc4_get_convert_buf(h5, len * file_type_size, &bufr)))
+          BAIL(retval);
     }
   else
 #endif /* ifndef HDF5_CONVERT */
@@ -674,12 +886,18 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
     BAIL(retval);
 #endif
 
-  /* Create the data transfer property list. */
-  if ((xfer_plistid = H5Pcreate(H5P_DATASET_XFER)) < 0)
-    BAIL(NC_EHDFERR);
+  /* Create the data transfer property list. Serial I/O without HDF5
+   * conversion uses the default list, H5P_DEFAULT (0). */
+#ifndef HDF5_CONVERT
+  if (h5->parallel)
+#endif
+    {
+      if ((xfer_plistid = H5Pcreate(H5P_DATASET_XFER)) < 0)
+        BAIL(NC_EHDFERR);
 #ifdef EXTRA_TESTS
-  num_plists++;
+      num_plists++;
 #endif
+    }
 
   /* Apply the callback function which will detect range
    * errors. Which one to call depends on the length of the
@@ -710,6 +928,12 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
               if (start[d2] + count[d2] > fdims[d2])
                 {
                   xtend_size[d2] = start[d2] + count[d2];
+                  /* When appending, at least double the extent, so
+                   * that a run of appends extends the dataset only a
+                   * logarithmic number of times. */
+                  if (h5->append_mode == NC_APPEND_GEOMETRIC &&
+                      xtend_size[d2] < 2 * fdims[d2])
+                    xtend_size[d2] = 2 * fdims[d2];
                   need_to_extend++;
                 }
               else
@@ -719,6 +943,7 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
                 {
                   dim->len = start[d2] + count[d2];
                   dim->extended = NC_TRUE;
+                  h5->meta_dirty = NC_TRUE;
                 }
             }
           else
@@ -761,13 +986,14 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
 #endif /* USE_PARALLEL4 */
           if (H5Dset_extent(var->hdf_datasetid, xtend_size) < 0)
             BAIL(NC_EHDFERR);
-          if (file_spaceid > 0 && H5Sclose(file_spaceid) < 0)
-            BAIL2(NC_EHDFERR);
-          if ((file_spaceid = H5Dget_space(var->hdf_datasetid)) < 0)
-            BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
+          for (d2 = 0; d2 < var->ndims; d2++)
+            if (xtend_size[d2] > var->logical_dims[d2])
+              var->overallocated = NC_TRUE;
+          /* Over-allocation is trimmed on sync. */
+          h5->meta_dirty = NC_TRUE;
+          nc4_release_file_space(var);
+          if ((retval = nc4_get_file_space(var, &file_spaceid)))
+            BAIL(retval);
           if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET,
                                   start, NULL, count, NULL) < 0)
             BAIL(NC_EHDFERR);
@@ -776,27 +1002,52 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
 
 #ifndef HDF5_CONVERT
   /* Do we need to convert the data? */
-  if (need_to_convert)
+  if (in_blocks)
     {
-      if ((retval = nc4_convert_type(data, bufr, mem_nc_type, var->type_info->nc_typeid,
-                                     len, &range_error, var->fill_value,
-                                     (h5->cmode & NC_CLASSIC_MODEL), is_long, 0)))
+      if ((retval = convert_in_blocks(h5, var, PUT, file_spaceid, xfer_plistid,
+                                      start, count, mem_nc_type, is_long,
+                                      data, &range_error)))
         BAIL(retval);
     }
+  else
+    {
+      if (need_to_convert)
+        {
+          if ((retval = nc4_convert_type(data, bufr, mem_nc_type, var->type_info->nc_typeid,
+                                         len, &range_error, var->fill_value,
+                                         (h5->cmode & NC_CLASSIC_MODEL), is_long, 0)))
+            BAIL(retval);
+          nc4_quantize_data(bufr, var->type_info->nc_typeid, len,
+                            var->quantize_mode, var->nsd, var->fill_value);
+        }
 #endif
 
-  /* Write the data. At last! */
-  LOG((4, "about to H5Dwrite datasetid 0x%x mem_spaceid 0x%x "
-       "file_spaceid 0x%x", var->hdf_datasetid, mem_spaceid, file_spaceid));
-  if (H5Dwrite(var->hdf_datasetid, var->type_info->hdf_typeid,
-               mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
-    BAIL(NC_EHDFERR);
+      /* Write the data. At last! */
+      LOG((4, "about to H5Dwrite datasetid 0x%x mem_spaceid 0x%x "
+           "file_spaceid 0x%x", var->hdf_datasetid, mem_spaceid, file_spaceid));
+      if (H5Dwrite(var->hdf_datasetid, var->type_info->hdf_typeid,
+                   mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+        BAIL(NC_EHDFERR);
+#ifndef HDF5_CONVERT
+    }
+#endif
 
   /* Remember that we have written to this var so that Fill Value
    * can't be set for it. */
   if (!var->written_to)
     var->written_to = NC_TRUE;
 
+  /* The data now reaches at least to the end of this write. The
+   * dataset is over-allocated if it reaches further still. */
+  var->overallocated = NC_FALSE;
+  for (d2 = 0; d2 < var->ndims; d2++)
+    {
+      if (var->dim[d2]->unlimited && start[d2] + count[d2] > var->logical_dims[d2])
+        var->logical_dims[d2] = start[d2] + count[d2];
+      if (xtend_size[d2] > var->logical_dims[d2])
+        var->overallocated = NC_TRUE;
+    }
+
   /* For strict netcdf-3 rules, ignore erange errors between UBYTE
    * and BYTE types. */
   if ((h5->cmode & NC_CLASSIC_MODEL) &&
@@ -809,26 +1060,12 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
 #ifdef HDF5_CONVERT
   if (mem_typeid > 0 && H5Tclose(mem_typeid) < 0)
     BAIL2(NC_EHDFERR);
-#endif
-  if (file_spaceid > 0 && H5Sclose(file_spaceid) < 0)
-    BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_spaces--;
-#endif
-  if (mem_spaceid > 0 && H5Sclose(mem_spaceid) < 0)
-    BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_spaces--;
 #endif
   if (xfer_plistid && (H5Pclose(xfer_plistid) < 0))
     BAIL2(NC_EPARINIT);
 #ifdef EXTRA_TESTS
   num_plists--;
 #endif
-#ifndef HDF5_CONVERT
-  if (need_to_convert && bufr) free(bufr);
-#endif
-
   /* If there was an error return it, otherwise return any potential
      range error value. If none, return NC_NOERR as usual.*/
   if (retval)
@@ -840,7 +1077,8 @@ nc4_put_vara(NC *nc, int ncid, int varid, const size_t *startp,
 
 int
 nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
-             const size_t *countp, nc_type mem_nc_type, int is_long, void *data)
+             const size_t *countp, nc_type mem_nc_type, int is_long, void *data,
+             NC4_ARENA_T *arena)
 {
   NC_GRP_INFO_T *grp, *g;
   NC_HDF5_FILE_INFO_T *h5;
@@ -862,7 +1100,7 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
   hid_t mem_typeid = 0;
 #endif
 #ifndef HDF5_CONVERT
-  int need_to_convert = 0;
+  int need_to_convert = 0, in_blocks = 0;
   size_t len = 1;
 #endif
 
@@ -896,16 +1134,23 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
     name_to_use = var->hdf5_name;
   else
     name_to_use = var->name;
-  if (!var->hdf_datasetid)
-    if ((var->hdf_datasetid = H5Dopen2(grp->hdf_grpid, name_to_use, H5P_DEFAULT)) < 0)
-      return NC_ENOTVAR;
+  if ((retval = nc4_open_var_dataset(grp, var, name_to_use)))
+    return retval;
+
+  /* A read of a few values within one chunk may be served from the
+   * cache of decoded chunks, without going through HDF5. */
+  if (var->logical_dims)
+    {
+      nc_bool_t done;
+      retval = nc4_point_read(h5, var, start, count, mem_nc_type, is_long,
+                              data, &done);
+      if (retval || done)
+        return retval;
+    }
 
   /* Get file space of data. */
-  if ((file_spaceid = H5Dget_space(var->hdf_datasetid)) < 0)
-    BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_spaces++;
-#endif
+  if ((retval = nc4_get_file_space(var, &file_spaceid)))
+    BAIL(retval);
 
   /* Check to ensure the user selection is
    * valid. H5Sget_simple_extent_dims gets the sizes of all the dims
@@ -913,6 +1158,18 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
   if (H5Sget_simple_extent_dims(file_spaceid, fdims, fmaxdims) < 0)
     BAIL(NC_EHDFERR);
 
+  /* Anything past the data written so far reads as fill, even if
+   * the dataset has been over-allocated. Until the dataset has been
+   * written to, the extent of the data is that of the dataset. */
+  if (var->logical_dims)
+    memcpy(fdims, var->logical_dims, var->ndims * sizeof(hsize_t));
+  else if (var->ndims && H5Sget_simple_extent_ndims(file_spaceid) == var->ndims)
+    {
+      if (!(var->logical_dims = malloc(var->ndims * sizeof(hsize_t))))
+        BAIL(NC_ENOMEM);
+      memcpy(var->logical_dims, fdims, var->ndims * sizeof(hsize_t));
+    }
+
 #ifdef LOGGING
   log_dim_info(var, fdims, fmaxdims, start, count);
 #endif
@@ -983,27 +1240,15 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
          would be wrong. So let's check to see if the dataset is
          scalar. If it is, we won't try to set up a hyperslab. */
       if (H5Sget_simple_extent_type(file_spaceid) == H5S_SCALAR)
-        {
-          if ((mem_spaceid = H5Screate(H5S_SCALAR)) < 0)
-            BAIL(NC_EHDFERR);
-          scalar++;
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
-        }
-      else
-        {
-          if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET,
-                                  start, NULL, count, NULL) < 0)
-            BAIL(NC_EHDFERR);
-          /* Create a space for the memory, just big enough to hold the slab
-             we want. */
-          if ((mem_spaceid = H5Screate_simple(var->ndims, count, NULL)) < 0)
-            BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
-        }
+        scalar++;
+      else if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET,
+                                   start, NULL, count, NULL) < 0)
+        BAIL(NC_EHDFERR);
+
+      /* Get a space for the memory, just big enough to hold the slab
+         we want. */
+      if ((retval = get_mem_space(var, count, &mem_spaceid)))
+        BAIL(retval);
 
       /* Fix bug when reading HDF5 files with variable of type
        * fixed-length string.  We need to make it look like a
@@ -1029,20 +1274,25 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
       if ((mem_nc_type != var->type_info->nc_typeid || (var->type_info->nc_typeid == NC_INT && is_long)) &&
           mem_nc_type != NC_COMPOUND && mem_nc_type != NC_OPAQUE)
         {
-          /* We must convert - allocate a buffer. */
+          /* We must convert - get a buffer. Only what is actually
+           * read needs converting; any fill values beyond the end of
+           * the data are provided below. */
           need_to_convert++;
           if (var->ndims)
             for (d2 = 0; d2 < var->ndims; d2++)
-              len *= countp[d2];
+              len *= count[d2];
           LOG((4, "converting data for var %s type=%d len=%d", var->name,
                var->type_info->nc_typeid, len));
 
-          /* If we're reading, we need bufr to have enough memory to store
-           * the data in the file. If we're writing, we need bufr to be
-           * big enough to hold all the data in the file's type. */
-          if(len > 0)
-            if (!(bufr = malloc(len * file_type_size)))
-              BAIL(NC_ENOMEM);
+          /* We need bufr to have enough memory to store the data in
+           * the file. Large reads are converted a block at a time
+           * instead, except in parallel, as for writes. */
+          if (len * file_type_size > NC4_CONVERT_BLOCK_SIZE && !scalar &&
+              !h5->parallel)
+            in_blocks++;
+          else if (len > 0)
+            if ((retval = nc4_get_convert_buf(h5, len * file_type_size, &bufr)))
+              BAIL(retval);
         }
       else
 #endif /* ifndef HDF5_CONVERT */
@@ -1056,12 +1306,22 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
         BAIL(retval);
 #endif
 
-      /* Create the data transfer property list. */
-      if ((xfer_plistid = H5Pcreate(H5P_DATASET_XFER)) < 0)
-        BAIL(NC_EHDFERR);
+      /* Create the data transfer property list. Serial I/O without
+       * HDF5 conversion uses the default list, H5P_DEFAULT (0),
+       * unless the strings or vlens read go in an arena. */
+#ifndef HDF5_CONVERT
+      if (h5->parallel || arena)
+#endif
+        {
+          if ((xfer_plistid = H5Pcreate(H5P_DATASET_XFER)) < 0)
+            BAIL(NC_EHDFERR);
 #ifdef EXTRA_TESTS
-      num_plists++;
+          num_plists++;
 #endif
+        }
+      if (arena && H5Pset_vlen_mem_manager(xfer_plistid, nc4_arena_alloc, arena,
+                                           nc4_arena_free, arena) < 0)
+        BAIL(NC_EHDFERR);
 
 #ifdef HDF5_CONVERT
       /* Apply the callback function which will detect range
@@ -1077,11 +1337,23 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
         BAIL(retval);
 #endif
 
-      /* Read this hyperslab into memory. */
-      LOG((5, "About to H5Dread some data..."));
-      if (H5Dread(var->hdf_datasetid, var->type_info->native_hdf_typeid,
-                  mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
-        BAIL(NC_EHDFERR);
+#ifndef HDF5_CONVERT
+      if (in_blocks)
+        {
+          if ((retval = convert_in_blocks(h5, var, GET, file_spaceid, xfer_plistid,
+                                          start, count, mem_nc_type, is_long,
+                                          data, &range_error)))
+            BAIL(retval);
+        }
+      else
+#endif
+        {
+          /* Read this hyperslab into memory. */
+          LOG((5, "About to H5Dread some data..."));
+          if (H5Dread(var->hdf_datasetid, var->type_info->native_hdf_typeid,
+                      mem_spaceid, file_spaceid, xfer_plistid, bufr) < 0)
+            BAIL(NC_EHDFERR);
+        }
 
 #ifndef HDF5_CONVERT
       /* Eventually the block below will go away. Right now it's
@@ -1091,7 +1363,8 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
          now, by a staff of thousands of programming gnomes. */
       if (need_to_convert)
         {
-          if ((retval = nc4_convert_type(bufr, data, var->type_info->nc_typeid, mem_nc_type,
+          if (!in_blocks &&
+              (retval = nc4_convert_type(bufr, data, var->type_info->nc_typeid, mem_nc_type,
                                          len, &range_error, var->fill_value,
                                          (h5->cmode & NC_CLASSIC_MODEL), 0, is_long)))
             BAIL(retval);
@@ -1171,22 +1444,6 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
   if (mem_typeid > 0 && H5Tclose(mem_typeid) < 0)
     BAIL2(NC_EHDFERR);
 #endif
-  if (file_spaceid > 0)
-    {
-      if (H5Sclose(file_spaceid) < 0)
-        BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_spaces--;
-#endif
-    }
-  if (mem_spaceid > 0)
-    {
-      if (H5Sclose(mem_spaceid) < 0)
-        BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_spaces--;
-#endif
-    }
   if (xfer_plistid > 0)
     {
       if (H5Pclose(xfer_plistid) < 0)
@@ -1195,10 +1452,6 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
       num_plists--;
 #endif
     }
-#ifndef HDF5_CONVERT
-  if (need_to_convert && bufr != NULL)
-    free(bufr);
-#endif
   if (xtend_size)
     free(xtend_size);
   if (fillvalue)
@@ -1219,2347 +1472,2109 @@ nc4_get_vara(NC *nc, int ncid, int varid, const size_t *startp,
   return NC_NOERR;
 }
 
-/* Read or write an attribute. */
-static int
-put_att_grpa(NC_GRP_INFO_T *grp, int varid, NC_ATT_INFO_T *att)
+/* A point to read, with its position in the order of the file. */
+typedef struct NC4_POINT_KEY
 {
-  hid_t datasetid = 0, locid;
-  hid_t attid = 0, spaceid = 0, file_typeid = 0;
-  hsize_t dims[1]; /* netcdf attributes always 1-D. */
-  htri_t attr_exists;
-  int retval = NC_NOERR;
-  void *data;
-  int phoney_data = 99;
+  unsigned long long key;
+  size_t point;
+} NC4_POINT_KEY_T;
 
-  assert(att->name);
-  LOG((3, "%s: varid %d att->attnum %d att->name %s att->nc_typeid %d att->len %d",
-       __func__, varid, att->attnum, att->name,
-       att->nc_typeid, att->len));
+static int
+point_key_cmp(const void *a, const void *b)
+{
+  const NC4_POINT_KEY_T *pa = a, *pb = b;
+  if (pa->key != pb->key)
+    return pa->key < pb->key ? -1 : 1;
+  return pa->point < pb->point ? -1 : pa->point > pb->point;
+}
 
-  /* If the file is read-only, return an error. */
-  if (grp->nc4_info->no_write)
-    BAIL(NC_EPERM);
+/* Read the values at scattered points of a var. All the points are
+ * checked against the lengths of the dimensions before any is read,
+ * as in NC3_get_var_points(). The points within the data written so
+ * far are then put in the order they are stored in: chunk by chunk for a chunked var, and row-major for a
+ * contiguous one, so that HDF5's sieve buffer is refilled as few times
+ * as possible. Points of chunked vars are then served from the cache
+ * of decoded chunks where it can, and the rest are read with H5Dread
+ * of a point selection, split so that the buffer for type conversion
+ * never exceeds NC4_CONVERT_BLOCK_SIZE. Any other points, which are
+ * past the data of this var along an unlimited dimension, read as fill
+ * through nc4_get_vara(), one at a time. So are all the points of scalars, vars of types other than the numeric and char
+ * atomic types, and vars of files open for parallel access. */
+int
+nc4_get_var_points(NC *nc, int ncid, int varid, size_t npoints,
+                   const size_t *indexp, nc_type mem_nc_type, int is_long,
+                   void *data)
+{
+  NC_GRP_INFO_T *grp;
+  NC_HDF5_FILE_INFO_T *h5;
+  NC_VAR_INFO_T *var;
+  NC4_POINT_KEY_T *keys = NULL;
+  hid_t file_spaceid = 0, mem_spaceid = 0;
+  hsize_t fdims[NC_MAX_VAR_DIMS], start[NC_MAX_VAR_DIMS], hones[NC_MAX_VAR_DIMS];
+  hsize_t *coords = NULL, nsel = 0, nblock, b, k;
+  size_t ones[NC_MAX_VAR_DIMS], dimlen[NC_MAX_VAR_DIMS];
+  size_t file_type_size, mem_type_size, p, max_block, nread = 0;
+  unsigned long long nchunks, chunk_elems, key, within;
+  char *name_to_use;
+  void *bufr;
+  int need_to_convert, chunked, retval = NC_NOERR, range_error = 0, re, d;
 
-  /* Get the hid to attach the attribute to, or read it from. */
-  if (varid == NC_GLOBAL)
-    locid = grp->hdf_grpid;
-  else
-    {
-      if ((retval = nc4_open_var_grp2(grp, varid, &datasetid)))
-        BAIL(retval);
-      locid = datasetid;
-    }
+  /* Find our metadata for this file, group, and var. */
+  assert(nc);
+  if ((retval = nc4_find_g_var_nc(nc, ncid, varid, &grp, &var)))
+    return retval;
+  h5 = NC4_DATA(nc);
+  assert(grp && h5 && var && var->name);
 
-  /* Delete the att if it exists already. */
-  if ((attr_exists = H5Aexists(locid, att->name)) < 0)
-    BAIL(NC_EHDFERR);
-  if (attr_exists)
+  LOG((3, "%s: var->name %s npoints %d mem_nc_type %d", __func__,
+       var->name, npoints, mem_nc_type));
+
+  /* Check some stuff about the type and the file. */
+  if ((retval = check_for_vara(&mem_nc_type, var, h5)))
+    return retval;
+  if (!npoints)
+    return NC_NOERR;
+
+  if (!var->ndims || h5->parallel ||
+      var->type_info->nc_typeid < NC_BYTE || var->type_info->nc_typeid > NC_UINT64 ||
+      mem_nc_type < NC_BYTE || mem_nc_type > NC_UINT64)
+    return NCDEFAULT_get_var_points(ncid, varid, npoints, indexp, data,
+                                    mem_nc_type);
+
+  /* Check all the points before reading any. Along an unlimited
+   * dimension they may go up to its length, past the data of this
+   * var. */
+  for (d = 0; d < var->ndims; d++)
     {
-      if (H5Adelete(locid, att->name) < 0)
-        BAIL(NC_EHDFERR);
+      if (!var->dim[d]->unlimited)
+        dimlen[d] = var->dim[d]->len;
+      else if ((retval = NC4_inq_dim(ncid, var->dim[d]->dimid, NULL, &dimlen[d])))
+        return retval;
     }
+  for (p = 0; p < npoints; p++)
+    for (d = 0; d < var->ndims; d++)
+      if (indexp[p * var->ndims + d] >= dimlen[d])
+        return NC_EINVALCOORDS;
 
-  /* Get the length ready, and find the HDF type we'll be
-   * writing. */
-  dims[0] = att->len;
-  if ((retval = nc4_get_hdf_typeid(grp->nc4_info, att->nc_typeid,
-                                   &file_typeid, 0)))
-    BAIL(retval);
+  /* Open this dataset if necessary, also checking for a weird case:
+   * a non-coordinate (and non-scalar) variable that has the same
+   * name as a dimension. */
+  if (var->hdf5_name && strlen(var->hdf5_name) >= strlen(NON_COORD_PREPEND) &&
+      strncmp(var->hdf5_name, NON_COORD_PREPEND, strlen(NON_COORD_PREPEND)) == 0)
+    name_to_use = var->hdf5_name;
+  else
+    name_to_use = var->name;
+  if ((retval = nc4_open_var_dataset(grp, var, name_to_use)))
+    return retval;
 
-  /* Even if the length is zero, HDF5 won't let me write with a
-   * NULL pointer. So if the length of the att is zero, point to
-   * some phoney data (which won't be written anyway.)*/
-  if (!dims[0])
-    data = &phoney_data;
-  else if (att->data)
-    data = att->data;
-  else if (att->stdata)
-    data = att->stdata;
+  /* The extent of the data written so far. */
+  if ((retval = nc4_get_file_space(var, &file_spaceid)))
+    return retval;
+  if (var->logical_dims)
+    memcpy(fdims, var->logical_dims, var->ndims * sizeof(hsize_t));
   else
-    data = att->vldata;
+    {
+      if (H5Sget_simple_extent_dims(file_spaceid, fdims, NULL) < 0)
+        return NC_EHDFERR;
+      if (H5Sget_simple_extent_ndims(file_spaceid) == var->ndims)
+        {
+          if (!(var->logical_dims = malloc(var->ndims * sizeof(hsize_t))))
+            return NC_ENOMEM;
+          memcpy(var->logical_dims, fdims, var->ndims * sizeof(hsize_t));
+        }
+    }
 
-  /* NC_CHAR types require some extra work. The space ID is set to
-   * scalar, and the type is told how long the string is. If it's
-   * really zero length, set the size to 1. (The fact that it's
-   * really zero will be marked by the NULL dataspace, but HDF5
-   * doesn't allow me to set the size of the type to zero.)*/
-  if (att->nc_typeid == NC_CHAR)
+  /* Key the points within the data by where they are stored. The
+   * keys only order the reads, so it does no harm if they wrap. */
+  if (!(keys = malloc(npoints * sizeof(NC4_POINT_KEY_T))))
+    return NC_ENOMEM;
+  chunked = !var->contiguous && var->chunksizes;
+  for (p = 0; p < npoints; p++)
     {
-      size_t string_size = dims[0];
-      if (!string_size)
+      const size_t *index = indexp + p * var->ndims;
+      key = 0;
+      within = 0;
+      for (d = 0; d < var->ndims; d++)
         {
-          string_size = 1;
-          if ((spaceid = H5Screate(H5S_NULL)) < 0)
-            BAIL(NC_EATTMETA);
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
+          if (index[d] >= fdims[d])
+            break;
+          if (chunked)
+            {
+              nchunks = (fdims[d] + var->chunksizes[d] - 1) / var->chunksizes[d];
+              key = key * nchunks + index[d] / var->chunksizes[d];
+              within = within * var->chunksizes[d] + index[d] % var->chunksizes[d];
+            }
+          else
+            key = key * fdims[d] + index[d];
         }
-      else
+      if (d < var->ndims)
+        continue;
+      if (chunked)
         {
-          if ((spaceid = H5Screate(H5S_SCALAR)) < 0)
-            BAIL(NC_EATTMETA);
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
+          for (chunk_elems = 1, d = 0; d < var->ndims; d++)
+            chunk_elems *= var->chunksizes[d];
+          key = key * chunk_elems + within;
         }
-      if (H5Tset_size(file_typeid, string_size) < 0)
-        BAIL(NC_EATTMETA);
-      if (H5Tset_strpad(file_typeid, H5T_STR_NULLTERM) < 0)
-        BAIL(NC_EATTMETA);
+      keys[nsel].key = key;
+      keys[nsel++].point = p;
     }
-  else
+  qsort(keys, nsel, sizeof(NC4_POINT_KEY_T), point_key_cmp);
+
+  if ((retval = nc4_get_typelen_mem(h5, mem_nc_type, is_long, &mem_type_size)))
+    BAIL(retval);
+  file_type_size = var->type_info->size;
+  need_to_convert = (mem_nc_type != var->type_info->nc_typeid ||
+                     (var->type_info->nc_typeid == NC_INT && is_long));
+
+  /* Points of chunked vars come from the cache of decoded chunks, in
+   * chunk order, so each chunk is decoded once. Those it can't serve
+   * are kept for HDF5. */
+  if (chunked && h5->point_cache_size && var->logical_dims)
     {
-      if (!att->len)
+      for (d = 0; d < var->ndims; d++)
+        hones[d] = 1;
+      for (k = 0; k < nsel; k++)
         {
-          if ((spaceid = H5Screate(H5S_NULL)) < 0)
-            BAIL(NC_EATTMETA);
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
+          const size_t *index = indexp + keys[k].point * var->ndims;
+          nc_bool_t done;
+          for (d = 0; d < var->ndims; d++)
+            start[d] = index[d];
+          if ((re = nc4_point_read(h5, var, start, hones, mem_nc_type, is_long,
+                                   (char *)data + keys[k].point * mem_type_size,
+                                   &done)))
+            {
+              if (re != NC_ERANGE)
+                BAIL(re);
+              range_error++;
+            }
+          if (!done)
+            keys[nread++] = keys[k];
         }
-      else
+    }
+  else
+    nread = nsel;
+
+  /* Select the rest in storage order, and scatter the values to where
+   * their points were given. */
+  if (nread)
+    {
+      max_block = NC4_CONVERT_BLOCK_SIZE / file_type_size;
+      if (!(coords = malloc((nread < max_block ? nread : max_block) *
+                            var->ndims * sizeof(hsize_t))))
+        BAIL(NC_ENOMEM);
+    }
+  for (b = 0; b < nread; b += nblock)
+    {
+      nblock = nread - b < max_block ? nread - b : max_block;
+      for (k = 0; k < nblock; k++)
+        for (d = 0; d < var->ndims; d++)
+          coords[k * var->ndims + d] = indexp[keys[b + k].point * var->ndims + d];
+
+      if ((retval = nc4_get_convert_buf(h5, nblock * file_type_size, &bufr)))
+        BAIL(retval);
+      if (H5Sselect_elements(file_spaceid, H5S_SELECT_SET, nblock, coords) < 0)
+        BAIL(NC_EHDFERR);
+      if ((mem_spaceid = H5Screate_simple(1, &nblock, NULL)) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Dread(var->hdf_datasetid, var->type_info->native_hdf_typeid,
+                  mem_spaceid, file_spaceid, H5P_DEFAULT, bufr) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Sclose(mem_spaceid) < 0)
+        BAIL(NC_EHDFERR);
+      mem_spaceid = 0;
+
+      for (k = 0; k < nblock; k++)
         {
-          if ((spaceid = H5Screate_simple(1, dims, NULL)) < 0)
-            BAIL(NC_EATTMETA);
-#ifdef EXTRA_TESTS
-          num_spaces++;
-#endif
+          void *src = (char *)bufr + k * file_type_size;
+          void *dest = (char *)data + keys[b + k].point * mem_type_size;
+          if (!need_to_convert)
+            memcpy(dest, src, file_type_size);
+          else
+            {
+              if ((retval = nc4_convert_type(src, dest, var->type_info->nc_typeid,
+                                             mem_nc_type, 1, &re, var->fill_value,
+                                             (h5->cmode & NC_CLASSIC_MODEL), 0,
+                                             is_long)))
+                BAIL(retval);
+              range_error += re;
+            }
         }
     }
-  if ((attid = H5Acreate(locid, att->name, file_typeid, spaceid,
-                         H5P_DEFAULT)) < 0)
-    BAIL(NC_EATTMETA);
 
-  /* Write the values, (even if length is zero). */
-  if (H5Awrite(attid, file_typeid, data) < 0)
-    BAIL(NC_EATTMETA);
+  /* For strict netcdf-3 rules, ignore erange errors between UBYTE
+   * and BYTE types. */
+  if ((h5->cmode & NC_CLASSIC_MODEL) &&
+      (var->type_info->nc_typeid == NC_UBYTE || var->type_info->nc_typeid == NC_BYTE) &&
+      (mem_nc_type == NC_UBYTE || mem_nc_type == NC_BYTE) &&
+      range_error)
+    range_error = 0;
+
+  /* The rest of the points are past the data of this var, and read
+   * as fill. */
+  if (nsel < npoints)
+    {
+      for (d = 0; d < var->ndims; d++)
+        ones[d] = 1;
+      for (p = 0; p < npoints; p++)
+        {
+          const size_t *index = indexp + p * var->ndims;
+          for (d = 0; d < var->ndims; d++)
+            if (index[d] >= fdims[d])
+              break;
+          if (d == var->ndims)
+            continue;
+          if ((re = nc4_get_vara(nc, ncid, varid, index, ones, mem_nc_type,
+                                 is_long, (char *)data + p * mem_type_size,
+                                 NULL)))
+            {
+              if (re != NC_ERANGE)
+                BAIL(re);
+              range_error++;
+            }
+        }
+    }
 
  exit:
-  if (file_typeid && H5Tclose(file_typeid))
-    BAIL2(NC_EHDFERR);
-  if (attid > 0 && H5Aclose(attid) < 0)
-    BAIL2(NC_EHDFERR);
-  if (spaceid > 0 && H5Sclose(spaceid) < 0)
+  if (mem_spaceid > 0 && H5Sclose(mem_spaceid) < 0)
     BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_spaces--;
-#endif
-  return retval;
+  if (coords)
+    free(coords);
+  if (keys)
+    free(keys);
+  if (retval)
+    return retval;
+  if (range_error)
+    return NC_ERANGE;
+  return NC_NOERR;
 }
 
-/* Write all the dirty atts in an attlist. */
+/* Read one field of the values of a hyperslab of a compound var in
+ * blocks of at most NC4_CONVERT_BLOCK_SIZE bytes of whole values,
+ * using the file's conversion buffer, and gather the field of each
+ * value into the caller's buffer. HDF5 reads whole values of a type
+ * as they are in memory much faster than it converts them to a
+ * compound type of fewer members, so this is used for types without
+ * data of variable length, which would be allocated for every
+ * member. Blocks are taken as in convert_in_blocks(). */
 static int
-write_attlist(NC_ATT_INFO_T *attlist, int varid, NC_GRP_INFO_T *grp)
+get_field_in_blocks(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var,
+                    hid_t file_spaceid, const hsize_t *start,
+                    const hsize_t *count, size_t field_offset,
+                    size_t field_size, void *data)
 {
-  NC_ATT_INFO_T *att;
-  int retval;
+  hsize_t bstart[NC_MAX_VAR_DIMS], bcount[NC_MAX_VAR_DIMS];
+  hsize_t idx[NC_MAX_VAR_DIMS];
+  hsize_t inner = 1, step, nelems, e;
+  size_t native_size, block_elems, offset;
+  hid_t mem_spaceid = 0;
+  char *bufr, *src, *dest;
+  int k, d, retval = NC_NOERR;
+
+  assert(var->ndims > 0);
+  if (!(native_size = H5Tget_size(var->type_info->native_hdf_typeid)))
+    return NC_EHDFERR;
+  if ((block_elems = NC4_CONVERT_BLOCK_SIZE / native_size) == 0)
+    block_elems = 1;
+  if ((retval = nc4_get_convert_buf(h5, block_elems * native_size,
+                                    (void **)&bufr)))
+    return retval;
 
-  for (att = attlist; att; att = att->l.next)
+  /* Take whole innermost dimensions while they fit, then split
+   * dimension k into steps. */
+  for (k = var->ndims - 1; k > 0 && inner * count[k] <= block_elems; k--)
+    inner *= count[k];
+  step = block_elems / inner;
+  if (step > count[k])
+    step = count[k];
+
+  for (d = 0; d < var->ndims; d++)
     {
-      if (att->dirty)
+      idx[d] = 0;
+      bstart[d] = start[d];
+      bcount[d] = d > k ? count[d] : 1;
+    }
+
+  for (;;)
+    {
+      /* This block, and where it lives in the caller's buffer. */
+      for (offset = 0, d = 0; d <= k; d++)
         {
-          LOG((4, "%s: writing att %s to varid %d", __func__, att->name, varid));
-          if ((retval = put_att_grpa(grp, varid, att)))
-            return retval;
-          att->dirty = NC_FALSE;
-          att->created = NC_TRUE;
+          bstart[d] = start[d] + idx[d];
+          offset = offset * count[d] + idx[d];
         }
-    }
-  return NC_NOERR;
-}
+      offset *= inner;
+      bcount[k] = count[k] - idx[k] < step ? count[k] - idx[k] : step;
+      nelems = bcount[k] * inner;
 
+      if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, bstart, NULL,
+                              bcount, NULL) < 0)
+        BAIL(NC_EHDFERR);
+      if ((mem_spaceid = H5Screate_simple(1, &nelems, NULL)) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Dread(var->hdf_datasetid, var->type_info->native_hdf_typeid,
+                  mem_spaceid, file_spaceid, H5P_DEFAULT, bufr) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Sclose(mem_spaceid) < 0)
+        BAIL(NC_EHDFERR);
+      mem_spaceid = 0;
 
-/* This function is a bit of a hack. Turns out that HDF5 dimension
- * scales cannot themselves have scales attached. This leaves
- * multidimensional coordinate variables hosed. So this function
- * writes a special attribute for such a variable, which has the ids
- * of all the dimensions for that coordinate variable. This sucks,
- * really. But that's the way the cookie crumbles. Better luck next
- * time. This function also contains a new way of dealing with HDF5
- * error handling, abandoning the BAIL macros for a more organic and
- * natural approach, made with whole grains, and locally-grown
- * vegetables. */
-static int
-write_coord_dimids(NC_VAR_INFO_T *var)
-{
-  hsize_t coords_len[1];
-  hid_t c_spaceid = -1, c_attid = -1;
-  int ret = 0;
+      src = bufr + field_offset;
+      dest = (char *)data + offset * field_size;
+      for (e = 0; e < nelems; e++)
+        {
+          memcpy(dest, src, field_size);
+          src += native_size;
+          dest += field_size;
+        }
 
-  /* Write our attribute. */
-  coords_len[0] = var->ndims;
-  if ((c_spaceid = H5Screate_simple(1, coords_len, coords_len)) < 0) ret++;
-#ifdef EXTRA_TESTS
-  num_spaces++;
-#endif
-  if (!ret && (c_attid = H5Acreate(var->hdf_datasetid, COORDINATES, H5T_NATIVE_INT,
-                                   c_spaceid, H5P_DEFAULT)) < 0) ret++;
-  if (!ret && H5Awrite(c_attid, H5T_NATIVE_INT, var->dimids) < 0) ret++;
+      /* Move on to the next block. */
+      idx[k] += bcount[k];
+      for (d = k; d > 0 && idx[d] >= count[d]; d--)
+        {
+          idx[d] = 0;
+          idx[d - 1]++;
+        }
+      if (idx[0] >= count[0])
+        break;
+    }
 
-  /* Close up shop. */
-  if (c_spaceid > 0 && H5Sclose(c_spaceid) < 0) ret++;
-#ifdef EXTRA_TESTS
-  num_spaces--;
-#endif
-  if (c_attid > 0 && H5Aclose(c_attid) < 0) ret++;
-  return ret ? NC_EHDFERR : 0;
+ exit:
+  if (mem_spaceid > 0 && H5Sclose(mem_spaceid) < 0)
+    BAIL2(NC_EHDFERR);
+  return retval;
 }
 
-/* Write a special attribute for the netCDF-4 dimension ID. */
-static int
-write_netcdf4_dimid(hid_t datasetid, int dimid)
+/* Read one field of the values of a hyperslab of a compound var,
+ * packed one after another. Types with data of variable length are
+ * read through a compound memory type of that member alone, so only
+ * it is allocated and copied; others are read in blocks of whole
+ * values. Any part of the hyperslab past the data written so far
+ * reads as the field of the fill value. */
+int
+nc4_get_vara_field(NC *nc, int ncid, int varid, int fieldid,
+                   const size_t *startp, const size_t *countp, void *data)
 {
-  hid_t dimid_spaceid, dimid_attid;
-  htri_t attr_exists;
-
-  /* Create the space. */
-  if ((dimid_spaceid = H5Screate(H5S_SCALAR)) < 0)
-    return NC_EHDFERR;
-#ifdef EXTRA_TESTS
-  num_spaces++;
-#endif
+  NC_GRP_INFO_T *grp;
+  NC_HDF5_FILE_INFO_T *h5;
+  NC_VAR_INFO_T *var;
+  NC_FIELD_INFO_T *field;
+  hid_t file_spaceid = 0, mem_spaceid = 0, field_typeid = 0, mem_typeid = 0;
+  hid_t xfer_plistid = 0;
+  hsize_t fdims[NC_MAX_VAR_DIMS], start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+  hsize_t read_count[NC_MAX_VAR_DIMS], mem_start[NC_MAX_VAR_DIMS];
+  size_t field_size, field_offset, dimlen, len = 1, i;
+  nc_type mem_nc_type = NC_NAT;
+  char *name_to_use;
+  int idx, no_read = 0, partial = 0, varlen, retval = NC_NOERR, d;
+  int collective = 0;
 
-  /* Does the attribute already exist? If so, don't try to create it. */
-  if ((attr_exists = H5Aexists(datasetid, NC_DIMID_ATT_NAME)) < 0)
-    return NC_EHDFERR;
-  if (attr_exists)
-    dimid_attid = H5Aopen_by_name(datasetid, ".", NC_DIMID_ATT_NAME,
-                                  H5P_DEFAULT, H5P_DEFAULT);
-  else
-    /* Create the attribute if needed. */
-    dimid_attid = H5Acreate(datasetid, NC_DIMID_ATT_NAME,
-                            H5T_NATIVE_INT, dimid_spaceid, H5P_DEFAULT);
-  if (dimid_attid  < 0)
-    return NC_EHDFERR;
+  /* Find our metadata for this file, group, and var. */
+  assert(nc);
+  if ((retval = nc4_find_g_var_nc(nc, ncid, varid, &grp, &var)))
+    return retval;
+  h5 = NC4_DATA(nc);
+  assert(grp && h5 && var && var->name);
 
+  LOG((3, "%s: var->name %s fieldid %d", __func__, var->name, fieldid));
 
-  /* Write it. */
-  LOG((4, "%s: writing secret dimid %d", __func__, dimid));
-  if (H5Awrite(dimid_attid, H5T_NATIVE_INT, &dimid) < 0)
-    return NC_EHDFERR;
+  if (var->type_info->nc_type_class != NC_COMPOUND)
+    return NC_EBADTYPE;
+  for (field = var->type_info->u.c.field; field; field = field->l.next)
+    if (field->fieldid == fieldid)
+      break;
+  if (!field)
+    return NC_EBADFIELD;
+  if ((retval = check_for_vara(&mem_nc_type, var, h5)))
+    return retval;
 
-  /* Close stuff*/
-  if (H5Sclose(dimid_spaceid) < 0)
-    return NC_EHDFERR;
-#ifdef EXTRA_TESTS
-  num_spaces--;
-#endif
-  if (H5Aclose(dimid_attid) < 0)
-    return NC_EHDFERR;
+  /* Open this dataset if necessary, also checking for a weird case:
+   * a non-coordinate (and non-scalar) variable that has the same
+   * name as a dimension. */
+  if (var->hdf5_name && strlen(var->hdf5_name) >= strlen(NON_COORD_PREPEND) &&
+      strncmp(var->hdf5_name, NON_COORD_PREPEND, strlen(NON_COORD_PREPEND)) == 0 &&
+      var->ndims)
+    name_to_use = var->hdf5_name;
+  else
+    name_to_use = var->name;
+  if ((retval = nc4_open_var_dataset(grp, var, name_to_use)))
+    return retval;
 
-  return NC_NOERR;
-}
+  /* The extent of the data written so far. */
+  if ((retval = nc4_get_file_space(var, &file_spaceid)))
+    return retval;
+  if (var->logical_dims)
+    memcpy(fdims, var->logical_dims, var->ndims * sizeof(hsize_t));
+  else
+    {
+      if (H5Sget_simple_extent_dims(file_spaceid, fdims, NULL) < 0)
+        return NC_EHDFERR;
+      if (var->ndims && H5Sget_simple_extent_ndims(file_spaceid) == var->ndims)
+        {
+          if (!(var->logical_dims = malloc(var->ndims * sizeof(hsize_t))))
+            return NC_ENOMEM;
+          memcpy(var->logical_dims, fdims, var->ndims * sizeof(hsize_t));
+        }
+    }
 
-/* This function creates the HDF5 dataset for a variable. */
-static int
-var_create_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var, nc_bool_t write_dimid)
-{
-  NC_GRP_INFO_T *g;
-  hid_t plistid = 0, access_plistid = 0, typeid = 0, spaceid = 0;
-  hsize_t chunksize[H5S_MAX_RANK], dimsize[H5S_MAX_RANK], maxdimsize[H5S_MAX_RANK];
-  int d;
-  void *fillp = NULL;
-  NC_DIM_INFO_T *dim = NULL;
-  int dims_found = 0;
-  char *name_to_use;
-  int retval = NC_NOERR;
+  /* Check the hyperslab against the dimensions, and clip what is
+   * read to the data written so far. */
+  for (d = 0; d < var->ndims; d++)
+    {
+      start[d] = startp[d];
+      count[d] = countp[d];
+      if (var->dim[d]->unlimited)
+        {
+          if ((retval = NC4_inq_dim(ncid, var->dim[d]->dimid, NULL, &dimlen)))
+            return retval;
+        }
+      else
+        dimlen = fdims[d];
+      if (start[d] >= dimlen && count[d])
+        return NC_EINVALCOORDS;
+      if (start[d] + count[d] > dimlen)
+        return NC_EEDGE;
+      read_count[d] = start[d] >= fdims[d] ? 0 :
+        start[d] + count[d] > fdims[d] ? fdims[d] - start[d] : count[d];
+      if (read_count[d] < count[d])
+        partial++;
+      if (!read_count[d])
+        no_read++;
+      mem_start[d] = 0;
+      len *= count[d];
+    }
 
-  LOG((3, "%s:: name %s", __func__, var->name));
+  /* In collective mode every rank must take part in the H5Dread,
+   * even one with nothing to read. */
+#ifdef USE_PARALLEL4
+  collective = h5->parallel && var->parallel_access == NC_COLLECTIVE;
+#endif
+  if (!len && !collective)
+    return NC_NOERR;
 
-  /* Scalar or not, we need a creation property list. */
-  if ((plistid = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+  /* The memory type is a compound type of the field alone. */
+  if ((idx = H5Tget_member_index(var->type_info->native_hdf_typeid,
+                                 field->name)) < 0)
     BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_plists++;
-#endif
-  if ((access_plistid = H5Pcreate(H5P_DATASET_ACCESS)) < 0)
+  if ((field_typeid = H5Tget_member_type(var->type_info->native_hdf_typeid,
+                                         (unsigned)idx)) < 0)
     BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_plists++;
-#endif
+  field_offset = H5Tget_member_offset(var->type_info->native_hdf_typeid,
+                                      (unsigned)idx);
+  if (!(field_size = H5Tget_size(field_typeid)))
+    BAIL(NC_EHDFERR);
+  varlen = H5Tdetect_class(field_typeid, H5T_VLEN) > 0 ||
+    H5Tis_variable_str(field_typeid) > 0;
 
-  /* RJ: this suppose to be FALSE that is defined in H5 private.h as 0 */
-  if (H5Pset_obj_track_times(plistid,0)<0)
+  if (!partial && var->ndims && !h5->parallel &&
+      H5Tdetect_class(var->type_info->native_hdf_typeid, H5T_VLEN) <= 0)
+    {
+      retval = get_field_in_blocks(h5, var, file_spaceid, start, count,
+                                   field_offset, field_size, data);
+      goto exit;
+    }
+
+  if ((mem_typeid = H5Tcreate(H5T_COMPOUND, field_size)) < 0)
+    BAIL(NC_EHDFERR);
+  if (H5Tinsert(mem_typeid, field->name, 0, field_typeid) < 0)
     BAIL(NC_EHDFERR);
 
-  /* Find the HDF5 type of the dataset. */
-  if ((retval = nc4_get_hdf_typeid(grp->nc4_info, var->type_info->nc_typeid, &typeid,
-                                   var->type_info->endianness)))
-    BAIL(retval);
+  /* Values that are not read are the field of the fill value, or
+   * zeros (no data) if the field holds data of variable length,
+   * which can't be shared. */
+  if (partial)
+    {
+      if (var->fill_value && !varlen)
+        for (i = 0; i < len; i++)
+          memcpy((char *)data + i * field_size,
+                 (char *)var->fill_value + field_offset, field_size);
+      else
+        memset(data, 0, len * field_size);
+    }
+  if (no_read && !collective)
+    goto exit;
 
-  /* Figure out what fill value to set, if any. */
-  if (var->no_fill)
+  /* Select the hyperslab in the file, and where it goes in memory. */
+  if (no_read)
     {
-      /* Required to truly turn HDF5 fill values off */
-      if (H5Pset_fill_time(plistid, H5D_FILL_TIME_NEVER) < 0)
+      if (H5Sselect_none(file_spaceid) < 0)
+        BAIL(NC_EHDFERR);
+      if ((mem_spaceid = H5Screate(H5S_SCALAR)) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Sselect_none(mem_spaceid) < 0)
         BAIL(NC_EHDFERR);
     }
-  else
+  else if (var->ndims)
     {
-      if ((retval = get_fill_value(grp->nc4_info, var, &fillp)))
-        BAIL(retval);
-
-      /* If there is a fill value, set it. */
-      if (fillp)
-        {
-          if (var->type_info->nc_type_class == NC_STRING)
-            {
-              if (H5Pset_fill_value(plistid, typeid, fillp) < 0)
-                BAIL(NC_EHDFERR);
-            }
-          else
-            {
-              /* The fill value set in HDF5 must always be presented as
-               * a native type, even if the endianness for this dataset
-               * is non-native. HDF5 will translate the fill value to
-               * the target endiannesss. */
-              hid_t fill_typeid = 0;
+      if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, start, NULL,
+                              read_count, NULL) < 0)
+        BAIL(NC_EHDFERR);
+      if ((mem_spaceid = H5Screate_simple(var->ndims, count, NULL)) < 0)
+        BAIL(NC_EHDFERR);
+      if (partial && H5Sselect_hyperslab(mem_spaceid, H5S_SELECT_SET, mem_start,
+                                         NULL, read_count, NULL) < 0)
+        BAIL(NC_EHDFERR);
+    }
+  else if ((mem_spaceid = H5Screate(H5S_SCALAR)) < 0)
+    BAIL(NC_EHDFERR);
 
-              if ((retval = nc4_get_hdf_typeid(grp->nc4_info, var->type_info->nc_typeid, &fill_typeid,
-                                               NC_ENDIAN_NATIVE)))
-                BAIL(retval);
-              if (H5Pset_fill_value(plistid, fill_typeid, fillp) < 0)
-                {
-                  if (H5Tclose(fill_typeid) < 0)
-                    BAIL(NC_EHDFERR);
-                  BAIL(NC_EHDFERR);
-                }
-              if (H5Tclose(fill_typeid) < 0)
-                BAIL(NC_EHDFERR);
-            }
-        }
+#ifdef USE_PARALLEL4
+  /* Set up parallel I/O, if needed. */
+  if (h5->parallel)
+    {
+      if ((xfer_plistid = H5Pcreate(H5P_DATASET_XFER)) < 0)
+        BAIL(NC_EHDFERR);
+      if ((retval = set_par_access(h5, var, xfer_plistid)))
+        BAIL(retval);
     }
+#endif
 
-  /* If the user wants to shuffle the data, set that up now. */
-  if (var->shuffle)
-    if (H5Pset_shuffle(plistid) < 0)
-      BAIL(NC_EHDFERR);
+  if (H5Dread(var->hdf_datasetid, mem_typeid, mem_spaceid, file_spaceid,
+              xfer_plistid, data) < 0)
+    BAIL(NC_EHDFERR);
 
-  /* If the user wants to deflate the data, set that up now. */
-  if (var->deflate)
-    if (H5Pset_deflate(plistid, var->deflate_level) < 0)
-      BAIL(NC_EHDFERR);
+ exit:
+  if (xfer_plistid > 0 && H5Pclose(xfer_plistid) < 0)
+    BAIL2(NC_EHDFERR);
+  if (mem_spaceid > 0 && H5Sclose(mem_spaceid) < 0)
+    BAIL2(NC_EHDFERR);
+  if (mem_typeid > 0 && H5Tclose(mem_typeid) < 0)
+    BAIL2(NC_EHDFERR);
+  if (field_typeid > 0 && H5Tclose(field_typeid) < 0)
+    BAIL2(NC_EHDFERR);
+  return retval;
+}
 
-  /* Szip? NO! We don't want anyone to produce szipped netCDF files! */
-  /* #ifdef USE_SZIP */
-  /*    if (var->options_mask) */
-  /*       if (H5Pset_szip(plistid, var->options_mask, var->bits_per_pixel) < 0) */
-  /*          BAIL(NC_EHDFERR); */
-  /* #endif */
+/* Read or write an attribute. */
+static int
+put_att_grpa(NC_GRP_INFO_T *grp, int varid, NC_ATT_INFO_T *att)
+{
+  hid_t datasetid = 0, locid;
+  hid_t attid = 0, spaceid = 0, file_typeid = 0;
+  hsize_t dims[1]; /* netcdf attributes always 1-D. */
+  htri_t attr_exists;
+  int retval = NC_NOERR;
+  void *data;
+  int phoney_data = 99;
 
-  /* If the user wants to fletcher error correcton, set that up now. */
-  if (var->fletcher32)
-    if (H5Pset_fletcher32(plistid) < 0)
-      BAIL(NC_EHDFERR);
+  assert(att->name);
+  LOG((3, "%s: varid %d att->attnum %d att->name %s att->nc_typeid %d att->len %d",
+       __func__, varid, att->attnum, att->name,
+       att->nc_typeid, att->len));
 
-  /* If ndims non-zero, get info for all dimensions. We look up the
-     dimids and get the len of each dimension. We need this to create
-     the space for the dataset. In netCDF a dimension length of zero
-     means an unlimited dimension. */
-  if (var->ndims)
+  /* If the file is read-only, return an error. */
+  if (grp->nc4_info->no_write)
+    BAIL(NC_EPERM);
+
+  /* Get the hid to attach the attribute to, or read it from. */
+  if (varid == NC_GLOBAL)
+    locid = grp->hdf_grpid;
+  else
     {
-      int unlimdim = 0;
+      if ((retval = nc4_open_var_grp2(grp, varid, &datasetid)))
+        BAIL(retval);
+      locid = datasetid;
+    }
 
-      /* Check to see if any unlimited dimensions are used in this var. */
-      for (d = 0; d < var->ndims; d++) {
-	dim = var->dim[d];
-	assert(dim && dim->dimid == var->dimids[d]);
-	if (dim->unlimited)
-	  unlimdim++;
-      }
+  /* Delete the att if it exists already. */
+  if ((attr_exists = H5Aexists(locid, att->name)) < 0)
+    BAIL(NC_EHDFERR);
+  if (attr_exists)
+    {
+      if (H5Adelete(locid, att->name) < 0)
+        BAIL(NC_EHDFERR);
+    }
 
-      /* If there are no unlimited dims, and no filters, and the user
-       * has not specified chunksizes, use contiguous variable for
-       * better performance. */
+  /* Get the length ready, and find the HDF type we'll be
+   * writing. */
+  dims[0] = att->len;
+  if ((retval = nc4_get_hdf_typeid(grp->nc4_info, att->nc_typeid,
+                                   &file_typeid, 0)))
+    BAIL(retval);
 
-      if(!var->shuffle && !var->deflate && !var->options_mask &&
-         !var->fletcher32 && (var->chunksizes == NULL || !var->chunksizes[0])) {
-#ifdef USE_HDF4
-        NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
-        if(h5->hdf4 || !unlimdim)
-#else
-          if(!unlimdim)
-#endif
-            var->contiguous = NC_TRUE;
-      }
-
-      /* Gather current & maximum dimension sizes, along with chunk sizes */
-      for (d = 0; d < var->ndims; d++)
-        {
-          dim = var->dim[d];
-	  assert(dim && dim->dimid == var->dimids[d]);
-          dimsize[d] = dim->unlimited ? NC_HDF5_UNLIMITED_DIMSIZE : dim->len;
-          maxdimsize[d] = dim->unlimited ? H5S_UNLIMITED : (hsize_t)dim->len;
-          if (!var->contiguous) {
-            if (var->chunksizes[d])
-              chunksize[d] = var->chunksizes[d];
-            else
-              {
-                size_t type_size;
-                if (var->type_info->nc_type_class == NC_STRING)
-                  type_size = sizeof(char *);
-                else
-                  type_size = var->type_info->size;
-
-                /* Unlimited dim always gets chunksize of 1. */
-                if (dim->unlimited)
-                  chunksize[d] = 1;
-                else
-                  chunksize[d] = pow((double)DEFAULT_CHUNK_SIZE/type_size,
-                                     1/(double)(var->ndims - unlimdim));
-
-                /* If the chunksize is greater than the dim
-                 * length, make it the dim length. */
-                if (!dim->unlimited && chunksize[d] > dim->len)
-                  chunksize[d] = dim->len;
-
-                /* Remember the computed chunksize */
-                var->chunksizes[d] = chunksize[d];
-              }
-          }
-        }
+  /* Even if the length is zero, HDF5 won't let me write with a
+   * NULL pointer. So if the length of the att is zero, point to
+   * some phoney data (which won't be written anyway.)*/
+  if (!dims[0])
+    data = &phoney_data;
+  else if (att->data)
+    data = att->data;
+  else if (att->stdata)
+    data = att->stdata;
+  else
+    data = att->vldata;
 
-      if (var->contiguous)
+  /* NC_CHAR types require some extra work. The space ID is set to
+   * scalar, and the type is told how long the string is. If it's
+   * really zero length, set the size to 1. (The fact that it's
+   * really zero will be marked by the NULL dataspace, but HDF5
+   * doesn't allow me to set the size of the type to zero.)*/
+  if (att->nc_typeid == NC_CHAR)
+    {
+      size_t string_size = dims[0];
+      if (!string_size)
         {
-          if (H5Pset_layout(plistid, H5D_CONTIGUOUS) < 0)
-            BAIL(NC_EHDFERR);
+          string_size = 1;
+          if ((spaceid = H5Screate(H5S_NULL)) < 0)
+            BAIL(NC_EATTMETA);
+#ifdef EXTRA_TESTS
+          num_spaces++;
+#endif
         }
       else
         {
-          if (H5Pset_chunk(plistid, var->ndims, chunksize) < 0)
-            BAIL(NC_EHDFERR);
-        }
-
-      /* Create the dataspace. */
-      if ((spaceid = H5Screate_simple(var->ndims, dimsize, maxdimsize)) < 0)
-        BAIL(NC_EHDFERR);
+          if ((spaceid = H5Screate(H5S_SCALAR)) < 0)
+            BAIL(NC_EATTMETA);
 #ifdef EXTRA_TESTS
-      num_spaces++;
+          num_spaces++;
 #endif
+        }
+      if (H5Tset_size(file_typeid, string_size) < 0)
+        BAIL(NC_EATTMETA);
+      if (H5Tset_strpad(file_typeid, H5T_STR_NULLTERM) < 0)
+        BAIL(NC_EATTMETA);
     }
   else
     {
-      if ((spaceid = H5Screate(H5S_SCALAR)) < 0)
-        BAIL(NC_EHDFERR);
+      if (!att->len)
+        {
+          if ((spaceid = H5Screate(H5S_NULL)) < 0)
+            BAIL(NC_EATTMETA);
 #ifdef EXTRA_TESTS
-      num_spaces++;
+          num_spaces++;
 #endif
+        }
+      else
+        {
+          if ((spaceid = H5Screate_simple(1, dims, NULL)) < 0)
+            BAIL(NC_EATTMETA);
+#ifdef EXTRA_TESTS
+          num_spaces++;
+#endif
+        }
     }
+  if ((attid = H5Acreate(locid, att->name, file_typeid, spaceid,
+                         H5P_DEFAULT)) < 0)
+    BAIL(NC_EATTMETA);
 
-  /* Turn on creation order tracking. */
-  if (H5Pset_attr_creation_order(plistid, H5P_CRT_ORDER_TRACKED|
-                                 H5P_CRT_ORDER_INDEXED) < 0)
-    BAIL(NC_EHDFERR);
-
-  /* Set per-var chunk cache, for chunked datasets. */
-  if (!var->contiguous && var->chunk_cache_size)
-    if (H5Pset_chunk_cache(access_plistid, var->chunk_cache_nelems,
-                           var->chunk_cache_size, var->chunk_cache_preemption) < 0)
-      BAIL(NC_EHDFERR);
-
-  /* At long last, create the dataset. */
-  name_to_use = var->hdf5_name ? var->hdf5_name : var->name;
-  LOG((4, "%s: about to H5Dcreate2 dataset %s of type 0x%x", __func__,
-       name_to_use, typeid));
-  if ((var->hdf_datasetid = H5Dcreate2(grp->hdf_grpid, name_to_use, typeid,
-                                       spaceid, H5P_DEFAULT, plistid, access_plistid)) < 0)
-    BAIL(NC_EHDFERR);
-  var->created = NC_TRUE;
-  var->is_new_var = NC_FALSE;
-
-  /* If this is a dimscale, mark it as such in the HDF5 file. Also
-   * find the dimension info and store the dataset id of the dimscale
-   * dataset. */
-  if (var->dimscale)
-    {
-      if (H5DSset_scale(var->hdf_datasetid, var->name) < 0)
-        BAIL(NC_EHDFERR);
-
-      /* If this is a multidimensional coordinate variable, write a
-       * coordinates attribute. */
-      if (var->ndims > 1)
-        if ((retval = write_coord_dimids(var)))
-          BAIL(retval);
-
-      /* If desired, write the netCDF dimid. */
-      if (write_dimid)
-        if ((retval = write_netcdf4_dimid(var->hdf_datasetid, var->dimids[0])))
-          BAIL(retval);
-    }
-
-
-  /* Write attributes for this var. */
-  if ((retval = write_attlist(var->att, var->varid, grp)))
-    BAIL(retval);
-  var->attr_dirty = NC_FALSE;
+  /* Write the values, (even if length is zero). */
+  if (H5Awrite(attid, file_typeid, data) < 0)
+    BAIL(NC_EATTMETA);
 
  exit:
-  if (typeid > 0 && H5Tclose(typeid) < 0)
-    BAIL2(NC_EHDFERR);
-  if (plistid > 0 && H5Pclose(plistid) < 0)
+  if (file_typeid && H5Tclose(file_typeid))
     BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_plists--;
-#endif
-  if (access_plistid > 0 && H5Pclose(access_plistid) < 0)
+  if (attid > 0 && H5Aclose(attid) < 0)
     BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_plists--;
-#endif
   if (spaceid > 0 && H5Sclose(spaceid) < 0)
     BAIL2(NC_EHDFERR);
 #ifdef EXTRA_TESTS
   num_spaces--;
 #endif
-  if (fillp)
-    {
-      if (var->type_info->nc_type_class == NC_VLEN)
-        nc_free_vlen((nc_vlen_t *)fillp);
-      else if (var->type_info->nc_type_class == NC_STRING && *(char **)fillp)
-        free(*(char **)fillp);
-      free(fillp);
-    }
-
   return retval;
 }
 
-/* Adjust the chunk cache of a var for better performance. */
-int
-nc4_adjust_var_cache(NC_GRP_INFO_T *grp, NC_VAR_INFO_T * var)
+/* Write all the dirty atts in an attlist. */
+static int
+write_attlist(NC_ATT_INFO_T *attlist, int varid, NC_GRP_INFO_T *grp)
 {
-  size_t chunk_size_bytes = 1;
-  int d;
+  NC_ATT_INFO_T *att;
   int retval;
 
-  /* Nothing to be done. */
-  if (var->contiguous)
-    return NC_NOERR;
-#ifdef USE_PARALLEL4
-  return NC_NOERR;
-#endif
-
-  /* How many bytes in the chunk? */
-  for (d = 0; d < var->ndims; d++)
-    chunk_size_bytes *= var->chunksizes[d];
-  if (var->type_info->size)
-    chunk_size_bytes *= var->type_info->size;
-  else
-    chunk_size_bytes *= sizeof(char *);
-
-  /* If the chunk cache is too small, and the user has not changed
-   * the default value of the chunk cache size, then increase the
-   * size of the cache. */
-  if (var->chunk_cache_size == CHUNK_CACHE_SIZE)
-    if (chunk_size_bytes > var->chunk_cache_size)
-      {
-        var->chunk_cache_size = chunk_size_bytes * DEFAULT_CHUNKS_IN_CACHE;
-        if (var->chunk_cache_size > MAX_DEFAULT_CACHE_SIZE)
-          var->chunk_cache_size = MAX_DEFAULT_CACHE_SIZE;
-        if ((retval = nc4_reopen_dataset(grp, var)))
-          return retval;
-      }
-
+  for (att = attlist; att; att = att->l.next)
+    {
+      if (att->dirty)
+        {
+          LOG((4, "%s: writing att %s to varid %d", __func__, att->name, varid));
+          if ((retval = put_att_grpa(grp, varid, att)))
+            return retval;
+          att->dirty = NC_FALSE;
+          att->created = NC_TRUE;
+        }
+    }
   return NC_NOERR;
 }
 
-/* Create a HDF5 defined type from a NC_TYPE_INFO_T struct, and commit
- * it to the file. */
+
+/* This function is a bit of a hack. Turns out that HDF5 dimension
+ * scales cannot themselves have scales attached. This leaves
+ * multidimensional coordinate variables hosed. So this function
+ * writes a special attribute for such a variable, which has the ids
+ * of all the dimensions for that coordinate variable. This sucks,
+ * really. But that's the way the cookie crumbles. Better luck next
+ * time. This function also contains a new way of dealing with HDF5
+ * error handling, abandoning the BAIL macros for a more organic and
+ * natural approach, made with whole grains, and locally-grown
+ * vegetables. */
 static int
-commit_type(NC_GRP_INFO_T *grp, NC_TYPE_INFO_T *type)
+write_coord_dimids(NC_VAR_INFO_T *var)
 {
-  int retval;
-
-  assert(grp && type);
+  hsize_t coords_len[1];
+  hid_t c_spaceid = -1, c_attid = -1;
+  int ret = 0;
 
-  /* Did we already record this type? */
-  if (type->committed)
-    return NC_NOERR;
+  /* Write our attribute. */
+  coords_len[0] = var->ndims;
+  if ((c_spaceid = H5Screate_simple(1, coords_len, coords_len)) < 0) ret++;
+#ifdef EXTRA_TESTS
+  num_spaces++;
+#endif
+  if (!ret && (c_attid = H5Acreate(var->hdf_datasetid, COORDINATES, H5T_NATIVE_INT,
+                                   c_spaceid, H5P_DEFAULT)) < 0) ret++;
+  if (!ret && H5Awrite(c_attid, H5T_NATIVE_INT, var->dimids) < 0) ret++;
 
-  /* Is this a compound type? */
-  if (type->nc_type_class == NC_COMPOUND)
-    {
-      NC_FIELD_INFO_T *field;
-      hid_t hdf_base_typeid, hdf_typeid;
-
-      if ((type->hdf_typeid = H5Tcreate(H5T_COMPOUND, type->size)) < 0)
-        return NC_EHDFERR;
-      LOG((4, "creating compound type %s hdf_typeid 0x%x", type->name,
-           type->hdf_typeid));
-
-      for (field = type->u.c.field; field; field = field->l.next)
-        {
-          if ((retval = nc4_get_hdf_typeid(grp->nc4_info, field->nc_typeid,
-                                           &hdf_base_typeid, type->endianness)))
-            return retval;
-
-          /* If this is an array, create a special array type. */
-          if (field->ndims)
-            {
-              int d;
-              hsize_t dims[NC_MAX_VAR_DIMS];
-
-              for (d = 0; d < field->ndims; d++)
-                dims[d] = field->dim_size[d];
-              if ((hdf_typeid = H5Tarray_create(hdf_base_typeid, field->ndims,
-                                                dims, NULL)) < 0)
-                {
-                  if (H5Tclose(hdf_base_typeid) < 0)
-                    return NC_EHDFERR;
-                  return NC_EHDFERR;
-                }
-              if (H5Tclose(hdf_base_typeid) < 0)
-                return NC_EHDFERR;
-            }
-          else
-            hdf_typeid = hdf_base_typeid;
-          LOG((4, "inserting field %s offset %d hdf_typeid 0x%x", field->name,
-               field->offset, hdf_typeid));
-          if (H5Tinsert(type->hdf_typeid, field->name, field->offset,
-                        hdf_typeid) < 0)
-            return NC_EHDFERR;
-          if (H5Tclose(hdf_typeid) < 0)
-            return NC_EHDFERR;
-        }
-    }
-  else if (type->nc_type_class == NC_VLEN)
-    {
-      /* Find the HDF typeid of the base type of this vlen. */
-      if ((retval = nc4_get_hdf_typeid(grp->nc4_info, type->u.v.base_nc_typeid,
-                                       &type->u.v.base_hdf_typeid, type->endianness)))
-        return retval;
-
-      /* Create a vlen type. */
-      if ((type->hdf_typeid = H5Tvlen_create(type->u.v.base_hdf_typeid)) < 0)
-        return NC_EHDFERR;
-    }
-  else if (type->nc_type_class == NC_OPAQUE)
-    {
-      /* Create the opaque type. */
-      if ((type->hdf_typeid = H5Tcreate(H5T_OPAQUE, type->size)) < 0)
-        return NC_EHDFERR;
-    }
-  else if (type->nc_type_class == NC_ENUM)
-    {
-      NC_ENUM_MEMBER_INFO_T *enum_m;
-
-      if (!type->u.e.enum_member)
-        return NC_EINVAL;
+  /* Close up shop. */
+  if (c_spaceid > 0 && H5Sclose(c_spaceid) < 0) ret++;
+#ifdef EXTRA_TESTS
+  num_spaces--;
+#endif
+  if (c_attid > 0 && H5Aclose(c_attid) < 0) ret++;
+  return ret ? NC_EHDFERR : 0;
+}
 
-      /* Find the HDF typeid of the base type of this enum. */
-      if ((retval = nc4_get_hdf_typeid(grp->nc4_info, type->u.e.base_nc_typeid,
-                                       &type->u.e.base_hdf_typeid, type->endianness)))
-        return retval;
+/* Write a special attribute for the netCDF-4 dimension ID. */
+static int
+write_netcdf4_dimid(hid_t datasetid, int dimid)
+{
+  hid_t dimid_spaceid, dimid_attid;
+  htri_t attr_exists;
 
-      /* Create an enum type. */
-      if ((type->hdf_typeid =  H5Tenum_create(type->u.e.base_hdf_typeid)) < 0)
-        return NC_EHDFERR;
+  /* Create the space. */
+  if ((dimid_spaceid = H5Screate(H5S_SCALAR)) < 0)
+    return NC_EHDFERR;
+#ifdef EXTRA_TESTS
+  num_spaces++;
+#endif
 
-      /* Add all the members to the HDF5 type. */
-      for (enum_m = type->u.e.enum_member; enum_m; enum_m = enum_m->l.next)
-        if (H5Tenum_insert(type->hdf_typeid, enum_m->name, enum_m->value) < 0)
-          return NC_EHDFERR;
-    }
+  /* Does the attribute already exist? If so, don't try to create it. */
+  if ((attr_exists = H5Aexists(datasetid, NC_DIMID_ATT_NAME)) < 0)
+    return NC_EHDFERR;
+  if (attr_exists)
+    dimid_attid = H5Aopen_by_name(datasetid, ".", NC_DIMID_ATT_NAME,
+                                  H5P_DEFAULT, H5P_DEFAULT);
   else
-    {
-      LOG((0, "Unknown class: %d", type->nc_type_class));
-      return NC_EBADTYPE;
-    }
+    /* Create the attribute if needed. */
+    dimid_attid = H5Acreate(datasetid, NC_DIMID_ATT_NAME,
+                            H5T_NATIVE_INT, dimid_spaceid, H5P_DEFAULT);
+  if (dimid_attid  < 0)
+    return NC_EHDFERR;
 
-  /* Commit the type. */
-  if (H5Tcommit(grp->hdf_grpid, type->name, type->hdf_typeid) < 0)
+
+  /* Write it. */
+  LOG((4, "%s: writing secret dimid %d", __func__, dimid));
+  if (H5Awrite(dimid_attid, H5T_NATIVE_INT, &dimid) < 0)
     return NC_EHDFERR;
-  type->committed = NC_TRUE;
-  LOG((4, "just committed type %s, HDF typeid: 0x%x", type->name,
-       type->hdf_typeid));
 
-  /* Later we will always use the native typeid. In this case, it is
-   * a copy of the same type pointed to by hdf_typeid, but it's
-   * easier to maintain a copy. */
-  if ((type->native_hdf_typeid = H5Tget_native_type(type->hdf_typeid,
-                                                    H5T_DIR_DEFAULT)) < 0)
+  /* Close stuff*/
+  if (H5Sclose(dimid_spaceid) < 0)
+    return NC_EHDFERR;
+#ifdef EXTRA_TESTS
+  num_spaces--;
+#endif
+  if (H5Aclose(dimid_attid) < 0)
     return NC_EHDFERR;
 
   return NC_NOERR;
 }
 
-/* Write an attribute, with value 1, to indicate that strict NC3 rules
- * apply to this file. */
+/* This function creates the HDF5 dataset for a variable. */
 static int
-write_nc3_strict_att(hid_t hdf_grpid)
+var_create_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var)
 {
-  hid_t attid = 0, spaceid = 0;
-  int one = 1, num, a;
-  char att_name[NC_MAX_NAME + 1];
+  NC_GRP_INFO_T *g;
+  hid_t plistid = 0, access_plistid = 0, typeid = 0, spaceid = 0;
+  hsize_t chunksize[H5S_MAX_RANK], dimsize[H5S_MAX_RANK], maxdimsize[H5S_MAX_RANK];
+  int d;
+  void *fillp = NULL;
+  NC_DIM_INFO_T *dim = NULL;
+  int dims_found = 0;
+  char *name_to_use;
   int retval = NC_NOERR;
 
-  /* If the attribute already exists, call that a success and return
-   * NC_NOERR. */
-  if ((num = H5Aget_num_attrs(hdf_grpid)) < 0)
-    return NC_EHDFERR;
-  for (a = 0; a < num; a++)
-    {
-      if ((attid = H5Aopen_idx(hdf_grpid, (unsigned int)a)) < 0)
-        BAIL(NC_EHDFERR);
-      if (H5Aget_name(attid, NC_MAX_HDF5_NAME, att_name) < 0)
-        BAIL(NC_EHDFERR);
-      if (H5Aclose(attid) < 0)
-            return NC_EFILEMETA;
-      if (strcmp(att_name, NC3_STRICT_ATT_NAME)==0)
-        {
-          return NC_NOERR;
-        }
-    }
+  LOG((3, "%s:: name %s", __func__, var->name));
 
-  /* Create the attribute to mark this as a file that needs to obey
-   * strict netcdf-3 rules. */
-  if ((spaceid = H5Screate(H5S_SCALAR)) < 0)
-    BAIL(NC_EFILEMETA);
+  /* Scalar or not, we need a creation property list. */
+  if ((plistid = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+    BAIL(NC_EHDFERR);
 #ifdef EXTRA_TESTS
-  num_spaces++;
+  num_plists++;
 #endif
-  if ((attid = H5Acreate(hdf_grpid, NC3_STRICT_ATT_NAME,
-                         H5T_NATIVE_INT, spaceid, H5P_DEFAULT)) < 0)
-    BAIL(NC_EFILEMETA);
-  if (H5Awrite(attid, H5T_NATIVE_INT, &one) < 0)
-    BAIL(NC_EFILEMETA);
-
- exit:
-  if (spaceid && (H5Sclose(spaceid) < 0))
-    BAIL2(NC_EFILEMETA);
+  if ((access_plistid = H5Pcreate(H5P_DATASET_ACCESS)) < 0)
+    BAIL(NC_EHDFERR);
 #ifdef EXTRA_TESTS
-  num_spaces--;
+  num_plists++;
 #endif
-  if (attid && (H5Aclose(attid) < 0))
-    BAIL2(NC_EFILEMETA);
-  return retval;
-}
 
-static int
-create_group(NC_GRP_INFO_T *grp)
-{
-  hid_t gcpl_id = 0;
-  int retval = NC_NOERR;;
+  /* RJ: this suppose to be FALSE that is defined in H5 private.h as 0 */
+  if (H5Pset_obj_track_times(plistid,0)<0)
+    BAIL(NC_EHDFERR);
 
-  assert(grp);
+  /* Find the HDF5 type of the dataset. */
+  if ((retval = nc4_get_hdf_typeid(grp->nc4_info, var->type_info->nc_typeid, &typeid,
+                                   var->type_info->endianness)))
+    BAIL(retval);
 
-  /* If this is not the root group, create it in the HDF5 file. */
-  if (grp->parent)
+  /* Figure out what fill value to set, if any. */
+  if (var->no_fill)
     {
-      /* Create group, with link_creation_order set in the group
-       * creation property list. */
-      if ((gcpl_id = H5Pcreate(H5P_GROUP_CREATE)) < 0)
-        return NC_EHDFERR;
-#ifdef EXTRA_TESTS
-      num_plists++;
-#endif
-
-      /* RJ: this suppose to be FALSE that is defined in H5 private.h as 0 */
-      if (H5Pset_obj_track_times(gcpl_id,0)<0)
-        BAIL(NC_EHDFERR);
-
-      if (H5Pset_link_creation_order(gcpl_id, H5P_CRT_ORDER_TRACKED|H5P_CRT_ORDER_INDEXED) < 0)
-        BAIL(NC_EHDFERR);
-      if (H5Pset_attr_creation_order(gcpl_id, H5P_CRT_ORDER_TRACKED|H5P_CRT_ORDER_INDEXED) < 0)
-        BAIL(NC_EHDFERR);
-      if ((grp->hdf_grpid = H5Gcreate2(grp->parent->hdf_grpid, grp->name,
-                                       H5P_DEFAULT, gcpl_id, H5P_DEFAULT)) < 0)
-        BAIL(NC_EHDFERR);
-      if (H5Pclose(gcpl_id) < 0)
+      /* Required to truly turn HDF5 fill values off */
+      if (H5Pset_fill_time(plistid, H5D_FILL_TIME_NEVER) < 0)
         BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_plists--;
-#endif
     }
   else
     {
-      /* Since this is the root group, we have to open it. */
-      if ((grp->hdf_grpid = H5Gopen2(grp->nc4_info->hdfid, "/", H5P_DEFAULT)) < 0)
-        BAIL(NC_EFILEMETA);
-    }
-  return NC_NOERR;
-
- exit:
-  if (gcpl_id > 0 && H5Pclose(gcpl_id) < 0)
-    BAIL2(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-  num_plists--;
-#endif
-  if (grp->hdf_grpid > 0 && H5Gclose(grp->hdf_grpid) < 0)
-    BAIL2(NC_EHDFERR);
-  return retval;
-}
+      if ((retval = get_fill_value(grp->nc4_info, var, &fillp)))
+        BAIL(retval);
 
-/* After all the datasets of the file have been read, it's time to
- * sort the wheat from the chaff. Which of the datasets are netCDF
- * dimensions, and which are coordinate variables, and which are
- * non-coordinate variables. */
-static int
-attach_dimscales(NC_GRP_INFO_T *grp)
-{
-  NC_VAR_INFO_T *var;
-  NC_DIM_INFO_T *dim1;
-  NC_GRP_INFO_T *g;
-  int d;
-  int retval = NC_NOERR;
-
-  /* Attach dimension scales. */
-  for (var = grp->var; var; var = var->l.next)
-    {
-      /* Scales themselves do not attach. But I really wish they
-       * would. */
-      if (var->dimscale)
-        {
-          /* If this is a multidimensional coordinate variable, it will
-           * have a special coords attribute (read earlier) with a list
-           * of the dimensions for this variable. */
-        }
-      else /* not a dimscale... */
+      /* If there is a fill value, set it. */
+      if (fillp)
         {
-          /* Find the scale for each dimension and attach it. */
-          for (d = 0; d < var->ndims; d++)
+          if (var->type_info->nc_type_class == NC_STRING)
             {
-              /* Is there a dimscale for this dimension? */
-              if (var->dimscale_attached)
-                {
-                  if (!var->dimscale_attached[d])
-                    {
-                      hid_t dim_datasetid;  /* Dataset ID for dimension */
-                      dim1 = var->dim[d];
-		      assert(dim1 && dim1->dimid == var->dimids[d]);
-
-                      LOG((2, "%s: attaching scale for dimid %d to var %s",
-                           __func__, var->dimids[d], var->name));
-
-                      /* Find dataset ID for dimension */
-                      if (dim1->coord_var)
-                        dim_datasetid = dim1->coord_var->hdf_datasetid;
-                      else
-                        dim_datasetid = dim1->hdf_dimscaleid;
-                      assert(dim_datasetid > 0);
-                      if (H5DSattach_scale(var->hdf_datasetid, dim_datasetid, d) < 0)
-                        BAIL(NC_EHDFERR);
-                      var->dimscale_attached[d] = NC_TRUE;
-                    }
+              if (H5Pset_fill_value(plistid, typeid, fillp) < 0)
+                BAIL(NC_EHDFERR);
+            }
+          else
+            {
+              /* The fill value set in HDF5 must always be presented as
+               * a native type, even if the endianness for this dataset
+               * is non-native. HDF5 will translate the fill value to
+               * the target endiannesss. */
+              hid_t fill_typeid = 0;
 
-		  /* If we didn't find a dimscale to attach, that's a problem! */
-		  if (!var->dimscale_attached[d])
-		    {
-		      LOG((0, "no dimscale found!"));
-		      return NC_EDIMSCALE;
-		    }
+              if ((retval = nc4_get_hdf_typeid(grp->nc4_info, var->type_info->nc_typeid, &fill_typeid,
+                                               NC_ENDIAN_NATIVE)))
+                BAIL(retval);
+              if (H5Pset_fill_value(plistid, fill_typeid, fillp) < 0)
+                {
+                  if (H5Tclose(fill_typeid) < 0)
+                    BAIL(NC_EHDFERR);
+                  BAIL(NC_EHDFERR);
                 }
+              if (H5Tclose(fill_typeid) < 0)
+                BAIL(NC_EHDFERR);
             }
         }
     }
 
- exit:
-  return retval;
-}
-
-static int
-var_exists(hid_t grpid, char *name, nc_bool_t *exists)
-{
-  htri_t link_exists;
-
-  /* Reset the boolean */
-  *exists = NC_FALSE;
-
-  /* Check if the object name exists in the group */
-  if ((link_exists = H5Lexists(grpid, name, H5P_DEFAULT)) < 0)
-    return NC_EHDFERR;
-  if (link_exists)
-    {
-      H5G_stat_t statbuf;
-
-      /* Get info about the object */
-      if (H5Gget_objinfo(grpid, name, 1, &statbuf) < 0)
-        return NC_EHDFERR;
-
-      if (H5G_DATASET == statbuf.type)
-        *exists = NC_TRUE;
-    }
+  /* If the user wants to shuffle the data, set that up now. */
+  if (var->shuffle)
+    if (H5Pset_shuffle(plistid) < 0)
+      BAIL(NC_EHDFERR);
 
-  return NC_NOERR;
-}
+  /* Any other filter goes between shuffle and deflate. */
+  if (var->filterid)
+    if (H5Pset_filter(plistid, (H5Z_filter_t)var->filterid, H5Z_FLAG_MANDATORY,
+                      var->nparams, var->params) < 0)
+      BAIL(NC_EFILTER);
 
-/* This function writes a variable. The principle difficulty comes
- * from the possibility that this is a coordinate variable, and was
- * already written to the file as a dimension-only dimscale. If this
- * occurs, then it must be deleted and recreated. */
-static int
-write_var(NC_VAR_INFO_T *var, NC_GRP_INFO_T *grp, nc_bool_t write_dimid)
-{
-  nc_bool_t replace_existing_var = NC_FALSE;
-  int retval;
+  /* If the user wants to deflate the data, set that up now. */
+  if (var->deflate)
+    if (H5Pset_deflate(plistid, var->deflate_level) < 0)
+      BAIL(NC_EHDFERR);
 
-  LOG((4, "%s: writing var %s", __func__, var->name));
+  /* Szip? NO! We don't want anyone to produce szipped netCDF files! */
+  /* #ifdef USE_SZIP */
+  /*    if (var->options_mask) */
+  /*       if (H5Pset_szip(plistid, var->options_mask, var->bits_per_pixel) < 0) */
+  /*          BAIL(NC_EHDFERR); */
+  /* #endif */
 
-  /* If the variable has already been created & the fill value changed,
-   * indicate that the existing variable should be replaced. */
-  if (var->created && var->fill_val_changed)
-    {
-      replace_existing_var = NC_TRUE;
-      var->fill_val_changed = NC_FALSE;
-    }
+  /* If the user wants to fletcher error correcton, set that up now. */
+  if (var->fletcher32)
+    if (H5Pset_fletcher32(plistid) < 0)
+      BAIL(NC_EHDFERR);
 
-  /* Is this a coordinate var that has already been created in
-   * the HDF5 file as a dimscale dataset? Check for dims with the
-   * same name in this group. If there is one, check to see if
-   * this object exists in the HDF group. */
-  if (var->became_coord_var)
+  /* If ndims non-zero, get info for all dimensions. We look up the
+     dimids and get the len of each dimension. We need this to create
+     the space for the dataset. In netCDF a dimension length of zero
+     means an unlimited dimension. */
+  if (var->ndims)
     {
-      NC_DIM_INFO_T *d1;
-
-      for (d1 = grp->dim; d1; d1 = d1->l.next)
-        if (!strcmp(d1->name, var->name))
-          {
-            nc_bool_t exists;
+      int unlimdim = 0;
 
-            if ((retval = var_exists(grp->hdf_grpid, var->name, &exists)))
-              return retval;
-            if (exists)
-              {
-                /* Indicate that the variable already exists, and should be replaced */
-                replace_existing_var = NC_TRUE;
-                break;
-              }
-          }
-    }
+      /* Check to see if any unlimited dimensions are used in this var. */
+      for (d = 0; d < var->ndims; d++) {
+	dim = var->dim[d];
+	assert(dim && dim->dimid == var->dimids[d]);
+	if (dim->unlimited)
+	  unlimdim++;
+      }
 
-  /* Check dims if the variable will be replaced, so that the dimensions
-   * will be de-attached and re-attached correctly. */
-  /* (Note: There's a temptation to merge this loop over the dimensions with
-   *        the prior loop over dimensions, but that blurs the line over the
-   *        purpose of them, so they are currently separate.  If performance
-   *        becomes an issue here, it would be possible to merge them. -QAK)
-   */
-  if (replace_existing_var)
-    {
-      NC_DIM_INFO_T *d1;
+      /* If there are no unlimited dims, and no filters, and the user
+       * has not specified chunksizes, use contiguous variable for
+       * better performance. */
 
-      for (d1 = grp->dim; d1; d1 = d1->l.next)
-        if (!strcmp(d1->name, var->name))
-          {
-            nc_bool_t exists;
+      if(!var->shuffle && !var->deflate && !var->options_mask &&
+         !var->fletcher32 && (var->chunksizes == NULL || !var->chunksizes[0])) {
+#ifdef USE_HDF4
+        NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
+        if(h5->hdf4 || !unlimdim)
+#else
+          if(!unlimdim)
+#endif
+            var->contiguous = NC_TRUE;
+      }
 
-            if ((retval = var_exists(grp->hdf_grpid, var->name, &exists)))
-              return retval;
-            if (exists)
+      /* Gather current & maximum dimension sizes, along with chunk sizes */
+      for (d = 0; d < var->ndims; d++)
+        {
+          dim = var->dim[d];
+	  assert(dim && dim->dimid == var->dimids[d]);
+          dimsize[d] = dim->unlimited ? NC_HDF5_UNLIMITED_DIMSIZE : dim->len;
+          maxdimsize[d] = dim->unlimited ? H5S_UNLIMITED : (hsize_t)dim->len;
+          if (!var->contiguous) {
+            if (var->chunksizes[d])
+              chunksize[d] = var->chunksizes[d];
+            else
               {
-                hid_t dim_datasetid;  /* Dataset ID for dimension */
+                size_t type_size;
+                if (var->type_info->nc_type_class == NC_STRING)
+                  type_size = sizeof(char *);
+                else
+                  type_size = var->type_info->size;
 
-                /* Find dataset ID for dimension */
-                if (d1->coord_var)
-                  dim_datasetid = d1->coord_var->hdf_datasetid;
+                /* Unlimited dim always gets chunksize of 1. */
+                if (dim->unlimited)
+                  chunksize[d] = 1;
                 else
-                  dim_datasetid = d1->hdf_dimscaleid;
-                assert(dim_datasetid > 0);
+                  chunksize[d] = pow((double)DEFAULT_CHUNK_SIZE/type_size,
+                                     1/(double)(var->ndims - unlimdim));
 
-                /* If we're replacing an existing dimscale dataset, go to
-                 * every var in the file and detach this dimension scale,
-                 * because we have to delete it. */
-                if ((retval = rec_detach_scales(grp->nc4_info->root_grp,
-                                                var->dimids[0], dim_datasetid)))
-                  return retval;
-                break;
+                /* If the chunksize is greater than the dim
+                 * length, make it the dim length. */
+                if (!dim->unlimited && chunksize[d] > dim->len)
+                  chunksize[d] = dim->len;
+
+                /* Remember the computed chunksize */
+                var->chunksizes[d] = chunksize[d];
               }
           }
-    }
+        }
 
-  /* If this is not a dimension scale, do this stuff. */
-  if (var->was_coord_var && var->dimscale_attached)
-    {
-      /* If the variable already exists in the file, Remove any dimension scale
-       * attributes from it, if they exist. */
-      /* (The HDF5 Dimension Scale API should really have an API routine
-       * for making a dataset not a scale. -QAK) */
-      if (var->created)
+      if (var->contiguous)
         {
-          htri_t attr_exists;
-
-          /* (We could do a better job here and verify that the attributes are
-           * really dimension scale 'CLASS' & 'NAME' attributes, but that would be
-           * poking about in the HDF5 DimScale internal data) */
-          if ((attr_exists = H5Aexists(var->hdf_datasetid, "CLASS")) < 0)
+          if (H5Pset_layout(plistid, H5D_CONTIGUOUS) < 0)
             BAIL(NC_EHDFERR);
-          if (attr_exists)
-            {
-              if (H5Adelete(var->hdf_datasetid, "CLASS") < 0)
-                BAIL(NC_EHDFERR);
-            }
-          if ((attr_exists = H5Aexists(var->hdf_datasetid, "NAME")) < 0)
+        }
+      else
+        {
+          if (H5Pset_chunk(plistid, var->ndims, chunksize) < 0)
             BAIL(NC_EHDFERR);
-          if (attr_exists)
-            {
-              if (H5Adelete(var->hdf_datasetid, "NAME") < 0)
-                BAIL(NC_EHDFERR);
-            }
         }
 
-      if (var->dimscale_attached)
-        {
-          int d;
+      /* Create the dataspace. */
+      if ((spaceid = H5Screate_simple(var->ndims, dimsize, maxdimsize)) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_spaces++;
+#endif
+    }
+  else
+    {
+      if ((spaceid = H5Screate(H5S_SCALAR)) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_spaces++;
+#endif
+    }
 
-          /* If this is a regular var, detach all its dim scales. */
-          for (d = 0; d < var->ndims; d++)
-            if (var->dimscale_attached[d])
-              {
-                hid_t dim_datasetid;  /* Dataset ID for dimension */
-                NC_DIM_INFO_T *dim1 = var->dim[d];
-		assert(dim1 && dim1->dimid == var->dimids[d]);
+  /* Turn on creation order tracking. */
+  if (H5Pset_attr_creation_order(plistid, H5P_CRT_ORDER_TRACKED|
+                                 H5P_CRT_ORDER_INDEXED) < 0)
+    BAIL(NC_EHDFERR);
 
-                /* Find dataset ID for dimension */
-                if (dim1->coord_var)
-                  dim_datasetid = dim1->coord_var->hdf_datasetid;
-                else
-                  dim_datasetid = dim1->hdf_dimscaleid;
-                assert(dim_datasetid > 0);
+  /* Set per-var chunk cache within the memory budget, even if the
+   * budget grants none, so the dataset never gets the file's default
+   * cache, which is not charged. */
+  nc4_charge_chunk_cache(var);
+  if (H5Pset_chunk_cache(access_plistid, var->chunk_cache_nelems,
+                         var->chunk_cache_charged, var->chunk_cache_preemption) < 0)
+    BAIL(NC_EHDFERR);
 
-                if (H5DSdetach_scale(var->hdf_datasetid, dim_datasetid, d) < 0)
-                  BAIL(NC_EHDFERR);
-                var->dimscale_attached[d] = NC_FALSE;
-              }
-        }
+  /* At long last, create the dataset. */
+  name_to_use = var->hdf5_name ? var->hdf5_name : var->name;
+  LOG((4, "%s: about to H5Dcreate2 dataset %s of type 0x%x", __func__,
+       name_to_use, typeid));
+  if ((var->hdf_datasetid = H5Dcreate2(grp->hdf_grpid, name_to_use, typeid,
+                                       spaceid, H5P_DEFAULT, plistid, access_plistid)) < 0)
+    BAIL(NC_EHDFERR);
+  var->created = NC_TRUE;
+  var->is_new_var = NC_FALSE;
+  if (var->logical_dims)
+    {
+      free(var->logical_dims);
+      var->logical_dims = NULL;
     }
+  var->overallocated = NC_FALSE;
+  nc4_release_file_space(var);
+  nc4_point_cache_drop_var(grp->nc4_info, var);
 
-  /* Delete the HDF5 dataset that is to be replaced. */
-  if (replace_existing_var)
+  /* If this is a dimscale, mark it as such in the HDF5 file. Also
+   * find the dimension info and store the dataset id of the dimscale
+   * dataset. */
+  if (var->dimscale)
     {
-      /* Free the HDF5 dataset id. */
-      if (var->hdf_datasetid && H5Dclose(var->hdf_datasetid) < 0)
+      if (H5DSset_scale(var->hdf_datasetid, var->name) < 0)
         BAIL(NC_EHDFERR);
-      var->hdf_datasetid = 0;
 
-      /* Now delete the variable. */
-      if (H5Gunlink(grp->hdf_grpid, var->name) < 0)
-        return NC_EDIMMETA;
-    }
+      /* If this is a multidimensional coordinate variable, write a
+       * coordinates attribute. */
+      if (var->ndims > 1)
+        if ((retval = write_coord_dimids(var)))
+          BAIL(retval);
 
-  /* Create the dataset. */
-  if (var->is_new_var || replace_existing_var)
-    {
-      if ((retval = var_create_dataset(grp, var, write_dimid)))
-        return retval;
+      /* Write the netCDF dimid, so that the dimids in the coordinates
+       * attributes of other vars can be trusted when the file is
+       * read. */
+      if ((retval = write_netcdf4_dimid(var->hdf_datasetid, var->dimids[0])))
+        BAIL(retval);
     }
-  else
+  /* Write the dimids of other vars in a coordinates attribute too, so
+   * that reading the file need not iterate through the dimscales
+   * attached to each one. */
+  else if (var->ndims)
     {
-      if (write_dimid && var->ndims)
-        if ((retval = write_netcdf4_dimid(var->hdf_datasetid, var->dimids[0])))
-          BAIL(retval);
+      if ((retval = write_coord_dimids(var)))
+        BAIL(retval);
     }
 
-  if (replace_existing_var)
-    {
-      /* If this is a dimension scale, reattach the scale everywhere it
-       * is used. (Recall that netCDF dimscales are always 1-D). */
-      if(var->dimscale)
-        {
-          if ((retval = rec_reattach_scales(grp->nc4_info->root_grp,
-                                            var->dimids[0], var->hdf_datasetid)))
-            return retval;
-        }
-      /* If it's not a dimension scale, clear the dimscale attached flags,
-       * so the dimensions are re-attached. */
-      else
-        {
-          if (var->dimscale_attached)
-            memset(var->dimscale_attached, 0, sizeof(nc_bool_t) * var->ndims);
-        }
-    }
 
-  /* Clear coord. var state transition flags */
-  var->was_coord_var = NC_FALSE;
-  var->became_coord_var = NC_FALSE;
+  /* Write attributes for this var. */
+  if ((retval = write_attlist(var->att, var->varid, grp)))
+    BAIL(retval);
+  var->attr_dirty = NC_FALSE;
 
-  /* Now check the attributes for this var. */
-  if (var->attr_dirty)
+ exit:
+  if (typeid > 0 && H5Tclose(typeid) < 0)
+    BAIL2(NC_EHDFERR);
+  if (plistid > 0 && H5Pclose(plistid) < 0)
+    BAIL2(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+  num_plists--;
+#endif
+  if (access_plistid > 0 && H5Pclose(access_plistid) < 0)
+    BAIL2(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+  num_plists--;
+#endif
+  if (spaceid > 0 && H5Sclose(spaceid) < 0)
+    BAIL2(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+  num_spaces--;
+#endif
+  if (fillp)
     {
-      /* Write attributes for this var. */
-      if ((retval = write_attlist(var->att, var->varid, grp)))
-        BAIL(retval);
-      var->attr_dirty = NC_FALSE;
+      if (var->type_info->nc_type_class == NC_VLEN)
+        nc_free_vlen((nc_vlen_t *)fillp);
+      else if (var->type_info->nc_type_class == NC_STRING && *(char **)fillp)
+        free(*(char **)fillp);
+      free(fillp);
     }
 
-  return NC_NOERR;
- exit:
   return retval;
 }
 
-static int
-write_dim(NC_DIM_INFO_T *dim, NC_GRP_INFO_T *grp, nc_bool_t write_dimid)
+/* Adjust the chunk cache of a var for better performance. */
+int
+nc4_adjust_var_cache(NC_GRP_INFO_T *grp, NC_VAR_INFO_T * var)
 {
+  size_t chunk_size_bytes = 1;
+  int d;
   int retval;
 
-  /* If there's no dimscale dataset for this dim, create one,
-   * and mark that it should be hidden from netCDF as a
-   * variable. (That is, it should appear as a dimension
-   * without an associated variable.) */
-  if (0 == dim->hdf_dimscaleid)
-    {
-      hid_t spaceid, create_propid;
-      hsize_t dims[1], max_dims[1], chunk_dims[1] = {1};
-      char dimscale_wo_var[NC_MAX_NAME];
-
-      LOG((4, "%s: creating dim %s", __func__, dim->name));
+  /* Nothing to be done. */
+  if (var->contiguous)
+    return NC_NOERR;
+#ifdef USE_PARALLEL4
+  return NC_NOERR;
+#endif
 
-      /* Sanity check */
-      assert(NULL == dim->coord_var);
+  /* How many bytes in the chunk? */
+  for (d = 0; d < var->ndims; d++)
+    chunk_size_bytes *= var->chunksizes[d];
+  if (var->type_info->size)
+    chunk_size_bytes *= var->type_info->size;
+  else
+    chunk_size_bytes *= sizeof(char *);
 
-      /* Create a property list. If this dimension scale is
-       * unlimited (i.e. it's an unlimited dimension), then set
-       * up chunking, with a chunksize of 1. */
-      if ((create_propid = H5Pcreate(H5P_DATASET_CREATE)) < 0)
-        BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_plists++;
-#endif
+  /* If the chunk cache is too small, and the user has not changed
+   * the default value of the chunk cache size, then increase the
+   * size of the cache. */
+  if (var->chunk_cache_size == CHUNK_CACHE_SIZE)
+    if (chunk_size_bytes > var->chunk_cache_size)
+      {
+        var->chunk_cache_size = chunk_size_bytes * DEFAULT_CHUNKS_IN_CACHE;
+        if (var->chunk_cache_size > MAX_DEFAULT_CACHE_SIZE)
+          var->chunk_cache_size = MAX_DEFAULT_CACHE_SIZE;
+        if ((retval = nc4_reopen_dataset(grp, var)))
+          return retval;
+      }
 
-      /* RJ: this suppose to be FALSE that is defined in H5 private.h as 0 */
-      if (H5Pset_obj_track_times(create_propid,0)<0)
-        BAIL(NC_EHDFERR);
+  return NC_NOERR;
+}
 
-      dims[0] = dim->len;
-      max_dims[0] = dim->len;
-      if (dim->unlimited)
-        {
-          max_dims[0] = H5S_UNLIMITED;
-          if (H5Pset_chunk(create_propid, 1, chunk_dims) < 0)
-            BAIL(NC_EHDFERR);
-        }
+/* Create a HDF5 defined type from a NC_TYPE_INFO_T struct, and commit
+ * it to the file. */
+static int
+commit_type(NC_GRP_INFO_T *grp, NC_TYPE_INFO_T *type)
+{
+  int retval;
 
-      /* Set up space. */
-      if ((spaceid = H5Screate_simple(1, dims, max_dims)) < 0)
-        BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_spaces++;
-#endif
+  assert(grp && type);
 
-      if (H5Pset_attr_creation_order(create_propid, H5P_CRT_ORDER_TRACKED|
-                                     H5P_CRT_ORDER_INDEXED) < 0)
-        BAIL(NC_EHDFERR);
+  /* Did we already record this type? */
+  if (type->committed)
+    return NC_NOERR;
 
-      /* Create the dataset that will be the dimension scale. */
-      LOG((4, "%s: about to H5Dcreate1 a dimscale dataset %s", __func__, dim->name));
-      if ((dim->hdf_dimscaleid = H5Dcreate1(grp->hdf_grpid, dim->name, H5T_IEEE_F32BE,
-                                            spaceid, create_propid)) < 0)
-        BAIL(NC_EHDFERR);
+  /* Is this a compound type? */
+  if (type->nc_type_class == NC_COMPOUND)
+    {
+      NC_FIELD_INFO_T *field;
+      hid_t hdf_base_typeid, hdf_typeid;
 
-      /* Close the spaceid and create_propid. */
-      if (H5Sclose(spaceid) < 0)
-        BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_spaces--;
-#endif
-      if (H5Pclose(create_propid) < 0)
-        BAIL(NC_EHDFERR);
-#ifdef EXTRA_TESTS
-      num_plists--;
-#endif
+      if ((type->hdf_typeid = H5Tcreate(H5T_COMPOUND, type->size)) < 0)
+        return NC_EHDFERR;
+      LOG((4, "creating compound type %s hdf_typeid 0x%x", type->name,
+           type->hdf_typeid));
 
-      /* Indicate that this is a scale. Also indicate that not
-       * be shown to the user as a variable. It is hidden. It is
-       * a DIM WITHOUT A VARIABLE! */
-      sprintf(dimscale_wo_var, "%s%10d", DIM_WITHOUT_VARIABLE, (int)dim->len);
-      if (H5DSset_scale(dim->hdf_dimscaleid, dimscale_wo_var) < 0)
-        BAIL(NC_EHDFERR);
+      for (field = type->u.c.field; field; field = field->l.next)
+        {
+          if ((retval = nc4_get_hdf_typeid(grp->nc4_info, field->nc_typeid,
+                                           &hdf_base_typeid, type->endianness)))
+            return retval;
+
+          /* If this is an array, create a special array type. */
+          if (field->ndims)
+            {
+              int d;
+              hsize_t dims[NC_MAX_VAR_DIMS];
+
+              for (d = 0; d < field->ndims; d++)
+                dims[d] = field->dim_size[d];
+              if ((hdf_typeid = H5Tarray_create(hdf_base_typeid, field->ndims,
+                                                dims, NULL)) < 0)
+                {
+                  if (H5Tclose(hdf_base_typeid) < 0)
+                    return NC_EHDFERR;
+                  return NC_EHDFERR;
+                }
+              if (H5Tclose(hdf_base_typeid) < 0)
+                return NC_EHDFERR;
+            }
+          else
+            hdf_typeid = hdf_base_typeid;
+          LOG((4, "inserting field %s offset %d hdf_typeid 0x%x", field->name,
+               field->offset, hdf_typeid));
+          if (H5Tinsert(type->hdf_typeid, field->name, field->offset,
+                        hdf_typeid) < 0)
+            return NC_EHDFERR;
+          if (H5Tclose(hdf_typeid) < 0)
+            return NC_EHDFERR;
+        }
     }
+  else if (type->nc_type_class == NC_VLEN)
+    {
+      /* Find the HDF typeid of the base type of this vlen. */
+      if ((retval = nc4_get_hdf_typeid(grp->nc4_info, type->u.v.base_nc_typeid,
+                                       &type->u.v.base_hdf_typeid, type->endianness)))
+        return retval;
 
-  /* Did we extend an unlimited dimension? */
-  if (dim->extended)
+      /* Create a vlen type. */
+      if ((type->hdf_typeid = H5Tvlen_create(type->u.v.base_hdf_typeid)) < 0)
+        return NC_EHDFERR;
+    }
+  else if (type->nc_type_class == NC_OPAQUE)
     {
-      NC_VAR_INFO_T *v1;
+      /* Create the opaque type. */
+      if ((type->hdf_typeid = H5Tcreate(H5T_OPAQUE, type->size)) < 0)
+        return NC_EHDFERR;
+    }
+  else if (type->nc_type_class == NC_ENUM)
+    {
+      NC_ENUM_MEMBER_INFO_T *enum_m;
 
-      assert(dim->unlimited);
-      /* If this is a dimension without a variable, then update
-       * the secret length information at the end of the NAME
-       * attribute. */
-      for (v1 = grp->var; v1; v1 = v1->l.next)
-        if (!strcmp(v1->name, dim->name))
-          break;
+      if (!type->u.e.enum_member)
+        return NC_EINVAL;
 
-      if (v1)
-        {
-          hsize_t *new_size = NULL;
-          NC_DIM_INFO_T *dim1;
-          int d1;
+      /* Find the HDF typeid of the base type of this enum. */
+      if ((retval = nc4_get_hdf_typeid(grp->nc4_info, type->u.e.base_nc_typeid,
+                                       &type->u.e.base_hdf_typeid, type->endianness)))
+        return retval;
 
-          /* Extend the dimension scale dataset to reflect the new
-           * length of the dimension. */
-          if (!(new_size = malloc(v1->ndims * sizeof(hsize_t))))
-            BAIL(NC_ENOMEM);
-          for (d1 = 0; d1 < v1->ndims; d1++)
-            {
-	      assert(v1->dim[d1] && v1->dim[d1]->dimid == v1->dimids[d1]);
-	      new_size[d1] = v1->dim[d1]->len;
-            }
-          if (H5Dset_extent(v1->hdf_datasetid, new_size) < 0) {
-            free(new_size);
-            BAIL(NC_EHDFERR);
-          }
-          free(new_size);
-        }
+      /* Create an enum type. */
+      if ((type->hdf_typeid =  H5Tenum_create(type->u.e.base_hdf_typeid)) < 0)
+        return NC_EHDFERR;
+
+      /* Add all the members to the HDF5 type. */
+      for (enum_m = type->u.e.enum_member; enum_m; enum_m = enum_m->l.next)
+        if (H5Tenum_insert(type->hdf_typeid, enum_m->name, enum_m->value) < 0)
+          return NC_EHDFERR;
+    }
+  else
+    {
+      LOG((0, "Unknown class: %d", type->nc_type_class));
+      return NC_EBADTYPE;
     }
 
-  /* If desired, write the secret dimid. This will be used instead of
-   * the dimid that the dimension would otherwise receive based on
-   * creation order. This can be necessary when dims and their
-   * coordinate variables were created in different order. */
-  if (write_dimid && dim->hdf_dimscaleid)
-    if ((retval = write_netcdf4_dimid(dim->hdf_dimscaleid, dim->dimid)))
-      BAIL(retval);
+  /* Commit the type. */
+  if (H5Tcommit(grp->hdf_grpid, type->name, type->hdf_typeid) < 0)
+    return NC_EHDFERR;
+  type->committed = NC_TRUE;
+  LOG((4, "just committed type %s, HDF typeid: 0x%x", type->name,
+       type->hdf_typeid));
 
-  return NC_NOERR;
- exit:
+  /* Later we will always use the native typeid. In this case, it is
+   * a copy of the same type pointed to by hdf_typeid, but it's
+   * easier to maintain a copy. */
+  if ((type->native_hdf_typeid = H5Tget_native_type(type->hdf_typeid,
+                                                    H5T_DIR_DEFAULT)) < 0)
+    return NC_EHDFERR;
 
-  return retval;
+  return NC_NOERR;
 }
 
-/* Recursively determine if there is a mismatch between order of
- * coordinate creation and associated dimensions in this group or any
- * subgroups, to find out if we have to handle that situation.  Also
- * check if there are any multidimensional coordinate variables
- * defined, which require the same treatment to fix a potential bug
- * when such variables occur in subgroups. */
-int
-nc4_rec_detect_need_to_preserve_dimids(NC_GRP_INFO_T *grp, nc_bool_t *bad_coord_orderp)
+/* Write an attribute, with value 1, to indicate that strict NC3 rules
+ * apply to this file. */
+static int
+write_nc3_strict_att(hid_t hdf_grpid)
 {
-  NC_VAR_INFO_T *var;
-  NC_GRP_INFO_T *child_grp;
-  int last_dimid = -1;
-  int retval;
+  hid_t attid = 0, spaceid = 0;
+  int one = 1, num, a;
+  char att_name[NC_MAX_NAME + 1];
+  int retval = NC_NOERR;
 
-  /* Iterate over variables in this group */
-  for (var = grp->var; var; var = var->l.next)
+  /* If the attribute already exists, call that a success and return
+   * NC_NOERR. */
+  if ((num = H5Aget_num_attrs(hdf_grpid)) < 0)
+    return NC_EHDFERR;
+  for (a = 0; a < num; a++)
     {
-      /* Only matters for dimension scale variables, with non-scalar dimensionality */
-      if (var->dimscale && var->ndims)
+      if ((attid = H5Aopen_idx(hdf_grpid, (unsigned int)a)) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Aget_name(attid, NC_MAX_HDF5_NAME, att_name) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Aclose(attid) < 0)
+            return NC_EFILEMETA;
+      if (strcmp(att_name, NC3_STRICT_ATT_NAME)==0)
         {
-          /* If the user writes coord vars in a different order then he
-           * defined their dimensions, then, when the file is reopened, the
-           * order of the dimids will change to match the order of the coord
-           * vars. Detect if this is about to happen. */
-          if (var->dimids[0] < last_dimid)
-            {
-              LOG((5, "%s: %s is out of order coord var", __func__, var->name));
-              *bad_coord_orderp = NC_TRUE;
-              return NC_NOERR;
-            }
-          last_dimid = var->dimids[0];
-
-          /* If there are multidimensional coordinate variables defined, then
-           * it's also necessary to preserve dimension IDs when the file is
-           * reopened ... */
-          if (var->ndims > 1)
-            {
-              LOG((5, "%s: %s is multidimensional coord var", __func__, var->name));
-              *bad_coord_orderp = NC_TRUE;
-              return NC_NOERR;
-            }
-
-          /* Did the user define a dimension, end define mode, reenter define
-           * mode, and then define a coordinate variable for that dimension?
-           * If so, dimensions will be out of order. */
-          if (var->is_new_var || var->became_coord_var)
-            {
-              LOG((5, "%s: coord var defined after enddef/redef", __func__));
-              *bad_coord_orderp = NC_TRUE;
-              return NC_NOERR;
-            }
+          return NC_NOERR;
         }
     }
 
-  /* If there are any child groups, check them also for this condition. */
-  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
-    if ((retval = nc4_rec_detect_need_to_preserve_dimids(child_grp, bad_coord_orderp)))
-      return retval;
+  /* Create the attribute to mark this as a file that needs to obey
+   * strict netcdf-3 rules. */
+  if ((spaceid = H5Screate(H5S_SCALAR)) < 0)
+    BAIL(NC_EFILEMETA);
+#ifdef EXTRA_TESTS
+  num_spaces++;
+#endif
+  if ((attid = H5Acreate(hdf_grpid, NC3_STRICT_ATT_NAME,
+                         H5T_NATIVE_INT, spaceid, H5P_DEFAULT)) < 0)
+    BAIL(NC_EFILEMETA);
+  if (H5Awrite(attid, H5T_NATIVE_INT, &one) < 0)
+    BAIL(NC_EFILEMETA);
 
-  return NC_NOERR;
+ exit:
+  if (spaceid && (H5Sclose(spaceid) < 0))
+    BAIL2(NC_EFILEMETA);
+#ifdef EXTRA_TESTS
+  num_spaces--;
+#endif
+  if (attid && (H5Aclose(attid) < 0))
+    BAIL2(NC_EFILEMETA);
+  return retval;
 }
 
-
-/* Recursively write all the metadata in a group. Groups and types
- * have all already been written.  Propagate bad cooordinate order to
- * subgroups, if detected. */
-int
-nc4_rec_write_metadata(NC_GRP_INFO_T *grp, nc_bool_t bad_coord_order)
+static int
+create_group(NC_GRP_INFO_T *grp)
 {
-  NC_DIM_INFO_T *dim;
-  NC_VAR_INFO_T *var;
-  NC_GRP_INFO_T *child_grp;
-  int coord_varid = -1;
+  hid_t gcpl_id = 0;
+  int retval = NC_NOERR;;
 
-  int retval;
-  assert(grp && grp->name && grp->hdf_grpid);
-  LOG((3, "%s: grp->name %s, bad_coord_order %d", __func__, grp->name, bad_coord_order));
+  assert(grp);
 
-  /* Write global attributes for this group. */
-  if ((retval = write_attlist(grp->att, NC_GLOBAL, grp)))
-    return retval;
-  /* Set the pointers to the beginning of the list of dims & vars in this
-   * group. */
-  dim = grp->dim;
-  var = grp->var;
+  /* If this is not the root group, create it in the HDF5 file. */
+  if (grp->parent)
+    {
+      /* Create group, with link_creation_order set in the group
+       * creation property list. */
+      if ((gcpl_id = H5Pcreate(H5P_GROUP_CREATE)) < 0)
+        return NC_EHDFERR;
+#ifdef EXTRA_TESTS
+      num_plists++;
+#endif
 
-  /* Because of HDF5 ordering the dims and vars have to be stored in
-   * this way to ensure that the dims and coordinate vars come out in
-   * the correct order. */
-  while (dim || var)
+      /* RJ: this suppose to be FALSE that is defined in H5 private.h as 0 */
+      if (H5Pset_obj_track_times(gcpl_id,0)<0)
+        BAIL(NC_EHDFERR);
+
+      if (H5Pset_link_creation_order(gcpl_id, H5P_CRT_ORDER_TRACKED|H5P_CRT_ORDER_INDEXED) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Pset_attr_creation_order(gcpl_id, H5P_CRT_ORDER_TRACKED|H5P_CRT_ORDER_INDEXED) < 0)
+        BAIL(NC_EHDFERR);
+      if ((grp->hdf_grpid = H5Gcreate2(grp->parent->hdf_grpid, grp->name,
+                                       H5P_DEFAULT, gcpl_id, H5P_DEFAULT)) < 0)
+        BAIL(NC_EHDFERR);
+      if (H5Pclose(gcpl_id) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_plists--;
+#endif
+    }
+  else
     {
-      nc_bool_t found_coord, wrote_coord;
+      /* Since this is the root group, we have to open it. */
+      if ((grp->hdf_grpid = H5Gopen2(grp->nc4_info->hdfid, "/", H5P_DEFAULT)) < 0)
+        BAIL(NC_EFILEMETA);
+    }
+  return NC_NOERR;
 
-      /* Write non-coord dims in order, stopping at the first one that
-       * has an associated coord var. */
-      for (found_coord = NC_FALSE; dim && !found_coord; dim = dim->l.next)
+ exit:
+  if (gcpl_id > 0 && H5Pclose(gcpl_id) < 0)
+    BAIL2(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+  num_plists--;
+#endif
+  if (grp->hdf_grpid > 0 && H5Gclose(grp->hdf_grpid) < 0)
+    BAIL2(NC_EHDFERR);
+  return retval;
+}
+
+/* After all the datasets of the file have been read, it's time to
+ * sort the wheat from the chaff. Which of the datasets are netCDF
+ * dimensions, and which are coordinate variables, and which are
+ * non-coordinate variables. */
+static int
+attach_dimscales(NC_GRP_INFO_T *grp)
+{
+  NC_VAR_INFO_T *var;
+  NC_DIM_INFO_T *dim1;
+  NC_GRP_INFO_T *g;
+  int d;
+  int retval = NC_NOERR;
+
+  /* Attach dimension scales. */
+  for (var = grp->var; var; var = var->l.next)
+    {
+      /* Scales themselves do not attach. But I really wish they
+       * would. */
+      if (var->dimscale)
         {
-          if (!dim->coord_var)
-            {
-              if ((retval = write_dim(dim, grp, bad_coord_order)))
-                return retval;
-            }
-          else
+          /* If this is a multidimensional coordinate variable, it will
+           * have a special coords attribute (read earlier) with a list
+           * of the dimensions for this variable. */
+        }
+      else /* not a dimscale... */
+        {
+          /* Find the scale for each dimension and attach it. */
+          for (d = 0; d < var->ndims; d++)
             {
-              coord_varid = dim->coord_var->varid;
-              found_coord = NC_TRUE;
+              /* Is there a dimscale for this dimension? */
+              if (var->dimscale_attached)
+                {
+                  if (!var->dimscale_attached[d])
+                    {
+                      hid_t dim_datasetid;  /* Dataset ID for dimension */
+                      dim1 = var->dim[d];
+		      assert(dim1 && dim1->dimid == var->dimids[d]);
+
+                      LOG((2, "%s: attaching scale for dimid %d to var %s",
+                           __func__, var->dimids[d], var->name));
+
+                      /* Find dataset ID for dimension */
+                      if (dim1->coord_var)
+                        dim_datasetid = dim1->coord_var->hdf_datasetid;
+                      else
+                        dim_datasetid = dim1->hdf_dimscaleid;
+                      assert(dim_datasetid > 0);
+                      if (H5DSattach_scale(var->hdf_datasetid, dim_datasetid, d) < 0)
+                        BAIL(NC_EHDFERR);
+                      var->dimscale_attached[d] = NC_TRUE;
+                    }
+
+		  /* If we didn't find a dimscale to attach, that's a problem! */
+		  if (!var->dimscale_attached[d])
+		    {
+		      LOG((0, "no dimscale found!"));
+		      return NC_EDIMSCALE;
+		    }
+                }
             }
         }
+    }
 
-      /* Write each var. When we get to the coord var we are waiting
-       * for (if any), then we break after writing it. */
-      for (wrote_coord = NC_FALSE; var && !wrote_coord; var = var->l.next)
-        {
-          if ((retval = write_var(var, grp, bad_coord_order)))
-            return retval;
-          if (found_coord && var->varid == coord_varid)
-            wrote_coord = NC_TRUE;
-        }
-    } /* end while */
+ exit:
+  return retval;
+}
 
-  if ((retval = attach_dimscales(grp)))
-    return retval;
+static int
+var_exists(hid_t grpid, char *name, nc_bool_t *exists)
+{
+  htri_t link_exists;
 
-  /* If there are any child groups, write their metadata. */
-  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
-    if ((retval = nc4_rec_write_metadata(child_grp, bad_coord_order)))
-      return retval;
+  /* Reset the boolean */
+  *exists = NC_FALSE;
+
+  /* Check if the object name exists in the group */
+  if ((link_exists = H5Lexists(grpid, name, H5P_DEFAULT)) < 0)
+    return NC_EHDFERR;
+  if (link_exists)
+    {
+      H5G_stat_t statbuf;
+
+      /* Get info about the object */
+      if (H5Gget_objinfo(grpid, name, 1, &statbuf) < 0)
+        return NC_EHDFERR;
+
+      if (H5G_DATASET == statbuf.type)
+        *exists = NC_TRUE;
+    }
 
   return NC_NOERR;
 }
 
-/* Recursively write all groups and types. */
-int
-nc4_rec_write_groups_types(NC_GRP_INFO_T *grp)
+/* This function writes a variable. The principle difficulty comes
+ * from the possibility that this is a coordinate variable, and was
+ * already written to the file as a dimension-only dimscale. If this
+ * occurs, then it must be deleted and recreated. */
+static int
+write_var(NC_VAR_INFO_T *var, NC_GRP_INFO_T *grp, nc_bool_t write_dimid)
 {
-  NC_GRP_INFO_T *child_grp;
-  NC_TYPE_INFO_T *type;
+  nc_bool_t replace_existing_var = NC_FALSE;
   int retval;
 
-  assert(grp && grp->name);
-  LOG((3, "%s: grp->name %s", __func__, grp->name));
+  LOG((4, "%s: writing var %s", __func__, var->name));
 
-  /* Create the group in the HDF5 file if it doesn't exist. */
-  if (!grp->hdf_grpid)
-    if ((retval = create_group(grp)))
-      return retval;
+  /* If the variable has already been created & the fill value changed,
+   * indicate that the existing variable should be replaced. */
+  if (var->created && var->fill_val_changed)
+    {
+      replace_existing_var = NC_TRUE;
+      var->fill_val_changed = NC_FALSE;
+    }
 
-  /* If this is the root group of a file with strict NC3 rules, write
-   * an attribute. But don't leave the attribute open. */
-  if (!grp->parent && (grp->nc4_info->cmode & NC_CLASSIC_MODEL))
-    if ((retval = write_nc3_strict_att(grp->hdf_grpid)))
-      return retval;
+  /* Is this a coordinate var that has already been created in
+   * the HDF5 file as a dimscale dataset? Check for dims with the
+   * same name in this group. If there is one, check to see if
+   * this object exists in the HDF group. */
+  if (var->became_coord_var)
+    {
+      NC_DIM_INFO_T *d1;
 
-  /* If there are any user-defined types, write them now. */
-  for (type = grp->type; type; type = type->l.next)
-    if ((retval = commit_type(grp, type)))
-      return retval;
+      for (d1 = grp->dim; d1; d1 = d1->l.next)
+        if (!strcmp(d1->name, var->name))
+          {
+            nc_bool_t exists;
 
-  /* If there are any child groups, write their groups and types. */
-  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
-    if ((retval = nc4_rec_write_groups_types(child_grp)))
-      return retval;
+            if ((retval = var_exists(grp->hdf_grpid, var->name, &exists)))
+              return retval;
+            if (exists)
+              {
+                /* Indicate that the variable already exists, and should be replaced */
+                replace_existing_var = NC_TRUE;
+                break;
+              }
+          }
+    }
 
-  return NC_NOERR;
-}
+  /* Check dims if the variable will be replaced, so that the dimensions
+   * will be de-attached and re-attached correctly. */
+  /* (Note: There's a temptation to merge this loop over the dimensions with
+   *        the prior loop over dimensions, but that blurs the line over the
+   *        purpose of them, so they are currently separate.  If performance
+   *        becomes an issue here, it would be possible to merge them. -QAK)
+   */
+  if (replace_existing_var)
+    {
+      NC_DIM_INFO_T *d1;
 
-/*! Copy data from one buffer to another, performing appropriate data conversion.
+      for (d1 = grp->dim; d1; d1 = d1->l.next)
+        if (!strcmp(d1->name, var->name))
+          {
+            nc_bool_t exists;
 
-  This function will copy data from one buffer to another, in
-  accordance with the types. Range errors will be noted, and the fill
-  value used (or the default fill value if none is supplied) for
-  values that overflow the type.
+            if ((retval = var_exists(grp->hdf_grpid, var->name, &exists)))
+              return retval;
+            if (exists)
+              {
+                hid_t dim_datasetid;  /* Dataset ID for dimension */
 
-  I should be able to take this out when HDF5 does the right thing
-  with data type conversion.
+                /* Find dataset ID for dimension */
+                if (d1->coord_var)
+                  dim_datasetid = d1->coord_var->hdf_datasetid;
+                else
+                  dim_datasetid = d1->hdf_dimscaleid;
+                assert(dim_datasetid > 0);
 
-  Ed Hartnett, 11/15/3
-*/
-int
-nc4_convert_type(const void *src, void *dest,
-                 const nc_type src_type, const nc_type dest_type,
-                 const size_t len, int *range_error,
-                 const void *fill_value, int strict_nc3, int src_long,
-                 int dest_long)
-{
-  char *cp, *cp1;
-  float *fp, *fp1;
-  double *dp, *dp1;
-  int *ip, *ip1;
-  signed long *lp, *lp1;
-  short *sp, *sp1;
-  signed char *bp, *bp1;
-  unsigned char *ubp, *ubp1;
-  unsigned short *usp, *usp1;
-  unsigned int *uip, *uip1;
-  long long *lip, *lip1;
-  unsigned long long *ulip, *ulip1;
-  size_t count = 0;
-
-  *range_error = 0;
-  LOG((3, "%s: len %d src_type %d dest_type %d src_long %d dest_long %d",
-       __func__, len, src_type, dest_type, src_long, dest_long));
-
-  /* OK, this is ugly. If you can think of anything better, I'm open
-     to suggestions!
-
-     Note that we don't use a default fill value for type
-     NC_BYTE. This is because Lord Voldemort cast a nofilleramous spell
-     at Harry Potter, but it bounced off his scar and hit the netcdf-4
-     code.
-  */
-  switch (src_type)
-    {
-    case NC_CHAR:
-      switch (dest_type)
-        {
-        case NC_CHAR:
-          for (cp = (char *)src, cp1 = dest; count < len; count++)
-            *cp1++ = *cp++;
-          break;
-        default:
-          LOG((0, "%s: Uknown destination type.", __func__));
-        }
-      break;
+                /* If we're replacing an existing dimscale dataset, go to
+                 * every var in the file and detach this dimension scale,
+                 * because we have to delete it. */
+                if ((retval = rec_detach_scales(grp->nc4_info->root_grp,
+                                                var->dimids[0], dim_datasetid)))
+                  return retval;
+                break;
+              }
+          }
+    }
 
-    case NC_BYTE:
-      switch (dest_type)
+  /* If this is not a dimension scale, do this stuff. */
+  if (var->was_coord_var && var->dimscale_attached)
+    {
+      /* If the variable already exists in the file, Remove any dimension scale
+       * attributes from it, if they exist. */
+      /* (The HDF5 Dimension Scale API should really have an API routine
+       * for making a dataset not a scale. -QAK) */
+      if (var->created)
         {
-        case NC_BYTE:
-          for (bp = (signed char *)src, bp1 = dest; count < len; count++)
-            *bp1++ = *bp++;
-          break;
-        case NC_UBYTE:
-          for (bp = (signed char *)src, ubp = dest; count < len; count++)
-            {
-              if (*bp < 0)
-                (*range_error)++;
-              *ubp++ = *bp++;
-            }
-          break;
-        case NC_SHORT:
-          for (bp = (signed char *)src, sp = dest; count < len; count++)
-            *sp++ = *bp++;
-          break;
-        case NC_USHORT:
-          for (bp = (signed char *)src, usp = dest; count < len; count++)
-            {
-              if (*bp < 0)
-                (*range_error)++;
-              *usp++ = *bp++;
-            }
-          break;
-        case NC_INT:
-          if (dest_long)
-            {
-              for (bp = (signed char *)src, lp = dest; count < len; count++)
-                *lp++ = *bp++;
-              break;
-            }
-          else
-            {
-              for (bp = (signed char *)src, ip = dest; count < len; count++)
-                *ip++ = *bp++;
-              break;
-            }
-        case NC_UINT:
-          for (bp = (signed char *)src, uip = dest; count < len; count++)
+          htri_t attr_exists;
+
+          /* (We could do a better job here and verify that the attributes are
+           * really dimension scale 'CLASS' & 'NAME' attributes, but that would be
+           * poking about in the HDF5 DimScale internal data) */
+          if ((attr_exists = H5Aexists(var->hdf_datasetid, "CLASS")) < 0)
+            BAIL(NC_EHDFERR);
+          if (attr_exists)
             {
-              if (*bp < 0)
-                (*range_error)++;
-              *uip++ = *bp++;
+              if (H5Adelete(var->hdf_datasetid, "CLASS") < 0)
+                BAIL(NC_EHDFERR);
             }
-          break;
-        case NC_INT64:
-          for (bp = (signed char *)src, lip = dest; count < len; count++)
-            *lip++ = *bp++;
-          break;
-        case NC_UINT64:
-          for (bp = (signed char *)src, ulip = dest; count < len; count++)
+          if ((attr_exists = H5Aexists(var->hdf_datasetid, "NAME")) < 0)
+            BAIL(NC_EHDFERR);
+          if (attr_exists)
             {
-              if (*bp < 0)
-                (*range_error)++;
-              *ulip++ = *bp++;
+              if (H5Adelete(var->hdf_datasetid, "NAME") < 0)
+                BAIL(NC_EHDFERR);
             }
-          break;
-        case NC_FLOAT:
-          for (bp = (signed char *)src, fp = dest; count < len; count++)
-            *fp++ = *bp++;
-          break;
-        case NC_DOUBLE:
-          for (bp = (signed char *)src, dp = dest; count < len; count++)
-            *dp++ = *bp++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
         }
-      break;
 
-    case NC_UBYTE:
-      switch (dest_type)
+      if (var->dimscale_attached)
         {
-        case NC_BYTE:
-          for (ubp = (unsigned char *)src, bp = dest; count < len; count++)
-            {
-              if (!strict_nc3 && *ubp > X_SCHAR_MAX)
-                (*range_error)++;
-              *bp++ = *ubp++;
-            }
-          break;
-        case NC_SHORT:
-          for (ubp = (unsigned char *)src, sp = dest; count < len; count++)
-            *sp++ = *ubp++;
-          break;
-        case NC_UBYTE:
-          for (ubp = (unsigned char *)src, ubp1 = dest; count < len; count++)
-            *ubp1++ = *ubp++;
-          break;
-        case NC_USHORT:
-          for (ubp = (unsigned char *)src, usp = dest; count < len; count++)
-            *usp++ = *ubp++;
-          break;
-        case NC_INT:
-          if (dest_long)
-            {
-              for (ubp = (unsigned char *)src, lp = dest; count < len; count++)
-                *lp++ = *ubp++;
-              break;
-            }
-          else
-            {
-              for (ubp = (unsigned char *)src, ip = dest; count < len; count++)
-                *ip++ = *ubp++;
-              break;
-            }
-        case NC_UINT:
-          for (ubp = (unsigned char *)src, uip = dest; count < len; count++)
-            *uip++ = *ubp++;
-          break;
-        case NC_INT64:
-          for (ubp = (unsigned char *)src, lip = dest; count < len; count++)
-            *lip++ = *ubp++;
-          break;
-        case NC_UINT64:
-          for (ubp = (unsigned char *)src, ulip = dest; count < len; count++)
-            *ulip++ = *ubp++;
-          break;
-        case NC_FLOAT:
-          for (ubp = (unsigned char *)src, fp = dest; count < len; count++)
-            *fp++ = *ubp++;
-          break;
-        case NC_DOUBLE:
-          for (ubp = (unsigned char *)src, dp = dest; count < len; count++)
-            *dp++ = *ubp++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
+          int d;
+
+          /* If this is a regular var, detach all its dim scales. */
+          for (d = 0; d < var->ndims; d++)
+            if (var->dimscale_attached[d])
+              {
+                hid_t dim_datasetid;  /* Dataset ID for dimension */
+                NC_DIM_INFO_T *dim1 = var->dim[d];
+		assert(dim1 && dim1->dimid == var->dimids[d]);
+
+                /* Find dataset ID for dimension */
+                if (dim1->coord_var)
+                  dim_datasetid = dim1->coord_var->hdf_datasetid;
+                else
+                  dim_datasetid = dim1->hdf_dimscaleid;
+                assert(dim_datasetid > 0);
+
+                if (H5DSdetach_scale(var->hdf_datasetid, dim_datasetid, d) < 0)
+                  BAIL(NC_EHDFERR);
+                var->dimscale_attached[d] = NC_FALSE;
+              }
         }
-      break;
+    }
 
-    case NC_SHORT:
-      switch (dest_type)
+  /* Delete the HDF5 dataset that is to be replaced. */
+  if (replace_existing_var)
+    {
+      /* Free the HDF5 dataset id. */
+      if (var->hdf_datasetid && H5Dclose(var->hdf_datasetid) < 0)
+        BAIL(NC_EHDFERR);
+      var->hdf_datasetid = 0;
+
+      /* Now delete the variable. */
+      if (H5Gunlink(grp->hdf_grpid, var->name) < 0)
+        return NC_EDIMMETA;
+    }
+
+  /* Create the dataset. */
+  if (var->is_new_var || replace_existing_var)
+    {
+      if ((retval = var_create_dataset(grp, var)))
+        return retval;
+    }
+  else
+    {
+      if (write_dimid && var->ndims)
+        if ((retval = write_netcdf4_dimid(var->hdf_datasetid, var->dimids[0])))
+          BAIL(retval);
+    }
+
+  if (replace_existing_var)
+    {
+      /* If this is a dimension scale, reattach the scale everywhere it
+       * is used. (Recall that netCDF dimscales are always 1-D). */
+      if(var->dimscale)
         {
-        case NC_UBYTE:
-          for (sp = (short *)src, ubp = dest; count < len; count++)
-            {
-              if (*sp > X_UCHAR_MAX || *sp < 0)
-                (*range_error)++;
-              *ubp++ = *sp++;
-            }
-          break;
-        case NC_BYTE:
-          for (sp = (short *)src, bp = dest; count < len; count++)
-            {
-              if (*sp > X_SCHAR_MAX || *sp < X_SCHAR_MIN)
-                (*range_error)++;
-              *bp++ = *sp++;
-            }
-          break;
-        case NC_SHORT:
-          for (sp = (short *)src, sp1 = dest; count < len; count++)
-            *sp1++ = *sp++;
-          break;
-        case NC_USHORT:
-          for (sp = (short *)src, usp = dest; count < len; count++)
-            {
-              if (*sp < 0)
-                (*range_error)++;
-              *usp++ = *sp++;
-            }
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (sp = (short *)src, lp = dest; count < len; count++)
-              *lp++ = *sp++;
-          else
-            for (sp = (short *)src, ip = dest; count < len; count++)
-              *ip++ = *sp++;
-          break;
-        case NC_UINT:
-          for (sp = (short *)src, uip = dest; count < len; count++)
-            {
-              if (*sp < 0)
-                (*range_error)++;
-              *uip++ = *sp++;
-            }
-          break;
-        case NC_INT64:
-          for (sp = (short *)src, lip = dest; count < len; count++)
-            *lip++ = *sp++;
-          break;
-        case NC_UINT64:
-          for (sp = (short *)src, ulip = dest; count < len; count++)
-            {
-              if (*sp < 0)
-                (*range_error)++;
-              *ulip++ = *sp++;
-            }
-          break;
-        case NC_FLOAT:
-          for (sp = (short *)src, fp = dest; count < len; count++)
-            *fp++ = *sp++;
-          break;
-        case NC_DOUBLE:
-          for (sp = (short *)src, dp = dest; count < len; count++)
-            *dp++ = *sp++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
+          if ((retval = rec_reattach_scales(grp->nc4_info->root_grp,
+                                            var->dimids[0], var->hdf_datasetid)))
+            return retval;
         }
-      break;
-
-    case NC_USHORT:
-      switch (dest_type)
+      /* If it's not a dimension scale, clear the dimscale attached flags,
+       * so the dimensions are re-attached. */
+      else
         {
-        case NC_UBYTE:
-          for (usp = (unsigned short *)src, ubp = dest; count < len; count++)
-            {
-              if (*usp > X_UCHAR_MAX)
-                (*range_error)++;
-              *ubp++ = *usp++;
-            }
-          break;
-        case NC_BYTE:
-          for (usp = (unsigned short *)src, bp = dest; count < len; count++)
-            {
-              if (*usp > X_SCHAR_MAX)
-                (*range_error)++;
-              *bp++ = *usp++;
-            }
-          break;
-        case NC_SHORT:
-          for (usp = (unsigned short *)src, sp = dest; count < len; count++)
-            {
-              if (*usp > X_SHORT_MAX)
-                (*range_error)++;
-              *sp++ = *usp++;
-            }
-          break;
-        case NC_USHORT:
-          for (usp = (unsigned short *)src, usp1 = dest; count < len; count++)
-            *usp1++ = *usp++;
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (usp = (unsigned short *)src, lp = dest; count < len; count++)
-              *lp++ = *usp++;
-          else
-            for (usp = (unsigned short *)src, ip = dest; count < len; count++)
-              *ip++ = *usp++;
-          break;
-        case NC_UINT:
-          for (usp = (unsigned short *)src, uip = dest; count < len; count++)
-            *uip++ = *usp++;
-          break;
-        case NC_INT64:
-          for (usp = (unsigned short *)src, lip = dest; count < len; count++)
-            *lip++ = *usp++;
-          break;
-        case NC_UINT64:
-          for (usp = (unsigned short *)src, ulip = dest; count < len; count++)
-            *ulip++ = *usp++;
-          break;
-        case NC_FLOAT:
-          for (usp = (unsigned short *)src, fp = dest; count < len; count++)
-            *fp++ = *usp++;
-          break;
-        case NC_DOUBLE:
-          for (usp = (unsigned short *)src, dp = dest; count < len; count++)
-            *dp++ = *usp++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
+          if (var->dimscale_attached)
+            memset(var->dimscale_attached, 0, sizeof(nc_bool_t) * var->ndims);
         }
-      break;
+    }
 
-    case NC_INT:
-      if (src_long)
-        {
-          switch (dest_type)
-            {
-            case NC_UBYTE:
-              for (lp = (long *)src, ubp = dest; count < len; count++)
-                {
-                  if (*lp > X_UCHAR_MAX || *lp < 0)
-                    (*range_error)++;
-                  *ubp++ = *lp++;
-                }
-              break;
-            case NC_BYTE:
-              for (lp = (long *)src, bp = dest; count < len; count++)
-                {
-                  if (*lp > X_SCHAR_MAX || *lp < X_SCHAR_MIN)
-                    (*range_error)++;
-                  *bp++ = *lp++;
-                }
-              break;
-            case NC_SHORT:
-              for (lp = (long *)src, sp = dest; count < len; count++)
-                {
-                  if (*lp > X_SHORT_MAX || *lp < X_SHORT_MIN)
-                    (*range_error)++;
-                  *sp++ = *lp++;
-                }
-              break;
-            case NC_USHORT:
-              for (lp = (long *)src, usp = dest; count < len; count++)
-                {
-                  if (*lp > X_USHORT_MAX || *lp < 0)
-                    (*range_error)++;
-                  *usp++ = *lp++;
-                }
-              break;
-            case NC_INT: /* src is long */
-              if (dest_long)
-                {
-                  for (lp = (long *)src, lp1 = dest; count < len; count++)
-                    {
-                      if (*lp > X_LONG_MAX || *lp < X_LONG_MIN)
-                        (*range_error)++;
-                      *lp1++ = *lp++;
-                    }
-                }
-              else /* dest is int */
-                {
-                  for (lp = (long *)src, ip = dest; count < len; count++)
-                    {
-                      if (*lp > X_INT_MAX || *lp < X_INT_MIN)
-                        (*range_error)++;
-                      *ip++ = *lp++;
-                    }
-                }
-              break;
-            case NC_UINT:
-              for (lp = (long *)src, uip = dest; count < len; count++)
-                {
-                  if (*lp > X_UINT_MAX || *lp < 0)
-                    (*range_error)++;
-                  *uip++ = *lp++;
-                }
-              break;
-            case NC_INT64:
-              for (lp = (long *)src, lip = dest; count < len; count++)
-                *lip++ = *lp++;
-              break;
-            case NC_UINT64:
-              for (lp = (long *)src, ulip = dest; count < len; count++)
-                {
-                  if (*lp < 0)
-                    (*range_error)++;
-                  *ulip++ = *lp++;
-                }
-              break;
-            case NC_FLOAT:
-              for (lp = (long *)src, fp = dest; count < len; count++)
-                *fp++ = *lp++;
-              break;
-            case NC_DOUBLE:
-              for (lp = (long *)src, dp = dest; count < len; count++)
-                *dp++ = *lp++;
-              break;
-            default:
-              LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-                   __func__, src_type, dest_type));
-              return NC_EBADTYPE;
-            }
-        }
-      else
-        {
-          switch (dest_type)
-            {
-            case NC_UBYTE:
-              for (ip = (int *)src, ubp = dest; count < len; count++)
-                {
-                  if (*ip > X_UCHAR_MAX || *ip < 0)
-                    (*range_error)++;
-                  *ubp++ = *ip++;
-                }
-              break;
-            case NC_BYTE:
-              for (ip = (int *)src, bp = dest; count < len; count++)
-                {
-                  if (*ip > X_SCHAR_MAX || *ip < X_SCHAR_MIN)
-                    (*range_error)++;
-                  *bp++ = *ip++;
-                }
-              break;
-            case NC_SHORT:
-              for (ip = (int *)src, sp = dest; count < len; count++)
-                {
-                  if (*ip > X_SHORT_MAX || *ip < X_SHORT_MIN)
-                    (*range_error)++;
-                  *sp++ = *ip++;
-                }
-              break;
-            case NC_USHORT:
-              for (ip = (int *)src, usp = dest; count < len; count++)
-                {
-                  if (*ip > X_USHORT_MAX || *ip < 0)
-                    (*range_error)++;
-                  *usp++ = *ip++;
-                }
-              break;
-            case NC_INT: /* src is int */
-              if (dest_long)
-                {
-                  for (ip = (int *)src, lp1 = dest; count < len; count++)
-                    {
-                      if (*ip > X_LONG_MAX || *ip < X_LONG_MIN)
-                        (*range_error)++;
-                      *lp1++ = *ip++;
-                    }
-                }
-              else /* dest is int */
-                {
-                  for (ip = (int *)src, ip1 = dest; count < len; count++)
-                    {
-                      if (*ip > X_INT_MAX || *ip < X_INT_MIN)
-                        (*range_error)++;
-                      *ip1++ = *ip++;
-                    }
-                }
-              break;
-            case NC_UINT:
-              for (ip = (int *)src, uip = dest; count < len; count++)
-                {
-                  if (*ip > X_UINT_MAX || *ip < 0)
-                    (*range_error)++;
-                  *uip++ = *ip++;
-                }
-              break;
-            case NC_INT64:
-              for (ip = (int *)src, lip = dest; count < len; count++)
-                *lip++ = *ip++;
-              break;
-            case NC_UINT64:
-              for (ip = (int *)src, ulip = dest; count < len; count++)
-                {
-                  if (*ip < 0)
-                    (*range_error)++;
-                  *ulip++ = *ip++;
-                }
-              break;
-            case NC_FLOAT:
-              for (ip = (int *)src, fp = dest; count < len; count++)
-                *fp++ = *ip++;
-              break;
-            case NC_DOUBLE:
-              for (ip = (int *)src, dp = dest; count < len; count++)
-                *dp++ = *ip++;
-              break;
-            default:
-              LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-                   __func__, src_type, dest_type));
-              return NC_EBADTYPE;
-            }
-        }
-      break;
+  /* Clear coord. var state transition flags */
+  var->was_coord_var = NC_FALSE;
+  var->became_coord_var = NC_FALSE;
 
-    case NC_UINT:
-      switch (dest_type)
+  /* Now check the attributes for this var. */
+  if (var->attr_dirty)
+    {
+      /* Write attributes for this var. */
+      if ((retval = write_attlist(var->att, var->varid, grp)))
+        BAIL(retval);
+      var->attr_dirty = NC_FALSE;
+    }
+
+  return NC_NOERR;
+ exit:
+  return retval;
+}
+
+static int
+write_dim(NC_DIM_INFO_T *dim, NC_GRP_INFO_T *grp, nc_bool_t write_dimid)
+{
+  int retval;
+
+  /* If there's no dimscale dataset for this dim, create one,
+   * and mark that it should be hidden from netCDF as a
+   * variable. (That is, it should appear as a dimension
+   * without an associated variable.) */
+  if (0 == dim->hdf_dimscaleid)
+    {
+      hid_t spaceid, create_propid;
+      hsize_t dims[1], max_dims[1], chunk_dims[1] = {1};
+      char dimscale_wo_var[NC_MAX_NAME];
+
+      LOG((4, "%s: creating dim %s", __func__, dim->name));
+
+      /* Sanity check */
+      assert(NULL == dim->coord_var);
+
+      /* Create a property list. If this dimension scale is
+       * unlimited (i.e. it's an unlimited dimension), then set
+       * up chunking, with a chunksize of 1. */
+      if ((create_propid = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_plists++;
+#endif
+
+      /* RJ: this suppose to be FALSE that is defined in H5 private.h as 0 */
+      if (H5Pset_obj_track_times(create_propid,0)<0)
+        BAIL(NC_EHDFERR);
+
+      dims[0] = dim->len;
+      max_dims[0] = dim->len;
+      if (dim->unlimited)
         {
-        case NC_UBYTE:
-          for (uip = (unsigned int *)src, ubp = dest; count < len; count++)
-            {
-              if (*uip > X_UCHAR_MAX)
-                (*range_error)++;
-              *ubp++ = *uip++;
-            }
-          break;
-        case NC_BYTE:
-          for (uip = (unsigned int *)src, bp = dest; count < len; count++)
-            {
-              if (*uip > X_SCHAR_MAX)
-                (*range_error)++;
-              *bp++ = *uip++;
-            }
-          break;
-        case NC_SHORT:
-          for (uip = (unsigned int *)src, sp = dest; count < len; count++)
-            {
-              if (*uip > X_SHORT_MAX)
-                (*range_error)++;
-              *sp++ = *uip++;
-            }
-          break;
-        case NC_USHORT:
-          for (uip = (unsigned int *)src, usp = dest; count < len; count++)
-            {
-              if (*uip > X_USHORT_MAX)
-                (*range_error)++;
-              *usp++ = *uip++;
-            }
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (uip = (unsigned int *)src, lp = dest; count < len; count++)
-              {
-                if (*uip > X_LONG_MAX)
-                  (*range_error)++;
-                *lp++ = *uip++;
-              }
-          else
-            for (uip = (unsigned int *)src, ip = dest; count < len; count++)
-              {
-                if (*uip > X_INT_MAX)
-                  (*range_error)++;
-                *ip++ = *uip++;
-              }
-          break;
-        case NC_UINT:
-          for (uip = (unsigned int *)src, uip1 = dest; count < len; count++)
-            {
-              if (*uip > X_UINT_MAX)
-                (*range_error)++;
-              *uip1++ = *uip++;
-            }
-          break;
-        case NC_INT64:
-          for (uip = (unsigned int *)src, lip = dest; count < len; count++)
-            *lip++ = *uip++;
-          break;
-        case NC_UINT64:
-          for (uip = (unsigned int *)src, ulip = dest; count < len; count++)
-            *ulip++ = *uip++;
-          break;
-        case NC_FLOAT:
-          for (uip = (unsigned int *)src, fp = dest; count < len; count++)
-            *fp++ = *uip++;
-          break;
-        case NC_DOUBLE:
-          for (uip = (unsigned int *)src, dp = dest; count < len; count++)
-            *dp++ = *uip++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
+          max_dims[0] = H5S_UNLIMITED;
+          if (H5Pset_chunk(create_propid, 1, chunk_dims) < 0)
+            BAIL(NC_EHDFERR);
         }
-      break;
 
-    case NC_INT64:
-      switch (dest_type)
-        {
-        case NC_UBYTE:
-          for (lip = (long long *)src, ubp = dest; count < len; count++)
-            {
-              if (*lip > X_UCHAR_MAX || *lip < 0)
-                (*range_error)++;
-              *ubp++ = *lip++;
-            }
-          break;
-        case NC_BYTE:
-          for (lip = (long long *)src, bp = dest; count < len; count++)
-            {
-              if (*lip > X_SCHAR_MAX || *lip < X_SCHAR_MIN)
-                (*range_error)++;
-              *bp++ = *lip++;
-            }
-          break;
-        case NC_SHORT:
-          for (lip = (long long *)src, sp = dest; count < len; count++)
-            {
-              if (*lip > X_SHORT_MAX || *lip < X_SHORT_MIN)
-                (*range_error)++;
-              *sp++ = *lip++;
-            }
-          break;
-        case NC_USHORT:
-          for (lip = (long long *)src, usp = dest; count < len; count++)
-            {
-              if (*lip > X_USHORT_MAX || *lip < 0)
-                (*range_error)++;
-              *usp++ = *lip++;
-            }
-          break;
-        case NC_UINT:
-          for (lip = (long long *)src, uip = dest; count < len; count++)
-            {
-              if (*lip > X_UINT_MAX || *lip < 0)
-                (*range_error)++;
-              *uip++ = *lip++;
-            }
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (lip = (long long *)src, lp = dest; count < len; count++)
-              {
-                if (*lip > X_LONG_MAX || *lip < X_LONG_MIN)
-                  (*range_error)++;
-                *lp++ = *lip++;
-              }
-          else
-            for (lip = (long long *)src, ip = dest; count < len; count++)
-              {
-                if (*lip > X_INT_MAX || *lip < X_INT_MIN)
-                  (*range_error)++;
-                *ip++ = *lip++;
-              }
-          break;
-        case NC_INT64:
-          for (lip = (long long *)src, lip1 = dest; count < len; count++)
-            *lip1++ = *lip++;
-          break;
-        case NC_UINT64:
-          for (lip = (long long *)src, ulip = dest; count < len; count++)
-            {
-              if (*lip < 0)
-                (*range_error)++;
-              *ulip++ = *lip++;
-            }
-          break;
-        case NC_FLOAT:
-          for (lip = (long long *)src, fp = dest; count < len; count++)
-            *fp++ = *lip++;
-          break;
-        case NC_DOUBLE:
-          for (lip = (long long *)src, dp = dest; count < len; count++)
-            *dp++ = *lip++;
+      /* Set up space. */
+      if ((spaceid = H5Screate_simple(1, dims, max_dims)) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_spaces++;
+#endif
+
+      if (H5Pset_attr_creation_order(create_propid, H5P_CRT_ORDER_TRACKED|
+                                     H5P_CRT_ORDER_INDEXED) < 0)
+        BAIL(NC_EHDFERR);
+
+      /* Create the dataset that will be the dimension scale. */
+      LOG((4, "%s: about to H5Dcreate1 a dimscale dataset %s", __func__, dim->name));
+      if ((dim->hdf_dimscaleid = H5Dcreate1(grp->hdf_grpid, dim->name, H5T_IEEE_F32BE,
+                                            spaceid, create_propid)) < 0)
+        BAIL(NC_EHDFERR);
+
+      /* Close the spaceid and create_propid. */
+      if (H5Sclose(spaceid) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_spaces--;
+#endif
+      if (H5Pclose(create_propid) < 0)
+        BAIL(NC_EHDFERR);
+#ifdef EXTRA_TESTS
+      num_plists--;
+#endif
+
+      /* Indicate that this is a scale. Also indicate that not
+       * be shown to the user as a variable. It is hidden. It is
+       * a DIM WITHOUT A VARIABLE! */
+      sprintf(dimscale_wo_var, "%s%10d", DIM_WITHOUT_VARIABLE, (int)dim->len);
+      if (H5DSset_scale(dim->hdf_dimscaleid, dimscale_wo_var) < 0)
+        BAIL(NC_EHDFERR);
+
+      /* A new dimscale always gets the secret dimid, as in
+       * var_create_dataset(). */
+      write_dimid = NC_TRUE;
+    }
+
+  /* Did we extend an unlimited dimension? */
+  if (dim->extended)
+    {
+      NC_VAR_INFO_T *v1;
+
+      assert(dim->unlimited);
+      /* If this is a dimension without a variable, then update
+       * the secret length information at the end of the NAME
+       * attribute. */
+      for (v1 = grp->var; v1; v1 = v1->l.next)
+        if (!strcmp(v1->name, dim->name))
           break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
-        }
-      break;
 
-    case NC_UINT64:
-      switch (dest_type)
+      if (v1)
         {
-        case NC_UBYTE:
-          for (ulip = (unsigned long long *)src, ubp = dest; count < len; count++)
-            {
-              if (*ulip > X_UCHAR_MAX)
-                (*range_error)++;
-              *ubp++ = *ulip++;
-            }
-          break;
-        case NC_BYTE:
-          for (ulip = (unsigned long long *)src, bp = dest; count < len; count++)
-            {
-              if (*ulip > X_SCHAR_MAX)
-                (*range_error)++;
-              *bp++ = *ulip++;
-            }
-          break;
-        case NC_SHORT:
-          for (ulip = (unsigned long long *)src, sp = dest; count < len; count++)
-            {
-              if (*ulip > X_SHORT_MAX)
-                (*range_error)++;
-              *sp++ = *ulip++;
-            }
-          break;
-        case NC_USHORT:
-          for (ulip = (unsigned long long *)src, usp = dest; count < len; count++)
-            {
-              if (*ulip > X_USHORT_MAX)
-                (*range_error)++;
-              *usp++ = *ulip++;
-            }
-          break;
-        case NC_UINT:
-          for (ulip = (unsigned long long *)src, uip = dest; count < len; count++)
-            {
-              if (*ulip > X_UINT_MAX)
-                (*range_error)++;
-              *uip++ = *ulip++;
-            }
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (ulip = (unsigned long long *)src, lp = dest; count < len; count++)
-              {
-                if (*ulip > X_LONG_MAX)
-                  (*range_error)++;
-                *lp++ = *ulip++;
-              }
-          else
-            for (ulip = (unsigned long long *)src, ip = dest; count < len; count++)
-              {
-                if (*ulip > X_INT_MAX)
-                  (*range_error)++;
-                *ip++ = *ulip++;
-              }
-          break;
-        case NC_INT64:
-          for (ulip = (unsigned long long *)src, lip = dest; count < len; count++)
+          hsize_t *new_size = NULL;
+          NC_DIM_INFO_T *dim1;
+          int d1;
+
+          /* Extend the dimension scale dataset to reflect the new
+           * length of the dimension. */
+          if (!(new_size = malloc(v1->ndims * sizeof(hsize_t))))
+            BAIL(NC_ENOMEM);
+          for (d1 = 0; d1 < v1->ndims; d1++)
             {
-              if (*ulip > X_INT64_MAX)
-                (*range_error)++;
-              *lip++ = *ulip++;
+	      assert(v1->dim[d1] && v1->dim[d1]->dimid == v1->dimids[d1]);
+	      new_size[d1] = v1->dim[d1]->len;
             }
-          break;
-        case NC_UINT64:
-          for (ulip = (unsigned long long *)src, ulip1 = dest; count < len; count++)
-            *ulip1++ = *ulip++;
-          break;
-        case NC_FLOAT:
-          for (ulip = (unsigned long long *)src, fp = dest; count < len; count++)
-            *fp++ = *ulip++;
-          break;
-        case NC_DOUBLE:
-          for (ulip = (unsigned long long *)src, dp = dest; count < len; count++)
-            *dp++ = *ulip++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
+          if (H5Dset_extent(v1->hdf_datasetid, new_size) < 0) {
+            free(new_size);
+            BAIL(NC_EHDFERR);
+          }
+          if (v1->logical_dims)
+            memcpy(v1->logical_dims, new_size, v1->ndims * sizeof(hsize_t));
+          v1->overallocated = NC_FALSE;
+          nc4_release_file_space(v1);
+          free(new_size);
         }
-      break;
+      dim->extended = NC_FALSE;
+    }
 
-    case NC_FLOAT:
-      switch (dest_type)
+  /* If desired, write the secret dimid. This will be used instead of
+   * the dimid that the dimension would otherwise receive based on
+   * creation order. This can be necessary when dims and their
+   * coordinate variables were created in different order. */
+  if (write_dimid && dim->hdf_dimscaleid)
+    if ((retval = write_netcdf4_dimid(dim->hdf_dimscaleid, dim->dimid)))
+      BAIL(retval);
+
+  return NC_NOERR;
+ exit:
+
+  return retval;
+}
+
+/* Recursively determine if there is a mismatch between order of
+ * coordinate creation and associated dimensions in this group or any
+ * subgroups, to find out if we have to handle that situation.  Also
+ * check if there are any multidimensional coordinate variables
+ * defined, which require the same treatment to fix a potential bug
+ * when such variables occur in subgroups. */
+int
+nc4_rec_detect_need_to_preserve_dimids(NC_GRP_INFO_T *grp, nc_bool_t *bad_coord_orderp)
+{
+  NC_VAR_INFO_T *var;
+  NC_GRP_INFO_T *child_grp;
+  int last_dimid = -1;
+  int retval;
+
+  /* Iterate over variables in this group */
+  for (var = grp->var; var; var = var->l.next)
+    {
+      /* Only matters for dimension scale variables, with non-scalar dimensionality */
+      if (var->dimscale && var->ndims)
         {
-        case NC_UBYTE:
-          for (fp = (float *)src, ubp = dest; count < len; count++)
-            {
-              if (*fp > X_UCHAR_MAX || *fp < 0)
-                (*range_error)++;
-              *ubp++ = *fp++;
-            }
-          break;
-        case NC_BYTE:
-          for (fp = (float *)src, bp = dest; count < len; count++)
-            {
-              if (*fp > (double)X_SCHAR_MAX || *fp < (double)X_SCHAR_MIN)
-                (*range_error)++;
-              *bp++ = *fp++;
-            }
-          break;
-        case NC_SHORT:
-          for (fp = (float *)src, sp = dest; count < len; count++)
-            {
-              if (*fp > (double)X_SHORT_MAX || *fp < (double)X_SHORT_MIN)
-                (*range_error)++;
-              *sp++ = *fp++;
-            }
-          break;
-        case NC_USHORT:
-          for (fp = (float *)src, usp = dest; count < len; count++)
-            {
-              if (*fp > X_USHORT_MAX || *fp < 0)
-                (*range_error)++;
-              *usp++ = *fp++;
-            }
-          break;
-        case NC_UINT:
-          for (fp = (float *)src, uip = dest; count < len; count++)
-            {
-              if (*fp > X_UINT_MAX || *fp < 0)
-                (*range_error)++;
-              *uip++ = *fp++;
-            }
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (fp = (float *)src, lp = dest; count < len; count++)
-              {
-                if (*fp > (double)X_LONG_MAX || *fp < (double)X_LONG_MIN)
-                  (*range_error)++;
-                *lp++ = *fp++;
-              }
-          else
-            for (fp = (float *)src, ip = dest; count < len; count++)
-              {
-                if (*fp > (double)X_INT_MAX || *fp < (double)X_INT_MIN)
-                  (*range_error)++;
-                *ip++ = *fp++;
-              }
-          break;
-        case NC_INT64:
-          for (fp = (float *)src, lip = dest; count < len; count++)
+          /* If the user writes coord vars in a different order then he
+           * defined their dimensions, then, when the file is reopened, the
+           * order of the dimids will change to match the order of the coord
+           * vars. Detect if this is about to happen. */
+          if (var->dimids[0] < last_dimid)
             {
-              if (*fp > X_INT64_MAX || *fp <X_INT64_MIN)
-                (*range_error)++;
-              *lip++ = *fp++;
+              LOG((5, "%s: %s is out of order coord var", __func__, var->name));
+              *bad_coord_orderp = NC_TRUE;
+              return NC_NOERR;
             }
-          break;
-        case NC_UINT64:
-          for (fp = (float *)src, lip = dest; count < len; count++)
+          last_dimid = var->dimids[0];
+
+          /* If there are multidimensional coordinate variables defined, then
+           * it's also necessary to preserve dimension IDs when the file is
+           * reopened ... */
+          if (var->ndims > 1)
             {
-              if (*fp > X_UINT64_MAX || *fp < 0)
-                (*range_error)++;
-              *lip++ = *fp++;
+              LOG((5, "%s: %s is multidimensional coord var", __func__, var->name));
+              *bad_coord_orderp = NC_TRUE;
+              return NC_NOERR;
             }
-          break;
-        case NC_FLOAT:
-          for (fp = (float *)src, fp1 = dest; count < len; count++)
+
+          /* Did the user define a dimension, end define mode, reenter define
+           * mode, and then define a coordinate variable for that dimension?
+           * If so, dimensions will be out of order. */
+          if (var->is_new_var || var->became_coord_var)
             {
-              /*                if (*fp > X_FLOAT_MAX || *fp < X_FLOAT_MIN)
-                                (*range_error)++;*/
-              *fp1++ = *fp++;
+              LOG((5, "%s: coord var defined after enddef/redef", __func__));
+              *bad_coord_orderp = NC_TRUE;
+              return NC_NOERR;
             }
-          break;
-        case NC_DOUBLE:
-          for (fp = (float *)src, dp = dest; count < len; count++)
-            *dp++ = *fp++;
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
         }
-      break;
+    }
 
-    case NC_DOUBLE:
-      switch (dest_type)
+  /* If there are any child groups, check them also for this condition. */
+  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
+    if ((retval = nc4_rec_detect_need_to_preserve_dimids(child_grp, bad_coord_orderp)))
+      return retval;
+
+  return NC_NOERR;
+}
+
+
+/* Recursively write all the metadata in a group. Groups and types
+ * have all already been written.  Propagate bad cooordinate order to
+ * subgroups, if detected. */
+int
+nc4_rec_write_metadata(NC_GRP_INFO_T *grp, nc_bool_t bad_coord_order)
+{
+  NC_DIM_INFO_T *dim;
+  NC_VAR_INFO_T *var;
+  NC_GRP_INFO_T *child_grp;
+  int coord_varid = -1;
+
+  int retval;
+  assert(grp && grp->name && grp->hdf_grpid);
+  LOG((3, "%s: grp->name %s, bad_coord_order %d", __func__, grp->name, bad_coord_order));
+
+  /* Write global attributes for this group. */
+  if ((retval = write_attlist(grp->att, NC_GLOBAL, grp)))
+    return retval;
+  /* Set the pointers to the beginning of the list of dims & vars in this
+   * group. */
+  dim = grp->dim;
+  var = grp->var;
+
+  /* Because of HDF5 ordering the dims and vars have to be stored in
+   * this way to ensure that the dims and coordinate vars come out in
+   * the correct order. */
+  while (dim || var)
+    {
+      nc_bool_t found_coord, wrote_coord;
+
+      /* Write non-coord dims in order, stopping at the first one that
+       * has an associated coord var. */
+      for (found_coord = NC_FALSE; dim && !found_coord; dim = dim->l.next)
         {
-        case NC_UBYTE:
-          for (dp = (double *)src, ubp = dest; count < len; count++)
-            {
-              if (*dp > X_UCHAR_MAX || *dp < 0)
-                (*range_error)++;
-              *ubp++ = *dp++;
-            }
-          break;
-        case NC_BYTE:
-          for (dp = (double *)src, bp = dest; count < len; count++)
-            {
-              if (*dp > X_SCHAR_MAX || *dp < X_SCHAR_MIN)
-                (*range_error)++;
-              *bp++ = *dp++;
-            }
-          break;
-        case NC_SHORT:
-          for (dp = (double *)src, sp = dest; count < len; count++)
-            {
-              if (*dp > X_SHORT_MAX || *dp < X_SHORT_MIN)
-                (*range_error)++;
-              *sp++ = *dp++;
-            }
-          break;
-        case NC_USHORT:
-          for (dp = (double *)src, usp = dest; count < len; count++)
-            {
-              if (*dp > X_USHORT_MAX || *dp < 0)
-                (*range_error)++;
-              *usp++ = *dp++;
-            }
-          break;
-        case NC_UINT:
-          for (dp = (double *)src, uip = dest; count < len; count++)
+          if (!dim->coord_var)
             {
-              if (*dp > X_UINT_MAX || *dp < 0)
-                (*range_error)++;
-              *uip++ = *dp++;
+              if ((retval = write_dim(dim, grp, bad_coord_order)))
+                return retval;
             }
-          break;
-        case NC_INT:
-          if (dest_long)
-            for (dp = (double *)src, lp = dest; count < len; count++)
-              {
-                if (*dp > X_LONG_MAX || *dp < X_LONG_MIN)
-                  (*range_error)++;
-                *lp++ = *dp++;
-              }
           else
-            for (dp = (double *)src, ip = dest; count < len; count++)
-              {
-                if (*dp > X_INT_MAX || *dp < X_INT_MIN)
-                  (*range_error)++;
-                *ip++ = *dp++;
-              }
-          break;
-        case NC_INT64:
-          for (dp = (double *)src, lip = dest; count < len; count++)
-            {
-              if (*dp > X_INT64_MAX || *dp < X_INT64_MIN)
-                (*range_error)++;
-              *lip++ = *dp++;
-            }
-          break;
-        case NC_UINT64:
-          for (dp = (double *)src, lip = dest; count < len; count++)
-            {
-              if (*dp > X_UINT64_MAX || *dp < 0)
-                (*range_error)++;
-              *lip++ = *dp++;
-            }
-          break;
-        case NC_FLOAT:
-          for (dp = (double *)src, fp = dest; count < len; count++)
             {
-              if (*dp > X_FLOAT_MAX || *dp < X_FLOAT_MIN)
-                (*range_error)++;
-              *fp++ = *dp++;
-            }
-          break;
-        case NC_DOUBLE:
-          for (dp = (double *)src, dp1 = dest; count < len; count++)
-            {
-              /* if (*dp > X_DOUBLE_MAX || *dp < X_DOUBLE_MIN) */
-              /*    (*range_error)++; */
-              *dp1++ = *dp++;
+              coord_varid = dim->coord_var->varid;
+              found_coord = NC_TRUE;
             }
-          break;
-        default:
-          LOG((0, "%s: unexpected dest type. src_type %d, dest_type %d",
-               __func__, src_type, dest_type));
-          return NC_EBADTYPE;
         }
-      break;
 
-    default:
-      LOG((0, "%s: unexpected src type. src_type %d, dest_type %d",
-           __func__, src_type, dest_type));
-      return NC_EBADTYPE;
+      /* Write each var. When we get to the coord var we are waiting
+       * for (if any), then we break after writing it. */
+      for (wrote_coord = NC_FALSE; var && !wrote_coord; var = var->l.next)
+        {
+          if ((retval = write_var(var, grp, bad_coord_order)))
+            return retval;
+          if (found_coord && var->varid == coord_varid)
+            wrote_coord = NC_TRUE;
+        }
+    } /* end while */
+
+  if ((retval = attach_dimscales(grp)))
+    return retval;
+
+  /* If there are any child groups, write their metadata. */
+  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
+    if ((retval = nc4_rec_write_metadata(child_grp, bad_coord_order)))
+      return retval;
+
+  return NC_NOERR;
+}
+
+/* Recursively shrink the datasets that were over-allocated by
+ * appends in NC_APPEND_GEOMETRIC mode back to the extent of the data
+ * actually written. */
+int
+nc4_rec_trim_extents(NC_GRP_INFO_T *grp)
+{
+  NC_VAR_INFO_T *var;
+  NC_GRP_INFO_T *child_grp;
+  int retval;
+
+  assert(grp && grp->name);
+  LOG((3, "%s: grp->name %s", __func__, grp->name));
+
+  for (var = grp->var; var; var = var->l.next)
+    {
+      if (!var->overallocated || !var->hdf_datasetid)
+        continue;
+      assert(var->logical_dims);
+      LOG((4, "%s: trimming var %s", __func__, var->name));
+      if (H5Dset_extent(var->hdf_datasetid, var->logical_dims) < 0)
+        return NC_EHDFERR;
+      var->overallocated = NC_FALSE;
+      nc4_release_file_space(var);
+    }
+
+  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
+    if ((retval = nc4_rec_trim_extents(child_grp)))
+      return retval;
+
+  return NC_NOERR;
+}
+
+/* Recursively write all groups and types. */
+int
+nc4_rec_write_groups_types(NC_GRP_INFO_T *grp)
+{
+  NC_GRP_INFO_T *child_grp;
+  NC_TYPE_INFO_T *type;
+  int retval;
+
+  assert(grp && grp->name);
+  LOG((3, "%s: grp->name %s", __func__, grp->name));
+
+  /* Create the group in the HDF5 file if it doesn't exist. */
+  if (!grp->hdf_grpid)
+    if ((retval = create_group(grp)))
+      return retval;
+
+  /* If this is the root group of a file with strict NC3 rules, write
+   * an attribute. But don't leave the attribute open. */
+  if (!grp->parent && (grp->nc4_info->cmode & NC_CLASSIC_MODEL))
+    if ((retval = write_nc3_strict_att(grp->hdf_grpid)))
+      return retval;
+
+  /* If there are any user-defined types, write them now. */
+  for (type = grp->type; type; type = type->l.next)
+    if ((retval = commit_type(grp, type)))
+      return retval;
+
+  /* If there are any child groups, write their groups and types. */
+  for (child_grp = grp->children; child_grp; child_grp = child_grp->l.next)
+    if ((retval = nc4_rec_write_groups_types(child_grp)))
+      return retval;
+
+  return NC_NOERR;
+}
+
+/* One dimension in the table of dimensions by HDF5 object id, used
+ * to match the dimscales attached to vars with their dims. */
+typedef struct DIM_OBJID
+{
+  struct DIM_OBJID *next;       /* Next in this hash bucket */
+  NC_DIM_INFO_T *dim;
+  NC_GRP_INFO_T *grp;           /* The group of the dim */
+} DIM_OBJID_T;
+
+typedef struct DIM_OBJID_TABLE
+{
+  size_t nbuckets;              /* A power of two, or 0 until built */
+  DIM_OBJID_T **buckets;
+  DIM_OBJID_T *entries;
+} DIM_OBJID_TABLE_T;
+
+#define DIM_OBJID_BUCKET(table, objid) \
+  (hash_fast((objid), sizeof(HDF5_OBJID_T)) & ((table)->nbuckets - 1))
+
+static size_t
+rec_count_dims(const NC_GRP_INFO_T *grp)
+{
+  const NC_GRP_INFO_T *g;
+  size_t n = (size_t)grp->ndims;
+
+  for (g = grp->children; g; g = g->l.next)
+    n += rec_count_dims(g);
+  return n;
+}
+
+static void
+rec_add_dim_objids(DIM_OBJID_TABLE_T *table, NC_GRP_INFO_T *grp, size_t *n)
+{
+  NC_GRP_INFO_T *g;
+  NC_DIM_INFO_T *dim;
+  DIM_OBJID_T *entry;
+  size_t b;
+
+  for (dim = grp->dim; dim; dim = dim->l.next)
+    {
+      entry = &table->entries[(*n)++];
+      entry->dim = dim;
+      entry->grp = grp;
+      b = DIM_OBJID_BUCKET(table, &dim->hdf5_objid);
+      entry->next = table->buckets[b];
+      table->buckets[b] = entry;
     }
+  for (g = grp->children; g; g = g->l.next)
+    rec_add_dim_objids(table, g, n);
+}
+
+/* Build the table of all the dims in the file, the first time a var
+ * needs it. */
+static int
+build_dim_objids(DIM_OBJID_TABLE_T *table, NC_GRP_INFO_T *root_grp)
+{
+  size_t ndims = rec_count_dims(root_grp), n = 0;
+
+  table->nbuckets = 16;
+  while (table->nbuckets < 2 * ndims)
+    table->nbuckets *= 2;
+  if (!(table->buckets = calloc(table->nbuckets, sizeof(DIM_OBJID_T *))))
+    return NC_ENOMEM;
+  if (ndims && !(table->entries = malloc(ndims * sizeof(DIM_OBJID_T))))
+    return NC_ENOMEM;
+  rec_add_dim_objids(table, root_grp, &n);
   return NC_NOERR;
 }
 
+/* Find the dim with an HDF5 object id in grp or the nearest of its
+ * parents, as a var in grp sees it. */
+static NC_DIM_INFO_T *
+find_dim_objid(const DIM_OBJID_TABLE_T *table, NC_GRP_INFO_T *grp,
+               const HDF5_OBJID_T *objid)
+{
+  DIM_OBJID_T *entry;
+  NC_DIM_INFO_T *found = NULL;
+  NC_GRP_INFO_T *g;
+  int depth, found_depth = 0;
+
+  for (entry = table->buckets[DIM_OBJID_BUCKET(table, objid)]; entry;
+       entry = entry->next)
+    if (objid->fileno[0] == entry->dim->hdf5_objid.fileno[0] &&
+        objid->objno[0] == entry->dim->hdf5_objid.objno[0] &&
+        objid->fileno[1] == entry->dim->hdf5_objid.fileno[1] &&
+        objid->objno[1] == entry->dim->hdf5_objid.objno[1])
+      {
+        for (g = grp, depth = 0; g && g != entry->grp; g = g->parent)
+          depth++;
+        if (g && (!found || depth < found_depth))
+          {
+            found = entry->dim;
+            found_depth = depth;
+          }
+      }
+  return found;
+}
+
 /* In our first pass through the data, we may have encountered
  * variables before encountering their dimscales, so go through the
  * vars in this file and make sure we've got a dimid for each. */
-int
-nc4_rec_match_dimscales(NC_GRP_INFO_T *grp)
+static int
+rec_match_dimscales(NC_GRP_INFO_T *grp, DIM_OBJID_TABLE_T *table)
 {
   NC_GRP_INFO_T *g;
   NC_VAR_INFO_T *var;
@@ -3571,7 +3586,7 @@ nc4_rec_match_dimscales(NC_GRP_INFO_T *grp)
 
   /* Perform var dimscale match for child groups. */
   for (g = grp->children; g; g = g->l.next)
-    if ((retval = nc4_rec_match_dimscales(g)))
+    if ((retval = rec_match_dimscales(g, table)))
       return retval;
 
   /* Check all the vars in this group. If they have dimscale info,
@@ -3594,35 +3609,45 @@ nc4_rec_match_dimscales(NC_GRP_INFO_T *grp)
         {
           int d;
 
+          /* The dimids read from the coordinates attribute can be
+           * trusted if each names a dim whose dimid was also read from
+           * the file. If not, use the dimscales attached to the var. */
+          if (var->coords_read)
+            {
+              var->coords_read = NC_FALSE;
+              for (d = 0; d < var->ndims; d++)
+                {
+                  if (nc4_find_dim(grp, var->dimids[d], &dim, NULL) ||
+                      !dim->dimid_in_file)
+                    break;
+                  var->dim[d] = dim;
+                }
+              if (d == var->ndims)
+                continue;
+              LOG((3, "%s: coordinates of var %s don't match, reading dimscales",
+                   __func__, var->name));
+              free(var->dimscale_attached);
+              var->dimscale_attached = NULL;
+              if ((retval = nc4_read_dimscale_objids(var)))
+                return retval;
+            }
+
           /* Are there dimscales for this variable? */
           if (var->dimscale_hdf5_objids)
             {
+              if (!table->nbuckets &&
+                  (retval = build_dim_objids(table, grp->nc4_info->root_grp)))
+                return retval;
               for (d = 0; d < var->ndims; d++)
                 {
-                  nc_bool_t finished = NC_FALSE;
-
                   LOG((5, "%s: var %s has dimscale info...", __func__, var->name));
-                  /* Look at all the dims in this group to see if they
-                   * match. */
-                  for (g = grp; g && !finished; g = g->parent)
+                  if ((dim = find_dim_objid(table, grp, &var->dimscale_hdf5_objids[d])))
                     {
-                      for (dim = g->dim; dim; dim = dim->l.next)
-                        {
-                          if (var->dimscale_hdf5_objids[d].fileno[0] == dim->hdf5_objid.fileno[0] &&
-                              var->dimscale_hdf5_objids[d].objno[0] == dim->hdf5_objid.objno[0] &&
-                              var->dimscale_hdf5_objids[d].fileno[1] == dim->hdf5_objid.fileno[1] &&
-                              var->dimscale_hdf5_objids[d].objno[1] == dim->hdf5_objid.objno[1])
-                            {
-                              LOG((4, "%s: for dimension %d, found dim %s",
-                                   __func__, d, dim->name));
-                              var->dimids[d] = dim->dimid;
-                              var->dim[d] = dim;
-                              finished = NC_TRUE;
-                              break;
-                            }
-                        } /* next dim */
-                    } /* next grp */
-                  LOG((5, "%s: dimid for this dimscale is %d", __func__, var->type_info->nc_typeid));
+                      LOG((4, "%s: for dimension %d, found dim %s",
+                           __func__, d, dim->name));
+                      var->dimids[d] = dim->dimid;
+                      var->dim[d] = dim;
+                    }
                 } /* next var->dim */
             }
           /* No dimscales for this var! Invent phony dimensions. */
@@ -3730,6 +3755,20 @@ nc4_rec_match_dimscales(NC_GRP_INFO_T *grp)
   return retval;
 }
 
+/* Match the vars of a file with their dims, after its metadata is
+ * read. */
+int
+nc4_rec_match_dimscales(NC_GRP_INFO_T *grp)
+{
+  DIM_OBJID_TABLE_T table = {0, NULL, NULL};
+  int retval;
+
+  retval = rec_match_dimscales(grp, &table);
+  free(table.buckets);
+  free(table.entries);
+  return retval;
+}
+
 /* Get the length, in bytes, of one element of a type in memory. */
 int
 nc4_get_typelen_mem(NC_HDF5_FILE_INFO_T *h5, nc_type xtype, int is_long,
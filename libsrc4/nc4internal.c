@@ -26,6 +26,7 @@ conditions.
 extern size_t nc4_chunk_cache_size;
 extern size_t nc4_chunk_cache_nelems;
 extern float nc4_chunk_cache_preemption;
+extern size_t nc4_point_cache_size;
 
 /* This is to track opened HDF5 objects to make sure they are
  * closed. */
@@ -53,6 +54,8 @@ nc4_hdf5_initialize(void)
     if (H5Eset_auto(NULL, NULL) < 0)
 	LOG((0, "Couldn't turn off HDF5 error messages!"));
     LOG((1, "HDF5 error messages have been turned off."));
+    if (nc4_filter_initialize())
+	LOG((0, "Couldn't register the filters of the library!"));
     nc4_hdf5_initialized = 1;
 }
 
@@ -107,6 +110,15 @@ find_var_dim_max_length(NC_GRP_INFO_T *grp, int varid, int dimid, size_t *maxlen
    {
      *maxlen = 0;
    }
+   else if (var->logical_dims)
+   {
+     /* The extent of the data in the dataset is already known. This
+      * is the only way to learn it once the dataset has been
+      * over-allocated. */
+     for (d = 0; d < var->ndims; d++)
+       if (var->dimids[d] == dimid && var->logical_dims[d] > *maxlen)
+	 *maxlen = var->logical_dims[d];
+   }
    else
    {
      /* Get the number of records in the dataset. */
@@ -144,6 +156,10 @@ find_var_dim_max_length(NC_GRP_INFO_T *grp, int varid, int dimid, size_t *maxlen
 	   *maxlen = *maxlen > h5dimlen[d] ? *maxlen : h5dimlen[d];
 	 }
        }
+
+       /* Keep the extent, so the next query need not ask HDF5. */
+       var->logical_dims = h5dimlen;
+       h5dimlen = NULL;
      }
    }
 
@@ -181,6 +197,10 @@ nc4_nc4f_list_add(NC *nc, const char *path, int mode)
     * types. */
    h5->next_typeid = NC_FIRSTUSERTYPEID;
 
+   /* Point reads are cached up to the size set when the file is
+    * opened. */
+   h5->point_cache_size = nc4_point_cache_size;
+
    /* There's always at least one open group - the root
     * group. Allocate space for one group's worth of information. Set
     * its hdf id, name, and a pointer to it's file structure. */
@@ -207,7 +227,7 @@ nc4_find_nc4_grp(int ncid, NC_GRP_INFO_T **grp)
    if (h5->cmode & NC_CLASSIC_MODEL) return NC_ESTRICTNC3;
 
    /* If we can't find it, the grp id part of ncid is bad. */
-   if (!(*grp = nc4_rec_find_grp(h5->root_grp, (ncid & GRP_ID_MASK))))
+   if (!(*grp = nc4_find_grp_id(h5, (ncid & GRP_ID_MASK))))
       return NC_EBADID;
    return NC_NOERR;
 }
@@ -225,7 +245,7 @@ nc4_find_grp_h5(int ncid, NC_GRP_INFO_T **grpp, NC_HDF5_FILE_INFO_T **h5p)
     if (h5) {
         assert(h5->root_grp);
         /* If we can't find it, the grp id part of ncid is bad. */
-	if (!(grp = nc4_rec_find_grp(h5->root_grp, (ncid & GRP_ID_MASK))))
+	if (!(grp = nc4_find_grp_id(h5, (ncid & GRP_ID_MASK))))
   	    return NC_EBADID;
 	h5 = (grp)->nc4_info;
 	assert(h5);
@@ -252,7 +272,7 @@ nc4_find_nc_grp_h5(int ncid, NC **nc, NC_GRP_INFO_T **grpp,
     if (h5) {
 	assert(h5->root_grp);
 	/* If we can't find it, the grp id part of ncid is bad. */
-	if (!(grp = nc4_rec_find_grp(h5->root_grp, (ncid & GRP_ID_MASK))))
+	if (!(grp = nc4_find_grp_id(h5, (ncid & GRP_ID_MASK))))
 	       return NC_EBADID;
 
 	h5 = (grp)->nc4_info;
@@ -266,26 +286,198 @@ nc4_find_nc_grp_h5(int ncid, NC **nc, NC_GRP_INFO_T **grpp,
     return NC_NOERR;
 }
 
-/* Recursively hunt for a group id. */
+/* Find a group by its id, in the index of the file's groups. */
 NC_GRP_INFO_T *
-nc4_rec_find_grp(NC_GRP_INFO_T *start_grp, int target_nc_grpid)
+nc4_find_grp_id(const NC_HDF5_FILE_INFO_T *h5, int nc_grpid)
 {
-   NC_GRP_INFO_T *g, *res;
+   assert(h5);
+   if (nc_grpid < 0 || nc_grpid >= h5->grp_index_len)
+      return NULL;
+   return h5->grp_index[nc_grpid];
+}
 
-   assert(start_grp);
+/* Make room in an index for entry n. The index doubles as it grows,
+ * so adding groups or types one at a time is cheap. */
+static int
+grow_index(void ***indexp, int *lenp, int n)
+{
+   void **index;
+   int len = *lenp ? *lenp : 16;
+
+   if (n < *lenp)
+      return NC_NOERR;
+   while (len <= n)
+      len *= 2;
+   if (!(index = realloc(*indexp, (size_t)len * sizeof(void *))))
+      return NC_ENOMEM;
+   memset(index + *lenp, 0, (size_t)(len - *lenp) * sizeof(void *));
+   *indexp = index;
+   *lenp = len;
+   return NC_NOERR;
+}
 
-   /* Is this the group we are searching for? */
-   if (start_grp->nc_grpid == target_nc_grpid)
-      return start_grp;
+/* Get the full name of a group, as nc_inq_grpname_full() gives it,
+ * in memory the caller must free. */
+int
+nc4_grp_full_name(const NC_GRP_INFO_T *grp, char **full_name)
+{
+   const NC_GRP_INFO_T *g;
+   size_t len = 0, n;
+   char *name;
+
+   assert(grp && full_name);
+   for (g = grp; g->parent; g = g->parent)
+      len += strlen(g->name) + 1;
+   if (!(name = malloc(len ? len + 1 : 2)))
+      return NC_ENOMEM;
 
-   /* Shake down the kids. */
-   if (start_grp->children)
-      for (g = start_grp->children; g; g = g->l.next)
-	 if ((res = nc4_rec_find_grp(g, target_nc_grpid)))
-	    return res;
+   /* Fill in the names from the end, walking up to the root. */
+   strcpy(name, "/");
+   if (len)
+      name[len] = 0;
+   for (g = grp; g->parent; g = g->parent)
+   {
+      n = strlen(g->name);
+      len -= n;
+      memcpy(name + len, g->name, n);
+      name[--len] = '/';
+   }
+   *full_name = name;
+   return NC_NOERR;
+}
 
-   /* Can't find it. Fate, why do you mock me? */
-   return NULL;
+/* One group in the table of groups by full name. */
+typedef struct NC4_GRP_PATH
+{
+   struct NC4_GRP_PATH *next;   /* Next in this hash bucket */
+   uint32_t hash;
+   char *full_name;
+   NC_GRP_INFO_T *grp;
+} NC4_GRP_PATH_T;
+
+/* The table of groups by full name. It is built the first time a
+ * group is looked up by name, added to as groups are defined, and
+ * dropped when a group is renamed or deleted, since that changes the
+ * names of all the groups below it. */
+struct NC4_GRP_PATHS
+{
+   size_t nbuckets;             /* Always a power of two */
+   size_t count;
+   NC4_GRP_PATH_T **buckets;
+};
+
+#define GRP_PATHS_MIN_BUCKETS 64
+
+/* Add a group to the table, doubling the buckets when the chains
+ * get long. */
+static int
+grp_paths_add(struct NC4_GRP_PATHS *paths, NC_GRP_INFO_T *grp)
+{
+   NC4_GRP_PATH_T *path, *next, **buckets;
+   size_t b, nbuckets;
+   int retval;
+
+   if (paths->count >= paths->nbuckets)
+   {
+      nbuckets = paths->nbuckets ? 2 * paths->nbuckets : GRP_PATHS_MIN_BUCKETS;
+      if (!(buckets = calloc(nbuckets, sizeof(NC4_GRP_PATH_T *))))
+	 return NC_ENOMEM;
+      for (b = 0; b < paths->nbuckets; b++)
+	 for (path = paths->buckets[b]; path; path = next)
+	 {
+	    next = path->next;
+	    path->next = buckets[path->hash & (nbuckets - 1)];
+	    buckets[path->hash & (nbuckets - 1)] = path;
+	 }
+      free(paths->buckets);
+      paths->buckets = buckets;
+      paths->nbuckets = nbuckets;
+   }
+
+   if (!(path = malloc(sizeof(NC4_GRP_PATH_T))))
+      return NC_ENOMEM;
+   if ((retval = nc4_grp_full_name(grp, &path->full_name)))
+   {
+      free(path);
+      return retval;
+   }
+   path->hash = hash_fast(path->full_name, strlen(path->full_name));
+   path->grp = grp;
+   b = path->hash & (paths->nbuckets - 1);
+   path->next = paths->buckets[b];
+   paths->buckets[b] = path;
+   paths->count++;
+   return NC_NOERR;
+}
+
+void
+nc4_grp_paths_free(NC_HDF5_FILE_INFO_T *h5)
+{
+   NC4_GRP_PATH_T *path, *next;
+   size_t b;
+
+   if (!h5->grp_paths)
+      return;
+   for (b = 0; b < h5->grp_paths->nbuckets; b++)
+      for (path = h5->grp_paths->buckets[b]; path; path = next)
+      {
+	 next = path->next;
+	 free(path->full_name);
+	 free(path);
+      }
+   free(h5->grp_paths->buckets);
+   free(h5->grp_paths);
+   h5->grp_paths = NULL;
+}
+
+/* Find a group by its full name, which must be normalized. */
+int
+nc4_find_grp_full_name(NC_HDF5_FILE_INFO_T *h5, const char *full_name,
+		       NC_GRP_INFO_T **grp)
+{
+   NC4_GRP_PATH_T *path;
+   uint32_t hash;
+   int g, retval;
+
+   assert(h5 && full_name && grp);
+
+   /* Build the table on first use. */
+   if (!h5->grp_paths)
+   {
+      if (!(h5->grp_paths = calloc(1, sizeof(struct NC4_GRP_PATHS))))
+	 return NC_ENOMEM;
+      for (g = 0; g < h5->grp_index_len; g++)
+	 if (h5->grp_index[g] &&
+	     (retval = grp_paths_add(h5->grp_paths, h5->grp_index[g])))
+	 {
+	    nc4_grp_paths_free(h5);
+	    return retval;
+	 }
+   }
+
+   hash = hash_fast(full_name, strlen(full_name));
+   if (h5->grp_paths->nbuckets)
+      for (path = h5->grp_paths->buckets[hash & (h5->grp_paths->nbuckets - 1)];
+	   path; path = path->next)
+	 if (path->hash == hash && !strcmp(path->full_name, full_name))
+	 {
+	    *grp = path->grp;
+	    return NC_NOERR;
+	 }
+   return NC_ENOGRP;
+}
+
+/* Free the indexes of groups and types, when the file is closed. */
+void
+nc4_free_indexes(NC_HDF5_FILE_INFO_T *h5)
+{
+   nc4_grp_paths_free(h5);
+   free(h5->grp_index);
+   h5->grp_index = NULL;
+   h5->grp_index_len = 0;
+   free(h5->type_index);
+   h5->type_index = NULL;
+   h5->type_index_len = 0;
 }
 
 /* Given an ncid and varid, get pointers to the group and var
@@ -298,7 +490,7 @@ nc4_find_g_var_nc(NC *nc, int ncid, int varid,
 
    /* Find the group info. */
    assert(grp && var && h5 && h5->root_grp);
-   *grp = nc4_rec_find_grp(h5->root_grp, (ncid & GRP_ID_MASK));
+   *grp = nc4_find_grp_id(h5, (ncid & GRP_ID_MASK));
 
    /* It is possible for *grp to be NULL. If it is,
       return an error. */
@@ -360,88 +552,55 @@ nc4_find_var(NC_GRP_INFO_T *grp, const char *name, NC_VAR_INFO_T **var)
    return NC_NOERR;
 }
 
-/* Recursively hunt for a HDF type id. */
+/* Find a type equal to an HDF type id. The types are tried in the
+ * order they were added to the file, which for a file that was read
+ * is the order of a depth-first walk of its groups. */
 NC_TYPE_INFO_T *
-nc4_rec_find_hdf_type(NC_GRP_INFO_T *start_grp, hid_t target_hdf_typeid)
+nc4_find_hdf_type(const NC_HDF5_FILE_INFO_T *h5, hid_t target_hdf_typeid)
 {
-   NC_GRP_INFO_T *g;
-   NC_TYPE_INFO_T *type, *res;
+   NC_TYPE_INFO_T *type;
    htri_t equal;
+   int t;
 
-   assert(start_grp);
-
-   /* Does this group have the type we are searching for? */
-   for (type = start_grp->type; type; type = type->l.next)
+   assert(h5);
+   for (t = NC_FIRSTUSERTYPEID; t < h5->type_index_len; t++)
    {
+      if (!(type = h5->type_index[t]))
+	 continue;
       if ((equal = H5Tequal(type->native_hdf_typeid ? type->native_hdf_typeid : type->hdf_typeid, target_hdf_typeid)) < 0)
 	 return NULL;
       if (equal)
 	 return type;
    }
 
-   /* Shake down the kids. */
-   if (start_grp->children)
-      for (g = start_grp->children; g; g = g->l.next)
-	 if ((res = nc4_rec_find_hdf_type(g, target_hdf_typeid)))
-	    return res;
-
    /* Can't find it. Fate, why do you mock me? */
    return NULL;
 }
 
-/* Recursively hunt for a netCDF type by name. */
+/* Find a netCDF type by name, anywhere in the file. */
 NC_TYPE_INFO_T *
-nc4_rec_find_named_type(NC_GRP_INFO_T *start_grp, char *name)
+nc4_find_named_type(const NC_HDF5_FILE_INFO_T *h5, const char *name)
 {
-   NC_GRP_INFO_T *g;
-   NC_TYPE_INFO_T *type, *res;
-
-   assert(start_grp);
+   NC_TYPE_INFO_T *type;
+   int t;
 
-   /* Does this group have the type we are searching for? */
-   for (type = start_grp->type; type; type = type->l.next)
-      if (!strcmp(type->name, name))
+   assert(h5 && name);
+   for (t = NC_FIRSTUSERTYPEID; t < h5->type_index_len; t++)
+      if ((type = h5->type_index[t]) && !strcmp(type->name, name))
 	 return type;
 
-   /* Search subgroups. */
-   if (start_grp->children)
-      for (g = start_grp->children; g; g = g->l.next)
-	 if ((res = nc4_rec_find_named_type(g, name)))
-	    return res;
-
    /* Can't find it. Oh, woe is me! */
    return NULL;
 }
 
-/* Recursively hunt for a netCDF type id. */
+/* Find a netCDF type by its id, in the index of the file's types. */
 NC_TYPE_INFO_T *
-nc4_rec_find_nc_type(const NC_GRP_INFO_T *start_grp, nc_type target_nc_typeid)
+nc4_find_nc_type(const NC_HDF5_FILE_INFO_T *h5, nc_type typeid1)
 {
-   NC_TYPE_INFO_T *type;
-
-   assert(start_grp);
-
-   /* Does this group have the type we are searching for? */
-   for (type = start_grp->type; type; type = type->l.next)
-      if (type->nc_typeid == target_nc_typeid)
-	 return type;
-
-   /* Shake down the kids. */
-   if (start_grp->children)
-   {
-      NC_GRP_INFO_T *g;
-
-      for (g = start_grp->children; g; g = g->l.next)
-      {
-         NC_TYPE_INFO_T *res;
-
-	 if ((res = nc4_rec_find_nc_type(g, target_nc_typeid)))
-	    return res;
-      }
-   }
-
-   /* Can't find it. Fate, why do you mock me? */
-   return NULL;
+   assert(h5);
+   if (typeid1 < 0 || typeid1 >= h5->type_index_len)
+      return NULL;
+   return h5->type_index[typeid1];
 }
 
 /* Use a netCDF typeid to find a type in a type_list. */
@@ -458,7 +617,7 @@ nc4_find_type(const NC_HDF5_FILE_INFO_T *h5, nc_type typeid, NC_TYPE_INFO_T **ty
       return NC_NOERR;
 
    /* Find the type. */
-   if(!(*type = nc4_rec_find_nc_type(h5->root_grp, typeid)))
+   if(!(*type = nc4_find_nc_type(h5, typeid)))
       return NC_EBADTYPID;
 
    return NC_NOERR;
@@ -608,24 +767,25 @@ nc4_find_nc_file(int ext_ncid, NC_HDF5_FILE_INFO_T** h5p)
    return nc;
 }
 
-/* Add object to the end of a list. */
+/* Add object to the end of a list. The prev pointer of the first
+ * object points at the last one, so that adding is quick however long
+ * the list; the next pointer of the last object is NULL. */
 static void
 obj_list_add(NC_LIST_NODE_T **list, NC_LIST_NODE_T *obj)
 {
-   /* Go to the end of the list and set the last one to point at object,
-    * or, if the list is empty, our new object becomes the list. */
    if(*list)
    {
-      NC_LIST_NODE_T *o;
+      NC_LIST_NODE_T *last = (*list)->prev;
 
-      for (o = *list; o; o = o->next)
-	 if (!o->next)
-	    break;
-      o->next = obj;
-      obj->prev = o;
+      last->next = obj;
+      obj->prev = last;
+      (*list)->prev = obj;
    }
    else
+   {
       *list = obj;
+      obj->prev = obj;
+   }
 }
 
 /* Remove object from a list. */
@@ -634,12 +794,19 @@ obj_list_del(NC_LIST_NODE_T **list, NC_LIST_NODE_T *obj)
 {
    /* Remove the var from the linked list. */
    if(*list == obj)
+   {
       *list = obj->next;
+      if(*list)
+	 (*list)->prev = obj->prev;
+   }
    else
+   {
       ((NC_LIST_NODE_T *)obj->prev)->next = obj->next;
-
-   if(obj->next)
-      ((NC_LIST_NODE_T *)obj->next)->prev = obj->prev;
+      if(obj->next)
+	 ((NC_LIST_NODE_T *)obj->next)->prev = obj->prev;
+      else
+	 (*list)->prev = obj->prev;
+   }
 }
 
 /* Add to the end of a var list. Return a pointer to the newly
@@ -714,6 +881,8 @@ nc4_grp_list_add(NC_GRP_INFO_T **list, int new_nc_grpid,
 		 char *name, NC_GRP_INFO_T **grp)
 {
    NC_GRP_INFO_T *new_grp;
+   NC_HDF5_FILE_INFO_T *h5;
+   int retval;
 
    LOG((3, "%s: new_nc_grpid %d name %s ", __func__, new_nc_grpid, name));
 
@@ -729,7 +898,20 @@ nc4_grp_list_add(NC_GRP_INFO_T **list, int new_nc_grpid,
       free(new_grp);
       return NC_ENOMEM;
    }
-   new_grp->nc4_info = NC4_DATA(nc);
+   new_grp->nc4_info = h5 = NC4_DATA(nc);
+
+   /* Index the group by its id, and by its full name if groups have
+    * been looked up that way. */
+   if ((retval = grow_index((void ***)&h5->grp_index, &h5->grp_index_len,
+			    new_nc_grpid)))
+   {
+      free(new_grp->name);
+      free(new_grp);
+      return retval;
+   }
+   h5->grp_index[new_nc_grpid] = new_grp;
+   if (h5->grp_paths && (retval = grp_paths_add(h5->grp_paths, new_grp)))
+      nc4_grp_paths_free(h5);
 
    /* Add object to list */
    obj_list_add((NC_LIST_NODE_T **)list, (NC_LIST_NODE_T *)new_grp);
@@ -777,7 +959,14 @@ int
 nc4_type_list_add(NC_GRP_INFO_T *grp, size_t size, const char *name,
                   NC_TYPE_INFO_T **type)
 {
+   NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
    NC_TYPE_INFO_T *new_type;
+   int retval;
+
+   /* Make room for the type in the index of the file's types. */
+   if ((retval = grow_index((void ***)&h5->type_index, &h5->type_index_len,
+			    h5->next_typeid)))
+      return retval;
 
    /* Allocate memory for the type */
    if (!(new_type = calloc(1, sizeof(NC_TYPE_INFO_T))))
@@ -787,7 +976,8 @@ nc4_type_list_add(NC_GRP_INFO_T *grp, size_t size, const char *name,
    obj_list_add((NC_LIST_NODE_T **)(&grp->type), (NC_LIST_NODE_T *)new_type);
 
    /* Remember info about this type. */
-   new_type->nc_typeid = grp->nc4_info->next_typeid++;
+   new_type->nc_typeid = h5->next_typeid++;
+   h5->type_index[new_type->nc_typeid] = new_type;
    new_type->size = size;
    if (!(new_type->name = strdup(name)))
       return NC_ENOMEM;
@@ -1000,10 +1190,16 @@ nc4_var_list_del(NC_VAR_INFO_T **list, NC_VAR_INFO_T *var)
       att = a;
    }
 
+   /* Give back the memory charged for the chunk cache. */
+   nc4_release_chunk_cache(var);
+
    /* Free some things that may be allocated. */
    if (var->chunksizes)
      {free(var->chunksizes);var->chunksizes = NULL;}
 
+   if (var->params)
+     {free(var->params);var->params = NULL;}
+
    if (var->hdf5_name)
      {free(var->hdf5_name); var->hdf5_name = NULL;}
 
@@ -1016,6 +1212,11 @@ nc4_var_list_del(NC_VAR_INFO_T **list, NC_VAR_INFO_T *var)
    if (var->dim)
      {free(var->dim); var->dim = NULL;}
 
+   if (var->logical_dims)
+     {free(var->logical_dims); var->logical_dims = NULL;}
+
+   nc4_release_var_spaces(var);
+
    /* Delete any fill value allocation. This must be done before the
     * type_info is freed. */
    if (var->fill_value)
@@ -1168,6 +1369,8 @@ nc4_rec_grp_del(NC_GRP_INFO_T **list, NC_GRP_INFO_T *grp)
    {
       LOG((4, "%s: deleting type %s", __func__, type->name));
       t = type->l.next;
+      if (type->nc_typeid < grp->nc4_info->type_index_len)
+	 grp->nc4_info->type_index[type->nc_typeid] = NULL;
       if ((retval = type_list_del(&grp->type, type)))
 	 return retval;
       type = t;
@@ -1178,6 +1381,11 @@ nc4_rec_grp_del(NC_GRP_INFO_T **list, NC_GRP_INFO_T *grp)
    if (grp->hdf_grpid && H5Gclose(grp->hdf_grpid) < 0)
       return NC_EHDFERR;
 
+   /* Take the group out of the indexes. */
+   if (grp->nc_grpid < grp->nc4_info->grp_index_len)
+      grp->nc4_info->grp_index[grp->nc_grpid] = NULL;
+   nc4_grp_paths_free(grp->nc4_info);
+
    /* Free the name. */
    free(grp->name);
 
@@ -1274,6 +1482,7 @@ nc4_break_coord_var(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *coord_var, NC_DIM_INFO_T
    /* Set state transition indicators */
    coord_var->was_coord_var = NC_TRUE;
    coord_var->became_coord_var = NC_FALSE;
+   grp->nc4_info->dimids_preserved = NC_FALSE;
 
    return NC_NOERR;
 }
@@ -1359,6 +1568,7 @@ nc4_reform_coord_var(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var, NC_DIM_INFO_T *dim)
    else
       /* Set state transition indicator */
       var->became_coord_var = NC_TRUE;
+   grp->nc4_info->dimids_preserved = NC_FALSE;
 
   exit:
    return retval;
@@ -1564,3 +1774,145 @@ NC4_show_metadata(int ncid)
 #endif /*LOGGING*/
    return retval;
 }
+
+/* Charge the chunk cache of a var to the memory budget. The cache
+ * HDF5 is given, chunk_cache_charged, is the size the user asked for,
+ * chunk_cache_size, or whatever is left of the budget, which may be
+ * nothing. Called whenever the cache settings are handed to HDF5, so
+ * a cache shrunk by the budget grows back once there is room again;
+ * contiguous vars have no cache. */
+void
+nc4_charge_chunk_cache(NC_VAR_INFO_T *var)
+{
+   nc4_release_chunk_cache(var);
+   if (var->contiguous)
+      return;
+   var->chunk_cache_charged = NC_memory_grant(NC_MEM_CHUNK_CACHE,
+					      var->chunk_cache_size, 0);
+}
+
+/* Give back the memory charged for the chunk cache of a var. */
+void
+nc4_release_chunk_cache(NC_VAR_INFO_T *var)
+{
+   NC_memory_release(NC_MEM_CHUNK_CACHE, var->chunk_cache_charged);
+   var->chunk_cache_charged = 0;
+}
+
+/* Get the file's scratch buffer for type conversion, with room for at
+ * least size bytes. The buffer is kept, and reused by every converting
+ * read or write, until the file is closed. */
+int
+nc4_get_convert_buf(NC_HDF5_FILE_INFO_T *h5, size_t size, void **bufp)
+{
+   assert(h5 && bufp);
+   if (size > h5->convert_buf_size)
+   {
+      /* The old contents are not needed, so don't realloc. */
+      nc4_free_convert_buf(h5);
+      if (!(h5->convert_buf = malloc(size)))
+	 return NC_ENOMEM;
+      h5->convert_buf_size = size;
+      NC_memory_charge(NC_MEM_IO_BUFFERS, size);
+   }
+   *bufp = h5->convert_buf;
+   return NC_NOERR;
+}
+
+void
+nc4_free_convert_buf(NC_HDF5_FILE_INFO_T *h5)
+{
+   if (h5->convert_buf)
+   {
+      free(h5->convert_buf);
+      NC_memory_release(NC_MEM_IO_BUFFERS, h5->convert_buf_size);
+   }
+   h5->convert_buf = NULL;
+   h5->convert_buf_size = 0;
+}
+
+/* Estimate the memory held by a list of attributes. */
+static size_t
+att_list_memory(NC_HDF5_FILE_INFO_T *h5, NC_ATT_INFO_T *att)
+{
+   size_t n = 0, size;
+   int i;
+
+   for (; att; att = att->l.next)
+   {
+      n += sizeof(NC_ATT_INFO_T) + strlen(att->name) + 1;
+      if (att->data && !nc4_get_typelen_mem(h5, att->nc_typeid, 0, &size))
+	 n += size * att->len;
+      if (att->vldata)
+	 n += sizeof(nc_vlen_t) * att->len;
+      if (att->stdata)
+	 for (i = 0; i < att->len; i++)
+	    n += sizeof(char *) + (att->stdata[i] ? strlen(att->stdata[i]) + 1 : 0);
+   }
+   return n;
+}
+
+/* Add up the chunk caches of a group and its children, and estimate
+ * the memory held by their metadata. */
+static void
+rec_grp_memory(NC_HDF5_FILE_INFO_T *h5, NC_GRP_INFO_T *grp,
+	       nc_memory_usage_t *usage)
+{
+   NC_GRP_INFO_T *g;
+   NC_VAR_INFO_T *var;
+   NC_DIM_INFO_T *dim;
+   NC_TYPE_INFO_T *type;
+
+   usage->metadata += sizeof(NC_GRP_INFO_T) + strlen(grp->name) + 1;
+   usage->metadata += att_list_memory(h5, grp->att);
+   for (dim = grp->dim; dim; dim = dim->l.next)
+      usage->metadata += sizeof(NC_DIM_INFO_T) + strlen(dim->name) + 1;
+   for (type = grp->type; type; type = type->l.next)
+      usage->metadata += sizeof(NC_TYPE_INFO_T)
+	 + (type->name ? strlen(type->name) + 1 : 0);
+   for (var = grp->var; var; var = var->l.next)
+   {
+      usage->chunk_cache += var->chunk_cache_charged;
+      usage->metadata += sizeof(NC_VAR_INFO_T) + strlen(var->name) + 1
+	 + (var->hdf5_name ? strlen(var->hdf5_name) + 1 : 0)
+	 + var->ndims * (sizeof(int) + sizeof(NC_DIM_INFO_T *) + sizeof(size_t)
+			 + sizeof(nc_bool_t) + sizeof(HDF5_OBJID_T))
+	 + (var->fill_value && var->type_info ? var->type_info->size : 0)
+	 + (var->logical_dims ? var->ndims * sizeof(hsize_t) : 0)
+	 + att_list_memory(h5, var->att);
+   }
+   for (g = grp->children; g; g = g->l.next)
+      rec_grp_memory(h5, g, usage);
+}
+
+/* Report the chunk caches and metadata of a file. HDF5's own metadata
+ * cache is counted as metadata. */
+int
+NC4_inq_memory_usage(int ncid, nc_memory_usage_t *usagep)
+{
+   NC_HDF5_FILE_INFO_T *h5;
+   nc_memory_usage_t usage;
+
+   if (!nc4_find_nc_file(ncid, &h5))
+      return NC_EBADID;
+   assert(h5 && h5->root_grp);
+
+   memset(&usage, 0, sizeof(usage));
+   usage.metadata = sizeof(NC_HDF5_FILE_INFO_T);
+   usage.io_buffers = h5->convert_buf_size;
+   usage.chunk_cache = nc4_point_cache_used(h5);
+   rec_grp_memory(h5, h5->root_grp, &usage);
+#ifdef USE_HDF4
+   if (!h5->hdf4)
+#endif
+   {
+      size_t max_size, min_clean_size, cur_size;
+      int nentries;
+      if (H5Fget_mdc_size(h5->hdfid, &max_size, &min_clean_size, &cur_size,
+			  &nentries) >= 0)
+	 usage.metadata += cur_size;
+   }
+   if (usagep)
+      *usagep = usage;
+   return NC_NOERR;
+}
@@ -0,0 +1,1071 @@
+/** \file \internal
+The metadata index of a netcdf-4 file.
+
+Opening a netCDF-4 file the usual way visits every HDF5 object in it:
+each group, dataset, named type and attribute is opened and read. On
+parallel filesystems and network mounts each of these small reads is
+a round trip. A file may instead carry an index of its netCDF
+metadata - groups, types, dims, vars with their chunking, filter and
+fill settings, and attributes - written as one byte string in the
+hidden _NCMetadataIndex dataset of the root group, when the file is
+synced or closed with nc_set_metadata_index() turned on.
+
+A read-only open builds the metadata from the index instead of
+walking the file. Groups and named types are still opened, but the
+datasets of vars are only opened when their data is first read. The
+index is stamped with the size of the file, and the number of links
+and of attributes of the root group, when it is written, and is
+ignored if any of these has changed since, or if it was written on a
+machine of the other byte order. Changes made by other HDF5 writers
+that keep all three, such as rewriting an attribute of a var in
+place, are not seen: the index must not be trusted after such a
+writer has changed the file, and the writer should delete
+_NCMetadataIndex.
+
+Files with vlen types, attributes whose values have variable size, or
+vars of such types with a fill value, get no index; neither do files
+open for parallel I/O.
+
+Copyright 2016, University Corporation for Atmospheric
+Research. See the COPYRIGHT file for copying and redistribution
+conditions.
+*/
+#include "config.h"
+#include "nc4internal.h"
+#include "ncdispatch.h" /* from libdispatch */
+
+extern int nc4_get_default_fill_value(const NC_TYPE_INFO_T *type_info, void *fill_value);
+
+#define MD_MAGIC "NCMI"
+#define MD_VERSION 2
+#define MD_BYTE_ORDER 0x01020304 /* Read back in the order written */
+#define MD_CLASSIC 1             /* Header flag for NC_CLASSIC_MODEL */
+#define MD_COMPACT_MAX 32768     /* Largest index kept in its object header */
+#define MD_STAMP_LEN 3           /* File size, root links, root atts */
+
+/* The index as it is built. */
+typedef struct MD_BUF
+{
+   char *data;
+   size_t len;
+   size_t size;
+   int *ordinal;                /* Position of each user type, by typeid */
+   nc_bool_t unsupported;       /* True if the file can't be indexed */
+} MD_BUF;
+
+/* The index as it is read. */
+typedef struct MD_READER
+{
+   const char *p;
+   const char *end;
+   NC_TYPE_INFO_T **types;      /* User types, in the order indexed */
+   int ntypes;
+} MD_READER;
+
+static int
+md_put(MD_BUF *b, const void *p, size_t n)
+{
+   if (b->len + n > b->size)
+   {
+      size_t size = b->size ? b->size : 4096;
+      char *data;
+
+      while (size < b->len + n)
+	 size *= 2;
+      if (!(data = realloc(b->data, size)))
+	 return NC_ENOMEM;
+      b->data = data;
+      b->size = size;
+   }
+   memcpy(b->data + b->len, p, n);
+   b->len += n;
+   return NC_NOERR;
+}
+
+static int
+md_put_int(MD_BUF *b, int v)
+{
+   return md_put(b, &v, sizeof(v));
+}
+
+static int
+md_put_size(MD_BUF *b, size_t v)
+{
+   unsigned long long u = v;
+   return md_put(b, &u, sizeof(u));
+}
+
+/* A string is its length, or -1 for NULL, and its chars. */
+static int
+md_put_str(MD_BUF *b, const char *s)
+{
+   int len = s ? (int)strlen(s) : -1;
+   int retval;
+
+   if ((retval = md_put_int(b, len)))
+      return retval;
+   if (len > 0)
+      return md_put(b, s, (size_t)len);
+   return NC_NOERR;
+}
+
+static int
+md_get(MD_READER *r, void *p, size_t n)
+{
+   if ((size_t)(r->end - r->p) < n)
+      return NC_EHDFERR;
+   memcpy(p, r->p, n);
+   r->p += n;
+   return NC_NOERR;
+}
+
+static int
+md_get_int(MD_READER *r, int *v)
+{
+   return md_get(r, v, sizeof(*v));
+}
+
+static int
+md_get_size(MD_READER *r, size_t *v)
+{
+   unsigned long long u;
+   int retval;
+
+   if ((retval = md_get(r, &u, sizeof(u))))
+      return retval;
+   *v = (size_t)u;
+   return NC_NOERR;
+}
+
+static int
+md_get_str(MD_READER *r, char **s)
+{
+   int len, retval;
+
+   *s = NULL;
+   if ((retval = md_get_int(r, &len)))
+      return retval;
+   if (len < 0)
+      return NC_NOERR;
+   if ((size_t)(r->end - r->p) < (size_t)len)
+      return NC_EHDFERR;
+   if (!(*s = malloc((size_t)len + 1)))
+      return NC_ENOMEM;
+   memcpy(*s, r->p, (size_t)len);
+   (*s)[len] = 0;
+   r->p += len;
+   return NC_NOERR;
+}
+
+/* Is every value of this type the same size, with no pointers in it? */
+static nc_bool_t
+md_fixed_size(const NC_HDF5_FILE_INFO_T *h5, nc_type xtype)
+{
+   NC_TYPE_INFO_T *type;
+   NC_FIELD_INFO_T *field;
+
+   if (xtype == NC_STRING)
+      return NC_FALSE;
+   if (xtype < NC_STRING)
+      return NC_TRUE;
+   if (!(type = nc4_find_nc_type(h5, xtype)) || type->nc_type_class == NC_VLEN)
+      return NC_FALSE;
+   if (type->nc_type_class == NC_COMPOUND)
+      for (field = type->u.c.field; field; field = field->l.next)
+	 if (!md_fixed_size(h5, field->nc_typeid))
+	    return NC_FALSE;
+   return NC_TRUE;
+}
+
+/* The type of a var or att, as indexed: atomic types as they are,
+ * user types by their position in the index. */
+static int
+md_put_type(MD_BUF *b, nc_type xtype)
+{
+   if (xtype > NC_STRING)
+      xtype = NC_FIRSTUSERTYPEID + b->ordinal[xtype];
+   return md_put_int(b, xtype);
+}
+
+static int
+md_put_atts(MD_BUF *b, NC_HDF5_FILE_INFO_T *h5, NC_ATT_INFO_T *atts)
+{
+   NC_ATT_INFO_T *att;
+   size_t size;
+   int n, i, retval;
+
+   for (n = 0, att = atts; att; att = att->l.next)
+      n++;
+   if ((retval = md_put_int(b, n)))
+      return retval;
+   for (att = atts; att; att = att->l.next)
+   {
+      if (!md_fixed_size(h5, att->nc_typeid) && att->nc_typeid != NC_STRING)
+      {
+	 b->unsupported = NC_TRUE;
+	 return NC_NOERR;
+      }
+      if ((retval = md_put_str(b, att->name)) ||
+	  (retval = md_put_type(b, att->nc_typeid)) ||
+	  (retval = md_put_int(b, att->len)))
+	 return retval;
+      if (att->nc_typeid == NC_STRING)
+      {
+	 for (i = 0; i < att->len; i++)
+	    if ((retval = md_put_str(b, att->stdata ? att->stdata[i] : NULL)))
+	       return retval;
+      }
+      else if (att->len)
+      {
+	 if ((retval = nc4_get_typelen_mem(h5, att->nc_typeid, 0, &size)))
+	    return retval;
+	 if ((retval = md_put(b, att->data, size * (size_t)att->len)))
+	    return retval;
+      }
+   }
+   return NC_NOERR;
+}
+
+static int
+md_put_var(MD_BUF *b, NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var)
+{
+   NC_TYPE_INFO_T *type = var->type_info;
+   int endianness = type->endianness;
+   unsigned long long default_fill = 0; /* Room for any atomic value */
+   void *fill = var->fill_value;
+   int d, retval;
+
+   if (fill && !var->no_fill && type->nc_typeid != NC_STRING &&
+       !md_fixed_size(h5, type->nc_typeid))
+   {
+      b->unsupported = NC_TRUE;
+      return NC_NOERR;
+   }
+
+   /* Record the fill value as a read of the dataset would find it:
+    * the default one of its type if none was set, and none at all for
+    * a user type without one. */
+   if (var->no_fill)
+      fill = NULL;
+   else if (!fill && !nc4_get_default_fill_value(type, &default_fill))
+      fill = &default_fill;
+
+   /* Record the byte order the data was written in, as a read of the
+    * dataset type would find it. */
+   if (endianness == NC_ENDIAN_NATIVE &&
+       (type->nc_type_class == NC_INT || type->nc_type_class == NC_FLOAT))
+   {
+      int one = 1;
+      endianness = *(char *)&one ? NC_ENDIAN_LITTLE : NC_ENDIAN_BIG;
+   }
+
+   if ((retval = md_put_str(b, var->name)) ||
+       (retval = md_put_str(b, var->hdf5_name)) ||
+       (retval = md_put_int(b, var->ndims)))
+      return retval;
+   for (d = 0; d < var->ndims; d++)
+      if ((retval = md_put_int(b, var->dimids[d])))
+	 return retval;
+   if ((retval = md_put_type(b, type->nc_typeid)) ||
+       (retval = md_put_int(b, endianness)) ||
+       (retval = md_put_int(b, var->dimscale)) ||
+       (retval = md_put_int(b, var->contiguous || !var->chunksizes)))
+      return retval;
+   if (!var->contiguous && var->chunksizes)
+      for (d = 0; d < var->ndims; d++)
+	 if ((retval = md_put_size(b, var->chunksizes[d])))
+	    return retval;
+   if ((retval = md_put_int(b, var->shuffle)) ||
+       (retval = md_put_int(b, var->fletcher32)) ||
+       (retval = md_put_int(b, var->deflate)) ||
+       (retval = md_put_int(b, var->deflate_level)) ||
+       (retval = md_put_int(b, var->szip)) ||
+       (retval = md_put_int(b, var->options_mask)) ||
+       (retval = md_put_int(b, var->pixels_per_block)) ||
+       (retval = md_put_int(b, (int)var->filterid)) ||
+       (retval = md_put_int(b, (int)var->nparams)))
+      goto exit;
+   for (d = 0; d < (int)var->nparams; d++)
+      if ((retval = md_put_int(b, (int)var->params[d])))
+	 goto exit;
+   if ((retval = md_put_int(b, !fill)) ||
+       (retval = md_put_int(b, fill != NULL)))
+      goto exit;
+   if (fill)
+   {
+      if (type->nc_typeid == NC_STRING)
+	 retval = md_put_str(b, *(char **)fill);
+      else
+	 retval = md_put(b, fill, type->size);
+      if (retval)
+	 goto exit;
+   }
+   retval = md_put_atts(b, h5, var->att);
+
+exit:
+   if (fill == &default_fill && type->nc_typeid == NC_STRING)
+      free(*(char **)fill);
+   return retval;
+}
+
+/* Index the groups and their types, depth first. The position of
+ * each type is recorded, for vars and atts to refer to. */
+static int
+md_put_tree(MD_BUF *b, NC_GRP_INFO_T *grp, int *ntypes)
+{
+   NC_TYPE_INFO_T *type;
+   NC_GRP_INFO_T *child;
+   int n, retval;
+
+   for (n = 0, type = grp->type; type; type = type->l.next)
+      n++;
+   if ((retval = md_put_int(b, n)))
+      return retval;
+   for (type = grp->type; type; type = type->l.next)
+   {
+      if (type->nc_type_class == NC_VLEN || !type->committed)
+	 b->unsupported = NC_TRUE;
+      b->ordinal[type->nc_typeid] = (*ntypes)++;
+      if ((retval = md_put_str(b, type->name)))
+	 return retval;
+   }
+
+   for (n = 0, child = grp->children; child; child = child->l.next)
+      n++;
+   if ((retval = md_put_int(b, n)))
+      return retval;
+   for (child = grp->children; child; child = child->l.next)
+   {
+      if ((retval = md_put_str(b, child->name)))
+	 return retval;
+      if ((retval = md_put_tree(b, child, ntypes)))
+	 return retval;
+   }
+   return NC_NOERR;
+}
+
+/* Index the dims, vars and atts of each group, in the order of
+ * md_put_tree(). */
+static int
+md_put_grp(MD_BUF *b, NC_GRP_INFO_T *grp)
+{
+   NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
+   NC_DIM_INFO_T *dim;
+   NC_VAR_INFO_T *var;
+   NC_GRP_INFO_T *child;
+   int n, retval;
+
+   for (n = 0, dim = grp->dim; dim; dim = dim->l.next)
+      n++;
+   if ((retval = md_put_int(b, n)))
+      return retval;
+   for (dim = grp->dim; dim; dim = dim->l.next)
+      if ((retval = md_put_str(b, dim->name)) ||
+	  (retval = md_put_int(b, dim->dimid)) ||
+	  (retval = md_put_size(b, dim->len)) ||
+	  (retval = md_put_int(b, dim->unlimited)))
+	 return retval;
+
+   for (n = 0, var = grp->var; var; var = var->l.next)
+      n++;
+   if ((retval = md_put_int(b, n)))
+      return retval;
+   for (var = grp->var; var && !b->unsupported; var = var->l.next)
+      if ((retval = md_put_var(b, h5, var)))
+	 return retval;
+
+   if ((retval = md_put_atts(b, h5, grp->att)))
+      return retval;
+
+   for (child = grp->children; child && !b->unsupported; child = child->l.next)
+      if ((retval = md_put_grp(b, child)))
+	 return retval;
+   return NC_NOERR;
+}
+
+/* Get the stamp that tells whether the file has changed since the
+ * index was written. */
+static int
+md_stamp(NC_HDF5_FILE_INFO_T *h5, unsigned long long *stamp)
+{
+   hsize_t size;
+   H5G_info_t info;
+   int natts;
+
+   if (H5Fget_filesize(h5->hdfid, &size) < 0)
+      return NC_EHDFERR;
+   if (H5Gget_info(h5->root_grp->hdf_grpid, &info) < 0)
+      return NC_EHDFERR;
+   if ((natts = H5Aget_num_attrs(h5->root_grp->hdf_grpid)) < 0)
+      return NC_EHDFERR;
+   stamp[0] = size;
+   stamp[1] = info.nlinks;
+   stamp[2] = (unsigned long long)natts;
+   return NC_NOERR;
+}
+
+/* Stamp the index dataset. Everything else is in place once the
+ * file is flushed, so the stamp, which changes nothing but its own
+ * value, can be taken. */
+static int
+md_write_stamp(NC_HDF5_FILE_INFO_T *h5, hid_t datasetid)
+{
+   unsigned long long stamp[MD_STAMP_LEN];
+   hsize_t stamp_len = MD_STAMP_LEN;
+   hid_t attid, spaceid;
+   hssize_t len;
+   int retval;
+
+   /* An index written with a stamp of another length gets a new
+    * stamp attribute. */
+   if ((attid = H5Aopen(datasetid, NC_METADATA_STAMP_ATT_NAME, H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if ((spaceid = H5Aget_space(attid)) < 0)
+   {
+      H5Aclose(attid);
+      return NC_EHDFERR;
+   }
+   len = H5Sget_simple_extent_npoints(spaceid);
+   if (H5Sclose(spaceid) < 0 || H5Aclose(attid) < 0)
+      return NC_EHDFERR;
+   if (len != MD_STAMP_LEN)
+   {
+      if (H5Adelete(datasetid, NC_METADATA_STAMP_ATT_NAME) < 0)
+	 return NC_EHDFERR;
+      if ((spaceid = H5Screate_simple(1, &stamp_len, NULL)) < 0)
+	 return NC_EHDFERR;
+      attid = H5Acreate2(datasetid, NC_METADATA_STAMP_ATT_NAME, H5T_STD_U64LE,
+			 spaceid, H5P_DEFAULT, H5P_DEFAULT);
+      if (H5Sclose(spaceid) < 0 || attid < 0 || H5Aclose(attid) < 0)
+	 return NC_EHDFERR;
+   }
+
+   if (H5Fflush(h5->hdfid, H5F_SCOPE_GLOBAL) < 0)
+      return NC_EHDFERR;
+   if ((retval = md_stamp(h5, stamp)))
+      return retval;
+   if ((attid = H5Aopen(datasetid, NC_METADATA_STAMP_ATT_NAME, H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if (H5Awrite(attid, H5T_NATIVE_ULLONG, stamp) < 0)
+   {
+      H5Aclose(attid);
+      return NC_EHDFERR;
+   }
+   if (H5Aclose(attid) < 0)
+      return NC_EHDFERR;
+   return NC_NOERR;
+}
+
+/* Write the index into the file, reusing its dataset if it is the
+ * same size, and stamp it. */
+static int
+md_write(NC_HDF5_FILE_INFO_T *h5, const MD_BUF *b)
+{
+   hid_t grpid = h5->root_grp->hdf_grpid;
+   hid_t datasetid = -1, spaceid = -1, plistid = -1, attid = -1;
+   hsize_t dims[1], stamp_len = MD_STAMP_LEN;
+   htri_t exists;
+   int retval = NC_NOERR;
+
+   if ((exists = H5Lexists(grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if (exists)
+   {
+      if ((datasetid = H5Dopen2(grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT)) < 0)
+	 BAIL(NC_EHDFERR);
+      if ((spaceid = H5Dget_space(datasetid)) < 0)
+	 BAIL(NC_EHDFERR);
+      if (H5Sget_simple_extent_npoints(spaceid) != (hssize_t)b->len)
+      {
+	 if (H5Dclose(datasetid) < 0 ||
+	     H5Ldelete(grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT) < 0)
+	    BAIL(NC_EHDFERR);
+	 datasetid = -1;
+      }
+      if (H5Sclose(spaceid) < 0)
+	 BAIL(NC_EHDFERR);
+      spaceid = -1;
+   }
+
+   if (datasetid < 0)
+   {
+      dims[0] = b->len;
+      if ((spaceid = H5Screate_simple(1, dims, NULL)) < 0)
+	 BAIL(NC_EHDFERR);
+      if ((plistid = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+	 BAIL(NC_EHDFERR);
+      if (b->len <= MD_COMPACT_MAX && H5Pset_layout(plistid, H5D_COMPACT) < 0)
+	 BAIL(NC_EHDFERR);
+      if ((datasetid = H5Dcreate2(grpid, NC_METADATA_INDEX_NAME, H5T_NATIVE_UCHAR,
+				  spaceid, H5P_DEFAULT, plistid, H5P_DEFAULT)) < 0)
+	 BAIL(NC_EHDFERR);
+      if (H5Sclose(spaceid) < 0)
+	 BAIL(NC_EHDFERR);
+      if ((spaceid = H5Screate_simple(1, &stamp_len, NULL)) < 0)
+	 BAIL(NC_EHDFERR);
+      if ((attid = H5Acreate2(datasetid, NC_METADATA_STAMP_ATT_NAME, H5T_STD_U64LE,
+			      spaceid, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+	 BAIL(NC_EHDFERR);
+      if (H5Aclose(attid) < 0)
+	 BAIL(NC_EHDFERR);
+      attid = -1;
+   }
+   if (H5Dwrite(datasetid, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+		b->data) < 0)
+      BAIL(NC_EHDFERR);
+
+   if ((retval = md_write_stamp(h5, datasetid)))
+      BAIL(retval);
+
+exit:
+   if (attid >= 0 && H5Aclose(attid) < 0)
+      BAIL2(NC_EHDFERR);
+   if (plistid >= 0 && H5Pclose(plistid) < 0)
+      BAIL2(NC_EHDFERR);
+   if (spaceid >= 0 && H5Sclose(spaceid) < 0)
+      BAIL2(NC_EHDFERR);
+   if (datasetid >= 0 && H5Dclose(datasetid) < 0)
+      BAIL2(NC_EHDFERR);
+   return retval;
+}
+
+/* Stamp the index of a file whose metadata has not changed since the
+ * index was written, so that it still matches the file after data
+ * has been written. */
+static int
+md_restamp(NC_HDF5_FILE_INFO_T *h5)
+{
+   hid_t grpid = h5->root_grp->hdf_grpid, datasetid;
+   htri_t exists;
+   int retval;
+
+   if ((exists = H5Lexists(grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if (!exists)
+      return NC_NOERR;
+   if ((datasetid = H5Dopen2(grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   retval = md_write_stamp(h5, datasetid);
+   if (H5Dclose(datasetid) < 0 && !retval)
+      retval = NC_EHDFERR;
+   return retval;
+}
+
+/* Write the metadata index of a file, if it is turned on, or delete
+ * the index the file has, if it is not (or the file can't be
+ * indexed). This is called on sync, after all other metadata is
+ * written. If no metadata has changed since the last sync, the index
+ * is only stamped again. */
+int
+nc4_write_metadata_index(NC_HDF5_FILE_INFO_T *h5)
+{
+   MD_BUF b;
+   int ntypes = 0, flags = 0;
+   htri_t exists;
+   int retval;
+
+   assert(h5 && h5->root_grp && !h5->no_write);
+
+   if (!h5->meta_dirty)
+      return h5->md_index && !h5->parallel ? md_restamp(h5) : NC_NOERR;
+
+   memset(&b, 0, sizeof(b));
+   if (h5->md_index && !h5->parallel)
+   {
+      if (!(b.ordinal = calloc((size_t)h5->type_index_len + 1, sizeof(int))))
+	 return NC_ENOMEM;
+      if (h5->cmode & NC_CLASSIC_MODEL)
+	 flags |= MD_CLASSIC;
+      if (!(retval = md_put(&b, MD_MAGIC, strlen(MD_MAGIC))) &&
+	  !(retval = md_put_int(&b, MD_VERSION)) &&
+	  !(retval = md_put_int(&b, MD_BYTE_ORDER)) &&
+	  !(retval = md_put_int(&b, flags)) &&
+	  !(retval = md_put_int(&b, h5->next_typeid - NC_FIRSTUSERTYPEID)) &&
+	  !(retval = md_put_tree(&b, h5->root_grp, &ntypes)) &&
+	  !b.unsupported)
+	 retval = md_put_grp(&b, h5->root_grp);
+      if (!retval && !b.unsupported)
+	 retval = md_write(h5, &b);
+      free(b.ordinal);
+      free(b.data);
+      if (retval || !b.unsupported)
+	 return retval;
+      LOG((2, "%s: file can't be indexed", __func__));
+   }
+
+   /* Don't leave an index that would be out of date. */
+   if ((exists = H5Lexists(h5->root_grp->hdf_grpid, NC_METADATA_INDEX_NAME,
+			   H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if (exists && H5Ldelete(h5->root_grp->hdf_grpid, NC_METADATA_INDEX_NAME,
+			   H5P_DEFAULT) < 0)
+      return NC_EHDFERR;
+   return NC_NOERR;
+}
+
+/* Read the groups and named types, in the order of md_put_tree(). */
+static int
+md_get_tree(MD_READER *r, NC_GRP_INFO_T *grp, int ntypes)
+{
+   NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
+   NC_GRP_INFO_T *child;
+   char *name = NULL;
+   hid_t typeid;
+   int n, i, retval;
+
+   if ((retval = md_get_int(r, &n)))
+      return retval;
+   for (i = 0; i < n; i++)
+   {
+      if (r->ntypes >= ntypes)
+	 return NC_EHDFERR;
+      if ((retval = md_get_str(r, &name)))
+	 return retval;
+      if (!name || (typeid = H5Topen2(grp->hdf_grpid, name, H5P_DEFAULT)) < 0)
+	 BAIL(NC_EHDFERR);
+      retval = nc4_read_type(grp, typeid, name);
+      if (H5Tclose(typeid) < 0 && !retval)
+	 retval = NC_EHDFERR;
+      if (retval)
+	 BAIL(retval);
+      free(name);
+      name = NULL;
+      r->types[r->ntypes++] = nc4_find_nc_type(h5, h5->next_typeid - 1);
+   }
+
+   if ((retval = md_get_int(r, &n)))
+      return retval;
+   for (i = 0; i < n; i++)
+   {
+      if ((retval = md_get_str(r, &name)))
+	 return retval;
+      if (!name)
+	 return NC_EHDFERR;
+      if ((retval = nc4_grp_list_add(&grp->children, h5->next_nc_grpid++,
+				     grp, h5->controller, name, &child)))
+	 BAIL(retval);
+      if ((child->hdf_grpid = H5Gopen2(grp->hdf_grpid, name, H5P_DEFAULT)) < 0)
+      {
+	 child->hdf_grpid = 0;
+	 BAIL(NC_EHDFERR);
+      }
+      free(name);
+      name = NULL;
+      if ((retval = md_get_tree(r, child, ntypes)))
+	 return retval;
+   }
+   return NC_NOERR;
+
+exit:
+   free(name);
+   return retval;
+}
+
+/* Find the type of a var or att, as indexed. */
+static int
+md_get_type(MD_READER *r, nc_type *xtype, NC_TYPE_INFO_T **type)
+{
+   int retval;
+
+   *type = NULL;
+   if ((retval = md_get_int(r, xtype)))
+      return retval;
+   if (*xtype > NC_STRING)
+   {
+      if (*xtype - NC_FIRSTUSERTYPEID >= r->ntypes || *xtype < NC_FIRSTUSERTYPEID)
+	 return NC_EHDFERR;
+      *type = r->types[*xtype - NC_FIRSTUSERTYPEID];
+      *xtype = (*type)->nc_typeid;
+   }
+   else if (*xtype <= NC_NAT)
+      return NC_EHDFERR;
+   return NC_NOERR;
+}
+
+static int
+md_get_atts(MD_READER *r, NC_GRP_INFO_T *grp, NC_ATT_INFO_T **list, int *nattsp)
+{
+   NC_ATT_INFO_T *att;
+   NC_TYPE_INFO_T *type;
+   size_t size;
+   int natts, a, i, retval;
+
+   if ((retval = md_get_int(r, &natts)))
+      return retval;
+   for (a = 0; a < natts; a++)
+   {
+      if ((retval = nc4_att_list_add(list, &att)))
+	 return retval;
+      att->attnum = (*nattsp)++;
+      att->created = NC_TRUE;
+      if ((retval = md_get_str(r, &att->name)) ||
+	  (retval = md_get_type(r, &att->nc_typeid, &type)) ||
+	  (retval = md_get_int(r, &att->len)))
+	 return retval;
+      if (!att->name || att->len < 0)
+	 return NC_EHDFERR;
+      if (!att->len)
+	 continue;
+      if (att->nc_typeid == NC_STRING)
+      {
+	 if (!(att->stdata = calloc((size_t)att->len, sizeof(char *))))
+	    return NC_ENOMEM;
+	 for (i = 0; i < att->len; i++)
+	    if ((retval = md_get_str(r, &att->stdata[i])))
+	       return retval;
+      }
+      else
+      {
+	 if ((retval = nc4_get_typelen_mem(grp->nc4_info, att->nc_typeid, 0, &size)))
+	    return retval;
+	 if (!(att->data = malloc(size * (size_t)att->len)))
+	    return NC_ENOMEM;
+	 if ((retval = md_get(r, att->data, size * (size_t)att->len)))
+	    return retval;
+      }
+   }
+   return NC_NOERR;
+}
+
+/* Make the type info of a var of atomic type. */
+static int
+md_atomic_type(NC_HDF5_FILE_INFO_T *h5, nc_type xtype, int endianness,
+	       NC_TYPE_INFO_T **type_infop)
+{
+   NC_TYPE_INFO_T *type_info;
+   int retval;
+
+   if (!(type_info = calloc(1, sizeof(NC_TYPE_INFO_T))))
+      return NC_ENOMEM;
+   *type_infop = type_info;
+   type_info->nc_typeid = xtype;
+   type_info->endianness = endianness;
+   type_info->rc = 1;
+   if (!(type_info->name = strdup(NC_atomictypename(xtype))))
+      return NC_ENOMEM;
+   if ((retval = nc4_get_typelen_mem(h5, xtype, 0, &type_info->size)))
+      return retval;
+   if ((retval = nc4_get_hdf_typeid(h5, xtype, &type_info->hdf_typeid, endianness)))
+      return retval;
+   if ((type_info->native_hdf_typeid = H5Tget_native_type(type_info->hdf_typeid,
+							   H5T_DIR_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if (xtype == NC_CHAR || xtype == NC_STRING)
+      type_info->nc_type_class = xtype;
+   else if (xtype == NC_FLOAT || xtype == NC_DOUBLE)
+      type_info->nc_type_class = NC_FLOAT;
+   else
+      type_info->nc_type_class = NC_INT;
+   return NC_NOERR;
+}
+
+static int
+md_get_var(MD_READER *r, NC_GRP_INFO_T *grp)
+{
+   NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
+   NC_VAR_INFO_T *var;
+   NC_DIM_INFO_T *dim;
+   NC_TYPE_INFO_T *type;
+   NC_ATT_INFO_T *att;
+   nc_type xtype;
+   int endianness, flag, has_fill, filterid, nparams, param, d, retval;
+
+   if ((retval = nc4_var_list_add(&grp->var, &var)))
+      return retval;
+   var->varid = grp->nvars++;
+   var->created = NC_TRUE;
+   if ((retval = md_get_str(r, &var->name)) ||
+       (retval = md_get_str(r, &var->hdf5_name)) ||
+       (retval = md_get_int(r, &var->ndims)))
+      return retval;
+   if (!var->name || var->ndims < 0 || var->ndims > NC_MAX_VAR_DIMS)
+      return NC_EHDFERR;
+   var->hash = hash_fast(var->name, strlen(var->name));
+
+   if (var->ndims)
+   {
+      if (!(var->dim = calloc((size_t)var->ndims, sizeof(NC_DIM_INFO_T *))))
+	 return NC_ENOMEM;
+      if (!(var->dimids = calloc((size_t)var->ndims, sizeof(int))))
+	 return NC_ENOMEM;
+   }
+   for (d = 0; d < var->ndims; d++)
+   {
+      if ((retval = md_get_int(r, &var->dimids[d])))
+	 return retval;
+      if ((retval = nc4_find_dim(grp, var->dimids[d], &var->dim[d], NULL)))
+	 return retval;
+   }
+
+   if ((retval = md_get_type(r, &xtype, &type)) ||
+       (retval = md_get_int(r, &endianness)))
+      return retval;
+   if (type)
+   {
+      var->type_info = type;
+      type->rc++;
+   }
+   else if ((retval = md_atomic_type(h5, xtype, endianness, &var->type_info)))
+      return retval;
+
+   if ((retval = md_get_int(r, &flag)))
+      return retval;
+   if (flag)
+   {
+      /* The dim of a coordinate var has the name of the var. */
+      var->dimscale = NC_TRUE;
+      for (dim = grp->dim; dim; dim = dim->l.next)
+	 if (!strcmp(dim->name, var->name))
+	    dim->coord_var = var;
+   }
+   if ((retval = md_get_int(r, &flag)))
+      return retval;
+   if (flag)
+      var->contiguous = NC_TRUE;
+   else if (var->ndims)
+   {
+      if (!(var->chunksizes = malloc((size_t)var->ndims * sizeof(size_t))))
+	 return NC_ENOMEM;
+      for (d = 0; d < var->ndims; d++)
+	 if ((retval = md_get_size(r, &var->chunksizes[d])))
+	    return retval;
+   }
+   if ((retval = md_get_int(r, &flag)))
+      return retval;
+   var->shuffle = flag ? NC_TRUE : NC_FALSE;
+   if ((retval = md_get_int(r, &flag)))
+      return retval;
+   var->fletcher32 = flag ? NC_TRUE : NC_FALSE;
+   if ((retval = md_get_int(r, &flag)))
+      return retval;
+   var->deflate = flag ? NC_TRUE : NC_FALSE;
+   if ((retval = md_get_int(r, &var->deflate_level)))
+      return retval;
+   if ((retval = md_get_int(r, &flag)))
+      return retval;
+   var->szip = flag ? NC_TRUE : NC_FALSE;
+   if ((retval = md_get_int(r, &var->options_mask)) ||
+       (retval = md_get_int(r, &var->pixels_per_block)) ||
+       (retval = md_get_int(r, &filterid)) ||
+       (retval = md_get_int(r, &nparams)))
+      return retval;
+   if (nparams < 0)
+      return NC_EHDFERR;
+   var->filterid = (unsigned int)filterid;
+   var->nparams = (size_t)nparams;
+   if (nparams && !(var->params = malloc(var->nparams * sizeof(unsigned int))))
+      return NC_ENOMEM;
+   for (d = 0; d < nparams; d++)
+   {
+      if ((retval = md_get_int(r, &param)))
+	 return retval;
+      var->params[d] = (unsigned int)param;
+   }
+   if ((retval = md_get_int(r, &flag)) ||
+       (retval = md_get_int(r, &has_fill)))
+      return retval;
+   var->no_fill = flag ? NC_TRUE : NC_FALSE;
+
+   if (has_fill)
+   {
+      if (var->type_info->nc_type_class == NC_STRING)
+      {
+	 if (!(var->fill_value = calloc(1, sizeof(char *))))
+	    return NC_ENOMEM;
+	 if ((retval = md_get_str(r, (char **)var->fill_value)))
+	    return retval;
+      }
+      else
+      {
+	 if (!(var->fill_value = malloc(var->type_info->size)))
+	    return NC_ENOMEM;
+	 if ((retval = md_get(r, var->fill_value, var->type_info->size)))
+	    return retval;
+      }
+   }
+
+   if ((retval = md_get_atts(r, grp, &var->att, &var->natts)))
+      return retval;
+
+   /* Quantization stays in force for writes after a reopen. */
+   for (att = var->att; att; att = att->l.next)
+      if (att->nc_typeid == NC_INT && att->len == 1 && att->data)
+      {
+	 if (!strcmp(att->name, NC_QUANTIZE_BITGROOM_ATT_NAME))
+	    var->quantize_mode = NC_QUANTIZE_BITGROOM;
+	 else if (!strcmp(att->name, NC_QUANTIZE_BITROUND_ATT_NAME))
+	    var->quantize_mode = NC_QUANTIZE_BITROUND;
+	 if (var->quantize_mode)
+	 {
+	    var->nsd = *(int *)att->data;
+	    break;
+	 }
+      }
+
+   /* Size the chunk cache as if the dataset had been opened; it gets
+    * these settings, and is charged to the memory budget, when it
+    * is. */
+   if ((retval = nc4_adjust_var_cache(grp, var)))
+      return retval;
+
+   /* A string fill value belongs to the var once its dataset is open,
+    * as when it is read from the dataset. */
+   if (has_fill && var->type_info->nc_type_class == NC_STRING)
+      if ((retval = nc4_open_var_dataset(grp, var, var->hdf5_name ?
+					 var->hdf5_name : var->name)))
+	 return retval;
+
+   return NC_NOERR;
+}
+
+/* Read the dims, vars and atts of each group, in the order of
+ * md_put_grp(). */
+static int
+md_get_grp(MD_READER *r, NC_GRP_INFO_T *grp)
+{
+   NC_HDF5_FILE_INFO_T *h5 = grp->nc4_info;
+   NC_DIM_INFO_T *dim;
+   NC_GRP_INFO_T *child;
+   int n, i, flag, retval;
+
+   if ((retval = md_get_int(r, &n)))
+      return retval;
+   for (i = 0; i < n; i++)
+   {
+      if ((retval = nc4_dim_list_add(&grp->dim, &dim)))
+	 return retval;
+      grp->ndims++;
+      if ((retval = md_get_str(r, &dim->name)) ||
+	  (retval = md_get_int(r, &dim->dimid)) ||
+	  (retval = md_get_size(r, &dim->len)) ||
+	  (retval = md_get_int(r, &flag)))
+	 return retval;
+      if (!dim->name)
+	 return NC_EHDFERR;
+      dim->hash = hash_fast(dim->name, strlen(dim->name));
+      dim->unlimited = flag ? NC_TRUE : NC_FALSE;
+      dim->dimid_in_file = NC_TRUE;
+      if (dim->dimid >= h5->next_dimid)
+	 h5->next_dimid = dim->dimid + 1;
+   }
+
+   if ((retval = md_get_int(r, &n)))
+      return retval;
+   for (i = 0; i < n; i++)
+      if ((retval = md_get_var(r, grp)))
+	 return retval;
+
+   if ((retval = md_get_atts(r, grp, &grp->att, &grp->natts)))
+      return retval;
+
+   for (child = grp->children; child; child = child->l.next)
+      if ((retval = md_get_grp(r, child)))
+	 return retval;
+   return NC_NOERR;
+}
+
+/* Build the metadata of a file opened read-only from its index, if it
+ * has one that is up to date. *readp is set to false, and nothing is
+ * read, if it doesn't; the file must then be read the usual way. */
+int
+nc4_read_metadata_index(NC_HDF5_FILE_INFO_T *h5, nc_bool_t *readp)
+{
+   NC_GRP_INFO_T *root = h5->root_grp;
+   hid_t datasetid = -1, attid = -1;
+   unsigned long long stamp[MD_STAMP_LEN], file_stamp[MD_STAMP_LEN];
+   hssize_t len;
+   hid_t spaceid;
+   char *data = NULL;
+   char magic[sizeof(MD_MAGIC)];
+   MD_READER r;
+   htri_t exists;
+   int version, order, flags, ntypes;
+   int retval = NC_NOERR;
+
+   assert(h5 && root && h5->no_write);
+   *readp = NC_FALSE;
+   memset(&r, 0, sizeof(r));
+
+   if (!root->hdf_grpid &&
+       (root->hdf_grpid = H5Gopen2(h5->hdfid, "/", H5P_DEFAULT)) < 0)
+   {
+      root->hdf_grpid = 0;
+      return NC_EHDFERR;
+   }
+   if ((exists = H5Lexists(root->hdf_grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT)) < 0)
+      return NC_EHDFERR;
+   if (!exists)
+      return NC_NOERR;
+
+   /* Is the index up to date? */
+   if ((datasetid = H5Dopen2(root->hdf_grpid, NC_METADATA_INDEX_NAME, H5P_DEFAULT)) < 0)
+      BAIL(NC_EHDFERR);
+   if ((attid = H5Aopen(datasetid, NC_METADATA_STAMP_ATT_NAME, H5P_DEFAULT)) < 0)
+      BAIL(NC_EHDFERR);
+   if ((spaceid = H5Aget_space(attid)) < 0)
+      BAIL(NC_EHDFERR);
+   len = H5Sget_simple_extent_npoints(spaceid);
+   if (H5Sclose(spaceid) < 0)
+      BAIL(NC_EHDFERR);
+   if (len != MD_STAMP_LEN)
+   {
+      LOG((2, "%s: metadata index has a stamp of another length", __func__));
+      goto exit;
+   }
+   if (H5Aread(attid, H5T_NATIVE_ULLONG, stamp) < 0)
+      BAIL(NC_EHDFERR);
+   if ((retval = md_stamp(h5, file_stamp)))
+      BAIL(retval);
+   if (memcmp(stamp, file_stamp, sizeof(stamp)))
+   {
+      LOG((2, "%s: metadata index is out of date", __func__));
+      goto exit;
+   }
+
+   if ((spaceid = H5Dget_space(datasetid)) < 0)
+      BAIL(NC_EHDFERR);
+   len = H5Sget_simple_extent_npoints(spaceid);
+   if (H5Sclose(spaceid) < 0 || len <= 0)
+      BAIL(NC_EHDFERR);
+   if (!(data = malloc((size_t)len)))
+      BAIL(NC_ENOMEM);
+   if (H5Dread(datasetid, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0)
+      BAIL(NC_EHDFERR);
+   r.p = data;
+   r.end = data + len;
+
+   /* Is it an index this library can read? */
+   if (md_get(&r, magic, strlen(MD_MAGIC)) || memcmp(magic, MD_MAGIC, strlen(MD_MAGIC)) ||
+       md_get_int(&r, &version) || version != MD_VERSION ||
+       md_get_int(&r, &order) || order != MD_BYTE_ORDER)
+   {
+      LOG((2, "%s: metadata index can't be read", __func__));
+      goto exit;
+   }
+
+   if ((retval = md_get_int(&r, &flags)) ||
+       (retval = md_get_int(&r, &ntypes)))
+      BAIL(retval);
+   if (ntypes < 0)
+      BAIL(NC_EHDFERR);
+   if (flags & MD_CLASSIC)
+      h5->cmode |= NC_CLASSIC_MODEL;
+   if (ntypes && !(r.types = calloc((size_t)ntypes, sizeof(NC_TYPE_INFO_T *))))
+      BAIL(NC_ENOMEM);
+   if ((retval = md_get_tree(&r, root, ntypes)))
+      BAIL(retval);
+   if ((retval = md_get_grp(&r, root)))
+      BAIL(retval);
+
+   *readp = NC_TRUE;
+   h5->md_index_read = NC_TRUE;
+
+exit:
+   free(r.types);
+   free(data);
+   if (attid >= 0 && H5Aclose(attid) < 0)
+      BAIL2(NC_EHDFERR);
+   if (datasetid >= 0 && H5Dclose(datasetid) < 0)
+      BAIL2(NC_EHDFERR);
+   return retval;
+}
@@ -0,0 +1,294 @@
+/** \file \internal
+Packed reads and writes of the strings and vlens of netcdf-4
+variables.
+
+A packed hyperslab is one block of memory holding the strings or
+vlens of all its values, one after another, with an array of the
+offset in bytes of each value in the block, and of the end of the
+last one. Each string is stored with its terminating NUL, so a string
+of length n takes n + 1 bytes; each vlen takes its length times the
+size of its base type.
+
+Reads give HDF5 an arena to allocate the strings and vlens from, so
+that they are carved out of a few large blocks instead of being
+allocated one at a time, then copy them into the block returned to
+the caller, which is freed with one call. Writes point HDF5 at the
+values in the caller's block, without copying them.
+
+Copyright 2016, University Corporation for Atmospheric
+Research. See the COPYRIGHT file for copying and redistribution
+conditions.
+*/
+#include "config.h"
+#include "nc4internal.h"
+#include "nc4dispatch.h"
+
+#define ARENA_ALIGN 8                   /* Alignment of each allocation */
+#define ARENA_MIN_BLOCK (64 * 1024)     /* Size of the first block */
+#define ARENA_MAX_BLOCK (64 * MEGABYTE) /* Largest block grown to */
+
+/* Allocate memory for HDF5 from an arena, with the
+ * H5MM_allocate_t signature. Each block is twice the size of the one
+ * before, up to ARENA_MAX_BLOCK, or as big as a larger request. */
+void *
+nc4_arena_alloc(size_t size, void *info)
+{
+   NC4_ARENA_T *arena = info;
+   NC4_ARENA_BLOCK_T *b = NULL, *blocks;
+   size_t need = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+   size_t bsize;
+   void *p;
+
+   if (arena->nblocks)
+      b = &arena->block[arena->nblocks - 1];
+   if (!b || b->size - b->used < need)
+   {
+      bsize = b ? 2 * b->size : ARENA_MIN_BLOCK;
+      if (bsize > ARENA_MAX_BLOCK)
+         bsize = ARENA_MAX_BLOCK;
+      if (bsize < need)
+         bsize = need;
+      if (!(blocks = realloc(arena->block, (size_t)(arena->nblocks + 1) *
+                             sizeof(NC4_ARENA_BLOCK_T))))
+         return NULL;
+      arena->block = blocks;
+      b = &blocks[arena->nblocks];
+      if (!(b->data = malloc(bsize)))
+         return NULL;
+      b->size = bsize;
+      b->used = 0;
+      arena->nblocks++;
+   }
+   p = b->data + b->used;
+   b->used += need;
+   return p;
+}
+
+/* Memory from an arena is only freed with the whole arena. */
+void
+nc4_arena_free(void *mem, void *info)
+{
+}
+
+/* Free all the blocks of an arena. */
+void
+nc4_arena_release(NC4_ARENA_T *arena)
+{
+   int b;
+
+   for (b = 0; b < arena->nblocks; b++)
+      free(arena->block[b].data);
+   free(arena->block);
+   arena->block = NULL;
+   arena->nblocks = 0;
+}
+
+/* Is this memory from the arena? Fill values are not. */
+static int
+in_arena(const NC4_ARENA_T *arena, const void *p)
+{
+   const char *c = p;
+   int b;
+
+   for (b = arena->nblocks - 1; b >= 0; b--)
+      if (c >= arena->block[b].data && c < arena->block[b].data + arena->block[b].size)
+         return 1;
+   return 0;
+}
+
+/* Does a type hold data of variable length? */
+static int
+has_varlen(NC_HDF5_FILE_INFO_T *h5, nc_type xtype)
+{
+   NC_TYPE_INFO_T *type;
+   NC_FIELD_INFO_T *field;
+
+   if (xtype == NC_STRING)
+      return 1;
+   if (xtype <= NC_MAX_ATOMIC_TYPE || nc4_find_type(h5, xtype, &type) || !type)
+      return 0;
+   if (type->nc_type_class == NC_VLEN)
+      return 1;
+   if (type->nc_type_class == NC_COMPOUND)
+      for (field = type->u.c.field; field; field = field->l.next)
+         if (has_varlen(h5, field->nc_typeid))
+            return 1;
+   return 0;
+}
+
+/* Find a var that can be packed: one of strings, or of vlens of a
+ * type of fixed size, and the size of that base type. */
+static int
+find_packed_var(int ncid, int varid, NC **ncp, NC_HDF5_FILE_INFO_T **h5p,
+                NC_VAR_INFO_T **varp, int *is_stringp, size_t *base_sizep)
+{
+   NC *nc;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_GRP_INFO_T *grp;
+   NC_VAR_INFO_T *var;
+   nc_type base;
+   int retval;
+
+   if (!(nc = nc4_find_nc_file(ncid, &h5)))
+      return NC_EBADID;
+   if ((retval = nc4_find_g_var_nc(nc, ncid, varid, &grp, &var)))
+      return retval;
+
+   *is_stringp = var->type_info->nc_type_class == NC_STRING;
+   *base_sizep = 1;
+   if (!*is_stringp)
+   {
+      if (var->type_info->nc_type_class != NC_VLEN)
+         return NC_EBADTYPE;
+      base = var->type_info->u.v.base_nc_typeid;
+      if (has_varlen(h5, base))
+         return NC_EBADTYPE;
+      if ((retval = nc4_get_typelen_mem(h5, base, 0, base_sizep)))
+         return retval;
+   }
+   *ncp = nc;
+   *h5p = h5;
+   *varp = var;
+   return NC_NOERR;
+}
+
+/* Read the strings or vlens of a hyperslab of a var into one block
+ * of memory. */
+int
+NC4_get_vara_packed(int ncid, int varid, const size_t *startp,
+                    const size_t *countp, size_t *offsetsp, void **datap)
+{
+   NC *nc;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   NC4_ARENA_T arena = {NULL, 0};
+   size_t base_size, len = 1, total, i, n;
+   void *values = NULL, *p;
+   char *data = NULL;
+   int is_string, d, retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d", __func__, ncid, varid));
+
+   if ((retval = find_packed_var(ncid, varid, &nc, &h5, &var, &is_string,
+                                 &base_size)))
+      return retval;
+   for (d = 0; d < var->ndims; d++)
+      len *= countp[d];
+
+   /* Read the values, with their strings or vlens in the arena. */
+   if (!(values = calloc(len ? len : 1, is_string ? sizeof(char *) :
+                         sizeof(nc_vlen_t))))
+      return NC_ENOMEM;
+   if ((retval = nc4_get_vara(nc, ncid, varid, startp, countp,
+                              var->type_info->nc_typeid, 0, values, &arena)))
+      goto exit;
+
+   /* Lay them out one after another. A NULL string is packed as an
+    * empty one. */
+   for (total = 0, i = 0; i < len; i++)
+   {
+      if (is_string)
+      {
+         p = ((char **)values)[i];
+         total += p ? strlen(p) + 1 : 1;
+      }
+      else
+         total += ((nc_vlen_t *)values)[i].len * base_size;
+   }
+   if (!(data = malloc(total ? total : 1)))
+      BAIL(NC_ENOMEM);
+   for (total = 0, i = 0; i < len; i++)
+   {
+      offsetsp[i] = total;
+      if (is_string)
+      {
+         p = ((char **)values)[i];
+         n = p ? strlen(p) + 1 : 1;
+         if (p)
+            memcpy(data + total, p, n);
+         else
+            data[total] = '\0';
+      }
+      else
+      {
+         p = ((nc_vlen_t *)values)[i].p;
+         n = ((nc_vlen_t *)values)[i].len * base_size;
+         if (n)
+            memcpy(data + total, p, n);
+      }
+      total += n;
+   }
+   offsetsp[len] = total;
+   *datap = data;
+   data = NULL;
+
+ exit:
+   /* Free what did not come from the arena, then the arena. */
+   for (i = 0; i < len; i++)
+   {
+      p = is_string ? ((char **)values)[i] : ((nc_vlen_t *)values)[i].p;
+      if (p && !in_arena(&arena, p))
+         free(p);
+   }
+   free(values);
+   nc4_arena_release(&arena);
+   if (data)
+      free(data);
+   return retval;
+}
+
+/* Write the strings or vlens of a hyperslab of a var from one block
+ * of memory. */
+int
+NC4_put_vara_packed(int ncid, int varid, const size_t *startp,
+                    const size_t *countp, const size_t *offsetsp,
+                    const void *data)
+{
+   NC *nc;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   size_t base_size, len = 1, i, n;
+   const char *c = data;
+   void *values;
+   int is_string, d, retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d", __func__, ncid, varid));
+
+   if ((retval = find_packed_var(ncid, varid, &nc, &h5, &var, &is_string,
+                                 &base_size)))
+      return retval;
+   for (d = 0; d < var->ndims; d++)
+      len *= countp[d];
+
+   /* Point each value at its place in the block. Strings must end in
+    * their NUL, and vlens be whole values of their base type. */
+   if (!(values = malloc((len ? len : 1) * (is_string ? sizeof(char *) :
+                                            sizeof(nc_vlen_t)))))
+      return NC_ENOMEM;
+   for (i = 0; i < len; i++)
+   {
+      if (offsetsp[i + 1] < offsetsp[i])
+         BAIL(NC_EINVAL);
+      n = offsetsp[i + 1] - offsetsp[i];
+      if (is_string)
+      {
+         if (!n || c[offsetsp[i + 1] - 1])
+            BAIL(NC_EINVAL);
+         ((const char **)values)[i] = c + offsetsp[i];
+      }
+      else
+      {
+         if (n % base_size)
+            BAIL(NC_EINVAL);
+         ((nc_vlen_t *)values)[i].len = n / base_size;
+         ((nc_vlen_t *)values)[i].p = n ? (void *)(c + offsetsp[i]) : NULL;
+      }
+   }
+
+   retval = nc4_put_vara(nc, ncid, varid, startp, countp,
+                         var->type_info->nc_typeid, 0, values);
+
+ exit:
+   free(values);
+   return retval;
+}
@@ -0,0 +1,343 @@
+/** \file \internal
+The decoded-chunk cache used for point reads in netcdf-4.
+
+A read of a few values (nc_get_var1 and tiny nc_get_vara calls) of a
+chunked variable is served from a copy of the whole chunk, decoded
+(that is, read through the HDF5 filters) into the native type of the
+variable. Later reads from the same chunk cost only a lookup and a
+copy, with conversion to the memory type if needed, instead of a trip
+through HDF5. Keeping the chunks in the type of the variable means
+that one copy serves every memory type, and that range errors are
+reported for exactly the values read.
+
+Each open file has its own cache, of the size set with
+nc_set_point_cache() when the file was opened. Chunks are found
+through a hash table and evicted in least recently used order. The
+memory held is charged to the chunk cache category of the memory
+budget. Writes to a variable drop its chunks.
+
+Copyright 2016, University Corporation for Atmospheric
+Research. See the COPYRIGHT file for copying and redistribution
+conditions.
+*/
+#include "config.h"
+#include "nc4internal.h"
+#include "ncdispatch.h" /* from libdispatch */
+
+#define POINT_CACHE_BUCKETS 1024 /* a power of 2 */
+
+/* One decoded chunk, clipped to the extent of the data when it was
+ * read. */
+typedef struct NC4_POINT_CHUNK
+{
+   struct NC4_POINT_CHUNK *next_hash; /* Next in this hash bucket */
+   struct NC4_POINT_CHUNK *prev, *next; /* LRU list, most recent first */
+   NC_VAR_INFO_T *var;
+   uint32_t hash;
+   hsize_t *origin;             /* Start of the chunk in the variable */
+   hsize_t *count;              /* Its extent, possibly clipped */
+   size_t size;                 /* Bytes of data */
+   void *data;
+} NC4_POINT_CHUNK_T;
+
+struct NC4_POINT_CACHE
+{
+   size_t used;                 /* Bytes of chunk data held */
+   NC4_POINT_CHUNK_T *head, *tail;
+   NC4_POINT_CHUNK_T *buckets[POINT_CACHE_BUCKETS];
+};
+
+static uint32_t
+chunk_hash(const NC_VAR_INFO_T *var, const hsize_t *origin)
+{
+   return hash_fast(origin, var->ndims * sizeof(hsize_t)) ^
+      (uint32_t)((size_t)var >> 4);
+}
+
+static void
+lru_unlink(NC4_POINT_CACHE_T *cache, NC4_POINT_CHUNK_T *chunk)
+{
+   if (chunk->prev)
+      chunk->prev->next = chunk->next;
+   else
+      cache->head = chunk->next;
+   if (chunk->next)
+      chunk->next->prev = chunk->prev;
+   else
+      cache->tail = chunk->prev;
+   chunk->prev = chunk->next = NULL;
+}
+
+static void
+lru_push(NC4_POINT_CACHE_T *cache, NC4_POINT_CHUNK_T *chunk)
+{
+   chunk->prev = NULL;
+   chunk->next = cache->head;
+   if (cache->head)
+      cache->head->prev = chunk;
+   cache->head = chunk;
+   if (!cache->tail)
+      cache->tail = chunk;
+}
+
+/* Remove a chunk from the cache and free it. */
+static void
+chunk_del(NC4_POINT_CACHE_T *cache, NC4_POINT_CHUNK_T *chunk)
+{
+   NC4_POINT_CHUNK_T **p;
+
+   for (p = &cache->buckets[chunk->hash & (POINT_CACHE_BUCKETS - 1)];
+	*p != chunk; p = &(*p)->next_hash)
+      assert(*p);
+   *p = chunk->next_hash;
+   lru_unlink(cache, chunk);
+   cache->used -= chunk->size;
+   NC_memory_release(NC_MEM_CHUNK_CACHE, chunk->size);
+   free(chunk);
+}
+
+static NC4_POINT_CHUNK_T *
+chunk_find(NC4_POINT_CACHE_T *cache, NC_VAR_INFO_T *var,
+	   const hsize_t *origin, uint32_t hash)
+{
+   NC4_POINT_CHUNK_T *chunk;
+
+   for (chunk = cache->buckets[hash & (POINT_CACHE_BUCKETS - 1)]; chunk;
+	chunk = chunk->next_hash)
+      if (chunk->hash == hash && chunk->var == var &&
+	  !memcmp(chunk->origin, origin, var->ndims * sizeof(hsize_t)))
+	 return chunk;
+   return NULL;
+}
+
+/* Read a chunk of a var from the file into a new cache entry. Sets
+ * *chunkp to NULL, without error, if the chunk does not fit in the
+ * cache or the memory budget. */
+static int
+chunk_load(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var,
+	   const hsize_t *origin, uint32_t hash, NC4_POINT_CHUNK_T **chunkp)
+{
+   NC4_POINT_CACHE_T *cache = h5->point_cache;
+   NC4_POINT_CHUNK_T *chunk;
+   hsize_t count[NC_MAX_VAR_DIMS];
+   hid_t file_spaceid, mem_spaceid;
+   size_t size = var->type_info->size;
+   size_t bucket = hash & (POINT_CACHE_BUCKETS - 1);
+   int d, retval;
+
+   *chunkp = NULL;
+
+   /* Chunks at the edge of the data are clipped to it. */
+   for (d = 0; d < var->ndims; d++)
+   {
+      count[d] = var->logical_dims[d] - origin[d];
+      if (count[d] > var->chunksizes[d])
+	 count[d] = var->chunksizes[d];
+      size *= count[d];
+   }
+   if (size > h5->point_cache_size)
+      return NC_NOERR;
+
+   /* Make room, in the cache and in the memory budget. */
+   while (cache->tail && (cache->used + size > h5->point_cache_size ||
+			  NC_memory_available() < size))
+      chunk_del(cache, cache->tail);
+   if (NC_memory_available() < size)
+      return NC_NOERR;
+
+   if (!(chunk = malloc(sizeof(NC4_POINT_CHUNK_T) +
+			2 * var->ndims * sizeof(hsize_t) + size)))
+      return NC_ENOMEM;
+   chunk->origin = (hsize_t *)(chunk + 1);
+   chunk->count = chunk->origin + var->ndims;
+   chunk->data = chunk->count + var->ndims;
+   memcpy(chunk->origin, origin, var->ndims * sizeof(hsize_t));
+   memcpy(chunk->count, count, var->ndims * sizeof(hsize_t));
+
+   /* Decode the chunk. */
+   if ((retval = nc4_get_file_space(var, &file_spaceid)))
+   {
+      free(chunk);
+      return retval;
+   }
+   if (H5Sselect_hyperslab(file_spaceid, H5S_SELECT_SET, origin, NULL,
+			   count, NULL) < 0 ||
+       (mem_spaceid = H5Screate_simple(var->ndims, count, NULL)) < 0)
+   {
+      free(chunk);
+      return NC_EHDFERR;
+   }
+   if (H5Dread(var->hdf_datasetid, var->type_info->native_hdf_typeid,
+	       mem_spaceid, file_spaceid, H5P_DEFAULT, chunk->data) < 0)
+   {
+      H5Sclose(mem_spaceid);
+      free(chunk);
+      return NC_EHDFERR;
+   }
+   if (H5Sclose(mem_spaceid) < 0)
+   {
+      free(chunk);
+      return NC_EHDFERR;
+   }
+
+   chunk->var = var;
+   chunk->hash = hash;
+   chunk->size = size;
+   chunk->next_hash = cache->buckets[bucket];
+   cache->buckets[bucket] = chunk;
+   lru_push(cache, chunk);
+   cache->used += size;
+   NC_memory_charge(NC_MEM_CHUNK_CACHE, size);
+   *chunkp = chunk;
+   return NC_NOERR;
+}
+
+/* Serve a read of a few values within one chunk of a var from the
+ * cache. *donep is set to true if the read was served; otherwise,
+ * if the read is not one for the cache, it is left false, and the
+ * read must be done in the usual way. Returns NC_ERANGE if any of
+ * the values read did not fit the memory type. */
+int
+nc4_point_read(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var,
+	       const hsize_t *start, const hsize_t *count,
+	       nc_type mem_nc_type, int is_long, void *data,
+	       nc_bool_t *donep)
+{
+   NC4_POINT_CHUNK_T *chunk;
+   hsize_t origin[NC_MAX_VAR_DIMS], idx[NC_MAX_VAR_DIMS];
+   nc_type file_nc_type = var->type_info->nc_typeid;
+   size_t nelems = 1, file_size = var->type_info->size, mem_size;
+   size_t run, offset;
+   int convert, range_error = 0, re, d, retval;
+   uint32_t hash;
+
+   *donep = NC_FALSE;
+
+   /* Only small reads, wholly within the data written and within one
+    * chunk, of the fixed size atomic types. */
+   if (!h5->point_cache_size || h5->parallel || var->contiguous ||
+       !var->chunksizes || !var->ndims || !var->logical_dims ||
+       file_nc_type < NC_BYTE || file_nc_type > NC_UINT64 ||
+       mem_nc_type < NC_BYTE || mem_nc_type > NC_UINT64)
+      return NC_NOERR;
+   for (d = 0; d < var->ndims; d++)
+   {
+      if (!count[d] || start[d] + count[d] > var->logical_dims[d])
+	 return NC_NOERR;
+      origin[d] = start[d] - start[d] % var->chunksizes[d];
+      if (start[d] + count[d] > origin[d] + var->chunksizes[d])
+	 return NC_NOERR;
+      nelems *= count[d];
+   }
+   if (nelems > NC4_POINT_READ_MAX)
+      return NC_NOERR;
+
+   if (!h5->point_cache &&
+       !(h5->point_cache = calloc(1, sizeof(NC4_POINT_CACHE_T))))
+      return NC_ENOMEM;
+
+   /* Find the chunk, reading it if it isn't there, or if it was
+    * clipped before the data grew to cover the request. */
+   hash = chunk_hash(var, origin);
+   if ((chunk = chunk_find(h5->point_cache, var, origin, hash)))
+   {
+      for (d = 0; d < var->ndims; d++)
+	 if (start[d] + count[d] > origin[d] + chunk->count[d])
+	    break;
+      if (d < var->ndims)
+      {
+	 chunk_del(h5->point_cache, chunk);
+	 chunk = NULL;
+      }
+      else
+      {
+	 lru_unlink(h5->point_cache, chunk);
+	 lru_push(h5->point_cache, chunk);
+      }
+   }
+   if (!chunk)
+   {
+      if ((retval = chunk_load(h5, var, origin, hash, &chunk)))
+	 return retval;
+      if (!chunk)
+	 return NC_NOERR;
+   }
+
+   /* Copy out a run of the innermost dimension at a time. */
+   if ((retval = nc4_get_typelen_mem(h5, mem_nc_type, is_long, &mem_size)))
+      return retval;
+   convert = (mem_nc_type != file_nc_type || (file_nc_type == NC_INT && is_long));
+   run = count[var->ndims - 1];
+   memset(idx, 0, var->ndims * sizeof(hsize_t));
+   for (;;)
+   {
+      for (offset = 0, d = 0; d < var->ndims; d++)
+	 offset = offset * chunk->count[d] + (start[d] - origin[d] + idx[d]);
+      if (convert)
+      {
+	 if ((retval = nc4_convert_type((char *)chunk->data + offset * file_size,
+					data, file_nc_type, mem_nc_type, run,
+					&re, var->fill_value,
+					(h5->cmode & NC_CLASSIC_MODEL), 0, is_long)))
+	    return retval;
+	 range_error += re;
+      }
+      else
+	 memcpy(data, (char *)chunk->data + offset * file_size, run * file_size);
+      data = (char *)data + run * mem_size;
+
+      for (d = var->ndims - 2; d >= 0; d--)
+      {
+	 if (++idx[d] < count[d])
+	    break;
+	 idx[d] = 0;
+      }
+      if (d < 0)
+	 break;
+   }
+   *donep = NC_TRUE;
+
+   /* For strict netcdf-3 rules, ignore erange errors between UBYTE
+    * and BYTE types. */
+   if ((h5->cmode & NC_CLASSIC_MODEL) &&
+       (file_nc_type == NC_UBYTE || file_nc_type == NC_BYTE) &&
+       (mem_nc_type == NC_UBYTE || mem_nc_type == NC_BYTE))
+      range_error = 0;
+
+   return range_error ? NC_ERANGE : NC_NOERR;
+}
+
+/* Drop the cached chunks of a var, whose data or dataset has
+ * changed. */
+void
+nc4_point_cache_drop_var(NC_HDF5_FILE_INFO_T *h5, NC_VAR_INFO_T *var)
+{
+   NC4_POINT_CHUNK_T *chunk, *next;
+
+   if (!h5->point_cache)
+      return;
+   for (chunk = h5->point_cache->head; chunk; chunk = next)
+   {
+      next = chunk->next;
+      if (chunk->var == var)
+	 chunk_del(h5->point_cache, chunk);
+   }
+}
+
+/* Bytes of chunk data held by the cache of a file. */
+size_t
+nc4_point_cache_used(NC_HDF5_FILE_INFO_T *h5)
+{
+   return h5->point_cache ? h5->point_cache->used : 0;
+}
+
+void
+nc4_point_cache_free(NC_HDF5_FILE_INFO_T *h5)
+{
+   if (!h5->point_cache)
+      return;
+   while (h5->point_cache->head)
+      chunk_del(h5->point_cache, h5->point_cache->head);
+   free(h5->point_cache);
+   h5->point_cache = NULL;
+}
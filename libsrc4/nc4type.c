@@ -64,13 +64,11 @@ NC4_inq_type_equal(int ncid1, nc_type typeid1, int ncid2,
    /* Not atomic types - so find type1 and type2 information. */
    if ((retval = nc4_find_nc4_grp(ncid1, &grpone)))
       return retval;
-   if (!(type1 = nc4_rec_find_nc_type(grpone->nc4_info->root_grp, 
-				      typeid1)))
+   if (!(type1 = nc4_find_nc_type(grpone->nc4_info, typeid1)))
       return NC_EBADTYPE;
    if ((retval = nc4_find_nc4_grp(ncid2, &grptwo)))
       return retval;
-   if (!(type2 = nc4_rec_find_nc_type(grptwo->nc4_info->root_grp, 
-				      typeid2)))
+   if (!(type2 = nc4_find_nc_type(grptwo->nc4_info, typeid2)))
       return NC_EBADTYPE;
 
    /* Are the two types equal? */
@@ -133,7 +131,7 @@ NC4_inq_typeid(int ncid, const char *name, nc_type *typeidp)
    /* Still didn't find type? Search file recursively, starting at the
     * root group. */
    if (!type)
-      if ((type = nc4_rec_find_named_type(grp->nc4_info->root_grp, norm_name)))
+      if ((type = nc4_find_named_type(grp->nc4_info, norm_name)))
 	 if (typeidp)
 	    *typeidp = type->nc_typeid;
 
@@ -226,9 +224,10 @@ add_user_type(int ncid, size_t size, const char *name, nc_type base_typeid,
    if ((retval = nc4_check_dup_name(grp, norm_name)))
       return retval;
    
-   /* Add to our list of types. */
+   /* Add to our list of types. It is committed on the next sync. */
    if ((retval = nc4_type_list_add(grp, size, norm_name, &type)))
       return retval;
+   h5->meta_dirty = NC_TRUE;
 
    /* Remember info about this type. */
    type->nc_type_class = type_class;
@@ -287,7 +286,7 @@ NC4_inq_type(int ncid, nc_type typeid1, char *name, size_t *size)
       return retval;
    
    /* Find this type. */
-   if (!(type = nc4_rec_find_nc_type(grp->nc4_info->root_grp, typeid1)))
+   if (!(type = nc4_find_nc_type(grp->nc4_info, typeid1)))
       return NC_EBADTYPE;
 
    if (name)
@@ -384,7 +383,7 @@ NC4_inq_user_type(int ncid, nc_type typeid1, char *name, size_t *size,
       return retval;
    
    /* Find this type. */
-   if (!(type = nc4_rec_find_nc_type(grp->nc4_info->root_grp, typeid1)))
+   if (!(type = nc4_find_nc_type(grp->nc4_info, typeid1)))
       return NC_EBADTYPE;
 
    /* Count the number of fields. */
@@ -447,7 +446,7 @@ NC4_inq_compound_field(int ncid, nc_type typeid1, int fieldid, char *name,
       return retval;
    
    /* Find this type. */
-   if (!(type = nc4_rec_find_nc_type(grp->nc4_info->root_grp, typeid1)))
+   if (!(type = nc4_find_nc_type(grp->nc4_info, typeid1)))
       return NC_EBADTYPE;
 
    /* Find the field. */
@@ -578,7 +577,7 @@ NC4_inq_enum_ident(int ncid, nc_type xtype, long long value, char *identifier)
       return retval;
    
    /* Find this type. */
-   if (!(type = nc4_rec_find_nc_type(grp->nc4_info->root_grp, xtype)))
+   if (!(type = nc4_find_nc_type(grp->nc4_info, xtype)))
       return NC_EBADTYPE;
    
    /* Complain if they are confused about the type. */
@@ -653,7 +652,7 @@ NC4_inq_enum_member(int ncid, nc_type typeid1, int idx, char *identifier,
       return retval;
    
    /* Find this type. */
-   if (!(type = nc4_rec_find_nc_type(grp->nc4_info->root_grp, typeid1)))
+   if (!(type = nc4_find_nc_type(grp->nc4_info, typeid1)))
       return NC_EBADTYPE;
    
    /* Complain if they are confused about the type. */
@@ -48,8 +48,9 @@ nc4_reopen_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var)
 #ifdef EXTRA_TESTS
       num_plists++;
 #endif
+      nc4_charge_chunk_cache(var);
       if (H5Pset_chunk_cache(access_pid, var->chunk_cache_nelems,
-			     var->chunk_cache_size,
+			     var->chunk_cache_charged,
 			     var->chunk_cache_preemption) < 0)
 	 return NC_EHDFERR;
       if (H5Dclose(var->hdf_datasetid) < 0)
@@ -67,6 +68,41 @@ nc4_reopen_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var)
    return NC_NOERR;
 }
 
+/* Open the HDF5 dataset of a var, under the given name, if it is not
+ * open yet. The dataset gets the chunk cache settings of the var,
+ * charged to the memory budget; the charge is given back when the
+ * var is freed. */
+int
+nc4_open_var_dataset(NC_GRP_INFO_T *grp, NC_VAR_INFO_T *var, const char *name)
+{
+   hid_t access_pid;
+
+   if (var->hdf_datasetid)
+      return NC_NOERR;
+
+   if ((access_pid = H5Pcreate(H5P_DATASET_ACCESS)) < 0)
+      return NC_EHDFERR;
+   nc4_charge_chunk_cache(var);
+   if (H5Pset_chunk_cache(access_pid, var->chunk_cache_nelems,
+			  var->chunk_cache_charged,
+			  var->chunk_cache_preemption) < 0)
+   {
+      H5Pclose(access_pid);
+      return NC_EHDFERR;
+   }
+   if ((var->hdf_datasetid = H5Dopen2(grp->hdf_grpid, name, access_pid)) < 0)
+   {
+      var->hdf_datasetid = 0;
+      nc4_release_chunk_cache(var);
+      H5Pclose(access_pid);
+      return NC_ENOTVAR;
+   }
+   if (H5Pclose(access_pid) < 0)
+      return NC_EHDFERR;
+
+   return NC_NOERR;
+}
+
 /* Set chunk cache size for a variable. */
 int
 NC4_set_var_chunk_cache(int ncid, int varid, size_t size, size_t nelems,
@@ -890,7 +926,7 @@ nc_def_var_extra(int ncid, int varid, int *shuffle, int *deflate,
     * for this data. */
    if (contiguous && *contiguous)
    {
-      if (var->deflate || var->fletcher32 || var->shuffle)
+      if (var->deflate || var->fletcher32 || var->shuffle || var->filterid)
 	 return NC_EINVAL;
 
      if (!ishdf4) {
@@ -1119,6 +1155,299 @@ NC4_def_var_endian(int ncid, int varid, int endianness)
                            NULL, NULL, NULL, &endianness);
 }
 
+/* Set quantization for a float or double var, recording it in an
+ * attribute. This must be done after nc_def_var and before
+ * nc_enddef. */
+int
+NC4_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd)
+{
+   NC *nc;
+   NC_GRP_INFO_T *grp;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   const char *att_name = NULL;
+   int max_nsd = 0, retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d quantize_mode %d nsd %d", __func__,
+        ncid, varid, quantize_mode, nsd));
+
+   if ((retval = nc4_find_nc_grp_h5(ncid, &nc, &grp, &h5)))
+      return retval;
+   if (!h5)
+      return NC_ENOTNC4;
+   for (var = grp->var; var; var = var->l.next)
+      if (var->varid == varid)
+         break;
+   if (!var)
+      return NC_ENOTVAR;
+   if (var->created)
+      return NC_ELATEDEF;
+   if (var->type_info->nc_typeid != NC_FLOAT &&
+       var->type_info->nc_typeid != NC_DOUBLE)
+      return NC_EINVAL;
+
+   switch (quantize_mode)
+   {
+   case NC_NOQUANTIZE:
+      break;
+   case NC_QUANTIZE_BITGROOM:
+      att_name = NC_QUANTIZE_BITGROOM_ATT_NAME;
+      max_nsd = var->type_info->nc_typeid == NC_FLOAT ? 7 : 15;
+      break;
+   case NC_QUANTIZE_BITROUND:
+      att_name = NC_QUANTIZE_BITROUND_ATT_NAME;
+      max_nsd = var->type_info->nc_typeid == NC_FLOAT ? 23 : 52;
+      break;
+   default:
+      return NC_EINVAL;
+   }
+   if (att_name && (nsd < 1 || nsd > max_nsd))
+      return NC_EINVAL;
+
+   /* Replace the attribute of any earlier setting. */
+   retval = NC4_del_att(ncid, varid, NC_QUANTIZE_BITGROOM_ATT_NAME);
+   if (retval && retval != NC_ENOTATT)
+      return retval;
+   retval = NC4_del_att(ncid, varid, NC_QUANTIZE_BITROUND_ATT_NAME);
+   if (retval && retval != NC_ENOTATT)
+      return retval;
+   if (att_name)
+      if ((retval = nc_put_att_int(ncid, varid, att_name, NC_INT, 1, &nsd)))
+         return retval;
+
+   var->quantize_mode = quantize_mode;
+   var->nsd = att_name ? nsd : 0;
+   return NC_NOERR;
+}
+
+/* Learn the quantization settings of a var. */
+int
+NC4_inq_var_quantize(int ncid, int varid, int *quantize_modep, int *nsdp)
+{
+   NC *nc;
+   NC_GRP_INFO_T *grp;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   int retval;
+
+   if ((retval = nc4_find_nc_grp_h5(ncid, &nc, &grp, &h5)))
+      return retval;
+   if (!h5)
+      return NC_ENOTNC4;
+   for (var = grp->var; var; var = var->l.next)
+      if (var->varid == varid)
+         break;
+   if (!var)
+      return NC_ENOTVAR;
+
+   if (quantize_modep)
+      *quantize_modep = var->quantize_mode;
+   if (nsdp)
+      *nsdp = var->nsd;
+   return NC_NOERR;
+}
+
+/* Set the HDF5 filter of a var, and its params. This must be done
+ * after nc_def_var and before nc_enddef. */
+int
+NC4_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+                   const unsigned int *params)
+{
+   NC *nc;
+   NC_GRP_INFO_T *grp;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   unsigned int *new_params = NULL;
+   unsigned int config;
+   int retval;
+
+   LOG((2, "%s: ncid 0x%x varid %d id %u nparams %d", __func__, ncid,
+        varid, id, (int)nparams));
+
+   if (nparams && !params)
+      return NC_EINVAL;
+   if ((retval = nc4_find_nc_grp_h5(ncid, &nc, &grp, &h5)))
+      return retval;
+   if (!h5)
+      return NC_ENOTNC4;
+   for (var = grp->var; var; var = var->l.next)
+      if (var->varid == varid)
+         break;
+   if (!var)
+      return NC_ENOTVAR;
+   if (nc->mode & (NC_MPIIO | NC_MPIPOSIX))
+      return NC_EINVAL;
+   if (var->created)
+      return NC_ELATEDEF;
+
+   /* Deflate has its own settings. */
+   if (id == H5Z_FILTER_DEFLATE)
+   {
+      int deflate = 1, level;
+
+      if (nparams != 1)
+         return NC_EINVAL;
+      level = (int)params[0];
+      return nc_def_var_extra(ncid, varid, NULL, &deflate, &level, NULL,
+                              NULL, NULL, NULL, NULL, NULL);
+   }
+
+   /* The filter must be able to compress, not just decompress, since
+    * HDF5 only finds out when the data is first written. */
+   if (id)
+   {
+      if (id > H5Z_FILTER_MAX || H5Zfilter_avail((H5Z_filter_t)id) <= 0)
+         return NC_EFILTER;
+      if (H5Zget_filter_info((H5Z_filter_t)id, &config) < 0 ||
+          !(config & H5Z_FILTER_CONFIG_ENCODE_ENABLED))
+         return NC_EFILTER;
+   }
+
+   /* For scalars, just ignore attempt to filter, as for deflate. */
+   if (!var->ndims)
+      return NC_NOERR;
+
+   if (id && nparams)
+   {
+      if (!(new_params = malloc(nparams * sizeof(unsigned int))))
+         return NC_ENOMEM;
+      memcpy(new_params, params, nparams * sizeof(unsigned int));
+   }
+   free(var->params);
+   var->filterid = id;
+   var->nparams = id ? nparams : 0;
+   var->params = new_params;
+   if (!id)
+      return NC_NOERR;
+
+   /* Filters need chunks. */
+   var->contiguous = NC_FALSE;
+   if (!var->chunksizes[0])
+      if ((retval = nc4_find_default_chunksizes2(grp, var)))
+         return retval;
+   return nc4_adjust_var_cache(grp, var);
+}
+
+/* Learn the HDF5 filter of a var, and its params. */
+int
+NC4_inq_var_filter(int ncid, int varid, unsigned int *idp, size_t *nparamsp,
+                   unsigned int *params)
+{
+   NC *nc;
+   NC_GRP_INFO_T *grp;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   int retval;
+
+   if ((retval = nc4_find_nc_grp_h5(ncid, &nc, &grp, &h5)))
+      return retval;
+   if (!h5)
+      return NC_ENOTNC4;
+   for (var = grp->var; var; var = var->l.next)
+      if (var->varid == varid)
+         break;
+   if (!var)
+      return NC_ENOTVAR;
+
+   if (idp)
+      *idp = var->filterid;
+   if (nparamsp)
+      *nparamsp = var->nparams;
+   if (params && var->nparams)
+      memcpy(params, var->params, var->nparams * sizeof(unsigned int));
+   return NC_NOERR;
+}
+
+/* Get the ids of all the filters of a var, in the order they are
+ * applied. Those of a dataset in the file are read from it, since
+ * other programs may have applied them in another order. */
+int
+NC4_inq_var_filter_ids(int ncid, int varid, size_t *nfiltersp,
+                       unsigned int *ids)
+{
+   NC *nc;
+   NC_GRP_INFO_T *grp;
+   NC_HDF5_FILE_INFO_T *h5;
+   NC_VAR_INFO_T *var;
+   hid_t propid = 0;
+   unsigned int flags;
+   size_t nfilters = 0;
+   H5Z_filter_t filter;
+   int nfilters_in, f, retval = NC_NOERR;
+
+   LOG((2, "%s: ncid 0x%x varid %d", __func__, ncid, varid));
+
+   if ((retval = nc4_find_nc_grp_h5(ncid, &nc, &grp, &h5)))
+      return retval;
+   if (!h5)
+      return NC_ENOTNC4;
+   for (var = grp->var; var; var = var->l.next)
+      if (var->varid == varid)
+         break;
+   if (!var)
+      return NC_ENOTVAR;
+
+   /* Before enddef, the filters are those var_create_dataset() will
+    * set, in the same order. */
+   if (!var->created
+#ifdef USE_HDF4
+       || h5->hdf4
+#endif /* USE_HDF4 */
+      )
+   {
+      if (var->shuffle)
+      {
+         if (ids)
+            ids[nfilters] = H5Z_FILTER_SHUFFLE;
+         nfilters++;
+      }
+      if (var->filterid)
+      {
+         if (ids)
+            ids[nfilters] = var->filterid;
+         nfilters++;
+      }
+      if (var->deflate)
+      {
+         if (ids)
+            ids[nfilters] = H5Z_FILTER_DEFLATE;
+         nfilters++;
+      }
+      if (var->fletcher32)
+      {
+         if (ids)
+            ids[nfilters] = H5Z_FILTER_FLETCHER32;
+         nfilters++;
+      }
+      if (nfiltersp)
+         *nfiltersp = nfilters;
+      return NC_NOERR;
+   }
+
+   if ((retval = nc4_open_var_dataset(grp, var, var->hdf5_name ?
+                                      var->hdf5_name : var->name)))
+      return retval;
+   if ((propid = H5Dget_create_plist(var->hdf_datasetid)) < 0)
+      return NC_EHDFERR;
+   if ((nfilters_in = H5Pget_nfilters(propid)) < 0)
+      BAIL(NC_EHDFERR);
+   for (f = 0; f < nfilters_in; f++)
+   {
+      if ((filter = H5Pget_filter2(propid, f, &flags, NULL, NULL, 0, NULL,
+                                   NULL)) < 0)
+         BAIL(NC_EHDFERR);
+      if (ids)
+         ids[f] = (unsigned int)filter;
+   }
+   if (nfiltersp)
+      *nfiltersp = (size_t)nfilters_in;
+
+exit:
+   if (H5Pclose(propid) < 0 && !retval)
+      retval = NC_EHDFERR;
+   return retval;
+}
+
 /* Get var id from name. */
 int
 NC4_inq_varid(int ncid, const char *name, int *varidp)
@@ -1214,6 +1543,9 @@ NC4_rename_var(int ncid, int varid, const char *name)
        (h5->cmode & NC_CLASSIC_MODEL))
       return NC_ENOTINDEFINE;
 
+   /* The new name is in the metadata written on the next sync. */
+   h5->meta_dirty = NC_TRUE;
+
    /* Change the HDF5 file, if this var has already been created
       there. */
    if (var->created)
@@ -1377,7 +1709,7 @@ nc4_get_vara_tc(int ncid, int varid, nc_type mem_type, int mem_type_is_long,
 
    /* Handle HDF5 cases. */
    return nc4_get_vara(nc, ncid, varid, startp, countp, mem_type,
-                       mem_type_is_long, (void *)ip);
+                       mem_type_is_long, (void *)ip, NULL);
 }
 
 int
@@ -1395,3 +1727,44 @@ NC4_get_vara(int ncid, int varid, const size_t *startp,
 {
    return nc4_get_vara_tc(ncid, varid, memtype, 0, startp, countp, ip);
 }
+
+/* Read the values at scattered points of a var. */
+int
+NC4_get_var_points(int ncid, int varid, size_t npoints,
+                   const size_t *indexp, void *ip, nc_type memtype)
+{
+   NC *nc;
+   NC_HDF5_FILE_INFO_T* h5;
+
+   LOG((2, "%s: ncid 0x%x varid %d npoints %d memtype %d", __func__, ncid,
+        varid, npoints, memtype));
+
+   if (!(nc = nc4_find_nc_file(ncid,&h5)))
+      return NC_EBADID;
+
+#ifdef USE_HDF4
+   /* HDF4 files are read a point at a time. */
+   if (h5->hdf4)
+      return NCDEFAULT_get_var_points(ncid, varid, npoints, indexp, ip,
+                                      memtype);
+#endif /* USE_HDF4 */
+
+   return nc4_get_var_points(nc, ncid, varid, npoints, indexp, memtype, 0, ip);
+}
+
+/* Read one field of the compound values of a hyperslab of a var. */
+int
+NC4_get_vara_field(int ncid, int varid, int fieldid, const size_t *startp,
+                   const size_t *countp, void *ip)
+{
+   NC *nc;
+   NC_HDF5_FILE_INFO_T* h5;
+
+   LOG((2, "%s: ncid 0x%x varid %d fieldid %d", __func__, ncid, varid,
+        fieldid));
+
+   if (!(nc = nc4_find_nc_file(ncid,&h5)))
+      return NC_EBADID;
+
+   return nc4_get_vara_field(nc, ncid, varid, fieldid, startp, countp, ip);
+}
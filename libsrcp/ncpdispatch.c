@@ -6,6 +6,7 @@
 /* WARNING: Order of mpi.h, nc.h, and pnetcdf.h is important */
 #include "config.h"
 #include <stdlib.h>
+#include <string.h>
 #include <mpi.h>
 #include "nc.h"
 #include "ncdispatch.h"
@@ -1493,6 +1494,126 @@ NCP_def_var_endian(int ncid, int varid, int endianness)
 
 #endif /*USE_NETCDF4*/
 
+/* I/O statistics are kept by the classic ncio layer only */
+static int
+NCP_inq_io_stats(int ncid, nc_io_stats_t *statsp)
+{
+    return NC_ENOTNC3;
+}
+
+static int
+NCP_reset_io_stats(int ncid)
+{
+    return NC_ENOTNC3;
+}
+
+/* The memory held by pnetcdf is not visible to us */
+static int
+NCP_inq_memory_usage(int ncid, nc_memory_usage_t *usagep)
+{
+    if(usagep) memset(usagep,0,sizeof(nc_memory_usage_t));
+    return NC_NOERR;
+}
+
+static int
+NCP_set_append_mode(int ncid, int mode, int *old_modep)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_def_var_quantize(int ncid, int varid, int quantize_mode, int nsd)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_inq_var_quantize(int ncid, int varid, int *quantize_modep, int *nsdp)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_set_metadata_index(int ncid, int flag, int *old_flagp)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_inq_metadata_index(int ncid, int *flagp, int *openedp)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_get_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int *filter_maskp, size_t *sizep, void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_put_chunk_raw(int ncid, int varid, const size_t *startp,
+                  unsigned int filter_mask, size_t size, const void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_iter_chunks_raw(int ncid, int varid, nc_chunk_iter_fn fn, void *udata)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_iter_byte_ranges(int ncid, int varid, nc_byte_range_fn fn, void *udata)
+{
+    return NC_EINVAL;
+}
+
+static int
+NCP_def_var_filter(int ncid, int varid, unsigned int id, size_t nparams,
+                   const unsigned int *params)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_inq_var_filter(int ncid, int varid, unsigned int *idp, size_t *nparamsp,
+                   unsigned int *params)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_get_vara_field(int ncid, int varid, int fieldid, const size_t *startp,
+                   const size_t *countp, void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_get_vara_packed(int ncid, int varid, const size_t *startp,
+                    const size_t *countp, size_t *offsetsp, void **datap)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_put_vara_packed(int ncid, int varid, const size_t *startp,
+                    const size_t *countp, const size_t *offsetsp,
+                    const void *data)
+{
+    return NC_ENOTNC4;
+}
+
+static int
+NCP_inq_var_filter_ids(int ncid, int varid, size_t *nfiltersp,
+                       unsigned int *ids)
+{
+    return NC_ENOTNC4;
+}
+
 /**************************************************/
 /* Pnetcdf Dispatch table */
 
@@ -1586,6 +1707,31 @@ NCP_set_var_chunk_cache,
 NCP_get_var_chunk_cache,
 #endif /*USE_NETCDF4*/
 
+NCP_inq_io_stats,
+NCP_reset_io_stats,
+
+NCP_inq_memory_usage,
+
+NCP_set_append_mode,
+
+NCDEFAULT_get_var_points,
+
+NCP_def_var_quantize,
+NCP_inq_var_quantize,
+
+NCP_set_metadata_index,
+NCP_inq_metadata_index,
+NCP_get_chunk_raw,
+NCP_put_chunk_raw,
+NCP_iter_chunks_raw,
+NCP_iter_byte_ranges,
+NCP_def_var_filter,
+NCP_inq_var_filter,
+NCP_get_vara_field,
+NCP_get_vara_packed,
+NCP_put_vara_packed,
+NCP_inq_var_filter_ids,
+
 };
 
 NC_Dispatch* NCP_dispatch_table = NULL; /* moved here from ddispatch.c */
@@ -0,0 +1,1287 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   nc_bench: the netCDF performance benchmark suite.
+
+   Every kernel generates its own synthetic data, so no external
+   files are needed. Each kernel times its individual operations and
+   reports throughput together with latency percentiles. Results are
+   written as JSON, and may be compared against a baseline written by
+   an earlier run; the program exits with a non-zero status if any
+   kernel has slowed down by more than the allowed tolerance, unless
+   the slowdowns are only to be reported.
+
+   The data files are written to the current directory, so runs that
+   may overlap must be made from different directories.
+
+   Usage: nc_bench [-q] [-l] [-r] [-s scale] [-k filter] [-o results.json]
+                   [-b baseline.json] [-t tolerance]
+
+   -q  quick: smallest scale, useful as a smoke test
+   -l  list the kernels and exit
+   -r  report slowdowns against the baseline without failing
+   -s  dataset scale factor (default 8; each step adds 512 KB per dataset)
+   -k  only run kernels whose name contains this string
+   -o  write the JSON results to this file (default: stdout)
+   -b  compare against this baseline file
+   -t  tolerated slowdown as a fraction of the baseline (default 0.25)
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <netcdf.h>
+
+#define NCOLS 1024              /* floats per row */
+#define SLAB 8                  /* rows per read/write operation */
+#define ROWS_PER_SCALE 128      /* rows in a dataset per unit of scale */
+#define META_VARS_PER_SCALE 25  /* variables in the metadata file */
+#define META_ATTS 6             /* attributes per metadata variable */
+#define META_OPENS 20           /* opens timed by the metadata kernels */
+#define POINTS_BATCH 256        /* points per nc_get_var_points call */
+#define REDUCE_ROWS 64          /* rows per nc_get_vara_reduce call */
+#define OBS_FIELDS 50           /* floats in each compound record */
+#define OBS_FIELD 7             /* the field read by nc_get_vara_field */
+#define OBS_SLAB 1024           /* compound records per read */
+#define STRS_PER_ROW 16         /* strings in the string file per row */
+#define STR_SLAB 1024           /* strings per read */
+#define DEFAULT_SCALE 8
+#define DEFAULT_TOLERANCE 0.25
+
+#define CLASSIC_FILE "nc_bench_classic.nc"
+#define NC4_FILE "nc_bench_nc4.nc"
+#define DEFLATE_FILE "nc_bench_deflate.nc"
+#define RECORD_FILE "nc_bench_record.nc"
+#define PACK_FILE "nc_bench_pack.nc"
+#define PACK_DEFLATE_FILE "nc_bench_pack4.nc"
+#define META_CLASSIC_FILE "nc_bench_meta.nc"
+#define META_NC4_FILE "nc_bench_meta4.nc"
+#define OBS_FILE "nc_bench_obs.nc"
+#define STR_FILE "nc_bench_str.nc"
+#define SYNC_FILE "nc_bench_sync.nc"
+
+/* Bail out of a kernel on any netCDF error. */
+#define CHECK(stat) do { int _s = (stat); if (_s) { \
+   fprintf(stderr, "nc_bench: %s:%d: %s\n", __FILE__, __LINE__, \
+	   nc_strerror(_s)); return _s; } } while (0)
+
+/* The timings of one kernel. */
+typedef struct RESULT {
+   size_t nops;
+   size_t alloc;
+   double *lat;                 /* seconds per operation */
+   double seconds;              /* sum of the operation latencies */
+   unsigned long long bytes;    /* bytes moved to or from the caller */
+} RESULT;
+
+typedef int (*KERNEL)(RESULT *);
+
+typedef struct BENCH {
+   const char *name;
+   KERNEL run;
+   const char *desc;
+} BENCH;
+
+static size_t nrows;            /* rows in each dataset */
+static int nmetavars;           /* variables in each metadata file */
+static float *rowbuf;           /* SLAB rows of data */
+static float *checkbuf;         /* SLAB rows read back */
+
+/* Wall clock time in seconds. */
+static double
+bench_clock(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+#elif defined(HAVE_GETTIMEOFDAY)
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return (double)tv.tv_sec + (double)tv.tv_usec * 1.0e-6;
+#else
+   return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static void
+record(RESULT *r, double start, size_t bytes)
+{
+   double lat = bench_clock() - start;
+   if (r->nops == r->alloc)
+   {
+      r->alloc = r->alloc ? 2 * r->alloc : 64;
+      r->lat = realloc(r->lat, r->alloc * sizeof(double));
+      if (r->lat == NULL)
+      {
+	 fprintf(stderr, "nc_bench: out of memory\n");
+	 exit(2);
+      }
+   }
+   r->lat[r->nops++] = lat;
+   r->seconds += lat;
+   r->bytes += bytes;
+}
+
+/* A smooth field, so that the compression kernels have something to
+ * work with, but not a constant one. */
+static void
+fill_slab(float *buf, size_t row0, size_t nr)
+{
+   size_t i, j;
+   for (i = 0; i < nr; i++)
+      for (j = 0; j < NCOLS; j++)
+	 buf[i * NCOLS + j] = (float)((row0 + i) % 97) * 0.25f + (float)j * 0.001f;
+}
+
+static int
+verify_slab(const float *buf, size_t row0, size_t nr)
+{
+   fill_slab(rowbuf, row0, nr);
+   if (memcmp(buf, rowbuf, nr * NCOLS * sizeof(float)))
+   {
+      fprintf(stderr, "nc_bench: wrong data read at row %lu\n",
+	      (unsigned long)row0);
+      return NC_EINVAL;
+   }
+   return NC_NOERR;
+}
+
+/* Create a file with one [rows][cols] float variable and write it a
+ * slab at a time, timing each write. */
+static int
+write_grid(RESULT *r, const char *path, int cmode, int deflate)
+{
+   int ncid, varid, dimids[2];
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS};
+   double t0;
+
+   CHECK(nc_create(path, cmode|NC_CLOBBER, &ncid));
+   CHECK(nc_set_fill(ncid, NC_NOFILL, NULL));
+   CHECK(nc_def_dim(ncid, "row", nrows, &dimids[0]));
+   CHECK(nc_def_dim(ncid, "col", NCOLS, &dimids[1]));
+   CHECK(nc_def_var(ncid, "data", NC_FLOAT, 2, dimids, &varid));
+#ifdef USE_NETCDF4
+   if (cmode & NC_NETCDF4)
+   {
+      size_t chunks[2] = {SLAB, NCOLS};
+      CHECK(nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks));
+      if (deflate)
+	 CHECK(nc_def_var_deflate(ncid, varid, 1, 1, 1));
+   }
+#endif
+   CHECK(nc_enddef(ncid));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      fill_slab(rowbuf, start[0], SLAB);
+      t0 = bench_clock();
+      CHECK(nc_put_vara_float(ncid, varid, start, count, rowbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+   }
+   /* The close flushes the data, so it is part of the last write. */
+   t0 = bench_clock();
+   CHECK(nc_close(ncid));
+   t0 = bench_clock() - t0;
+   r->seconds += t0;
+   r->lat[r->nops - 1] += t0;
+   (void)deflate;
+   return NC_NOERR;
+}
+
+/* Read back the file written by write_grid(), a slab at a time. */
+static int
+read_grid(RESULT *r, const char *path, int omode)
+{
+   int ncid, varid;
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS};
+   double t0;
+
+   CHECK(nc_open(path, omode, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_vara_float(ncid, varid, start, count, checkbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+      CHECK(verify_slab(checkbuf, start[0], SLAB));
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* The read kernels use the files of the write kernels; make sure they
+ * exist when a read kernel is run on its own. */
+static int
+ensure_grid(const char *path, int cmode, int deflate)
+{
+   RESULT scratch;
+   int ncid, stat;
+
+   if (nc_open(path, NC_NOWRITE, &ncid) == NC_NOERR)
+   {
+      size_t len;
+      int dimid;
+      stat = nc_inq_dimid(ncid, "row", &dimid);
+      if (!stat)
+	 stat = nc_inq_dimlen(ncid, dimid, &len);
+      nc_close(ncid);
+      if (!stat && len == nrows)
+	 return NC_NOERR;
+   }
+   memset(&scratch, 0, sizeof(scratch));
+   stat = write_grid(&scratch, path, cmode, deflate);
+   free(scratch.lat);
+   return stat;
+}
+
+static int
+classic_write(RESULT *r)
+{
+   return write_grid(r, CLASSIC_FILE, 0, 0);
+}
+
+static int
+classic_read(RESULT *r)
+{
+   CHECK(ensure_grid(CLASSIC_FILE, 0, 0));
+   return read_grid(r, CLASSIC_FILE, NC_NOWRITE);
+}
+
+/* Every other row and column of a slab twice the usual height. */
+static int
+classic_strided_read(RESULT *r)
+{
+   int ncid, varid;
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS / 2};
+   ptrdiff_t stride[2] = {2, 2};
+   double t0;
+   size_t i, j;
+
+   CHECK(ensure_grid(CLASSIC_FILE, 0, 0));
+   CHECK(nc_open(CLASSIC_FILE, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (start[0] = 0; start[0] + 2 * SLAB <= nrows; start[0] += 2 * SLAB)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_vars_float(ncid, varid, start, count, stride, checkbuf));
+      record(r, t0, SLAB * (NCOLS / 2) * sizeof(float));
+      for (i = 0; i < SLAB; i++)
+      {
+	 fill_slab(rowbuf, start[0] + 2 * i, 1);
+	 for (j = 0; j < NCOLS / 2; j++)
+	    if (checkbuf[i * (NCOLS / 2) + j] != rowbuf[2 * j])
+	    {
+	       fprintf(stderr, "nc_bench: wrong strided data\n");
+	       return NC_EINVAL;
+	    }
+      }
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* A slab read transposed into memory through an index map. */
+static int
+classic_varm_read(RESULT *r)
+{
+   int ncid, varid;
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS};
+   ptrdiff_t imap[2] = {1, SLAB};
+   double t0;
+   size_t i, j;
+
+   CHECK(ensure_grid(CLASSIC_FILE, 0, 0));
+   CHECK(nc_open(CLASSIC_FILE, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_varm_float(ncid, varid, start, count, NULL, imap, checkbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+      fill_slab(rowbuf, start[0], SLAB);
+      for (i = 0; i < SLAB; i++)
+	 for (j = 0; j < NCOLS; j++)
+	    if (checkbuf[j * SLAB + i] != rowbuf[i * NCOLS + j])
+	    {
+	       fprintf(stderr, "nc_bench: wrong mapped data\n");
+	       return NC_EINVAL;
+	    }
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* Append records one at a time to two record variables. */
+static int
+classic_record_append(RESULT *r)
+{
+   int ncid, varid, timeid, dimids[2];
+   size_t start[2] = {0, 0}, count[2] = {1, NCOLS};
+   double t0, time;
+
+   CHECK(nc_create(RECORD_FILE, NC_CLOBBER, &ncid));
+   CHECK(nc_set_fill(ncid, NC_NOFILL, NULL));
+   CHECK(nc_def_dim(ncid, "time", NC_UNLIMITED, &dimids[0]));
+   CHECK(nc_def_dim(ncid, "col", NCOLS, &dimids[1]));
+   CHECK(nc_def_var(ncid, "time", NC_DOUBLE, 1, dimids, &timeid));
+   CHECK(nc_def_var(ncid, "data", NC_FLOAT, 2, dimids, &varid));
+   CHECK(nc_enddef(ncid));
+   for (start[0] = 0; start[0] < nrows; start[0]++)
+   {
+      fill_slab(rowbuf, start[0], 1);
+      time = (double)start[0];
+      t0 = bench_clock();
+      CHECK(nc_put_var1_double(ncid, timeid, start, &time));
+      CHECK(nc_put_vara_float(ncid, varid, start, count, rowbuf));
+      record(r, t0, NCOLS * sizeof(float) + sizeof(double));
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* A file with many small variables, each with a few attributes. */
+static int
+write_meta(const char *path, int cmode)
+{
+   int ncid, dimid, varid, v, a;
+   char name[NC_MAX_NAME + 1];
+   int ival;
+
+   CHECK(nc_create(path, cmode|NC_CLOBBER, &ncid));
+   CHECK(nc_def_dim(ncid, "x", 4, &dimid));
+   CHECK(nc_put_att_text(ncid, NC_GLOBAL, "title", 8, "nc_bench"));
+   for (v = 0; v < nmetavars; v++)
+   {
+      snprintf(name, sizeof(name), "var_%04d", v);
+      CHECK(nc_def_var(ncid, name, NC_INT, 1, &dimid, &varid));
+      CHECK(nc_put_att_text(ncid, varid, "long_name", strlen(name), name));
+      CHECK(nc_put_att_text(ncid, varid, "units", 1, "1"));
+      for (a = 2; a < META_ATTS; a++)
+      {
+	 snprintf(name, sizeof(name), "att_%d", a);
+	 ival = v * a;
+	 CHECK(nc_put_att_int(ncid, varid, name, NC_INT, 1, &ival));
+      }
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* Time an open followed by a full walk of the metadata, as a file
+ * browser or ncdump -h would do it. */
+static int
+open_meta(RESULT *r, const char *path, int cmode)
+{
+   int ncid, nvars, natts, v, a, i;
+   char name[NC_MAX_NAME + 1];
+   nc_type type;
+   size_t len;
+   double t0;
+
+   CHECK(write_meta(path, cmode));
+   for (i = 0; i < META_OPENS; i++)
+   {
+      t0 = bench_clock();
+      CHECK(nc_open(path, NC_NOWRITE, &ncid));
+      CHECK(nc_inq(ncid, NULL, &nvars, NULL, NULL));
+      for (v = 0; v < nvars; v++)
+      {
+	 CHECK(nc_inq_var(ncid, v, name, &type, NULL, NULL, &natts));
+	 for (a = 0; a < natts; a++)
+	 {
+	    CHECK(nc_inq_attname(ncid, v, a, name));
+	    CHECK(nc_inq_att(ncid, v, name, &type, &len));
+	 }
+      }
+      CHECK(nc_close(ncid));
+      record(r, t0, 0);
+      if (nvars != nmetavars)
+      {
+	 fprintf(stderr, "nc_bench: wrong number of variables\n");
+	 return NC_EINVAL;
+      }
+   }
+   return NC_NOERR;
+}
+
+static int
+classic_metadata_open(RESULT *r)
+{
+   return open_meta(r, META_CLASSIC_FILE, 0);
+}
+
+/* Scattered single values, read POINTS_BATCH at a time with
+ * nc_get_var_points. */
+static int
+var_points(RESULT *r, const char *path, int cmode, int deflate)
+{
+   int ncid, varid;
+   size_t index[POINTS_BATCH][2], npoints = nrows * 16, g, k;
+   double t0;
+
+   CHECK(ensure_grid(path, cmode, deflate));
+   CHECK(nc_open(path, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (g = 0; g + POINTS_BATCH <= npoints; g += POINTS_BATCH)
+   {
+      for (k = 0; k < POINTS_BATCH; k++)
+      {
+	 index[k][0] = ((g + k) * 37) % nrows;
+	 index[k][1] = ((g + k) * 61 + (g + k) / 7) % NCOLS;
+      }
+      t0 = bench_clock();
+      CHECK(nc_get_var_points_float(ncid, varid, POINTS_BATCH, &index[0][0],
+				    checkbuf));
+      record(r, t0, POINTS_BATCH * sizeof(float));
+      for (k = 0; k < POINTS_BATCH; k++)
+      {
+	 fill_slab(rowbuf, index[k][0], 1);
+	 if (checkbuf[k] != rowbuf[index[k][1]])
+	 {
+	    fprintf(stderr, "nc_bench: wrong point data\n");
+	    return NC_EINVAL;
+	 }
+      }
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+static int
+classic_var_points(RESULT *r)
+{
+   return var_points(r, CLASSIC_FILE, 0, 0);
+}
+
+/* The mean of each row, REDUCE_ROWS rows at a time, with
+ * nc_get_vara_reduce. */
+static int
+reduce_rows(RESULT *r, const char *path, int cmode, int deflate)
+{
+   int ncid, varid, reduce[2] = {0, 1};
+   size_t start[2] = {0, 0}, count[2] = {REDUCE_ROWS, NCOLS}, i;
+   double means[REDUCE_ROWS], t0;
+
+   CHECK(ensure_grid(path, cmode, deflate));
+   CHECK(nc_open(path, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (start[0] = 0; start[0] + REDUCE_ROWS <= nrows; start[0] += REDUCE_ROWS)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_vara_reduce(ncid, varid, start, count, reduce,
+			       NC_REDUCE_MEAN, means));
+      record(r, t0, REDUCE_ROWS * NCOLS * sizeof(float));
+      for (i = 0; i < REDUCE_ROWS; i++)
+      {
+	 double diff = means[i] - (((start[0] + i) % 97) * 0.25 +
+				   (NCOLS - 1) * 0.0005);
+	 if (diff > 1e-3 || diff < -1e-3)
+	 {
+	    fprintf(stderr, "nc_bench: wrong mean of row %lu\n",
+		    (unsigned long)(start[0] + i));
+	    return NC_EINVAL;
+	 }
+      }
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+static int
+classic_reduce(RESULT *r)
+{
+   return reduce_rows(r, CLASSIC_FILE, 0, 0);
+}
+
+/* Read slabs with nc_get_vara_unpack_float, which masks the fill
+ * values (there are none) as it converts. */
+static int
+unpack_grid(RESULT *r, const char *path, int cmode, int deflate)
+{
+   int ncid, varid;
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS};
+   double t0;
+
+   CHECK(ensure_grid(path, cmode, deflate));
+   CHECK(nc_open(path, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_vara_unpack_float(ncid, varid, start, count, checkbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+      CHECK(verify_slab(checkbuf, start[0], SLAB));
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+static int
+classic_unpack_read(RESULT *r)
+{
+   return unpack_grid(r, CLASSIC_FILE, 0, 0);
+}
+
+/* Write slabs of the grid packed into shorts with
+ * nc_put_vara_pack_float, then check a slab read back. */
+static int
+pack_grid(RESULT *r, const char *path, int cmode, int deflate)
+{
+   int ncid, varid, dimids[2];
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS}, i;
+   float scale = 0.001f, offset = 12.0f;
+   double t0;
+
+   CHECK(nc_create(path, cmode|NC_CLOBBER, &ncid));
+   CHECK(nc_set_fill(ncid, NC_NOFILL, NULL));
+   CHECK(nc_def_dim(ncid, "row", nrows, &dimids[0]));
+   CHECK(nc_def_dim(ncid, "col", NCOLS, &dimids[1]));
+   CHECK(nc_def_var(ncid, "data", NC_SHORT, 2, dimids, &varid));
+   CHECK(nc_put_att_float(ncid, varid, "scale_factor", NC_FLOAT, 1, &scale));
+   CHECK(nc_put_att_float(ncid, varid, "add_offset", NC_FLOAT, 1, &offset));
+#ifdef USE_NETCDF4
+   if (cmode & NC_NETCDF4)
+   {
+      size_t chunks[2] = {SLAB, NCOLS};
+      CHECK(nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks));
+      if (deflate)
+	 CHECK(nc_def_var_deflate(ncid, varid, 1, 1, 1));
+   }
+#endif
+   CHECK(nc_enddef(ncid));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      fill_slab(rowbuf, start[0], SLAB);
+      t0 = bench_clock();
+      CHECK(nc_put_vara_pack_float(ncid, varid, start, count, rowbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+   }
+   t0 = bench_clock();
+   CHECK(nc_close(ncid));
+   t0 = bench_clock() - t0;
+   r->seconds += t0;
+   r->lat[r->nops - 1] += t0;
+
+   CHECK(nc_open(path, NC_NOWRITE, &ncid));
+   start[0] = nrows - SLAB;
+   CHECK(nc_get_vara_unpack_float(ncid, varid, start, count, checkbuf));
+   CHECK(nc_close(ncid));
+   fill_slab(rowbuf, start[0], SLAB);
+   for (i = 0; i < SLAB * NCOLS; i++)
+      if (checkbuf[i] - rowbuf[i] > 0.0006f || rowbuf[i] - checkbuf[i] > 0.0006f)
+      {
+	 fprintf(stderr, "nc_bench: wrong packed data\n");
+	 return NC_EINVAL;
+      }
+   (void)deflate;
+   return NC_NOERR;
+}
+
+static int
+classic_pack_write(RESULT *r)
+{
+   return pack_grid(r, PACK_FILE, 0, 0);
+}
+
+#ifdef USE_NETCDF4
+static int
+nc4_write(RESULT *r)
+{
+   return write_grid(r, NC4_FILE, NC_NETCDF4, 0);
+}
+
+static int
+nc4_read(RESULT *r)
+{
+   CHECK(ensure_grid(NC4_FILE, NC_NETCDF4, 0));
+   return read_grid(r, NC4_FILE, NC_NOWRITE);
+}
+
+static int
+nc4_deflate_write(RESULT *r)
+{
+   return write_grid(r, DEFLATE_FILE, NC_NETCDF4, 1);
+}
+
+static int
+nc4_deflate_read(RESULT *r)
+{
+   CHECK(ensure_grid(DEFLATE_FILE, NC_NETCDF4, 1));
+   return read_grid(r, DEFLATE_FILE, NC_NOWRITE);
+}
+
+static int
+nc4_strided_read(RESULT *r)
+{
+   int ncid, varid;
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS / 2};
+   ptrdiff_t stride[2] = {2, 2};
+   double t0;
+
+   CHECK(ensure_grid(NC4_FILE, NC_NETCDF4, 0));
+   CHECK(nc_open(NC4_FILE, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (start[0] = 0; start[0] + 2 * SLAB <= nrows; start[0] += 2 * SLAB)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_vars_float(ncid, varid, start, count, stride, checkbuf));
+      record(r, t0, SLAB * (NCOLS / 2) * sizeof(float));
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* Single values read one at a time, as a time-series reader does. */
+static int
+point_read(RESULT *r, const char *path, int deflate)
+{
+   int ncid, varid;
+   size_t index[2];
+   float val;
+   double t0;
+
+   CHECK(ensure_grid(path, NC_NETCDF4, deflate));
+   CHECK(nc_open(path, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "data", &varid));
+   for (index[0] = 0; index[0] < nrows; index[0]++)
+   {
+      fill_slab(rowbuf, index[0], 1);
+      for (index[1] = index[0] % 17; index[1] < NCOLS; index[1] += 61)
+      {
+	 t0 = bench_clock();
+	 CHECK(nc_get_var1_float(ncid, varid, index, &val));
+	 record(r, t0, sizeof(float));
+	 if (val != rowbuf[index[1]])
+	 {
+	    fprintf(stderr, "nc_bench: wrong point data\n");
+	    return NC_EINVAL;
+	 }
+      }
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+static int
+nc4_point_read(RESULT *r)
+{
+   return point_read(r, NC4_FILE, 0);
+}
+
+static int
+nc4_deflate_point_read(RESULT *r)
+{
+   return point_read(r, DEFLATE_FILE, 1);
+}
+
+static int
+nc4_var_points(RESULT *r)
+{
+   return var_points(r, NC4_FILE, NC_NETCDF4, 0);
+}
+
+static int
+nc4_deflate_var_points(RESULT *r)
+{
+   return var_points(r, DEFLATE_FILE, NC_NETCDF4, 1);
+}
+
+static int
+nc4_deflate_reduce(RESULT *r)
+{
+   return reduce_rows(r, DEFLATE_FILE, NC_NETCDF4, 1);
+}
+
+static int
+nc4_deflate_unpack_read(RESULT *r)
+{
+   return unpack_grid(r, DEFLATE_FILE, NC_NETCDF4, 1);
+}
+
+static int
+nc4_deflate_pack_write(RESULT *r)
+{
+   return pack_grid(r, PACK_DEFLATE_FILE, NC_NETCDF4, 1);
+}
+
+static int
+nc4_metadata_open(RESULT *r)
+{
+   return open_meta(r, META_NC4_FILE, NC_NETCDF4);
+}
+
+/* A file of compound records of OBS_FIELDS floats each, holding the
+ * values of the grid one after another. */
+static int
+ensure_obs(void)
+{
+   int ncid, dimid, varid, f, stat;
+   size_t nobs = nrows * NCOLS / OBS_FIELDS, len;
+   nc_type typeid;
+   char name[NC_MAX_NAME + 1];
+   float *buf;
+
+   if (nc_open(OBS_FILE, NC_NOWRITE, &ncid) == NC_NOERR)
+   {
+      stat = nc_inq_dimid(ncid, "obs", &dimid);
+      if (!stat)
+	 stat = nc_inq_dimlen(ncid, dimid, &len);
+      nc_close(ncid);
+      if (!stat && len == nobs)
+	 return NC_NOERR;
+   }
+   if (!(buf = malloc(nrows * NCOLS * sizeof(float))))
+      return NC_ENOMEM;
+   fill_slab(buf, 0, nrows);
+   CHECK(nc_create(OBS_FILE, NC_NETCDF4|NC_CLOBBER, &ncid));
+   CHECK(nc_def_compound(ncid, OBS_FIELDS * sizeof(float), "obs_t", &typeid));
+   for (f = 0; f < OBS_FIELDS; f++)
+   {
+      snprintf(name, sizeof(name), "f%d", f);
+      CHECK(nc_insert_compound(ncid, typeid, name, f * sizeof(float), NC_FLOAT));
+   }
+   CHECK(nc_def_dim(ncid, "obs", nobs, &dimid));
+   CHECK(nc_def_var(ncid, "obs", typeid, 1, &dimid, &varid));
+   CHECK(nc_put_var(ncid, varid, buf));
+   CHECK(nc_close(ncid));
+   free(buf);
+   return NC_NOERR;
+}
+
+/* OBS_SLAB records at a time, whole or only their field OBS_FIELD. */
+static int
+read_obs(RESULT *r, int field_only)
+{
+   int ncid, varid;
+   size_t nobs = nrows * NCOLS / OBS_FIELDS, start[1], count[1] = {OBS_SLAB};
+   size_t i, flat, nvals = field_only ? 1 : OBS_FIELDS;
+   float *buf;
+   double t0;
+
+   CHECK(ensure_obs());
+   if (!(buf = malloc(OBS_SLAB * OBS_FIELDS * sizeof(float))))
+      return NC_ENOMEM;
+   CHECK(nc_open(OBS_FILE, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "obs", &varid));
+   for (start[0] = 0; start[0] + OBS_SLAB <= nobs; start[0] += OBS_SLAB)
+   {
+      t0 = bench_clock();
+      if (field_only)
+	 CHECK(nc_get_vara_field(ncid, varid, OBS_FIELD, start, count, buf));
+      else
+	 CHECK(nc_get_vara(ncid, varid, start, count, buf));
+      record(r, t0, OBS_SLAB * nvals * sizeof(float));
+      for (i = 0; i < OBS_SLAB; i++)
+      {
+	 flat = (start[0] + i) * OBS_FIELDS + OBS_FIELD;
+	 if (buf[i * nvals + (field_only ? 0 : OBS_FIELD)] !=
+	     (float)((flat / NCOLS) % 97) * 0.25f + (float)(flat % NCOLS) * 0.001f)
+	 {
+	    fprintf(stderr, "nc_bench: wrong compound data\n");
+	    return NC_EINVAL;
+	 }
+      }
+   }
+   CHECK(nc_close(ncid));
+   free(buf);
+   return NC_NOERR;
+}
+
+static int
+nc4_compound_read(RESULT *r)
+{
+   return read_obs(r, 0);
+}
+
+static int
+nc4_compound_field_read(RESULT *r)
+{
+   return read_obs(r, 1);
+}
+
+/* The string at index i of the string file. */
+static void
+make_str(char *s, size_t i)
+{
+   snprintf(s, 32, "station %lu/%lu", (unsigned long)i,
+	    (unsigned long)(i * 7919 % 1000));
+}
+
+/* A file of strings, STRS_PER_ROW for each row of the grid. */
+static int
+ensure_strs(void)
+{
+   int ncid, dimid, varid, stat;
+   size_t nstrs = nrows * STRS_PER_ROW, len, i;
+   char **strs, *buf;
+
+   if (nc_open(STR_FILE, NC_NOWRITE, &ncid) == NC_NOERR)
+   {
+      stat = nc_inq_dimid(ncid, "station", &dimid);
+      if (!stat)
+	 stat = nc_inq_dimlen(ncid, dimid, &len);
+      nc_close(ncid);
+      if (!stat && len == nstrs)
+	 return NC_NOERR;
+   }
+   if (!(strs = malloc(nstrs * sizeof(char *))) ||
+       !(buf = malloc(nstrs * 32)))
+      return NC_ENOMEM;
+   for (i = 0; i < nstrs; i++)
+   {
+      strs[i] = buf + i * 32;
+      make_str(strs[i], i);
+   }
+   CHECK(nc_create(STR_FILE, NC_NETCDF4|NC_CLOBBER, &ncid));
+   CHECK(nc_def_dim(ncid, "station", nstrs, &dimid));
+   CHECK(nc_def_var(ncid, "name", NC_STRING, 1, &dimid, &varid));
+   CHECK(nc_put_var_string(ncid, varid, (const char **)strs));
+   CHECK(nc_close(ncid));
+   free(buf);
+   free(strs);
+   return NC_NOERR;
+}
+
+/* STR_SLAB strings at a time, each in its own allocation, or packed
+ * into one. */
+static int
+read_strs(RESULT *r, int packed)
+{
+   int ncid, varid;
+   size_t nstrs = nrows * STRS_PER_ROW, start[1], count[1] = {STR_SLAB};
+   size_t offsets[STR_SLAB + 1], bytes, i;
+   char *strs[STR_SLAB], *data = NULL, s[32];
+   double t0, t1;
+
+   CHECK(ensure_strs());
+   CHECK(nc_open(STR_FILE, NC_NOWRITE, &ncid));
+   CHECK(nc_inq_varid(ncid, "name", &varid));
+   for (start[0] = 0; start[0] + STR_SLAB <= nstrs; start[0] += STR_SLAB)
+   {
+      t0 = bench_clock();
+      if (packed)
+      {
+	 CHECK(nc_get_vara_packed(ncid, varid, start, count, offsets,
+				  (void **)&data));
+	 for (i = 0; i < STR_SLAB; i++)
+	    strs[i] = data + offsets[i];
+	 bytes = offsets[STR_SLAB];
+      }
+      else
+      {
+	 CHECK(nc_get_vara_string(ncid, varid, start, count, strs));
+	 for (bytes = 0, i = 0; i < STR_SLAB; i++)
+	    bytes += strlen(strs[i]) + 1;
+      }
+
+      /* The strings are freed in the timed op, but not checked in it. */
+      t1 = bench_clock();
+      for (i = 0; i < STR_SLAB; i++)
+      {
+	 make_str(s, start[0] + i);
+	 if (strcmp(strs[i], s))
+	 {
+	    fprintf(stderr, "nc_bench: wrong string data\n");
+	    return NC_EINVAL;
+	 }
+      }
+      t0 += bench_clock() - t1;
+      if (packed)
+	 nc_free_packed(data);
+      else
+	 nc_free_string(STR_SLAB, strs);
+      record(r, t0, bytes);
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+static int
+nc4_string_read(RESULT *r)
+{
+   return read_strs(r, 0);
+}
+
+static int
+nc4_string_packed_read(RESULT *r)
+{
+   return read_strs(r, 1);
+}
+
+/* Row slabs written to a file that also holds the metadata of
+ * nmetavars vars, with nc_sync after each, as a writer does for crash
+ * safety. If unlimited, the rows are records, each slab with its
+ * times. */
+static int
+sync_grid(RESULT *r, int unlimited)
+{
+   int ncid, varid, timeid, metaid, dimids[2], stationid, v, a;
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS}, i;
+   double times[SLAB], t0;
+   float station[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+   char name[NC_MAX_NAME + 1];
+
+   CHECK(nc_create(SYNC_FILE, NC_NETCDF4|NC_CLOBBER, &ncid));
+   CHECK(nc_def_dim(ncid, "row", unlimited ? NC_UNLIMITED : nrows, &dimids[0]));
+   CHECK(nc_def_dim(ncid, "col", NCOLS, &dimids[1]));
+   CHECK(nc_def_dim(ncid, "station", 4, &stationid));
+   CHECK(nc_def_var(ncid, "row", NC_DOUBLE, 1, dimids, &timeid));
+   for (v = 0; v < nmetavars; v++)
+   {
+      snprintf(name, sizeof(name), "meta_%d", v);
+      CHECK(nc_def_var(ncid, name, NC_FLOAT, 1, &stationid, &metaid));
+      for (a = 0; a < META_ATTS; a++)
+      {
+	 snprintf(name, sizeof(name), "att_%d", a);
+	 CHECK(nc_put_att_int(ncid, metaid, name, NC_INT, 1, &a));
+      }
+   }
+   CHECK(nc_def_var(ncid, "data", NC_FLOAT, 2, dimids, &varid));
+   CHECK(nc_def_var_chunking(ncid, varid, NC_CHUNKED, count));
+   CHECK(nc_enddef(ncid));
+   CHECK(nc_put_var_float(ncid, metaid, station));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      fill_slab(rowbuf, start[0], SLAB);
+      for (i = 0; i < SLAB; i++)
+	 times[i] = (double)(start[0] + i);
+      t0 = bench_clock();
+      CHECK(nc_put_vara_float(ncid, varid, start, count, rowbuf));
+      CHECK(nc_put_vara_double(ncid, timeid, start, count, times));
+      CHECK(nc_sync(ncid));
+      record(r, t0, SLAB * (NCOLS * sizeof(float) + sizeof(double)));
+   }
+   CHECK(nc_close(ncid));
+
+   CHECK(nc_open(SYNC_FILE, NC_NOWRITE, &ncid));
+   start[0] = nrows - SLAB;
+   CHECK(nc_get_vara_float(ncid, varid, start, count, checkbuf));
+   CHECK(nc_close(ncid));
+   return verify_slab(checkbuf, start[0], SLAB);
+}
+
+static int
+nc4_sync_write(RESULT *r)
+{
+   return sync_grid(r, 0);
+}
+
+static int
+nc4_sync_append(RESULT *r)
+{
+   return sync_grid(r, 1);
+}
+#endif /* USE_NETCDF4 */
+
+#ifdef USE_DISKLESS
+/* Write and read back an in-memory file that is never persisted. */
+static int
+diskless_write_read(RESULT *r)
+{
+   int ncid, varid, dimids[2];
+   size_t start[2] = {0, 0}, count[2] = {SLAB, NCOLS};
+   double t0;
+
+   CHECK(nc_create("nc_bench_diskless.nc", NC_DISKLESS|NC_CLOBBER, &ncid));
+   CHECK(nc_set_fill(ncid, NC_NOFILL, NULL));
+   CHECK(nc_def_dim(ncid, "row", nrows, &dimids[0]));
+   CHECK(nc_def_dim(ncid, "col", NCOLS, &dimids[1]));
+   CHECK(nc_def_var(ncid, "data", NC_FLOAT, 2, dimids, &varid));
+   CHECK(nc_enddef(ncid));
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      fill_slab(rowbuf, start[0], SLAB);
+      t0 = bench_clock();
+      CHECK(nc_put_vara_float(ncid, varid, start, count, rowbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+   }
+   for (start[0] = 0; start[0] < nrows; start[0] += SLAB)
+   {
+      t0 = bench_clock();
+      CHECK(nc_get_vara_float(ncid, varid, start, count, checkbuf));
+      record(r, t0, SLAB * NCOLS * sizeof(float));
+      CHECK(verify_slab(checkbuf, start[0], SLAB));
+   }
+   CHECK(nc_close(ncid));
+   return NC_NOERR;
+}
+
+/* Read a classic file that is loaded into memory at open. */
+static int
+diskless_read(RESULT *r)
+{
+   CHECK(ensure_grid(CLASSIC_FILE, 0, 0));
+   return read_grid(r, CLASSIC_FILE, NC_NOWRITE|NC_DISKLESS);
+}
+#endif /* USE_DISKLESS */
+
+#ifdef USE_MMAP
+static int
+mmap_read(RESULT *r)
+{
+   CHECK(ensure_grid(CLASSIC_FILE, 0, 0));
+   return read_grid(r, CLASSIC_FILE, NC_NOWRITE|NC_DISKLESS|NC_MMAP);
+}
+#endif /* USE_MMAP */
+
+static BENCH benches[] = {
+   {"classic_write", classic_write, "row slabs written to a classic file"},
+   {"classic_read", classic_read, "row slabs read from a classic file"},
+   {"classic_strided_read", classic_strided_read, "nc_get_vars with stride 2x2"},
+   {"classic_varm_read", classic_varm_read, "nc_get_varm transposing into memory"},
+   {"classic_record_append", classic_record_append, "one record at a time"},
+   {"classic_metadata_open", classic_metadata_open, "open and walk a metadata-heavy file"},
+   {"classic_var_points", classic_var_points, "nc_get_var_points of scattered values"},
+   {"classic_reduce", classic_reduce, "nc_get_vara_reduce of row means"},
+   {"classic_unpack_read", classic_unpack_read, "row slabs read with nc_get_vara_unpack_float"},
+   {"classic_pack_write", classic_pack_write, "row slabs packed into shorts with nc_put_vara_pack_float"},
+#ifdef USE_NETCDF4
+   {"nc4_write", nc4_write, "row slabs written to a chunked netCDF-4 file"},
+   {"nc4_read", nc4_read, "row slabs read from a chunked netCDF-4 file"},
+   {"nc4_strided_read", nc4_strided_read, "nc_get_vars with stride 2x2"},
+   {"nc4_point_read", nc4_point_read, "nc_get_var1 of scattered single values"},
+   {"nc4_deflate_write", nc4_deflate_write, "as nc4_write, with shuffle and deflate"},
+   {"nc4_deflate_read", nc4_deflate_read, "as nc4_read, with shuffle and deflate"},
+   {"nc4_deflate_point_read", nc4_deflate_point_read, "as nc4_point_read, with shuffle and deflate"},
+   {"nc4_var_points", nc4_var_points, "nc_get_var_points of scattered values"},
+   {"nc4_deflate_var_points", nc4_deflate_var_points, "as nc4_var_points, with shuffle and deflate"},
+   {"nc4_deflate_reduce", nc4_deflate_reduce, "nc_get_vara_reduce of row means, with shuffle and deflate"},
+   {"nc4_deflate_unpack_read", nc4_deflate_unpack_read, "as classic_unpack_read, with shuffle and deflate"},
+   {"nc4_deflate_pack_write", nc4_deflate_pack_write, "as classic_pack_write, with shuffle and deflate"},
+   {"nc4_metadata_open", nc4_metadata_open, "open and walk a metadata-heavy file"},
+   {"nc4_compound_read", nc4_compound_read, "whole records of 50 float fields"},
+   {"nc4_compound_field_read", nc4_compound_field_read, "one field of those records, with nc_get_vara_field"},
+   {"nc4_string_read", nc4_string_read, "nc_get_vara_string and nc_free_string of short strings"},
+   {"nc4_string_packed_read", nc4_string_packed_read, "the same strings, with nc_get_vara_packed"},
+   {"nc4_sync_write", nc4_sync_write, "row slabs, each followed by nc_sync, in a file with many vars"},
+   {"nc4_sync_append", nc4_sync_append, "as nc4_sync_write, appending records along an unlimited dim"},
+#endif
+#ifdef USE_DISKLESS
+   {"diskless_write_read", diskless_write_read, "in-memory file written then read"},
+   {"diskless_read", diskless_read, "classic file loaded into memory at open"},
+#endif
+#ifdef USE_MMAP
+   {"mmap_read", mmap_read, "classic file mapped into memory at open"},
+#endif
+   {NULL, NULL, NULL}
+};
+
+static int
+cmp_double(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+   return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Nearest-rank percentile of sorted latencies, in microseconds. */
+static double
+percentile(const RESULT *r, double p)
+{
+   size_t rank;
+   if (r->nops == 0)
+      return 0;
+   rank = (size_t)(p * (double)r->nops + 0.5);
+   if (rank < 1)
+      rank = 1;
+   if (rank > r->nops)
+      rank = r->nops;
+   return r->lat[rank - 1] * 1.0e6;
+}
+
+/* Find the median latency of a kernel in a baseline file. The file is
+ * one written by this program, so a full JSON parser is not needed. */
+static double
+baseline_p50(const char *text, const char *name)
+{
+   char key[NC_MAX_NAME + 16];
+   const char *p;
+
+   snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+   if ((p = strstr(text, key)) == NULL)
+      return -1;
+   if ((p = strstr(p, "\"p50_us\": ")) == NULL)
+      return -1;
+   return strtod(p + strlen("\"p50_us\": "), NULL);
+}
+
+static char *
+read_file(const char *path)
+{
+   FILE *fp;
+   long size;
+   char *text;
+
+   if ((fp = fopen(path, "rb")) == NULL)
+      return NULL;
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+   if (size < 0 || (text = malloc((size_t)size + 1)) == NULL)
+   {
+      fclose(fp);
+      return NULL;
+   }
+   size = (long)fread(text, 1, (size_t)size, fp);
+   text[size] = '\0';
+   fclose(fp);
+   return text;
+}
+
+static void
+usage(void)
+{
+   fprintf(stderr, "usage: nc_bench [-q] [-l] [-r] [-s scale] [-k filter] "
+	   "[-o results.json] [-b baseline.json] [-t tolerance]\n");
+   exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+   int scale = DEFAULT_SCALE;
+   double tolerance = DEFAULT_TOLERANCE;
+   const char *filter = NULL, *outpath = NULL, *basepath = NULL;
+   char *basetext = NULL;
+   RESULT *results;
+   FILE *out = stdout;
+   int c, b, nbench, first = 1, regressions = 0, failures = 0, report = 0;
+
+   while ((c = getopt(argc, argv, "qlrs:k:o:b:t:")) != -1)
+      switch (c)
+      {
+      case 'q':
+	 scale = 1;
+	 break;
+      case 'l':
+	 for (b = 0; benches[b].name; b++)
+	    printf("%-24s %s\n", benches[b].name, benches[b].desc);
+	 return 0;
+      case 'r':
+	 report = 1;
+	 break;
+      case 's':
+	 if ((scale = atoi(optarg)) < 1)
+	    usage();
+	 break;
+      case 'k':
+	 filter = optarg;
+	 break;
+      case 'o':
+	 outpath = optarg;
+	 break;
+      case 'b':
+	 basepath = optarg;
+	 break;
+      case 't':
+	 tolerance = strtod(optarg, NULL);
+	 if (tolerance <= 0 || tolerance >= 1)
+	    usage();
+	 break;
+      default:
+	 usage();
+      }
+
+   if (basepath && (basetext = read_file(basepath)) == NULL)
+   {
+      fprintf(stderr, "nc_bench: cannot read baseline %s\n", basepath);
+      return 2;
+   }
+   if (outpath && (out = fopen(outpath, "w")) == NULL)
+   {
+      fprintf(stderr, "nc_bench: cannot write %s\n", outpath);
+      return 2;
+   }
+
+   nrows = (size_t)scale * ROWS_PER_SCALE;
+   nmetavars = scale * META_VARS_PER_SCALE;
+   for (nbench = 0; benches[nbench].name; nbench++)
+      ;
+   rowbuf = malloc(SLAB * NCOLS * sizeof(float));
+   checkbuf = malloc(SLAB * NCOLS * sizeof(float));
+   results = calloc((size_t)nbench, sizeof(RESULT));
+   if (!rowbuf || !checkbuf || !results)
+   {
+      fprintf(stderr, "nc_bench: out of memory\n");
+      return 2;
+   }
+
+   fprintf(out, "{\n  \"benchmark\": \"nc_bench\",\n"
+	   "  \"version\": \"%s\",\n  \"scale\": %d,\n  \"results\": [\n",
+	   nc_inq_libvers(), scale);
+   for (b = 0; b < nbench; b++)
+   {
+      RESULT *r = &results[b];
+      double p50, base;
+
+      if (filter && !strstr(benches[b].name, filter))
+	 continue;
+      if (benches[b].run(r) || r->nops == 0)
+      {
+	 fprintf(stderr, "nc_bench: %s failed\n", benches[b].name);
+	 failures++;
+	 continue;
+      }
+      qsort(r->lat, r->nops, sizeof(double), cmp_double);
+      p50 = percentile(r, 0.50);
+      fprintf(out, "%s    {\"name\": \"%s\", \"ops\": %lu, \"bytes\": %llu, "
+	      "\"seconds\": %.6f, \"mb_per_sec\": %.3f, \"ops_per_sec\": %.3f, "
+	      "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+	      "\"max_us\": %.3f}",
+	      first ? "" : ",\n", benches[b].name, (unsigned long)r->nops,
+	      r->bytes, r->seconds,
+	      r->seconds > 0 ? (double)r->bytes / r->seconds / 1.0e6 : 0.0,
+	      r->seconds > 0 ? (double)r->nops / r->seconds : 0.0,
+	      p50, percentile(r, 0.90), percentile(r, 0.99),
+	      percentile(r, 1.0));
+      first = 0;
+
+      /* Compare median latencies; they are much less noisy than the
+       * totals on a shared machine. */
+      if (basetext && (base = baseline_p50(basetext, benches[b].name)) > 0)
+      {
+	 double speed = base / p50;
+	 fprintf(stderr, "%-24s %10.1f us  baseline %10.1f us  %5.2fx%s\n",
+		 benches[b].name, p50, base, speed,
+		 speed < 1.0 - tolerance ? "  REGRESSION" : "");
+	 if (speed < 1.0 - tolerance)
+	    regressions++;
+      }
+      else if (basetext)
+	 fprintf(stderr, "%-24s not in the baseline\n", benches[b].name);
+   }
+   fprintf(out, "\n  ]\n}\n");
+   if (out != stdout)
+      fclose(out);
+
+   remove(CLASSIC_FILE);
+   remove(NC4_FILE);
+   remove(DEFLATE_FILE);
+   remove(RECORD_FILE);
+   remove(PACK_FILE);
+   remove(PACK_DEFLATE_FILE);
+   remove(META_CLASSIC_FILE);
+   remove(META_NC4_FILE);
+   remove(OBS_FILE);
+   remove(STR_FILE);
+   remove(SYNC_FILE);
+   for (b = 0; b < nbench; b++)
+      free(results[b].lat);
+   free(results);
+   free(rowbuf);
+   free(checkbuf);
+   free(basetext);
+
+   if (regressions)
+      fprintf(stderr, "nc_bench: %d kernel(s) slower than the baseline by more "
+	      "than %.0f%%\n", regressions, tolerance * 100);
+   return failures || (regressions && !report) ? 1 : 0;
+}
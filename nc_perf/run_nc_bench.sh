@@ -0,0 +1,41 @@
+#!/bin/sh
+if test "x$SETX" = x1 ; then echo "file=$0"; set -x ; fi
+# This shell script runs the nc_bench benchmark suite. The first run
+# records its results as the baseline; later runs report the kernels
+# slower than the baseline by more than the tolerance, but only fail
+# if a kernel fails. The data files are written in a directory of
+# their own, so that other runs of nc_bench do not overwrite them.
+#
+# NC_BENCH_BASELINE  baseline file (default nc_bench_baseline.json)
+# NC_BENCH_TOLERANCE allowed slowdown as a fraction (default 0.5)
+# NC_BENCH_SCALE     dataset scale (default 8)
+
+set -e
+
+TOP=`pwd`
+BASELINE=${NC_BENCH_BASELINE:-nc_bench_baseline.json}
+TOLERANCE=${NC_BENCH_TOLERANCE:-0.5}
+SCALE=${NC_BENCH_SCALE:-8}
+case "$BASELINE" in
+/*) ;;
+*) BASELINE="$TOP/$BASELINE" ;;
+esac
+
+rm -rf nc_bench_run
+mkdir nc_bench_run
+cd nc_bench_run
+
+echo ""
+echo "*** Running the nc_bench benchmark suite."
+if test -f "$BASELINE" ; then
+echo "*** Comparing against $BASELINE with tolerance $TOLERANCE."
+"$TOP/nc_bench" -r -s $SCALE -o "$TOP/nc_bench.json" -b "$BASELINE" -t $TOLERANCE
+else
+echo "*** No baseline yet; recording $BASELINE."
+"$TOP/nc_bench" -s $SCALE -o "$BASELINE"
+cp "$BASELINE" "$TOP/nc_bench.json"
+fi
+cd "$TOP"
+rm -rf nc_bench_run
+echo "*** Results are in nc_bench.json."
+exit 0
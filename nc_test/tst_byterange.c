@@ -0,0 +1,368 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test reading classic files through the byte-range ncio package
+   (url#mode=bytes): through file:// urls, for which libcurl honors
+   ranges, and through http:// urls served by a small server forked by
+   the test, which answers range requests with 206 Partial Content, or
+   ignores them and answers with the whole file.
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define HTTP_SERVER 1
+#endif
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_byterange.nc"
+#define NX 500
+#define NY 40
+#define NREC 7
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+/* Room for the scheme, host, file name and fragment after the path. */
+#define URLLEN (PATH_MAX + 256)
+
+static int
+create_file(int cmode)
+{
+   int ncid, xdim, ydim, recdim, varid, recvarid;
+   int dimids[2];
+   size_t start[2], count[2];
+   static double data[NX*NY];
+   int rec[NY];
+   int i, r;
+
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "x", NX, &xdim)) ERR;
+   if (nc_def_dim(ncid, "y", NY, &ydim)) ERR;
+   if (nc_def_dim(ncid, "time", NC_UNLIMITED, &recdim)) ERR;
+   dimids[0] = xdim;
+   dimids[1] = ydim;
+   if (nc_def_var(ncid, "data", NC_DOUBLE, 2, dimids, &varid)) ERR;
+   dimids[0] = recdim;
+   if (nc_def_var(ncid, "rec", NC_INT, 2, dimids, &recvarid)) ERR;
+   if (nc_put_att_text(ncid, NC_GLOBAL, "title", 9, "byterange")) ERR;
+   if (nc_enddef(ncid)) ERR;
+   for (i = 0; i < NX*NY; i++)
+      data[i] = i * 0.5;
+   if (nc_put_var_double(ncid, varid, data)) ERR;
+   count[0] = 1;
+   count[1] = NY;
+   start[1] = 0;
+   for (r = 0; r < NREC; r++) {
+      for (i = 0; i < NY; i++)
+	 rec[i] = r * 1000 + i;
+      start[0] = r;
+      if (nc_put_vara_int(ncid, recvarid, start, count, rec)) ERR;
+   }
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+static int
+check_file(const char *url)
+{
+   int ncid, varid, recvarid, ndims, nvars, natts, unlimdimid;
+   size_t len, start[2], count[2];
+   static double data[NX*NY];
+   double value;
+   int rec[NY];
+   char title[10];
+   int i, r;
+
+   if (nc_open(url, NC_NOWRITE, &ncid)) ERR;
+   if (nc_inq(ncid, &ndims, &nvars, &natts, &unlimdimid)) ERR;
+   if (ndims != 3 || nvars != 2 || natts != 1 || unlimdimid != 2) ERR;
+   if (nc_inq_dimlen(ncid, unlimdimid, &len)) ERR;
+   if (len != NREC) ERR;
+   if (nc_get_att_text(ncid, NC_GLOBAL, "title", title)) ERR;
+   if (strncmp(title, "byterange", 9)) ERR;
+   if (nc_inq_varid(ncid, "data", &varid)) ERR;
+   if (nc_inq_varid(ncid, "rec", &recvarid)) ERR;
+
+   /* Scattered single values, then the whole variable. */
+   for (i = NX*NY - 1; i >= 0; i -= 997) {
+      start[0] = i / NY;
+      start[1] = i % NY;
+      if (nc_get_var1_double(ncid, varid, start, &value)) ERR;
+      if (value != i * 0.5) ERR;
+   }
+   if (nc_get_var_double(ncid, varid, data)) ERR;
+   for (i = 0; i < NX*NY; i++)
+      if (data[i] != i * 0.5) ERR;
+
+   /* Sequential record reads. */
+   count[0] = 1;
+   count[1] = NY;
+   start[1] = 0;
+   for (r = 0; r < NREC; r++) {
+      start[0] = r;
+      if (nc_get_vara_int(ncid, recvarid, start, count, rec)) ERR;
+      for (i = 0; i < NY; i++)
+	 if (rec[i] != r * 1000 + i) ERR;
+   }
+
+   /* The file is read-only. */
+   if (nc_redef(ncid) != NC_EPERM) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+/* Make the url of the test file, with a fragment, from the url of
+ * its directory. */
+static int
+make_url(char *url, const char *dir, const char *name, const char *fragment)
+{
+   int len = snprintf(url, URLLEN, "%s/%s#%s", dir, name, fragment);
+   return len < 0 || len >= URLLEN;
+}
+
+#ifdef HTTP_SERVER
+/* A forked HTTP server for the test file. */
+typedef struct server
+{
+   pid_t pid;
+   int port;
+   int report;  /* read end of a pipe with a byte for each 206 answer */
+} server;
+
+/* Write all of a buffer to a socket. */
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+   ssize_t n;
+
+   while (len > 0)
+   {
+      if ((n = write(fd, buf, len)) <= 0)
+	 return 1;
+      buf += n;
+      len -= (size_t)n;
+   }
+   return 0;
+}
+
+/* Answer one request for the file in data, on its own connection. */
+static void
+answer(int fd, const char *data, size_t size, int ranges, int report)
+{
+   char req[8192], hdr[512], path[256];
+   char *range;
+   size_t len = 0, first = 0, last = size - 1;
+   ssize_t n;
+   int head, partial = 0, hlen;
+
+   /* Read the request line and headers. */
+   while (len < sizeof(req) - 1)
+   {
+      if ((n = read(fd, req + len, sizeof(req) - 1 - len)) <= 0)
+	 return;
+      len += (size_t)n;
+      req[len] = 0;
+      if (strstr(req, "\r\n\r\n"))
+	 break;
+   }
+   if (sscanf(req, "%*s %255s", path) != 1)
+      return;
+   head = !strncmp(req, "HEAD ", 5);
+   if (strcmp(path, "/" FILE_NAME))
+   {
+      hlen = snprintf(hdr, sizeof(hdr), "HTTP/1.1 404 Not Found\r\n"
+		      "Content-Length: 0\r\nConnection: close\r\n\r\n");
+      write_all(fd, hdr, (size_t)hlen);
+      return;
+   }
+
+   if (ranges && !head && (range = strstr(req, "\nRange: bytes=")))
+   {
+      unsigned long long a, b;
+      if (sscanf(range, "\nRange: bytes=%llu-%llu", &a, &b) == 2 &&
+	  a < size && a <= b)
+      {
+	 first = (size_t)a;
+	 last = b < size ? (size_t)b : size - 1;
+	 partial = 1;
+      }
+   }
+   if (partial)
+      hlen = snprintf(hdr, sizeof(hdr), "HTTP/1.1 206 Partial Content\r\n"
+		      "Content-Length: %lu\r\nContent-Range: bytes %lu-%lu/%lu\r\n"
+		      "Connection: close\r\n\r\n", (unsigned long)(last - first + 1),
+		      (unsigned long)first, (unsigned long)last,
+		      (unsigned long)size);
+   else
+      hlen = snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\n"
+		      "Content-Length: %lu\r\nConnection: close\r\n\r\n",
+		      (unsigned long)size);
+   if (write_all(fd, hdr, (size_t)hlen) || head)
+      return;
+   if (write_all(fd, data + first, last - first + 1))
+      return;
+   if (partial)
+      write_all(report, "r", 1);
+}
+
+/* Fork a server for the test file, which answers range requests
+ * with the range asked for, or, without ranges, with the whole
+ * file. */
+static int
+start_server(int ranges, server *srv)
+{
+   struct sockaddr_in addr;
+   socklen_t addrlen = sizeof(addr);
+   int lsock, fd, pipefd[2];
+   FILE *fp;
+   char *data;
+   size_t size;
+
+   /* Serve the file from memory, as it is now. */
+   if (!(fp = fopen(FILE_NAME, "rb"))) ERR_RET;
+   if (fseek(fp, 0, SEEK_END)) ERR_RET;
+   size = (size_t)ftell(fp);
+   rewind(fp);
+   if (!(data = malloc(size))) ERR_RET;
+   if (fread(data, 1, size, fp) != size) ERR_RET;
+   fclose(fp);
+
+   if ((lsock = socket(AF_INET, SOCK_STREAM, 0)) < 0) ERR_RET;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = 0;
+   if (bind(lsock, (struct sockaddr *)&addr, sizeof(addr))) ERR_RET;
+   if (listen(lsock, 16)) ERR_RET;
+   if (getsockname(lsock, (struct sockaddr *)&addr, &addrlen)) ERR_RET;
+   srv->port = ntohs(addr.sin_port);
+   if (pipe(pipefd)) ERR_RET;
+
+   if ((srv->pid = fork()) < 0) ERR_RET;
+   if (!srv->pid)
+   {
+      close(pipefd[0]);
+      signal(SIGPIPE, SIG_IGN);
+      while ((fd = accept(lsock, NULL, NULL)) >= 0)
+      {
+	 answer(fd, data, size, ranges, pipefd[1]);
+	 close(fd);
+      }
+      _exit(0);
+   }
+   close(pipefd[1]);
+   close(lsock);
+   free(data);
+   srv->report = pipefd[0];
+   return 0;
+}
+
+/* Stop the server, and find how many ranges it answered with. */
+static int
+stop_server(server *srv, int *npartialp)
+{
+   char buf[256];
+   ssize_t n;
+
+   if (kill(srv->pid, SIGTERM)) ERR_RET;
+   if (waitpid(srv->pid, NULL, 0) != srv->pid) ERR_RET;
+   *npartialp = 0;
+   while ((n = read(srv->report, buf, sizeof(buf))) > 0)
+      *npartialp += (int)n;
+   close(srv->report);
+   return 0;
+}
+#endif /* HTTP_SERVER */
+
+int
+main(int argc, char **argv)
+{
+   char cwd[PATH_MAX];
+   char dir[URLLEN];
+   char url[URLLEN];
+   int formats[] = {0, NC_64BIT_OFFSET, NC_64BIT_DATA};
+   int f, ncid;
+
+   printf("\n*** Testing byte-range access to classic files.\n");
+   if (getcwd(cwd, sizeof(cwd)) == NULL) ERR;
+   if (snprintf(dir, sizeof(dir), "file://%s", cwd) >= (int)sizeof(dir)) ERR;
+
+   for (f = 0; f < 3; f++)
+   {
+      printf("*** testing format %d with default cache settings...", f);
+      if (create_file(formats[f])) ERR;
+      if (make_url(url, dir, FILE_NAME, "mode=bytes")) ERR;
+      if (check_file(url)) ERR;
+      SUMMARIZE_ERR;
+
+      printf("*** testing format %d with a tiny cache...", f);
+      if (make_url(url, dir, FILE_NAME,
+		   "mode=bytes&blocksize=512&cachesize=8192&readahead=4")) ERR;
+      if (check_file(url)) ERR;
+      SUMMARIZE_ERR;
+   }
+
+   printf("*** testing that byte-range files cannot be opened for writing...");
+   if (make_url(url, dir, FILE_NAME, "mode=bytes")) ERR;
+   if (nc_open(url, NC_WRITE, &ncid) != NC_EPERM) ERR;
+   if (nc_create(url, NC_CLOBBER, &ncid) != NC_EPERM) ERR;
+   if (make_url(url, dir, "no_such_file.nc", "mode=bytes")) ERR;
+   if (nc_open(url, NC_NOWRITE, &ncid) == NC_NOERR) ERR;
+   SUMMARIZE_ERR;
+
+#ifdef HTTP_SERVER
+   /* The server is on the loopback interface, not behind any proxy. */
+   setenv("no_proxy", "*", 1);
+   setenv("NO_PROXY", "*", 1);
+   printf("*** testing HTTP range requests...");
+   {
+      server srv;
+      int npartial;
+
+      if (start_server(1, &srv)) ERR;
+      snprintf(dir, sizeof(dir), "http://127.0.0.1:%d", srv.port);
+      if (make_url(url, dir, FILE_NAME, "mode=bytes")) ERR;
+      if (check_file(url)) ERR;
+      if (make_url(url, dir, FILE_NAME,
+		   "mode=bytes&blocksize=512&cachesize=8192&readahead=4")) ERR;
+      if (check_file(url)) ERR;
+      if (make_url(url, dir, "no_such_file.nc", "mode=bytes")) ERR;
+      if (nc_open(url, NC_NOWRITE, &ncid) == NC_NOERR) ERR;
+      if (stop_server(&srv, &npartial)) ERR;
+
+      /* The data came in ranges, answered with 206. */
+      if (npartial < 2) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing an HTTP server that ignores ranges...");
+   {
+      server srv;
+      int npartial;
+
+      if (start_server(0, &srv)) ERR;
+      snprintf(dir, sizeof(dir), "http://127.0.0.1:%d", srv.port);
+      if (make_url(url, dir, FILE_NAME,
+		   "mode=bytes&blocksize=512&cachesize=8192&readahead=4")) ERR;
+      if (check_file(url)) ERR;
+      if (stop_server(&srv, &npartial)) ERR;
+      if (npartial) ERR;
+   }
+   SUMMARIZE_ERR;
+#endif /* HTTP_SERVER */
+
+   FINAL_RESULTS;
+}
@@ -0,0 +1,127 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the per-file I/O counters, nc_inq_io_stats() and
+   nc_reset_io_stats().
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_io_stats.nc"
+#define NX 1000
+#define NY 100
+
+static int
+create_file(int cmode)
+{
+   int ncid, dimids[2], varid;
+   static int data[NX*NY];
+   nc_io_stats_t stats;
+   int i;
+
+   for (i = 0; i < NX*NY; i++)
+      data[i] = i;
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "x", NX, &dimids[0])) ERR;
+   if (nc_def_dim(ncid, "y", NY, &dimids[1])) ERR;
+   if (nc_def_var(ncid, "data", NC_INT, 2, dimids, &varid)) ERR;
+   if (nc_enddef(ncid)) ERR;
+   if (nc_put_var_int(ncid, varid, data)) ERR;
+   if (nc_sync(ncid)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   if (stats.nget == 0 || stats.nrel == 0 || stats.nsync == 0) ERR;
+   if (stats.get_time < 0 || stats.rel_time < 0 || stats.sync_time < 0) ERR;
+   if (!(cmode & NC_DISKLESS))
+   {
+      if (stats.nwrite == 0) ERR;
+      if (stats.bytes_written < NX*NY*sizeof(int)) ERR;
+   }
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   int ncid, varid, value;
+   size_t index[2] = {NX/2, NY/2};
+   nc_io_stats_t stats, zero;
+
+   memset(&zero, 0, sizeof(zero));
+   printf("\n*** Testing I/O statistics.\n");
+   printf("*** testing counters while writing...");
+   if (create_file(0)) ERR;
+   SUMMARIZE_ERR;
+
+   printf("*** testing counters while reading...");
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   /* Opening reads the header. */
+   if (stats.nread == 0 || stats.bytes_read == 0) ERR;
+   if (nc_reset_io_stats(ncid)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   if (memcmp(&stats, &zero, sizeof(stats))) ERR;
+   if (nc_inq_varid(ncid, "data", &varid)) ERR;
+   if (nc_get_var1_int(ncid, varid, index, &value)) ERR;
+   if (value != NX/2 * NY + NY/2) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   if (stats.nget != 1 || stats.nrel != 1) ERR;
+   if (stats.cache_misses != 1 || stats.cache_hits != 0) ERR;
+   if (stats.nread == 0 || stats.bytes_read == 0) ERR;
+   if (stats.nwrite != 0 || stats.bytes_written != 0 || stats.nrmw != 0) ERR;
+   /* The same value again comes from the buffer. */
+   if (nc_get_var1_int(ncid, varid, index, &value)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   if (stats.nget != 2 || stats.cache_hits != 1 || stats.cache_misses != 1) ERR;
+   if (nc_inq_io_stats(ncid, NULL)) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+
+   printf("*** testing read-modify-write counting...");
+   if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+   if (nc_reset_io_stats(ncid)) ERR;
+   if (nc_inq_varid(ncid, "data", &varid)) ERR;
+   value = -1;
+   if (nc_put_var1_int(ncid, varid, index, &value)) ERR;
+   if (nc_sync(ncid)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   if (stats.nrmw != 1) ERR;
+   if (stats.nwrite == 0 || stats.bytes_written == 0) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+
+#ifdef USE_DISKLESS
+   printf("*** testing counters of a diskless file...");
+   if (create_file(NC_DISKLESS)) ERR;
+   if (nc_open(FILE_NAME, NC_NOWRITE|NC_DISKLESS, &ncid)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   /* The whole file is read in at open, then every get is a hit. */
+   if (stats.bytes_read < NX*NY*sizeof(int)) ERR;
+   if (nc_reset_io_stats(ncid)) ERR;
+   if (nc_inq_varid(ncid, "data", &varid)) ERR;
+   if (nc_get_var1_int(ncid, varid, index, &value)) ERR;
+   if (nc_inq_io_stats(ncid, &stats)) ERR;
+   if (stats.nread != 0 || stats.cache_misses != 0 || stats.cache_hits != 1) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+#endif
+
+   printf("*** testing errors...");
+   if (nc_inq_io_stats(-1, &stats) != NC_EBADID) ERR;
+   if (nc_reset_io_stats(-1) != NC_EBADID) ERR;
+#ifdef USE_NETCDF4
+   if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+   if (nc_inq_io_stats(ncid, &stats) != NC_ENOTNC3) ERR;
+   if (nc_reset_io_stats(ncid) != NC_ENOTNC3) ERR;
+   if (nc_close(ncid)) ERR;
+#endif
+   SUMMARIZE_ERR;
+
+   FINAL_RESULTS;
+}
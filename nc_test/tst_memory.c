@@ -0,0 +1,197 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test memory accounting, nc_inq_memory_usage(), and the memory
+   budget, nc_set_memory_budget().
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_memory.nc"
+#define NX 200
+#define NY 100
+#define NVARS 3
+
+static int
+create_file(int cmode)
+{
+   int ncid, dimids[2], varid, v;
+   static int data[NX*NY];
+   char name[NC_MAX_NAME + 1];
+   nc_memory_usage_t usage;
+   int i;
+
+   for (i = 0; i < NX*NY; i++)
+      data[i] = i;
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "x", NX, &dimids[0])) ERR;
+   if (nc_def_dim(ncid, "y", NY, &dimids[1])) ERR;
+   if (nc_put_att_text(ncid, NC_GLOBAL, "title", 6, "memory")) ERR;
+   for (v = 0; v < NVARS; v++)
+   {
+      sprintf(name, "data%d", v);
+      if (nc_def_var(ncid, name, NC_INT, 2, dimids, &varid)) ERR;
+   }
+   if (nc_enddef(ncid)) ERR;
+   for (v = 0; v < NVARS; v++)
+      if (nc_put_var_int(ncid, v, data)) ERR;
+   if (nc_inq_memory_usage(ncid, &usage)) ERR;
+   if (usage.metadata == 0) ERR;
+   if (usage.total != usage.chunk_cache + usage.dap_cache +
+       usage.io_buffers + usage.metadata) ERR;
+   if (cmode & NC_NETCDF4)
+   {
+      if (usage.chunk_cache != 0 || usage.io_buffers != 0) ERR;
+   }
+   else if (usage.io_buffers == 0 || usage.chunk_cache != 0) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+static int
+check_data(int ncid)
+{
+   static int data[NX*NY];
+   int v, i;
+
+   for (v = 0; v < NVARS; v++)
+   {
+      if (nc_get_var_int(ncid, v, data)) ERR;
+      for (i = 0; i < NX*NY; i++)
+	 if (data[i] != i) ERR;
+   }
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   int ncid;
+   size_t budget, chunksize;
+   nc_memory_usage_t usage, global;
+
+   printf("\n*** Testing memory accounting.\n");
+   printf("*** testing defaults...");
+   if (nc_inq_memory_budget(&budget)) ERR;
+   if (budget != 0) ERR;
+   if (nc_inq_memory_usage(NC_GLOBAL, &global)) ERR;
+   if (global.total != 0) ERR;
+   if (nc_inq_memory_usage(NC_GLOBAL, NULL)) ERR;
+   if (nc_inq_memory_usage(999999, &usage) != NC_EBADID) ERR;
+   SUMMARIZE_ERR;
+
+   printf("*** testing a classic file...");
+   if (create_file(0)) ERR;
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+   if (nc_inq_memory_usage(ncid, &usage)) ERR;
+   if (usage.io_buffers == 0 || usage.metadata == 0) ERR;
+   if (nc_inq_memory_usage(NC_GLOBAL, &global)) ERR;
+   if (global.io_buffers != usage.io_buffers) ERR;
+   if (global.metadata != usage.metadata) ERR;
+   if (global.total != usage.total) ERR;
+   if (check_data(ncid)) ERR;
+   if (nc_close(ncid)) ERR;
+   /* Everything is given back at close. */
+   if (nc_inq_memory_usage(NC_GLOBAL, &global)) ERR;
+   if (global.total != 0) ERR;
+   SUMMARIZE_ERR;
+
+   printf("*** testing the budget with a classic file...");
+   if (nc_set_memory_budget(16384)) ERR;
+   if (nc_inq_memory_budget(&budget)) ERR;
+   if (budget != 16384) ERR;
+   chunksize = 1 << 20;
+   if (nc__open(FILE_NAME, NC_NOWRITE, &chunksize, &ncid)) ERR;
+   /* The buffer was shrunk to fit. */
+   if (chunksize > 8192) ERR;
+   if (nc_inq_memory_usage(ncid, &usage)) ERR;
+   if (usage.io_buffers == 0 || usage.io_buffers > 16384) ERR;
+   if (check_data(ncid)) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+
+#ifdef USE_DISKLESS
+   printf("*** testing the budget with a diskless file...");
+   /* The image of the file does not fit. */
+   if (nc_open(FILE_NAME, NC_NOWRITE|NC_DISKLESS, &ncid) != NC_ENOMEM) ERR;
+   if (nc_set_memory_budget(0)) ERR;
+   if (nc_open(FILE_NAME, NC_NOWRITE|NC_DISKLESS, &ncid)) ERR;
+   if (nc_inq_memory_usage(ncid, &usage)) ERR;
+   if (usage.io_buffers < NVARS * NX * NY * sizeof(int)) ERR;
+   if (check_data(ncid)) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+#endif
+
+#ifdef USE_NETCDF4
+   printf("*** testing a netCDF-4 file...");
+   if (nc_set_memory_budget(0)) ERR;
+   if (create_file(NC_NETCDF4)) ERR;
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+   if (nc_inq_memory_usage(ncid, &usage)) ERR;
+   /* The variables are contiguous, so there are no chunk caches. */
+   if (usage.chunk_cache != 0 || usage.metadata == 0) ERR;
+   if (nc_close(ncid)) ERR;
+   SUMMARIZE_ERR;
+
+   printf("*** testing the budget with netCDF-4 chunk caches...");
+   {
+      int dimid, varid, v;
+      size_t chunks[1] = {NX}, size, nelems;
+      float preemption;
+      char name[NC_MAX_NAME + 1];
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX * NY, &dimid)) ERR;
+      for (v = 0; v < NVARS; v++)
+      {
+	 sprintf(name, "chunked%d", v);
+	 if (nc_def_var(ncid, name, NC_INT, 1, &dimid, &varid)) ERR;
+	 if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      }
+      if (nc_enddef(ncid)) ERR;
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.chunk_cache == 0) ERR;
+      if (nc_get_var_chunk_cache(ncid, 0, &size, &nelems, &preemption)) ERR;
+      if (usage.chunk_cache != NVARS * size) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* With a budget of one and a half caches, the second var gets
+       * half a cache and the third none. */
+      if (nc_set_memory_budget(size + size / 2)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.chunk_cache != size + size / 2) ERR;
+      if (nc_inq_memory_usage(NC_GLOBAL, &global)) ERR;
+      if (global.chunk_cache + global.io_buffers + global.dap_cache >
+	  size + size / 2) ERR;
+      /* The vars keep the size asked for, whatever they were
+       * granted. */
+      for (v = 0; v < NVARS; v++)
+      {
+	 if (nc_get_var_chunk_cache(ncid, v, &chunksize, NULL, NULL)) ERR;
+	 if (chunksize != size) ERR;
+      }
+
+      /* With room in the budget again, the third var gets its whole
+       * cache when it is next handed to HDF5. */
+      if (nc_set_memory_budget(3 * size)) ERR;
+      if (nc_set_var_chunk_cache(ncid, 2, size, nelems, preemption)) ERR;
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.chunk_cache != 2 * size + size / 2) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_inq_memory_usage(NC_GLOBAL, &global)) ERR;
+      if (global.total != 0) ERR;
+   }
+   if (nc_set_memory_budget(0)) ERR;
+   SUMMARIZE_ERR;
+#endif
+
+   FINAL_RESULTS;
+}
@@ -0,0 +1,207 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test nc_def_var_pack(), nc_put_vara_pack_double() and
+   nc_put_vara_pack_float(), whose data must read back with
+   nc_get_vara_unpack_double() to within half a packing step.
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_pack.nc"
+#define NREC 3
+#define NY 200
+#define NX 300
+#define N (NREC * NY * NX)
+#define SCALE 0.01
+#define OFFSET 273.15
+#define VALID_MIN -30000
+
+/* The value at a point: a smooth field with some NaNs. */
+static double
+value(size_t i)
+{
+   if (i % 89 == 5)
+      return NAN;
+   return 250 + 60 * sin((double)i * 0.001) + (double)(i % 7) * 0.01;
+}
+
+/* Compare a value read back with the one written, to within tol;
+ * NaNs must stay NaNs. */
+#define CLOSE(a, b, tol) ((isnan(a) && isnan(b)) || fabs((a) - (b)) <= (tol))
+
+static int
+test_pack(int cmode)
+{
+   int ncid, dimids[3], tid, pid, fid, textid, bareid;
+   size_t start[3] = {1, 20, 30}, count[3] = {2, 150, 201}, i, r, y, x;
+   double *dval, *back, scale, offset, range, big[2] = {1e9, NAN};
+   double vmin = HUGE_VAL, vmax = -HUGE_VAL;
+   float *fval, fscale;
+   nc_type atype;
+   short pvalid = VALID_MIN, packed[2];
+
+   if (!(dval = malloc(N * sizeof(double))) || !(back = malloc(N * sizeof(double)))) ERR_RET;
+   if (!(fval = malloc(N * sizeof(float)))) ERR_RET;
+   for (i = 0; i < N; i++)
+   {
+      dval[i] = value(i);
+      fval[i] = (float)dval[i];
+      if (fval[i] < vmin)
+         vmin = fval[i];
+      if (fval[i] > vmax)
+         vmax = fval[i];
+   }
+
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR_RET;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) ERR_RET;
+   if (nc_def_dim(ncid, "y", NY, &dimids[1])) ERR_RET;
+   if (nc_def_dim(ncid, "x", NX, &dimids[2])) ERR_RET;
+   if (nc_def_var(ncid, "t", NC_SHORT, 3, dimids, &tid)) ERR_RET;
+   if (nc_def_var(ncid, "p", NC_SHORT, 3, dimids, &pid)) ERR_RET;
+   scale = SCALE;
+   offset = OFFSET;
+   if (nc_put_att_double(ncid, pid, "scale_factor", NC_DOUBLE, 1, &scale)) ERR_RET;
+   if (nc_put_att_double(ncid, pid, "add_offset", NC_DOUBLE, 1, &offset)) ERR_RET;
+   if (nc_put_att_short(ncid, pid, "valid_min", NC_SHORT, 1, &pvalid)) ERR_RET;
+   if (nc_def_var(ncid, "f", NC_FLOAT, 3, dimids, &fid)) ERR_RET;
+   if (nc_def_var(ncid, "text", NC_CHAR, 1, &dimids[2], &textid)) ERR_RET;
+   if (nc_def_var(ncid, "bare", NC_BYTE, 1, &dimids[2], &bareid)) ERR_RET;
+
+   /* The classic formats need define mode to add attributes, so t is
+    * given them now, as floats, from the range of the data; netCDF-4
+    * files get the same from the first write. */
+   if (!(cmode & NC_NETCDF4) && nc_def_var_pack(ncid, tid, NC_FLOAT, vmin, vmax)) ERR_RET;
+   if (nc_def_var_pack(ncid, fid, NC_FLOAT, vmin, vmax) != NC_EBADTYPE) ERR_RET;
+   if (nc_def_var_pack(ncid, bareid, NC_SHORT, vmin, vmax) != NC_EBADTYPE) ERR_RET;
+   if (nc_def_var_pack(ncid, bareid, NC_DOUBLE, vmax, vmin) != NC_EINVAL) ERR_RET;
+   if (nc_def_var_pack(ncid, bareid, NC_DOUBLE, vmin, NAN) != NC_EINVAL) ERR_RET;
+   if (cmode & NC_NETCDF4)
+   {
+      size_t chunks[3] = {1, 64, 64};
+      if (nc_def_var_chunking(ncid, tid, NC_CHUNKED, chunks)) ERR_RET;
+      if (nc_def_var_deflate(ncid, tid, 1, 1, 1)) ERR_RET;
+   }
+   if (nc_enddef(ncid)) ERR_RET;
+
+   /* Out of define mode, the classic formats can't add attributes,
+    * so an integral var without them can't be written. */
+   if (!(cmode & NC_NETCDF4))
+   {
+      if (nc_put_vara_pack_double(ncid, bareid, NULL, NULL, dval) != NC_ENOTINDEFINE) ERR_RET;
+      if (nc_inq_attid(ncid, bareid, "scale_factor", NULL) != NC_ENOTATT) ERR_RET;
+      if (nc_def_var_pack(ncid, bareid, NC_DOUBLE, vmin, vmax) != NC_ENOTINDEFINE) ERR_RET;
+   }
+   else
+   {
+      if (nc_put_vara_pack_double(ncid, bareid, NULL, NULL, dval)) ERR_RET;
+      if (nc_inq_atttype(ncid, bareid, "add_offset", &atype)) ERR_RET;
+      if (atype != NC_DOUBLE) ERR_RET;
+   }
+
+   /* Without attributes, the first write chooses them. */
+
+   count[0] = NREC;
+   count[1] = NY;
+   count[2] = NX;
+   start[0] = start[1] = start[2] = 0;
+   if (nc_put_vara_pack_float(ncid, tid, start, count, fval)) ERR_RET;
+   if (nc_inq_atttype(ncid, tid, "scale_factor", &atype)) ERR_RET;
+   if (atype != NC_FLOAT) ERR_RET;
+   if (nc_get_att_float(ncid, tid, "scale_factor", &fscale)) ERR_RET;
+   range = 120.07;
+   if (fscale <= 0 || fscale > range / 65533 * 1.001) ERR_RET;
+   if (nc_get_vara_unpack_double(ncid, tid, NULL, NULL, back)) ERR_RET;
+   for (i = 0; i < N; i++)
+      if (!CLOSE(back[i], (double)fval[i], fscale * 0.51)) ERR_RET;
+
+   /* With attributes: the whole var, then part of it with new
+    * values. */
+   if (nc_put_vara_pack_double(ncid, pid, NULL, NULL, dval)) ERR_RET;
+   if (nc_get_vara_unpack_double(ncid, pid, NULL, NULL, back)) ERR_RET;
+   for (i = 0; i < N; i++)
+      if (!CLOSE(back[i], dval[i], SCALE * 0.51)) ERR_RET;
+   start[0] = 1;
+   start[1] = 20;
+   start[2] = 30;
+   count[0] = 2;
+   count[1] = 150;
+   count[2] = 201;
+   for (i = 0; i < count[0] * count[1] * count[2]; i++)
+      dval[i] = value(i) - 10;
+   if (nc_put_vara_pack_double(ncid, pid, start, count, dval)) ERR_RET;
+   if (nc_get_vara_unpack_double(ncid, pid, NULL, NULL, back)) ERR_RET;
+   for (r = 0, i = 0; r < NREC; r++)
+      for (y = 0; y < NY; y++)
+         for (x = 0; x < NX; x++, i++)
+         {
+            double want = value(i);
+            if (r >= start[0] && y >= start[1] && y < start[1] + count[1] &&
+                x >= start[2] && x < start[2] + count[2])
+               want = value(((r - start[0]) * count[1] + y - start[1]) * count[2] +
+                            x - start[2]) - 10;
+            if (!CLOSE(back[i], want, SCALE * 0.51)) ERR_RET;
+         }
+
+   /* Out of range values are clamped, and NaNs are fill. */
+   start[0] = start[1] = start[2] = 0;
+   count[0] = count[1] = 1;
+   count[2] = 2;
+   if (nc_put_vara_pack_double(ncid, pid, start, count, big) != NC_ERANGE) ERR_RET;
+   if (nc_get_vara_short(ncid, pid, start, count, packed)) ERR_RET;
+   if (packed[0] != 32767 || packed[1] != NC_FILL_SHORT) ERR_RET;
+   big[0] = -1e9;
+   if (nc_put_vara_pack_double(ncid, pid, start, count, big) != NC_ERANGE) ERR_RET;
+   if (nc_get_vara_short(ncid, pid, start, count, packed)) ERR_RET;
+   if (packed[0] != VALID_MIN) ERR_RET;
+
+   /* A float var is not rounded. */
+   if (nc_put_vara_pack_double(ncid, fid, NULL, NULL, dval)) ERR_RET;
+   if (nc_get_vara_unpack_double(ncid, fid, NULL, NULL, back)) ERR_RET;
+   for (i = 0; i < N; i++)
+      if (!CLOSE(back[i], (double)(float)dval[i], 0)) ERR_RET;
+
+   /* Errors. */
+   if (nc_put_vara_pack_double(ncid, textid, NULL, NULL, dval) != NC_ECHAR) ERR_RET;
+   if (nc_put_vara_pack_double(ncid, tid + 100, NULL, NULL, dval) != NC_ENOTVAR) ERR_RET;
+   start[2] = NX + 1;
+   if (nc_put_vara_pack_float(ncid, tid, start, count, fval) != NC_EINVALCOORDS) ERR_RET;
+   if (nc_close(ncid)) ERR_RET;
+
+   /* The attributes chosen were saved. */
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR_RET;
+   if (nc_get_att_float(ncid, tid, "scale_factor", &fscale)) ERR_RET;
+   if (nc_inq_atttype(ncid, tid, "add_offset", &atype)) ERR_RET;
+   if (atype != NC_FLOAT) ERR_RET;
+   if (nc_close(ncid)) ERR_RET;
+   free(dval);
+   free(back);
+   free(fval);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing writes of packed variables.\n");
+   printf("*** testing classic file...");
+   {
+      if (test_pack(0)) ERR;
+   }
+   SUMMARIZE_ERR;
+#ifdef USE_NETCDF4
+   printf("*** testing netCDF-4 file with chunks...");
+   {
+      if (test_pack(NC_NETCDF4)) ERR;
+   }
+   SUMMARIZE_ERR;
+#endif /* USE_NETCDF4 */
+   FINAL_RESULTS;
+}
@@ -0,0 +1,219 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test reading scattered points of a variable with
+   nc_get_var_points(), which must give the same values as reading the
+   points one at a time with nc_get_var1().
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_points.nc"
+#define NREC 7
+#define NY 40
+#define NX 30
+#define NPOINTS 500
+
+/* The value at a point of the record variable. */
+#define VAL(r, y, x) ((r) * 10000 + (y) * 100 + (x))
+
+static int
+create_file(int cmode)
+{
+   int ncid, dimids[3], varid, shortid, textid, otherid;
+   size_t start[3] = {0, 0, 0}, count[3] = {1, NY, NX};
+   static int data[NY * NX];
+   static short sdata[NY * NX];
+   float other = 1.5f;
+   int r, y, x;
+
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) ERR;
+   if (nc_def_dim(ncid, "y", NY, &dimids[1])) ERR;
+   if (nc_def_dim(ncid, "x", NX, &dimids[2])) ERR;
+   if (nc_def_var(ncid, "data", NC_INT, 3, dimids, &varid)) ERR;
+   if (nc_def_var(ncid, "fixed", NC_SHORT, 2, &dimids[1], &shortid)) ERR;
+   if (nc_def_var(ncid, "text", NC_CHAR, 1, &dimids[2], &textid)) ERR;
+   if (nc_def_var(ncid, "other", NC_FLOAT, 1, dimids, &otherid)) ERR;
+   if (cmode & NC_NETCDF4)
+   {
+      size_t chunks[3] = {2, 16, 8};
+      if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, varid, 1, 1, 1)) ERR;
+   }
+   if (nc_enddef(ncid)) ERR;
+
+   for (r = 0; r < NREC; r++)
+   {
+      for (y = 0; y < NY; y++)
+         for (x = 0; x < NX; x++)
+            data[y * NX + x] = VAL(r, y, x);
+      start[0] = r;
+      if (nc_put_vara_int(ncid, varid, start, count, data)) ERR;
+   }
+   for (y = 0; y < NY; y++)
+      for (x = 0; x < NX; x++)
+         sdata[y * NX + x] = (short)(y * NX + x);
+   if (nc_put_var_short(ncid, shortid, sdata)) ERR;
+   if (nc_put_var_text(ncid, textid, "abcdefghijklmnopqrstuvwxyz0123")) ERR;
+
+   /* Another var of the record dimension goes two records further. */
+   start[0] = NREC + 1;
+   if (nc_put_var1_float(ncid, otherid, start, &other)) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+static int
+check_points(void)
+{
+   int ncid, varid, shortid, textid;
+   size_t index[NPOINTS][3], index2[NPOINTS][2], bad[2][3];
+   size_t tindex[3] = {5, 0, NX - 1};
+   int *ival, one;
+   double *dval;
+   signed char *bval;
+   char tval[3];
+   short sone;
+   int p;
+
+   if (!(ival = malloc(NPOINTS * sizeof(int)))) ERR;
+   if (!(dval = malloc(NPOINTS * sizeof(double)))) ERR;
+   if (!(bval = malloc(NPOINTS * sizeof(signed char)))) ERR;
+
+   /* Scattered points, out of order, with some repeated. */
+   for (p = 0; p < NPOINTS; p++)
+   {
+      index[p][0] = (p * 7) % NREC;
+      index[p][1] = (p * 37) % NY;
+      index[p][2] = (p * 13 + p / 50) % NX;
+      index2[p][0] = index[p][1];
+      index2[p][1] = index[p][2];
+   }
+   index[NPOINTS - 1][0] = index[0][0];
+   index[NPOINTS - 1][1] = index[0][1];
+   index[NPOINTS - 1][2] = index[0][2];
+
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+   if (nc_inq_varid(ncid, "data", &varid)) ERR;
+   if (nc_inq_varid(ncid, "fixed", &shortid)) ERR;
+   if (nc_inq_varid(ncid, "text", &textid)) ERR;
+
+   if (nc_get_var_points_int(ncid, varid, NPOINTS, &index[0][0], ival)) ERR;
+   for (p = 0; p < NPOINTS; p++)
+   {
+      if (ival[p] != VAL(index[p][0], index[p][1], index[p][2])) ERR;
+      if (nc_get_var1_int(ncid, varid, index[p], &one)) ERR;
+      if (one != ival[p]) ERR;
+   }
+   if (nc_get_var_points(ncid, varid, NPOINTS, &index[0][0], ival)) ERR;
+   for (p = 0; p < NPOINTS; p++)
+      if (ival[p] != VAL(index[p][0], index[p][1], index[p][2])) ERR;
+   if (nc_get_var_points_double(ncid, varid, NPOINTS, &index[0][0], dval)) ERR;
+   for (p = 0; p < NPOINTS; p++)
+      if (dval[p] != VAL(index[p][0], index[p][1], index[p][2])) ERR;
+
+   /* A var of fixed dimensions, and a char var. */
+   if (nc_get_var_points_int(ncid, shortid, NPOINTS, &index2[0][0], ival)) ERR;
+   for (p = 0; p < NPOINTS; p++)
+   {
+      if (nc_get_var1_short(ncid, shortid, index2[p], &sone)) ERR;
+      if (ival[p] != sone || sone != index2[p][0] * NX + index2[p][1]) ERR;
+   }
+   if (nc_get_var_points_text(ncid, textid, 3, tindex, tval)) ERR;
+   if (strncmp(tval, "fa3", 3)) ERR;
+   if (nc_get_var_points_int(ncid, textid, 3, tindex, ival) != NC_ECHAR) ERR;
+
+   /* Values that don't fit are range errors, and the rest are still
+    * read. */
+   if (nc_get_var_points_schar(ncid, shortid, NPOINTS, &index2[0][0], bval) != NC_ERANGE) ERR;
+   for (p = 0; p < NPOINTS; p++)
+      if (index2[p][0] * NX + index2[p][1] <= 127 &&
+          bval[p] != index2[p][0] * NX + index2[p][1]) ERR;
+
+   /* Nothing to read, and nothing to read from. */
+   if (nc_get_var_points_int(ncid, varid, 0, NULL, ival)) ERR;
+   if (nc_get_var_points_int(ncid, varid, 1, NULL, ival) != NC_EINVAL) ERR;
+   if (nc_get_var_points_int(ncid, varid + 100, 1, &index[0][0], ival) != NC_ENOTVAR) ERR;
+
+   /* A point out of bounds is an error, found before any point is
+    * read. */
+   bad[0][0] = 0;
+   bad[0][1] = 0;
+   bad[0][2] = 0;
+   bad[1][0] = 0;
+   bad[1][1] = NY;
+   bad[1][2] = 0;
+   ival[0] = -1;
+   if (nc_get_var_points_int(ncid, varid, 2, &bad[0][0], ival) != NC_EINVALCOORDS) ERR;
+   if (ival[0] != -1) ERR;
+   if (nc_close(ncid)) ERR;
+
+   free(ival);
+   free(dval);
+   free(bval);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing nc_get_var_points.\n");
+   printf("*** testing classic file...");
+   {
+      if (create_file(0)) ERR;
+      if (check_points()) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing 64-bit offset file...");
+   {
+      if (create_file(NC_64BIT_OFFSET)) ERR;
+      if (check_points()) ERR;
+   }
+   SUMMARIZE_ERR;
+#ifdef USE_NETCDF4
+   printf("*** testing netCDF-4 file...");
+   {
+      int ncid, varid;
+      size_t index[3][3] = {{NREC + 1, 3, 4}, {1, 2, 3}, {NREC, 0, 0}};
+      int ival[3];
+
+      if (create_file(NC_NETCDF4)) ERR;
+      if (check_points()) ERR;
+
+      /* Records past the data of this var, but within the unlimited
+       * dimension, read as fill. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_varid(ncid, "data", &varid)) ERR;
+      if (nc_get_var_points_int(ncid, varid, 3, &index[0][0], ival)) ERR;
+      if (ival[0] != NC_FILL_INT || ival[1] != VAL(1, 2, 3) ||
+          ival[2] != NC_FILL_INT) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing netCDF-4 string var...");
+   {
+      int ncid, dimid, varid;
+      const char *data[3] = {"one", "two", "three"};
+      char *in[2];
+      size_t index[2] = {2, 0};
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "n", 3, &dimid)) ERR;
+      if (nc_def_var(ncid, "s", NC_STRING, 1, &dimid, &varid)) ERR;
+      if (nc_put_var_string(ncid, varid, data)) ERR;
+      if (nc_get_var_points_string(ncid, varid, 2, index, in)) ERR;
+      if (strcmp(in[0], "three") || strcmp(in[1], "one")) ERR;
+      if (nc_free_string(2, in)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+#endif /* USE_NETCDF4 */
+   FINAL_RESULTS;
+}
@@ -0,0 +1,219 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test nc_get_vara_reduce(), which must give the same results as
+   reading the hyperslab and reducing it in memory.
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_reduce.nc"
+#define NREC 5
+#define NY 300
+#define NX 200
+#define VALID_MIN 10
+#define VALID_MAX 550000
+
+/* The value at a point of the var: every 97th value is fill, and
+ * some are outside the valid range. */
+#define VAL(r, y, x) ((((y) * NX + (x)) % 97 == 3) ? NC_FILL_INT : \
+                      (int)((r) * 100000 + (y) * 300 + (x)))
+
+static int
+create_file(int cmode)
+{
+   int ncid, dimids[3], varid, textid, fltid;
+   size_t start[3] = {0, 0, 0}, count[3] = {1, NY, NX};
+   int range[2] = {VALID_MIN, VALID_MAX}, r, y, x;
+   float fdata[4] = {1.5f, -2.0f, 0.0f, 7.0f};
+   static int data[NY * NX];
+
+   fdata[2] = (float)NAN;
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) ERR;
+   if (nc_def_dim(ncid, "y", NY, &dimids[1])) ERR;
+   if (nc_def_dim(ncid, "x", NX, &dimids[2])) ERR;
+   if (nc_def_var(ncid, "data", NC_INT, 3, dimids, &varid)) ERR;
+   if (nc_put_att_int(ncid, varid, "valid_range", NC_INT, 2, range)) ERR;
+   if (nc_def_var(ncid, "text", NC_CHAR, 1, &dimids[2], &textid)) ERR;
+   if (nc_def_var(ncid, "flt", NC_FLOAT, 1, &dimids[2], &fltid)) ERR;
+   if (nc_put_att_float(ncid, fltid, "valid_min", NC_FLOAT, 1, &fdata[1])) ERR;
+   if (cmode & NC_NETCDF4)
+   {
+      size_t chunks[3] = {2, 64, 48};
+      if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, varid, 1, 1, 1)) ERR;
+   }
+   if (nc_enddef(ncid)) ERR;
+
+   for (r = 0; r < NREC; r++)
+   {
+      for (y = 0; y < NY; y++)
+         for (x = 0; x < NX; x++)
+            data[y * NX + x] = VAL(r, y, x);
+      start[0] = r;
+      if (nc_put_vara_int(ncid, varid, start, count, data)) ERR;
+   }
+   start[0] = 0;
+   count[0] = 4;
+   if (nc_put_vara_float(ncid, fltid, start, count, fdata)) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+/* Reduce a hyperslab of the var in memory. */
+static void
+reduce_ref(const size_t *start, const size_t *count, const int *reduce,
+           int op, double *res)
+{
+   size_t nres = 1, stride[3], r, y, x, cell;
+   size_t *cnt;
+   int d;
+
+   for (d = 2; d >= 0; d--)
+   {
+      stride[d] = reduce[d] ? 0 : nres;
+      if (!reduce[d])
+         nres *= count[d];
+   }
+   cnt = calloc(nres, sizeof(size_t));
+   for (cell = 0; cell < nres; cell++)
+      res[cell] = op == NC_REDUCE_MIN ? HUGE_VAL : op == NC_REDUCE_MAX ? -HUGE_VAL : 0;
+   for (r = 0; r < count[0]; r++)
+      for (y = 0; y < count[1]; y++)
+         for (x = 0; x < count[2]; x++)
+         {
+            double v = VAL(start[0] + r, start[1] + y, start[2] + x);
+            if (v == NC_FILL_INT || v < VALID_MIN || v > VALID_MAX)
+               continue;
+            cell = r * stride[0] + y * stride[1] + x * stride[2];
+            cnt[cell]++;
+            if (op == NC_REDUCE_MIN && v < res[cell])
+               res[cell] = v;
+            else if (op == NC_REDUCE_MAX && v > res[cell])
+               res[cell] = v;
+            else if (op != NC_REDUCE_MIN && op != NC_REDUCE_MAX)
+               res[cell] += v;
+         }
+   for (cell = 0; cell < nres; cell++)
+   {
+      if ((op == NC_REDUCE_MIN || op == NC_REDUCE_MAX) && !cnt[cell])
+         res[cell] = NC_FILL_DOUBLE;
+      if (op == NC_REDUCE_MEAN)
+         res[cell] = cnt[cell] ? res[cell] / (double)cnt[cell] : NC_FILL_DOUBLE;
+      if (op == NC_REDUCE_COUNT)
+         res[cell] = (double)cnt[cell];
+   }
+   free(cnt);
+}
+
+static int
+check_reduce(int ncid, int varid, const size_t *start, const size_t *count,
+             const int *reduce)
+{
+   double *res, *ref;
+   size_t n = NREC * NY * NX, i;
+   int op;
+
+   if (!(res = malloc(n * sizeof(double))) || !(ref = malloc(n * sizeof(double)))) ERR_RET;
+   for (op = NC_REDUCE_MIN; op <= NC_REDUCE_COUNT; op++)
+   {
+      size_t nres = 1;
+      int d;
+      for (d = 0; d < 3; d++)
+         if (!reduce[d])
+            nres *= count[d];
+      if (nc_get_vara_reduce(ncid, varid, start, count, reduce, op, res)) ERR_RET;
+      reduce_ref(start, count, reduce, op, ref);
+      for (i = 0; i < nres; i++)
+         if (res[i] != ref[i]) ERR_RET;
+   }
+   free(res);
+   free(ref);
+   return 0;
+}
+
+static int
+check_file(void)
+{
+   int ncid, varid, textid, fltid;
+   size_t start[3] = {0, 0, 0}, count[3] = {NREC, NY, NX};
+   size_t sub_start[3] = {1, 37, 11}, sub_count[3] = {3, 201, 150};
+   int all[3] = {1, 1, 1}, space[3] = {0, 1, 1}, time[3] = {1, 0, 0};
+   int rows[3] = {0, 1, 0}, none[3] = {0, 0, 0};
+   double res[NX], sum;
+
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+   if (nc_inq_varid(ncid, "data", &varid)) ERR;
+   if (nc_inq_varid(ncid, "text", &textid)) ERR;
+   if (nc_inq_varid(ncid, "flt", &fltid)) ERR;
+
+   /* The whole var, and a part of it, reduced along different
+    * dimensions. */
+   if (check_reduce(ncid, varid, start, count, all)) ERR;
+   if (check_reduce(ncid, varid, start, count, space)) ERR;
+   if (check_reduce(ncid, varid, start, count, time)) ERR;
+   if (check_reduce(ncid, varid, sub_start, sub_count, all)) ERR;
+   if (check_reduce(ncid, varid, sub_start, sub_count, rows)) ERR;
+   if (check_reduce(ncid, varid, sub_start, sub_count, none)) ERR;
+
+   /* NULL start, count and reduce mean the whole var, all
+    * reduced. */
+   if (nc_get_vara_reduce(ncid, varid, NULL, NULL, NULL, NC_REDUCE_SUM, &sum)) ERR;
+   if (nc_get_vara_reduce(ncid, varid, start, count, all, NC_REDUCE_SUM, res)) ERR;
+   if (sum != res[0]) ERR;
+
+   /* Only fill values leaves nothing to reduce. */
+   start[1] = 0;
+   start[2] = 3;
+   count[0] = NREC;
+   count[1] = 1;
+   count[2] = 1;
+   if (nc_get_vara_reduce(ncid, varid, start, count, NULL, NC_REDUCE_MAX, res)) ERR;
+   if (res[0] != NC_FILL_DOUBLE) ERR;
+   if (nc_get_vara_reduce(ncid, varid, start, count, NULL, NC_REDUCE_COUNT, res)) ERR;
+   if (res[0] != 0) ERR;
+
+   /* NaNs and values below valid_min are left out. */
+   if (nc_get_vara_reduce(ncid, fltid, NULL, NULL, NULL, NC_REDUCE_SUM, res)) ERR;
+   if (res[0] != 6.5) ERR;
+   if (nc_get_vara_reduce(ncid, fltid, NULL, NULL, NULL, NC_REDUCE_MIN, res)) ERR;
+   if (res[0] != -2.0) ERR;
+
+   /* Errors. */
+   if (nc_get_vara_reduce(ncid, varid, NULL, NULL, NULL, 0, res) != NC_EINVAL) ERR;
+   if (nc_get_vara_reduce(ncid, textid, NULL, NULL, NULL, NC_REDUCE_SUM, res) != NC_ECHAR) ERR;
+   if (nc_get_vara_reduce(ncid, varid + 100, NULL, NULL, NULL, NC_REDUCE_SUM, res) != NC_ENOTVAR) ERR;
+   start[1] = NY + 1;
+   if (nc_get_vara_reduce(ncid, varid, start, count, NULL, NC_REDUCE_SUM, res) != NC_EINVALCOORDS) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing nc_get_vara_reduce.\n");
+   printf("*** testing classic file...");
+   {
+      if (create_file(0)) ERR;
+      if (check_file()) ERR;
+   }
+   SUMMARIZE_ERR;
+#ifdef USE_NETCDF4
+   printf("*** testing netCDF-4 file with chunks...");
+   {
+      if (create_file(NC_NETCDF4)) ERR;
+      if (check_file()) ERR;
+   }
+   SUMMARIZE_ERR;
+#endif /* USE_NETCDF4 */
+   FINAL_RESULTS;
+}
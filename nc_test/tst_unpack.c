@@ -0,0 +1,207 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test nc_get_vara_unpack_double() and nc_get_vara_unpack_float(),
+   which must give the same results as reading the packed values and
+   unpacking them.
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <netcdf.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_unpack.nc"
+#define NREC 4
+#define NY 300
+#define NX 500
+#define SCALE 0.01
+#define OFFSET 273.15
+#define FILL -32767
+#define MISSING -32000
+#define MISSING2 31000
+#define VALID_MIN -30000
+
+/* The packed value at a point: some are fill, some one of the two
+ * missing values, some below the valid minimum. */
+static short
+packed(size_t r, size_t y, size_t x)
+{
+   size_t i = (r * NY + y) * NX + x;
+   if (i % 101 == 7)
+      return FILL;
+   if (i % 103 == 9)
+      return MISSING;
+   if (i % 109 == 13)
+      return MISSING2;
+   if (i % 107 == 11)
+      return VALID_MIN - 1;
+   return (short)((int)(i % 60000) - 30000);
+}
+
+static double
+unpacked(short v)
+{
+   if (v == FILL || v == MISSING || v == MISSING2 || v < VALID_MIN)
+      return NAN;
+   return v * SCALE + OFFSET;
+}
+
+static int
+create_file(int cmode)
+{
+   int ncid, dimids[3], varid, byteid, textid, badid;
+   size_t start[3] = {0, 0, 0}, count[3] = {1, NY, NX}, y, x, r;
+   short fill = FILL, missing[5] = {MISSING, MISSING2, 1, 2, 3};
+   short valid_min = VALID_MIN, valid_range[3] = {-10, 10, 20};
+   double scale = SCALE, offset = OFFSET;
+   signed char bytes[3] = {1, NC_FILL_BYTE, -3};
+   static short data[NY * NX];
+
+   if (nc_create(FILE_NAME, cmode|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) ERR;
+   if (nc_def_dim(ncid, "y", NY, &dimids[1])) ERR;
+   if (nc_def_dim(ncid, "x", NX, &dimids[2])) ERR;
+   if (nc_def_var(ncid, "t", NC_SHORT, 3, dimids, &varid)) ERR;
+   if (nc_put_att_short(ncid, varid, _FillValue, NC_SHORT, 1, &fill)) ERR;
+   if (nc_put_att_short(ncid, varid, "missing_value", NC_SHORT, 2, missing)) ERR;
+   if (nc_put_att_short(ncid, varid, "valid_min", NC_SHORT, 1, &valid_min)) ERR;
+   if (nc_put_att_double(ncid, varid, "scale_factor", NC_DOUBLE, 1, &scale)) ERR;
+   if (nc_put_att_double(ncid, varid, "add_offset", NC_DOUBLE, 1, &offset)) ERR;
+   if (nc_def_var(ncid, "b", NC_BYTE, 1, &dimids[2], &byteid)) ERR;
+   if (nc_def_var(ncid, "text", NC_CHAR, 1, &dimids[2], &textid)) ERR;
+
+   /* Vars with masking attributes of the wrong length. */
+   if (nc_def_var(ncid, "bad_min", NC_SHORT, 1, &dimids[2], &badid)) ERR;
+   if (nc_put_att_short(ncid, badid, "valid_min", NC_SHORT, 2, valid_range)) ERR;
+   if (nc_def_var(ncid, "bad_range", NC_SHORT, 1, &dimids[2], &badid)) ERR;
+   if (nc_put_att_short(ncid, badid, "valid_range", NC_SHORT, 3, valid_range)) ERR;
+   if (nc_def_var(ncid, "bad_missing", NC_SHORT, 1, &dimids[2], &badid)) ERR;
+   if (nc_put_att_short(ncid, badid, "missing_value", NC_SHORT, 5, missing)) ERR;
+   if (nc_def_var(ncid, "text_missing", NC_SHORT, 1, &dimids[2], &badid)) ERR;
+   if (nc_put_att_text(ncid, badid, "missing_value", 3, "N/A")) ERR;
+   if (cmode & NC_NETCDF4)
+   {
+      size_t chunks[3] = {1, 100, 128};
+      if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, varid, 1, 1, 1)) ERR;
+   }
+   if (nc_enddef(ncid)) ERR;
+
+   for (r = 0; r < NREC; r++)
+   {
+      for (y = 0; y < NY; y++)
+         for (x = 0; x < NX; x++)
+            data[y * NX + x] = packed(r, y, x);
+      start[0] = r;
+      if (nc_put_vara_short(ncid, varid, start, count, data)) ERR;
+   }
+   start[0] = 0;
+   count[0] = 3;
+   if (nc_put_vara_schar(ncid, byteid, start, count, bytes)) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+/* Compare unpacked values, where two NaNs are the same. */
+#define SAME(a, b) (((a) == (b)) || (isnan(a) && isnan(b)))
+
+static int
+check_file(void)
+{
+   int ncid, varid, byteid, textid, badid;
+   size_t start[3] = {1, 17, 33}, count[3] = {3, 250, 401};
+   size_t r, y, x, i, nvalid;
+   double *dval, bval[3], result;
+   const char *bad_names[] = {"bad_min", "bad_range", "bad_missing", "text_missing"};
+   float *fval;
+
+   if (!(dval = malloc(NREC * NY * NX * sizeof(double)))) ERR_RET;
+   if (!(fval = malloc(NREC * NY * NX * sizeof(float)))) ERR_RET;
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR_RET;
+   if (nc_inq_varid(ncid, "t", &varid)) ERR_RET;
+   if (nc_inq_varid(ncid, "b", &byteid)) ERR_RET;
+   if (nc_inq_varid(ncid, "text", &textid)) ERR_RET;
+
+   /* The whole var. */
+   if (nc_get_vara_unpack_double(ncid, varid, NULL, NULL, dval)) ERR_RET;
+   if (nc_get_vara_unpack_float(ncid, varid, NULL, NULL, fval)) ERR_RET;
+   for (r = 0, i = 0; r < NREC; r++)
+      for (y = 0; y < NY; y++)
+         for (x = 0; x < NX; x++, i++)
+         {
+            double want = unpacked(packed(r, y, x));
+            if (!SAME(dval[i], want)) ERR_RET;
+            if (!SAME(fval[i], (float)want)) ERR_RET;
+         }
+
+   /* Part of it. */
+   if (nc_get_vara_unpack_double(ncid, varid, start, count, dval)) ERR_RET;
+   for (r = 0, i = 0; r < count[0]; r++)
+      for (y = 0; y < count[1]; y++)
+         for (x = 0; x < count[2]; x++, i++)
+            if (!SAME(dval[i], unpacked(packed(start[0] + r, start[1] + y,
+                                               start[2] + x)))) ERR_RET;
+
+   /* Reductions leave out both missing values too. */
+   if (nc_get_vara_reduce(ncid, varid, NULL, NULL, NULL, NC_REDUCE_COUNT,
+                          &result)) ERR_RET;
+   for (r = 0, nvalid = 0; r < NREC; r++)
+      for (y = 0; y < NY; y++)
+         for (x = 0; x < NX; x++)
+            if (!isnan(unpacked(packed(r, y, x))))
+               nvalid++;
+   if (result != (double)nvalid) ERR_RET;
+
+   /* Without attributes, values are as stored, except for the
+    * default fill value. Past the written data there is only fill. */
+   start[0] = 0;
+   count[0] = 3;
+   if (nc_get_vara_unpack_double(ncid, byteid, start, count, bval)) ERR_RET;
+   if (bval[0] != 1 || !isnan(bval[1]) || bval[2] != -3) ERR_RET;
+   start[0] = NX - 3;
+   if (nc_get_vara_unpack_double(ncid, byteid, start, count, bval)) ERR_RET;
+   if (!isnan(bval[0]) || !isnan(bval[2])) ERR_RET;
+
+   /* Errors. */
+   if (nc_get_vara_unpack_double(ncid, textid, NULL, NULL, dval) != NC_ECHAR) ERR_RET;
+   if (nc_get_vara_unpack_double(ncid, varid + 100, NULL, NULL, dval) != NC_ENOTVAR) ERR_RET;
+   for (i = 0; i < sizeof(bad_names) / sizeof(bad_names[0]); i++)
+   {
+      if (nc_inq_varid(ncid, bad_names[i], &badid)) ERR_RET;
+      if (nc_get_vara_unpack_double(ncid, badid, NULL, NULL, dval) != NC_EINVAL) ERR_RET;
+      if (nc_get_vara_reduce(ncid, badid, NULL, NULL, NULL, NC_REDUCE_COUNT,
+                             &result) != NC_EINVAL) ERR_RET;
+   }
+   start[0] = NX + 1;
+   if (nc_get_vara_unpack_float(ncid, byteid, start, count, fval) != NC_EINVALCOORDS) ERR_RET;
+   if (nc_close(ncid)) ERR_RET;
+   free(dval);
+   free(fval);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing reads of packed variables.\n");
+   printf("*** testing classic file...");
+   {
+      if (create_file(0)) ERR;
+      if (check_file()) ERR;
+   }
+   SUMMARIZE_ERR;
+#ifdef USE_NETCDF4
+   printf("*** testing netCDF-4 file with chunks...");
+   {
+      if (create_file(NC_NETCDF4)) ERR;
+      if (check_file()) ERR;
+   }
+   SUMMARIZE_ERR;
+#endif /* USE_NETCDF4 */
+   FINAL_RESULTS;
+}
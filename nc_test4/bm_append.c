@@ -0,0 +1,101 @@
+/*
+Copyright 2016, UCAR/Unidata
+See COPYRIGHT file for copying and redistribution conditions.
+
+This program benchmarks appending records to a netCDF-4 file one at a
+time, with the datasets extended exactly (the default) and with them
+over-allocated in NC_APPEND_GEOMETRIC mode.
+
+Usage: bm_append [nrecs]
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include <netcdf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h> /* Extra high precision time info. */
+
+#define FILE_NAME "bm_append.nc"
+#define DEFAULT_NRECS 2000
+#define NVARS 4
+#define LAT_LEN 16
+#define LON_LEN 16
+
+/* Append nrecs records to the vars of a new file, and return the
+ * time taken, including the close. */
+static int
+append(int mode, int nrecs, double *secp)
+{
+   struct timeval start_time, end_time;
+   int ncid, dimids[3], time_varid, varids[NVARS];
+   size_t start[3] = {0, 0, 0}, count[3] = {1, LAT_LEN, LON_LEN};
+   float data[LAT_LEN * LON_LEN];
+   double time_val;
+   char name[NC_MAX_NAME + 1];
+   size_t len;
+   int v, rec, i;
+
+   for (i = 0; i < LAT_LEN * LON_LEN; i++)
+      data[i] = (float)i;
+
+   if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR_RET;
+   if (nc_def_dim(ncid, "time", NC_UNLIMITED, &dimids[0])) ERR_RET;
+   if (nc_def_dim(ncid, "lat", LAT_LEN, &dimids[1])) ERR_RET;
+   if (nc_def_dim(ncid, "lon", LON_LEN, &dimids[2])) ERR_RET;
+   if (nc_def_var(ncid, "time", NC_DOUBLE, 1, dimids, &time_varid)) ERR_RET;
+   for (v = 0; v < NVARS; v++)
+   {
+      sprintf(name, "var_%d", v);
+      if (nc_def_var(ncid, name, NC_FLOAT, 3, dimids, &varids[v])) ERR_RET;
+   }
+   if (nc_enddef(ncid)) ERR_RET;
+   if (nc_set_append_mode(ncid, mode, NULL)) ERR_RET;
+
+   if (gettimeofday(&start_time, NULL)) ERR_RET;
+   for (rec = 0; rec < nrecs; rec++)
+   {
+      start[0] = rec;
+      time_val = rec;
+      if (nc_put_var1_double(ncid, time_varid, start, &time_val)) ERR_RET;
+      for (v = 0; v < NVARS; v++)
+         if (nc_put_vara_float(ncid, varids[v], start, count, data)) ERR_RET;
+   }
+   if (nc_close(ncid)) ERR_RET;
+   if (gettimeofday(&end_time, NULL)) ERR_RET;
+   *secp = (double)(end_time.tv_sec - start_time.tv_sec) +
+      (double)(end_time.tv_usec - start_time.tv_usec) / 1.0e6;
+
+   /* Make sure the file is the same either way. */
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR_RET;
+   if (nc_inq_dimlen(ncid, dimids[0], &len)) ERR_RET;
+   if (len != nrecs) ERR_RET;
+   if (nc_close(ncid)) ERR_RET;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   int nrecs = DEFAULT_NRECS;
+   double exact_sec, geometric_sec;
+
+   if (argc > 2)
+   {
+      printf("Usage:\t%s [nrecs]\n", argv[0]);
+      return 0;
+   }
+   if (argc > 1)
+      nrecs = atoi(argv[1]);
+   if (nrecs < 1) ERR;
+
+   if (append(NC_APPEND_EXACT, nrecs, &exact_sec)) ERR;
+   if (append(NC_APPEND_GEOMETRIC, nrecs, &geometric_sec)) ERR;
+
+   printf("%-10s %8s %12s %12s\n", "mode", "records", "seconds", "records/s");
+   printf("%-10s %8d %12.4f %12.1f\n", "exact", nrecs, exact_sec,
+          nrecs / (exact_sec > 0 ? exact_sec : 1.0e-6));
+   printf("%-10s %8d %12.4f %12.1f\n", "geometric", nrecs, geometric_sec,
+          nrecs / (geometric_sec > 0 ? geometric_sec : 1.0e-6));
+   FINAL_RESULTS;
+}
@@ -0,0 +1,114 @@
+/*
+Copyright 2016, UCAR/Unidata
+See COPYRIGHT file for copying and redistribution conditions.
+
+This program benchmarks the type conversions done by netCDF-4 when the
+memory type of a read or write differs from the type in the file. For
+every pair of numeric types it times nc4_convert_type() on a buffer of
+values that are in range for all types, and prints the throughput.
+
+Usage: bm_convert [nelems [reps]]
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include "nc4internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h> /* Extra high precision time info. */
+
+#define DEFAULT_NELEMS (1 << 18)
+#define DEFAULT_REPS 4
+#define NUM_TYPES 10
+
+static const nc_type types[NUM_TYPES] = {NC_BYTE, NC_UBYTE, NC_SHORT,
+					 NC_USHORT, NC_INT, NC_UINT,
+					 NC_INT64, NC_UINT64, NC_FLOAT,
+					 NC_DOUBLE};
+static const char *type_names[NUM_TYPES] = {"byte", "ubyte", "short",
+					    "ushort", "int", "uint",
+					    "int64", "uint64", "float",
+					    "double"};
+static const size_t type_sizes[NUM_TYPES] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+
+/* Fill a buffer with values from 0 to 100, which all types can
+ * hold. */
+static void
+fill(void *buf, nc_type type, size_t nelems)
+{
+   size_t i;
+
+   for (i = 0; i < nelems; i++)
+   {
+      int v = (int)(i % 101);
+      switch (type)
+      {
+      case NC_BYTE: ((signed char *)buf)[i] = (signed char)v; break;
+      case NC_UBYTE: ((unsigned char *)buf)[i] = (unsigned char)v; break;
+      case NC_SHORT: ((short *)buf)[i] = (short)v; break;
+      case NC_USHORT: ((unsigned short *)buf)[i] = (unsigned short)v; break;
+      case NC_INT: ((int *)buf)[i] = v; break;
+      case NC_UINT: ((unsigned int *)buf)[i] = (unsigned int)v; break;
+      case NC_INT64: ((long long *)buf)[i] = v; break;
+      case NC_UINT64: ((unsigned long long *)buf)[i] = (unsigned long long)v; break;
+      case NC_FLOAT: ((float *)buf)[i] = (float)v; break;
+      case NC_DOUBLE: ((double *)buf)[i] = v; break;
+      }
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   struct timeval start_time, end_time;
+   size_t nelems = DEFAULT_NELEMS;
+   int reps = DEFAULT_REPS;
+   void *src, *dest;
+   int s, d, r, range_error;
+
+   if (argc > 3)
+   {
+      printf("Usage:\t%s [nelems [reps]]\n", argv[0]);
+      return 0;
+   }
+   if (argc > 1)
+      nelems = (size_t)atol(argv[1]);
+   if (argc > 2)
+      reps = atoi(argv[2]);
+   if (!nelems || reps < 1) ERR;
+
+   if (!(src = malloc(nelems * sizeof(double)))) ERR;
+   if (!(dest = malloc(nelems * sizeof(double)))) ERR;
+
+   printf("%-8s %-8s %12s %12s\n", "src", "dest", "MB/s", "Melem/s");
+   for (s = 0; s < NUM_TYPES; s++)
+   {
+      fill(src, types[s], nelems);
+      for (d = 0; d < NUM_TYPES; d++)
+      {
+	 double sec;
+
+	 /* Warm up the buffers before timing. */
+	 if (nc4_convert_type(src, dest, types[s], types[d], nelems,
+			      &range_error, NULL, 0, 0, 0)) ERR;
+	 if (range_error) ERR;
+
+	 if (gettimeofday(&start_time, NULL)) ERR;
+	 for (r = 0; r < reps; r++)
+	    if (nc4_convert_type(src, dest, types[s], types[d], nelems,
+				 &range_error, NULL, 0, 0, 0)) ERR;
+	 if (gettimeofday(&end_time, NULL)) ERR;
+	 sec = (double)(end_time.tv_sec - start_time.tv_sec) +
+	    (double)(end_time.tv_usec - start_time.tv_usec) / 1.0e6;
+	 if (sec <= 0)
+	    sec = 1.0e-6;
+	 printf("%-8s %-8s %12.1f %12.1f\n", type_names[s], type_names[d],
+		(double)(nelems * (type_sizes[s] + type_sizes[d])) * reps /
+		MEGABYTE / sec, (double)nelems * reps / 1.0e6 / sec);
+      }
+   }
+
+   free(src);
+   free(dest);
+   FINAL_RESULTS;
+}
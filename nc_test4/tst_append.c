@@ -0,0 +1,206 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test appending records in NC_APPEND_GEOMETRIC mode, which
+   over-allocates the datasets of unlimited dimensions and trims them
+   on sync and close.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include <hdf5.h>
+
+#define FILE_NAME "tst_append.nc"
+#define FILE_NAME_CLASSIC "tst_append_classic.nc"
+#define TIME_NAME "time"
+#define X_NAME "x"
+#define A_NAME "a"
+#define B_NAME "b"
+#define X_LEN 4
+#define NREC 37
+#define NREC_B 20
+#define NREC_SYNC 9
+#define NREC_ABORT 3
+
+/* Check the extent of a dataset in the HDF5 file. */
+static int
+check_extent(hid_t fileid, const char *name, int ndims, const hsize_t *expected)
+{
+   hid_t datasetid, spaceid;
+   hsize_t dims[NC_MAX_VAR_DIMS];
+   int d;
+
+   if ((datasetid = H5Dopen2(fileid, name, H5P_DEFAULT)) < 0) ERR_RET;
+   if ((spaceid = H5Dget_space(datasetid)) < 0) ERR_RET;
+   if (H5Sget_simple_extent_ndims(spaceid) != ndims) ERR_RET;
+   if (H5Sget_simple_extent_dims(spaceid, dims, NULL) < 0) ERR_RET;
+   for (d = 0; d < ndims; d++)
+      if (dims[d] != expected[d]) ERR_RET;
+   if (H5Sclose(spaceid) < 0) ERR_RET;
+   if (H5Dclose(datasetid) < 0) ERR_RET;
+   return 0;
+}
+
+/* Find the extent of the first dimension of a dataset, as a program
+ * opening the file would, while the library has it open. */
+static int
+get_extent(const char *file_name, const char *name, hsize_t *extentp)
+{
+   hid_t faplid, fileid, datasetid, spaceid;
+   hsize_t dims[NC_MAX_VAR_DIMS];
+
+   /* Opening it again takes the close degree the library uses. */
+   if ((faplid = H5Pcreate(H5P_FILE_ACCESS)) < 0) ERR_RET;
+#ifdef EXTRA_TESTS
+   if (H5Pset_fclose_degree(faplid, H5F_CLOSE_SEMI) < 0) ERR_RET;
+#else
+   if (H5Pset_fclose_degree(faplid, H5F_CLOSE_STRONG) < 0) ERR_RET;
+#endif
+   if ((fileid = H5Fopen(file_name, H5F_ACC_RDONLY, faplid)) < 0) ERR_RET;
+   if (H5Pclose(faplid) < 0) ERR_RET;
+   if ((datasetid = H5Dopen2(fileid, name, H5P_DEFAULT)) < 0) ERR_RET;
+   if ((spaceid = H5Dget_space(datasetid)) < 0) ERR_RET;
+   if (H5Sget_simple_extent_dims(spaceid, dims, NULL) < 0) ERR_RET;
+   *extentp = dims[0];
+   if (H5Sclose(spaceid) < 0 || H5Dclose(datasetid) < 0 ||
+       H5Fclose(fileid) < 0) ERR_RET;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing netcdf-4 geometric append mode.\n");
+   printf("*** testing appending records one at a time...");
+   {
+      int ncid, dimids[2], time_varid, a_varid, b_varid, old_mode;
+      size_t start[2] = {0, 0}, count[2] = {1, X_LEN}, len;
+      double time_val;
+      int a_out[X_LEN], a_in[NREC][X_LEN];
+      float b_val, b_in[NREC];
+      hsize_t extent;
+      int rec, x;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, TIME_NAME, NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, X_NAME, X_LEN, &dimids[1])) ERR;
+      if (nc_def_var(ncid, TIME_NAME, NC_DOUBLE, 1, dimids, &time_varid)) ERR;
+      if (nc_def_var(ncid, A_NAME, NC_INT, 2, dimids, &a_varid)) ERR;
+      if (nc_def_var(ncid, B_NAME, NC_FLOAT, 1, dimids, &b_varid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+
+      /* Check the mode arguments. */
+      if (nc_set_append_mode(ncid, 2, NULL) != NC_EINVAL) ERR;
+      if (nc_set_append_mode(ncid, NC_APPEND_GEOMETRIC, &old_mode)) ERR;
+      if (old_mode != NC_APPEND_EXACT) ERR;
+
+      for (rec = 0; rec < NREC; rec++)
+      {
+         start[0] = rec;
+         time_val = rec * 0.5;
+         for (x = 0; x < X_LEN; x++)
+            a_out[x] = rec * X_LEN + x;
+         if (nc_put_var1_double(ncid, time_varid, start, &time_val)) ERR;
+         if (nc_put_vara_int(ncid, a_varid, start, count, a_out)) ERR;
+         if (rec < NREC_B)
+         {
+            b_val = (float)rec;
+            if (nc_put_var1_float(ncid, b_varid, start, &b_val)) ERR;
+         }
+
+         /* The over-allocated records never show. */
+         if (nc_inq_dimlen(ncid, dimids[0], &len)) ERR;
+         if (len != rec + 1) ERR;
+         start[0] = rec + 1;
+         if (nc_get_vara_int(ncid, a_varid, start, count, a_in[0]) != NC_EINVALCOORDS) ERR;
+
+         /* Other programs see only the records written once the file
+          * is synced, and appending goes on. */
+         if (rec == NREC_SYNC)
+         {
+            if (get_extent(FILE_NAME, A_NAME, &extent)) ERR;
+            if (extent <= rec + 1) ERR;
+            if (nc_sync(ncid)) ERR;
+            if (get_extent(FILE_NAME, A_NAME, &extent)) ERR;
+            if (extent != rec + 1) ERR;
+         }
+      }
+
+      /* Records of b that were never written read as fill. */
+      if (nc_get_var_float(ncid, b_varid, b_in)) ERR;
+      for (rec = 0; rec < NREC; rec++)
+         if (b_in[rec] != (rec < NREC_B ? (float)rec : NC_FILL_FLOAT)) ERR;
+      if (nc_set_append_mode(ncid, NC_APPEND_EXACT, &old_mode)) ERR;
+      if (old_mode != NC_APPEND_GEOMETRIC) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* Reopen and check the data. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_set_append_mode(ncid, NC_APPEND_GEOMETRIC, NULL) != NC_EPERM) ERR;
+      if (nc_inq_dimlen(ncid, dimids[0], &len)) ERR;
+      if (len != NREC) ERR;
+      if (nc_get_var_int(ncid, a_varid, &a_in[0][0])) ERR;
+      for (rec = 0; rec < NREC; rec++)
+         for (x = 0; x < X_LEN; x++)
+            if (a_in[rec][x] != rec * X_LEN + x) ERR;
+      if (nc_get_var_float(ncid, b_varid, b_in)) ERR;
+      for (rec = 0; rec < NREC; rec++)
+         if (b_in[rec] != (rec < NREC_B ? (float)rec : NC_FILL_FLOAT)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing that datasets are trimmed on close...");
+   {
+      hid_t fileid;
+      hsize_t time_dims[1] = {NREC}, a_dims[2] = {NREC, X_LEN};
+      hsize_t b_dims[1] = {NREC_B};
+
+      if ((fileid = H5Fopen(FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0) ERR;
+      if (check_extent(fileid, TIME_NAME, 1, time_dims)) ERR;
+      if (check_extent(fileid, A_NAME, 2, a_dims)) ERR;
+      if (check_extent(fileid, B_NAME, 1, b_dims)) ERR;
+      if (H5Fclose(fileid) < 0) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing that datasets are trimmed on abort...");
+   {
+      int ncid, varid;
+      size_t start[1], len;
+      float b_val = 99.0;
+      hid_t fileid;
+      hsize_t b_dims[1] = {NREC_B + NREC_ABORT};
+      int rec;
+
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_set_append_mode(ncid, NC_APPEND_GEOMETRIC, NULL)) ERR;
+      if (nc_inq_varid(ncid, B_NAME, &varid)) ERR;
+      for (rec = NREC_B; rec < NREC_B + NREC_ABORT; rec++)
+      {
+         start[0] = rec;
+         if (nc_put_var1_float(ncid, varid, start, &b_val)) ERR;
+      }
+      if (nc_abort(ncid)) ERR;
+
+      if ((fileid = H5Fopen(FILE_NAME, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0) ERR;
+      if (check_extent(fileid, B_NAME, 1, b_dims)) ERR;
+      if (H5Fclose(fileid) < 0) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_unlimdim(ncid, &varid)) ERR;
+      if (nc_inq_dimlen(ncid, varid, &len)) ERR;
+      if (len != NREC) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing append mode of a classic file...");
+   {
+      int ncid;
+
+      if (nc_create(FILE_NAME_CLASSIC, NC_CLOBBER, &ncid)) ERR;
+      if (nc_set_append_mode(ncid, NC_APPEND_GEOMETRIC, NULL) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
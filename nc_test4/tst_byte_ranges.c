@@ -0,0 +1,223 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the byte ranges of var data in netCDF-4 and classic files, by
+   reading the bytes at those offsets without the library.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_byte_ranges.nc"
+#define FILE_NAME_CLASSIC "tst_byte_ranges_classic.nc"
+#define NT 6
+#define NX 8
+#define CT 4
+#define CX 4
+#define MAX_RANGES 8
+
+/* The ranges that have been seen. */
+struct ranges
+{
+   int n;
+   size_t start[MAX_RANGES][2];
+   size_t count[MAX_RANGES][2];
+   unsigned long long offset[MAX_RANGES];
+   unsigned long long size[MAX_RANGES];
+   unsigned int mask[MAX_RANGES];
+};
+
+static int
+save_range(const size_t *startp, const size_t *countp,
+           unsigned long long offset, unsigned long long size,
+           unsigned int filter_mask, void *udata)
+{
+   struct ranges *r = udata;
+   int i;
+
+   if (r->n >= MAX_RANGES)
+      return NC_EINVAL;
+   for (i = 0; i < 2; i++)
+   {
+      r->start[r->n][i] = startp ? startp[i] : 0;
+      r->count[r->n][i] = countp ? countp[i] : 0;
+   }
+   r->offset[r->n] = offset;
+   r->size[r->n] = size;
+   r->mask[r->n] = filter_mask;
+   r->n++;
+   return 0;
+}
+
+/* Read size bytes at offset in a file, with stdio. */
+static int
+read_bytes(const char *name, unsigned long long offset, size_t size, void *buf)
+{
+   FILE *fp;
+   int ret = 0;
+
+   if (!(fp = fopen(name, "rb")))
+      return NC_EIO;
+   if (fseek(fp, (long)offset, SEEK_SET) || fread(buf, 1, size, fp) != size)
+      ret = NC_EIO;
+   fclose(fp);
+   return ret;
+}
+
+/* Decode a big-endian int, as it is in a classic file. */
+static int
+get_be_int(const unsigned char *p)
+{
+   return (int)((unsigned)p[0] << 24 | (unsigned)p[1] << 16 |
+                (unsigned)p[2] << 8 | (unsigned)p[3]);
+}
+
+int
+main(int argc, char **argv)
+{
+   int data[NT][NX];
+   size_t start[2] = {0, 0}, count[2] = {NT, NX};
+   int t, x;
+
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+         data[t][x] = t * 1000 + x;
+
+   printf("\n*** Testing byte ranges of var data.\n");
+   printf("*** testing byte ranges of netCDF-4 vars...");
+   {
+      int ncid, dimids[2], chunkid, zipid, contigid, emptyid, i;
+      size_t chunks[2] = {CT, CX};
+      struct ranges r;
+      int buf[CT * CX];
+      unsigned char zbuf[CT * CX * sizeof(int) * 2];
+      unsigned char zbuf_in[CT * CX * sizeof(int) * 2];
+      size_t zsize;
+      unsigned int mask;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "t", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "chunked", NC_INT, 2, dimids, &chunkid)) ERR;
+      if (nc_def_var_chunking(ncid, chunkid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_endian(ncid, chunkid, NC_ENDIAN_NATIVE)) ERR;
+      if (nc_def_var(ncid, "zipped", NC_INT, 2, dimids, &zipid)) ERR;
+      if (nc_def_var_chunking(ncid, zipid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, zipid, 1, 1, 4)) ERR;
+      if (nc_def_var(ncid, "contig", NC_INT, 1, &dimids[1], &contigid)) ERR;
+      if (nc_def_var_chunking(ncid, contigid, NC_CONTIGUOUS, NULL)) ERR;
+      if (nc_def_var(ncid, "empty", NC_INT, 1, &dimids[1], &emptyid)) ERR;
+      if (nc_def_var_chunking(ncid, emptyid, NC_CONTIGUOUS, NULL)) ERR;
+      if (nc_put_vara_int(ncid, chunkid, start, count, &data[0][0])) ERR;
+      if (nc_put_vara_int(ncid, zipid, start, count, &data[0][0])) ERR;
+      if (nc_put_var_int(ncid, contigid, data[1])) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+
+      /* Each chunk of the uncompressed var holds the data, in native
+       * byte order, at the offset it is reported at. */
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, chunkid, save_range, &r)) ERR;
+      if (r.n != 4) ERR;
+      for (i = 0; i < r.n; i++)
+      {
+         size_t t0 = r.start[i][0], x0 = r.start[i][1];
+
+         if (t0 != (size_t)(i / 2) * CT || x0 != (size_t)(i % 2) * CX) ERR;
+         if (r.count[i][0] != CT || r.count[i][1] != CX) ERR;
+         if (r.size[i] != sizeof(buf) || r.mask[i]) ERR;
+         if (read_bytes(FILE_NAME, r.offset[i], sizeof(buf), buf)) ERR;
+         /* The last row of chunks is past the end of the data. */
+         for (t = 0; t < CT && t0 + (size_t)t < NT; t++)
+            for (x = 0; x < CX; x++)
+               if (buf[t * CX + x] != data[t0 + (size_t)t][x0 + (size_t)x]) ERR;
+      }
+
+      /* The compressed chunks are the bytes the raw reads return. */
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, zipid, save_range, &r)) ERR;
+      if (r.n != 4) ERR;
+      for (i = 0; i < r.n; i++)
+      {
+         if (r.size[i] >= sizeof(buf) || r.size[i] > sizeof(zbuf)) ERR;
+         if (nc_get_chunk_raw(ncid, zipid, r.start[i], &mask, &zsize, zbuf)) ERR;
+         if (zsize != r.size[i] || mask != r.mask[i]) ERR;
+         if (read_bytes(FILE_NAME, r.offset[i], zsize, zbuf_in)) ERR;
+         if (memcmp(zbuf, zbuf_in, zsize)) ERR;
+      }
+
+      /* A contiguous var is one range, and an unwritten one has
+       * none. */
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, contigid, save_range, &r)) ERR;
+      if (r.n != 1 || r.start[0][0] || r.count[0][0] != NX) ERR;
+      if (r.size[0] != NX * sizeof(int)) ERR;
+      if (read_bytes(FILE_NAME, r.offset[0], NX * sizeof(int), buf)) ERR;
+      for (x = 0; x < NX; x++)
+         if (buf[x] != data[1][x]) ERR;
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, emptyid, save_range, &r)) ERR;
+      if (r.n) ERR;
+
+      if (nc_iter_byte_ranges(ncid, chunkid, NULL, &r) != NC_EINVAL) ERR;
+      if (nc_iter_byte_ranges(ncid, emptyid + 1, save_range, &r) != NC_ENOTVAR) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing byte ranges of classic vars...");
+   {
+      int ncid, dimids[2], recid, fixid, scalarid, i;
+      struct ranges r;
+      unsigned char buf[NX * 4];
+      signed char c = 'z', c_in;
+
+      if (nc_create(FILE_NAME_CLASSIC, NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "t", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "rec", NC_INT, 2, dimids, &recid)) ERR;
+      if (nc_def_var(ncid, "fixed", NC_INT, 1, &dimids[1], &fixid)) ERR;
+      if (nc_def_var(ncid, "scalar", NC_BYTE, 0, NULL, &scalarid)) ERR;
+
+      /* No ranges until the data has a place in the file. */
+      if (nc_iter_byte_ranges(ncid, recid, save_range, &r) != NC_EINDEFINE) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_put_vara_int(ncid, recid, start, count, &data[0][0])) ERR;
+      if (nc_put_var_int(ncid, fixid, data[2])) ERR;
+      if (nc_put_var_schar(ncid, scalarid, &c)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME_CLASSIC, NC_NOWRITE, &ncid)) ERR;
+
+      /* Each record is a range of big-endian ints. */
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, recid, save_range, &r)) ERR;
+      if (r.n != NT) ERR;
+      for (i = 0; i < r.n; i++)
+      {
+         if (r.start[i][0] != i || r.start[i][1]) ERR;
+         if (r.count[i][0] != 1 || r.count[i][1] != NX) ERR;
+         if (r.size[i] != NX * 4 || r.mask[i]) ERR;
+         if (read_bytes(FILE_NAME_CLASSIC, r.offset[i], NX * 4, buf)) ERR;
+         for (x = 0; x < NX; x++)
+            if (get_be_int(&buf[x * 4]) != data[i][x]) ERR;
+      }
+
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, fixid, save_range, &r)) ERR;
+      if (r.n != 1 || r.count[0][0] != NX || r.size[0] != NX * 4) ERR;
+      if (read_bytes(FILE_NAME_CLASSIC, r.offset[0], NX * 4, buf)) ERR;
+      for (x = 0; x < NX; x++)
+         if (get_be_int(&buf[x * 4]) != data[2][x]) ERR;
+
+      memset(&r, 0, sizeof(r));
+      if (nc_iter_byte_ranges(ncid, scalarid, save_range, &r)) ERR;
+      if (r.n != 1 || r.size[0] != 1) ERR;
+      if (read_bytes(FILE_NAME_CLASSIC, r.offset[0], 1, &c_in)) ERR;
+      if (c_in != c) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
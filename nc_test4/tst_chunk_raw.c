@@ -0,0 +1,340 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test reading, writing and iterating over the chunks of a var as
+   they are stored, and the copy of vars with them.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include <hdf5.h>
+
+#define FILE_NAME "tst_chunk_raw.nc"
+#define FILE_NAME2 "tst_chunk_raw2.nc"
+#define FILE_NAME3 "tst_chunk_raw3.nc"
+#define NT 10
+#define NX 12
+#define CT 4
+#define CX 5
+#define NCHUNKS 9 /* 3 x 3, with partial chunks at the ends */
+
+/* What the iteration has seen. */
+struct visit
+{
+   int n;
+   size_t start[NCHUNKS][2];
+   size_t size[NCHUNKS];
+   int stop_at;
+};
+
+static int
+count_chunk(const size_t *startp, unsigned int filter_mask, size_t size,
+            void *udata)
+{
+   struct visit *v = udata;
+
+   if (v->n >= NCHUNKS)
+      return NC_EINVAL;
+   v->start[v->n][0] = startp[0];
+   v->start[v->n][1] = startp[1];
+   v->size[v->n] = size;
+   if (++v->n == v->stop_at)
+      return -1000;
+   return 0;
+}
+
+/* Copy each stored chunk to another file. */
+struct copy
+{
+   int ncid_in, varid_in, ncid_out, varid_out;
+   char buf[CT * CX * sizeof(float) * 2];
+};
+
+static int
+copy_chunk(const size_t *startp, unsigned int filter_mask, size_t size,
+           void *udata)
+{
+   struct copy *c = udata;
+   int ret;
+
+   if (size > sizeof(c->buf))
+      return NC_EINVAL;
+   if ((ret = nc_get_chunk_raw(c->ncid_in, c->varid_in, startp, &filter_mask,
+                               &size, c->buf)))
+      return ret;
+   return nc_put_chunk_raw(c->ncid_out, c->varid_out, startp, filter_mask,
+                           size, c->buf);
+}
+
+/* Define the data var, compressed, in a new file. */
+static int
+def_file(const char *name, int *ncidp, int *varidp)
+{
+   int dimids[2];
+   size_t chunks[2] = {CT, CX};
+
+   if (nc_create(name, NC_NETCDF4|NC_CLOBBER, ncidp)) ERR_RET;
+   if (nc_def_dim(*ncidp, "t", NC_UNLIMITED, &dimids[0])) ERR_RET;
+   if (nc_def_dim(*ncidp, "x", NX, &dimids[1])) ERR_RET;
+   if (nc_def_var(*ncidp, "data", NC_FLOAT, 2, dimids, varidp)) ERR_RET;
+   if (nc_def_var_chunking(*ncidp, *varidp, NC_CHUNKED, chunks)) ERR_RET;
+   if (nc_def_var_deflate(*ncidp, *varidp, 1, 1, 4)) ERR_RET;
+   return 0;
+}
+
+/* Check the data, read through the filters. */
+static int
+check_data(int ncid, int varid, float (*data)[NX])
+{
+   float data_in[NT][NX];
+   size_t start[2] = {0, 0}, count[2] = {NT, NX};
+   int t, x;
+
+   if (nc_get_vara_float(ncid, varid, start, count, &data_in[0][0])) ERR_RET;
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+         if (data_in[t][x] != data[t][x]) ERR_RET;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   float data[NT][NX];
+   size_t start[2] = {0, 0}, count[2] = {NT, NX};
+   int t, x;
+
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+         data[t][x] = (float)(t * 100 + x % 3);
+
+   printf("\n*** Testing raw chunk I/O.\n");
+   printf("*** testing iteration over the stored chunks...");
+   {
+      int ncid, varid, contigid, dimid, i;
+      struct visit v;
+      size_t size, bad[2];
+      unsigned int mask;
+      char buf[CT * CX * sizeof(float) * 2];
+
+      if (def_file(FILE_NAME, &ncid, &varid)) ERR;
+      if (nc_inq_dimid(ncid, "x", &dimid)) ERR;
+      if (nc_def_var(ncid, "contig", NC_INT, 1, &dimid, &contigid)) ERR;
+      if (nc_def_var_chunking(ncid, contigid, NC_CONTIGUOUS, NULL)) ERR;
+      if (nc_put_vara_float(ncid, varid, start, count, &data[0][0])) ERR;
+
+      /* The chunks are visited in order, each with the size it has in
+       * the file, even while the file is open for writing. */
+      memset(&v, 0, sizeof(v));
+      if (nc_iter_chunks_raw(ncid, varid, count_chunk, &v)) ERR;
+      if (v.n != NCHUNKS) ERR;
+      for (i = 0; i < NCHUNKS; i++)
+      {
+         if (v.start[i][0] != (i / 3) * CT || v.start[i][1] != (i % 3) * CX) ERR;
+         if (nc_get_chunk_raw(ncid, varid, v.start[i], &mask, &size, NULL)) ERR;
+         if (size != v.size[i] || mask) ERR;
+         /* The data compresses. */
+         if (!size || size >= CT * CX * sizeof(float)) ERR;
+      }
+
+      /* Stop the iteration early. */
+      memset(&v, 0, sizeof(v));
+      v.stop_at = 2;
+      if (nc_iter_chunks_raw(ncid, varid, count_chunk, &v) != -1000) ERR;
+      if (v.n != 2) ERR;
+
+      /* Bad chunks and vars. */
+      bad[0] = 1;
+      bad[1] = 0;
+      if (nc_get_chunk_raw(ncid, varid, bad, NULL, &size, NULL) != NC_EINVAL) ERR;
+      bad[0] = 3 * CT;
+      if (nc_get_chunk_raw(ncid, varid, bad, NULL, &size, NULL) != NC_EINVALCOORDS) ERR;
+      if (nc_get_chunk_raw(ncid, varid, NULL, NULL, &size, NULL) != NC_EINVAL) ERR;
+      if (nc_get_chunk_raw(ncid, contigid, start, NULL, &size, NULL) != NC_EINVAL) ERR;
+      if (nc_iter_chunks_raw(ncid, contigid, count_chunk, &v) != NC_EINVAL) ERR;
+      if (nc_iter_chunks_raw(ncid, varid, NULL, &v) != NC_EINVAL) ERR;
+      if (nc_get_chunk_raw(ncid, varid + 5, start, NULL, &size, NULL) != NC_ENOTVAR) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* No writes to a read-only file. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_chunk_raw(ncid, varid, start, &mask, &size, buf)) ERR;
+      if (nc_put_chunk_raw(ncid, varid, start, mask, size, buf) != NC_EPERM) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing copy of the stored chunks...");
+   {
+      struct copy c;
+      struct visit v;
+      float last = data[NT - 1][NX - 1];
+      size_t index[2] = {NT - 1, NX - 1};
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &c.ncid_in)) ERR;
+      if (nc_inq_varid(c.ncid_in, "data", &c.varid_in)) ERR;
+
+      /* The chunks must be within the extent of the var, so the
+       * unlimited dim is extended first. */
+      if (def_file(FILE_NAME2, &c.ncid_out, &c.varid_out)) ERR;
+      if (nc_iter_chunks_raw(c.ncid_in, c.varid_in, copy_chunk, &c) != NC_EINVALCOORDS) ERR;
+      if (nc_put_var1_float(c.ncid_out, c.varid_out, index, &last)) ERR;
+      if (nc_iter_chunks_raw(c.ncid_in, c.varid_in, copy_chunk, &c)) ERR;
+      if (check_data(c.ncid_out, c.varid_out, data)) ERR;
+      if (nc_close(c.ncid_out)) ERR;
+      if (nc_close(c.ncid_in)) ERR;
+
+      if (nc_open(FILE_NAME2, NC_NOWRITE, &c.ncid_out)) ERR;
+      if (check_data(c.ncid_out, c.varid_out, data)) ERR;
+      memset(&v, 0, sizeof(v));
+      if (nc_iter_chunks_raw(c.ncid_out, c.varid_out, count_chunk, &v)) ERR;
+      if (v.n != NCHUNKS) ERR;
+      if (nc_close(c.ncid_out)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing chunks that were never written...");
+   {
+      int ncid, varid;
+      struct visit v;
+      size_t size, chunk_start[2] = {CT, CX}, one_count[2] = {1, 1};
+      float value = 42.0, fill, value_in[NT][NX];
+      unsigned int mask;
+
+      /* Only one chunk is written, and the extent reaches the end of
+       * the var. */
+      if (def_file(FILE_NAME, &ncid, &varid)) ERR;
+      if (nc_put_vara_float(ncid, varid, chunk_start, one_count, &value)) ERR;
+      chunk_start[0] = NT - 1;
+      if (nc_put_vara_float(ncid, varid, chunk_start, one_count, &value)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      memset(&v, 0, sizeof(v));
+      if (nc_iter_chunks_raw(ncid, varid, count_chunk, &v)) ERR;
+      if (v.n != 2) ERR;
+      if (v.start[0][0] != CT || v.start[0][1] != CX) ERR;
+      if (v.start[1][0] != 2 * CT || v.start[1][1] != CX) ERR;
+      if (nc_get_chunk_raw(ncid, varid, start, &mask, &size, &fill)) ERR;
+      if (size) ERR;
+
+      /* What isn't stored reads as fill. */
+      if (nc_get_vara_float(ncid, varid, start, count, &value_in[0][0])) ERR;
+      if (value_in[0][0] != NC_FILL_FLOAT || value_in[CT][CX] != value) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing the order of the filters...");
+   {
+      int ncid, varid;
+      size_t nfilters;
+      unsigned int ids[4];
+      hid_t fileid, spaceid, plistid, datasetid;
+      hsize_t dims[2] = {NT, NX}, chunk_dims[2] = {CT, CX};
+
+      /* The order this library sets them in, before and after the
+       * dataset is created. */
+      if (def_file(FILE_NAME, &ncid, &varid)) ERR;
+      if (nc_def_var_fletcher32(ncid, varid, NC_FLETCHER32)) ERR;
+      if (nc_inq_var_filter_ids(ncid, varid, &nfilters, NULL)) ERR;
+      if (nfilters != 3) ERR;
+      if (nc_inq_var_filter_ids(ncid, varid, NULL, ids)) ERR;
+      if (ids[0] != H5Z_FILTER_SHUFFLE || ids[1] != H5Z_FILTER_DEFLATE ||
+          ids[2] != H5Z_FILTER_FLETCHER32) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_var_filter_ids(ncid, varid, &nfilters, ids)) ERR;
+      if (nfilters != 3 || ids[0] != H5Z_FILTER_SHUFFLE ||
+          ids[1] != H5Z_FILTER_DEFLATE || ids[2] != H5Z_FILTER_FLETCHER32) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The same filters, in the order another program set them. */
+      if ((fileid = H5Fcreate(FILE_NAME3, H5F_ACC_TRUNC, H5P_DEFAULT,
+                              H5P_DEFAULT)) < 0) ERR;
+      if ((spaceid = H5Screate_simple(2, dims, NULL)) < 0) ERR;
+      if ((plistid = H5Pcreate(H5P_DATASET_CREATE)) < 0) ERR;
+      if (H5Pset_chunk(plistid, 2, chunk_dims) < 0) ERR;
+      if (H5Pset_fletcher32(plistid) < 0) ERR;
+      if (H5Pset_shuffle(plistid) < 0) ERR;
+      if (H5Pset_deflate(plistid, 4) < 0) ERR;
+      if ((datasetid = H5Dcreate2(fileid, "data", H5T_NATIVE_FLOAT, spaceid,
+                                  H5P_DEFAULT, plistid, H5P_DEFAULT)) < 0) ERR;
+      if (H5Dclose(datasetid) < 0 || H5Pclose(plistid) < 0 ||
+          H5Sclose(spaceid) < 0 || H5Fclose(fileid) < 0) ERR;
+      if (nc_open(FILE_NAME3, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_var_filter_ids(ncid, 0, &nfilters, ids)) ERR;
+      if (nfilters != 3 || ids[0] != H5Z_FILTER_FLETCHER32 ||
+          ids[1] != H5Z_FILTER_SHUFFLE || ids[2] != H5Z_FILTER_DEFLATE) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing nc_copy_var with the stored chunks...");
+   {
+      int ncid_in, ncid_out, varid, dimid, dimids[2], shuffle, deflate;
+      int storage, fletcher32;
+      size_t chunks[2], nfilters;
+
+      /* The copy of a compressed var gets the storage of any new var,
+       * and is not compressed. */
+      if (def_file(FILE_NAME, &ncid_in, &varid)) ERR;
+      if (nc_def_var_fletcher32(ncid_in, varid, NC_FLETCHER32)) ERR;
+      if (nc_put_vara_float(ncid_in, varid, start, count, &data[0][0])) ERR;
+      if (nc_close(ncid_in)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid_in)) ERR;
+      if (nc_create(FILE_NAME2, NC_NETCDF4|NC_CLOBBER, &ncid_out)) ERR;
+      if (nc_def_dim(ncid_out, "t", NC_UNLIMITED, &dimid)) ERR;
+      if (nc_def_dim(ncid_out, "x", NX, &dimid)) ERR;
+      if (nc_copy_var(ncid_in, varid, ncid_out)) ERR;
+      if (nc_close(ncid_out)) ERR;
+      if (nc_close(ncid_in)) ERR;
+
+      if (nc_open(FILE_NAME2, NC_NOWRITE, &ncid_out)) ERR;
+      if (nc_inq_var_deflate(ncid_out, varid, &shuffle, &deflate, NULL)) ERR;
+      if (shuffle || deflate) ERR;
+      if (nc_inq_var_fletcher32(ncid_out, varid, &fletcher32)) ERR;
+      if (fletcher32) ERR;
+      if (nc_inq_var_filter_ids(ncid_out, varid, &nfilters, NULL)) ERR;
+      if (nfilters) ERR;
+      if (check_data(ncid_out, varid, data)) ERR;
+      if (nc_close(ncid_out)) ERR;
+
+      /* A var with the default storage is copied as stored. */
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid_in)) ERR;
+      if (nc_def_dim(ncid_in, "t", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid_in, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid_in, "data", NC_FLOAT, 2, dimids, &varid)) ERR;
+      if (nc_put_vara_float(ncid_in, varid, start, count, &data[0][0])) ERR;
+      if (nc_close(ncid_in)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid_in)) ERR;
+      if (nc_create(FILE_NAME2, NC_NETCDF4|NC_CLOBBER, &ncid_out)) ERR;
+      if (nc_def_dim(ncid_out, "t", NC_UNLIMITED, &dimid)) ERR;
+      if (nc_def_dim(ncid_out, "x", NX, &dimid)) ERR;
+      if (nc_copy_var(ncid_in, varid, ncid_out)) ERR;
+      if (nc_close(ncid_out)) ERR;
+      if (nc_close(ncid_in)) ERR;
+
+      if (nc_open(FILE_NAME2, NC_NOWRITE, &ncid_out)) ERR;
+      if (nc_inq_var_chunking(ncid_out, varid, &storage, chunks)) ERR;
+      if (storage != NC_CHUNKED) ERR;
+      if (check_data(ncid_out, varid, data)) ERR;
+      if (nc_close(ncid_out)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing raw chunk I/O of classic files...");
+   {
+      int ncid, dimid, varid;
+      size_t size;
+      struct visit v;
+
+      if (nc_create(FILE_NAME, NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+      if (nc_def_var(ncid, "v", NC_INT, 1, &dimid, &varid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_get_chunk_raw(ncid, varid, start, NULL, &size, NULL) != NC_ENOTNC4) ERR;
+      if (nc_iter_chunks_raw(ncid, varid, count_chunk, &v) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
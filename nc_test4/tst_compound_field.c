@@ -0,0 +1,297 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test reads of one field of compound vars, with
+   nc_get_vara_field().
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_compound_field.nc"
+#define FILE_NAME_CLASSIC "tst_compound_field_classic.nc"
+#define NT 5
+#define NX 7
+#define NT_MORE 8
+#define NFLAGS 3
+#define NVARS 2
+#define BIG_NT 600
+#define BIG_NX 1000
+
+/* An observation record. */
+struct obs
+{
+   int id;
+   double time;
+   float temp;
+   short flags[NFLAGS];
+   char *name;
+};
+
+static void
+make_obs(struct obs *o, int t, int x)
+{
+   char name[16];
+   int f;
+
+   o->id = t * 100 + x;
+   o->time = t + x / 10.0;
+   o->temp = 273.5f + (float)(t - x);
+   for (f = 0; f < NFLAGS; f++)
+      o->flags[f] = (short)(t + x + f);
+   snprintf(name, sizeof(name), "stn%d.%d", t, x);
+   o->name = strdup(name);
+}
+
+/* The record without its name. */
+struct pos
+{
+   int id;
+   double time;
+   float temp;
+   short flags[NFLAGS];
+};
+
+/* A small record. */
+struct pair
+{
+   int a;
+   double b;
+};
+
+/* Define the compound type of the records, with or without the
+ * name. */
+static int
+def_obs_type(int ncid, const char *name, int with_name, nc_type *typeidp)
+{
+   int flags_size[1] = {NFLAGS};
+
+   if (nc_def_compound(ncid, with_name ? sizeof(struct obs) : sizeof(struct pos),
+                       name, typeidp)) ERR_RET;
+   if (nc_insert_compound(ncid, *typeidp, "id", NC_COMPOUND_OFFSET(struct obs, id),
+                          NC_INT)) ERR_RET;
+   if (nc_insert_compound(ncid, *typeidp, "time", NC_COMPOUND_OFFSET(struct obs, time),
+                          NC_DOUBLE)) ERR_RET;
+   if (nc_insert_compound(ncid, *typeidp, "temp", NC_COMPOUND_OFFSET(struct obs, temp),
+                          NC_FLOAT)) ERR_RET;
+   if (nc_insert_array_compound(ncid, *typeidp, "flags",
+                                NC_COMPOUND_OFFSET(struct obs, flags), NC_SHORT,
+                                1, flags_size)) ERR_RET;
+   if (with_name &&
+       nc_insert_compound(ncid, *typeidp, "name", NC_COMPOUND_OFFSET(struct obs, name),
+                          NC_STRING)) ERR_RET;
+   return 0;
+}
+
+/* Check each field of a hyperslab of a var of records against the
+ * whole records. */
+static int
+check_fields(int ncid, int varid, int with_name, const size_t *start,
+             const size_t *count, struct obs (*data)[NX])
+{
+   int ids[NT * NX];
+   double times[NT * NX];
+   float temps[NT * NX];
+   short flags[NT * NX][NFLAGS];
+   char *names[NT * NX];
+   size_t t, x, i;
+   int f;
+
+   if (nc_get_vara_field(ncid, varid, 0, start, count, ids)) ERR_RET;
+   if (nc_get_vara_field(ncid, varid, 1, start, count, times)) ERR_RET;
+   if (nc_get_vara_field(ncid, varid, 2, start, count, temps)) ERR_RET;
+   if (nc_get_vara_field(ncid, varid, 3, start, count, flags)) ERR_RET;
+   if (with_name && nc_get_vara_field(ncid, varid, 4, start, count, names)) ERR_RET;
+   for (i = 0, t = start[0]; t < start[0] + count[0]; t++)
+      for (x = start[1]; x < start[1] + count[1]; x++, i++)
+      {
+         struct obs *o = &data[t][x];
+         if (ids[i] != o->id || times[i] != o->time || temps[i] != o->temp) ERR_RET;
+         for (f = 0; f < NFLAGS; f++)
+            if (flags[i][f] != o->flags[f]) ERR_RET;
+         if (with_name)
+         {
+            if (strcmp(names[i], o->name)) ERR_RET;
+            free(names[i]);
+         }
+      }
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct obs data[NT][NX];
+   struct pos posdata[NT][NX];
+   int t, x;
+
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+      {
+         make_obs(&data[t][x], t, x);
+         memcpy(&posdata[t][x], &data[t][x], sizeof(struct pos));
+      }
+
+   printf("\n*** Testing reads of one field of compound vars.\n");
+   printf("*** testing field reads...");
+   {
+      int ncid, dimids[2], varids[NVARS], varid, scalarid, moreid, intid, v;
+      int ids[NT_MORE * NX];
+      nc_type typeids[NVARS];
+      size_t start[2] = {0, 0}, count[2] = {NT, NX};
+      size_t sub_start[2] = {1, 2}, sub_count[2] = {3, 4};
+      size_t more_count[2] = {NT_MORE, NX};
+      struct obs fill, one;
+      float temp, temps[NT_MORE];
+      char *names[NT_MORE];
+      double time;
+
+      /* The records of obs have a string, and are read through HDF5
+       * a field at a time, but those of pos don't, and are read in
+       * blocks of whole records. */
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (def_obs_type(ncid, "obs_t", 1, &typeids[0])) ERR;
+      if (def_obs_type(ncid, "pos_t", 0, &typeids[1])) ERR;
+      if (nc_def_dim(ncid, "t", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "obs", typeids[0], 2, dimids, &varids[0])) ERR;
+      if (nc_def_var(ncid, "pos", typeids[1], 2, dimids, &varids[1])) ERR;
+      memset(&fill, 0, sizeof(fill));
+      fill.id = -1;
+      fill.temp = -999.0f;
+      for (v = 0; v < NVARS; v++)
+         if (nc_def_var_fill(ncid, varids[v], 0, &fill)) ERR;
+      if (nc_def_var(ncid, "one", typeids[0], 0, NULL, &scalarid)) ERR;
+      if (nc_def_var(ncid, "more", NC_INT, 2, dimids, &moreid)) ERR;
+      if (nc_def_var(ncid, "x", NC_INT, 1, &dimids[1], &intid)) ERR;
+      if (nc_put_vara(ncid, varids[0], start, count, data)) ERR;
+      if (nc_put_vara(ncid, varids[1], start, count, posdata)) ERR;
+      if (nc_put_var(ncid, scalarid, &data[2][3])) ERR;
+
+      /* Whole records and their fields agree, before and after the
+       * file is closed. */
+      for (v = 0; v < NVARS; v++)
+         if (check_fields(ncid, varids[v], !v, start, count, data)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      for (v = 0; v < NVARS; v++)
+      {
+         if (check_fields(ncid, varids[v], !v, start, count, data)) ERR;
+         if (check_fields(ncid, varids[v], !v, sub_start, sub_count, data)) ERR;
+      }
+      if (nc_get_vara_field(ncid, scalarid, 1, NULL, NULL, &time)) ERR;
+      if (time != data[2][3].time) ERR;
+
+      /* The records past those written read as the field of the fill
+       * value. */
+      for (t = 0; t < NT_MORE * NX; t++)
+         ids[t] = t;
+      if (nc_put_vara_int(ncid, moreid, start, more_count, ids)) ERR;
+      more_count[1] = 1;
+      start[1] = 4;
+      for (v = 0; v < NVARS; v++)
+      {
+         varid = varids[v];
+         if (nc_get_vara_field(ncid, varid, 2, start, more_count, temps)) ERR;
+         for (t = 0; t < NT_MORE; t++)
+            if (temps[t] != (t < NT ? data[t][4].temp : fill.temp)) ERR;
+         if (nc_get_vara_field(ncid, varid, 0, NULL, NULL, ids)) ERR;
+         for (t = 0; t < NT_MORE; t++)
+            for (x = 0; x < NX; x++)
+               if (ids[t * NX + x] != (t < NT ? data[t][x].id : fill.id)) ERR;
+      }
+
+      /* Strings can't be shared with the fill value, and read as
+       * NULL. */
+      if (nc_get_vara_field(ncid, varids[0], 4, start, more_count, names)) ERR;
+      for (t = 0; t < NT_MORE; t++)
+      {
+         if (t < NT ? strcmp(names[t], data[t][4].name) : names[t] != NULL) ERR;
+         free(names[t]);
+      }
+
+      /* Nothing to read is no error. */
+      more_count[0] = 0;
+      for (v = 0; v < NVARS; v++)
+         if (nc_get_vara_field(ncid, varids[v], 0, start, more_count, NULL)) ERR;
+
+      /* Bad fields, bad types, and bad hyperslabs. */
+      varid = varids[0];
+      start[1] = 0;
+      count[0] = 1;
+      if (nc_get_vara_field(ncid, varid, 5, start, count, &one) != NC_EBADFIELD) ERR;
+      if (nc_get_vara_field(ncid, varids[1], 4, start, count, &one) != NC_EBADFIELD) ERR;
+      if (nc_get_vara_field(ncid, varid, -1, start, count, &one) != NC_EBADFIELD) ERR;
+      if (nc_get_vara_field(ncid, intid, 0, NULL, NULL, ids) != NC_EBADTYPE) ERR;
+      if (nc_get_vara_field(ncid, intid + 1, 0, NULL, NULL, ids) != NC_ENOTVAR) ERR;
+      count[1] = NX + 1;
+      if (nc_get_vara_field(ncid, varid, 2, start, count, &temp) != NC_EEDGE) ERR;
+      start[0] = NT_MORE;
+      count[1] = 1;
+      if (nc_get_vara_field(ncid, varid, 2, start, count, &temp) != NC_EINVALCOORDS) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing field reads of many blocks...");
+   {
+      int ncid, dimids[2], varid;
+      nc_type typeid;
+      size_t start[2] = {5, 3}, count[2] = {BIG_NT - 10, BIG_NX - 6};
+      struct pair *big;
+      double *b;
+      size_t i, j;
+
+      /* More records than fit in one block of the conversion
+       * buffer. */
+      if (!(big = malloc(BIG_NT * BIG_NX * sizeof(struct pair)))) ERR;
+      if (!(b = malloc(BIG_NT * BIG_NX * sizeof(double)))) ERR;
+      for (i = 0; i < BIG_NT * BIG_NX; i++)
+      {
+         big[i].a = (int)i;
+         big[i].b = (double)i * 0.5;
+      }
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_compound(ncid, sizeof(struct pair), "pair_t", &typeid)) ERR;
+      if (nc_insert_compound(ncid, typeid, "a", NC_COMPOUND_OFFSET(struct pair, a),
+                             NC_INT)) ERR;
+      if (nc_insert_compound(ncid, typeid, "b", NC_COMPOUND_OFFSET(struct pair, b),
+                             NC_DOUBLE)) ERR;
+      if (nc_def_dim(ncid, "t", BIG_NT, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", BIG_NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "big", typeid, 2, dimids, &varid)) ERR;
+      if (nc_put_var(ncid, varid, big)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_vara_field(ncid, varid, 1, NULL, NULL, b)) ERR;
+      for (i = 0; i < BIG_NT * BIG_NX; i++)
+         if (b[i] != big[i].b) ERR;
+      if (nc_get_vara_field(ncid, varid, 1, start, count, b)) ERR;
+      for (i = 0; i < count[0]; i++)
+         for (j = 0; j < count[1]; j++)
+            if (b[i * count[1] + j] != big[(start[0] + i) * BIG_NX + start[1] + j].b) ERR;
+      if (nc_close(ncid)) ERR;
+      free(big);
+      free(b);
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing field reads of classic files...");
+   {
+      int ncid, dimid, varid, id;
+
+      if (nc_create(FILE_NAME_CLASSIC, NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+      if (nc_def_var(ncid, "v", NC_INT, 1, &dimid, &varid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_get_vara_field(ncid, varid, 0, NULL, NULL, &id) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+         free(data[t][x].name);
+   FINAL_RESULTS;
+}
@@ -0,0 +1,118 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test type conversion of reads and writes large enough to be
+   converted in blocks, through the file's reusable conversion
+   buffer.
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <nc_tests.h>
+#include "netcdf.h"
+
+#define FILE_NAME "tst_converts3.nc"
+#define BLOCK_SIZE (4 * 1048576) /* NC4_CONVERT_BLOCK_SIZE */
+#define NY 3000
+#define NX 1000
+#define NROWS 3
+#define ROW_LEN 1100000
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing netcdf-4 conversion in blocks.\n");
+   printf("*** testing many rows in each block...");
+   {
+      int ncid, dimids[2], varid;
+      size_t start[2] = {5, 3}, count[2] = {NY - 10, NX - 7};
+      double *ddata;
+      int *idata;
+      nc_memory_usage_t usage;
+      size_t i, j;
+
+      if (!(ddata = malloc(NY * NX * sizeof(double)))) ERR;
+      if (!(idata = malloc(NY * NX * sizeof(int)))) ERR;
+      for (i = 0; i < NY * NX; i++)
+	 ddata[i] = (double)(i % 30000);
+
+      /* A short var of 6 MB, written from doubles. */
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "y", NY, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "data", NC_SHORT, 2, dimids, &varid)) ERR;
+      if (nc_put_var_double(ncid, varid, ddata)) ERR;
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.io_buffers == 0 || usage.io_buffers > BLOCK_SIZE) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_var_int(ncid, varid, idata)) ERR;
+      for (i = 0; i < NY * NX; i++)
+	 if (idata[i] != (int)(i % 30000)) ERR;
+
+      /* A hyperslab that does not start at the origin. */
+      if (nc_get_vara_int(ncid, varid, start, count, idata)) ERR;
+      for (i = 0; i < count[0]; i++)
+	 for (j = 0; j < count[1]; j++)
+	    if (idata[i * count[1] + j] !=
+		(int)(((start[0] + i) * NX + start[1] + j) % 30000)) ERR;
+
+      /* The buffer is reused, and never grows beyond one block. */
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.io_buffers == 0 || usage.io_buffers > BLOCK_SIZE) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* A range error in the last block is reported, and the rest of
+       * the data is still written. */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      ddata[NY * NX - 1] = 1.0e6;
+      if (nc_put_var_double(ncid, varid, ddata) != NC_ERANGE) ERR;
+      if (nc_get_var_int(ncid, varid, idata)) ERR;
+      for (i = 0; i < NY * NX - 1; i++)
+	 if (idata[i] != (int)(i % 30000)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      free(ddata);
+      free(idata);
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing rows larger than a block...");
+   {
+      int ncid, dimids[2], varid;
+      size_t start[2] = {1, 7}, count[2] = {NROWS - 1, ROW_LEN - 10};
+      float *fdata;
+      double *ddata;
+      size_t i, j;
+
+      if (!(fdata = malloc(NROWS * ROW_LEN * sizeof(float)))) ERR;
+      if (!(ddata = malloc(NROWS * ROW_LEN * sizeof(double)))) ERR;
+      for (i = 0; i < NROWS * ROW_LEN; i++)
+	 fdata[i] = (float)i;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "row", NROWS, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", ROW_LEN, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "data", NC_DOUBLE, 2, dimids, &varid)) ERR;
+      if (nc_put_var_float(ncid, varid, fdata)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_vara_float(ncid, varid, start, count, fdata)) ERR;
+      for (i = 0; i < count[0]; i++)
+	 for (j = 0; j < count[1]; j++)
+	    if (fdata[i * count[1] + j] !=
+		(float)((start[0] + i) * ROW_LEN + start[1] + j)) ERR;
+      if (nc_get_var_double(ncid, varid, ddata)) ERR;
+      for (i = 0; i < NROWS * ROW_LEN; i++)
+	 if (ddata[i] != (double)(float)i) ERR;
+      if (nc_close(ncid)) ERR;
+
+      free(fdata);
+      free(ddata);
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
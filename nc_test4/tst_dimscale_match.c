@@ -0,0 +1,129 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test that the dims of vars are found when a file is opened, from the
+   dimids the library records, and from the dimscales attached to the
+   vars when those records are missing or can't be trusted.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include <hdf5.h>
+
+#define FILE_NAME "tst_dimscale_match.nc"
+#define NX 4
+#define NY 3
+
+/* Check the dims of each var, by name. */
+static int
+check_file(int extra)
+{
+   int ncid, grpid, subid, varid, ndims, natts, dimids[3];
+   int timeid, xid, yid;
+
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR_RET;
+   if (nc_inq_dimid(ncid, "time", &timeid)) ERR_RET;
+   if (nc_inq_dimid(ncid, "x", &xid)) ERR_RET;
+   if (nc_inq_ncid(ncid, "g", &grpid)) ERR_RET;
+   if (nc_inq_ncid(grpid, "sub", &subid)) ERR_RET;
+   if (nc_inq_dimid(grpid, "y", &yid)) ERR_RET;
+
+   if (nc_inq_varid(ncid, "u", &varid)) ERR_RET;
+   if (nc_inq_var(ncid, varid, NULL, NULL, &ndims, dimids, &natts)) ERR_RET;
+   if (ndims != 2 || dimids[0] != xid || dimids[1] != timeid || natts) ERR_RET;
+
+   if (nc_inq_varid(grpid, "v", &varid)) ERR_RET;
+   if (nc_inq_var(grpid, varid, NULL, NULL, &ndims, dimids, &natts)) ERR_RET;
+   if (ndims != 3 || dimids[0] != timeid || dimids[1] != yid ||
+       dimids[2] != xid || natts != 1) ERR_RET;
+
+   if (nc_inq_varid(subid, "s", &varid)) ERR_RET;
+   if (nc_inq_var(subid, varid, NULL, NULL, &ndims, dimids, &natts)) ERR_RET;
+   if (ndims != 2 || dimids[0] != yid || dimids[1] != xid) ERR_RET;
+
+   if (extra)
+   {
+      if (nc_inq_varid(subid, "extra", &varid)) ERR_RET;
+      if (nc_inq_var(subid, varid, NULL, NULL, &ndims, dimids, NULL)) ERR_RET;
+      if (ndims != 2 || dimids[0] != timeid || dimids[1] != yid) ERR_RET;
+   }
+   if (nc_close(ncid)) ERR_RET;
+   return 0;
+}
+
+/* Delete an attribute of a dataset, with HDF5. */
+static int
+delete_att(const char *dataset, const char *att_name)
+{
+   hid_t fileid, datasetid;
+
+   if ((fileid = H5Fopen(FILE_NAME, H5F_ACC_RDWR, H5P_DEFAULT)) < 0) ERR_RET;
+   if ((datasetid = H5Dopen2(fileid, dataset, H5P_DEFAULT)) < 0) ERR_RET;
+   if (H5Adelete(datasetid, att_name) < 0) ERR_RET;
+   if (H5Dclose(datasetid) < 0) ERR_RET;
+   if (H5Fclose(fileid) < 0) ERR_RET;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing matching of vars with their dims on open.\n");
+   printf("*** testing file written by netCDF...");
+   {
+      int ncid, grpid, subid, varid, dimids[3];
+      int timeid, xid, yid;
+      char units[] = "m";
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "time", NC_UNLIMITED, &timeid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &xid)) ERR;
+      if (nc_def_grp(ncid, "g", &grpid)) ERR;
+      if (nc_def_grp(grpid, "sub", &subid)) ERR;
+      if (nc_def_dim(grpid, "y", NY, &yid)) ERR;
+
+      /* The dims of vars are in any order, and in parent groups. */
+      dimids[0] = xid;
+      dimids[1] = timeid;
+      if (nc_def_var(ncid, "u", NC_FLOAT, 2, dimids, &varid)) ERR;
+      if (nc_def_var(ncid, "x", NC_FLOAT, 1, &xid, &varid)) ERR;
+      dimids[0] = timeid;
+      dimids[1] = yid;
+      dimids[2] = xid;
+      if (nc_def_var(grpid, "v", NC_FLOAT, 3, dimids, &varid)) ERR;
+      if (nc_put_att_text(grpid, varid, "units", 1, units)) ERR;
+      if (nc_def_var(subid, "s", NC_FLOAT, 2, &dimids[1], &varid)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (check_file(0)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing file without recorded dimids...");
+   {
+      /* Without the dimid of a dim, the vars that use it are matched
+       * through their dimscales. */
+      if (delete_att("/g/y", "_Netcdf4Dimid")) ERR;
+      if (check_file(0)) ERR;
+
+      /* So is a var without recorded dimids, as older versions of the
+       * library wrote. */
+      if (delete_att("/g/sub/s", "_Netcdf4Coordinates")) ERR;
+      if (check_file(0)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing vars added to an existing file...");
+   {
+      int ncid, grpid, subid, varid, dimids[2];
+
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_inq_ncid(ncid, "g", &grpid)) ERR;
+      if (nc_inq_ncid(grpid, "sub", &subid)) ERR;
+      if (nc_inq_dimid(ncid, "time", &dimids[0])) ERR;
+      if (nc_inq_dimid(grpid, "y", &dimids[1])) ERR;
+      if (nc_def_var(subid, "extra", NC_INT, 2, dimids, &varid)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (check_file(1)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
@@ -0,0 +1,236 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the settings of how HDF5 lays out, and caches, the metadata
+   of netCDF-4 files: nc_set_meta_block_size(), nc_set_page_strategy(),
+   nc_set_alignment() and nc_set_metadata_cache(), and their
+   environment variables.
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <nc_tests.h>
+#include <hdf5.h>
+
+#define FILE_NAME "tst_file_layout.nc"
+#define FILE_NAME_PLAIN "tst_file_layout_plain.nc"
+#define FILE_NAME_DEFAULT "tst_file_layout_default.nc"
+#define NVARS 20
+#define NX 1000
+#define PAGE_SIZE 4096
+#define PAGE_BUFFER (64 * 1024)
+#define ALIGNMENT (64 * 1024)
+#define ALIGN_THRESHOLD 4096
+#define META_BLOCK (16 * 1024)
+#define CACHE_SIZE (4 * 1024 * 1024)
+
+/* HDF5 1.10.1 added files of pages; HDF5 before 1.14 has no page
+ * buffer netCDF will use. */
+#if H5_VERSION_GE(1,10,1)
+#define PAGED 1
+#endif
+#if H5_VERSION_GE(1,14,0)
+#define PAGE_BUFFERED 1
+#endif
+
+/* Write NVARS vars of doubles, each in its own group. */
+static int
+write_file(const char *name)
+{
+   int ncid, grpid, dimid, varid, g, x;
+   double data[NX];
+   char grp_name[NC_MAX_NAME + 1];
+
+   if (nc_create(name, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+   if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+   for (g = 0; g < NVARS; g++)
+   {
+      snprintf(grp_name, sizeof(grp_name), "g%d", g);
+      if (nc_def_grp(ncid, grp_name, &grpid)) ERR;
+      if (nc_def_var(grpid, "v", NC_DOUBLE, 1, &dimid, &varid)) ERR;
+      if (nc_def_var_chunking(grpid, varid, NC_CONTIGUOUS, NULL)) ERR;
+      if (nc_put_att_int(grpid, varid, "g", NC_INT, 1, &g)) ERR;
+   }
+   if (nc_enddef(ncid)) ERR;
+   for (g = 0; g < NVARS; g++)
+   {
+      snprintf(grp_name, sizeof(grp_name), "g%d", g);
+      if (nc_inq_grp_ncid(ncid, grp_name, &grpid)) ERR;
+      for (x = 0; x < NX; x++)
+         data[x] = g * NX + x;
+      if (nc_put_var_double(grpid, 0, data)) ERR;
+   }
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+/* Read the file back, and change one value. */
+static int
+check_file(const char *name)
+{
+   int ncid, grpid, g, g_in, x;
+   double data[NX];
+   char grp_name[NC_MAX_NAME + 1];
+   size_t index = 0;
+
+   if (nc_open(name, NC_WRITE, &ncid)) ERR;
+   for (g = 0; g < NVARS; g++)
+   {
+      snprintf(grp_name, sizeof(grp_name), "g%d", g);
+      if (nc_inq_grp_ncid(ncid, grp_name, &grpid)) ERR;
+      if (nc_get_att_int(grpid, 0, "g", &g_in)) ERR;
+      if (g_in != g) ERR;
+      if (nc_get_var_double(grpid, 0, data)) ERR;
+      for (x = 0; x < NX; x++)
+         if (data[x] != g * NX + x) ERR;
+   }
+   if (nc_put_var1_double(grpid, 0, &index, data)) ERR;
+   if (nc_close(ncid)) ERR;
+   return 0;
+}
+
+/* Check with HDF5 that a file is of pages of PAGE_SIZE bytes, or not,
+ * and that its vars start at multiples of alignment, or, with an
+ * alignment of zero, that they do not all start at multiples of
+ * ALIGNMENT. */
+static int
+check_layout(const char *name, int paged, hsize_t alignment)
+{
+   hid_t fileid, fcplid, datasetid;
+   haddr_t offset;
+   char var_name[NC_MAX_NAME + 1];
+   int g, unaligned = 0;
+#ifdef PAGED
+   H5F_fspace_strategy_t strategy;
+   hbool_t persist;
+   hsize_t threshold, page_size;
+#endif
+
+   if ((fileid = H5Fopen(name, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0) ERR;
+   if ((fcplid = H5Fget_create_plist(fileid)) < 0) ERR;
+#ifdef PAGED
+   if (H5Pget_file_space_strategy(fcplid, &strategy, &persist, &threshold) < 0) ERR;
+   if ((strategy == H5F_FSPACE_STRATEGY_PAGE) != paged) ERR;
+   if (paged)
+   {
+      if (!persist) ERR;
+      if (H5Pget_file_space_page_size(fcplid, &page_size) < 0) ERR;
+      if (page_size != PAGE_SIZE) ERR;
+   }
+#endif
+   for (g = 0; g < NVARS; g++)
+   {
+      snprintf(var_name, sizeof(var_name), "g%d/v", g);
+      if ((datasetid = H5Dopen2(fileid, var_name, H5P_DEFAULT)) < 0) ERR;
+      if ((offset = H5Dget_offset(datasetid)) == HADDR_UNDEF) ERR;
+      if (alignment && offset % alignment) ERR;
+      if (offset % ALIGNMENT)
+         unaligned++;
+      if (H5Dclose(datasetid) < 0) ERR;
+   }
+   if (!alignment && !unaligned) ERR;
+   if (H5Pclose(fcplid) < 0 || H5Fclose(fileid) < 0) ERR;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing file layout settings.\n");
+   printf("*** testing settings from the environment...");
+   {
+      size_t size, size2;
+
+      /* The environment is read once, at the first call. */
+      setenv("NETCDF_META_BLOCK_SIZE", "8192", 1);
+      setenv("NETCDF_ALIGNMENT", "4096", 1);
+      setenv("NETCDF_METADATA_CACHE_SIZE", "not a size", 1);
+      if (nc_get_meta_block_size(&size)) ERR;
+      if (size != 8192) ERR;
+      if (nc_get_alignment(&size, &size2)) ERR;
+      if (size != 4096 || size2 != 4096) ERR;
+      if (nc_get_metadata_cache(&size)) ERR;
+      if (size) ERR;
+      setenv("NETCDF_META_BLOCK_SIZE", "0", 1);
+      if (nc_get_meta_block_size(&size)) ERR;
+      if (size != 8192) ERR;
+      unsetenv("NETCDF_META_BLOCK_SIZE");
+      unsetenv("NETCDF_ALIGNMENT");
+      unsetenv("NETCDF_METADATA_CACHE_SIZE");
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing setting and getting...");
+   {
+      size_t size, size2;
+
+      if (nc_set_meta_block_size(META_BLOCK)) ERR;
+      if (nc_get_meta_block_size(&size)) ERR;
+      if (size != META_BLOCK) ERR;
+      if (nc_set_alignment(1024, 0)) ERR;
+      if (nc_get_alignment(&size, &size2)) ERR;
+      if (size || size2) ERR;
+      if (nc_set_alignment(ALIGN_THRESHOLD, ALIGNMENT)) ERR;
+      if (nc_get_alignment(&size, &size2)) ERR;
+      if (size != ALIGN_THRESHOLD || size2 != ALIGNMENT) ERR;
+      if (nc_set_metadata_cache(100) != NC_EINVAL) ERR;
+      if (nc_set_metadata_cache(CACHE_SIZE)) ERR;
+      if (nc_get_metadata_cache(&size)) ERR;
+      if (size != CACHE_SIZE) ERR;
+      if (nc_set_page_strategy(100, 0) != NC_EINVAL) ERR;
+      if (nc_set_page_strategy(PAGE_SIZE, 100) != NC_EINVAL) ERR;
+#ifdef PAGE_BUFFERED
+      if (nc_set_page_strategy(PAGE_SIZE, PAGE_BUFFER)) ERR;
+      if (nc_get_page_strategy(&size, &size2)) ERR;
+      if (size != PAGE_SIZE || size2 != PAGE_BUFFER) ERR;
+#else
+      if (nc_set_page_strategy(PAGE_SIZE, PAGE_BUFFER) != NC_ENOTBUILT) ERR;
+#ifdef PAGED
+      if (nc_set_page_strategy(PAGE_SIZE, 0)) ERR;
+      if (nc_get_page_strategy(&size, &size2)) ERR;
+      if (size != PAGE_SIZE || size2) ERR;
+#else
+      if (nc_set_page_strategy(PAGE_SIZE, 0) != NC_ENOTBUILT) ERR;
+#endif
+#endif
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing a file of pages with aligned vars...");
+   {
+      if (write_file(FILE_NAME)) ERR;
+#ifdef PAGED
+      /* Files of pages align vars to their pages instead. */
+      if (check_layout(FILE_NAME, 1, PAGE_SIZE)) ERR;
+#else
+      if (check_layout(FILE_NAME, 0, ALIGNMENT)) ERR;
+#endif
+
+      /* Open it again through the page buffer. */
+      if (check_file(FILE_NAME)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing a page buffer with a file not of pages...");
+   {
+      size_t size;
+
+      /* The page buffer is only used with files of pages. */
+      if (nc_get_page_strategy(NULL, &size)) ERR;
+      if (nc_set_page_strategy(0, size)) ERR;
+      if (write_file(FILE_NAME_PLAIN)) ERR;
+      if (check_layout(FILE_NAME_PLAIN, 0, ALIGNMENT)) ERR;
+      if (check_file(FILE_NAME_PLAIN)) ERR;
+      if (check_file(FILE_NAME)) ERR;
+
+      /* Back to HDF5's defaults. */
+      if (nc_set_page_strategy(0, 0)) ERR;
+      if (nc_set_alignment(0, 0)) ERR;
+      if (nc_set_meta_block_size(0)) ERR;
+      if (nc_set_metadata_cache(0)) ERR;
+      if (write_file(FILE_NAME_DEFAULT)) ERR;
+      if (check_layout(FILE_NAME_DEFAULT, 0, 0)) ERR;
+      if (check_file(FILE_NAME)) ERR;
+      if (check_file(FILE_NAME_PLAIN)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
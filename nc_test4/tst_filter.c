@@ -0,0 +1,191 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the filters of vars, set with nc_def_var_filter(), and the LZ4
+   filter built into the library.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_filter.nc"
+#define FILE_NAME2 "tst_filter2.nc"
+#define NT 16
+#define NX 1000
+#define NVARS 5
+#define BAD_FILTER 40000
+
+static const char *var_name[NVARS] = {"fast", "small", "blocks", "zlib", "noise"};
+
+/* LZ4 at levels 0 and 9, in 1000 byte blocks, then deflate, which
+ * nc_def_var_filter() passes on to nc_def_var_deflate(). */
+static unsigned int var_id[NVARS] = {NC_FILTER_LZ4, NC_FILTER_LZ4,
+                                     NC_FILTER_LZ4, 1, NC_FILTER_LZ4};
+static size_t var_nparams[NVARS] = {0, 2, 1, 1, 0};
+static unsigned int var_params[NVARS][2] = {{0, 0}, {0, 9}, {1000, 0},
+                                            {4, 0}, {0, 0}};
+
+/* Check the filter of each var, and the data in it. */
+static int
+check_file(int ncid, int (*data)[NT][NX])
+{
+   int data_in[NT][NX];
+   unsigned int id, params[2];
+   size_t nparams, chunk_start[2] = {0, 0}, size;
+   int varid, deflate, level, t, x;
+
+   for (varid = 0; varid < NVARS; varid++)
+   {
+      if (nc_inq_var_filter(ncid, varid, &id, &nparams, NULL)) ERR_RET;
+      if (varid == 3)
+      {
+         if (id || nparams) ERR_RET;
+         if (nc_inq_var_deflate(ncid, varid, NULL, &deflate, &level)) ERR_RET;
+         if (!deflate || level != 4) ERR_RET;
+      }
+      else
+      {
+         if (id != var_id[varid] || nparams != var_nparams[varid]) ERR_RET;
+         if (nc_inq_var_filter(ncid, varid, NULL, NULL, params)) ERR_RET;
+         if (nparams && memcmp(params, var_params[varid],
+                               nparams * sizeof(unsigned int))) ERR_RET;
+      }
+
+      if (nc_get_var_int(ncid, varid, &data_in[0][0])) ERR_RET;
+      for (t = 0; t < NT; t++)
+         for (x = 0; x < NX; x++)
+            if (data_in[t][x] != data[varid == 4][t][x]) ERR_RET;
+
+      /* All but the noise compress. */
+      if (nc_get_chunk_raw(ncid, varid, chunk_start, NULL, &size, NULL)) ERR_RET;
+      if (varid == 4 ? size < NT * NX * sizeof(int) :
+          size > NT * NX * sizeof(int) / 4) ERR_RET;
+   }
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   static int data[2][NT][NX];
+   unsigned int seed = 12345;
+   int t, x;
+
+   /* Smooth data with runs, and noise. */
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+      {
+         data[0][t][x] = t * 100 + (x / 7) % 50;
+         seed = seed * 1103515245 + 12345;
+         data[1][t][x] = (int)seed;
+      }
+
+   printf("\n*** Testing var filters.\n");
+   printf("*** testing LZ4 filter...");
+   {
+      int ncid, dimids[2], varid, flag;
+      size_t chunks[2] = {NT, NX};
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "t", NT, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      for (varid = 0; varid < NVARS; varid++)
+      {
+         if (nc_def_var(ncid, var_name[varid], NC_INT, 2, dimids, &varid)) ERR;
+         if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+         if (nc_def_var_filter(ncid, varid, var_id[varid], var_nparams[varid],
+                               var_params[varid])) ERR;
+      }
+      if (nc_set_metadata_index(ncid, 1, &flag)) ERR;
+      for (varid = 0; varid < NVARS; varid++)
+         if (nc_put_var_int(ncid, varid, &data[varid == 4][0][0])) ERR;
+      if (check_file(ncid, data)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* Read it back, with and without the metadata index. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, NULL, &flag)) ERR;
+      if (!flag) ERR;
+      if (check_file(ncid, data)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (check_file(ncid, data)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing copy of filtered vars...");
+   {
+      int ncid_in, ncid_out, dimids[2], varid, data_in[NT][NX];
+      unsigned int id;
+
+      /* The copies get the storage of any new var, without the
+       * filters. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid_in)) ERR;
+      if (nc_create(FILE_NAME2, NC_NETCDF4|NC_CLOBBER, &ncid_out)) ERR;
+      if (nc_def_dim(ncid_out, "t", NT, &dimids[0])) ERR;
+      if (nc_def_dim(ncid_out, "x", NX, &dimids[1])) ERR;
+      for (varid = 0; varid < NVARS; varid++)
+         if (nc_copy_var(ncid_in, varid, ncid_out)) ERR;
+      if (nc_close(ncid_out)) ERR;
+      if (nc_close(ncid_in)) ERR;
+      if (nc_open(FILE_NAME2, NC_NOWRITE, &ncid_out)) ERR;
+      for (varid = 0; varid < NVARS; varid++)
+      {
+         if (nc_inq_var_filter(ncid_out, varid, &id, NULL, NULL)) ERR;
+         if (id) ERR;
+         if (nc_get_var_int(ncid_out, varid, &data_in[0][0])) ERR;
+         for (t = 0; t < NT; t++)
+            for (x = 0; x < NX; x++)
+               if (data_in[t][x] != data[varid == 4][t][x]) ERR;
+      }
+      if (nc_close(ncid_out)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing bad filters...");
+   {
+      int ncid, dimid, varid, scalarid, contigid, contig;
+      unsigned int id, params[1] = {4};
+      size_t nparams;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+      if (nc_def_var(ncid, "v", NC_INT, 1, &dimid, &varid)) ERR;
+      if (nc_def_var(ncid, "s", NC_INT, 0, NULL, &scalarid)) ERR;
+      if (nc_def_var(ncid, "c", NC_INT, 1, &dimid, &contigid)) ERR;
+      if (nc_def_var_chunking(ncid, contigid, NC_CONTIGUOUS, NULL)) ERR;
+
+      if (nc_def_var_filter(ncid, varid, BAD_FILTER, 0, NULL) != NC_EFILTER) ERR;
+      if (nc_def_var_filter(ncid, varid, NC_FILTER_LZ4, 1, NULL) != NC_EINVAL) ERR;
+      if (nc_def_var_filter(ncid, varid, 1, 0, NULL) != NC_EINVAL) ERR;
+      if (nc_def_var_filter(ncid, varid + 5, NC_FILTER_LZ4, 0, NULL) != NC_ENOTVAR) ERR;
+
+      /* Filters need chunks, so scalars are left alone, and
+       * contiguous vars become chunked. */
+      if (nc_def_var_filter(ncid, scalarid, NC_FILTER_LZ4, 0, NULL)) ERR;
+      if (nc_inq_var_filter(ncid, scalarid, &id, NULL, NULL)) ERR;
+      if (id) ERR;
+      if (nc_def_var_filter(ncid, contigid, NC_FILTER_LZ4, 0, NULL)) ERR;
+      if (nc_inq_var_chunking(ncid, contigid, &contig, NULL)) ERR;
+      if (contig != NC_CHUNKED) ERR;
+      if (nc_def_var_chunking(ncid, contigid, NC_CONTIGUOUS, NULL) != NC_EINVAL) ERR;
+
+      /* A filter can be replaced, and removed. */
+      if (nc_def_var_filter(ncid, varid, NC_FILTER_LZ4, 1, params)) ERR;
+      if (nc_def_var_filter(ncid, varid, 0, 0, NULL)) ERR;
+      if (nc_inq_var_filter(ncid, varid, &id, &nparams, NULL)) ERR;
+      if (id || nparams) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_def_var_filter(ncid, varid, NC_FILTER_LZ4, 0, NULL) != NC_ELATEDEF) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_create(FILE_NAME, NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+      if (nc_def_var(ncid, "v", NC_INT, 1, &dimid, &varid)) ERR;
+      if (nc_def_var_filter(ncid, varid, NC_FILTER_LZ4, 0, NULL) != NC_ENOTNC4) ERR;
+      if (nc_inq_var_filter(ncid, varid, &id, NULL, NULL) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
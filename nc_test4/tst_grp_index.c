@@ -0,0 +1,121 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test that groups and types are found by id and full name in a file
+   with many groups, as groups are defined and renamed.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_grp_index.nc"
+#define NGRPS 300
+#define NTYPES 10
+
+/* Check that the first ngrps groups, and their children, are found
+ * by full name, and hold the right values in their vars. */
+static int
+check_grps(int ncid, int ngrps, int renamed)
+{
+   char name[NC_MAX_NAME * 3];
+   int g, grpid, grpid2, childid, varid, val;
+
+   for (g = 0; g < ngrps; g++)
+   {
+      if (g == renamed)
+	 sprintf(name, "/renamed");
+      else
+	 sprintf(name, "/g%d", g);
+      if (nc_inq_grp_full_ncid(ncid, name, &grpid)) ERR_RET;
+      strcat(name, "/child");
+      if (nc_inq_grp_full_ncid(ncid, name, &grpid2)) ERR_RET;
+      if (nc_inq_ncid(grpid, "child", &childid)) ERR_RET;
+      if (childid != grpid2) ERR_RET;
+      if (nc_inq_varid(grpid2, "v", &varid)) ERR_RET;
+      if (nc_get_var_int(grpid2, varid, &val)) ERR_RET;
+      if (val != g) ERR_RET;
+   }
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing lookups of groups and types by id and name.\n");
+   printf("*** testing groups by full name...");
+   {
+      char name[NC_MAX_NAME + 1];
+      int ncid, grpid, childid, varid, g, id, id2;
+      nc_type typeids[NTYPES], typeid1;
+      size_t size;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      for (g = 0; g < NGRPS; g++)
+      {
+	 sprintf(name, "g%d", g);
+	 if (nc_def_grp(ncid, name, &grpid)) ERR;
+	 if (nc_def_grp(grpid, "child", &childid)) ERR;
+	 if (nc_def_var(childid, "v", NC_INT, 0, NULL, &varid)) ERR;
+	 if (nc_put_var_int(childid, varid, &g)) ERR;
+	 if (g % (NGRPS / NTYPES) == 0)
+	 {
+	    sprintf(name, "t%d", g);
+	    if (nc_def_opaque(childid, (size_t)g + 1, name,
+			      &typeids[g / (NGRPS / NTYPES)])) ERR;
+	 }
+
+	 /* Groups defined after a lookup by name are found too. */
+	 if (g % 50 == 0 && check_grps(ncid, g + 1, -1)) ERR;
+      }
+      if (check_grps(ncid, NGRPS, -1)) ERR;
+
+      /* Extra slashes are ignored, names below a group are relative
+       * to it, and "/" is only the root group. */
+      if (nc_inq_grp_full_ncid(ncid, "//g7//child/", &id)) ERR;
+      if (nc_inq_grp_full_ncid(ncid, "/g7", &grpid)) ERR;
+      if (nc_inq_grp_full_ncid(grpid, "child", &id2)) ERR;
+      if (id != id2) ERR;
+      if (nc_inq_grp_full_ncid(ncid, "/", &id)) ERR;
+      if (id != ncid) ERR;
+      if (nc_inq_grp_full_ncid(grpid, "/", &id) != NC_ENOGRP) ERR;
+      if (nc_inq_grp_full_ncid(ncid, "/g7/nope", &id) != NC_ENOGRP) ERR;
+      if (nc_inq_grp_full_ncid(ncid, "/child", &id) != NC_ENOGRP) ERR;
+
+      /* After a rename, the old names are gone, and the new ones
+       * reach the group and its children. */
+      if (nc_rename_grp(grpid, "renamed")) ERR;
+      if (nc_inq_grp_full_ncid(ncid, "/g7/child", &id) != NC_ENOGRP) ERR;
+      if (check_grps(ncid, NGRPS, 7)) ERR;
+
+      /* Types are found by id, and by name from any group. */
+      for (g = 0; g < NTYPES; g++)
+      {
+	 sprintf(name, "t%d", g * (NGRPS / NTYPES));
+	 if (nc_inq_typeid(ncid, name, &typeid1)) ERR;
+	 if (typeid1 != typeids[g]) ERR;
+	 if (nc_inq_type(ncid, typeids[g], name, &size)) ERR;
+	 if (size != (size_t)(g * (NGRPS / NTYPES)) + 1) ERR;
+      }
+      if (nc_inq_typeid(ncid, "t1", &typeid1) != NC_EBADTYPE) ERR;
+      if (nc_inq_type(ncid, typeids[NTYPES - 1] + 1, name, &size) != NC_EBADTYPE) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* All of it holds when the file is read back. */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (check_grps(ncid, NGRPS, 7)) ERR;
+      for (g = 0; g < NTYPES; g++)
+      {
+	 sprintf(name, "t%d", g * (NGRPS / NTYPES));
+	 if (nc_inq_typeid(ncid, name, &typeid1)) ERR;
+	 if (nc_inq_type(ncid, typeid1, NULL, &size)) ERR;
+	 if (size != (size_t)(g * (NGRPS / NTYPES)) + 1) ERR;
+      }
+      if (nc_inq_grp_full_ncid(ncid, "/renamed", &grpid)) ERR;
+      if (nc_rename_grp(grpid, "g7")) ERR;
+      if (check_grps(ncid, NGRPS, -1)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
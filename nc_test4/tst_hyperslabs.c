@@ -0,0 +1,111 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test many small reads and writes of differing shapes on the same
+   netCDF-4 variables, which reuse the dataspaces cached for each
+   variable, including across changes to the extent of the dataset.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_hyperslabs.nc"
+#define NREC 12
+#define X_LEN 5
+
+/* The value at a point of the record variable. */
+#define VAL(r, x) ((r) * 100 + (x))
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing reads and writes of changing shapes.\n");
+   printf("*** testing appends interleaved with reads...");
+   {
+      int ncid, dimids[2], varid, scalarid;
+      size_t start[2], count[2], index[2], len;
+      int rec_out[X_LEN], data_in[NREC * X_LEN], val, scalar = 42;
+      int rec, x, r;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", X_LEN, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "data", NC_INT, 2, dimids, &varid)) ERR;
+      if (nc_def_var(ncid, "scalar", NC_INT, 0, NULL, &scalarid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+
+      for (rec = 0; rec < NREC; rec++)
+      {
+         /* Append a record, which extends the dataset. */
+         start[0] = rec;
+         start[1] = 0;
+         count[0] = 1;
+         count[1] = X_LEN;
+         for (x = 0; x < X_LEN; x++)
+            rec_out[x] = VAL(rec, x);
+         if (nc_put_vara_int(ncid, varid, start, count, rec_out)) ERR;
+
+         /* Read back single values, a block, and the whole var, so
+          * that the memory dataspace changes shape every time. */
+         index[0] = rec;
+         for (x = 0; x < X_LEN; x++)
+         {
+            index[1] = x;
+            if (nc_get_var1_int(ncid, varid, index, &val)) ERR;
+            if (val != VAL(rec, x)) ERR;
+         }
+         start[0] = rec / 2;
+         start[1] = 1;
+         count[0] = rec + 1 - rec / 2;
+         count[1] = X_LEN - 2;
+         if (nc_get_vara_int(ncid, varid, start, count, data_in)) ERR;
+         for (r = 0; r < count[0]; r++)
+            for (x = 0; x < count[1]; x++)
+               if (data_in[r * count[1] + x] != VAL(start[0] + r, start[1] + x)) ERR;
+         if (nc_get_var_int(ncid, varid, data_in)) ERR;
+         for (r = 0; r <= rec; r++)
+            for (x = 0; x < X_LEN; x++)
+               if (data_in[r * X_LEN + x] != VAL(r, x)) ERR;
+
+         /* An empty read does nothing. */
+         count[0] = 0;
+         if (nc_get_vara_int(ncid, varid, start, count, data_in)) ERR;
+
+         /* The scalar var has a dataspace of its own. */
+         if (nc_put_var_int(ncid, scalarid, &scalar)) ERR;
+         if (nc_get_var_int(ncid, scalarid, &val)) ERR;
+         if (val != scalar) ERR;
+      }
+
+      /* Reading past the end is still an error. */
+      index[0] = NREC;
+      index[1] = 0;
+      if (nc_get_var1_int(ncid, varid, index, &val) != NC_EINVALCOORDS) ERR;
+
+      /* Adding a var in define mode leaves the existing ones
+       * readable. */
+      if (nc_redef(ncid)) ERR;
+      if (nc_def_var(ncid, "more", NC_INT, 2, dimids, &r)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_get_var_int(ncid, varid, data_in)) ERR;
+      for (r = 0; r < NREC; r++)
+         for (x = 0; x < X_LEN; x++)
+            if (data_in[r * X_LEN + x] != VAL(r, x)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* Reopen and read a point at a time. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_dimlen(ncid, dimids[0], &len)) ERR;
+      if (len != NREC) ERR;
+      for (index[0] = 0; index[0] < NREC; index[0]++)
+         for (index[1] = 0; index[1] < X_LEN; index[1]++)
+         {
+            if (nc_get_var1_int(ncid, varid, index, &val)) ERR;
+            if (val != VAL(index[0], index[1])) ERR;
+         }
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
@@ -0,0 +1,415 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test the metadata index, which read-only opens build the metadata
+   of a file from, instead of reading every object in it.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include <hdf5.h>
+
+#define FILE_NAME "tst_metadata_index.nc"
+#define COPY_NAME "tst_metadata_index_copy.nc"
+#define NX 6
+#define NREC 3
+#define MAX_ATT_BYTES 64
+
+typedef struct
+{
+   int i;
+   double d;
+} pair_t;
+
+/* Check that an att is the same in two groups or vars. */
+static int
+compare_att(int ncid1, int ncid2, int varid, int a)
+{
+   char name[NC_MAX_NAME + 1];
+   nc_type xtype1, xtype2;
+   size_t len1, len2, size;
+   char buf1[MAX_ATT_BYTES], buf2[MAX_ATT_BYTES];
+   char *str1[4], *str2[4];
+   int i;
+
+   if (nc_inq_attname(ncid1, varid, a, name)) ERR_RET;
+   if (nc_inq_att(ncid1, varid, name, &xtype1, &len1)) ERR_RET;
+   if (nc_inq_att(ncid2, varid, name, &xtype2, &len2)) ERR_RET;
+   if (len1 != len2) ERR_RET;
+   if (xtype1 == NC_STRING)
+   {
+      if (xtype2 != NC_STRING || len1 > 4) ERR_RET;
+      if (nc_get_att_string(ncid1, varid, name, str1)) ERR_RET;
+      if (nc_get_att_string(ncid2, varid, name, str2)) ERR_RET;
+      for (i = 0; i < (int)len1; i++)
+	 if (strcmp(str1[i], str2[i])) ERR_RET;
+      if (nc_free_string(len1, str1)) ERR_RET;
+      if (nc_free_string(len2, str2)) ERR_RET;
+      return 0;
+   }
+   if (nc_inq_type(ncid1, xtype1, NULL, &size)) ERR_RET;
+   if (size * len1 > MAX_ATT_BYTES) ERR_RET;
+   memset(buf1, 0, sizeof(buf1));
+   memset(buf2, 0, sizeof(buf2));
+   if (nc_get_att(ncid1, varid, name, buf1)) ERR_RET;
+   if (nc_get_att(ncid2, varid, name, buf2)) ERR_RET;
+   if (memcmp(buf1, buf2, size * len1)) ERR_RET;
+   return 0;
+}
+
+/* Check that two groups, opened in different ways, have the same
+ * metadata. */
+static int
+compare_grp(int ncid1, int ncid2)
+{
+   int ndims1, ndims2, nvars1, nvars2, natts1, natts2, unlimdim1, unlimdim2;
+   int dimids1[NC_MAX_DIMS], dimids2[NC_MAX_DIMS];
+   int ntypes1, ntypes2, typeids1[NC_MAX_VARS], typeids2[NC_MAX_VARS];
+   int ngrps1, ngrps2, grpids1[NC_MAX_VARS], grpids2[NC_MAX_VARS];
+   char name1[NC_MAX_NAME + 1], name2[NC_MAX_NAME + 1];
+   size_t len1, len2;
+   int d, v, a, t, g;
+
+   if (nc_inq(ncid1, &ndims1, &nvars1, &natts1, &unlimdim1)) ERR_RET;
+   if (nc_inq(ncid2, &ndims2, &nvars2, &natts2, &unlimdim2)) ERR_RET;
+   if (ndims1 != ndims2 || nvars1 != nvars2 || natts1 != natts2 ||
+       unlimdim1 != unlimdim2) ERR_RET;
+
+   if (nc_inq_dimids(ncid1, &ndims1, dimids1, 0)) ERR_RET;
+   if (nc_inq_dimids(ncid2, &ndims2, dimids2, 0)) ERR_RET;
+   for (d = 0; d < ndims1; d++)
+   {
+      if (dimids1[d] != dimids2[d]) ERR_RET;
+      if (nc_inq_dim(ncid1, dimids1[d], name1, &len1)) ERR_RET;
+      if (nc_inq_dim(ncid2, dimids2[d], name2, &len2)) ERR_RET;
+      if (strcmp(name1, name2) || len1 != len2) ERR_RET;
+   }
+
+   if (nc_inq_typeids(ncid1, &ntypes1, typeids1)) ERR_RET;
+   if (nc_inq_typeids(ncid2, &ntypes2, typeids2)) ERR_RET;
+   if (ntypes1 != ntypes2) ERR_RET;
+   for (t = 0; t < ntypes1; t++)
+   {
+      size_t size1, size2, nfields1, nfields2;
+      nc_type base1, base2;
+      int class1, class2;
+
+      if (typeids1[t] != typeids2[t]) ERR_RET;
+      if (nc_inq_user_type(ncid1, typeids1[t], name1, &size1, &base1,
+			   &nfields1, &class1)) ERR_RET;
+      if (nc_inq_user_type(ncid2, typeids2[t], name2, &size2, &base2,
+			   &nfields2, &class2)) ERR_RET;
+      if (strcmp(name1, name2) || size1 != size2 || base1 != base2 ||
+	  nfields1 != nfields2 || class1 != class2) ERR_RET;
+   }
+
+   for (v = 0; v < nvars1; v++)
+   {
+      nc_type xtype1, xtype2;
+      int vdims1[NC_MAX_VAR_DIMS], vdims2[NC_MAX_VAR_DIMS];
+      int shuffle1, shuffle2, deflate1, deflate2, level1, level2;
+      int storage1, storage2, nofill1, nofill2, endian1, endian2;
+      int fletcher1, fletcher2;
+      size_t chunks1[NC_MAX_VAR_DIMS], chunks2[NC_MAX_VAR_DIMS];
+      char fill1[MAX_ATT_BYTES], fill2[MAX_ATT_BYTES];
+      size_t size;
+
+      if (nc_inq_var(ncid1, v, name1, &xtype1, &ndims1, vdims1, &natts1)) ERR_RET;
+      if (nc_inq_var(ncid2, v, name2, &xtype2, &ndims2, vdims2, &natts2)) ERR_RET;
+      if (strcmp(name1, name2) || xtype1 != xtype2 || ndims1 != ndims2 ||
+	  natts1 != natts2) ERR_RET;
+      for (d = 0; d < ndims1; d++)
+	 if (vdims1[d] != vdims2[d]) ERR_RET;
+
+      if (nc_inq_var_chunking(ncid1, v, &storage1, chunks1)) ERR_RET;
+      if (nc_inq_var_chunking(ncid2, v, &storage2, chunks2)) ERR_RET;
+      if (storage1 != storage2) ERR_RET;
+      if (storage1 == NC_CHUNKED)
+	 for (d = 0; d < ndims1; d++)
+	    if (chunks1[d] != chunks2[d]) ERR_RET;
+      if (nc_inq_var_deflate(ncid1, v, &shuffle1, &deflate1, &level1)) ERR_RET;
+      if (nc_inq_var_deflate(ncid2, v, &shuffle2, &deflate2, &level2)) ERR_RET;
+      if (shuffle1 != shuffle2 || deflate1 != deflate2 ||
+	  (deflate1 && level1 != level2)) ERR_RET;
+      if (nc_inq_var_fletcher32(ncid1, v, &fletcher1)) ERR_RET;
+      if (nc_inq_var_fletcher32(ncid2, v, &fletcher2)) ERR_RET;
+      if (fletcher1 != fletcher2) ERR_RET;
+      if (nc_inq_var_endian(ncid1, v, &endian1)) ERR_RET;
+      if (nc_inq_var_endian(ncid2, v, &endian2)) ERR_RET;
+      if (endian1 != endian2) ERR_RET;
+
+      if (xtype1 == NC_STRING)
+      {
+	 if (nc_inq_var_fill(ncid1, v, &nofill1, NULL)) ERR_RET;
+	 if (nc_inq_var_fill(ncid2, v, &nofill2, NULL)) ERR_RET;
+	 if (nofill1 != nofill2) ERR_RET;
+      }
+      else
+      {
+	 if (nc_inq_type(ncid1, xtype1, NULL, &size)) ERR_RET;
+	 if (size > MAX_ATT_BYTES) ERR_RET;
+	 memset(fill1, 0, sizeof(fill1));
+	 memset(fill2, 0, sizeof(fill2));
+	 if (nc_inq_var_fill(ncid1, v, &nofill1, fill1)) ERR_RET;
+	 if (nc_inq_var_fill(ncid2, v, &nofill2, fill2)) ERR_RET;
+	 if (nofill1 != nofill2 || memcmp(fill1, fill2, size)) ERR_RET;
+      }
+
+      for (a = 0; a < natts1; a++)
+	 if (compare_att(ncid1, ncid2, v, a)) ERR_RET;
+   }
+
+   for (a = 0; a < natts1; a++)
+      if (compare_att(ncid1, ncid2, NC_GLOBAL, a)) ERR_RET;
+
+   if (nc_inq_grps(ncid1, &ngrps1, grpids1)) ERR_RET;
+   if (nc_inq_grps(ncid2, &ngrps2, grpids2)) ERR_RET;
+   if (ngrps1 != ngrps2) ERR_RET;
+   for (g = 0; g < ngrps1; g++)
+   {
+      if (nc_inq_grpname(grpids1[g], name1)) ERR_RET;
+      if (nc_inq_grpname(grpids2[g], name2)) ERR_RET;
+      if (strcmp(name1, name2)) ERR_RET;
+      if (compare_grp(grpids1[g], grpids2[g])) ERR_RET;
+   }
+   return 0;
+}
+
+/* Copy the file, so it can be opened twice at once. */
+static int
+copy_file(void)
+{
+   FILE *in, *out;
+   char buf[4096];
+   size_t n;
+
+   if (!(in = fopen(FILE_NAME, "rb"))) ERR_RET;
+   if (!(out = fopen(COPY_NAME, "wb"))) ERR_RET;
+   while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+      if (fwrite(buf, 1, n, out) != n) ERR_RET;
+   if (fclose(in) || fclose(out)) ERR_RET;
+   return 0;
+}
+
+/* Open the file read-only, and check whether its metadata came from
+ * the index, and that it is the same as when a copy of the file is
+ * opened for writing, which always reads the objects in the file. */
+static int
+check_file(int expect_indexed)
+{
+   int ncid1, ncid2, opened;
+
+   if (copy_file()) ERR_RET;
+   if (nc_open(FILE_NAME, NC_NOWRITE, &ncid1)) ERR_RET;
+   if (nc_inq_metadata_index(ncid1, NULL, &opened)) ERR_RET;
+   if (opened != expect_indexed) ERR_RET;
+   if (nc_open(COPY_NAME, NC_WRITE, &ncid2)) ERR_RET;
+   if (nc_inq_metadata_index(ncid2, NULL, &opened)) ERR_RET;
+   if (opened) ERR_RET;
+   if (compare_grp(ncid1, ncid2)) ERR_RET;
+   if (nc_close(ncid2)) ERR_RET;
+   if (nc_close(ncid1)) ERR_RET;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   printf("\n*** Testing the metadata index.\n");
+   printf("*** testing file with index...");
+   {
+      int ncid, grpid, subid, varid, dimids[2], flag;
+      int timeid, xid, yid, pair_typeid, enum_typeid, opaque_typeid;
+      size_t chunks[2] = {1, NX}, start[2] = {0, 0}, count[2] = {NREC, NX};
+      float data[NREC][NX], data_in[NREC][NX], float_fill = -1.0f;
+      int ints[3] = {1, -2, 3}, y_in[NX], x, r;
+      char *strings[2] = {"one", "two"}, *string_fill = "none";
+      pair_t pair_fill = {-1, -1.0};
+      unsigned char opaque[4] = {1, 2, 3, 4};
+      signed char red = 0, green = 1;
+
+      for (r = 0; r < NREC; r++)
+	 for (x = 0; x < NX; x++)
+	    data[r][x] = (float)(r * NX + x);
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_set_metadata_index(ncid, 1, &flag)) ERR;
+      if (flag) ERR;
+      if (nc_def_dim(ncid, "time", NC_UNLIMITED, &timeid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &xid)) ERR;
+      if (nc_put_att_text(ncid, NC_GLOBAL, "title", 4, "test")) ERR;
+      if (nc_put_att_int(ncid, NC_GLOBAL, "ints", NC_INT, 3, ints)) ERR;
+      if (nc_put_att_string(ncid, NC_GLOBAL, "strings", 2, (const char **)strings)) ERR;
+
+      /* A coordinate var, and a chunked, filtered var with a fill
+       * value. */
+      if (nc_def_var(ncid, "x", NC_DOUBLE, 1, &xid, &varid)) ERR;
+      if (nc_put_att_text(ncid, varid, "units", 1, "m")) ERR;
+      dimids[0] = timeid;
+      dimids[1] = xid;
+      if (nc_def_var(ncid, "data", NC_FLOAT, 2, dimids, &varid)) ERR;
+      if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, varid, 1, 1, 4)) ERR;
+      if (nc_def_var_fletcher32(ncid, varid, NC_FLETCHER32)) ERR;
+      if (nc_def_var_endian(ncid, varid, NC_ENDIAN_BIG)) ERR;
+      if (nc_def_var_fill(ncid, varid, 0, &float_fill)) ERR;
+      if (nc_put_att_float(ncid, varid, "_FillValue", NC_FLOAT, 1, &float_fill)) ERR;
+
+      /* User types, and vars and atts of them, in a group. */
+      if (nc_def_grp(ncid, "g", &grpid)) ERR;
+      if (nc_def_grp(grpid, "sub", &subid)) ERR;
+      if (nc_def_compound(grpid, sizeof(pair_t), "pair", &pair_typeid)) ERR;
+      if (nc_insert_compound(grpid, pair_typeid, "i", NC_COMPOUND_OFFSET(pair_t, i),
+			     NC_INT)) ERR;
+      if (nc_insert_compound(grpid, pair_typeid, "d", NC_COMPOUND_OFFSET(pair_t, d),
+			     NC_DOUBLE)) ERR;
+      if (nc_def_enum(grpid, NC_BYTE, "color", &enum_typeid)) ERR;
+      if (nc_insert_enum(grpid, enum_typeid, "red", &red)) ERR;
+      if (nc_insert_enum(grpid, enum_typeid, "green", &green)) ERR;
+      if (nc_def_opaque(subid, 4, "blob", &opaque_typeid)) ERR;
+      if (nc_def_dim(grpid, "y", 2, &yid)) ERR;
+      if (nc_def_var(grpid, "pairs", pair_typeid, 1, &xid, &varid)) ERR;
+      if (nc_def_var_fill(grpid, varid, 0, &pair_fill)) ERR;
+      if (nc_put_att(grpid, varid, "pair", pair_typeid, 1, &pair_fill)) ERR;
+      if (nc_def_var(grpid, "names", NC_STRING, 1, &yid, &varid)) ERR;
+      if (nc_def_var_fill(grpid, varid, 0, &string_fill)) ERR;
+      if (nc_put_att(grpid, NC_GLOBAL, "color", enum_typeid, 1, &green)) ERR;
+
+      /* A var with the name of a dim it does not use. */
+      if (nc_def_var(grpid, "y", NC_INT, 1, &xid, &varid)) ERR;
+      if (nc_def_var(subid, "blobs", opaque_typeid, 1, &yid, &varid)) ERR;
+      if (nc_put_att(subid, varid, "blob", opaque_typeid, 1, opaque)) ERR;
+      if (nc_put_att_uchar(subid, NC_GLOBAL, "empty", NC_UBYTE, 0, NULL)) ERR;
+
+      if (nc_put_vara_float(ncid, 1, start, count, &data[0][0])) ERR;
+      if (nc_close(ncid)) ERR;
+      if (check_file(1)) ERR;
+
+      /* Data is read from datasets opened when it is first read. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_varid(ncid, "data", &varid)) ERR;
+      if (nc_get_var_float(ncid, varid, &data_in[0][0])) ERR;
+      for (r = 0; r < NREC; r++)
+	 for (x = 0; x < NX; x++)
+	    if (data_in[r][x] != data[r][x]) ERR;
+      if (nc_inq_ncid(ncid, "g", &grpid)) ERR;
+      if (nc_inq_varid(grpid, "y", &varid)) ERR;
+      if (nc_get_var_int(grpid, varid, y_in)) ERR;
+      if (nc_set_metadata_index(ncid, 0, NULL) != NC_EPERM) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing index kept up to date by writes...");
+   {
+      int ncid, varid, flag;
+      size_t start[2] = {NREC, 0}, count[2] = {1, NX};
+      float data[NX] = {1, 2, 3, 4, 5, 6};
+
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, &flag, NULL)) ERR;
+      if (!flag) ERR;
+      if (nc_inq_varid(ncid, "data", &varid)) ERR;
+      if (nc_put_vara_float(ncid, varid, start, count, data)) ERR;
+      if (nc_redef(ncid)) ERR;
+      if (nc_def_var(ncid, "more", NC_SHORT, 0, NULL, &varid)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (check_file(1)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing index of file changed by another program...");
+   {
+      hid_t fileid, grpid, gcpl_id;
+      int ncid, ngrps;
+
+      if ((fileid = H5Fopen(FILE_NAME, H5F_ACC_RDWR, H5P_DEFAULT)) < 0) ERR;
+      if ((gcpl_id = H5Pcreate(H5P_GROUP_CREATE)) < 0) ERR;
+      if (H5Pset_link_creation_order(gcpl_id, H5P_CRT_ORDER_TRACKED|
+				     H5P_CRT_ORDER_INDEXED) < 0) ERR;
+      if ((grpid = H5Gcreate2(fileid, "other", H5P_DEFAULT, gcpl_id,
+			      H5P_DEFAULT)) < 0) ERR;
+      if (H5Gclose(grpid) < 0) ERR;
+      if (H5Pclose(gcpl_id) < 0) ERR;
+      if (H5Fclose(fileid) < 0) ERR;
+      if (check_file(0)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_grps(ncid, &ngrps, NULL)) ERR;
+      if (ngrps != 2) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing index of file with a global att deleted by another program...");
+   {
+      hid_t fileid, grpid;
+      int ncid, flag, opened;
+      size_t len;
+
+      /* Bring the index up to date again. */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, &flag, &opened)) ERR;
+      if (!opened) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The file keeps its size, and the root group its links. */
+      if ((fileid = H5Fopen(FILE_NAME, H5F_ACC_RDWR, H5P_DEFAULT)) < 0) ERR;
+      if ((grpid = H5Gopen2(fileid, "/", H5P_DEFAULT)) < 0) ERR;
+      if (H5Adelete(grpid, "title") < 0) ERR;
+      if (H5Gclose(grpid) < 0 || H5Fclose(fileid) < 0) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, NULL, &opened)) ERR;
+      if (opened) ERR;
+      if (nc_inq_attlen(ncid, NC_GLOBAL, "title", &len) != NC_ENOTATT) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing index turned off...");
+   {
+      int ncid, flag;
+
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_set_metadata_index(ncid, 0, &flag)) ERR;
+      if (!flag) ERR;
+      if (nc_close(ncid)) ERR;
+      if (check_file(0)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing file that can't be indexed...");
+   {
+      int ncid, typeid, vlen_typeid, opened, format;
+      nc_vlen_t vlen;
+      int ints[2] = {1, 2};
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_set_metadata_index(ncid, 1, NULL)) ERR;
+      if (nc_def_vlen(ncid, "ints", NC_INT, &vlen_typeid)) ERR;
+      vlen.len = 2;
+      vlen.p = ints;
+      if (nc_put_att(ncid, NC_GLOBAL, "vlen", vlen_typeid, 1, &vlen)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, NULL, &opened)) ERR;
+      if (opened) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The classic model is kept by the index. */
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLASSIC_MODEL|NC_CLOBBER, &ncid)) ERR;
+      if (nc_set_metadata_index(ncid, 1, NULL)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &typeid)) ERR;
+      if (nc_close(ncid)) ERR;
+      if (check_file(1)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_format(ncid, &format)) ERR;
+      if (format != NC_FORMAT_NETCDF4_CLASSIC) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* Classic files have no index. */
+      if (nc_create(FILE_NAME, NC_CLOBBER, &ncid)) ERR;
+      if (nc_set_metadata_index(ncid, 1, NULL) != NC_ENOTNC4) ERR;
+      if (nc_inq_metadata_index(ncid, NULL, NULL) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
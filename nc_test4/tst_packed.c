@@ -0,0 +1,225 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test packed reads and writes of strings and vlens, with
+   nc_get_vara_packed() and nc_put_vara_packed().
+*/
+
+#include <config.h>
+#include <stdlib.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_packed.nc"
+#define FILE_NAME_CLASSIC "tst_packed_classic.nc"
+#define NT 4
+#define NX 6
+#define NT_MORE 6
+#define NLEN (NT * NX)
+#define MAX_STR 32
+
+/* Make the string of a value; some are empty. */
+static void
+make_str(char *s, int t, int x)
+{
+   if ((t + x) % 5 == 0)
+      s[0] = '\0';
+   else
+      snprintf(s, MAX_STR, "value %d at %d", x * 37 + t, t);
+}
+
+/* Pack the strings of a NT by NX hyperslab. */
+static size_t
+pack_strs(char *data, size_t *offsets)
+{
+   size_t total = 0;
+   int t, x;
+
+   for (t = 0; t < NT; t++)
+      for (x = 0; x < NX; x++)
+      {
+         offsets[t * NX + x] = total;
+         make_str(data + total, t, x);
+         total += strlen(data + total) + 1;
+      }
+   offsets[NLEN] = total;
+   return total;
+}
+
+int
+main(int argc, char **argv)
+{
+   static char packed[NLEN * MAX_STR];
+   static size_t offsets[NLEN + 1];
+
+   pack_strs(packed, offsets);
+
+   printf("\n*** Testing packed reads and writes.\n");
+   printf("*** testing packed strings...");
+   {
+      int ncid, dimids[2], varid, t, x;
+      size_t offsets_in[NT_MORE * NX + 1], start[2] = {1, 2}, count[2] = {2, 3};
+      size_t count_all[2] = {NT, NX}, count_more[2] = {NT_MORE, NX};
+      char *data_in, *strs_in[NLEN], s[MAX_STR];
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "t", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "names", NC_STRING, 2, dimids, &varid)) ERR;
+      if (nc_put_vara_packed(ncid, varid, NULL, count_all, offsets, packed)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* NULL start and count span the whole var, once written. */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_get_vara_packed(ncid, varid, NULL, NULL, offsets_in,
+                             (void **)&data_in)) ERR;
+      if (memcmp(offsets_in, offsets, sizeof(offsets))) ERR;
+      if (memcmp(data_in, packed, offsets[NLEN])) ERR;
+      if (nc_free_packed(data_in)) ERR;
+
+      /* The same strings as read one at a time. */
+      if (nc_get_var_string(ncid, varid, strs_in)) ERR;
+      for (t = 0; t < NLEN; t++)
+         if (strcmp(strs_in[t], packed + offsets[t])) ERR;
+      if (nc_free_string(NLEN, strs_in)) ERR;
+
+      /* A hyperslab. */
+      if (nc_get_vara_packed(ncid, varid, start, count, offsets_in,
+                             (void **)&data_in)) ERR;
+      if (offsets_in[0]) ERR;
+      for (t = 0; t < 2; t++)
+         for (x = 0; x < 3; x++)
+         {
+            make_str(s, t + 1, x + 2);
+            if (strcmp(data_in + offsets_in[t * 3 + x], s)) ERR;
+            if (offsets_in[t * 3 + x + 1] - offsets_in[t * 3 + x] !=
+                strlen(s) + 1) ERR;
+         }
+      if (nc_free_packed(data_in)) ERR;
+
+      /* Strings past the extent, and NULL strings written by
+       * nc_put_vara_string(), read as empty strings. */
+      strs_in[0] = NULL;
+      strs_in[1] = "last";
+      start[0] = NT_MORE - 1;
+      start[1] = 0;
+      count[0] = 1;
+      count[1] = 2;
+      if (nc_put_vara_string(ncid, varid, start, count,
+                             (const char **)strs_in)) ERR;
+      if (nc_get_vara_packed(ncid, varid, NULL, count_more, offsets_in,
+                             (void **)&data_in)) ERR;
+      for (t = 0; t < NT_MORE; t++)
+         for (x = 0; x < NX; x++)
+         {
+            if (t < NT)
+               make_str(s, t, x);
+            else
+               strcpy(s, t == NT_MORE - 1 && x == 1 ? "last" : "");
+            if (strcmp(data_in + offsets_in[t * NX + x], s)) ERR;
+         }
+      if (offsets_in[NT_MORE * NX] != offsets[NLEN] + NT_MORE * NX - NLEN +
+          strlen("last")) ERR;
+      if (nc_free_packed(data_in)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing packed vlens...");
+   {
+      int ncid, dimid, varid, i, j, data[NLEN * NLEN];
+      nc_type typeid;
+      nc_vlen_t vlens_in[NLEN];
+      size_t voffsets[NLEN + 1], offsets_in[NLEN + 1], total = 0;
+      size_t start = 3, count = 5;
+      int *data_in;
+
+      /* Vlen i holds i ints. */
+      for (i = 0; i < NLEN; i++)
+      {
+         voffsets[i] = total * sizeof(int);
+         for (j = 0; j < i; j++)
+            data[total++] = i * 1000 + j;
+      }
+      voffsets[NLEN] = total * sizeof(int);
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_vlen(ncid, "ints", NC_INT, &typeid)) ERR;
+      if (nc_def_dim(ncid, "i", NLEN, &dimid)) ERR;
+      if (nc_def_var(ncid, "v", typeid, 1, &dimid, &varid)) ERR;
+      if (nc_put_vara_packed(ncid, varid, NULL, NULL, voffsets, data)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_get_vara_packed(ncid, varid, NULL, NULL, offsets_in,
+                             (void **)&data_in)) ERR;
+      if (memcmp(offsets_in, voffsets, sizeof(voffsets))) ERR;
+      if (memcmp(data_in, data, voffsets[NLEN])) ERR;
+      if (nc_free_packed(data_in)) ERR;
+
+      /* The same vlens as read one at a time. */
+      if (nc_get_var(ncid, varid, vlens_in)) ERR;
+      for (i = 0; i < NLEN; i++)
+         if (vlens_in[i].len != (size_t)i ||
+             (i && memcmp(vlens_in[i].p, (char *)data + voffsets[i],
+                          (size_t)i * sizeof(int)))) ERR;
+      if (nc_free_vlens(NLEN, vlens_in)) ERR;
+
+      if (nc_get_vara_packed(ncid, varid, &start, &count, offsets_in,
+                             (void **)&data_in)) ERR;
+      if (offsets_in[count] != (voffsets[start + count] - voffsets[start])) ERR;
+      if (memcmp(data_in, (char *)data + voffsets[start], offsets_in[count])) ERR;
+      if (nc_free_packed(data_in)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing bad packed reads and writes...");
+   {
+      int ncid, dimid, varid, intid, vvid, vsid, data[2] = {1, 2};
+      nc_type vlen_int, vlen_str;
+      size_t bad_offsets[3] = {0, 3, 2}, count = 2, start = 5;
+      size_t odd_offsets[3] = {0, 4, 7}, offsets_in[3];
+      char *data_in, abc[6] = "ab\0cd";
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_vlen(ncid, "ints", NC_INT, &vlen_int)) ERR;
+      if (nc_def_vlen(ncid, "strs", NC_STRING, &vlen_str)) ERR;
+      if (nc_def_dim(ncid, "x", 2, &dimid)) ERR;
+      if (nc_def_var(ncid, "s", NC_STRING, 1, &dimid, &varid)) ERR;
+      if (nc_def_var(ncid, "i", NC_INT, 1, &dimid, &intid)) ERR;
+      if (nc_def_var(ncid, "vi", vlen_int, 1, &dimid, &vvid)) ERR;
+      if (nc_def_var(ncid, "vs", vlen_str, 1, &dimid, &vsid)) ERR;
+
+      /* Offsets out of order, and a string without its NUL. */
+      if (nc_put_vara_packed(ncid, varid, NULL, NULL, bad_offsets, abc) != NC_EINVAL) ERR;
+      odd_offsets[1] = 3;
+      odd_offsets[2] = 5;
+      if (nc_put_vara_packed(ncid, varid, NULL, NULL, odd_offsets, abc) != NC_EINVAL) ERR;
+      /* A vlen of ints of 7 bytes. */
+      odd_offsets[1] = 4;
+      odd_offsets[2] = 7;
+      if (nc_put_vara_packed(ncid, vvid, NULL, NULL, odd_offsets, data) != NC_EINVAL) ERR;
+      if (nc_put_vara_packed(ncid, varid, NULL, NULL, NULL, abc) != NC_EINVAL) ERR;
+      if (nc_get_vara_packed(ncid, varid, NULL, NULL, offsets_in, NULL) != NC_EINVAL) ERR;
+
+      /* Only strings, and vlens of fixed size types, can be packed. */
+      if (nc_get_vara_packed(ncid, intid, NULL, NULL, offsets_in,
+                             (void **)&data_in) != NC_EBADTYPE) ERR;
+      if (nc_put_vara_packed(ncid, vsid, NULL, NULL, odd_offsets, abc) != NC_EBADTYPE) ERR;
+      if (nc_get_vara_packed(ncid, varid + 10, NULL, NULL, offsets_in,
+                             (void **)&data_in) != NC_ENOTVAR) ERR;
+      if (nc_get_vara_packed(ncid, varid, &start, &count, offsets_in,
+                             (void **)&data_in) != NC_EINVALCOORDS) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_create(FILE_NAME_CLASSIC, NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", 2, &dimid)) ERR;
+      if (nc_def_var(ncid, "c", NC_CHAR, 1, &dimid, &varid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_get_vara_packed(ncid, varid, NULL, NULL, offsets_in,
+                             (void **)&data_in) != NC_ENOTNC4) ERR;
+      if (nc_put_vara_packed(ncid, varid, NULL, NULL, bad_offsets, abc) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
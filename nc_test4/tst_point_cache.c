@@ -0,0 +1,199 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test point reads of chunked netCDF-4 variables, which are served
+   from a per-file cache of decoded chunks.
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+
+#define FILE_NAME "tst_point_cache.nc"
+#define NY 30
+#define NX 25
+#define CHUNK_Y 8
+#define CHUNK_X 10
+#define NREC 20
+#define REC_LEN 3
+
+/* The value at a point of the short var. */
+#define VAL(y, x) ((short)((y) * 1000 + (x) - 15000))
+
+/* Read every point of the var one at a time, as shorts, and a tiny
+ * hyperslab as ints. */
+static int
+check_points(int ncid, int varid, int bump)
+{
+   size_t index[2], start[2], count[2] = {2, 3};
+   short val;
+   int ival[6], i;
+
+   for (index[0] = 0; index[0] < NY; index[0]++)
+      for (index[1] = 0; index[1] < NX; index[1]++)
+      {
+	 if (nc_get_var1_short(ncid, varid, index, &val)) ERR_RET;
+	 if (val != VAL(index[0], index[1]) + bump) ERR_RET;
+      }
+
+   /* A hyperslab within one edge chunk. */
+   start[0] = NY - 2;
+   start[1] = NX - 3;
+   if (nc_get_vara_int(ncid, varid, start, count, ival)) ERR_RET;
+   for (i = 0; i < 6; i++)
+      if (ival[i] != VAL(start[0] + i / 3, start[1] + i % 3) + bump) ERR_RET;
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   size_t default_size;
+
+   printf("\n*** Testing netcdf-4 point read cache.\n");
+   if (nc_get_point_cache(&default_size)) ERR;
+   printf("*** testing point reads of a deflated var...");
+   {
+      int ncid, dimids[2], varid;
+      size_t chunks[2] = {CHUNK_Y, CHUNK_X};
+      size_t index[2], start[2], count[2];
+      short data[NY][NX];
+      signed char bval;
+      double dval[4];
+      long long llval;
+      nc_memory_usage_t usage;
+      int x, y;
+
+      for (y = 0; y < NY; y++)
+	 for (x = 0; x < NX; x++)
+	    data[y][x] = VAL(y, x);
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "y", NY, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "data", NC_SHORT, 2, dimids, &varid)) ERR;
+      if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, varid, 0, 1, 1)) ERR;
+      if (nc_put_var_short(ncid, varid, &data[0][0])) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (check_points(ncid, varid, 0)) ERR;
+
+      /* Now the whole var is cached. */
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.chunk_cache < NY * NX * sizeof(short)) ERR;
+
+      /* Other memory types, read from the same chunks. */
+      index[0] = 17;
+      index[1] = 21;
+      if (nc_get_var1_longlong(ncid, varid, index, &llval)) ERR;
+      if (llval != VAL(17, 21)) ERR;
+      start[0] = 5;
+      start[1] = 4;
+      count[0] = 2;
+      count[1] = 2;
+      if (nc_get_vara_double(ncid, varid, start, count, dval)) ERR;
+      if (dval[0] != VAL(5, 4) || dval[1] != VAL(5, 5) ||
+	  dval[2] != VAL(6, 4) || dval[3] != VAL(6, 5)) ERR;
+
+      /* Range errors are for the values read. */
+      index[0] = 0;
+      index[1] = 0;
+      if (nc_get_var1_schar(ncid, varid, index, &bval) != NC_ERANGE) ERR;
+      index[0] = 15;
+      index[1] = 20;
+      if (nc_get_var1_schar(ncid, varid, index, &bval)) ERR;
+      if (bval != 20) ERR;
+
+      /* Reads past the end are still errors. */
+      index[0] = NY;
+      if (nc_get_var1_short(ncid, varid, index, &data[0][0]) != NC_EINVALCOORDS) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing that writes replace cached chunks...");
+   {
+      int ncid, varid;
+      short data[NY][NX];
+      int x, y;
+
+      for (y = 0; y < NY; y++)
+	 for (x = 0; x < NX; x++)
+	    data[y][x] = VAL(y, x) + 1;
+
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_inq_varid(ncid, "data", &varid)) ERR;
+      if (check_points(ncid, varid, 0)) ERR;
+      if (nc_put_var_short(ncid, varid, &data[0][0])) ERR;
+      if (check_points(ncid, varid, 1)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing a small cache...");
+   {
+      int ncid, varid;
+      size_t size, base;
+      nc_memory_usage_t usage;
+
+      /* No cache at all. What memory usage is left is HDF5's own
+       * chunk cache. */
+      if (nc_set_point_cache(0)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_varid(ncid, "data", &varid)) ERR;
+      if (check_points(ncid, varid, 1)) ERR;
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      base = usage.chunk_cache;
+      if (nc_close(ncid)) ERR;
+
+      /* Room for two chunks only. */
+      if (nc_set_point_cache(2 * CHUNK_Y * CHUNK_X * sizeof(short))) ERR;
+      if (nc_get_point_cache(&size)) ERR;
+      if (size != 2 * CHUNK_Y * CHUNK_X * sizeof(short)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (check_points(ncid, varid, 1)) ERR;
+      if (nc_inq_memory_usage(ncid, &usage)) ERR;
+      if (usage.chunk_cache <= base || usage.chunk_cache > base + size) ERR;
+      if (nc_close(ncid)) ERR;
+      if (nc_set_point_cache(default_size)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing point reads while appending records...");
+   {
+      int ncid, dimids[2], varid;
+      size_t chunks[2] = {4, REC_LEN};
+      size_t start[2] = {0, 0}, count[2] = {1, REC_LEN}, index[2];
+      float rec_out[REC_LEN], val;
+      int rec, r, x;
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "rec", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", REC_LEN, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "data", NC_FLOAT, 2, dimids, &varid)) ERR;
+      if (nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_set_append_mode(ncid, NC_APPEND_GEOMETRIC, NULL)) ERR;
+
+      /* Each append drops the chunks cached for the var, and the
+       * chunk it lands in is read again, longer than before. */
+      for (rec = 0; rec < NREC; rec++)
+      {
+	 start[0] = rec;
+	 for (x = 0; x < REC_LEN; x++)
+	    rec_out[x] = rec + x / 10.0f;
+	 if (nc_put_vara_float(ncid, varid, start, count, rec_out)) ERR;
+	 for (r = 0; r <= rec; r++)
+	 {
+	    index[0] = r;
+	    index[1] = r % REC_LEN;
+	    if (nc_get_var1_float(ncid, varid, index, &val)) ERR;
+	    if (val != r + (r % REC_LEN) / 10.0f) ERR;
+	 }
+	 index[0] = rec + 1;
+	 if (nc_get_var1_float(ncid, varid, index, &val) != NC_EINVALCOORDS) ERR;
+      }
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
@@ -0,0 +1,191 @@
+/* This is part of the netCDF package.
+   Copyright 2016 University Corporation for Atmospheric Research/Unidata
+   See COPYRIGHT file for conditions of use.
+
+   Test quantization of float and double variables with
+   nc_def_var_quantize().
+*/
+
+#include <config.h>
+#include <nc_tests.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#define FILE_NAME "tst_quantize.nc"
+#define FILE_NAME2 "tst_quantize2.nc"
+#define NY 64
+#define NX 100
+#define N (NY * NX)
+#define NSD 3
+#define NSB 10
+
+/* A noisy field, with a NaN, a fill value, an infinity and a zero
+ * at the start. */
+static void
+make_data(float *f, double *d)
+{
+   unsigned int seed = 12345;
+   size_t i;
+
+   for (i = 0; i < N; i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      d[i] = 280 + 20 * sin((double)i * 0.01) + (double)(seed >> 8) / (1 << 24);
+      if (i % 7 == 3)
+         d[i] = -d[i] / 1000;
+      f[i] = (float)d[i];
+   }
+   f[0] = NAN;
+   d[0] = NAN;
+   f[1] = NC_FILL_FLOAT;
+   d[1] = NC_FILL_DOUBLE;
+   f[2] = INFINITY;
+   d[2] = INFINITY;
+   f[3] = 0;
+   d[3] = 0;
+}
+
+/* Check the values read back are within the precision kept, and
+ * that the low bits are zero where they should be. */
+static int
+check_data(int ncid, int fid, int did, const float *f, const double *d)
+{
+   static float fback[N];
+   static double dback[N];
+   unsigned int fbits;
+   unsigned long long dbits;
+   size_t i;
+
+   if (nc_get_var_float(ncid, fid, fback)) ERR_RET;
+   if (nc_get_var_double(ncid, did, dback)) ERR_RET;
+   if (!isnan(fback[0]) || !isnan(dback[0])) ERR_RET;
+   if (fback[1] != NC_FILL_FLOAT || dback[1] != NC_FILL_DOUBLE) ERR_RET;
+   if (fback[2] != INFINITY || dback[2] != INFINITY) ERR_RET;
+   if (fback[3] != 0 || dback[3] != 0) ERR_RET;
+   for (i = 4; i < N; i++)
+   {
+      /* Bit grooming keeps 11 bits of a float for 3 digits, and
+       * shaves the other 12 of every other value. */
+      if (fabs(fback[i] - f[i]) > fabs(f[i]) * pow(2, -10)) ERR_RET;
+      if (fabs(fback[i] - f[i]) > fabs(f[i]) * 0.5e-3) ERR_RET;
+      memcpy(&fbits, &fback[i], sizeof(fbits));
+      if (i % 2 == 0 && (fbits & 0xfff)) ERR_RET;
+      if (i % 2 == 1 && (fbits & 0xfff) != 0xfff) ERR_RET;
+
+      /* Bit rounding keeps 10 bits, to within half the last. */
+      if (fabs(dback[i] - d[i]) > fabs(d[i]) * pow(2, -11)) ERR_RET;
+      memcpy(&dbits, &dback[i], sizeof(dbits));
+      if (dbits & ((1ULL << (52 - NSB)) - 1)) ERR_RET;
+   }
+   return 0;
+}
+
+static off_t
+file_size(const char *name)
+{
+   struct stat st;
+   if (stat(name, &st))
+      return 0;
+   return st.st_size;
+}
+
+int
+main(int argc, char **argv)
+{
+   static float f[N], fcopy[N];
+   static double d[N];
+
+   printf("\n*** Testing quantization of float variables.\n");
+   make_data(f, d);
+   printf("*** testing quantized writes...");
+   {
+      int ncid, dimids[2], fid, did, iid, mode, nsd;
+      size_t chunks[2] = {16, NX};
+
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "y", NY, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "f", NC_FLOAT, 2, dimids, &fid)) ERR;
+      if (nc_def_var(ncid, "d", NC_DOUBLE, 2, dimids, &did)) ERR;
+      if (nc_def_var(ncid, "i", NC_INT, 2, dimids, &iid)) ERR;
+      if (nc_def_var_chunking(ncid, fid, NC_CHUNKED, chunks)) ERR;
+      if (nc_def_var_deflate(ncid, fid, 1, 1, 1)) ERR;
+      if (nc_def_var_deflate(ncid, did, 1, 1, 1)) ERR;
+
+      /* Bad settings. */
+      if (nc_def_var_quantize(ncid, iid, NC_QUANTIZE_BITGROOM, NSD) != NC_EINVAL) ERR;
+      if (nc_def_var_quantize(ncid, fid, NC_QUANTIZE_BITGROOM, 0) != NC_EINVAL) ERR;
+      if (nc_def_var_quantize(ncid, fid, NC_QUANTIZE_BITGROOM, 8) != NC_EINVAL) ERR;
+      if (nc_def_var_quantize(ncid, did, NC_QUANTIZE_BITROUND, 53) != NC_EINVAL) ERR;
+      if (nc_def_var_quantize(ncid, fid, 99, NSD) != NC_EINVAL) ERR;
+      if (nc_def_var_quantize(ncid, 99, NC_QUANTIZE_BITGROOM, NSD) != NC_ENOTVAR) ERR;
+
+      /* A later setting replaces an earlier one, and its attribute. */
+      if (nc_def_var_quantize(ncid, fid, NC_QUANTIZE_BITROUND, 5)) ERR;
+      if (nc_def_var_quantize(ncid, fid, NC_QUANTIZE_BITGROOM, NSD)) ERR;
+      if (nc_def_var_quantize(ncid, did, NC_QUANTIZE_BITROUND, NSB)) ERR;
+      if (nc_inq_attid(ncid, fid, NC_QUANTIZE_BITROUND_ATT_NAME, NULL) != NC_ENOTATT) ERR;
+      if (nc_get_att_int(ncid, fid, NC_QUANTIZE_BITGROOM_ATT_NAME, &nsd)) ERR;
+      if (nsd != NSD) ERR;
+      if (nc_inq_var_quantize(ncid, iid, &mode, &nsd)) ERR;
+      if (mode != NC_NOQUANTIZE || nsd != 0) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_def_var_quantize(ncid, iid, NC_NOQUANTIZE, 0) != NC_ELATEDEF) ERR;
+
+      /* The caller's data is not changed. */
+      memcpy(fcopy, f, sizeof(f));
+      if (nc_put_var_float(ncid, fid, f)) ERR;
+      if (memcmp(fcopy, f, sizeof(f))) ERR;
+      if (nc_put_var_double(ncid, did, d)) ERR;
+      if (check_data(ncid, fid, did, f, d)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The settings come back from the attributes, and hold for
+       * new writes. Doubles written to the float var are quantized
+       * after they are converted. */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_inq_var_quantize(ncid, fid, &mode, &nsd)) ERR;
+      if (mode != NC_QUANTIZE_BITGROOM || nsd != NSD) ERR;
+      if (nc_inq_var_quantize(ncid, did, &mode, &nsd)) ERR;
+      if (mode != NC_QUANTIZE_BITROUND || nsd != NSB) ERR;
+      /* The infinity is out of range for a float, but is still
+       * written. */
+      if (nc_put_var_double(ncid, fid, d) != NC_ERANGE) ERR;
+      if (nc_put_var_double(ncid, did, d)) ERR;
+      if (check_data(ncid, fid, did, f, d)) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing quantized data compresses better...");
+   {
+      int ncid, dimids[2], varid, q;
+      off_t size[2];
+
+      for (q = 0; q < 2; q++)
+      {
+         if (nc_create(FILE_NAME2, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+         if (nc_def_dim(ncid, "y", NY, &dimids[0])) ERR;
+         if (nc_def_dim(ncid, "x", NX, &dimids[1])) ERR;
+         if (nc_def_var(ncid, "f", NC_FLOAT, 2, dimids, &varid)) ERR;
+         if (nc_def_var_deflate(ncid, varid, 1, 1, 1)) ERR;
+         if (q && nc_def_var_quantize(ncid, varid, NC_QUANTIZE_BITGROOM, NSD)) ERR;
+         if (nc_put_var_float(ncid, varid, f)) ERR;
+         if (nc_close(ncid)) ERR;
+         size[q] = file_size(FILE_NAME2);
+      }
+      if (!size[0] || size[1] * 5 > size[0] * 4) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("*** testing quantization of a classic file...");
+   {
+      int ncid, dimid, varid;
+
+      if (nc_create(FILE_NAME2, NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", NX, &dimid)) ERR;
+      if (nc_def_var(ncid, "f", NC_FLOAT, 1, &dimid, &varid)) ERR;
+      if (nc_def_var_quantize(ncid, varid, NC_QUANTIZE_BITGROOM, NSD) != NC_ENOTNC4) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   FINAL_RESULTS;
+}
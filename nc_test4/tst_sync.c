@@ -11,6 +11,8 @@
 #define DIM_NAME "x"
 #define VAR1_NAME "var1"
 #define VAR2_NAME "var2"
+#define NREC 5
+#define NX 4
 
 int
 main(int argc, char **argv)
@@ -85,6 +87,129 @@ main(int argc, char **argv)
       if (nc_close(ncid)) ERR;
    }
    SUMMARIZE_ERR;
+   printf("**** testing syncs after data mode changes...");
+   {
+      int ncid, dimids[2], tid, varid, data[NX], data_in[NREC][NX], flag, r, x;
+      size_t start[2] = {0, 0}, count[2] = {1, NX}, len;
+      double t, t_in[NREC];
+      nc_type typeid;
+      char units[2];
+
+      /* Sync after each record, as a writer does for crash safety,
+       * with the metadata index on. */
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_set_metadata_index(ncid, 1, NULL)) ERR;
+      if (nc_def_dim(ncid, "t", NC_UNLIMITED, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, DIM_NAME, NX, &dimids[1])) ERR;
+      if (nc_def_var(ncid, "t", NC_DOUBLE, 1, dimids, &tid)) ERR;
+      if (nc_def_var(ncid, VAR1_NAME, NC_INT, 2, dimids, &varid)) ERR;
+      if (nc_put_att_text(ncid, varid, "units", 1, "m")) ERR;
+      if (nc_enddef(ncid)) ERR;
+      for (r = 0; r < NREC; r++)
+      {
+         for (x = 0; x < NX; x++)
+            data[x] = r * 10 + x;
+         t = r * 0.5;
+         start[0] = (size_t)r;
+         if (nc_put_vara_int(ncid, varid, start, count, data)) ERR;
+         if (nc_put_var1_double(ncid, tid, start, &t)) ERR;
+         if (nc_sync(ncid)) ERR;
+      }
+
+      /* Changes that don't need define mode are written on sync. */
+      if (nc_put_att_text(ncid, varid, "units", 1, "s")) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_rename_var(ncid, varid, VAR2_NAME)) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_def_opaque(ncid, 4, "blob", &typeid)) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      /* The index was kept up to date, and is read. */
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, NULL, &flag)) ERR;
+      if (!flag) ERR;
+      if (nc_inq_dimlen(ncid, dimids[0], &len)) ERR;
+      if (len != NREC) ERR;
+      if (nc_inq_varid(ncid, VAR2_NAME, &varid)) ERR;
+      if (nc_get_att_text(ncid, varid, "units", units)) ERR;
+      if (units[0] != 's') ERR;
+      if (nc_inq_typeid(ncid, "blob", &typeid)) ERR;
+      if (nc_get_var_double(ncid, tid, t_in)) ERR;
+      if (nc_get_var_int(ncid, varid, &data_in[0][0])) ERR;
+      for (r = 0; r < NREC; r++)
+      {
+         if (t_in[r] != r * 0.5) ERR;
+         for (x = 0; x < NX; x++)
+            if (data_in[r][x] != r * 10 + x) ERR;
+      }
+      if (nc_close(ncid)) ERR;
+
+      /* Syncs after writing only data keep the index in use. */
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_sync(ncid)) ERR;
+      for (r = 0; r < NREC; r++)
+      {
+         data[0] = -r;
+         start[0] = (size_t)r;
+         if (nc_put_vara_int(ncid, varid, start, count, data)) ERR;
+         if (nc_sync(ncid)) ERR;
+      }
+      if (nc_close(ncid)) ERR;
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_metadata_index(ncid, NULL, &flag)) ERR;
+      if (!flag) ERR;
+      if (nc_get_var_int(ncid, varid, &data_in[0][0])) ERR;
+      for (r = 0; r < NREC; r++)
+         if (data_in[r][0] != -r) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
+   printf("**** testing syncs with coordinate vars out of order...");
+   {
+      int ncid, dimids[2], varid, xid, yid, ndims, dimids_in[2], x[2] = {1, 2};
+      int y[3] = {3, 4, 5}, one = 1;
+
+      /* Coordinate vars defined after a redef, and in the reverse
+       * order of their dims, need the dimids stored. */
+      if (nc_create(FILE_NAME, NC_NETCDF4|NC_CLOBBER, &ncid)) ERR;
+      if (nc_def_dim(ncid, "x", 2, &dimids[0])) ERR;
+      if (nc_def_dim(ncid, "y", 3, &dimids[1])) ERR;
+      if (nc_def_var(ncid, VAR1_NAME, NC_INT, 2, dimids, &varid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_redef(ncid)) ERR;
+      if (nc_def_var(ncid, "y", NC_INT, 1, &dimids[1], &yid)) ERR;
+      if (nc_def_var(ncid, "x", NC_INT, 1, &dimids[0], &xid)) ERR;
+      if (nc_enddef(ncid)) ERR;
+      if (nc_put_var_int(ncid, xid, x)) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_put_var_int(ncid, yid, y)) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_put_att_int(ncid, NC_GLOBAL, "one", NC_INT, 1, &one)) ERR;
+      if (nc_sync(ncid)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_WRITE, &ncid)) ERR;
+      if (nc_put_att_int(ncid, xid, "one", NC_INT, 1, &one)) ERR;
+      if (nc_close(ncid)) ERR;
+
+      if (nc_open(FILE_NAME, NC_NOWRITE, &ncid)) ERR;
+      if (nc_inq_dimid(ncid, "x", &dimids_in[0])) ERR;
+      if (nc_inq_dimid(ncid, "y", &dimids_in[1])) ERR;
+      if (dimids_in[0] != dimids[0] || dimids_in[1] != dimids[1]) ERR;
+      if (nc_inq_var(ncid, varid, NULL, NULL, &ndims, dimids_in, NULL)) ERR;
+      if (ndims != 2 || dimids_in[0] != dimids[0] || dimids_in[1] != dimids[1]) ERR;
+      if (nc_inq_varid(ncid, "x", &xid)) ERR;
+      if (nc_inq_vardimid(ncid, xid, dimids_in)) ERR;
+      if (dimids_in[0] != dimids[0]) ERR;
+      if (nc_get_att_int(ncid, xid, "one", &one)) ERR;
+      if (nc_get_att_int(ncid, NC_GLOBAL, "one", &one)) ERR;
+      if (nc_get_var_int(ncid, xid, x)) ERR;
+      if (x[0] != 1 || x[1] != 2) ERR;
+      if (nc_close(ncid)) ERR;
+   }
+   SUMMARIZE_ERR;
    FINAL_RESULTS;
 }
 
@@ -550,6 +550,21 @@ copy_var_specials(int igrp, int varid, int ogrp, int o_varid)
 	    NC_CHECK(nc_def_var_deflate(ogrp, o_varid, shuffle_out, deflate_out, deflate_level_out));
 	}
     }
+    {				/* handle other filters, copied unless
+				 * compression is set on the command line */
+	unsigned int id = 0;
+	size_t nparams = 0;
+	unsigned int *params = NULL;
+	NC_CHECK(nc_inq_var_filter(igrp, varid, &id, &nparams, NULL));
+	if(id != 0 && option_deflate_level == -1) {
+	    if(nparams > 0)
+		params = (unsigned int *) emalloc(nparams * sizeof(unsigned int));
+	    NC_CHECK(nc_inq_var_filter(igrp, varid, NULL, NULL, params));
+	    NC_CHECK(nc_def_var_filter(ogrp, o_varid, id, nparams, params));
+	    if(params)
+		free(params);
+	}
+    }
     {				/* handle checksum parameters */
 	int fletcher32 = 0;
 	NC_CHECK(nc_inq_var_fletcher32(igrp, varid, &fletcher32));
@@ -950,6 +965,206 @@ inq_nvals(int igrp, int varid, long long *nvalsp) {
     return stat;
 }
 
+#ifdef USE_NETCDF4
+/* Variables whose stored chunks are copied, for copy_chunk() */
+struct chunk_copy {
+    int igrp, varid;
+    int ogrp, ovarid;
+    size_t nstored;		/* number of chunks stored in input */
+    void *buf;			/* buffer for a stored chunk */
+    size_t buf_size;
+};
+
+static int
+count_chunk(const size_t *startp, unsigned int filter_mask, size_t size, void *udata) {
+    ((struct chunk_copy *)udata)->nstored++;
+    return NC_NOERR;
+}
+
+static int
+copy_chunk(const size_t *startp, unsigned int filter_mask, size_t size, void *udata) {
+    struct chunk_copy *cp = (struct chunk_copy *)udata;
+    if(size > cp->buf_size) {
+	if(cp->buf)
+	    free(cp->buf);
+	cp->buf = emalloc(size);
+	cp->buf_size = size;
+    }
+    NC_CHECK(nc_get_chunk_raw(cp->igrp, cp->varid, startp, &filter_mask, &size, cp->buf));
+    NC_CHECK(nc_put_chunk_raw(cp->ogrp, cp->ovarid, startp, filter_mask, size, cp->buf));
+    return NC_NOERR;
+}
+
+/* Return byte order of variable, with native order resolved */
+static int
+var_endian(int grpid, int varid) {
+    int endianness;
+    int one = 1;
+    NC_CHECK(nc_inq_var_endian(grpid, varid, &endianness));
+    if(endianness == NC_ENDIAN_NATIVE)
+	endianness = *(char *)&one ? NC_ENDIAN_LITTLE : NC_ENDIAN_BIG;
+    return endianness;
+}
+
+/* Return 1 if variable varid in group igrp and variable ovarid in
+ * group ogrp have the same filter, set with nc_def_var_filter, with
+ * the same params, else 0. */
+static int
+same_filter(int igrp, int varid, int ogrp, int ovarid) {
+    unsigned int iid, oid;
+    size_t inparams, onparams;
+    unsigned int *iparams, *oparams;
+    int same;
+
+    NC_CHECK(nc_inq_var_filter(igrp, varid, &iid, &inparams, NULL));
+    NC_CHECK(nc_inq_var_filter(ogrp, ovarid, &oid, &onparams, NULL));
+    if(iid != oid || inparams != onparams)
+	return 0;
+    if(inparams == 0)
+	return 1;
+    iparams = (unsigned int *) emalloc(inparams * sizeof(unsigned int));
+    oparams = (unsigned int *) emalloc(onparams * sizeof(unsigned int));
+    NC_CHECK(nc_inq_var_filter(igrp, varid, NULL, NULL, iparams));
+    NC_CHECK(nc_inq_var_filter(ogrp, ovarid, NULL, NULL, oparams));
+    same = memcmp(iparams, oparams, inparams * sizeof(unsigned int)) == 0;
+    free(iparams);
+    free(oparams);
+    return same;
+}
+
+/* Return 1 if variable varid in group igrp and variable ovarid in
+ * group ogrp have the same filters in the same order, else 0.  The
+ * filter mask of a stored chunk has a bit for each place in the
+ * pipeline, and files written by other programs may order filters
+ * differently. */
+static int
+same_filter_order(int igrp, int varid, int ogrp, int ovarid) {
+    size_t infilters, onfilters;
+    unsigned int *iids, *oids;
+    int same;
+
+    NC_CHECK(nc_inq_var_filter_ids(igrp, varid, &infilters, NULL));
+    NC_CHECK(nc_inq_var_filter_ids(ogrp, ovarid, &onfilters, NULL));
+    if(infilters != onfilters)
+	return 0;
+    if(infilters == 0)
+	return 1;
+    iids = (unsigned int *) emalloc(infilters * sizeof(unsigned int));
+    oids = (unsigned int *) emalloc(onfilters * sizeof(unsigned int));
+    NC_CHECK(nc_inq_var_filter_ids(igrp, varid, NULL, iids));
+    NC_CHECK(nc_inq_var_filter_ids(ogrp, ovarid, NULL, oids));
+    same = memcmp(iids, oids, infilters * sizeof(unsigned int)) == 0;
+    free(iids);
+    free(oids);
+    return same;
+}
+
+/* Return 1 if input variable varid in group igrp and output variable
+ * ovarid in group ogrp have the same atomic type, chunking, filters,
+ * and byte order, so that their stored chunks are the same, else 0. */
+static int
+same_chunk_storage(int igrp, int varid, int ogrp, int ovarid) {
+    int iformat, oformat;
+    nc_type itype, otype;
+    int ndims, ondims, dim;
+    int icontig, ocontig;
+    size_t ichunks[NC_MAX_VAR_DIMS], ochunks[NC_MAX_VAR_DIMS];
+    int ishuffle, ideflate, ilevel, oshuffle, odeflate, olevel;
+    int ifletcher32, ofletcher32;
+    int options_mask;
+
+    NC_CHECK(nc_inq_format(igrp, &iformat));
+    NC_CHECK(nc_inq_format(ogrp, &oformat));
+    if((iformat != NC_FORMAT_NETCDF4 && iformat != NC_FORMAT_NETCDF4_CLASSIC) ||
+       (oformat != NC_FORMAT_NETCDF4 && oformat != NC_FORMAT_NETCDF4_CLASSIC))
+	return 0;
+    NC_CHECK(nc_inq_var(igrp, varid, NULL, &itype, &ndims, NULL, NULL));
+    NC_CHECK(nc_inq_var(ogrp, ovarid, NULL, &otype, &ondims, NULL, NULL));
+    /* strings and user-defined types are stored as references */
+    if(itype != otype || itype <= NC_NAT || itype >= NC_STRING
+       || ndims != ondims || ndims == 0)
+	return 0;
+    NC_CHECK(nc_inq_var_chunking(igrp, varid, &icontig, ichunks));
+    NC_CHECK(nc_inq_var_chunking(ogrp, ovarid, &ocontig, ochunks));
+    if(icontig != NC_CHUNKED || ocontig != NC_CHUNKED)
+	return 0;
+    for(dim = 0; dim < ndims; dim++) {
+	if(ichunks[dim] != ochunks[dim])
+	    return 0;
+    }
+    NC_CHECK(nc_inq_var_deflate(igrp, varid, &ishuffle, &ideflate, &ilevel));
+    NC_CHECK(nc_inq_var_deflate(ogrp, ovarid, &oshuffle, &odeflate, &olevel));
+    if(ishuffle != oshuffle || ideflate != odeflate || (ideflate && ilevel != olevel))
+	return 0;
+    NC_CHECK(nc_inq_var_fletcher32(igrp, varid, &ifletcher32));
+    NC_CHECK(nc_inq_var_fletcher32(ogrp, ovarid, &ofletcher32));
+    if(ifletcher32 != ofletcher32)
+	return 0;
+    if(!same_filter(igrp, varid, ogrp, ovarid))
+	return 0;
+    if(!same_filter_order(igrp, varid, ogrp, ovarid))
+	return 0;
+    /* szip can be read but not written */
+    NC_CHECK(nc_inq_var_szip(igrp, varid, &options_mask, NULL));
+    if(options_mask)
+	return 0;
+    return var_endian(igrp, varid) == var_endian(ogrp, ovarid);
+}
+
+/* Copy data from variable varid in group igrp to variable ovarid in
+ * group ogrp as stored, chunk by chunk, without uncompressing and
+ * recompressing it, if the variables store their chunks the same
+ * way.  Set *copiedp to 1 if done, 0 if data must be copied the usual
+ * way. */
+static int
+copy_var_chunks(int igrp, int varid, int ogrp, int ovarid, int *copiedp) {
+    int stat = NC_NOERR;
+    struct chunk_copy cp;
+    int ndims, dim, contig;
+    int dimids[NC_MAX_VAR_DIMS];
+    size_t chunks[NC_MAX_VAR_DIMS], index[NC_MAX_VAR_DIMS];
+    size_t len, nchunks = 1;
+    unsigned long long value;	/* big enough for any atomic type */
+
+    *copiedp = 0;
+    if(!same_chunk_storage(igrp, varid, ogrp, ovarid))
+	return stat;
+    cp.igrp = igrp;
+    cp.varid = varid;
+    cp.ogrp = ogrp;
+    cp.ovarid = ovarid;
+    cp.nstored = 0;
+    cp.buf = 0;
+    cp.buf_size = 0;
+    stat = nc_iter_chunks_raw(igrp, varid, count_chunk, &cp);
+    if(stat == NC_ENOTBUILT)	/* library has no direct chunk I/O */
+	return NC_NOERR;
+    NC_CHECK(stat);
+
+    /* Output is not filled, so chunks not stored in input would read
+     * as garbage rather than fill values. */
+    NC_CHECK(nc_inq_var(igrp, varid, NULL, NULL, &ndims, dimids, NULL));
+    NC_CHECK(nc_inq_var_chunking(igrp, varid, &contig, chunks));
+    for(dim = 0; dim < ndims; dim++) {
+	NC_CHECK(nc_inq_dimlen(igrp, dimids[dim], &len));
+	nchunks *= (len + chunks[dim] - 1) / chunks[dim];
+	index[dim] = len - 1;
+    }
+    if(cp.nstored < nchunks)
+	return stat;
+
+    /* Extend any unlimited dimensions of output variable, by writing
+     * its last value */
+    NC_CHECK(nc_get_var1(igrp, varid, index, &value));
+    NC_CHECK(nc_put_var1(ogrp, ovarid, index, &value));
+    NC_CHECK(nc_iter_chunks_raw(igrp, varid, copy_chunk, &cp));
+    if(cp.buf)
+	free(cp.buf);
+    *copiedp = 1;
+    return stat;
+}
+#endif	/* USE_NETCDF4 */
+
 /* Copy data from variable varid in group igrp to corresponding group
  * ogrp. */
 static int
@@ -969,6 +1184,7 @@ copy_var_data(int igrp, int varid, int ogrp) {
 #ifdef USE_NETCDF4    
     int okind;
     size_t chunksize;
+    int copied;
 #endif
 
     NC_CHECK(inq_nvals(igrp, varid, &nvalues));
@@ -978,6 +1194,12 @@ copy_var_data(int igrp, int varid, int ogrp) {
     NC_CHECK(nc_inq_varname(igrp, varid, varname));
     NC_CHECK(nc_inq_varid(ogrp, varname, &ovarid));
     NC_CHECK(nc_inq_vartype(igrp, varid, &vartype));
+#ifdef USE_NETCDF4
+    /* copy compressed chunks as they are, if output stores them the same way */
+    NC_CHECK(copy_var_chunks(igrp, varid, ogrp, ovarid, &copied));
+    if(copied)
+	return stat;
+#endif	/* USE_NETCDF4 */
     value_size = val_size(igrp, varid);
     if(value_size > option_copy_buffer_size) {
 	option_copy_buffer_size = value_size;
@@ -115,13 +115,14 @@ usage(void)
   [-t]             Output time data as date-time strings\n\
   [-i]             Output time data as date-time strings with ISO-8601 'T' separator\n\
   [-g grp1[,...]]  Data and metadata for group(s) <grp1>,... only\n\
+  [-I]             Output index of byte ranges of variable data in file, as JSON\n\
   [-w]             With client-side caching of variables for DAP URLs\n\
   [-x]             Output XML (NcML) instead of CDL\n\
   [-Xp]            Unconditionally suppress output of the properties attribute\n\
   file             Name of netCDF file (or URL if DAP access enabled)\n"
 
     (void) fprintf(stderr,
-		   "%s [-c|-h] [-v ...] [[-b|-f] [c|f]] [-l len] [-n name] [-p n[,n]] [-k] [-x] [-s] [-t|-i] [-g ...] [-w] file\n%s",
+		   "%s [-c|-h] [-v ...] [[-b|-f] [c|f]] [-l len] [-n name] [-p n[,n]] [-k] [-x] [-s] [-t|-i] [-g ...] [-I] [-w] file\n%s",
 		   progname,
 		   USAGE);
 
@@ -1879,6 +1880,191 @@ done:
 }
 
 
+/* Print a string as a JSON string, with quotes and escapes */
+static void
+pr_json_string(const char *s)
+{
+    const unsigned char *cp;
+
+    putchar('"');
+    for (cp = (const unsigned char *)s; *cp; cp++) {
+	if (*cp == '"' || *cp == '\\')
+	    printf("\\%c", *cp);
+	else if (*cp < 0x20)
+	    printf("\\u%04x", *cp);
+	else
+	    putchar(*cp);
+    }
+    putchar('"');
+}
+
+static void
+pr_json_sizes(int n, const size_t *sizes)
+{
+    int i;
+
+    putchar('[');
+    for (i = 0; i < n; i++)
+	printf("%s%lu", i ? "," : "", (unsigned long)sizes[i]);
+    putchar(']');
+}
+
+/* Where the byte ranges of a variable are printed */
+typedef struct {
+    int ndims;
+    size_t nranges;		/* number printed so far */
+} index_var_t;
+
+static int
+pr_byte_range(const size_t *startp, const size_t *countp,
+	      unsigned long long offset, unsigned long long size,
+	      unsigned int filter_mask, void *udata)
+{
+    index_var_t *iv = (index_var_t *)udata;
+
+    printf("%s\n    [", iv->nranges ? "," : "");
+    pr_json_sizes(iv->ndims, startp);
+    printf(",%llu,%llu,%u]", offset, size, filter_mask);
+    iv->nranges++;
+    return NC_NOERR;
+}
+
+/* Print the byte-range index of a variable, as a JSON object */
+static void
+pr_var_index(int ncid, int varid, const char *grpname, int nvars_done)
+{
+    char name[NC_MAX_NAME + 1];
+    char type_name[NC_MAX_NAME + 1];
+    nc_type type;
+    int ndims, id;
+    int dimids[NC_MAX_VAR_DIMS];
+    size_t shape[NC_MAX_VAR_DIMS], block[NC_MAX_VAR_DIMS];
+    int is_nc4 = formatting_specs.nc_kind == NC_FORMAT_NETCDF4
+	|| formatting_specs.nc_kind == NC_FORMAT_NETCDF4_CLASSIC;
+    int contig = NC_CONTIGUOUS;
+    int endianness = NC_ENDIAN_BIG;
+    int shuffle = 0, deflate = 0, deflate_level = 0, fletcher32 = 0;
+    index_var_t iv;
+    char *fullname;
+
+    NC_CHECK( nc_inq_var(ncid, varid, name, &type, &ndims, dimids, NULL) );
+    NC_CHECK( nc_inq_type(ncid, type, type_name, NULL) );
+    for (id = 0; id < ndims; id++) {
+	NC_CHECK( nc_inq_dimlen(ncid, dimids[id], &shape[id]) );
+	block[id] = shape[id];
+    }
+    if (is_nc4) {
+	if (ndims > 0)
+	    NC_CHECK( nc_inq_var_chunking(ncid, varid, &contig, block) );
+	if (contig != NC_CHUNKED) {
+	    for (id = 0; id < ndims; id++)
+		block[id] = shape[id];
+	}
+	NC_CHECK( nc_inq_var_deflate(ncid, varid, &shuffle, &deflate, &deflate_level) );
+	NC_CHECK( nc_inq_var_fletcher32(ncid, varid, &fletcher32) );
+	NC_CHECK( nc_inq_var_endian(ncid, varid, &endianness) );
+	if (endianness == NC_ENDIAN_NATIVE) {
+	    int one = 1;
+	    endianness = *(char *)&one ? NC_ENDIAN_LITTLE : NC_ENDIAN_BIG;
+	}
+    } else if (ndims > 0 && isrecvar(ncid, varid)) {
+	block[0] = 1;		/* one record in each range */
+    }
+
+    fullname = (char *) emalloc(strlen(grpname) + strlen(name) + 2);
+    if (grpname[0])
+	sprintf(fullname, "%s/%s", grpname, name);
+    else
+	strcpy(fullname, name);
+    printf("%s\n  {\"name\": ", nvars_done ? "," : "");
+    pr_json_string(fullname);
+    free(fullname);
+    printf(", \"type\": ");
+    pr_json_string(type_name);
+    printf(", \"byte_order\": \"%s\", \"shape\": ",
+	   endianness == NC_ENDIAN_LITTLE ? "little" : "big");
+    pr_json_sizes(ndims, shape);
+    printf(", \"chunked\": %s, \"block\": ", contig == NC_CHUNKED ? "true" : "false");
+    pr_json_sizes(ndims, block);
+    printf(", \"shuffle\": %s, \"deflate_level\": %d, \"fletcher32\": %s,\n   \"ranges\": [",
+	   shuffle ? "true" : "false", deflate ? deflate_level : 0,
+	   fletcher32 ? "true" : "false");
+    iv.ndims = ndims;
+    iv.nranges = 0;
+    NC_CHECK( nc_iter_byte_ranges(ncid, varid, pr_byte_range, &iv) );
+    printf("]}");
+}
+
+/* Print the byte-range index of the variables in a group and its
+ * subgroups, returning the number of variables printed so far */
+static int
+pr_index_rec(int ncid, const char *grpname, int nvars_done)
+{
+    int nvars, varid, iv;
+    idnode_t* vlist = NULL;	/* list for vars specified with -v option */
+#ifdef USE_NETCDF4
+    int numgrps, *ncids, g;
+    char subname[NC_MAX_NAME + 1];
+    char *subgrpname;
+#endif /* USE_NETCDF4 */
+
+    if (formatting_specs.nlvars > 0) {
+	vlist = newidlist();
+	for (iv = 0; iv < formatting_specs.nlvars; iv++) {
+	    if(nc_inq_gvarid(ncid, formatting_specs.lvars[iv], &varid) == NC_NOERR)
+		idadd(vlist, varid);
+	}
+    }
+    NC_CHECK( nc_inq_nvars(ncid, &nvars) );
+    if (group_wanted(ncid, formatting_specs.nlgrps, formatting_specs.grpids)) {
+	for (varid = 0; varid < nvars; varid++) {
+	    if (formatting_specs.nlvars > 0 && ! idmember(vlist, varid))
+		continue;
+	    pr_var_index(ncid, varid, grpname, nvars_done++);
+	}
+    }
+    if (vlist)
+	freeidlist(vlist);
+
+#ifdef USE_NETCDF4
+    if (formatting_specs.nc_kind == NC_FORMAT_NETCDF4) {
+	NC_CHECK( nc_inq_grps(ncid, &numgrps, NULL) );
+	ncids = (int *) emalloc((numgrps + 1) * sizeof(int));
+	NC_CHECK( nc_inq_grps(ncid, NULL, ncids) );
+	for (g = 0; g < numgrps; g++) {
+	    NC_CHECK( nc_inq_grpname(ncids[g], subname) );
+	    subgrpname = (char *) emalloc(strlen(grpname) + strlen(subname) + 2);
+	    if (grpname[0])
+		sprintf(subgrpname, "%s/%s", grpname, subname);
+	    else
+		strcpy(subgrpname, subname);
+	    nvars_done = pr_index_rec(ncids[g], subgrpname, nvars_done);
+	    free(subgrpname);
+	}
+	free(ncids);
+    }
+#endif /* USE_NETCDF4 */
+    return nvars_done;
+}
+
+/* Print an index of where the data of each variable is in the file,
+ * as JSON, so other programs can read it without the netCDF
+ * library.  Each range is [start, offset, size, filter_mask]: the
+ * index of the first element of a block of data with the "block"
+ * shape of the variable, and its offset and size in bytes in the
+ * file. */
+static void
+do_ncindex(int ncid, const char *path)
+{
+    printf("{\"file\": ");
+    pr_json_string(path);
+    printf(", \"format\": ");
+    pr_json_string(kind_string(formatting_specs.nc_kind));
+    printf(",\n \"variables\": [");
+    pr_index_rec(ncid, "", 0);
+    printf("\n]}\n");
+}
+
 static void
 do_ncdump(int ncid, const char *path)
 {
@@ -2091,6 +2277,7 @@ main(int argc, char *argv[])
     bool_t xml_out = false;    /* if true, output NcML instead of CDL */
     bool_t kind_out = false;	/* if true, just output kind of netCDF file */
     bool_t kind_out_extended = false;	/* output inq_format vs inq_format_extended */
+    bool_t index_out = false;	/* if true, output index of byte ranges of data */
     int Xp_flag = 0;    /* indicate that -Xp flag was set */
 
 #if defined(WIN32) || defined(msdos) || defined(WIN64)
@@ -2112,7 +2299,7 @@ main(int argc, char *argv[])
        exit(EXIT_SUCCESS);
     }
 
-    while ((c = getopt(argc, argv, "b:cd:f:g:hikl:n:p:stv:xwKX:")) != EOF)
+    while ((c = getopt(argc, argv, "b:cd:f:g:hikl:n:p:stv:xwIKX:")) != EOF)
       switch(c) {
 	case 'h':		/* dump header only, no data */
 	  formatting_specs.header_only = true;
@@ -2183,6 +2370,9 @@ main(int argc, char *argv[])
         case 'K':	        /* extended format info */
 	  kind_out_extended = true;
 	  break;
+        case 'I':	        /* index of byte ranges of variable data */
+	  index_out = true;
+	  break;
 	case 't':		/* human-readable strings for date-time values */
 	  formatting_specs.string_times = true;
 	  formatting_specs.iso_separator = false;
@@ -2301,7 +2491,9 @@ main(int argc, char *argv[])
 		    if(grp_matches(ncid, formatting_specs.nlgrps, formatting_specs.lgrps, formatting_specs.grpids) == 0)
 			exit(EXIT_FAILURE);
 		}
-		if (xml_out) {
+		if (index_out) {
+		    do_ncindex(ncid, path);
+		} else if (xml_out) {
 		    if(formatting_specs.nc_kind == NC_FORMAT_NETCDF4) {
 			error("NcML output (-x) currently only permitted for netCDF classic model");
 			exit(EXIT_FAILURE);
@@ -58,7 +58,13 @@ fi
 if fgrep '_Shuffle' < tmp.cdl ; then
     exit 1
 fi
-rm tst_deflated.nc tst_inflated.nc tst_inflated4.nc tmp.nc tmp.cdl
+echo "*** Test nccopy of a compressed netCDF-4 file, copying its chunks as stored ..."
+./nccopy -d1 -s tst_inflated4.nc tst_deflated.nc
+./nccopy tst_deflated.nc tmp.nc
+./ncdump -s -n tmp tst_deflated.nc > tmp.cdl
+./ncdump -s tmp.nc > tmp-copy.cdl
+diff tmp.cdl tmp-copy.cdl
+rm tst_deflated.nc tst_inflated.nc tst_inflated4.nc tmp.nc tmp.cdl tmp-copy.cdl
 
 echo "*** Testing nccopy -d1 -s on ncdump/*.nc files"
 for i in $TESTFILES ; do
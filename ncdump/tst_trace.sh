@@ -0,0 +1,66 @@
+#!/bin/sh
+if test "x$SETX" = x1 ; then echo "file=$0"; set -x ; fi
+# This shell script tests dispatch-layer tracing (NETCDF_TRACE and
+# NETCDF_TRACE_JSON) by profiling unmodified ncgen and ncdump runs.
+
+if test "x$srcdir" = x ; then
+srcdir="."
+fi
+
+ECODE=0
+
+echo ""
+echo "*** Testing dispatch tracing."
+rm -f tst_trace.nc tst_trace.txt tst_trace.json tmp_trace.cdl
+
+echo "Test that tracing is off by default"
+../ncgen/ncgen -b -o tst_trace.nc $srcdir/ref_tst_small.cdl
+./ncdump tst_trace.nc > tmp_trace.cdl 2>&1
+if grep 'netCDF dispatch trace' <tmp_trace.cdl ; then
+echo "*** Fail: trace written without NETCDF_TRACE"
+ECODE=1
+fi
+
+echo "Test the summary"
+NETCDF_TRACE=tst_trace.txt ./ncdump tst_trace.nc > tmp_trace.cdl
+if ! grep 'netCDF dispatch trace' <tst_trace.txt ; then
+echo "*** Fail: no trace summary"
+ECODE=1
+fi
+for op in open inq_var_all get_vara close ; do
+if ! grep "^$op " <tst_trace.txt >/dev/null ; then
+echo "*** Fail: $op missing from the trace summary"
+ECODE=1
+fi
+done
+if ! grep '^    >=' <tst_trace.txt >/dev/null ; then
+echo "*** Fail: no latency histogram"
+ECODE=1
+fi
+# Exactly one open and one close
+if ! grep '^open  *1 ' <tst_trace.txt >/dev/null ; then
+echo "*** Fail: wrong open count"
+ECODE=1
+fi
+
+echo "Test the summary on stderr and the Chrome trace events"
+NETCDF_TRACE=1 NETCDF_TRACE_JSON=tst_trace.json ./ncdump tst_trace.nc 2>tmp_trace.cdl >/dev/null
+if ! grep 'netCDF dispatch trace' <tmp_trace.cdl ; then
+echo "*** Fail: no trace summary on stderr"
+ECODE=1
+fi
+if test "x`head -1 tst_trace.json`" != 'x[' -o "x`tail -1 tst_trace.json`" != 'x]' ; then
+echo "*** Fail: trace events are not a JSON array"
+ECODE=1
+fi
+if ! grep '{"name":"open","cat":"netcdf","ph":"X",' <tst_trace.json >/dev/null ; then
+echo "*** Fail: no open event"
+ECODE=1
+fi
+if test `grep -c '"name":"get_vara"' tst_trace.json` -lt 1 ; then
+echo "*** Fail: no get_vara events"
+ECODE=1
+fi
+
+rm -f tst_trace.nc tst_trace.txt tst_trace.json tmp_trace.cdl
+exit $ECODE